@@ -0,0 +1,73 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/backends/sentry_backend_none.c" "CMakeFiles/sentry.dir/src/backends/sentry_backend_none.c.o" "gcc" "CMakeFiles/sentry.dir/src/backends/sentry_backend_none.c.o.d"
+  "/root/repo/src/modulefinder/sentry_modulefinder.c" "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder.c.o" "gcc" "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder.c.o.d"
+  "/root/repo/src/modulefinder/sentry_modulefinder_linux.c" "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder_linux.c.o" "gcc" "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder_linux.c.o.d"
+  "/root/repo/src/path/sentry_path.c" "CMakeFiles/sentry.dir/src/path/sentry_path.c.o" "gcc" "CMakeFiles/sentry.dir/src/path/sentry_path.c.o.d"
+  "/root/repo/src/path/sentry_path_unix.c" "CMakeFiles/sentry.dir/src/path/sentry_path_unix.c.o" "gcc" "CMakeFiles/sentry.dir/src/path/sentry_path_unix.c.o.d"
+  "/root/repo/src/sentry_alloc.c" "CMakeFiles/sentry.dir/src/sentry_alloc.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_alloc.c.o.d"
+  "/root/repo/src/sentry_backend.c" "CMakeFiles/sentry.dir/src/sentry_backend.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_backend.c.o.d"
+  "/root/repo/src/sentry_breadcrumb.c" "CMakeFiles/sentry.dir/src/sentry_breadcrumb.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_breadcrumb.c.o.d"
+  "/root/repo/src/sentry_core.c" "CMakeFiles/sentry.dir/src/sentry_core.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_core.c.o.d"
+  "/root/repo/src/sentry_database.c" "CMakeFiles/sentry.dir/src/sentry_database.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_database.c.o.d"
+  "/root/repo/src/sentry_dedup.c" "CMakeFiles/sentry.dir/src/sentry_dedup.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_dedup.c.o.d"
+  "/root/repo/src/sentry_dtoa.c" "CMakeFiles/sentry.dir/src/sentry_dtoa.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_dtoa.c.o.d"
+  "/root/repo/src/sentry_envelope.c" "CMakeFiles/sentry.dir/src/sentry_envelope.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_envelope.c.o.d"
+  "/root/repo/src/sentry_info.c" "CMakeFiles/sentry.dir/src/sentry_info.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_info.c.o.d"
+  "/root/repo/src/sentry_journal.c" "CMakeFiles/sentry.dir/src/sentry_journal.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_journal.c.o.d"
+  "/root/repo/src/sentry_json.c" "CMakeFiles/sentry.dir/src/sentry_json.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_json.c.o.d"
+  "/root/repo/src/sentry_logger.c" "CMakeFiles/sentry.dir/src/sentry_logger.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_logger.c.o.d"
+  "/root/repo/src/sentry_metrics.c" "CMakeFiles/sentry.dir/src/sentry_metrics.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_metrics.c.o.d"
+  "/root/repo/src/sentry_offline.c" "CMakeFiles/sentry.dir/src/sentry_offline.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_offline.c.o.d"
+  "/root/repo/src/sentry_options.c" "CMakeFiles/sentry.dir/src/sentry_options.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_options.c.o.d"
+  "/root/repo/src/sentry_os.c" "CMakeFiles/sentry.dir/src/sentry_os.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_os.c.o.d"
+  "/root/repo/src/sentry_profiler.c" "CMakeFiles/sentry.dir/src/sentry_profiler.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_profiler.c.o.d"
+  "/root/repo/src/sentry_random.c" "CMakeFiles/sentry.dir/src/sentry_random.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_random.c.o.d"
+  "/root/repo/src/sentry_ratelimiter.c" "CMakeFiles/sentry.dir/src/sentry_ratelimiter.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_ratelimiter.c.o.d"
+  "/root/repo/src/sentry_ringbuffer.c" "CMakeFiles/sentry.dir/src/sentry_ringbuffer.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_ringbuffer.c.o.d"
+  "/root/repo/src/sentry_ringfile.c" "CMakeFiles/sentry.dir/src/sentry_ringfile.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_ringfile.c.o.d"
+  "/root/repo/src/sentry_sampling.c" "CMakeFiles/sentry.dir/src/sentry_sampling.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_sampling.c.o.d"
+  "/root/repo/src/sentry_scope.c" "CMakeFiles/sentry.dir/src/sentry_scope.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_scope.c.o.d"
+  "/root/repo/src/sentry_session.c" "CMakeFiles/sentry.dir/src/sentry_session.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_session.c.o.d"
+  "/root/repo/src/sentry_session_aggregator.c" "CMakeFiles/sentry.dir/src/sentry_session_aggregator.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_session_aggregator.c.o.d"
+  "/root/repo/src/sentry_sidecar.c" "CMakeFiles/sentry.dir/src/sentry_sidecar.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_sidecar.c.o.d"
+  "/root/repo/src/sentry_slice.c" "CMakeFiles/sentry.dir/src/sentry_slice.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_slice.c.o.d"
+  "/root/repo/src/sentry_stats.c" "CMakeFiles/sentry.dir/src/sentry_stats.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_stats.c.o.d"
+  "/root/repo/src/sentry_string.c" "CMakeFiles/sentry.dir/src/sentry_string.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_string.c.o.d"
+  "/root/repo/src/sentry_sync.c" "CMakeFiles/sentry.dir/src/sentry_sync.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_sync.c.o.d"
+  "/root/repo/src/sentry_tracepoint.c" "CMakeFiles/sentry.dir/src/sentry_tracepoint.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_tracepoint.c.o.d"
+  "/root/repo/src/sentry_tracing.c" "CMakeFiles/sentry.dir/src/sentry_tracing.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_tracing.c.o.d"
+  "/root/repo/src/sentry_transport.c" "CMakeFiles/sentry.dir/src/sentry_transport.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_transport.c.o.d"
+  "/root/repo/src/sentry_unix_pageallocator.c" "CMakeFiles/sentry.dir/src/sentry_unix_pageallocator.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_unix_pageallocator.c.o.d"
+  "/root/repo/src/sentry_utils.c" "CMakeFiles/sentry.dir/src/sentry_utils.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_utils.c.o.d"
+  "/root/repo/src/sentry_uuid.c" "CMakeFiles/sentry.dir/src/sentry_uuid.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_uuid.c.o.d"
+  "/root/repo/src/sentry_value.c" "CMakeFiles/sentry.dir/src/sentry_value.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_value.c.o.d"
+  "/root/repo/src/sentry_watchdog.c" "CMakeFiles/sentry.dir/src/sentry_watchdog.c.o" "gcc" "CMakeFiles/sentry.dir/src/sentry_watchdog.c.o.d"
+  "/root/repo/src/symbolizer/sentry_symbolizer.c" "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer.c.o" "gcc" "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer.c.o.d"
+  "/root/repo/src/symbolizer/sentry_symbolizer_unix.c" "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer_unix.c.o" "gcc" "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer_unix.c.o.d"
+  "/root/repo/src/transports/sentry_disk_transport.c" "CMakeFiles/sentry.dir/src/transports/sentry_disk_transport.c.o" "gcc" "CMakeFiles/sentry.dir/src/transports/sentry_disk_transport.c.o.d"
+  "/root/repo/src/transports/sentry_function_transport.c" "CMakeFiles/sentry.dir/src/transports/sentry_function_transport.c.o" "gcc" "CMakeFiles/sentry.dir/src/transports/sentry_function_transport.c.o.d"
+  "/root/repo/src/transports/sentry_transport_curl.c" "CMakeFiles/sentry.dir/src/transports/sentry_transport_curl.c.o" "gcc" "CMakeFiles/sentry.dir/src/transports/sentry_transport_curl.c.o.d"
+  "/root/repo/src/transports/sentry_transport_sidecar.c" "CMakeFiles/sentry.dir/src/transports/sentry_transport_sidecar.c.o" "gcc" "CMakeFiles/sentry.dir/src/transports/sentry_transport_sidecar.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder.c" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder.c.o" "gcc" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_fp.c" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_fp.c.o" "gcc" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_fp.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_libbacktrace.c" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_libbacktrace.c.o" "gcc" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_libbacktrace.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_threads.c" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_threads.c.o" "gcc" "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_threads.c.o.d"
+  "/root/repo/vendor/mpack.c" "CMakeFiles/sentry.dir/vendor/mpack.c.o" "gcc" "CMakeFiles/sentry.dir/vendor/mpack.c.o.d"
+  "/root/repo/vendor/stb_sprintf.c" "CMakeFiles/sentry.dir/vendor/stb_sprintf.c.o" "gcc" "CMakeFiles/sentry.dir/vendor/stb_sprintf.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
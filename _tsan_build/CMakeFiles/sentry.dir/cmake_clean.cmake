@@ -0,0 +1,119 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sentry.dir/src/backends/sentry_backend_none.c.o"
+  "CMakeFiles/sentry.dir/src/backends/sentry_backend_none.c.o.d"
+  "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder.c.o"
+  "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder.c.o.d"
+  "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder_linux.c.o"
+  "CMakeFiles/sentry.dir/src/modulefinder/sentry_modulefinder_linux.c.o.d"
+  "CMakeFiles/sentry.dir/src/path/sentry_path.c.o"
+  "CMakeFiles/sentry.dir/src/path/sentry_path.c.o.d"
+  "CMakeFiles/sentry.dir/src/path/sentry_path_unix.c.o"
+  "CMakeFiles/sentry.dir/src/path/sentry_path_unix.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_alloc.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_alloc.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_backend.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_backend.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_breadcrumb.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_breadcrumb.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_core.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_core.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_database.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_database.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_dedup.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_dedup.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_dtoa.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_dtoa.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_envelope.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_envelope.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_info.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_info.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_journal.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_journal.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_json.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_json.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_logger.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_logger.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_metrics.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_metrics.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_offline.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_offline.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_options.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_options.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_os.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_os.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_profiler.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_profiler.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_random.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_random.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_ratelimiter.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_ratelimiter.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_ringbuffer.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_ringbuffer.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_ringfile.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_ringfile.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_sampling.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_sampling.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_scope.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_scope.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_session.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_session.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_session_aggregator.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_session_aggregator.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_sidecar.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_sidecar.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_slice.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_slice.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_stats.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_stats.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_string.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_string.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_sync.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_sync.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_tracepoint.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_tracepoint.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_tracing.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_tracing.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_transport.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_transport.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_unix_pageallocator.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_unix_pageallocator.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_utils.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_utils.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_uuid.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_uuid.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_value.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_value.c.o.d"
+  "CMakeFiles/sentry.dir/src/sentry_watchdog.c.o"
+  "CMakeFiles/sentry.dir/src/sentry_watchdog.c.o.d"
+  "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer.c.o"
+  "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer.c.o.d"
+  "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer_unix.c.o"
+  "CMakeFiles/sentry.dir/src/symbolizer/sentry_symbolizer_unix.c.o.d"
+  "CMakeFiles/sentry.dir/src/transports/sentry_disk_transport.c.o"
+  "CMakeFiles/sentry.dir/src/transports/sentry_disk_transport.c.o.d"
+  "CMakeFiles/sentry.dir/src/transports/sentry_function_transport.c.o"
+  "CMakeFiles/sentry.dir/src/transports/sentry_function_transport.c.o.d"
+  "CMakeFiles/sentry.dir/src/transports/sentry_transport_curl.c.o"
+  "CMakeFiles/sentry.dir/src/transports/sentry_transport_curl.c.o.d"
+  "CMakeFiles/sentry.dir/src/transports/sentry_transport_sidecar.c.o"
+  "CMakeFiles/sentry.dir/src/transports/sentry_transport_sidecar.c.o.d"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder.c.o"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder.c.o.d"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_fp.c.o"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_fp.c.o.d"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_libbacktrace.c.o"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_libbacktrace.c.o.d"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_threads.c.o"
+  "CMakeFiles/sentry.dir/src/unwinder/sentry_unwinder_threads.c.o.d"
+  "CMakeFiles/sentry.dir/vendor/mpack.c.o"
+  "CMakeFiles/sentry.dir/vendor/mpack.c.o.d"
+  "CMakeFiles/sentry.dir/vendor/stb_sprintf.c.o"
+  "CMakeFiles/sentry.dir/vendor/stb_sprintf.c.o.d"
+  "libsentry.pdb"
+  "libsentry.so"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sentry.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
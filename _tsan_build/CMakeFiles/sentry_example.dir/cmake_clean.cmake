@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sentry_example.dir/examples/example.c.o"
+  "CMakeFiles/sentry_example.dir/examples/example.c.o.d"
+  "sentry_example"
+  "sentry_example.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sentry_example.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sentry_sidecar_uploader.dir/examples/sidecar_uploader.c.o"
+  "CMakeFiles/sentry_sidecar_uploader.dir/examples/sidecar_uploader.c.o.d"
+  "sentry_sidecar_uploader"
+  "sentry_sidecar_uploader.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sentry_sidecar_uploader.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,10 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_tsan_build
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(sentry_example "/root/repo/_tsan_build/sentry_example")
+set_tests_properties(sentry_example PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;676;add_test;/root/repo/CMakeLists.txt;0;")
+subdirs("src")
+subdirs("tests/unit")
@@ -0,0 +1,109 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/backends/sentry_backend_none.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/backends/sentry_backend_none.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/backends/sentry_backend_none.c.o.d"
+  "/root/repo/src/modulefinder/sentry_modulefinder.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder.c.o.d"
+  "/root/repo/src/modulefinder/sentry_modulefinder_linux.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder_linux.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder_linux.c.o.d"
+  "/root/repo/src/path/sentry_path.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path.c.o.d"
+  "/root/repo/src/path/sentry_path_unix.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path_unix.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path_unix.c.o.d"
+  "/root/repo/src/sentry_alloc.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_alloc.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_alloc.c.o.d"
+  "/root/repo/src/sentry_backend.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_backend.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_backend.c.o.d"
+  "/root/repo/src/sentry_breadcrumb.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_breadcrumb.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_breadcrumb.c.o.d"
+  "/root/repo/src/sentry_core.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_core.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_core.c.o.d"
+  "/root/repo/src/sentry_database.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_database.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_database.c.o.d"
+  "/root/repo/src/sentry_dedup.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dedup.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dedup.c.o.d"
+  "/root/repo/src/sentry_dtoa.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dtoa.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dtoa.c.o.d"
+  "/root/repo/src/sentry_envelope.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_envelope.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_envelope.c.o.d"
+  "/root/repo/src/sentry_info.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_info.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_info.c.o.d"
+  "/root/repo/src/sentry_journal.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_journal.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_journal.c.o.d"
+  "/root/repo/src/sentry_json.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_json.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_json.c.o.d"
+  "/root/repo/src/sentry_logger.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_logger.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_logger.c.o.d"
+  "/root/repo/src/sentry_metrics.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_metrics.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_metrics.c.o.d"
+  "/root/repo/src/sentry_offline.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_offline.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_offline.c.o.d"
+  "/root/repo/src/sentry_options.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_options.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_options.c.o.d"
+  "/root/repo/src/sentry_os.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_os.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_os.c.o.d"
+  "/root/repo/src/sentry_profiler.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_profiler.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_profiler.c.o.d"
+  "/root/repo/src/sentry_random.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_random.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_random.c.o.d"
+  "/root/repo/src/sentry_ratelimiter.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ratelimiter.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ratelimiter.c.o.d"
+  "/root/repo/src/sentry_ringbuffer.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringbuffer.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringbuffer.c.o.d"
+  "/root/repo/src/sentry_ringfile.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringfile.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringfile.c.o.d"
+  "/root/repo/src/sentry_sampling.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sampling.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sampling.c.o.d"
+  "/root/repo/src/sentry_scope.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_scope.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_scope.c.o.d"
+  "/root/repo/src/sentry_session.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session.c.o.d"
+  "/root/repo/src/sentry_session_aggregator.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session_aggregator.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session_aggregator.c.o.d"
+  "/root/repo/src/sentry_sidecar.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sidecar.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sidecar.c.o.d"
+  "/root/repo/src/sentry_slice.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_slice.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_slice.c.o.d"
+  "/root/repo/src/sentry_stats.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_stats.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_stats.c.o.d"
+  "/root/repo/src/sentry_string.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_string.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_string.c.o.d"
+  "/root/repo/src/sentry_sync.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sync.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sync.c.o.d"
+  "/root/repo/src/sentry_tracepoint.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracepoint.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracepoint.c.o.d"
+  "/root/repo/src/sentry_tracing.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracing.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracing.c.o.d"
+  "/root/repo/src/sentry_transport.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_transport.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_transport.c.o.d"
+  "/root/repo/src/sentry_unix_pageallocator.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_unix_pageallocator.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_unix_pageallocator.c.o.d"
+  "/root/repo/src/sentry_utils.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_utils.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_utils.c.o.d"
+  "/root/repo/src/sentry_uuid.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_uuid.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_uuid.c.o.d"
+  "/root/repo/src/sentry_value.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_value.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_value.c.o.d"
+  "/root/repo/src/sentry_watchdog.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_watchdog.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_watchdog.c.o.d"
+  "/root/repo/src/symbolizer/sentry_symbolizer.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer.c.o.d"
+  "/root/repo/src/symbolizer/sentry_symbolizer_unix.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer_unix.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer_unix.c.o.d"
+  "/root/repo/src/transports/sentry_disk_transport.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_disk_transport.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_disk_transport.c.o.d"
+  "/root/repo/src/transports/sentry_function_transport.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_function_transport.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_function_transport.c.o.d"
+  "/root/repo/src/transports/sentry_transport_curl.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_curl.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_curl.c.o.d"
+  "/root/repo/src/transports/sentry_transport_sidecar.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_sidecar.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_sidecar.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_fp.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_fp.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_fp.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_libbacktrace.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_libbacktrace.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_libbacktrace.c.o.d"
+  "/root/repo/src/unwinder/sentry_unwinder_threads.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_threads.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_threads.c.o.d"
+  "/root/repo/vendor/mpack.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/vendor/mpack.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/vendor/mpack.c.o.d"
+  "/root/repo/vendor/stb_sprintf.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/vendor/stb_sprintf.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/__/__/vendor/stb_sprintf.c.o.d"
+  "/root/repo/tests/unit/main.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/main.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/main.c.o.d"
+  "/root/repo/tests/unit/test_attachments.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_attachments.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_attachments.c.o.d"
+  "/root/repo/tests/unit/test_basic.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_basic.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_basic.c.o.d"
+  "/root/repo/tests/unit/test_concurrency.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_concurrency.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_concurrency.c.o.d"
+  "/root/repo/tests/unit/test_consent.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_consent.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_consent.c.o.d"
+  "/root/repo/tests/unit/test_dedup.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_dedup.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_dedup.c.o.d"
+  "/root/repo/tests/unit/test_envelopes.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_envelopes.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_envelopes.c.o.d"
+  "/root/repo/tests/unit/test_failures.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_failures.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_failures.c.o.d"
+  "/root/repo/tests/unit/test_fuzzfailures.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_fuzzfailures.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_fuzzfailures.c.o.d"
+  "/root/repo/tests/unit/test_info.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_info.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_info.c.o.d"
+  "/root/repo/tests/unit/test_journal.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_journal.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_journal.c.o.d"
+  "/root/repo/tests/unit/test_logger.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_logger.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_logger.c.o.d"
+  "/root/repo/tests/unit/test_metrics.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_metrics.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_metrics.c.o.d"
+  "/root/repo/tests/unit/test_modulefinder.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_modulefinder.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_modulefinder.c.o.d"
+  "/root/repo/tests/unit/test_mpack.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_mpack.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_mpack.c.o.d"
+  "/root/repo/tests/unit/test_offline.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_offline.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_offline.c.o.d"
+  "/root/repo/tests/unit/test_path.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_path.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_path.c.o.d"
+  "/root/repo/tests/unit/test_profiler.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_profiler.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_profiler.c.o.d"
+  "/root/repo/tests/unit/test_ratelimiter.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ratelimiter.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ratelimiter.c.o.d"
+  "/root/repo/tests/unit/test_ringbuffer.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ringbuffer.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ringbuffer.c.o.d"
+  "/root/repo/tests/unit/test_ringfile.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ringfile.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_ringfile.c.o.d"
+  "/root/repo/tests/unit/test_sampling.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sampling.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sampling.c.o.d"
+  "/root/repo/tests/unit/test_session.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_session.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_session.c.o.d"
+  "/root/repo/tests/unit/test_sidecar.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sidecar.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sidecar.c.o.d"
+  "/root/repo/tests/unit/test_slab.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_slab.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_slab.c.o.d"
+  "/root/repo/tests/unit/test_slice.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_slice.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_slice.c.o.d"
+  "/root/repo/tests/unit/test_symbolizer.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_symbolizer.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_symbolizer.c.o.d"
+  "/root/repo/tests/unit/test_sync.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sync.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_sync.c.o.d"
+  "/root/repo/tests/unit/test_tracing.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_tracing.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_tracing.c.o.d"
+  "/root/repo/tests/unit/test_uninit.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_uninit.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_uninit.c.o.d"
+  "/root/repo/tests/unit/test_unwinder.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_unwinder.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_unwinder.c.o.d"
+  "/root/repo/tests/unit/test_utils.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_utils.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_utils.c.o.d"
+  "/root/repo/tests/unit/test_uuid.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_uuid.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_uuid.c.o.d"
+  "/root/repo/tests/unit/test_value.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_value.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_value.c.o.d"
+  "/root/repo/tests/unit/test_watchdog.c" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_watchdog.c.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_watchdog.c.o.d"
+  "/root/repo/tests/unit/test_tracing_cxx.cpp" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_tracing_cxx.cpp.o" "gcc" "tests/unit/CMakeFiles/sentry_test_unit.dir/test_tracing_cxx.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,191 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/backends/sentry_backend_none.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/backends/sentry_backend_none.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder_linux.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/modulefinder/sentry_modulefinder_linux.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path_unix.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/path/sentry_path_unix.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_alloc.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_alloc.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_backend.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_backend.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_breadcrumb.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_breadcrumb.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_core.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_core.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_database.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_database.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dedup.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dedup.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dtoa.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_dtoa.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_envelope.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_envelope.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_info.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_info.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_journal.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_journal.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_json.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_json.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_logger.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_logger.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_metrics.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_metrics.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_offline.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_offline.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_options.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_options.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_os.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_os.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_profiler.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_profiler.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_random.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_random.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ratelimiter.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ratelimiter.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringbuffer.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringbuffer.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringfile.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_ringfile.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sampling.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sampling.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_scope.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_scope.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session_aggregator.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_session_aggregator.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sidecar.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sidecar.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_slice.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_slice.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_stats.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_stats.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_string.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_string.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sync.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_sync.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracepoint.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracepoint.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracing.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_tracing.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_transport.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_transport.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_unix_pageallocator.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_unix_pageallocator.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_utils.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_utils.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_uuid.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_uuid.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_value.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_value.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_watchdog.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/sentry_watchdog.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer_unix.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/symbolizer/sentry_symbolizer_unix.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_disk_transport.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_disk_transport.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_function_transport.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_function_transport.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_curl.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_curl.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_sidecar.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/transports/sentry_transport_sidecar.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_fp.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_fp.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_libbacktrace.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_libbacktrace.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_threads.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/src/unwinder/sentry_unwinder_threads.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/vendor/mpack.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/vendor/mpack.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/__/__/vendor/stb_sprintf.c.o"
+  "CMakeFiles/sentry_test_unit.dir/__/__/vendor/stb_sprintf.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/main.c.o"
+  "CMakeFiles/sentry_test_unit.dir/main.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_attachments.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_attachments.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_basic.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_basic.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_concurrency.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_concurrency.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_consent.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_consent.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_dedup.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_dedup.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_envelopes.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_envelopes.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_failures.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_failures.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_fuzzfailures.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_fuzzfailures.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_info.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_info.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_journal.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_journal.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_logger.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_logger.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_metrics.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_metrics.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_modulefinder.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_modulefinder.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_mpack.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_mpack.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_offline.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_offline.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_path.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_path.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_profiler.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_profiler.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_ratelimiter.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_ratelimiter.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_ringbuffer.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_ringbuffer.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_ringfile.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_ringfile.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_sampling.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_sampling.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_session.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_session.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_sidecar.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_sidecar.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_slab.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_slab.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_slice.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_slice.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_symbolizer.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_symbolizer.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_sync.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_sync.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_tracing.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_tracing.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_tracing_cxx.cpp.o"
+  "CMakeFiles/sentry_test_unit.dir/test_tracing_cxx.cpp.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_uninit.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_uninit.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_unwinder.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_unwinder.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_utils.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_utils.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_uuid.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_uuid.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_value.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_value.c.o.d"
+  "CMakeFiles/sentry_test_unit.dir/test_watchdog.c.o"
+  "CMakeFiles/sentry_test_unit.dir/test_watchdog.c.o.d"
+  "sentry_test_unit"
+  "sentry_test_unit.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C CXX)
+  include(CMakeFiles/sentry_test_unit.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,10 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/tests/unit
+# Build directory: /root/repo/_tsan_build/tests/unit
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(sentry_test_unit "/root/repo/_tsan_build/tests/unit/sentry_test_unit")
+set_tests_properties(sentry_test_unit PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/unit/CMakeLists.txt;103;add_test;/root/repo/tests/unit/CMakeLists.txt;0;")
+add_test(sentry_fuzz_json "/root/repo/_tsan_build/tests/unit/sentry_fuzz_json")
+set_tests_properties(sentry_fuzz_json PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/unit/CMakeLists.txt;129;add_test;/root/repo/tests/unit/CMakeLists.txt;0;")
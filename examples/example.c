@@ -192,6 +192,14 @@ main(int argc, char **argv)
             options, sentry_transport_new(print_envelope));
     }
 
+    if (has_arg(argc, argv, "concurrent-requests")) {
+        sentry_options_set_transport_max_concurrent_requests(options, 4);
+    }
+
+    if (has_arg(argc, argv, "transport-warmup")) {
+        sentry_options_set_transport_warmup(options, 1);
+    }
+
     if (has_arg(argc, argv, "capture-transaction")) {
         sentry_options_set_traces_sample_rate(options, 1.0);
     }
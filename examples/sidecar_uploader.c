@@ -0,0 +1,78 @@
+/*
+An uploader process for the sidecar transport, which sends the envelopes that
+the applications on this host wrote into the rings in a shared directory.
+
+Run via:
+
+sentry_sidecar_uploader DIRECTORY [DSN]
+
+The DSN defaults to the `SENTRY_DSN` environment variable. The applications
+use `sentry_new_sidecar_transport(DIRECTORY, 0)` as their transport.
+*/
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "sentry.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <synchapi.h>
+#    define sleep_ms(MILLISECONDS) Sleep(MILLISECONDS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MILLISECONDS) usleep((MILLISECONDS)*1000)
+#endif
+
+#define DRAIN_INTERVAL_MS 100
+
+static volatile sig_atomic_t g_running = 1;
+
+static void
+stop_running(int signum)
+{
+    (void)signum;
+    g_running = 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s DIRECTORY [DSN]\n", argv[0]);
+        return 1;
+    }
+    const char *directory = argv[1];
+
+    sentry_options_t *options = sentry_options_new();
+    if (argc > 2) {
+        sentry_options_set_dsn(options, argv[2]);
+    }
+    sentry_options_set_database_path(options, ".sentry-sidecar-uploader");
+    // the uploader only sends what the applications captured
+    sentry_options_set_auto_session_tracking(options, 0);
+    sentry_options_set_backend(options, NULL);
+    if (sentry_init(options) != 0) {
+        fprintf(stderr, "failed to initialize the SDK\n");
+        return 1;
+    }
+
+    signal(SIGINT, stop_running);
+    signal(SIGTERM, stop_running);
+    while (g_running) {
+        if (sentry_sidecar_drain(directory) < 0) {
+            fprintf(stderr, "failed to read \"%s\"\n", directory);
+        }
+        sleep_ms(DRAIN_INTERVAL_MS);
+    }
+    // pick up what was written in the meantime
+    sentry_sidecar_drain(directory);
+
+    sentry_close();
+    return 0;
+}
@@ -97,7 +97,8 @@ extern "C" {
 
 /**
  * The library internally uses the system malloc and free functions to manage
- * memory.  It does not use realloc.  The reason for this is that on unix
+ * memory, unless a custom allocator is set with `sentry_set_allocator`.  It
+ * does not use realloc.  The reason for this is that on unix
  * platforms we fall back to a simplistic page allocator once we have
  * encountered a SIGSEGV or other terminating signal as malloc is no longer
  * safe to use.  Since we cannot portably reallocate allocations made on the
@@ -116,6 +117,39 @@ SENTRY_API void *sentry_malloc(size_t size);
  */
 SENTRY_API void sentry_free(void *ptr);
 
+/**
+ * Type of the callback for allocating memory with a custom allocator.
+ */
+typedef void *(*sentry_malloc_function_t)(size_t size, void *user_data);
+
+/**
+ * Type of the callback for releasing memory allocated with
+ * `sentry_malloc_function_t`.
+ */
+typedef void (*sentry_free_function_t)(void *ptr, void *user_data);
+
+/**
+ * Makes the library allocate all of its memory with `malloc_func` and release
+ * it with `free_func`, for example to keep it in its own arena of a custom
+ * allocator. Both receive `user_data` as their last argument. Passing `NULL`
+ * for either function restores the system allocator.
+ *
+ * Since memory can only be released with the allocator it was allocated
+ * with, this must be called before any other function of the library, and
+ * must not be called again while any memory of the library is still
+ * allocated. Once a terminating signal has been encountered, the page
+ * allocator is used instead, as described above.
+ *
+ * The functions are called from all the threads of the library, and need to
+ * be thread-safe. `sentry_init` already starts a thread that loads the list
+ * of modules in the background, which allocates concurrently with the caller.
+ *
+ * Backends that are implemented in C++ (crashpad and breakpad) keep using
+ * the global allocator of the process for their own state.
+ */
+SENTRY_API void sentry_set_allocator(sentry_malloc_function_t malloc_func,
+    sentry_free_function_t free_func, void *user_data);
+
 /**
  * Legacy function.  Alias for `sentry_free`.
  */
@@ -134,6 +168,8 @@ typedef enum {
     SENTRY_VALUE_TYPE_STRING,
     SENTRY_VALUE_TYPE_LIST,
     SENTRY_VALUE_TYPE_OBJECT,
+    SENTRY_VALUE_TYPE_INT64,
+    SENTRY_VALUE_TYPE_UINT64,
 } sentry_value_type_t;
 
 /**
@@ -193,6 +229,16 @@ SENTRY_API sentry_value_t sentry_value_new_null(void);
  */
 SENTRY_API sentry_value_t sentry_value_new_int32(int32_t value);
 
+/**
+ * Creates a new 64-bit signed integer value.
+ */
+SENTRY_API sentry_value_t sentry_value_new_int64(int64_t value);
+
+/**
+ * Creates a new 64-bit unsigned integer value.
+ */
+SENTRY_API sentry_value_t sentry_value_new_uint64(uint64_t value);
+
 /**
  * Creates a new double value.
  */
@@ -208,6 +254,13 @@ SENTRY_API sentry_value_t sentry_value_new_bool(int value);
  */
 SENTRY_API sentry_value_t sentry_value_new_string(const char *value);
 
+/**
+ * Creates a new string from the first `value_len` bytes of `value`, which
+ * does not need to be null terminated.
+ */
+SENTRY_API sentry_value_t sentry_value_new_string_n(
+    const char *value, size_t value_len);
+
 /**
  * Creates a new list value.
  */
@@ -218,6 +271,34 @@ SENTRY_API sentry_value_t sentry_value_new_list(void);
  */
 SENTRY_API sentry_value_t sentry_value_new_object(void);
 
+/**
+ * A key/value pair, as used by `sentry_value_new_object_from_pairs`.
+ */
+typedef struct sentry_value_pair_s {
+    const char *key;
+    sentry_value_t value;
+} sentry_value_pair_t;
+
+/**
+ * Creates a new object from an array of `len` key/value `pairs`, allocating
+ * exactly the space needed for all of them at once.
+ *
+ * This moves the ownership of all the values into the object. If a key is
+ * given more than once, the last value wins. Pairs with a `NULL` key are
+ * skipped, and their value is released.
+ */
+SENTRY_API sentry_value_t sentry_value_new_object_from_pairs(
+    const sentry_value_pair_t *pairs, size_t len);
+
+/**
+ * Creates a new list from an array of `len` `values`, allocating exactly the
+ * space needed for all of them at once.
+ *
+ * This moves the ownership of all the values into the list.
+ */
+SENTRY_API sentry_value_t sentry_value_new_list_from_values(
+    const sentry_value_t *values, size_t len);
+
 /**
  * Returns the type of the value passed.
  */
@@ -232,11 +313,25 @@ SENTRY_API sentry_value_type_t sentry_value_get_type(sentry_value_t value);
 SENTRY_API int sentry_value_set_by_key(
     sentry_value_t value, const char *k, sentry_value_t v);
 
+/**
+ * Same as `sentry_value_set_by_key`, but with a key of `k_len` bytes, which
+ * does not need to be null terminated.
+ */
+SENTRY_API int sentry_value_set_by_key_n(
+    sentry_value_t value, const char *k, size_t k_len, sentry_value_t v);
+
 /**
  * This removes a value from the map by key.
  */
 SENTRY_API int sentry_value_remove_by_key(sentry_value_t value, const char *k);
 
+/**
+ * Same as `sentry_value_remove_by_key`, but with a key of `k_len` bytes,
+ * which does not need to be null terminated.
+ */
+SENTRY_API int sentry_value_remove_by_key_n(
+    sentry_value_t value, const char *k, size_t k_len);
+
 /**
  * Appends a value to a list.
  *
@@ -269,6 +364,13 @@ SENTRY_API int sentry_value_remove_by_index(sentry_value_t value, size_t index);
 SENTRY_API sentry_value_t sentry_value_get_by_key(
     sentry_value_t value, const char *k);
 
+/**
+ * Same as `sentry_value_get_by_key`, but with a key of `k_len` bytes, which
+ * does not need to be null terminated.
+ */
+SENTRY_API sentry_value_t sentry_value_get_by_key_n(
+    sentry_value_t value, const char *k, size_t k_len);
+
 /**
  * Looks up a value in a map by key.  If missing a null value is returned.
  * The returned value is owned.
@@ -279,6 +381,13 @@ SENTRY_API sentry_value_t sentry_value_get_by_key(
 SENTRY_API sentry_value_t sentry_value_get_by_key_owned(
     sentry_value_t value, const char *k);
 
+/**
+ * Same as `sentry_value_get_by_key_owned`, but with a key of `k_len` bytes,
+ * which does not need to be null terminated.
+ */
+SENTRY_API sentry_value_t sentry_value_get_by_key_owned_n(
+    sentry_value_t value, const char *k, size_t k_len);
+
 /**
  * Looks up a value in a list by index.  If missing a null value is returned.
  * The returned value is borrowed.
@@ -308,6 +417,20 @@ SENTRY_API size_t sentry_value_get_length(sentry_value_t value);
  */
 SENTRY_API int32_t sentry_value_as_int32(sentry_value_t value);
 
+/**
+ * Converts a value into a 64bit signed integer.
+ *
+ * This works for all the integer types, and returns 0 for any other value.
+ */
+SENTRY_API int64_t sentry_value_as_int64(sentry_value_t value);
+
+/**
+ * Converts a value into a 64bit unsigned integer.
+ *
+ * This works for all the integer types, and returns 0 for any other value.
+ */
+SENTRY_API uint64_t sentry_value_as_uint64(sentry_value_t value);
+
 /**
  * Converts a value into a double value.
  */
@@ -720,6 +843,40 @@ SENTRY_API void sentry_transport_free(sentry_transport_t *transport);
 SENTRY_API sentry_transport_t *sentry_new_function_transport(
     void (*func)(const sentry_envelope_t *envelope, void *data), void *data);
 
+/**
+ * Creates a new transport which does no network I/O itself, but hands the
+ * envelopes over to an uploader process on the same host.
+ *
+ * Every process that uses this transport writes its serialized envelopes into
+ * a ring of `capacity` bytes, which lives in a file in `directory` that is
+ * shared with the uploader. A `capacity` of `0` uses a ring of 8 MiB. Once the
+ * ring is full, new envelopes are dropped until the uploader catches up. The
+ * directory is best placed on a memory-backed filesystem, like `/dev/shm`.
+ *
+ * Envelopes are handed over as soon as they are written into the ring, so
+ * `sentry_flush` returns immediately. Those that the uploader did not send yet
+ * stay in the ring when the process exits or crashes, and are sent afterwards.
+ * With `sentry_options_set_reinit_after_fork`, a forked child writes into a
+ * ring of its own.
+ */
+SENTRY_EXPERIMENTAL_API sentry_transport_t *sentry_new_sidecar_transport(
+    const char *directory, size_t capacity);
+
+/**
+ * Sends the envelopes that the sidecar transports of other processes wrote
+ * into the rings in `directory`, through the transport of this process.
+ *
+ * This is the main loop of an uploader process, which initializes the SDK
+ * with the DSN that the envelopes belong to and the default http transport,
+ * and keeps calling this function, for example every 100 milliseconds. The
+ * http transport then sends the envelopes of all the processes on the host.
+ * The rings of processes which exited are removed once they are sent.
+ *
+ * Returns the number of envelopes that were passed on to the transport, or
+ * `-1` if the SDK is not initialized or `directory` cannot be read.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_sidecar_drain(const char *directory);
+
 /**
  * This represents an interface for user-defined backends.
  *
@@ -781,12 +938,10 @@ SENTRY_API void sentry_options_set_transport(
  * the documentation on SEH (structured exception handling) for more information
  * https://docs.microsoft.com/en-us/windows/win32/debug/structured-exception-handling
  *
- * Up to version 0.4.18 the `before_send` callback wasn't invoked in case the
- * event sampling discarded an event. In the current implementation the
- * `before_send` callback is invoked even if the event sampling discards the
- * event, following the cross-SDK session filter order:
- *
- * https://develop.sentry.dev/sdk/sessions/#filter-order
+ * The `before_send` callback is not invoked for events that are discarded by
+ * the event sampling, the rate limits or the client side throttling, since
+ * those are decided before doing any work on the event. Discarded errors
+ * still count towards the health of the current session.
  *
  * On Windows the crashpad backend can capture fast-fail crashes which by-pass
  * SEH. Since the `before_send` is called by a local exception-handler, it will
@@ -862,6 +1017,33 @@ typedef sentry_value_t (*sentry_crash_function_t)(
 SENTRY_API void sentry_options_set_on_crash(
     sentry_options_t *opts, sentry_crash_function_t func, void *data);
 
+/**
+ * Type of the connectivity probe callback.
+ *
+ * The callback returns non-zero if the device can reach the network, for
+ * example using the connectivity APIs of the platform, and zero otherwise.
+ * It is called from a background thread, and should not block for long.
+ */
+typedef int (*sentry_connectivity_probe_function_t)(void *closure);
+
+/**
+ * Sets a callback that switches the SDK between offline and online, see
+ * `sentry_set_offline`.
+ *
+ * The callback is called on startup, and then once per interval set via
+ * `sentry_options_set_connectivity_probe_interval`.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_connectivity_probe(
+    sentry_options_t *opts, sentry_connectivity_probe_function_t func,
+    void *data);
+
+/**
+ * Sets how often the connectivity probe is called, in milliseconds. This
+ * defaults to 30000 ms.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_connectivity_probe_interval(
+    sentry_options_t *opts, uint64_t interval_ms);
+
 /**
  * Sets the DSN.
  */
@@ -872,23 +1054,30 @@ SENTRY_API void sentry_options_set_dsn(sentry_options_t *opts, const char *dsn);
  */
 SENTRY_API const char *sentry_options_get_dsn(const sentry_options_t *opts);
 
+/**
+ * Adds a DSN that receives a copy of every envelope sent to the DSN, such as
+ * a regional mirror of a central project. Invalid DSNs are ignored.
+ *
+ * Every envelope is serialized and compressed only once, and the same bytes
+ * are then sent to every DSN. Each of them has a send queue and rate limits
+ * of its own, so that a slow or rate limited DSN does not hold up the others.
+ * Envelopes to the mirrors are not retried and not written to disk on a
+ * crash, those are only sent to the DSN.
+ *
+ * This is only supported by the default HTTP transports, custom transports
+ * only send to the DSN.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_add_mirror_dsn(
+    sentry_options_t *opts, const char *dsn);
+
 /**
  * Sets the sample rate, which should be a double between `0.0` and `1.0`.
  * Sentry will randomly discard any event that is captured using
  * `sentry_capture_event` when a sample rate < 1 is set.
  *
- * The sampling happens at the end of the event processing according to the
- * following order:
- *
- * https://develop.sentry.dev/sdk/sessions/#filter-order
- *
- * Only items 3. to 6. are currently applicable to sentry-native. This means
- * each processing step is executed even if the sampling discards the event
- * before sending it to the backend. This is particularly relevant to users of
- * the `before_send` callback.
- *
- * The above is in contrast to versions up to 0.4.18 where the sampling happened
- * at the beginning of the processing/filter sequence.
+ * The sampling happens right at the start of `sentry_capture_event`, so
+ * discarded events skip all the processing, including the `before_send`
+ * callback, and a sample rate of `0.01` only costs about 1% of the work.
  */
 SENTRY_API void sentry_options_set_sample_rate(
     sentry_options_t *opts, double sample_rate);
@@ -898,6 +1087,163 @@ SENTRY_API void sentry_options_set_sample_rate(
  */
 SENTRY_API double sentry_options_get_sample_rate(const sentry_options_t *opts);
 
+/**
+ * Sets the maximum number of events that are captured per second.
+ *
+ * Events beyond that are discarded in `sentry_capture_event`, before they are
+ * processed, even before the `before_send` callback and sampling. Bursts of up
+ * to this many events are allowed, as long as the average stays below it.
+ * The default of 0 means that there is no limit.
+ */
+SENTRY_API void sentry_options_set_max_events_per_second(
+    sentry_options_t *opts, size_t max_events);
+
+/**
+ * Gets the maximum number of events that are captured per second.
+ */
+SENTRY_API size_t sentry_options_get_max_events_per_second(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the maximum number of events of the given `level` that are sent per
+ * second.
+ *
+ * Unlike `sentry_options_set_max_events_per_second`, events beyond that are
+ * not cut off, but the sample rate of the `level` is lowered dynamically, so
+ * that about `max_events` of them are sent per second. The rate of incoming
+ * events is estimated over a sliding window of one second. The effective
+ * sample rate, including the one of `sentry_options_set_sample_rate`, is
+ * written to the `sample_rate` of the events that are kept, so that their
+ * number can be extrapolated. Events without a `level` count as
+ * `SENTRY_LEVEL_ERROR`.
+ *
+ * The default of 0 means that there is no limit, so that for example only
+ * setting a limit for `SENTRY_LEVEL_ERROR` and `SENTRY_LEVEL_WARNING` keeps
+ * sending all of the fatal events.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_max_events_per_second_for_level(
+    sentry_options_t *opts, sentry_level_t level, size_t max_events);
+
+/**
+ * Gets the maximum number of events of the given `level` that are sent per
+ * second.
+ */
+SENTRY_EXPERIMENTAL_API size_t
+sentry_options_get_max_events_per_second_for_level(
+    const sentry_options_t *opts, sentry_level_t level);
+
+/**
+ * Enables or disables capturing events asynchronously.
+ *
+ * By default, `sentry_capture_event` prepares the event on the calling thread,
+ * which includes attaching the modules list, symbolizing stack traces when
+ * `sentry_options_set_symbolize_stacktraces` is enabled, invoking the
+ * `before_send` callback, sampling and creating the envelope. When this is
+ * enabled, the calling thread only merges a snapshot of the scope into the
+ * event, and the rest happens on a background thread, which means that the
+ * `before_send` callback is invoked on that thread as well.
+ *
+ * `sentry_capture_event` then returns the id of the event even if it is later
+ * discarded by the `before_send` callback. Events that are
+ * still being prepared are sent by `sentry_flush` and `sentry_close`.
+ */
+SENTRY_API void sentry_options_set_async_capture(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if events are captured asynchronously.
+ */
+SENTRY_API int sentry_options_get_async_capture(const sentry_options_t *opts);
+
+/**
+ * Enables or disables reinitializing the SDK in child processes after `fork`.
+ *
+ * This is meant for prefork servers, which call `sentry_init` once in the
+ * master process and then fork their workers. When this is enabled, every
+ * child process gets a run directory and a session of its own, and a freshly
+ * started transport, instead of the ones that belong to the parent, without
+ * going through `sentry_close` and `sentry_init` again. The options, the scope
+ * and the cached list of modules are kept. Envelopes that the parent had not
+ * sent yet are left to the parent.
+ *
+ * To that end, the SDK's background threads are stopped right before each
+ * `fork`, and started again in both processes afterwards. Custom transports
+ * are kept as they are, and only the crash handlers of the `inproc` and
+ * `breakpad` backends keep working in the child.
+ *
+ * This has a cost for every `fork` of the process, also for those that are
+ * immediately followed by `exec`, like the ones of `system` and `popen` on C
+ * libraries that implement them with `fork`: the forking thread waits until
+ * all the background threads finished their current task and exited, and
+ * both processes start them again. Do not enable this in processes that fork
+ * frequently without needing the SDK in the child.
+ *
+ * This uses `pthread_atfork`, so it only applies to `fork` itself, not to
+ * `vfork` or `posix_spawn`, and it has no effect on Windows. It defaults to
+ * off.
+ */
+SENTRY_API void sentry_options_set_reinit_after_fork(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if the SDK is reinitialized in child processes after `fork`.
+ */
+SENTRY_API int sentry_options_get_reinit_after_fork(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the window in milliseconds within which duplicate events are
+ * suppressed.
+ *
+ * Events with the same exceptions, innermost frames, message, fingerprint,
+ * level and logger as an event that was captured within the window are
+ * discarded in `sentry_capture_event`, before they are processed. This keeps
+ * an error that is thrown in a tight loop from flooding the transport. The
+ * default of 0 disables this.
+ */
+SENTRY_API void sentry_options_set_dedup_window(
+    sentry_options_t *opts, uint64_t window_ms);
+
+/**
+ * Gets the window within which duplicate events are suppressed.
+ */
+SENTRY_API uint64_t sentry_options_get_dedup_window(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables sending a summary of the suppressed duplicates.
+ *
+ * When enabled, the latest duplicate of an event is sent once its window
+ * ends, or on `sentry_close`, with the number of suppressed duplicates as the
+ * `duplicates_suppressed` extra. Otherwise, the duplicates are just discarded.
+ * This is enabled by default.
+ */
+SENTRY_API void sentry_options_set_dedup_summary(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if a summary of the suppressed duplicates is sent.
+ */
+SENTRY_API int sentry_options_get_dedup_summary(const sentry_options_t *opts);
+
+/**
+ * Sets the maximum size of a serialized event in bytes.
+ *
+ * Larger events are trimmed while they are serialized: first the oldest
+ * breadcrumbs are left out, then long strings are cut, and then only the
+ * outermost and innermost frames of deep stack traces are kept, until the
+ * event fits. The default is 1 MiB, which is what the server accepts, and 0
+ * means no limit.
+ */
+SENTRY_API void sentry_options_set_max_event_size(
+    sentry_options_t *opts, size_t bytes);
+
+/**
+ * Gets the maximum size of a serialized event.
+ */
+SENTRY_API size_t sentry_options_get_max_event_size(
+    const sentry_options_t *opts);
+
 /**
  * Sets the release.
  */
@@ -972,170 +1318,715 @@ SENTRY_API const char *sentry_options_get_transport_thread_name(
     const sentry_options_t *opts);
 
 /**
- * Enables or disables debug printing mode.
+ * Sets the maximum number of envelopes the http transport sends concurrently.
+ *
+ * Concurrent requests to the same host are multiplexed over a single HTTP/2
+ * connection when possible. Envelopes might reach the server out of order,
+ * unless this is set to 1, which is the default. The winhttp transport sends
+ * requests asynchronously when this is larger than 1.
  */
-SENTRY_API void sentry_options_set_debug(sentry_options_t *opts, int debug);
+SENTRY_API void sentry_options_set_transport_max_concurrent_requests(
+    sentry_options_t *opts, size_t max_requests);
 
 /**
- * Returns the current value of the debug flag.
+ * Returns the maximum number of concurrent http transport requests.
  */
-SENTRY_API int sentry_options_get_debug(const sentry_options_t *opts);
+SENTRY_API size_t sentry_options_get_transport_max_concurrent_requests(
+    const sentry_options_t *opts);
 
 /**
- * Sets the number of breadcrumbs being tracked and attached to events.
+ * Sets the maximum number of envelopes in the send queue of the http
+ * transport. `0` means unlimited.
  *
- * Defaults to 100.
+ * When the queue is full, for example because the server can not be reached,
+ * the oldest envelopes are dropped, starting with transactions, then sessions
+ * and lastly events. Events are also sent ahead of queued sessions and
+ * transactions.
+ *
+ * Defaults to 1000.
  */
-SENTRY_API void sentry_options_set_max_breadcrumbs(
-    sentry_options_t *opts, size_t max_breadcrumbs);
+SENTRY_API void sentry_options_set_transport_max_queue_size(
+    sentry_options_t *opts, size_t max_envelopes);
 
 /**
- * Gets the number of breadcrumbs being tracked and attached to events.
+ * Returns the maximum number of envelopes in the http transport send queue.
  */
-SENTRY_API size_t sentry_options_get_max_breadcrumbs(
+SENTRY_API size_t sentry_options_get_transport_max_queue_size(
     const sentry_options_t *opts);
 
 /**
- * Type of the callback for logger function.
+ * Sets the maximum number of bytes the envelopes in the send queue of the http
+ * transport can occupy in memory, with the same drop policy as
+ * `sentry_options_set_transport_max_queue_size`. `0` means unlimited, which
+ * is the default.
  */
-typedef void (*sentry_logger_function_t)(
-    sentry_level_t level, const char *message, va_list args, void *userdata);
+SENTRY_API void sentry_options_set_transport_max_queue_bytes(
+    sentry_options_t *opts, size_t max_bytes);
 
 /**
- * Sets the sentry-native logger function.
- *
- * Used for logging debug events when the `debug` option is set to true.
+ * Returns the maximum number of bytes in the http transport send queue.
  */
-SENTRY_API void sentry_options_set_logger(
-    sentry_options_t *opts, sentry_logger_function_t func, void *userdata);
+SENTRY_API size_t sentry_options_get_transport_max_queue_bytes(
+    const sentry_options_t *opts);
 
 /**
- * Enables or disables automatic session tracking.
+ * Enables or disables connecting to the DSN host as soon as the http
+ * transport starts.
  *
- * Automatic session tracking is enabled by default and is equivalent to calling
- * `sentry_start_session` after startup.
- * There can only be one running session, and the current session will always be
- * closed implicitly by `sentry_close`, when starting a new session with
- * `sentry_start_session`, or manually by calling `sentry_end_session`.
+ * This resolves the host and performs the TLS handshake ahead of time, so that
+ * the first envelope can be sent with less latency. This is disabled by
+ * default, and currently only supported by the curl transport.
  */
-SENTRY_API void sentry_options_set_auto_session_tracking(
-    sentry_options_t *opts, int val);
+SENTRY_API void sentry_options_set_transport_warmup(
+    sentry_options_t *opts, int warmup);
 
 /**
- * Returns true if automatic session tracking is enabled.
+ * Returns whether the http transport connects to the DSN host on startup.
  */
-SENTRY_API int sentry_options_get_auto_session_tracking(
+SENTRY_API int sentry_options_get_transport_warmup(
     const sentry_options_t *opts);
 
 /**
- * Enables or disables user consent requirements for uploads.
- *
- * This disables uploads until the user has given the consent to the SDK.
- * Consent itself is given with `sentry_user_consent_give` and
- * `sentry_user_consent_revoke`.
+ * Sets the time in milliseconds the http transport waits for a connection to
+ * be established, including the DNS lookup and TLS handshake, before the
+ * request fails. `0` means that the transport uses the default of its HTTP
+ * client. Defaults to 10000.
  */
-SENTRY_API void sentry_options_set_require_user_consent(
-    sentry_options_t *opts, int val);
+SENTRY_API void sentry_options_set_transport_connect_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms);
 
 /**
- * Returns true if user consent is required.
+ * Returns the connect timeout of the http transport.
  */
-SENTRY_API int sentry_options_get_require_user_consent(
+SENTRY_API uint64_t sentry_options_get_transport_connect_timeout(
     const sentry_options_t *opts);
 
 /**
- * Enables or disables on-device symbolication of stack traces.
- *
- * This feature can have a performance impact, and is enabled by default on
- * Android. It is usually only needed when it is not possible to provide debug
- * information files for system libraries which are needed for serverside
- * symbolication.
+ * Sets the time in milliseconds an http transport request may take as a
+ * whole, including connecting, before it is aborted. `0` means no limit,
+ * which is the default, since large envelopes may take a while to upload on
+ * slow networks. See `sentry_options_set_transport_low_speed_limit` for
+ * aborting stalled requests instead. Only supported by the curl transport.
  */
-SENTRY_API void sentry_options_set_symbolize_stacktraces(
-    sentry_options_t *opts, int val);
+SENTRY_API void sentry_options_set_transport_request_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms);
 
 /**
- * Returns true if on-device symbolication of stack traces is enabled.
+ * Returns the request timeout of the http transport.
  */
-SENTRY_API int sentry_options_get_symbolize_stacktraces(
+SENTRY_API uint64_t sentry_options_get_transport_request_timeout(
     const sentry_options_t *opts);
 
 /**
- * Adds a new attachment to be sent along.
+ * Aborts any http transport request that transfers less than
+ * `bytes_per_second` for `duration_ms` milliseconds, which catches requests
+ * that hang without taking the worker down for as long as the connection is
+ * kept open. A `duration_ms` of `0` disables this. Defaults to 1 byte per
+ * second over 30000 milliseconds.
  *
- * `path` is assumed to be in platform-specific filesystem path encoding.
- * API Users on windows are encouraged to use `sentry_options_add_attachmentw`
- * instead.
+ * The winhttp transport only supports the duration, as its timeout for
+ * sending and receiving data.
  */
-SENTRY_API void sentry_options_add_attachment(
-    sentry_options_t *opts, const char *path);
+SENTRY_API void sentry_options_set_transport_low_speed_limit(
+    sentry_options_t *opts, size_t bytes_per_second, uint64_t duration_ms);
 
 /**
- * Sets the path to the crashpad handler if the crashpad backend is used.
- *
- * The path defaults to the `crashpad_handler`/`crashpad_handler.exe`
- * executable, depending on platform, which is expected to be present in the
- * same directory as the app executable.
- *
- * It is recommended that library users set an explicit handler path, depending
- * on the directory/executable structure of their app.
- *
- * `path` is assumed to be in platform-specific filesystem path encoding.
- * API Users on windows are encouraged to use `sentry_options_set_handler_pathw`
- * instead.
+ * Returns the speed in bytes per second below which http transport requests
+ * are aborted.
  */
-SENTRY_API void sentry_options_set_handler_path(
-    sentry_options_t *opts, const char *path);
+SENTRY_API size_t sentry_options_get_transport_low_speed_limit(
+    const sentry_options_t *opts);
 
 /**
- * Sets the path to the Sentry Database Directory.
- *
- * Sentry will use this path to persist user consent, sessions, and other
- * artifacts in case of a crash. This will also be used by the crashpad backend
- * if it is configured.
- *
- * The directory is used for "cached" data, which needs to persist across
- * application restarts to ensure proper flagging of release-health sessions,
- * but might otherwise be safely purged regularly.
- *
- * It is roughly equivalent to the type of `AppData/Local` on Windows and
- * `XDG_CACHE_HOME` on Linux, and equivalent runtime directories on other
- * platforms.
- *
- * It is recommended that users set an explicit absolute path, depending
- * on their apps runtime directory. The path will be created if it does not
- * exist, and will be resolved to an absolute path inside of `sentry_init`. The
- * directory should not be shared with other application data/configuration, as
- * sentry-native will enumerate and possibly delete files in that directory. An
- * example might be `$XDG_CACHE_HOME/your-app/sentry`
- *
- * If no explicit path it set, sentry-native will default to `.sentry-native` in
- * the current working directory, with no specific platform-specific handling.
- *
- * `path` is assumed to be in platform-specific filesystem path encoding.
- * API Users on windows are encouraged to use
- * `sentry_options_set_database_pathw` instead.
+ * Returns the time in milliseconds after which http transport requests below
+ * the low speed limit are aborted.
  */
-SENTRY_API void sentry_options_set_database_path(
-    sentry_options_t *opts, const char *path);
+SENTRY_API uint64_t sentry_options_get_transport_low_speed_time(
+    const sentry_options_t *opts);
 
-#ifdef SENTRY_PLATFORM_WINDOWS
 /**
- * Wide char version of `sentry_options_add_attachment`.
+ * Enables or disables `TCP_NODELAY` for the connections of the http
+ * transport, which sends small requests right away instead of batching them
+ * up with Nagle's algorithm. Enabled by default, and only supported by the
+ * curl transport.
  */
-SENTRY_API void sentry_options_add_attachmentw(
-    sentry_options_t *opts, const wchar_t *path);
+SENTRY_API void sentry_options_set_transport_tcp_nodelay(
+    sentry_options_t *opts, int val);
 
 /**
- * Wide char version of `sentry_options_set_handler_path`.
+ * Returns whether the http transport connections use `TCP_NODELAY`.
  */
-SENTRY_API void sentry_options_set_handler_pathw(
-    sentry_options_t *opts, const wchar_t *path);
+SENTRY_API int sentry_options_get_transport_tcp_nodelay(
+    const sentry_options_t *opts);
 
 /**
- * Wide char version of `sentry_options_set_database_path`.
+ * Enables or disables TCP keepalive probes for the connections of the http
+ * transport, which keeps idle connections from being dropped by firewalls and
+ * NATs, and detects dead connections. Enabled by default, and only supported
+ * by the curl transport.
  */
-SENTRY_API void sentry_options_set_database_pathw(
+SENTRY_API void sentry_options_set_transport_tcp_keepalive(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns whether the http transport connections use TCP keepalive.
+ */
+SENTRY_API int sentry_options_get_transport_tcp_keepalive(
+    const sentry_options_t *opts);
+
+/**
+ * The IP versions the http transport connects with.
+ */
+typedef enum {
+    // any of the addresses the host resolves to, which is the default
+    SENTRY_IP_RESOLVE_ANY = 0,
+    // only IPv4 addresses
+    SENTRY_IP_RESOLVE_V4 = 1,
+    // only IPv6 addresses
+    SENTRY_IP_RESOLVE_V6 = 2,
+} sentry_ip_resolve_t;
+
+/**
+ * Sets the IP versions the http transport connects with. Only supported by
+ * the curl transport.
+ */
+SENTRY_API void sentry_options_set_transport_ip_resolve(
+    sentry_options_t *opts, sentry_ip_resolve_t ip_resolve);
+
+/**
+ * Returns the IP versions the http transport connects with.
+ */
+SENTRY_API sentry_ip_resolve_t sentry_options_get_transport_ip_resolve(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the time in milliseconds the http transport gives an IPv6 connection
+ * attempt a head start, before it tries IPv4 in parallel ("happy eyeballs"),
+ * when the host resolves to both. `0` means that the default of the HTTP
+ * client is used, which is the default. Only supported by the curl transport.
+ */
+SENTRY_API void sentry_options_set_transport_happy_eyeballs_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms);
+
+/**
+ * Returns the happy eyeballs timeout of the http transport.
+ */
+SENTRY_API uint64_t sentry_options_get_transport_happy_eyeballs_timeout(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables debug printing mode.
+ */
+SENTRY_API void sentry_options_set_debug(sentry_options_t *opts, int debug);
+
+/**
+ * Returns the current value of the debug flag.
+ */
+SENTRY_API int sentry_options_get_debug(const sentry_options_t *opts);
+
+/**
+ * Sets the number of breadcrumbs being tracked and attached to events.
+ *
+ * Defaults to 100.
+ */
+SENTRY_API void sentry_options_set_max_breadcrumbs(
+    sentry_options_t *opts, size_t max_breadcrumbs);
+
+/**
+ * Gets the number of breadcrumbs being tracked and attached to events.
+ */
+SENTRY_API size_t sentry_options_get_max_breadcrumbs(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables buffering of the breadcrumbs of the Qt integration.
+ *
+ * When enabled, the breadcrumbs for Qt log messages are put into a bounded
+ * lock-free queue on the thread that logs them, and are added to the scope in
+ * batches by a background thread. This keeps the scope lock and the backend
+ * breadcrumb hooks off threads with chatty logging, like the UI thread.
+ * Buffered breadcrumbs are added before an event is captured, on
+ * `sentry_flush` and `sentry_close`, and when handling a crash. While the
+ * queue is full, it is drained on the logging thread.
+ *
+ * This only has an effect when the SDK is built with `SENTRY_INTEGRATION_QT`,
+ * and is disabled by default.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_qt_buffered_breadcrumbs(
+    sentry_options_t *opts, int buffered);
+
+/**
+ * Returns whether the breadcrumbs of the Qt integration are buffered.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_options_get_qt_buffered_breadcrumbs(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the size of the memory that is reserved for handling a crash.
+ *
+ * On Unix platforms, the crash handlers of the backends can not use `malloc`,
+ * and get their memory from a dedicated allocator instead. This much memory is
+ * set aside for it when `sentry_init` starts the backend, so that the handler
+ * does not need to map any more memory while the process is crashing, which
+ * could take long or fail under memory pressure. A value of 0 disables the
+ * reserve. This has no effect on other platforms.
+ *
+ * Defaults to 256 KiB.
+ */
+SENTRY_API void sentry_options_set_crash_memory_reserve(
+    sentry_options_t *opts, size_t reserve_size);
+
+/**
+ * Gets the size of the memory that is reserved for handling a crash.
+ */
+SENTRY_API size_t sentry_options_get_crash_memory_reserve(
+    const sentry_options_t *opts);
+
+/**
+ * Type of the callback for logger function.
+ */
+typedef void (*sentry_logger_function_t)(
+    sentry_level_t level, const char *message, va_list args, void *userdata);
+
+/**
+ * Sets the sentry-native logger function.
+ *
+ * Used for logging debug events when the `debug` option is set to true.
+ *
+ * The function is called from all the threads of the library, and needs to be
+ * thread-safe. `sentry_init` already starts a thread that loads the list of
+ * modules in the background, which may log concurrently with the caller.
+ */
+SENTRY_API void sentry_options_set_logger(
+    sentry_options_t *opts, sentry_logger_function_t func, void *userdata);
+
+/**
+ * Enables or disables asynchronous logging.
+ *
+ * When enabled, the debug messages are formatted into a fixed-size ring buffer
+ * on the thread that emits them, and are passed to the logger function by a
+ * background thread. This keeps slow logger functions off the capture paths.
+ * Messages are truncated to 255 bytes, and new messages are dropped while the
+ * buffer is full, which is reported by a separate message once there is room
+ * again. `sentry_close` waits for the buffered messages to be logged.
+ *
+ * This is disabled by default.
+ */
+SENTRY_API void sentry_options_set_logger_async(
+    sentry_options_t *opts, int async);
+
+/**
+ * Returns whether logging is asynchronous.
+ */
+SENTRY_API int sentry_options_get_logger_async(const sentry_options_t *opts);
+
+/**
+ * Enables or disables automatic session tracking.
+ *
+ * Automatic session tracking is enabled by default and is equivalent to calling
+ * `sentry_start_session` after startup.
+ * There can only be one running session, and the current session will always be
+ * closed implicitly by `sentry_close`, when starting a new session with
+ * `sentry_start_session`, or manually by calling `sentry_end_session`.
+ */
+SENTRY_API void sentry_options_set_auto_session_tracking(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if automatic session tracking is enabled.
+ */
+SENTRY_API int sentry_options_get_auto_session_tracking(
+    const sentry_options_t *opts);
+
+/**
+ * Sets how often changes to the current session are written to disk, in
+ * milliseconds.
+ *
+ * Updates of the session, like its error count or user, are kept in memory,
+ * and are written to the run directory at most once per interval, so that a
+ * burst of errors does not rewrite the session for every single one of them.
+ * A crash or `sentry_close` still reports the session with all of its
+ * updates. Only a process that is killed without a chance to handle it loses
+ * the updates of up to one interval.
+ *
+ * The writes are done by the worker thread of the HTTP transport, and custom
+ * transports get a thread for it once the session first changes.
+ *
+ * A value of `0` writes every update right away. This defaults to 5000 ms.
+ */
+SENTRY_API void sentry_options_set_session_persist_interval(
+    sentry_options_t *opts, uint64_t interval_ms);
+
+/**
+ * Returns how often changes to the current session are written to disk.
+ */
+SENTRY_API uint64_t sentry_options_get_session_persist_interval(
+    const sentry_options_t *opts);
+
+/**
+ * How sessions are tracked.
+ */
+typedef enum {
+    /**
+     * There is a single session for the whole lifetime of the application,
+     * see `sentry_start_session`. This is the default.
+     */
+    SENTRY_SESSION_MODE_APPLICATION = 0,
+    /**
+     * Every request that a server handles is its own session, which is
+     * recorded via `sentry_record_request_session`. The recorded sessions
+     * are counted per minute in memory, and are sent periodically as session
+     * aggregates. Automatic session tracking does not start an application
+     * session in this mode.
+     */
+    SENTRY_SESSION_MODE_REQUEST = 1,
+} sentry_session_mode_t;
+
+/**
+ * Sets how sessions are tracked.
+ */
+SENTRY_API void sentry_options_set_session_mode(
+    sentry_options_t *opts, sentry_session_mode_t mode);
+
+/**
+ * Returns how sessions are tracked.
+ */
+SENTRY_API sentry_session_mode_t sentry_options_get_session_mode(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables user consent requirements for uploads.
+ *
+ * This disables uploads until the user has given the consent to the SDK.
+ * Consent itself is given with `sentry_user_consent_give` and
+ * `sentry_user_consent_revoke`.
+ */
+SENTRY_API void sentry_options_set_require_user_consent(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if user consent is required.
+ */
+SENTRY_API int sentry_options_get_require_user_consent(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables on-device symbolication of stack traces.
+ *
+ * This feature can have a performance impact, and is enabled by default on
+ * Android. It is usually only needed when it is not possible to provide debug
+ * information files for system libraries which are needed for serverside
+ * symbolication.
+ */
+SENTRY_API void sentry_options_set_symbolize_stacktraces(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if on-device symbolication of stack traces is enabled.
+ */
+SENTRY_API int sentry_options_get_symbolize_stacktraces(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables attaching only the referenced debug images to events.
+ *
+ * By default, events include the list of all the loaded modules as their
+ * `debug_meta.images`. When this is enabled, only the modules which contain an
+ * instruction address of any of the stack traces of the event are included,
+ * and events without any stack traces have no debug images at all. This can
+ * considerably reduce the size of events of applications which load a lot of
+ * libraries.
+ */
+SENTRY_API void sentry_options_set_only_referenced_images(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if only the referenced debug images are attached to events.
+ */
+SENTRY_API int sentry_options_get_only_referenced_images(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables precomputing the crash event of the `inproc` backend.
+ *
+ * When enabled, the scope, contexts and debug images that are part of a crash
+ * event are serialized ahead of time, whenever the scope changes or a
+ * breadcrumb is added, instead of from within the signal handler. The crash
+ * handler then only needs to capture and serialize the exception with its
+ * stack trace, which shortens the time spent in the handler.
+ *
+ * This makes adding breadcrumbs and changing the scope more expensive, and has
+ * no effect with other backends. Crashes are captured the regular way when an
+ * `on_crash` or `before_send` hook is set, or when the crashing thread has
+ * thread-local tags or extra set. Precomputed events always contain all the
+ * debug images, regardless of `sentry_options_set_only_referenced_images`.
+ */
+SENTRY_API void sentry_options_set_precomputed_crash_event(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if the crash event of the `inproc` backend is precomputed.
+ */
+SENTRY_API int sentry_options_get_precomputed_crash_event(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables capturing the stacks of all threads on a crash with the
+ * `inproc` backend.
+ *
+ * By default, crash events only contain the stack of the crashing thread. When
+ * enabled, the event additionally lists all the threads of the process along
+ * with their stacks, which helps with diagnosing crashes that involve several
+ * threads, such as deadlocks. Up to 64 threads are captured, and threads
+ * which do not respond within 20 milliseconds are listed without a stack.
+ *
+ * The other threads are interrupted with `SIGURG` for this, which only gets
+ * its own handler while the crash is handled. This is currently only
+ * supported on Linux and Android.
+ */
+SENTRY_API void sentry_options_set_capture_all_threads(
+    sentry_options_t *opts, int val);
+
+/**
+ * Returns true if the stacks of all threads are captured on a crash.
+ */
+SENTRY_API int sentry_options_get_capture_all_threads(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the timeout in milliseconds after which a missed heartbeat is reported
+ * as an app hang. Defaults to 0, which disables app hang detection.
+ *
+ * When enabled, a watchdog thread checks the heartbeats that the application
+ * sends via `sentry_app_heartbeat`. Once no heartbeat was sent for `timeout`
+ * milliseconds, an event is sent which reports the stall along with its
+ * duration so far, and on Linux and Android the stack of the thread that sent
+ * the last heartbeat. On the other platforms, the threads of the process can
+ * not be unwound yet, and the event has neither a stack nor a thread id. Each
+ * stall is only reported once.
+ *
+ * To unwind the stalled thread, it is interrupted with `SIGURG`, which gets
+ * its own handler for as long as the watchdog runs.
+ */
+SENTRY_API void sentry_options_set_app_hang_timeout(
+    sentry_options_t *opts, uint64_t timeout);
+
+/**
+ * Returns the timeout after which an app hang is reported, or 0 if app hangs
+ * are not detected.
+ */
+SENTRY_API uint64_t sentry_options_get_app_hang_timeout(
+    const sentry_options_t *opts);
+
+/**
+ * Adds a new attachment to be sent along.
+ *
+ * `path` is assumed to be in platform-specific filesystem path encoding.
+ * API Users on windows are encouraged to use `sentry_options_add_attachmentw`
+ * instead.
+ */
+SENTRY_API void sentry_options_add_attachment(
+    sentry_options_t *opts, const char *path);
+
+/**
+ * Flags for `sentry_options_add_attachment_with_flags`.
+ *
+ * `SENTRY_ATTACHMENT_COMPRESS` gzip-compresses the attachment when it is added
+ * to an envelope, and sends it with a `.gz` suffix and the `application/gzip`
+ * content type. This requires the SDK to be built with
+ * `SENTRY_TRANSPORT_COMPRESSION`, and is ignored otherwise, as it is for
+ * contents that do not compress.
+ *
+ * `SENTRY_ATTACHMENT_DEDUPLICATE` skips the attachment if the very same
+ * contents were already added to an envelope since `sentry_init`, which avoids
+ * uploading an unchanged config dump or log tail with every event.
+ *
+ * Both flags make the attachment be read when the event is captured, instead
+ * of when the envelope is sent.
+ */
+#define SENTRY_ATTACHMENT_COMPRESS 0x1
+#define SENTRY_ATTACHMENT_DEDUPLICATE 0x2
+
+/**
+ * Adds a new attachment to be sent along, like `sentry_options_add_attachment`,
+ * that is processed according to `flags`, see `SENTRY_ATTACHMENT_COMPRESS`.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_add_attachment_with_flags(
+    sentry_options_t *opts, const char *path, int flags);
+
+/**
+ * Sets the path to the crashpad handler if the crashpad backend is used.
+ *
+ * The path defaults to the `crashpad_handler`/`crashpad_handler.exe`
+ * executable, depending on platform, which is expected to be present in the
+ * same directory as the app executable.
+ *
+ * It is recommended that library users set an explicit handler path, depending
+ * on the directory/executable structure of their app.
+ *
+ * `path` is assumed to be in platform-specific filesystem path encoding.
+ * API Users on windows are encouraged to use `sentry_options_set_handler_pathw`
+ * instead.
+ */
+SENTRY_API void sentry_options_set_handler_path(
+    sentry_options_t *opts, const char *path);
+
+/**
+ * Sets the path to the Sentry Database Directory.
+ *
+ * Sentry will use this path to persist user consent, sessions, and other
+ * artifacts in case of a crash. This will also be used by the crashpad backend
+ * if it is configured.
+ *
+ * The directory is used for "cached" data, which needs to persist across
+ * application restarts to ensure proper flagging of release-health sessions,
+ * but might otherwise be safely purged regularly.
+ *
+ * It is roughly equivalent to the type of `AppData/Local` on Windows and
+ * `XDG_CACHE_HOME` on Linux, and equivalent runtime directories on other
+ * platforms.
+ *
+ * It is recommended that users set an explicit absolute path, depending
+ * on their apps runtime directory. The path will be created if it does not
+ * exist, and will be resolved to an absolute path inside of `sentry_init`. The
+ * directory should not be shared with other application data/configuration, as
+ * sentry-native will enumerate and possibly delete files in that directory. An
+ * example might be `$XDG_CACHE_HOME/your-app/sentry`
+ *
+ * If no explicit path it set, sentry-native will default to `.sentry-native` in
+ * the current working directory, with no specific platform-specific handling.
+ *
+ * `path` is assumed to be in platform-specific filesystem path encoding.
+ * API Users on windows are encouraged to use
+ * `sentry_options_set_database_pathw` instead.
+ */
+SENTRY_API void sentry_options_set_database_path(
+    sentry_options_t *opts, const char *path);
+
+/**
+ * Limits the total size of the envelopes that are kept in the database, for
+ * example while uploads keep failing, to `max_size` bytes. Defaults to 0,
+ * which means no limit.
+ *
+ * Once the limit is exceeded, envelopes are evicted by priority: transactions
+ * go first, then errors, and crashes last. Within the same priority, the
+ * oldest envelopes are evicted first.
+ */
+SENTRY_API void sentry_options_set_max_database_size(
+    sentry_options_t *opts, size_t max_size);
+
+/**
+ * Returns the size limit of the database, or 0 if there is none.
+ */
+SENTRY_API size_t sentry_options_get_max_database_size(
+    const sentry_options_t *opts);
+
+/**
+ * Limits the number of envelopes that are kept in the database to
+ * `max_envelopes`. Defaults to 0, which means no limit.
+ *
+ * Envelopes are evicted in the same order as with
+ * `sentry_options_set_max_database_size`.
+ */
+SENTRY_API void sentry_options_set_max_database_envelopes(
+    sentry_options_t *opts, size_t max_envelopes);
+
+/**
+ * Returns the limit on the number of envelopes in the database, or 0 if there
+ * is none.
+ */
+SENTRY_API size_t sentry_options_get_max_database_envelopes(
+    const sentry_options_t *opts);
+
+/**
+ * When the data that is written to the database is flushed to stable storage,
+ * so that a power loss does not leave torn envelopes behind.
+ */
+typedef enum {
+    // leaves it to the operating system, which is the default
+    SENTRY_DURABILITY_NONE = 0,
+    // only flushes the data that is written on a crash, like the crash
+    // envelope and the crash marker
+    SENTRY_DURABILITY_CRASH = 1,
+    // like `SENTRY_DURABILITY_CRASH`, and flushes all other writes together
+    // every `durability_interval`
+    SENTRY_DURABILITY_BATCHED = 2,
+    // flushes every write right away
+    SENTRY_DURABILITY_ALWAYS = 3,
+} sentry_durability_t;
+
+/**
+ * Sets when the envelopes, sessions, crash marker and consent that are
+ * written to the database are flushed to stable storage. Defaults to
+ * `SENTRY_DURABILITY_NONE`.
+ *
+ * Every flush waits for the storage device, so flushing more often trades
+ * throughput for durability.
+ */
+SENTRY_API void sentry_options_set_durability(
+    sentry_options_t *opts, sentry_durability_t durability);
+
+/**
+ * Returns when data written to the database is flushed.
+ */
+SENTRY_API sentry_durability_t sentry_options_get_durability(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the interval in milliseconds at which writes are flushed together with
+ * `SENTRY_DURABILITY_BATCHED`. Defaults to 1000.
+ */
+SENTRY_API void sentry_options_set_durability_interval(
+    sentry_options_t *opts, uint64_t interval_ms);
+
+/**
+ * Returns the interval at which writes are flushed together.
+ */
+SENTRY_API uint64_t sentry_options_get_durability_interval(
+    const sentry_options_t *opts);
+
+/**
+ * Enables or disables writing the envelopes and session updates of a run to
+ * a single append-only journal in the database, instead of a file for each
+ * envelope and a session file that is rewritten on every update. This is
+ * cheaper on slow filesystems, and on Windows with antivirus scanners that
+ * inspect every new file. Disabled by default.
+ *
+ * The journal is read by the next run either way, and envelopes in a journal
+ * are not subject to `sentry_options_set_max_database_size` or
+ * `sentry_options_set_max_database_envelopes`.
+ */
+SENTRY_API void sentry_options_set_run_journal(
+    sentry_options_t *opts, int enabled);
+
+/**
+ * Returns whether runs are written to a journal.
+ */
+SENTRY_API int sentry_options_get_run_journal(const sentry_options_t *opts);
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+/**
+ * Wide char version of `sentry_options_add_attachment`.
+ */
+SENTRY_API void sentry_options_add_attachmentw(
+    sentry_options_t *opts, const wchar_t *path);
+
+/**
+ * Wide char version of `sentry_options_add_attachment_with_flags`.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_add_attachment_with_flagsw(
+    sentry_options_t *opts, const wchar_t *path, int flags);
+
+/**
+ * Wide char version of `sentry_options_set_handler_path`.
+ */
+SENTRY_API void sentry_options_set_handler_pathw(
+    sentry_options_t *opts, const wchar_t *path);
+
+/**
+ * Wide char version of `sentry_options_set_database_path`.
+ */
+SENTRY_API void sentry_options_set_database_pathw(
     sentry_options_t *opts, const wchar_t *path);
 #endif
 
@@ -1163,6 +2054,90 @@ SENTRY_API void sentry_options_set_shutdown_timeout(
  */
 SENTRY_API uint64_t sentry_options_get_shutdown_timeout(sentry_options_t *opts);
 
+/**
+ * Sets the time (in milliseconds) by which persisting the scope for crash
+ * reports is delayed, so that a burst of scope changes, like setting a number
+ * of tags, results in a single write. This defaults to 0, which persists the
+ * scope synchronously on every change.
+ *
+ * This setting only has an effect when using Crashpad. Pending changes are
+ * written when a crash is handled on Linux and Windows. On macOS, a crash
+ * within the delay may be reported with a slightly outdated scope.
+ */
+SENTRY_API void sentry_options_set_scope_flush_delay(
+    sentry_options_t *opts, uint64_t delay_ms);
+
+/**
+ * Gets the delay (in milliseconds) of persisting the scope for crash reports.
+ */
+SENTRY_API uint64_t sentry_options_get_scope_flush_delay(
+    sentry_options_t *opts);
+
+/**
+ * The content of the minidumps written by the `breakpad` and `crashpad`
+ * backends.
+ */
+typedef enum {
+    // The stacks of all threads, along with the list of modules.
+    SENTRY_MINIDUMP_MODE_STACK_ONLY = 0,
+    // Additionally the memory that the stacks point to.
+    SENTRY_MINIDUMP_MODE_REFERENCED_MEMORY = 1,
+    // The complete memory of the process.
+    SENTRY_MINIDUMP_MODE_FULL = 2,
+} sentry_minidump_mode_t;
+
+/**
+ * Sets the content of the minidumps. Defaults to
+ * `SENTRY_MINIDUMP_MODE_STACK_ONLY`.
+ *
+ * Not every backend supports every mode:
+ * - `breakpad` on Windows supports all of them.
+ * - `breakpad` on Linux always writes stack-only dumps.
+ * - `crashpad` has no full dumps, and writes dumps with referenced memory
+ *   instead.
+ * The memory of modules added via `sentry_options_add_minidump_module` is
+ * included in any mode.
+ */
+SENTRY_API void sentry_options_set_minidump_mode(
+    sentry_options_t *opts, sentry_minidump_mode_t mode);
+
+/**
+ * Returns the content of the minidumps.
+ */
+SENTRY_API sentry_minidump_mode_t sentry_options_get_minidump_mode(
+    const sentry_options_t *opts);
+
+/**
+ * Includes the writable memory, such as the global variables, of the modules
+ * with the given file name in minidumps, like `"libfoo.so"` or `"foo.dll"`.
+ *
+ * Only the modules that are loaded when the backend starts are included. This
+ * is supported by `breakpad` on Linux and Windows, and by `crashpad` on
+ * Linux, Windows and macOS.
+ */
+SENTRY_API void sentry_options_add_minidump_module(
+    sentry_options_t *opts, const char *module_name);
+
+/**
+ * Limits the size of minidumps to `max_size` bytes. Defaults to 0, which
+ * means no limit.
+ *
+ * The limit bounds the memory of the modules that are included, as well as:
+ * - for `breakpad` on Linux, the complete dump, which is achieved by
+ *   truncating the stacks;
+ * - for `crashpad`, the referenced memory.
+ * Full dumps can not be limited, and are downgraded to dumps with referenced
+ * memory when a limit is set.
+ */
+SENTRY_API void sentry_options_set_minidump_max_size(
+    sentry_options_t *opts, size_t max_size);
+
+/**
+ * Returns the size limit of minidumps, or 0 if there is none.
+ */
+SENTRY_API size_t sentry_options_get_minidump_max_size(
+    const sentry_options_t *opts);
+
 /**
  * Sets a user-defined backend.
  *
@@ -1211,6 +2186,19 @@ SENTRY_API int sentry_close(void);
  */
 SENTRY_API int sentry_shutdown(void);
 
+/**
+ * Signals that the calling thread is responsive.
+ *
+ * This is meant to be called on every iteration of the main loop of the
+ * application, and only stores the current time, so it is cheap enough for
+ * that. A stall is reported once no heartbeat was sent for the timeout given
+ * to `sentry_options_set_app_hang_timeout`, and the thread that sent the last
+ * heartbeat is the one that is considered stalled. Stalls are only detected
+ * after the first heartbeat, and this does nothing while app hang detection
+ * is disabled.
+ */
+SENTRY_API void sentry_app_heartbeat(void);
+
 /**
  * This will lazily load and cache a list of all the loaded libraries.
  *
@@ -1227,9 +2215,84 @@ SENTRY_EXPERIMENTAL_API sentry_value_t sentry_get_modules_list(void);
  * libraries at runtime. It is therefore recommended to call
  * `sentry_clear_modulecache` when doing so, to make sure that the next call to
  * `sentry_capture_event` will have an up-to-date module list.
+ *
+ * On Linux, macOS and Windows, sentry is notified about libraries being loaded
+ * or unloaded, and keeps the list up-to-date on its own. Modules which are
+ * still loaded are not read again when the list is updated.
  */
 SENTRY_EXPERIMENTAL_API void sentry_clear_modulecache(void);
 
+/**
+ * Returns the statistics of the http transport since `sentry_init`.
+ *
+ * The returned object has the following keys:
+ * - `requests`: The number of requests that were sent.
+ * - `latency_ms_sum`: The total time all of those requests took.
+ * - `latency_ms_buckets`: A histogram of the request latencies. Each bucket
+ *   counts the requests that took at most the corresponding entry of
+ *   `latency_ms_bounds` in milliseconds, and are not in an earlier bucket.
+ *   The last bucket counts all the slower requests.
+ * - `bytes_sent`, `bytes_uncompressed`: The size of the request bodies that
+ *   were sent, and their size before compression.
+ * - `queue_depth`, `queue_high_water`: The current, and the largest number of
+ *   envelopes in the send queue.
+ * - `status_codes`: The number of responses for each HTTP status code.
+ * - `errors`: The number of requests that got no response, for each error code
+ *   of the HTTP client, which is a `CURLcode` or a WinHTTP error code.
+ * - `rate_limited`: The number of events and envelope items that were dropped
+ *   because of rate limits, for each rate limiting category.
+ *
+ * Returns `null` when the SDK is not initialized, or the transport does not
+ * collect statistics, which is the case for custom transports.
+ * The reference must be released with `sentry_value_decref`.
+ */
+SENTRY_EXPERIMENTAL_API sentry_value_t sentry_get_transport_stats(void);
+
+/**
+ * Returns the counters of the SDK itself, which show its own overhead and
+ * loss of data.
+ *
+ * The returned object has the following keys, which count since the start of
+ * the process, across all calls to `sentry_init`:
+ * - `events_captured`: The events and transactions that were captured while
+ *   the SDK was initialized, including unsampled transactions.
+ * - `events_sampled_out`: Those that were thrown away because of the sample
+ *   rates.
+ * - `events_discarded`: The events that the `before_send` hook discarded.
+ * - `events_rate_limited`: Those that were thrown away because of the rate
+ *   limits of the server, or because of `max_events_per_second` and
+ *   `max_transactions_per_second`.
+ * - `events_sent`: Those that were passed on to the transport.
+ * - `breadcrumbs_added`, `breadcrumbs_evicted`: The breadcrumbs that were
+ *   added, and the older ones they replaced because of `max_breadcrumbs`.
+ * - `spans_dropped`: The spans that were not recorded because their
+ *   transaction already had `max_spans` spans.
+ * - `envelopes_dumped`: The envelopes that were written to disk because the
+ *   transport could not send them before shutting down or crashing.
+ *
+ * Along with these gauges of the current state:
+ * - `transport_queue_depth`: The envelopes in the send queue of the http
+ *   transport.
+ * - `capture_queue_depth`: The events that wait to be prepared when
+ *   `async_capture` is enabled.
+ * - `modules_bytes`: The size of the cached module list, see
+ *   `sentry_get_modules_list`.
+ *
+ * When built with the `SENTRY_LOCK_STATS` CMake option, `locks` contains the
+ * `acquisitions`, the total and maximum time spent waiting (`wait_us`,
+ * `max_wait_us`), a `wait_histogram` and the longest time held
+ * (`max_hold_us`) of every internal lock, in microseconds.
+ *
+ * When built with the `SENTRY_MEMORY_TAGS` CMake option, `memory` contains the
+ * `current_bytes` and `peak_bytes` allocated by every subsystem of the SDK,
+ * like `value`, `scope`, `transport`, `modulefinder`, `json`, `envelope` and
+ * `page_allocator`, along with those of all allocations as `total`.
+ *
+ * The counters are kept per thread, without locking, and are summed up by this
+ * function. The reference must be released with `sentry_value_decref`.
+ */
+SENTRY_EXPERIMENTAL_API sentry_value_t sentry_get_stats(void);
+
 /**
  * Re-initializes the Sentry backend.
  *
@@ -1241,6 +2304,27 @@ SENTRY_EXPERIMENTAL_API void sentry_clear_modulecache(void);
  */
 SENTRY_EXPERIMENTAL_API int sentry_reinstall_backend(void);
 
+/**
+ * Switches the SDK between offline, when `offline` is non-zero, and online.
+ *
+ * While offline, envelopes are not sent, but written to the database right
+ * away. Once the SDK is online again, these are uploaded in the background,
+ * crashes first, then errors, then transactions, and the oldest first within
+ * each of those. The upload is paced in small batches, each of which waits
+ * for the transport to send the previous one, so that it neither floods the
+ * network nor the CPU. Envelopes that are not uploaded by `sentry_close` stay
+ * in the database for the next start.
+ *
+ * The SDK starts out online, unless this is called before `sentry_init`.
+ * See also `sentry_options_set_connectivity_probe`.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_set_offline(int offline);
+
+/**
+ * Returns non-zero if the SDK is offline, see `sentry_set_offline`.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_is_offline(void);
+
 /**
  * Gives user consent.
  */
@@ -1270,6 +2354,28 @@ SENTRY_API sentry_user_consent_t sentry_user_consent_get(void);
  */
 SENTRY_API sentry_uuid_t sentry_capture_event(sentry_value_t event);
 
+/**
+ * Sends an event with a single exception of the given `type` and `value`,
+ * which do not need to be NUL-terminated, like a handled C++ exception.
+ *
+ * `ips` are the `ips_len` instruction addresses of its stack trace, starting
+ * with the innermost frame, as written by `sentry_unwind_stack`. They can be
+ * NULL, in which case the exception has no stack trace.
+ *
+ * This is the same as creating the event via `sentry_value_new_event`,
+ * `sentry_value_new_exception` and `sentry_value_set_stacktrace`, and passing
+ * it to `sentry_capture_event`. But none of the arguments are copied until
+ * the event has passed the duplicate detection of
+ * `sentry_options_set_dedup_window` and the sampling, so that a discarded
+ * event costs no allocations. All the arguments remain owned by the caller, so
+ * they can live on its stack.
+ *
+ * Returns the id of the event, or a nil UUID if it was discarded.
+ */
+SENTRY_EXPERIMENTAL_API sentry_uuid_t sentry_capture_exception_n(
+    sentry_level_t level, const char *type, size_t type_len,
+    const char *value, size_t value_len, void *const *ips, size_t ips_len);
+
 /**
  * Captures an exception to be handled by the backend.
  *
@@ -1283,6 +2389,17 @@ SENTRY_EXPERIMENTAL_API void sentry_handle_exception(
  */
 SENTRY_API void sentry_add_breadcrumb(sentry_value_t breadcrumb);
 
+/**
+ * Adds the `count` breadcrumbs in the `breadcrumbs` array, from the oldest to
+ * the most recent one, as if `sentry_add_breadcrumb` was called for each of
+ * them. The locks are taken and the crash backend is updated only once for
+ * all of them, and the breadcrumbs that exceed `max_breadcrumbs` are dropped
+ * right away. This takes ownership of all the breadcrumbs, but not of the
+ * array itself.
+ */
+SENTRY_API void sentry_add_breadcrumbs(
+    sentry_value_t *breadcrumbs, size_t count);
+
 /**
  * Sets the specified user.
  */
@@ -1313,6 +2430,39 @@ SENTRY_API void sentry_set_extra(const char *key, sentry_value_t value);
  */
 SENTRY_API void sentry_remove_extra(const char *key);
 
+/**
+ * Sets a tag which only applies to events captured on the calling thread.
+ *
+ * Thread tags take precedence over the ones set via `sentry_set_tag`. Unlike
+ * those, they are not synchronized with any other thread and are not made
+ * available to the crashpad backend.
+ */
+SENTRY_API void sentry_set_thread_tag(const char *key, const char *value);
+
+/**
+ * Removes the tag with the specified key from the calling thread.
+ */
+SENTRY_API void sentry_remove_thread_tag(const char *key);
+
+/**
+ * Sets extra information which only applies to events captured on the calling
+ * thread. See `sentry_set_thread_tag`.
+ */
+SENTRY_API void sentry_set_thread_extra(const char *key, sentry_value_t value);
+
+/**
+ * Removes the extra with the specified key from the calling thread.
+ */
+SENTRY_API void sentry_remove_thread_extra(const char *key);
+
+/**
+ * Removes all the tags and extra of the calling thread.
+ *
+ * This should be called before a thread that used `sentry_set_thread_tag` or
+ * `sentry_set_thread_extra` exits, since they would be leaked otherwise.
+ */
+SENTRY_API void sentry_clear_thread_scope(void);
+
 /**
  * Sets a context object.
  */
@@ -1356,6 +2506,28 @@ SENTRY_API void sentry_start_session(void);
  */
 SENTRY_API void sentry_end_session(void);
 
+/**
+ * The outcome of a request session.
+ */
+typedef enum {
+    SENTRY_REQUEST_SESSION_EXITED,
+    SENTRY_REQUEST_SESSION_ERRORED,
+    SENTRY_REQUEST_SESSION_CRASHED,
+    SENTRY_REQUEST_SESSION_ABNORMAL,
+} sentry_request_session_status_t;
+
+/**
+ * Records a session for a finished request, when sessions are tracked in the
+ * `SENTRY_SESSION_MODE_REQUEST` mode.
+ *
+ * `distinct_id` optionally identifies the user of the request, and is
+ * truncated to 63 bytes. This only increments an in-memory counter without
+ * taking any locks, so it is safe to call for every request. Otherwise this
+ * does nothing.
+ */
+SENTRY_API void sentry_record_request_session(
+    sentry_request_session_status_t status, const char *distinct_id);
+
 /**
  * Sets the maximum number of spans that can be attached to a
  * transaction.
@@ -1384,6 +2556,137 @@ SENTRY_EXPERIMENTAL_API void sentry_options_set_traces_sample_rate(
 SENTRY_EXPERIMENTAL_API double sentry_options_get_traces_sample_rate(
     sentry_options_t *opts);
 
+/**
+ * Type of the `traces_sampler` callback.
+ *
+ * It is called with the `name` and `operation` of a transaction that is being
+ * started without a sampling decision, and with the custom `sampling_ctx`
+ * passed to `sentry_transaction_start`, which it does not own. It returns the
+ * sample rate for the transaction, between `0.0` and `1.0`.
+ */
+typedef double (*sentry_traces_sampler_function_t)(const char *name,
+    const char *operation, sentry_value_t sampling_ctx, void *user_data);
+
+/**
+ * Sets the `traces_sampler` callback, which decides the sample rate of each
+ * transaction instead of the `traces_sample_rate`.
+ *
+ * The callback is invoked from whichever thread starts a transaction, and
+ * needs to be thread safe.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_traces_sampler(
+    sentry_options_t *opts, sentry_traces_sampler_function_t func,
+    void *user_data);
+
+/**
+ * Sets for how many milliseconds the sample rate that the `traces_sampler`
+ * returned for a name and operation is reused for further transactions with
+ * the same name and operation. In the meantime, the sampler is not called for
+ * those at all, so its decision can not depend on the `sampling_ctx`.
+ *
+ * This defaults to 0, which calls the sampler for every transaction.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_traces_sampler_cache_ttl(
+    sentry_options_t *opts, uint64_t ttl_ms);
+
+/**
+ * Gets for how many milliseconds the sample rates of the `traces_sampler` are
+ * reused.
+ */
+SENTRY_EXPERIMENTAL_API uint64_t sentry_options_get_traces_sampler_cache_ttl(
+    const sentry_options_t *opts);
+
+/**
+ * Enables streaming the spans of long running transactions, and sets after
+ * how many finished spans they are sent.
+ *
+ * Instead of being dropped once a transaction has `max_spans` finished spans,
+ * the finished spans are then sent in chunks of `span_count` spans. Each chunk
+ * is sent as a transaction with the same name and trace as the transaction
+ * that is still running, whose root span is the parent of the chunk. This
+ * keeps the memory held by a transaction bounded, no matter how long it runs.
+ *
+ * This defaults to 0, which does not stream spans unless
+ * `sentry_options_set_span_chunk_max_bytes` is set.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_span_chunk_size(
+    sentry_options_t *opts, size_t span_count);
+
+/**
+ * Gets after how many finished spans the spans of a transaction are sent.
+ */
+SENTRY_EXPERIMENTAL_API size_t sentry_options_get_span_chunk_size(
+    const sentry_options_t *opts);
+
+/**
+ * Enables streaming the spans of long running transactions, and sets how many
+ * bytes the finished spans of a transaction are allowed to take up until they
+ * are sent as a chunk, see `sentry_options_set_span_chunk_size`.
+ *
+ * Without a `span_chunk_size`, chunks are also sent once they have
+ * `max_spans` spans. This defaults to 0, which does not limit the size.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_span_chunk_max_bytes(
+    sentry_options_t *opts, size_t bytes);
+
+/**
+ * Gets how many bytes the finished spans of a transaction are allowed to take
+ * up until they are sent.
+ */
+SENTRY_EXPERIMENTAL_API size_t sentry_options_get_span_chunk_max_bytes(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the sample rate for profiles, which is relative to the sampled
+ * transactions. Should be a double between `0.0` and `1.0`, and defaults to
+ * `0.0`, which disables profiling.
+ *
+ * A profiled transaction samples the stack of the thread that started it
+ * every `profiling_interval` milliseconds, for at most 30 seconds. The
+ * deduplicated stacks are sent along with the transaction in a profile.
+ * Only one transaction is profiled at a time, and profiling is only supported
+ * on Linux.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_profiles_sample_rate(
+    sentry_options_t *opts, double sample_rate);
+
+/**
+ * Returns the sample rate for profiles.
+ */
+SENTRY_EXPERIMENTAL_API double sentry_options_get_profiles_sample_rate(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the interval in milliseconds at which profiled transactions sample
+ * their stack. This defaults to 10.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_profiling_interval(
+    sentry_options_t *opts, uint64_t interval_ms);
+
+/**
+ * Gets the interval in milliseconds at which profiled transactions sample
+ * their stack.
+ */
+SENTRY_EXPERIMENTAL_API uint64_t sentry_options_get_profiling_interval(
+    const sentry_options_t *opts);
+
+/**
+ * Sets the maximum number of transactions that are sent per second.
+ *
+ * Transactions beyond that are discarded in `sentry_transaction_finish`,
+ * before they are processed. This works like
+ * `sentry_options_set_max_events_per_second`, and the default of 0 means that
+ * there is no limit.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_max_transactions_per_second(
+    sentry_options_t *opts, size_t max_transactions);
+
+/**
+ * Gets the maximum number of transactions that are sent per second.
+ */
+SENTRY_EXPERIMENTAL_API size_t sentry_options_get_max_transactions_per_second(
+    const sentry_options_t *opts);
+
 /* -- Performance Monitoring/Tracing APIs -- */
 
 /**
@@ -1434,6 +2737,15 @@ typedef struct sentry_span_s sentry_span_t;
 SENTRY_EXPERIMENTAL_API sentry_transaction_context_t *
 sentry_transaction_context_new(const char *name, const char *operation);
 
+/**
+ * Same as `sentry_transaction_context_new`, but with a `name` of `name_len`
+ * bytes and an `operation` of `operation_len` bytes, which do not need to be
+ * null terminated.
+ */
+SENTRY_EXPERIMENTAL_API sentry_transaction_context_t *
+sentry_transaction_context_new_n(const char *name, size_t name_len,
+    const char *operation, size_t operation_len);
+
 /**
  * Sets the `name` on a Transaction Context, which will be used in the
  * Transaction constructed off of the context.
@@ -1499,10 +2811,9 @@ SENTRY_EXPERIMENTAL_API void sentry_transaction_context_update_from_header(
  * external integration (i.e. a span from a different SDK) or manually
  * constructed by a user.
  *
- * The second parameter is a custom Sampling Context to be used with a Traces
- * Sampler to make a more informed sampling decision. The SDK does not currently
- * support a custom Traces Sampler and this parameter is ignored for the time
- * being but needs to be provided.
+ * The second parameter is a custom Sampling Context, which is passed to the
+ * `traces_sampler` to make a more informed sampling decision. This takes
+ * ownership of it, and it can be a null Value.
  *
  * Returns a Transaction, which is expected to be manually managed by the
  * caller. Manual management involves ensuring that `sentry_transaction_finish`
@@ -1605,6 +2916,15 @@ SENTRY_EXPERIMENTAL_API void sentry_set_span(sentry_span_t *span);
 SENTRY_EXPERIMENTAL_API sentry_span_t *sentry_transaction_start_child(
     sentry_transaction_t *parent, char *operation, char *description);
 
+/**
+ * Same as `sentry_transaction_start_child`, but with an `operation` of
+ * `operation_len` bytes and a `description` of `description_len` bytes, which
+ * do not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API sentry_span_t *sentry_transaction_start_child_n(
+    sentry_transaction_t *parent, const char *operation, size_t operation_len,
+    const char *description, size_t description_len);
+
 /**
  * Starts a new Span.
  *
@@ -1638,6 +2958,15 @@ SENTRY_EXPERIMENTAL_API sentry_span_t *sentry_transaction_start_child(
 SENTRY_EXPERIMENTAL_API sentry_span_t *sentry_span_start_child(
     sentry_span_t *parent, char *operation, char *description);
 
+/**
+ * Same as `sentry_span_start_child`, but with an `operation` of
+ * `operation_len` bytes and a `description` of `description_len` bytes, which
+ * do not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API sentry_span_t *sentry_span_start_child_n(
+    sentry_span_t *parent, const char *operation, size_t operation_len,
+    const char *description, size_t description_len);
+
 /**
  * Finishes a Span.
  *
@@ -1661,6 +2990,14 @@ SENTRY_EXPERIMENTAL_API void sentry_span_finish(sentry_span_t *span);
 SENTRY_EXPERIMENTAL_API void sentry_transaction_set_tag(
     sentry_transaction_t *transaction, const char *tag, const char *value);
 
+/**
+ * Same as `sentry_transaction_set_tag`, but with a `tag` of `tag_len` bytes
+ * and a `value` of `value_len` bytes, which do not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_transaction_set_tag_n(
+    sentry_transaction_t *transaction, const char *tag, size_t tag_len,
+    const char *value, size_t value_len);
+
 /**
  * Removes a tag from a Transaction.
  *
@@ -1679,6 +3016,14 @@ SENTRY_EXPERIMENTAL_API void sentry_transaction_remove_tag(
 SENTRY_EXPERIMENTAL_API void sentry_transaction_set_data(
     sentry_transaction_t *transaction, const char *key, sentry_value_t value);
 
+/**
+ * Same as `sentry_transaction_set_data`, but with a `key` of `key_len` bytes,
+ * which does not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_transaction_set_data_n(
+    sentry_transaction_t *transaction, const char *key, size_t key_len,
+    sentry_value_t value);
+
 /**
  * Removes a key from a Transaction's "data" section.
  *
@@ -1699,6 +3044,13 @@ SENTRY_EXPERIMENTAL_API void sentry_transaction_remove_data(
 SENTRY_EXPERIMENTAL_API void sentry_span_set_tag(
     sentry_span_t *span, const char *tag, const char *value);
 
+/**
+ * Same as `sentry_span_set_tag`, but with a `tag` of `tag_len` bytes and a
+ * `value` of `value_len` bytes, which do not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_span_set_tag_n(sentry_span_t *span,
+    const char *tag, size_t tag_len, const char *value, size_t value_len);
+
 /**
  * Removes a tag from a Span.
  *
@@ -1717,6 +3069,13 @@ SENTRY_EXPERIMENTAL_API void sentry_span_remove_tag(
 SENTRY_EXPERIMENTAL_API void sentry_span_set_data(
     sentry_span_t *span, const char *key, sentry_value_t value);
 
+/**
+ * Same as `sentry_span_set_data`, but with a `key` of `key_len` bytes, which
+ * does not need to be null terminated.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_span_set_data_n(sentry_span_t *span,
+    const char *key, size_t key_len, sentry_value_t value);
+
 /**
  * Removes a key from a Span's "data" section.
  *
@@ -1877,6 +3236,79 @@ SENTRY_EXPERIMENTAL_API const char *sentry_sdk_name();
  */
 SENTRY_EXPERIMENTAL_API const char *sentry_sdk_user_agent();
 
+/* -- Metrics APIs -- */
+
+/**
+ * Enables the metrics APIs below. This is disabled by default, in which case
+ * recording metrics does nothing.
+ *
+ * Metrics are aggregated in memory into 10 second buckets, per metric type,
+ * key, unit and tags. The buckets are sent every 10 seconds in a compact
+ * `statsd` envelope item, and when the SDK is closed.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_enable_metrics(
+    sentry_options_t *opts, int enable_metrics);
+
+/**
+ * Returns whether the metrics APIs are enabled.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_options_get_enable_metrics(
+    const sentry_options_t *opts);
+
+/**
+ * Sets how many bytes the aggregated metrics are allowed to take up. This is
+ * allocated upfront. Metrics which do not fit are dropped until the buckets
+ * are sent the next time. This defaults to 1 MiB.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_metrics_max_memory(
+    sentry_options_t *opts, size_t bytes);
+
+/**
+ * Gets how many bytes the aggregated metrics are allowed to take up.
+ */
+SENTRY_EXPERIMENTAL_API size_t sentry_options_get_metrics_max_memory(
+    const sentry_options_t *opts);
+
+/*
+ * Records metrics.
+ *
+ * The `key` is truncated to 127 bytes, and the optional `unit` to 31 bytes,
+ * like `"millisecond"`. The optional `tags` are given as comma separated
+ * `name:value` pairs, like `"route:/home,method:GET"`, and are truncated to
+ * 255 bytes.
+ *
+ * None of these functions allocate or take any locks. They only update the
+ * aggregate of the bucket with atomic operations, so they are cheap enough to
+ * be called from hot code paths.
+ */
+
+/**
+ * Adds `value` to a counter, which is the sum of all its values.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_metrics_increment(
+    const char *key, double value, const char *unit, const char *tags);
+
+/**
+ * Records `value` in a gauge, which keeps the last, minimum, maximum and sum
+ * of its values, as well as their count.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_metrics_gauge(
+    const char *key, double value, const char *unit, const char *tags);
+
+/**
+ * Adds `value` to a distribution, which keeps every single value, for
+ * percentiles to be computed from.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_metrics_distribution(
+    const char *key, double value, const char *unit, const char *tags);
+
+/**
+ * Adds `value` to a set, which counts the number of unique values, like
+ * users. Only the hashes of the values are kept.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_metrics_set(
+    const char *key, const char *value, const char *unit, const char *tags);
+
 #ifdef __cplusplus
 }
 #endif
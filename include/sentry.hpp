@@ -0,0 +1,370 @@
+/**
+ * sentry-native C++ tracing wrappers
+ *
+ * Move-only RAII types around the tracing APIs of `sentry.h`. A `Span` is
+ * finished and a `Transaction` is finished and sent when it goes out of scope,
+ * unless that was already done explicitly. Strings are passed as
+ * `std::string_view`, which maps onto the length-aware `_n` functions, so
+ * neither null terminated nor heap allocated strings are needed.
+ *
+ * Defining `SENTRY_TRACING_DISABLED` before including this header turns all of
+ * these types into empty ones whose methods do nothing, so that the
+ * instrumentation compiles out entirely.
+ *
+ * This requires C++17.
+ */
+
+#ifndef SENTRY_HPP_INCLUDED
+#define SENTRY_HPP_INCLUDED
+
+#include "sentry.h"
+
+#include <string_view>
+#include <utility>
+
+namespace sentry {
+
+#ifndef SENTRY_TRACING_DISABLED
+
+/**
+ * A Span, which is finished once it goes out of scope.
+ */
+class Span {
+public:
+    Span() noexcept = default;
+
+    /**
+     * Takes ownership of a span returned by `sentry_span_start_child` or
+     * `sentry_transaction_start_child`.
+     */
+    explicit Span(sentry_span_t *span) noexcept
+        : m_span(span)
+    {
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+    Span(Span &&other) noexcept
+        : m_span(std::exchange(other.m_span, nullptr))
+    {
+    }
+
+    Span &
+    operator=(Span &&other) noexcept
+    {
+        if (this != &other) {
+            finish();
+            m_span = std::exchange(other.m_span, nullptr);
+        }
+        return *this;
+    }
+
+    ~Span() { finish(); }
+
+    /**
+     * Starts a child span, see `sentry_span_start_child`.
+     */
+    Span
+    start_child(std::string_view operation,
+        std::string_view description = std::string_view()) noexcept
+    {
+        if (!m_span) {
+            return Span();
+        }
+        return Span(sentry_span_start_child_n(m_span, operation.data(),
+            operation.size(), description.data(), description.size()));
+    }
+
+    void
+    set_tag(std::string_view tag, std::string_view value) noexcept
+    {
+        sentry_span_set_tag_n(
+            m_span, tag.data(), tag.size(), value.data(), value.size());
+    }
+
+    /**
+     * Sets data on the span, and takes ownership of `value`.
+     */
+    void
+    set_data(std::string_view key, sentry_value_t value) noexcept
+    {
+        sentry_span_set_data_n(m_span, key.data(), key.size(), value);
+    }
+
+    void
+    set_status(sentry_span_status_t status) noexcept
+    {
+        sentry_span_set_status(m_span, status);
+    }
+
+    /**
+     * Finishes the span right away, see `sentry_span_finish`.
+     */
+    void
+    finish() noexcept
+    {
+        if (m_span) {
+            sentry_span_finish(std::exchange(m_span, nullptr));
+        }
+    }
+
+    sentry_span_t *
+    get() const noexcept
+    {
+        return m_span;
+    }
+
+    /**
+     * Gives up the ownership of the span, which then needs to be finished with
+     * `sentry_span_finish`.
+     */
+    sentry_span_t *
+    release() noexcept
+    {
+        return std::exchange(m_span, nullptr);
+    }
+
+    explicit operator bool() const noexcept { return m_span != nullptr; }
+
+private:
+    sentry_span_t *m_span = nullptr;
+};
+
+/**
+ * A Transaction, which is finished and sent once it goes out of scope.
+ */
+class Transaction {
+public:
+    Transaction() noexcept = default;
+
+    /**
+     * Starts a transaction, see `sentry_transaction_start`.
+     */
+    Transaction(std::string_view name, std::string_view operation,
+        sentry_value_t sampling_ctx = sentry_value_new_null()) noexcept
+    {
+        sentry_transaction_context_t *tx_cxt
+            = sentry_transaction_context_new_n(
+                name.data(), name.size(), operation.data(), operation.size());
+        if (tx_cxt) {
+            m_tx = sentry_transaction_start(tx_cxt, sampling_ctx);
+        } else {
+            sentry_value_decref(sampling_ctx);
+        }
+    }
+
+    /**
+     * Takes ownership of a transaction returned by `sentry_transaction_start`.
+     */
+    explicit Transaction(sentry_transaction_t *tx) noexcept
+        : m_tx(tx)
+    {
+    }
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    Transaction(Transaction &&other) noexcept
+        : m_tx(std::exchange(other.m_tx, nullptr))
+    {
+    }
+
+    Transaction &
+    operator=(Transaction &&other) noexcept
+    {
+        if (this != &other) {
+            finish();
+            m_tx = std::exchange(other.m_tx, nullptr);
+        }
+        return *this;
+    }
+
+    ~Transaction() { finish(); }
+
+    /**
+     * Starts a child span, see `sentry_transaction_start_child`.
+     */
+    Span
+    start_child(std::string_view operation,
+        std::string_view description = std::string_view()) noexcept
+    {
+        if (!m_tx) {
+            return Span();
+        }
+        return Span(sentry_transaction_start_child_n(m_tx, operation.data(),
+            operation.size(), description.data(), description.size()));
+    }
+
+    void
+    set_tag(std::string_view tag, std::string_view value) noexcept
+    {
+        sentry_transaction_set_tag_n(
+            m_tx, tag.data(), tag.size(), value.data(), value.size());
+    }
+
+    /**
+     * Sets data on the transaction, and takes ownership of `value`.
+     */
+    void
+    set_data(std::string_view key, sentry_value_t value) noexcept
+    {
+        if (m_tx) {
+            sentry_transaction_set_data_n(m_tx, key.data(), key.size(), value);
+        } else {
+            sentry_value_decref(value);
+        }
+    }
+
+    void
+    set_status(sentry_span_status_t status) noexcept
+    {
+        sentry_transaction_set_status(m_tx, status);
+    }
+
+    /**
+     * Finishes and sends the transaction right away, see
+     * `sentry_transaction_finish`.
+     */
+    sentry_uuid_t
+    finish() noexcept
+    {
+        if (!m_tx) {
+            return sentry_uuid_nil();
+        }
+        return sentry_transaction_finish(std::exchange(m_tx, nullptr));
+    }
+
+    sentry_transaction_t *
+    get() const noexcept
+    {
+        return m_tx;
+    }
+
+    /**
+     * Gives up the ownership of the transaction, which then needs to be
+     * finished with `sentry_transaction_finish`.
+     */
+    sentry_transaction_t *
+    release() noexcept
+    {
+        return std::exchange(m_tx, nullptr);
+    }
+
+    explicit operator bool() const noexcept { return m_tx != nullptr; }
+
+private:
+    sentry_transaction_t *m_tx = nullptr;
+};
+
+#else
+
+// These have the same interface as above, but do nothing at all. Values that
+// they would take ownership of are still released.
+
+class Span {
+public:
+    Span() noexcept = default;
+    explicit Span(sentry_span_t *) noexcept { }
+    // this keeps unused spans from being warned about
+    ~Span() { }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+    Span(Span &&) noexcept = default;
+    Span &operator=(Span &&) noexcept = default;
+
+    Span
+    start_child(std::string_view,
+        std::string_view = std::string_view()) noexcept
+    {
+        return Span();
+    }
+
+    void set_tag(std::string_view, std::string_view) noexcept { }
+
+    void
+    set_data(std::string_view, sentry_value_t value) noexcept
+    {
+        sentry_value_decref(value);
+    }
+
+    void set_status(sentry_span_status_t) noexcept { }
+    void finish() noexcept { }
+
+    sentry_span_t *
+    get() const noexcept
+    {
+        return nullptr;
+    }
+
+    sentry_span_t *
+    release() noexcept
+    {
+        return nullptr;
+    }
+
+    explicit operator bool() const noexcept { return false; }
+};
+
+class Transaction {
+public:
+    Transaction() noexcept = default;
+
+    Transaction(std::string_view, std::string_view,
+        sentry_value_t sampling_ctx = sentry_value_new_null()) noexcept
+    {
+        sentry_value_decref(sampling_ctx);
+    }
+
+    explicit Transaction(sentry_transaction_t *) noexcept { }
+    ~Transaction() { }
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+    Transaction(Transaction &&) noexcept = default;
+    Transaction &operator=(Transaction &&) noexcept = default;
+
+    Span
+    start_child(std::string_view,
+        std::string_view = std::string_view()) noexcept
+    {
+        return Span();
+    }
+
+    void set_tag(std::string_view, std::string_view) noexcept { }
+
+    void
+    set_data(std::string_view, sentry_value_t value) noexcept
+    {
+        sentry_value_decref(value);
+    }
+
+    void set_status(sentry_span_status_t) noexcept { }
+
+    sentry_uuid_t
+    finish() noexcept
+    {
+        return sentry_uuid_nil();
+    }
+
+    sentry_transaction_t *
+    get() const noexcept
+    {
+        return nullptr;
+    }
+
+    sentry_transaction_t *
+    release() noexcept
+    {
+        return nullptr;
+    }
+
+    explicit operator bool() const noexcept { return false; }
+};
+
+#endif
+
+} // namespace sentry
+
+#endif
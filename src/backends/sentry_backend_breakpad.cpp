@@ -3,6 +3,7 @@ extern "C" {
 
 #include "sentry_alloc.h"
 #include "sentry_backend.h"
+#include "sentry_breadcrumb.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
 #include "sentry_envelope.h"
@@ -73,6 +74,10 @@ sentry__breakpad_backend_callback(
     sentry__enter_signal_handler();
 #endif
 
+    // the buffered breadcrumbs are added before the scope becomes part of the
+    // crash event
+    sentry__breadcrumbs_flush();
+
     sentry_path_t *dump_path = nullptr;
 #ifdef SENTRY_PLATFORM_WINDOWS
     sentry_path_t *tmp_path = sentry__path_new(breakpad_dump_path);
@@ -203,6 +208,37 @@ IsDebuggerActive()
 }
 #endif
 
+#if defined(SENTRY_PLATFORM_WINDOWS) || defined(SENTRY_PLATFORM_LINUX)
+static void
+register_minidump_range(void *start, size_t size, void *data)
+{
+    google_breakpad::ExceptionHandler *eh
+        = (google_breakpad::ExceptionHandler *)data;
+    eh->RegisterAppMemory(start, size);
+}
+#endif
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+static MINIDUMP_TYPE
+get_minidump_type(const sentry_options_t *options)
+{
+    switch (options->minidump_mode) {
+    case SENTRY_MINIDUMP_MODE_FULL:
+        // there is no way to limit the size of a full dump
+        if (!options->minidump_max_size) {
+            return MiniDumpWithFullMemory;
+        }
+        SENTRY_WARN("full minidumps can not be limited in size, writing "
+                    "minidumps with referenced memory instead");
+        return MiniDumpWithIndirectlyReferencedMemory;
+    case SENTRY_MINIDUMP_MODE_REFERENCED_MEMORY:
+        return MiniDumpWithIndirectlyReferencedMemory;
+    default:
+        return MiniDumpNormal;
+    }
+}
+#endif
+
 static int
 sentry__breakpad_backend_startup(
     sentry_backend_t *backend, const sentry_options_t *options)
@@ -212,7 +248,8 @@ sentry__breakpad_backend_startup(
 #ifdef SENTRY_PLATFORM_WINDOWS
     backend->data = new google_breakpad::ExceptionHandler(
         current_run_folder->path, NULL, sentry__breakpad_backend_callback, NULL,
-        google_breakpad::ExceptionHandler::HANDLER_EXCEPTION);
+        google_breakpad::ExceptionHandler::HANDLER_EXCEPTION,
+        get_minidump_type(options), (const wchar_t *)NULL, NULL);
 #elif defined(SENTRY_PLATFORM_MACOS)
     // If process is being debugged and there are breakpoints set it will cause
     // task_set_exception_ports to crash the whole process and debugger
@@ -224,9 +261,23 @@ sentry__breakpad_backend_startup(
         = new google_breakpad::ExceptionHandler(current_run_folder->path, NULL,
             sentry__breakpad_backend_callback, NULL, true, NULL);
 #else
+    if (options->minidump_mode != SENTRY_MINIDUMP_MODE_STACK_ONLY) {
+        SENTRY_WARN("breakpad only writes stack-only minidumps on this "
+                    "platform");
+    }
     google_breakpad::MinidumpDescriptor descriptor(current_run_folder->path);
+    if (options->minidump_max_size) {
+        // breakpad truncates the stacks to stay within this limit
+        descriptor.set_size_limit((off_t)options->minidump_max_size);
+    }
     backend->data = new google_breakpad::ExceptionHandler(
         descriptor, NULL, sentry__breakpad_backend_callback, NULL, true, -1);
+#endif
+#if defined(SENTRY_PLATFORM_WINDOWS) || defined(SENTRY_PLATFORM_LINUX)
+    if (backend->data) {
+        sentry__backend_foreach_minidump_range(
+            options, register_minidump_range, backend->data);
+    }
 #endif
     return backend->data == NULL;
 }
@@ -280,6 +331,7 @@ sentry__backend_new(void)
     backend->startup_func = sentry__breakpad_backend_startup;
     backend->shutdown_func = sentry__breakpad_backend_shutdown;
     backend->except_func = sentry__breakpad_backend_except;
+    backend->restart_after_fork = true;
 
     return backend;
 }
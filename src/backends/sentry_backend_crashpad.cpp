@@ -3,11 +3,13 @@ extern "C" {
 
 #include "sentry_alloc.h"
 #include "sentry_backend.h"
+#include "sentry_breadcrumb.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
 #include "sentry_envelope.h"
 #include "sentry_options.h"
 #include "sentry_path.h"
+#include "sentry_ringfile.h"
 #include "sentry_sync.h"
 #include "sentry_transport.h"
 #include "sentry_unix_pageallocator.h"
@@ -33,6 +35,7 @@ extern "C" {
 #include "client/crashpad_info.h"
 #include "client/prune_crash_reports.h"
 #include "client/settings.h"
+#include "client/simple_address_range_bag.h"
 #if defined(_MSC_VER)
 #    include "util/win/termination_codes.h"
 #elif defined(__MINGW32__)
@@ -74,12 +77,32 @@ constexpr int g_CrashSignals[] = {
 };
 #endif
 
+// The size of a breadcrumb slot in the ring file, which makes every slot
+// including its header take up 4K. Larger breadcrumbs are dropped.
+#define SENTRY_BREADCRUMB_SLOT_SIZE 4080
+
 typedef struct {
     crashpad::CrashReportDatabase *db;
     sentry_path_t *event_path;
     sentry_path_t *breadcrumb1_path;
     sentry_path_t *breadcrumb2_path;
     size_t num_breadcrumbs;
+    // Where the first-chance crash handler is available, breadcrumbs are
+    // appended to this memory-mapped ring instead, and written out to
+    // `breadcrumb1_path` only once we crash.
+    sentry_ringfile_t *breadcrumb_ring;
+    // The scope and breadcrumbs are encoded into this buffer, which is reused
+    // across flushes, and guarded by `mpack_lock`.
+    sentry_stringbuilder_t mpack_buf;
+    sentry_mutex_t mpack_lock;
+    // With a `scope_flush_delay`, scope changes only mark the scope as
+    // `scope_dirty`, and schedule a single write on the `scope_worker`.
+    sentry_bgworker_t *scope_worker;
+    // The memory of the `minidump_modules`, which needs to outlive the
+    // backend, since crashpad keeps handling crashes after `sentry_close`.
+    crashpad::SimpleAddressRangeBag *extra_memory;
+    const sentry_options_t *options;
+    volatile long scope_dirty;
 } crashpad_state_t;
 
 static void
@@ -92,15 +115,10 @@ sentry__crashpad_backend_user_consent_changed(sentry_backend_t *backend)
     data->db->GetSettings()->SetUploadsEnabled(!sentry__should_skip_upload());
 }
 
-static void
-sentry__crashpad_backend_flush_scope(
-    sentry_backend_t *backend, const sentry_options_t *options)
+static int
+write_scope(const crashpad_state_t *data, const sentry_options_t *options,
+    sentry_stringbuilder_t *mpack_buf)
 {
-    const crashpad_state_t *data = (crashpad_state_t *)backend->data;
-    if (!data->event_path) {
-        return;
-    }
-
     // This here is an empty object that we copy the scope into.
     // Even though the API is specific to `event`, an `event` has a few default
     // properties that we do not want here.
@@ -110,22 +128,81 @@ sentry__crashpad_backend_flush_scope(
         sentry__scope_apply_to_event(scope, options, event, SENTRY_SCOPE_NONE);
     }
 
-    size_t mpack_size;
-    char *mpack = sentry_value_to_msgpack(event, &mpack_size);
+    // the unchanged sections of the scope are spliced in from their cached
+    // msgpack encoding
+    sentry__stringbuilder_set_len(mpack_buf, 0);
+    int rv = sentry__value_append_msgpack(mpack_buf, event);
     sentry_value_decref(event);
-    if (!mpack) {
+    if (rv == 0) {
+        rv = sentry__path_write_buffer(data->event_path, mpack_buf->buf,
+            sentry__stringbuilder_len(mpack_buf));
+    }
+    if (rv != 0) {
+        SENTRY_DEBUG("flushing scope to msgpack failed");
+    }
+    return rv;
+}
+
+static void
+flush_scope_now(crashpad_state_t *data, const sentry_options_t *options)
+{
+    sentry__mutex_lock(&data->mpack_lock);
+    write_scope(data, options, &data->mpack_buf);
+    sentry__mutex_unlock(&data->mpack_lock);
+}
+
+static void
+flush_dirty_scope_task(void *UNUSED(task_data), void *state)
+{
+    crashpad_state_t *data = (crashpad_state_t *)state;
+    if (sentry__atomic_store(&data->scope_dirty, 0)) {
+        flush_scope_now(data, data->options);
+    }
+}
+
+static void
+sentry__crashpad_backend_flush_scope(
+    sentry_backend_t *backend, const sentry_options_t *options)
+{
+    crashpad_state_t *data = (crashpad_state_t *)backend->data;
+    if (!data->event_path) {
         return;
     }
 
-    int rv = sentry__path_write_buffer(data->event_path, mpack, mpack_size);
-    sentry_free(mpack);
+    if (!data->scope_worker) {
+        flush_scope_now(data, options);
+        return;
+    }
+    // only the first change after a write schedules the next one, all the
+    // others are picked up by it
+    if (sentry__atomic_store(&data->scope_dirty, 1) == 0
+        && sentry__bgworker_submit_delayed(data->scope_worker,
+               flush_dirty_scope_task, NULL, NULL, options->scope_flush_delay,
+               NULL)
+            != 0) {
+        sentry__atomic_store(&data->scope_dirty, 0);
+        flush_scope_now(data, options);
+    }
+}
 
+#if defined(SENTRY_PLATFORM_LINUX) || defined(SENTRY_PLATFORM_WINDOWS)
+static void
+write_breadcrumb_ring(const crashpad_state_t *data)
+{
+    // the breadcrumbs are concatenated msgpack, just like the rotating files
+    sentry_stringbuilder_t mpack_buf;
+    sentry__stringbuilder_init(&mpack_buf);
+    int rv = sentry__ringfile_read(data->breadcrumb_ring, &mpack_buf);
+    if (rv == 0) {
+        rv = sentry__path_write_buffer(data->breadcrumb1_path, mpack_buf.buf,
+            sentry__stringbuilder_len(&mpack_buf));
+    }
+    sentry__stringbuilder_cleanup(&mpack_buf);
     if (rv != 0) {
-        SENTRY_DEBUG("flushing scope to msgpack failed");
+        SENTRY_DEBUG("writing breadcrumbs from the ring file failed");
     }
 }
 
-#if defined(SENTRY_PLATFORM_LINUX) || defined(SENTRY_PLATFORM_WINDOWS)
 #    ifdef SENTRY_PLATFORM_WINDOWS
 static bool
 sentry__crashpad_handler(EXCEPTION_POINTERS *ExceptionInfo)
@@ -139,10 +216,27 @@ sentry__crashpad_handler(int signum, siginfo_t *info, ucontext_t *user_context)
 #    endif
     SENTRY_DEBUG("flushing session and queue before crashpad handler");
 
+    // the buffered breadcrumbs are written along with the scope below
+    sentry__breadcrumbs_flush();
+
     bool should_dump = true;
     sentry_value_t event = sentry_value_new_event();
 
     SENTRY_WITH_OPTIONS (options) {
+        // write any scope changes that are still pending. The scope worker
+        // may be writing concurrently, since locks are bypassed in here, so
+        // this uses its own buffer instead of `mpack_buf`.
+        crashpad_state_t *data = (crashpad_state_t *)options->backend->data;
+        if (data->event_path && sentry__atomic_store(&data->scope_dirty, 0)) {
+            sentry_stringbuilder_t mpack_buf;
+            sentry__stringbuilder_init(&mpack_buf);
+            write_scope(data, options, &mpack_buf);
+            sentry__stringbuilder_cleanup(&mpack_buf);
+        }
+        if (data->breadcrumb_ring) {
+            write_breadcrumb_ring(data);
+        }
+
 
         if (options->on_crash_func) {
             sentry_ucontext_t uctx;
@@ -232,6 +326,43 @@ sentry__crashpad_handler(int signum, siginfo_t *info, ucontext_t *user_context)
 }
 #endif
 
+static void
+insert_minidump_range(void *start, size_t size, void *data)
+{
+    crashpad::SimpleAddressRangeBag *extra_memory
+        = (crashpad::SimpleAddressRangeBag *)data;
+    if (!extra_memory->Insert(start, size)) {
+        SENTRY_DEBUG("too many memory ranges to include in the minidump");
+    }
+}
+
+static void
+configure_minidump_content(
+    crashpad_state_t *data, const sentry_options_t *options)
+{
+    crashpad::CrashpadInfo *crashpad_info
+        = crashpad::CrashpadInfo::GetCrashpadInfo();
+    if (options->minidump_mode != SENTRY_MINIDUMP_MODE_STACK_ONLY) {
+        if (options->minidump_mode == SENTRY_MINIDUMP_MODE_FULL) {
+            SENTRY_WARN("crashpad can not write full minidumps, writing "
+                        "minidumps with referenced memory instead");
+        }
+        uint32_t limit = options->minidump_max_size
+                && options->minidump_max_size < UINT32_MAX
+            ? (uint32_t)options->minidump_max_size
+            : UINT32_MAX;
+        crashpad_info->set_gather_indirectly_referenced_memory(
+            crashpad::TriState::kEnabled, limit);
+    }
+
+    if (options->minidump_modules && !data->extra_memory) {
+        data->extra_memory = new crashpad::SimpleAddressRangeBag();
+        sentry__backend_foreach_minidump_range(
+            options, insert_minidump_range, data->extra_memory);
+        crashpad_info->set_extra_memory_ranges(data->extra_memory);
+    }
+}
+
 static int
 sentry__crashpad_backend_startup(
     sentry_backend_t *backend, const sentry_options_t *options)
@@ -301,6 +432,18 @@ sentry__crashpad_backend_startup(
     sentry__path_touch(data->breadcrumb1_path);
     sentry__path_touch(data->breadcrumb2_path);
 
+#if defined(SENTRY_PLATFORM_LINUX) || defined(SENTRY_PLATFORM_WINDOWS)
+    if (options->max_breadcrumbs) {
+        sentry_path_t *ring_path = sentry__path_join_str(
+            current_run_folder, "__sentry-breadcrumbs.ring");
+        if (ring_path) {
+            data->breadcrumb_ring = sentry__ringfile_new(ring_path,
+                options->max_breadcrumbs, SENTRY_BREADCRUMB_SLOT_SIZE);
+            sentry__path_free(ring_path);
+        }
+    }
+#endif
+
     attachments.push_back(base::FilePath(data->event_path->path));
     attachments.push_back(base::FilePath(data->breadcrumb1_path->path));
     attachments.push_back(base::FilePath(data->breadcrumb2_path->path));
@@ -357,6 +500,18 @@ sentry__crashpad_backend_startup(
 
     sentry__path_free(absolute_handler_path);
 
+    if (success && options->scope_flush_delay) {
+        data->options = options;
+        data->scope_worker = sentry__bgworker_new(data, NULL);
+        if (data->scope_worker) {
+            sentry__bgworker_setname(data->scope_worker, "sentry-scope");
+            if (sentry__bgworker_start(data->scope_worker) != 0) {
+                sentry__bgworker_decref(data->scope_worker);
+                data->scope_worker = nullptr;
+            }
+        }
+    }
+
     if (success) {
         SENTRY_DEBUG("started crashpad client handler");
     } else {
@@ -384,6 +539,8 @@ sentry__crashpad_backend_startup(
     }
 #endif
 
+    configure_minidump_content(data, options);
+
     if (!options->system_crash_reporter_enabled) {
         // Disable the system crash reporter. Especially on macOS, it takes
         // substantial time *after* crashpad has done its job.
@@ -408,6 +565,18 @@ sentry__crashpad_backend_shutdown(sentry_backend_t *backend)
 #endif
 
     crashpad_state_t *data = (crashpad_state_t *)backend->data;
+    if (data->scope_worker) {
+        // pending writes are dropped on shutdown, so do them right here
+        if (sentry__bgworker_shutdown(
+                data->scope_worker, data->options->shutdown_timeout)
+            == 0) {
+            sentry__bgworker_decref(data->scope_worker);
+        }
+        data->scope_worker = nullptr;
+        if (sentry__atomic_store(&data->scope_dirty, 0)) {
+            flush_scope_now(data, data->options);
+        }
+    }
     delete data->db;
     data->db = nullptr;
 
@@ -420,8 +589,9 @@ sentry__crashpad_backend_shutdown(sentry_backend_t *backend)
 }
 
 static void
-sentry__crashpad_backend_add_breadcrumb(sentry_backend_t *backend,
-    sentry_value_t breadcrumb, const sentry_options_t *options)
+sentry__crashpad_backend_add_breadcrumbs(sentry_backend_t *backend,
+    const sentry_value_t *breadcrumbs, size_t count,
+    const sentry_options_t *options)
 {
     crashpad_state_t *data = (crashpad_state_t *)backend->data;
 
@@ -430,27 +600,56 @@ sentry__crashpad_backend_add_breadcrumb(sentry_backend_t *backend,
         return;
     }
 
-    bool first_breadcrumb = data->num_breadcrumbs % max_breadcrumbs == 0;
-
-    const sentry_path_t *breadcrumb_file
-        = data->num_breadcrumbs % (max_breadcrumbs * 2) < max_breadcrumbs
-        ? data->breadcrumb1_path
-        : data->breadcrumb2_path;
-    data->num_breadcrumbs++;
-    if (!breadcrumb_file) {
+    if (data->breadcrumb_ring) {
+        int rv = 0;
+        sentry__mutex_lock(&data->mpack_lock);
+        for (size_t i = 0; i < count && rv == 0; i++) {
+            sentry__stringbuilder_set_len(&data->mpack_buf, 0);
+            rv = sentry__value_append_msgpack(&data->mpack_buf, breadcrumbs[i]);
+            if (rv == 0) {
+                rv = sentry__ringfile_append(data->breadcrumb_ring,
+                    data->mpack_buf.buf,
+                    sentry__stringbuilder_len(&data->mpack_buf));
+            }
+        }
+        sentry__mutex_unlock(&data->mpack_lock);
+        if (rv != 0) {
+            SENTRY_DEBUG("breadcrumb does not fit into the ring file");
+        }
         return;
     }
 
-    size_t mpack_size;
-    char *mpack = sentry_value_to_msgpack(breadcrumb, &mpack_size);
-    if (!mpack) {
-        return;
+    int rv = 0;
+    sentry__mutex_lock(&data->mpack_lock);
+    while (count && rv == 0) {
+        bool first_breadcrumb = data->num_breadcrumbs % max_breadcrumbs == 0;
+        const sentry_path_t *breadcrumb_file
+            = data->num_breadcrumbs % (max_breadcrumbs * 2) < max_breadcrumbs
+            ? data->breadcrumb1_path
+            : data->breadcrumb2_path;
+
+        // the breadcrumbs that go into the same file are written at once
+        size_t len = max_breadcrumbs - data->num_breadcrumbs % max_breadcrumbs;
+        if (len > count) {
+            len = count;
+        }
+        data->num_breadcrumbs += len;
+        sentry__stringbuilder_set_len(&data->mpack_buf, 0);
+        for (size_t i = 0; i < len && rv == 0; i++) {
+            rv = sentry__value_append_msgpack(&data->mpack_buf, breadcrumbs[i]);
+        }
+        breadcrumbs += len;
+        count -= len;
+        if (rv == 0 && breadcrumb_file) {
+            const char *mpack = data->mpack_buf.buf;
+            size_t mpack_size = sentry__stringbuilder_len(&data->mpack_buf);
+            rv = first_breadcrumb
+                ? sentry__path_write_buffer(breadcrumb_file, mpack, mpack_size)
+                : sentry__path_append_buffer(
+                      breadcrumb_file, mpack, mpack_size);
+        }
     }
-
-    int rv = first_breadcrumb
-        ? sentry__path_write_buffer(breadcrumb_file, mpack, mpack_size)
-        : sentry__path_append_buffer(breadcrumb_file, mpack, mpack_size);
-    sentry_free(mpack);
+    sentry__mutex_unlock(&data->mpack_lock);
 
     if (rv != 0) {
         SENTRY_DEBUG("flushing breadcrumb to msgpack failed");
@@ -461,9 +660,17 @@ static void
 sentry__crashpad_backend_free(sentry_backend_t *backend)
 {
     crashpad_state_t *data = (crashpad_state_t *)backend->data;
+    if (data->extra_memory) {
+        crashpad::CrashpadInfo::GetCrashpadInfo()->set_extra_memory_ranges(
+            nullptr);
+        delete data->extra_memory;
+    }
     sentry__path_free(data->event_path);
     sentry__path_free(data->breadcrumb1_path);
     sentry__path_free(data->breadcrumb2_path);
+    sentry__ringfile_free(data->breadcrumb_ring);
+    sentry__stringbuilder_cleanup(&data->mpack_buf);
+    sentry__mutex_free(&data->mpack_lock);
     sentry_free(data);
 }
 
@@ -545,13 +752,15 @@ sentry__backend_new(void)
         return NULL;
     }
     memset(data, 0, sizeof(crashpad_state_t));
+    sentry__stringbuilder_init(&data->mpack_buf);
+    sentry__mutex_init(&data->mpack_lock);
 
     backend->startup_func = sentry__crashpad_backend_startup;
     backend->shutdown_func = sentry__crashpad_backend_shutdown;
     backend->except_func = sentry__crashpad_backend_except;
     backend->free_func = sentry__crashpad_backend_free;
     backend->flush_scope_func = sentry__crashpad_backend_flush_scope;
-    backend->add_breadcrumb_func = sentry__crashpad_backend_add_breadcrumb;
+    backend->add_breadcrumbs_func = sentry__crashpad_backend_add_breadcrumbs;
     backend->user_consent_changed_func
         = sentry__crashpad_backend_user_consent_changed;
     backend->get_last_crash_func = sentry__crashpad_backend_last_crash;
@@ -2,15 +2,21 @@
 
 #include "sentry_alloc.h"
 #include "sentry_backend.h"
+#include "sentry_breadcrumb.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
 #include "sentry_envelope.h"
+#include "sentry_json.h"
+#include "sentry_modulefinder.h"
 #include "sentry_options.h"
 #include "sentry_scope.h"
+#include "sentry_session.h"
 #include "sentry_sync.h"
+#include "sentry_tracepoint.h"
 #include "sentry_transport.h"
 #include "sentry_unix_pageallocator.h"
-#include "transports/sentry_disk_transport.h"
+#include "sentry_unwinder.h"
+#include "sentry_utils.h"
 #include <string.h>
 
 #define SIGNAL_DEF(Sig, Desc)                                                  \
@@ -20,6 +26,8 @@
 
 #define MAX_FRAMES 128
 
+static void free_crash_skeleton(void);
+
 #ifdef SENTRY_PLATFORM_UNIX
 struct signal_slot {
     int signum;
@@ -74,8 +82,12 @@ invoke_signal_handler(int signum, siginfo_t *info, void *user_context)
 
 static int
 startup_inproc_backend(
-    sentry_backend_t *UNUSED(backend), const sentry_options_t *UNUSED(options))
+    sentry_backend_t *UNUSED(backend), const sentry_options_t *options)
 {
+    if (!sentry__run_prepare_crash_envelope(options->run)) {
+        SENTRY_DEBUG("failed to prepare the crash envelope file");
+    }
+
     // save the old signal handlers
     memset(g_previous_handlers, 0, sizeof(g_previous_handlers));
     for (size_t i = 0; i < SIGNAL_COUNT; ++i) {
@@ -112,6 +124,7 @@ shutdown_inproc_backend(sentry_backend_t *UNUSED(backend))
     sentry_free(g_signal_stack.ss_sp);
     g_signal_stack.ss_sp = NULL;
     reset_signal_handlers();
+    free_crash_skeleton();
 }
 
 #elif defined(SENTRY_PLATFORM_WINDOWS)
@@ -153,8 +166,12 @@ static LONG WINAPI handle_exception(EXCEPTION_POINTERS *);
 
 static int
 startup_inproc_backend(
-    sentry_backend_t *UNUSED(backend), const sentry_options_t *UNUSED(options))
+    sentry_backend_t *UNUSED(backend), const sentry_options_t *options)
 {
+    if (!sentry__run_prepare_crash_envelope(options->run)) {
+        SENTRY_DEBUG("failed to prepare the crash envelope file");
+    }
+
     g_previous_handler = SetUnhandledExceptionFilter(&handle_exception);
     SetErrorMode(SEM_FAILCRITICALERRORS);
     return 0;
@@ -168,6 +185,7 @@ shutdown_inproc_backend(sentry_backend_t *UNUSED(backend))
     if (current_handler != &handle_exception) {
         SetUnhandledExceptionFilter(current_handler);
     }
+    free_crash_skeleton();
 }
 
 #endif
@@ -492,9 +510,244 @@ make_signal_event(
     return event;
 }
 
+/**
+ * The parts of a crash event that do not depend on the crash itself are kept
+ * serialized while the process runs, so that the signal handler only needs to
+ * serialize the exception and its stacktrace. The scope is serialized on every
+ * change to it, and the modules whenever the list of modules changes.
+ */
+static sentry_mutex_t g_skeleton_lock = SENTRY__MUTEX_INIT;
+static char *g_skeleton_scope = NULL;
+static char *g_skeleton_images = NULL;
+static sentry_value_t g_skeleton_modules = { 0 };
+
+/**
+ * Serializes the members of `object` without the surrounding braces, or
+ * returns NULL if it has none. The members that come from the scope are
+ * spliced in from their cached JSON.
+ */
+static char *
+serialize_members(sentry_value_t object)
+{
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    if (!jw) {
+        return NULL;
+    }
+    sentry__jsonwriter_write_event(jw, object, 0);
+    size_t len = 0;
+    char *json = sentry__jsonwriter_into_string(jw, &len);
+    if (!json || len <= 2) {
+        sentry_free(json);
+        return NULL;
+    }
+    memmove(json, json + 1, len - 2);
+    json[len - 2] = '\0';
+    return json;
+}
+
+static char *
+serialize_images(sentry_value_t modules)
+{
+    sentry_value_t debug_meta = sentry_value_new_object();
+    sentry_value_incref(modules);
+    sentry_value_set_by_key(debug_meta, "images", modules);
+    sentry_value_t members = sentry_value_new_object();
+    sentry_value_set_by_key(members, "debug_meta", debug_meta);
+    char *rv = serialize_members(members);
+    sentry_value_decref(members);
+    return rv;
+}
+
+static void
+update_crash_skeleton(const sentry_options_t *options)
+{
+    if (!options->precomputed_crash_event) {
+        return;
+    }
+
+    sentry__mutex_lock(&g_skeleton_lock);
+
+    sentry_value_t skeleton = sentry_value_new_object();
+    SENTRY_WITH_SCOPE (scope) {
+        sentry__scope_apply_to_event(
+            scope, options, skeleton, SENTRY_SCOPE_BREADCRUMBS);
+    }
+    // the crash event comes with both of these
+    sentry_value_remove_by_key(skeleton, "platform");
+    sentry_value_remove_by_key(skeleton, "level");
+    sentry_free(g_skeleton_scope);
+    g_skeleton_scope = serialize_members(skeleton);
+    sentry_value_decref(skeleton);
+
+    // the modules are loaded in the background, and we do not want to wait
+    // for them here
+    if (sentry__modulefinder_get_memory_usage()) {
+        sentry_value_t modules = sentry_get_modules_list();
+        if (modules._bits != g_skeleton_modules._bits) {
+            sentry_free(g_skeleton_images);
+            g_skeleton_images = serialize_images(modules);
+            sentry_value_decref(g_skeleton_modules);
+            g_skeleton_modules = modules;
+        } else {
+            sentry_value_decref(modules);
+        }
+    }
+
+    sentry__mutex_unlock(&g_skeleton_lock);
+}
+
+static void
+free_crash_skeleton(void)
+{
+    sentry__mutex_lock(&g_skeleton_lock);
+    sentry_free(g_skeleton_scope);
+    g_skeleton_scope = NULL;
+    sentry_free(g_skeleton_images);
+    g_skeleton_images = NULL;
+    sentry_value_decref(g_skeleton_modules);
+    g_skeleton_modules._bits = 0;
+    sentry__mutex_unlock(&g_skeleton_lock);
+}
+
+static void
+flush_scope(sentry_backend_t *UNUSED(backend), const sentry_options_t *options)
+{
+    update_crash_skeleton(options);
+}
+
+static void
+add_breadcrumbs(sentry_backend_t *UNUSED(backend),
+    const sentry_value_t *UNUSED(breadcrumbs), size_t UNUSED(count),
+    const sentry_options_t *options)
+{
+    // the breadcrumbs are already part of the scope
+    update_crash_skeleton(options);
+}
+
+/**
+ * Creates the crash envelope out of `event` and the crash skeleton. Returns
+ * false if the skeleton can not be used for this crash, in which case the
+ * `event` is left untouched.
+ */
+static bool
+prepare_precomputed_event(const sentry_options_t *options,
+    sentry_value_t event, sentry_envelope_t **envelope_out)
+{
+    // the hooks need to see the complete event, and the skeleton does not
+    // have the values of the crashing thread
+    if (!options->precomputed_crash_event || options->on_crash_func
+        || options->before_send_func || !g_skeleton_scope
+        || sentry__thread_scope_has_values()) {
+        return false;
+    }
+
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry__stringbuilder_append(&sb, g_skeleton_scope);
+    sentry_value_t modules = sentry_get_modules_list();
+    char *images = NULL;
+    if (!sentry_value_is_null(modules)) {
+        images = modules._bits == g_skeleton_modules._bits
+            ? g_skeleton_images
+            : serialize_images(modules);
+    }
+    if (images) {
+        sentry__stringbuilder_append_char(&sb, ',');
+        sentry__stringbuilder_append(&sb, images);
+        if (images != g_skeleton_images) {
+            sentry_free(images);
+        }
+    }
+    sentry_value_decref(modules);
+
+    sentry__record_errors_on_current_session(1);
+    if (options->symbolize_stacktraces) {
+        sentry__symbolize_stacktraces(event);
+    }
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    if (!envelope
+        || !sentry__envelope_add_event_with_members(
+            envelope, event, sb.buf, sb.len)) {
+        sentry_envelope_free(envelope);
+        sentry_value_decref(event);
+        envelope = NULL;
+    } else {
+        sentry__envelope_add_attachments(envelope, options);
+    }
+    sentry__stringbuilder_cleanup(&sb);
+
+    *envelope_out = envelope;
+    return true;
+}
+
+#ifdef SENTRY_PLATFORM_LINUX
+#    define MAX_CAPTURED_THREADS 64
+// how long each thread has to respond to the capture
+#    define THREAD_RESPONSE_TIMEOUT_MS 20
+
+struct thread_capture_state {
+    sentry_value_t event;
+    sentry_value_t exception;
+    long current_tid;
+    size_t thread_count;
+};
+
+static bool
+capture_thread(long tid, void *data)
+{
+    struct thread_capture_state *state = (struct thread_capture_state *)data;
+    char name_buf[16];
+    sentry_value_t thread = sentry_value_new_thread(
+        (uint64_t)tid, sentry__unwinder_thread_name(tid, name_buf));
+
+    if (tid == state->current_tid) {
+        // the stack of the crashing thread is already part of the exception
+        sentry_value_set_by_key(thread, "crashed", sentry_value_new_bool(true));
+        sentry_value_set_by_key(thread, "current", sentry_value_new_bool(true));
+        sentry_value_t thread_id = sentry_value_get_by_key(thread, "id");
+        sentry_value_incref(thread_id);
+        sentry_value_set_by_key(state->exception, "thread_id", thread_id);
+    } else {
+        void *backtrace[MAX_FRAMES];
+        size_t frame_count = sentry__unwind_thread(
+            tid, &backtrace[0], MAX_FRAMES, THREAD_RESPONSE_TIMEOUT_MS);
+        if (frame_count) {
+            sentry_value_set_stacktrace(thread, &backtrace[0], frame_count);
+        }
+    }
+
+    sentry_event_add_thread(state->event, thread);
+    return ++state->thread_count < MAX_CAPTURED_THREADS;
+}
+
+/**
+ * Adds all the threads of the process to `event`, along with their stacks.
+ */
+static void
+add_thread_stacks(sentry_value_t event)
+{
+    struct thread_capture_state state;
+    state.event = event;
+    state.exception = sentry_value_get_by_index(
+        sentry_value_get_by_key(sentry_value_get_by_key(event, "exception"),
+            "values"),
+        0);
+    state.current_tid = sentry__unwinder_current_tid();
+    state.thread_count = 0;
+
+    sentry__unwinder_threads_begin();
+    sentry__unwinder_foreach_thread(capture_thread, &state);
+    sentry__unwinder_threads_end();
+
+    SENTRY_TRACEF("captured the stacks of %zu threads", state.thread_count);
+}
+#endif
+
 static void
 handle_ucontext(const sentry_ucontext_t *uctx)
 {
+    SENTRY_CRASH_TRACEPOINT(crash__start);
     SENTRY_DEBUG("entering signal handler");
 
     const struct signal_slot *sig_slot = NULL;
@@ -521,11 +774,22 @@ handle_ucontext(const sentry_ucontext_t *uctx)
     sentry__enter_signal_handler();
 #endif
 
+    // the buffered breadcrumbs are added before the scope becomes part of the
+    // crash event
+    sentry__breadcrumbs_flush();
+
     sentry_value_t event = make_signal_event(sig_slot, uctx);
+    SENTRY_CRASH_TRACEPOINT(crash__event);
 
     SENTRY_WITH_OPTIONS (options) {
         sentry__write_crash_marker(options);
 
+#ifdef SENTRY_PLATFORM_LINUX
+        if (options->capture_all_threads) {
+            add_thread_stacks(event);
+        }
+#endif
+
         bool should_handle = true;
 
         if (options->on_crash_func) {
@@ -535,8 +799,11 @@ handle_ucontext(const sentry_ucontext_t *uctx)
         }
 
         if (should_handle) {
-            sentry_envelope_t *envelope = sentry__prepare_event(
-                options, event, NULL, !options->on_crash_func);
+            sentry_envelope_t *envelope = NULL;
+            if (!prepare_precomputed_event(options, event, &envelope)) {
+                envelope = sentry__prepare_event(
+                    options, event, NULL, !options->on_crash_func);
+            }
             // TODO(tracing): Revisit when investigating transaction flushing
             // during hard crashes.
 
@@ -544,12 +811,13 @@ handle_ucontext(const sentry_ucontext_t *uctx)
                 SENTRY_SESSION_STATUS_CRASHED);
             sentry__envelope_add_session(envelope, session);
 
-            // capture the envelope with the disk transport
-            sentry_transport_t *disk_transport
-                = sentry_new_disk_transport(options->run);
-            sentry__capture_envelope(disk_transport, envelope);
-            sentry__transport_dump_queue(disk_transport, options->run);
-            sentry_transport_free(disk_transport);
+            // write the envelope into the file that was opened at startup
+            if (sentry__should_skip_upload()) {
+                SENTRY_TRACE("discarding envelope due to missing user consent");
+            } else if (envelope) {
+                sentry__run_write_crash_envelope(options->run, envelope);
+            }
+            sentry_envelope_free(envelope);
         } else {
             SENTRY_TRACE("event was discarded by the `on_crash` hook");
             sentry_value_decref(event);
@@ -560,6 +828,15 @@ handle_ucontext(const sentry_ucontext_t *uctx)
     }
 
     SENTRY_DEBUG("crash has been captured");
+    SENTRY_CRASH_TRACEPOINT(crash__end);
+
+#ifdef SENTRY_PLATFORM_UNIX
+    sentry_page_allocator_stats_t stats;
+    sentry__page_allocator_get_stats(&stats);
+    SENTRY_DEBUGF("handling the crash used up to %zu bytes, with %zu bytes "
+                  "mapped",
+        stats.high_water_mark, stats.mapped);
+#endif
 
 #ifdef SENTRY_PLATFORM_UNIX
     // reset signal handlers and invoke the original ones.  This will then tear
@@ -619,6 +896,9 @@ sentry__backend_new(void)
     backend->startup_func = startup_inproc_backend;
     backend->shutdown_func = shutdown_inproc_backend;
     backend->except_func = handle_except;
+    backend->flush_scope_func = flush_scope;
+    backend->add_breadcrumbs_func = add_breadcrumbs;
+    backend->restart_after_fork = true;
 
     return backend;
 }
@@ -1,6 +1,10 @@
 #include "sentry_integration_qt.h"
 #include "sentry_boot.h"
 
+extern "C" {
+#include "sentry_breadcrumb.h"
+}
+
 #include <QtCore/qglobal.h>
 #include <QtCore/qstring.h>
 
@@ -44,7 +48,8 @@ sentry_qt_messsage_handler(
         location, "line", sentry_value_new_int32(context.line));
     sentry_value_set_by_key(crumb, "data", location);
 
-    sentry_add_breadcrumb(crumb);
+    // this adds it right away, unless buffering is enabled
+    sentry__breadcrumbs_add_buffered(crumb);
 
     // Don't interfere with normal logging, by forwarding
     // to any existing message handlers.
@@ -0,0 +1,138 @@
+#include "sentry_modulefinder.h"
+
+#include "sentry_alloc.h"
+#include "sentry_sync.h"
+#include "sentry_value.h"
+
+#include <stdlib.h>
+
+struct sentry_module_index_s {
+    volatile long refcount;
+    sentry_value_t modules;
+    size_t len;
+    sentry_module_range_t *ranges;
+};
+
+// the index of the most recent modules list, which is rebuilt whenever the
+// modules list changes
+static sentry_mutex_t g_index_lock = SENTRY__MUTEX_INIT;
+static sentry_module_index_t *g_index = NULL;
+
+static int
+compare_module_ranges(const void *a, const void *b)
+{
+    uint64_t start_a = ((const sentry_module_range_t *)a)->start;
+    uint64_t start_b = ((const sentry_module_range_t *)b)->start;
+    return start_a < start_b ? -1 : start_a > start_b ? 1 : 0;
+}
+
+static sentry_module_index_t *
+module_index_new(sentry_value_t modules)
+{
+    size_t len = sentry_value_get_length(modules);
+    // the ranges are allocated along with the index
+    sentry_module_index_t *index = sentry_malloc(
+        sizeof(sentry_module_index_t) + sizeof(sentry_module_range_t) * len);
+    if (!index) {
+        return NULL;
+    }
+    index->refcount = 1;
+    index->ranges = (sentry_module_range_t *)(index + 1);
+    index->len = 0;
+    for (size_t i = 0; i < len; i++) {
+        sentry_value_t module = sentry_value_get_by_index(modules, i);
+        uint64_t image_addr = sentry__value_as_addr(
+            sentry_value_get_by_key(module, "image_addr"));
+        uint32_t image_size = (uint32_t)sentry_value_as_int32(
+            sentry_value_get_by_key(module, "image_size"));
+        if (!image_addr || !image_size) {
+            continue;
+        }
+        sentry_module_range_t *range = &index->ranges[index->len++];
+        range->start = image_addr;
+        range->end = image_addr + image_size;
+        range->index = i;
+    }
+    qsort(index->ranges, index->len, sizeof(sentry_module_range_t),
+        compare_module_ranges);
+    sentry_value_incref(modules);
+    index->modules = modules;
+    return index;
+}
+
+sentry_module_index_t *
+sentry__module_index_get(sentry_value_t modules)
+{
+    if (sentry_value_get_type(modules) != SENTRY_VALUE_TYPE_LIST) {
+        return NULL;
+    }
+    sentry__mutex_lock(&g_index_lock);
+    if (!g_index || g_index->modules._bits != modules._bits) {
+        sentry_module_index_t *index = module_index_new(modules);
+        if (index) {
+            sentry__module_index_decref(g_index);
+            g_index = index;
+        }
+    }
+    sentry_module_index_t *index = g_index;
+    if (index && index->modules._bits == modules._bits) {
+        sentry__atomic_fetch_and_add(&index->refcount, 1);
+    } else {
+        index = NULL;
+    }
+    sentry__mutex_unlock(&g_index_lock);
+    return index;
+}
+
+void
+sentry__module_index_decref(sentry_module_index_t *index)
+{
+    if (!index || sentry__atomic_fetch_and_add(&index->refcount, -1) != 1) {
+        return;
+    }
+    sentry_value_decref(index->modules);
+    sentry_free(index);
+}
+
+const sentry_module_range_t *
+sentry__module_index_find(const sentry_module_index_t *index, uint64_t addr)
+{
+    if (!index) {
+        return NULL;
+    }
+    // find the last module starting at or before `addr`
+    size_t lo = 0;
+    size_t hi = index->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->ranges[mid].start <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (!lo || addr >= index->ranges[lo - 1].end) {
+        return NULL;
+    }
+    return &index->ranges[lo - 1];
+}
+
+sentry_value_t
+sentry__module_index_find_module(
+    const sentry_module_index_t *index, uint64_t addr)
+{
+    const sentry_module_range_t *range = sentry__module_index_find(index, addr);
+    if (!range) {
+        return sentry_value_new_null();
+    }
+    return sentry_value_get_by_index(index->modules, range->index);
+}
+
+void
+sentry__module_index_cleanup(void)
+{
+    sentry__mutex_lock(&g_index_lock);
+    sentry__module_index_decref(g_index);
+    g_index = NULL;
+    sentry__mutex_unlock(&g_index_lock);
+}
@@ -1,7 +1,10 @@
 #include "sentry_boot.h"
 
+#include "sentry_alloc.h"
 #include "sentry_core.h"
+#include "sentry_modulefinder.h"
 #include "sentry_string.h"
+#include "sentry_symbolizer.h"
 #include "sentry_sync.h"
 #include "sentry_value.h"
 
@@ -19,6 +22,15 @@ static bool g_initialized = false;
 static sentry_mutex_t g_mutex = SENTRY__MUTEX_INIT;
 static sentry_value_t g_modules = { 0 };
 
+void
+sentry__modulefinder_foreach_writable_range(
+    void (*callback)(const char *name, void *start, size_t size, void *data),
+    void *data)
+{
+    (void)callback;
+    (void)data;
+}
+
 static void
 load_modules(void)
 {
@@ -85,16 +97,21 @@ load_modules(void)
 sentry_value_t
 sentry_get_modules_list(void)
 {
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_MODULEFINDER);
     sentry__mutex_lock(&g_mutex);
     if (!g_initialized) {
+        // the list outlives whatever arena the caller may have entered
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
         g_modules = sentry_value_new_list();
         g_initialized = true;
         load_modules();
+        sentry__value_arena_leave(prev_arena);
         sentry_value_freeze(g_modules);
     }
     sentry_value_t modules = g_modules;
     sentry_value_incref(modules);
     sentry__mutex_unlock(&g_mutex);
+    SENTRY_MEMORY_TAG_LEAVE();
     return modules;
 }
 
@@ -106,4 +123,26 @@ sentry_clear_modulecache(void)
     g_modules = sentry_value_new_null();
     g_initialized = false;
     sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_cleanup(void)
+{
+    sentry_clear_modulecache();
+}
+
+void
+sentry__modulefinder_set_database_path(
+    const sentry_path_t *UNUSED(database_path))
+{
+}
+
+size_t
+sentry__modulefinder_get_memory_usage(void)
+{
+    sentry__mutex_lock(&g_mutex);
+    size_t size = sentry__value_get_memory_usage(g_modules);
+    sentry__mutex_unlock(&g_mutex);
+    return size;
 }
@@ -1,12 +1,16 @@
 #include "sentry_boot.h"
 
+#include "sentry_alloc.h"
 #include "sentry_core.h"
+#include "sentry_modulefinder.h"
 #include "sentry_string.h"
+#include "sentry_symbolizer.h"
 #include "sentry_sync.h"
 #include "sentry_value.h"
 
 #include <dlfcn.h>
 #include <limits.h>
+#include <string.h>
 #include <mach-o/arch.h>
 #include <mach-o/dyld.h>
 #include <mach-o/dyld_images.h>
@@ -30,8 +34,13 @@ typedef struct segment_command_64 mach_segment_command_type;
 #    define seg_size uint64_t
 #endif
 
-static bool g_initialized = false;
+// The dyld callbacks keep `g_images` up to date, and `g_modules` is a frozen
+// snapshot of it that is handed out, which is only taken again once images
+// were added or removed. The callbacks are only registered once, and stay
+// registered as dyld has no way to unregister them.
+static bool g_registered = false;
 static sentry_mutex_t g_mutex = SENTRY__MUTEX_INIT;
+static sentry_value_t g_images = { 0 };
 static sentry_value_t g_modules = { 0 };
 
 static void
@@ -43,6 +52,8 @@ add_image(const struct mach_header *mh, intptr_t UNUSED(vmaddr_slide))
         return;
     }
 
+    // images may be loaded by a thread that entered an arena
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
     sentry_value_t module = sentry_value_new_object();
     sentry_value_set_by_key(module, "type", sentry_value_new_string("macho"));
     sentry_value_set_by_key(
@@ -78,15 +89,11 @@ add_image(const struct mach_header *mh, intptr_t UNUSED(vmaddr_slide))
     }
 
     sentry__mutex_lock(&g_mutex);
-
-    sentry_value_t modules = g_modules;
-    sentry_value_t new_modules = sentry__value_clone(modules);
-    sentry_value_append(new_modules, module);
-    sentry_value_freeze(new_modules);
+    sentry_value_append(g_images, module);
     sentry_value_decref(g_modules);
-    g_modules = new_modules;
-
+    g_modules = sentry_value_new_null();
     sentry__mutex_unlock(&g_mutex);
+    sentry__value_arena_leave(prev_arena);
 }
 
 static void
@@ -98,46 +105,38 @@ remove_image(const struct mach_header *mh, intptr_t UNUSED(vmaddr_slide))
         return;
     }
 
-    sentry__mutex_lock(&g_mutex);
-
-    if (sentry_value_is_null(g_modules)
-        || sentry_value_get_length(g_modules) == 0) {
-        goto done;
-    }
-
     char ref_addr[32];
     snprintf(ref_addr, sizeof(ref_addr), "0x%llx", (long long)info.dli_fbase);
-    sentry_value_t new_modules = sentry_value_new_list();
 
-    for (size_t i = 0; i < sentry_value_get_length(g_modules); i++) {
-        sentry_value_t module = sentry_value_get_by_index(g_modules, i);
+    sentry__mutex_lock(&g_mutex);
+    for (size_t i = 0; i < sentry_value_get_length(g_images); i++) {
+        sentry_value_t module = sentry_value_get_by_index(g_images, i);
         const char *addr = sentry_value_as_string(
             sentry_value_get_by_key(module, "image_addr"));
-        if (!addr || !sentry__string_eq(addr, ref_addr)) {
-            sentry_value_incref(module);
-            sentry_value_append(new_modules, module);
+        if (addr && sentry__string_eq(addr, ref_addr)) {
+            sentry_value_remove_by_index(g_images, i);
+            sentry_value_decref(g_modules);
+            g_modules = sentry_value_new_null();
+            break;
         }
     }
-
-    sentry_value_decref(g_modules);
-    sentry_value_freeze(new_modules);
-    g_modules = new_modules;
-
-done:
     sentry__mutex_unlock(&g_mutex);
 }
 
 sentry_value_t
 sentry_get_modules_list(void)
 {
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_MODULEFINDER);
     // We have 2 locked blocks here (actually 3, with the one inside of the
     // `add_image` callback). We do that because we have observed deadlocks when
     // code concurrently `dlopen`s and thus invokes the `add_image` callback
     // from a different thread.
+    // the lists outlive whatever arena the caller may have entered
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
     sentry__mutex_lock(&g_mutex);
-    if (!g_initialized) {
-        g_modules = sentry_value_new_list();
-        g_initialized = true;
+    if (!g_registered) {
+        g_images = sentry_value_new_list();
+        g_registered = true;
 
         sentry__mutex_unlock(&g_mutex);
 
@@ -152,18 +151,85 @@ sentry_get_modules_list(void)
         sentry__mutex_lock(&g_mutex);
     }
 
+    if (sentry_value_is_null(g_modules)) {
+        g_modules = sentry__value_clone(g_images);
+        sentry_value_freeze(g_modules);
+    }
     sentry_value_t modules = g_modules;
     sentry_value_incref(modules);
     sentry__mutex_unlock(&g_mutex);
+    sentry__value_arena_leave(prev_arena);
+    SENTRY_MEMORY_TAG_LEAVE();
     return modules;
 }
 
 void
 sentry_clear_modulecache(void)
 {
+    // the list of images is always kept up to date by the dyld callbacks, so
+    // only the symbols that were derived from it need to be dropped
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_cleanup(void)
+{
+    // the dyld callbacks can not be unregistered, and will keep updating the
+    // list of images, so only the snapshot is freed
     sentry__mutex_lock(&g_mutex);
     sentry_value_decref(g_modules);
     g_modules = sentry_value_new_null();
-    g_initialized = false;
     sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_set_database_path(
+    const sentry_path_t *UNUSED(database_path))
+{
+}
+
+size_t
+sentry__modulefinder_get_memory_usage(void)
+{
+    sentry__mutex_lock(&g_mutex);
+    size_t size = sentry__value_get_memory_usage(g_images);
+    sentry__mutex_unlock(&g_mutex);
+    return size;
+}
+
+void
+sentry__modulefinder_foreach_writable_range(
+    void (*callback)(const char *name, void *start, size_t size, void *data),
+    void *data)
+{
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++) {
+        const platform_mach_header *header
+            = (const platform_mach_header *)_dyld_get_image_header(i);
+        const char *name = _dyld_get_image_name(i);
+        if (!header || header->magic != MACHO_MAGIC_NUMBER || !name) {
+            continue;
+        }
+        const char *slash = strrchr(name, '/');
+        if (slash) {
+            name = slash + 1;
+        }
+        intptr_t slide = _dyld_get_image_vmaddr_slide(i);
+
+        const struct load_command *cmd
+            = (const struct load_command *)(header + 1);
+        for (uint32_t j = 0; j < header->ncmds; j++) {
+            if (cmd->cmd == CMD_SEGMENT) {
+                const mach_segment_command_type *seg
+                    = (const mach_segment_command_type *)cmd;
+                if ((seg->initprot & VM_PROT_WRITE) && seg->vmsize) {
+                    callback(name, (void *)(uintptr_t)(seg->vmaddr + slide),
+                        (size_t)seg->vmsize, data);
+                }
+            }
+            cmd = (const struct load_command *)((const char *)cmd
+                + cmd->cmdsize);
+        }
+    }
 }
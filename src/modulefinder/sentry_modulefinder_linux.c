@@ -3,17 +3,22 @@
 #endif
 #include "sentry_modulefinder_linux.h"
 
+#include "sentry_alloc.h"
 #include "sentry_core.h"
+#include "sentry_modulefinder.h"
 #include "sentry_path.h"
 #include "sentry_string.h"
+#include "sentry_symbolizer.h"
 #include "sentry_sync.h"
 #include "sentry_value.h"
 
 #include <arpa/inet.h>
 #include <elf.h>
 #include <fcntl.h>
+#include <link.h>
+#include <sched.h>
+#include <stdio.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -37,55 +42,104 @@ process_vm_readv(pid_t __pid, const struct iovec *__local_iov,
     if (!Ptr)                                                                  \
     goto fail
 
-static bool g_initialized = false;
-static sentry_mutex_t g_mutex = SENTRY__MUTEX_INIT;
-static sentry_value_t g_modules = { 0 };
-
-static sentry_slice_t LINUX_GATE = { "linux-gate.so", 13 };
+// `dl_iterate_phdr` only reports the number of loaded and unloaded objects
+// starting with Android R
+#if !defined(__ANDROID_API__) || __ANDROID_API__ >= 30
+#    define SENTRY_HAS_DL_COUNTERS
+#endif
 
-bool
-sentry__mmap_file(sentry_mmap_t *rv, const char *path)
-{
-    int fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        goto fail;
-    }
+/**
+ * A module that was found in an earlier scan. It is identified by the range
+ * and inode of its mappings and its file name, and the module value is
+ * reused as long as the same module is still mapped, so that its ELF headers
+ * do not have to be read again.
+ */
+typedef struct {
+    uint64_t image_addr;
+    uint64_t image_size;
+    uint64_t inode;
+    sentry_value_t value;
+} module_entry_t;
+
+typedef struct {
+    module_entry_t *entries;
+    size_t len;
+    size_t cap;
+} module_registry_t;
 
-    struct stat sb;
-    if (stat(path, &sb) != 0 || !S_ISREG(sb.st_mode)) {
-        goto fail;
-    }
+/**
+ * The number of objects the dynamic loader has loaded and unloaded so far.
+ */
+typedef struct {
+    unsigned long long adds;
+    unsigned long long subs;
+    bool valid;
+} load_counters_t;
 
-    rv->len = sb.st_size;
-    if (rv->len == 0) {
-        goto fail;
-    }
+#define BUILD_ID_CACHE_HEADER "sentry-build-ids 1\n"
+#define BUILD_ID_CACHE_MAX_ENTRIES 2048
 
-    rv->ptr = mmap(NULL, rv->len, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (rv->ptr == MAP_FAILED) {
-        goto fail;
-    }
+/**
+ * The identifiers of a module file as they were read by an earlier process.
+ * A file is identified by its device, inode, size and modification time, and
+ * the offset at which the module starts within the file.
+ */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t offset;
+    char debug_id[37];
+    // the hex encoded code id, or empty for modules without a build-id
+    char code_id[129];
+    bool used;
+} build_id_entry_t;
 
-    close(fd);
+/**
+ * The build-id cache, which lives in the database directory so that the
+ * identifiers of unchanged files are not read (or hashed) again for every
+ * process.
+ */
+typedef struct {
+    sentry_path_t *path;
+    build_id_entry_t *entries;
+    size_t len;
+    size_t cap;
+    bool loaded;
+    bool dirty;
+} build_id_cache_t;
 
-    return true;
+/**
+ * An immutable module list, along with the load counters it was read at.
+ */
+typedef struct {
+    sentry_value_t modules;
+    load_counters_t counters;
+} modules_snapshot_t;
+
+// the current snapshot is read without any lock. The readers announce
+// themselves in the counter of the current epoch, and a replaced snapshot is
+// freed once the readers of its epoch are gone.
+static modules_snapshot_t *volatile g_snapshot = NULL;
+static volatile long g_epoch = 0;
+static volatile long g_readers[2] = { 0, 0 };
+// whether a thread is reading the modules for a new snapshot
+static volatile long g_refreshing = 0;
+// serializes the threads that replace the snapshot
+static sentry_mutex_t g_mutex = SENTRY__MUTEX_INIT;
+static module_registry_t g_registry = { NULL, 0, 0 };
+static build_id_cache_t g_build_ids = { NULL, NULL, 0, 0, false, false };
+// modules are identified concurrently, so the cache has its own lock
+static sentry_mutex_t g_build_ids_lock = SENTRY__MUTEX_INIT;
 
-fail:
-    if (fd > 0) {
-        close(fd);
-    }
-    rv->ptr = NULL;
-    rv->len = 0;
-    return false;
-}
+// the maximum number of threads that read the identifiers of modules
+#define MAX_IDENTIFY_THREADS 4
+// the minimum number of modules each of the threads should identify
+#define MIN_MODULES_PER_THREAD 8
 
-void
-sentry__mmap_close(sentry_mmap_t *m)
-{
-    munmap(m->ptr, m->len);
-    m->ptr = NULL;
-    m->len = 0;
-}
+static sentry_slice_t LINUX_GATE = { "linux-gate.so", 13 };
 
 /**
  * Checks that `start_offset` + `size` is a valid contiguous mapping in the
@@ -461,13 +515,232 @@ sentry__procmaps_read_ids_from_elf(
     return true;
 }
 
+static build_id_entry_t *
+build_id_cache_push(build_id_cache_t *cache)
+{
+    if (cache->len == cache->cap) {
+        if (cache->cap >= BUILD_ID_CACHE_MAX_ENTRIES) {
+            return NULL;
+        }
+        size_t cap = cache->cap ? cache->cap * 2 : 64;
+        build_id_entry_t *entries
+            = sentry_malloc(sizeof(build_id_entry_t) * cap);
+        if (!entries) {
+            return NULL;
+        }
+        if (cache->len) {
+            memcpy(entries, cache->entries,
+                sizeof(build_id_entry_t) * cache->len);
+        }
+        sentry_free(cache->entries);
+        cache->entries = entries;
+        cache->cap = cap;
+    }
+    build_id_entry_t *entry = &cache->entries[cache->len++];
+    memset(entry, 0, sizeof(build_id_entry_t));
+    return entry;
+}
+
+static void
+build_id_cache_load(build_id_cache_t *cache)
+{
+    cache->loaded = true;
+    size_t len = 0;
+    char *contents = sentry__path_read_to_buffer(cache->path, &len);
+    if (!contents) {
+        return;
+    }
+    size_t header_len = strlen(BUILD_ID_CACHE_HEADER);
+    if (len < header_len
+        || memcmp(contents, BUILD_ID_CACHE_HEADER, header_len) != 0) {
+        sentry_free(contents);
+        return;
+    }
+
+    char *line = contents + header_len;
+    while (*line) {
+        char *nl = strchr(line, '\n');
+        if (nl) {
+            *nl = '\0';
+        }
+        build_id_entry_t entry;
+        memset(&entry, 0, sizeof(build_id_entry_t));
+        // a missing code id is written as `-`
+        if (sscanf(line,
+                "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNd64
+                " %" SCNu64 " %36s %128s",
+                &entry.dev, &entry.ino, &entry.size, &entry.mtime_sec,
+                &entry.mtime_nsec, &entry.offset, entry.debug_id,
+                entry.code_id)
+            == 8) {
+            if (sentry__string_eq(entry.code_id, "-")) {
+                entry.code_id[0] = '\0';
+            }
+            build_id_entry_t *slot = build_id_cache_push(cache);
+            if (slot) {
+                *slot = entry;
+            }
+        }
+        if (!nl) {
+            break;
+        }
+        line = nl + 1;
+    }
+    sentry_free(contents);
+}
+
+static void
+build_id_cache_save(build_id_cache_t *cache)
+{
+    if (!cache->path || !cache->dirty) {
+        return;
+    }
+    cache->dirty = false;
+
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry__stringbuilder_append(&sb, BUILD_ID_CACHE_HEADER);
+    // entries which were used by this process go first, so that those are
+    // kept once the cache grows beyond its limit
+    for (int used = 1; used >= 0; used--) {
+        for (size_t i = 0; i < cache->len; i++) {
+            const build_id_entry_t *entry = &cache->entries[i];
+            if (entry->used != (bool)used) {
+                continue;
+            }
+            char line[256];
+            int written = snprintf(line, sizeof(line),
+                "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRId64 " %" PRId64
+                " %" PRIu64 " %s %s\n",
+                entry->dev, entry->ino, entry->size, entry->mtime_sec,
+                entry->mtime_nsec, entry->offset, entry->debug_id,
+                entry->code_id[0] ? entry->code_id : "-");
+            if (written > 0 && (size_t)written < sizeof(line)) {
+                sentry__stringbuilder_append_buf(&sb, line, (size_t)written);
+            }
+        }
+    }
+
+    // write to a temporary file first, so that concurrently starting processes
+    // never read a partially written cache
+    char tmp_name[64];
+    snprintf(tmp_name, sizeof(tmp_name), ".build-ids-%d.tmp", (int)getpid());
+    size_t len = sentry__stringbuilder_len(&sb);
+    char *contents = sentry__stringbuilder_into_string(&sb);
+    sentry_path_t *dir = sentry__path_dir(cache->path);
+    sentry_path_t *tmp_path = dir ? sentry__path_join_str(dir, tmp_name) : NULL;
+    if (contents && tmp_path
+        && sentry__path_write_buffer(tmp_path, contents, len) == 0
+        && rename(tmp_path->path, cache->path->path) != 0) {
+        sentry__path_remove(tmp_path);
+    }
+    sentry__path_free(tmp_path);
+    sentry__path_free(dir);
+    sentry_free(contents);
+}
+
+static bool
+build_id_key(build_id_entry_t *key, const sentry_path_t *path,
+    const sentry_module_t *module)
+{
+    struct stat st;
+    if (stat(path->path, &st) != 0) {
+        return false;
+    }
+    memset(key, 0, sizeof(build_id_entry_t));
+    key->dev = (uint64_t)st.st_dev;
+    key->ino = (uint64_t)st.st_ino;
+    key->size = (uint64_t)st.st_size;
+    key->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    key->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    key->offset = module->offset_in_inode;
+    return true;
+}
+
+static bool
+build_id_cache_lookup(
+    build_id_cache_t *cache, const build_id_entry_t *key, sentry_value_t value)
+{
+    if (!cache->path) {
+        return false;
+    }
+    if (!cache->loaded) {
+        build_id_cache_load(cache);
+    }
+    for (size_t i = 0; i < cache->len; i++) {
+        build_id_entry_t *entry = &cache->entries[i];
+        if (entry->dev == key->dev && entry->ino == key->ino
+            && entry->size == key->size && entry->mtime_sec == key->mtime_sec
+            && entry->mtime_nsec == key->mtime_nsec
+            && entry->offset == key->offset) {
+            if (!entry->used) {
+                entry->used = true;
+                cache->dirty = true;
+            }
+            if (entry->code_id[0]) {
+                sentry_value_set_by_key(
+                    value, "code_id", sentry_value_new_string(entry->code_id));
+            }
+            sentry_value_set_by_key(
+                value, "debug_id", sentry_value_new_string(entry->debug_id));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+build_id_cache_insert(build_id_cache_t *cache, const build_id_entry_t *key,
+    sentry_value_t value)
+{
+    if (!cache->path) {
+        return;
+    }
+    const char *debug_id
+        = sentry_value_as_string(sentry_value_get_by_key(value, "debug_id"));
+    const char *code_id
+        = sentry_value_as_string(sentry_value_get_by_key(value, "code_id"));
+    if (strlen(debug_id) >= sizeof(key->debug_id) || !*debug_id
+        || strlen(code_id) >= sizeof(key->code_id)) {
+        return;
+    }
+
+    build_id_entry_t *entry = build_id_cache_push(cache);
+    if (!entry) {
+        // make room by dropping an entry that this process did not use
+        for (size_t i = 0; i < cache->len; i++) {
+            if (!cache->entries[i].used) {
+                entry = &cache->entries[i];
+                break;
+            }
+        }
+        if (!entry) {
+            return;
+        }
+    }
+    *entry = *key;
+    memcpy(entry->debug_id, debug_id, strlen(debug_id) + 1);
+    memcpy(entry->code_id, code_id, strlen(code_id) + 1);
+    entry->used = true;
+    cache->dirty = true;
+}
+
+static void
+build_id_cache_free(build_id_cache_t *cache)
+{
+    sentry__path_free(cache->path);
+    sentry_free(cache->entries);
+    memset(cache, 0, sizeof(build_id_cache_t));
+}
+
 sentry_value_t
 sentry__procmaps_module_to_value(const sentry_module_t *module)
 {
-    sentry_value_t mod_val = sentry_value_new_object();
+    // type, code_file, image_addr, image_size, code_id and debug_id
+    sentry_value_t mod_val = sentry__value_new_object_with_size(6);
     sentry_value_set_by_key(mod_val, "type", sentry_value_new_string("elf"));
     sentry_value_set_by_key(mod_val, "code_file",
-        sentry__value_new_string_owned(sentry__slice_to_owned(module->file)));
+        sentry_value_new_string_n(module->file.ptr, module->file.len));
 
     const sentry_mapped_region_t *first_mapping = &module->mappings[0];
     const sentry_mapped_region_t *last_mapping
@@ -492,13 +765,28 @@ sentry__procmaps_module_to_value(const sentry_module_t *module)
         sentry__procmaps_read_ids_from_elf(mod_val, module);
     } else {
         char *filename = sentry__slice_to_owned(module->file);
+        sentry_path_t *path = sentry__path_from_str_owned(filename);
+
+        // the identifiers of unchanged files are taken from the cache
+        build_id_entry_t key;
+        bool has_key = path && build_id_key(&key, path, module);
+        if (has_key) {
+            sentry__mutex_lock(&g_build_ids_lock);
+            bool cached = build_id_cache_lookup(&g_build_ids, &key, mod_val);
+            sentry__mutex_unlock(&g_build_ids_lock);
+            if (cached) {
+                sentry__path_free(path);
+                return mod_val;
+            }
+        }
+
         sentry_mmap_t mm;
-        if (!sentry__mmap_file(&mm, filename)) {
-            sentry_free(filename);
+        bool mapped = path && sentry__path_mmap(&mm, path);
+        sentry__path_free(path);
+        if (!mapped) {
             sentry_value_decref(mod_val);
             return sentry_value_new_null();
         }
-        sentry_free(filename);
 
         sentry_module_t mmapped_module;
         memset(&mmapped_module, 0, sizeof(sentry_module_t));
@@ -511,22 +799,233 @@ sentry__procmaps_module_to_value(const sentry_module_t *module)
         sentry__procmaps_read_ids_from_elf(mod_val, &mmapped_module);
 
         sentry__mmap_close(&mm);
+        if (has_key) {
+            sentry__mutex_lock(&g_build_ids_lock);
+            build_id_cache_insert(&g_build_ids, &key, mod_val);
+            sentry__mutex_unlock(&g_build_ids_lock);
+        }
     }
 
     return mod_val;
 }
 
 static void
-try_append_module(sentry_value_t modules, const sentry_module_t *module)
+registry_free(module_registry_t *registry)
+{
+    for (size_t i = 0; i < registry->len; i++) {
+        sentry_value_decref(registry->entries[i].value);
+    }
+    sentry_free(registry->entries);
+    memset(registry, 0, sizeof(module_registry_t));
+}
+
+static bool
+registry_push(module_registry_t *registry, const module_entry_t *entry)
+{
+    if (registry->len == registry->cap) {
+        size_t cap = registry->cap ? registry->cap * 2 : 64;
+        module_entry_t *entries = sentry_malloc(sizeof(module_entry_t) * cap);
+        if (!entries) {
+            return false;
+        }
+        if (registry->len) {
+            memcpy(entries, registry->entries,
+                sizeof(module_entry_t) * registry->len);
+        }
+        sentry_free(registry->entries);
+        registry->entries = entries;
+        registry->cap = cap;
+    }
+    registry->entries[registry->len++] = *entry;
+    return true;
+}
+
+static sentry_value_t
+registry_find(const module_registry_t *registry, const module_entry_t *key,
+    sentry_slice_t file)
+{
+    for (size_t i = 0; i < registry->len; i++) {
+        const module_entry_t *entry = &registry->entries[i];
+        if (entry->image_addr == key->image_addr
+            && entry->image_size == key->image_size
+            && entry->inode == key->inode) {
+            const char *code_file = sentry_value_as_string(
+                sentry_value_get_by_key(entry->value, "code_file"));
+            if (sentry__slice_eqs(file, code_file)) {
+                return entry->value;
+            }
+        }
+    }
+    return sentry_value_new_null();
+}
+
+/**
+ * A module found while parsing the mappings, along with its value once it
+ * was identified.
+ */
+typedef struct {
+    sentry_module_t module;
+    module_entry_t entry;
+} pending_module_t;
+
+typedef struct {
+    pending_module_t *items;
+    size_t len;
+    size_t cap;
+    // the index of the next module to be identified
+    volatile long next;
+} pending_modules_t;
+
+static void
+collect_module(pending_modules_t *pending, const sentry_module_t *module)
 {
     if (!module->file.ptr || !module->num_mappings) {
         return;
     }
+    if (pending->len == pending->cap) {
+        size_t cap = pending->cap ? pending->cap * 2 : 64;
+        pending_module_t *items = sentry_malloc(sizeof(pending_module_t) * cap);
+        if (!items) {
+            return;
+        }
+        if (pending->len) {
+            memcpy(
+                items, pending->items, sizeof(pending_module_t) * pending->len);
+        }
+        sentry_free(pending->items);
+        pending->items = items;
+        pending->cap = cap;
+    }
+
+    pending_module_t *item = &pending->items[pending->len++];
+    item->module = *module;
+    const sentry_mapped_region_t *first_mapping = &module->mappings[0];
+    const sentry_mapped_region_t *last_mapping
+        = &module->mappings[module->num_mappings - 1];
+    item->entry.image_addr = first_mapping->addr;
+    item->entry.image_size
+        = last_mapping->addr + last_mapping->size - first_mapping->addr;
+    item->entry.inode = module->mappings_inode;
+
+    // reuse the module of an earlier scan if it is still mapped
+    item->entry.value = registry_find(&g_registry, &item->entry, module->file);
+    sentry_value_incref(item->entry.value);
+}
+
+SENTRY_THREAD_FN
+identify_modules(void *data)
+{
+    pending_modules_t *pending = data;
+    while (true) {
+        size_t i = (size_t)sentry__atomic_fetch_and_add(&pending->next, 1);
+        if (i >= pending->len) {
+            break;
+        }
+        pending_module_t *item = &pending->items[i];
+        if (sentry_value_is_null(item->entry.value)) {
+            item->entry.value = sentry__procmaps_module_to_value(&item->module);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads the identifiers of all the modules that were not reused from an
+ * earlier scan. Mapping the files and hashing the text of modules without a
+ * build-id can take a while, so this is spread across a few threads when
+ * there are enough modules.
+ */
+static void
+identify_pending_modules(pending_modules_t *pending)
+{
+    size_t missing = 0;
+    for (size_t i = 0; i < pending->len; i++) {
+        missing += sentry_value_is_null(pending->items[i].entry.value);
+    }
+
+    size_t thread_count = missing / MIN_MODULES_PER_THREAD;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && thread_count > (size_t)cpus) {
+        thread_count = (size_t)cpus;
+    }
+    if (thread_count > MAX_IDENTIFY_THREADS) {
+        thread_count = MAX_IDENTIFY_THREADS;
+    }
+    // no threads can be spawned safely from within our signal handler
+    if (!sentry__block_for_signal_handler()) {
+        thread_count = 1;
+    }
+
+    // the current thread is one of the workers
+    sentry_threadid_t threads[MAX_IDENTIFY_THREADS - 1];
+    size_t spawned = 0;
+    for (; spawned + 1 < thread_count; spawned++) {
+        sentry__thread_init(&threads[spawned]);
+        if (sentry__thread_spawn(&threads[spawned], identify_modules, pending)
+            != 0) {
+            break;
+        }
+    }
+    identify_modules(pending);
+    for (size_t i = 0; i < spawned; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+}
+
+static void
+append_pending_modules(sentry_value_t modules, module_registry_t *registry,
+    pending_modules_t *pending)
+{
+    for (size_t i = 0; i < pending->len; i++) {
+        module_entry_t *entry = &pending->items[i].entry;
+        if (sentry_value_is_null(entry->value)) {
+            continue;
+        }
+        sentry_value_incref(entry->value);
+        sentry_value_append(modules, entry->value);
+        if (!registry_push(registry, entry)) {
+            sentry_value_decref(entry->value);
+        }
+    }
+    sentry_free(pending->items);
+}
+
+#ifdef SENTRY_HAS_DL_COUNTERS
+static int
+read_load_counters(struct dl_phdr_info *info, size_t size, void *data)
+{
+    load_counters_t *counters = data;
+    if (size >= offsetof(struct dl_phdr_info, dlpi_subs)
+            + sizeof(info->dlpi_subs)) {
+        counters->adds = info->dlpi_adds;
+        counters->subs = info->dlpi_subs;
+        counters->valid = true;
+    }
+    // the counters are the same for all objects
+    return 1;
+}
+#endif
 
-    sentry_value_t mod_val = sentry__procmaps_module_to_value(module);
-    if (!sentry_value_is_null(mod_val)) {
-        sentry_value_append(modules, mod_val);
+static load_counters_t
+get_load_counters(void)
+{
+    load_counters_t counters = { 0, 0, false };
+#ifdef SENTRY_HAS_DL_COUNTERS
+    // this takes the lock of the dynamic loader, which is not safe to do from
+    // within our signal handler
+    if (sentry__block_for_signal_handler()) {
+        dl_iterate_phdr(read_load_counters, &counters);
     }
+#endif
+    return counters;
+}
+
+uint64_t
+sentry__modulefinder_get_load_count(void)
+{
+    load_counters_t counters = get_load_counters();
+    return counters.valid ? counters.adds + counters.subs : 0;
 }
 
 // copied from:
@@ -576,7 +1075,7 @@ is_valid_elf_header(void *start)
 }
 
 static void
-load_modules(sentry_value_t modules)
+load_modules(sentry_value_t modules, module_registry_t *registry)
 {
     int fd = open("/proc/self/maps", O_RDONLY);
     if (fd < 0) {
@@ -619,6 +1118,7 @@ load_modules(sentry_value_t modules)
 
     // we have multiple memory maps per file, and we need to merge their offsets
     // based on the filename. Luckily, the maps are ordered by filename, so yay
+    pending_modules_t pending = { NULL, 0, 0, 0 };
     sentry_module_t last_module;
     memset(&last_module, 0, sizeof(sentry_module_t));
     while (true) {
@@ -662,7 +1162,7 @@ load_modules(sentry_value_t modules)
             if (!is_duplicated_mapping(&last_module, &module)) {
                 // try to append the module based on the mappings that we have
                 // found so far
-                try_append_module(modules, &last_module);
+                collect_module(&pending, &last_module);
 
                 // start a new module based on the current mapping
                 memset(&last_module, 0, sizeof(sentry_module_t));
@@ -673,35 +1173,224 @@ load_modules(sentry_value_t modules)
 
         sentry__module_mapping_push(&last_module, &module);
     }
-    try_append_module(modules, &last_module);
+    collect_module(&pending, &last_module);
+
+    identify_pending_modules(&pending);
+    append_pending_modules(modules, registry, &pending);
     sentry_free(contents);
 }
 
+/**
+ * Gets a reference to the module list of the current snapshot and the load
+ * counters it was read at. Returns false if there is no snapshot.
+ */
+static bool
+snapshot_acquire(sentry_value_t *modules_out, load_counters_t *counters_out)
+{
+    long epoch;
+    for (;;) {
+        epoch = sentry__atomic_fetch(&g_epoch);
+        sentry__atomic_fetch_and_add(&g_readers[epoch & 1], 1);
+        // this reader is only counted if the epoch did not end in between
+        if (sentry__atomic_fetch(&g_epoch) == epoch) {
+            break;
+        }
+        sentry__atomic_fetch_and_add(&g_readers[epoch & 1], -1);
+    }
+    modules_snapshot_t *snapshot
+        = sentry__atomic_fetch_ptr((void *volatile *)&g_snapshot);
+    if (snapshot) {
+        sentry_value_incref(snapshot->modules);
+        *modules_out = snapshot->modules;
+        *counters_out = snapshot->counters;
+    }
+    sentry__atomic_fetch_and_add(&g_readers[epoch & 1], -1);
+    return snapshot != NULL;
+}
+
+/**
+ * Replaces the current snapshot, which may be NULL, and frees the previous
+ * one once nobody reads it anymore. This must be called with `g_mutex` held.
+ */
+static void
+snapshot_publish(modules_snapshot_t *snapshot)
+{
+    modules_snapshot_t *prev
+        = sentry__atomic_exchange_ptr((void *volatile *)&g_snapshot, snapshot);
+    if (!prev) {
+        return;
+    }
+    // readers of the new epoch can only see the new snapshot, and the ones
+    // of the previous epoch are only about to incref the previous one
+    long epoch = sentry__atomic_fetch_and_add(&g_epoch, 1);
+    while (sentry__atomic_fetch(&g_readers[epoch & 1]) != 0) {
+        sched_yield();
+    }
+    sentry_value_decref(prev->modules);
+    sentry_free(prev);
+}
+
+/**
+ * Returns true if the dynamic loader reports that objects were loaded or
+ * unloaded since the `snapshot` counters were read.
+ */
+static bool
+is_outdated(const load_counters_t *snapshot, const load_counters_t *counters)
+{
+    return counters->valid
+        && (!snapshot->valid || counters->adds != snapshot->adds
+            || counters->subs != snapshot->subs);
+}
+
 sentry_value_t
 sentry_get_modules_list(void)
 {
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_MODULEFINDER);
+    load_counters_t counters = get_load_counters();
+    sentry_value_t modules;
+    load_counters_t snapshot_counters;
+
+    // the module list is kept until the dynamic loader reports that objects
+    // were loaded or unloaded in the meantime. While another thread reads the
+    // modules again, the outdated list is used rather than waiting for it.
+    bool found = snapshot_acquire(&modules, &snapshot_counters);
+    if (found
+        && (!is_outdated(&snapshot_counters, &counters)
+            || sentry__atomic_fetch(&g_refreshing))) {
+        SENTRY_MEMORY_TAG_LEAVE();
+        return modules;
+    }
+    if (found) {
+        sentry_value_decref(modules);
+    }
+
+    bool changed = false;
     sentry__mutex_lock(&g_mutex);
-    if (!g_initialized) {
-        g_modules = sentry_value_new_list();
+    sentry__atomic_store(&g_refreshing, 1);
+    found = snapshot_acquire(&modules, &snapshot_counters);
+    if (found && is_outdated(&snapshot_counters, &counters)) {
+        sentry_value_decref(modules);
+        changed = true;
+        found = false;
+    }
+    if (!found) {
+        // the list outlives whatever arena the caller may have entered
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
+        modules = sentry_value_new_list();
+        module_registry_t registry = { NULL, 0, 0 };
         SENTRY_TRACE("trying to read modules from /proc/self/maps");
-        load_modules(g_modules);
+        load_modules(modules, &registry);
         SENTRY_TRACEF("read %zu modules from /proc/self/maps",
-            sentry_value_get_length(g_modules));
-        sentry_value_freeze(g_modules);
-        g_initialized = true;
+            sentry_value_get_length(modules));
+        sentry__value_arena_leave(prev_arena);
+        sentry_value_freeze(modules);
+        build_id_cache_save(&g_build_ids);
+        registry_free(&g_registry);
+        g_registry = registry;
+
+        modules_snapshot_t *snapshot = SENTRY_MAKE(modules_snapshot_t);
+        if (snapshot) {
+            sentry_value_incref(modules);
+            snapshot->modules = modules;
+            snapshot->counters = counters;
+            snapshot_publish(snapshot);
+        }
     }
-    sentry_value_t modules = g_modules;
-    sentry_value_incref(modules);
+    sentry__atomic_store(&g_refreshing, 0);
     sentry__mutex_unlock(&g_mutex);
+
+    if (changed) {
+        // addresses may now belong to a different module
+        sentry__symbolizer_clear_cache();
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
     return modules;
 }
 
 void
 sentry_clear_modulecache(void)
+{
+    // the registry of known modules is kept, so the next scan only needs to
+    // read the modules that were loaded in the meantime
+    sentry__mutex_lock(&g_mutex);
+    snapshot_publish(NULL);
+    sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_cleanup(void)
+{
+    sentry__mutex_lock(&g_mutex);
+    snapshot_publish(NULL);
+    registry_free(&g_registry);
+    build_id_cache_free(&g_build_ids);
+    sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_set_database_path(const sentry_path_t *database_path)
 {
     sentry__mutex_lock(&g_mutex);
-    sentry_value_decref(g_modules);
-    g_modules = sentry_value_new_null();
-    g_initialized = false;
+    build_id_cache_free(&g_build_ids);
+    g_build_ids.path = sentry__path_join_str(database_path, "build-ids.cache");
     sentry__mutex_unlock(&g_mutex);
 }
+
+size_t
+sentry__modulefinder_get_memory_usage(void)
+{
+    sentry_value_t modules;
+    load_counters_t counters;
+    if (!snapshot_acquire(&modules, &counters)) {
+        return 0;
+    }
+    size_t size = sentry__value_get_memory_usage(modules);
+    sentry_value_decref(modules);
+    return size;
+}
+
+typedef struct {
+    void (*callback)(const char *name, void *start, size_t size, void *data);
+    void *data;
+    const char *exe_name;
+} writable_ranges_t;
+
+static int
+report_writable_ranges(
+    struct dl_phdr_info *info, size_t UNUSED(size), void *data)
+{
+    writable_ranges_t *ranges = data;
+    // the executable itself has no name
+    const char *name = info->dlpi_name && *info->dlpi_name
+        ? info->dlpi_name
+        : ranges->exe_name;
+    if (!name) {
+        return 0;
+    }
+    const char *slash = strrchr(name, '/');
+    if (slash) {
+        name = slash + 1;
+    }
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_W)
+            && phdr->p_memsz) {
+            ranges->callback(name, (void *)(info->dlpi_addr + phdr->p_vaddr),
+                (size_t)phdr->p_memsz, ranges->data);
+        }
+    }
+    return 0;
+}
+
+void
+sentry__modulefinder_foreach_writable_range(
+    void (*callback)(const char *name, void *start, size_t size, void *data),
+    void *data)
+{
+    sentry_path_t *exe = sentry__path_current_exe();
+    writable_ranges_t ranges = { callback, data, exe ? exe->path : NULL };
+    dl_iterate_phdr(report_writable_ranges, &ranges);
+    sentry__path_free(exe);
+}
@@ -30,10 +30,13 @@ typedef struct {
     bool is_mmapped;
 } sentry_module_t;
 
-typedef struct {
-    void *ptr;
-    size_t len;
-} sentry_mmap_t;
+/**
+ * Returns the number of objects the dynamic loader has loaded and unloaded so
+ * far, which changes whenever the mapped modules may have changed. Returns 0
+ * when the dynamic loader does not provide this, or from within our signal
+ * handler.
+ */
+uint64_t sentry__modulefinder_get_load_count(void);
 
 #ifdef SENTRY_UNITTEST
 bool sentry__procmaps_read_ids_from_elf(
@@ -1,5 +1,10 @@
 #include "sentry_boot.h"
 
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_modulefinder.h"
+#include "sentry_string.h"
+#include "sentry_symbolizer.h"
 #include "sentry_sync.h"
 #include "sentry_uuid.h"
 #include "sentry_value.h"
@@ -11,6 +16,19 @@ static bool g_initialized = false;
 static sentry_mutex_t g_mutex = SENTRY__MUTEX_INIT;
 static sentry_value_t g_modules = { 0 };
 
+// `LdrRegisterDllNotification` is exported from `ntdll.dll` starting with
+// Vista, and is not part of the SDK headers.
+typedef VOID(CALLBACK *dll_notification_func_t)(
+    ULONG reason, const void *data, PVOID context);
+typedef LONG(NTAPI *register_dll_notification_func_t)(
+    ULONG flags, dll_notification_func_t func, PVOID context, PVOID *cookie);
+typedef LONG(NTAPI *unregister_dll_notification_func_t)(PVOID cookie);
+
+static bool g_notification_registered = false;
+static PVOID g_notification_cookie = NULL;
+// set by the DLL notification, as the modules list is only updated lazily
+static volatile long g_modules_changed = 0;
+
 #define CV_SIGNATURE 0x53445352
 
 struct CodeViewRecord70 {
@@ -88,8 +106,30 @@ extract_pdb_info(uintptr_t module_addr, sentry_value_t module)
     }
 }
 
+static sentry_value_t
+find_module(sentry_value_t modules, const MODULEENTRY32W *module,
+    sentry_value_t code_file)
+{
+    size_t len = sentry_value_get_length(modules);
+    for (size_t i = 0; i < len; i++) {
+        sentry_value_t rv = sentry_value_get_by_index(modules, i);
+        uint64_t image_addr
+            = sentry__value_as_addr(sentry_value_get_by_key(rv, "image_addr"));
+        int32_t image_size
+            = sentry_value_as_int32(sentry_value_get_by_key(rv, "image_size"));
+        const char *file
+            = sentry_value_as_string(sentry_value_get_by_key(rv, "code_file"));
+        if (image_addr == (uint64_t)module->modBaseAddr
+            && image_size == (int32_t)module->modBaseSize
+            && sentry__string_eq(file, sentry_value_as_string(code_file))) {
+            return rv;
+        }
+    }
+    return sentry_value_new_null();
+}
+
 static void
-load_modules(void)
+load_modules(sentry_value_t previous)
 {
     HANDLE snapshot
         = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
@@ -99,6 +139,18 @@ load_modules(void)
 
     if (Module32FirstW(snapshot, &module)) {
         do {
+            // reuse modules that are still loaded from the previous list,
+            // without reading their headers again
+            sentry_value_t code_file
+                = sentry__value_new_string_from_wstr(module.szExePath);
+            sentry_value_t known = find_module(previous, &module, code_file);
+            sentry_value_decref(code_file);
+            if (!sentry_value_is_null(known)) {
+                sentry_value_incref(known);
+                sentry_value_append(g_modules, known);
+                continue;
+            }
+
             HMODULE handle = LoadLibraryExW(
                 module.szExePath, NULL, LOAD_LIBRARY_AS_DATAFILE);
             MEMORY_BASIC_INFORMATION vmem_info = { 0 };
@@ -128,26 +180,156 @@ load_modules(void)
     sentry_value_freeze(g_modules);
 }
 
+static VOID CALLBACK
+on_dll_notification(
+    ULONG UNUSED(reason), const void *UNUSED(data), PVOID UNUSED(context))
+{
+    // this runs under the loader lock, so it must not do anything else
+    sentry__atomic_store(&g_modules_changed, 1);
+}
+
+static void
+register_dll_notification(void)
+{
+    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+    register_dll_notification_func_t register_func = ntdll
+        ? (register_dll_notification_func_t)(void *)GetProcAddress(
+              ntdll, "LdrRegisterDllNotification")
+        : NULL;
+    if (!register_func
+        || register_func(0, on_dll_notification, NULL, &g_notification_cookie)
+            != 0) {
+        g_notification_cookie = NULL;
+    }
+}
+
+static void
+unregister_dll_notification(void)
+{
+    if (!g_notification_cookie) {
+        return;
+    }
+    unregister_dll_notification_func_t unregister_func
+        = (unregister_dll_notification_func_t)(void *)GetProcAddress(
+            GetModuleHandleW(L"ntdll.dll"), "LdrUnregisterDllNotification");
+    if (unregister_func) {
+        unregister_func(g_notification_cookie);
+    }
+    g_notification_cookie = NULL;
+}
+
 sentry_value_t
 sentry_get_modules_list(void)
 {
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_MODULEFINDER);
+    bool changed = false;
     sentry__mutex_lock(&g_mutex);
+    if (!g_notification_registered) {
+        register_dll_notification();
+        g_notification_registered = true;
+    }
+    // DLLs were loaded or unloaded since the list was last loaded
+    if (sentry__atomic_store(&g_modules_changed, 0) && g_initialized) {
+        changed = true;
+        g_initialized = false;
+    }
     if (!g_initialized) {
-        load_modules();
+        // the list outlives whatever arena the caller may have entered
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
+        sentry_value_t previous = g_modules;
+        load_modules(previous);
+        sentry_value_decref(previous);
+        sentry__value_arena_leave(prev_arena);
         g_initialized = true;
     }
     sentry_value_t modules = g_modules;
     sentry_value_incref(modules);
     sentry__mutex_unlock(&g_mutex);
+
+    if (changed) {
+        // addresses may now belong to a different module
+        sentry__symbolizer_clear_cache();
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
     return modules;
 }
 
 void
 sentry_clear_modulecache(void)
 {
+    // the current list is kept around, so that the modules which are still
+    // loaded do not need to be read again
     sentry__mutex_lock(&g_mutex);
+    g_initialized = false;
+    sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_cleanup(void)
+{
+    sentry__mutex_lock(&g_mutex);
+    unregister_dll_notification();
+    g_notification_registered = false;
     sentry_value_decref(g_modules);
     g_modules = sentry_value_new_null();
     g_initialized = false;
     sentry__mutex_unlock(&g_mutex);
+    sentry__symbolizer_clear_cache();
+}
+
+void
+sentry__modulefinder_set_database_path(
+    const sentry_path_t *UNUSED(database_path))
+{
+}
+
+size_t
+sentry__modulefinder_get_memory_usage(void)
+{
+    sentry__mutex_lock(&g_mutex);
+    size_t size = sentry__value_get_memory_usage(g_modules);
+    sentry__mutex_unlock(&g_mutex);
+    return size;
+}
+
+void
+sentry__modulefinder_foreach_writable_range(
+    void (*callback)(const char *name, void *start, size_t size, void *data),
+    void *data)
+{
+    HANDLE snapshot
+        = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
+    MODULEENTRY32W module = { 0 };
+    module.dwSize = sizeof(MODULEENTRY32W);
+
+    if (Module32FirstW(snapshot, &module)) {
+        do {
+            char *name = sentry__string_from_wstr(module.szModule);
+            if (!name) {
+                continue;
+            }
+            const char *base = (const char *)module.modBaseAddr;
+            const IMAGE_DOS_HEADER *dos_header = (const IMAGE_DOS_HEADER *)base;
+            const IMAGE_NT_HEADERS *nt_headers
+                = (const IMAGE_NT_HEADERS *)(base + dos_header->e_lfanew);
+            if (dos_header->e_magic == IMAGE_DOS_SIGNATURE
+                && nt_headers->Signature == IMAGE_NT_SIGNATURE) {
+                const IMAGE_SECTION_HEADER *section
+                    = IMAGE_FIRST_SECTION(nt_headers);
+                for (WORD i = 0; i < nt_headers->FileHeader.NumberOfSections;
+                     i++, section++) {
+                    if ((section->Characteristics & IMAGE_SCN_MEM_WRITE)
+                        && section->Misc.VirtualSize) {
+                        callback(name,
+                            (void *)(base + section->VirtualAddress),
+                            (size_t)section->Misc.VirtualSize, data);
+                    }
+                }
+            }
+            sentry_free(name);
+        } while (Module32NextW(snapshot, &module));
+    }
+
+    CloseHandle(snapshot);
 }
@@ -8,6 +8,9 @@ sentry__path_free(sentry_path_t *path)
         return;
     }
     sentry_free(path->path);
+#ifdef SENTRY_PLATFORM_WINDOWS
+    sentry_free(path->path_str);
+#endif
     sentry_free(path);
 }
 
@@ -9,9 +9,11 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -26,9 +28,20 @@
 // only read this many bytes to memory ever
 static const size_t MAX_READ_TO_BUFFER = 134217728;
 
+// the `*at` functions resolve the paths found by a directory iterator against
+// the open directory, which saves the kernel from walking all of the parent
+// directories again
+#ifdef AT_FDCWD
+#    define SENTRY_PATH_AT
+#endif
+
 struct sentry_pathiter_s {
     const sentry_path_t *parent;
+    // the entries are written into this one buffer, right after the parent
+    // path and a separator, which take up the first `prefix_len` bytes
     sentry_path_t *current;
+    size_t prefix_len;
+    size_t capacity;
     DIR *dir_handle;
 };
 
@@ -104,6 +117,18 @@ sentry__filelock_unlock(sentry_filelock_t *lock)
     lock->is_locked = false;
 }
 
+void
+sentry__filelock_close_inherited(sentry_filelock_t *lock)
+{
+    if (!lock->is_locked) {
+        return;
+    }
+    // the `flock` belongs to the open file description, which the parent
+    // still shares, so this only drops the reference of the child
+    close(lock->fd);
+    lock->is_locked = false;
+}
+
 sentry_path_t *
 sentry__path_absolute(const sentry_path_t *path)
 {
@@ -196,9 +221,64 @@ sentry__path_from_str_owned(char *s)
         return NULL;
     }
     rv->path = s;
+    rv->dir_fd = -1;
+    rv->d_type = 0;
     return rv;
 }
 
+/**
+ * Returns the directory that `path` is resolved against by the `*at`
+ * functions, and writes the name to resolve into `name_out`.
+ */
+#ifdef SENTRY_PATH_AT
+static int
+path_at(const sentry_path_t *path, const char **name_out)
+{
+    if (path->dir_fd >= 0) {
+        *name_out = sentry__path_filename(path);
+        return path->dir_fd;
+    }
+    *name_out = path->path;
+    return AT_FDCWD;
+}
+#endif
+
+static int
+path_stat(const sentry_path_t *path, struct stat *buf)
+{
+#ifdef SENTRY_PATH_AT
+    const char *name;
+    int dir_fd = path_at(path, &name);
+    return fstatat(dir_fd, name, buf, 0);
+#else
+    return stat(path->path, buf);
+#endif
+}
+
+static int
+path_open(const sentry_path_t *path, int flags)
+{
+#ifdef SENTRY_PATH_AT
+    const char *name;
+    int dir_fd = path_at(path, &name);
+    return openat(dir_fd, name, flags);
+#else
+    return open(path->path, flags);
+#endif
+}
+
+#ifdef DT_UNKNOWN
+/**
+ * Returns whether the `d_type` of the iterated `path` tells its file type.
+ * Symbolic links need to be followed, like `stat` does.
+ */
+static bool
+has_file_type(const sentry_path_t *path)
+{
+    return path->d_type != DT_UNKNOWN && path->d_type != DT_LNK;
+}
+#endif
+
 const sentry_pathchar_t *
 sentry__path_filename(const sentry_path_t *path)
 {
@@ -206,6 +286,18 @@ sentry__path_filename(const sentry_path_t *path)
     return c ? c + 1 : path->path;
 }
 
+const char *
+sentry__path_str(const sentry_path_t *path)
+{
+    return path->path;
+}
+
+const char *
+sentry__path_filename_str(const sentry_path_t *path)
+{
+    return sentry__path_filename(path);
+}
+
 bool
 sentry__path_filename_matches(const sentry_path_t *path, const char *filename)
 {
@@ -226,22 +318,32 @@ sentry__path_ends_with(const sentry_path_t *path, const char *suffix)
 bool
 sentry__path_is_dir(const sentry_path_t *path)
 {
+#ifdef DT_UNKNOWN
+    if (has_file_type(path)) {
+        return path->d_type == DT_DIR;
+    }
+#endif
     struct stat buf;
-    return stat(path->path, &buf) == 0 && S_ISDIR(buf.st_mode);
+    return path_stat(path, &buf) == 0 && S_ISDIR(buf.st_mode);
 }
 
 bool
 sentry__path_is_file(const sentry_path_t *path)
 {
+#ifdef DT_UNKNOWN
+    if (has_file_type(path)) {
+        return path->d_type == DT_REG;
+    }
+#endif
     struct stat buf;
-    return stat(path->path, &buf) == 0 && S_ISREG(buf.st_mode);
+    return path_stat(path, &buf) == 0 && S_ISREG(buf.st_mode);
 }
 
 size_t
 sentry__path_get_size(const sentry_path_t *path)
 {
     struct stat buf;
-    if (stat(path->path, &buf) == 0 && S_ISREG(buf.st_mode)) {
+    if (path_stat(path, &buf) == 0 && S_ISREG(buf.st_mode)) {
         return (size_t)buf.st_size;
     } else {
         return 0;
@@ -283,12 +385,8 @@ sentry__path_join_str(const sentry_path_t *base, const char *other)
 sentry_path_t *
 sentry__path_clone(const sentry_path_t *path)
 {
-    sentry_path_t *rv = SENTRY_MAKE(sentry_path_t);
-    if (!rv) {
-        return NULL;
-    }
-    rv->path = sentry__string_clone(path->path);
-    return rv;
+    // the clone may outlive the iterator, so it does not keep its directory
+    return sentry__path_from_str(path->path);
 }
 
 #define EINTR_RETRY(X, Y)                                                      \
@@ -306,6 +404,15 @@ int
 sentry__path_remove(const sentry_path_t *path)
 {
     int status;
+#ifdef SENTRY_PATH_AT
+    const char *name;
+    int dir_fd = path_at(path, &name);
+    int flags = sentry__path_is_dir(path) ? AT_REMOVEDIR : 0;
+    EINTR_RETRY(unlinkat(dir_fd, name, flags), &status);
+    if (status == 0) {
+        return 0;
+    }
+#else
     if (!sentry__path_is_dir(path)) {
         EINTR_RETRY(unlink(path->path), &status);
         if (status == 0) {
@@ -317,12 +424,39 @@ sentry__path_remove(const sentry_path_t *path)
             return 0;
         }
     }
+#endif
     if (errno == ENOENT) {
         return 0;
     }
     return 1;
 }
 
+int
+sentry__path_rename(const sentry_path_t *src, const sentry_path_t *dst)
+{
+    int status;
+    EINTR_RETRY(rename(src->path, dst->path), &status);
+    return status == 0 ? 0 : 1;
+}
+
+int
+sentry__path_sync(const sentry_path_t *path)
+{
+    int fd = open(path->path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+#ifdef SENTRY_PLATFORM_DARWIN
+    // `fsync` only hands the data over to the drive, which may keep it in its
+    // cache, so ask for a full flush first
+    int rv = fcntl(fd, F_FULLFSYNC) == 0 ? 0 : fsync(fd);
+#else
+    int rv = fsync(fd);
+#endif
+    close(fd);
+    return rv == 0 ? 0 : 1;
+}
+
 int
 sentry__path_create_dir_all(const sentry_path_t *path)
 {
@@ -362,10 +496,51 @@ sentry__path_iter_directory(const sentry_path_t *path)
     }
     rv->parent = path;
     rv->current = NULL;
+    rv->prefix_len = 0;
+    rv->capacity = 0;
     rv->dir_handle = opendir(path->path);
     return rv;
 }
 
+/**
+ * Makes sure that the buffer of `piter` can hold an entry of `name_len` bytes,
+ * allocating a larger one with the parent path and separator if needed.
+ */
+static bool
+pathiter_reserve(sentry_pathiter_t *piter, size_t name_len)
+{
+    const char *parent = piter->parent->path;
+    size_t parent_len = strlen(parent);
+    // this separates the names the same way as `sentry__path_join_str`
+    bool need_sep = !parent_len || parent[parent_len - 1] != '/';
+    size_t prefix_len = parent_len + (need_sep ? 1 : 0);
+    if (piter->current && prefix_len + name_len < piter->capacity) {
+        return true;
+    }
+    // the names of most file systems have at most 255 bytes
+    size_t capacity = prefix_len + (name_len > 255 ? name_len : 255) + 1;
+    char *buf = sentry_malloc(capacity);
+    if (!buf) {
+        return false;
+    }
+    memcpy(buf, parent, parent_len);
+    if (need_sep) {
+        buf[parent_len] = '/';
+    }
+    if (!piter->current) {
+        piter->current = sentry__path_from_str_owned(buf);
+        if (!piter->current) {
+            return false;
+        }
+    } else {
+        sentry_free(piter->current->path);
+        piter->current->path = buf;
+    }
+    piter->prefix_len = prefix_len;
+    piter->capacity = capacity;
+    return true;
+}
+
 const sentry_path_t *
 sentry__pathiter_next(sentry_pathiter_t *piter)
 {
@@ -387,10 +562,20 @@ sentry__pathiter_next(sentry_pathiter_t *piter)
         break;
     }
 
-    sentry__path_free(piter->current);
-    piter->current = sentry__path_join_str(piter->parent, entry->d_name);
-
-    return piter->current;
+    // the entry replaces the previous one in the same buffer
+    size_t name_len = strlen(entry->d_name);
+    if (!pathiter_reserve(piter, name_len)) {
+        return NULL;
+    }
+    sentry_path_t *current = piter->current;
+    memcpy(current->path + piter->prefix_len, entry->d_name, name_len + 1);
+#ifdef SENTRY_PATH_AT
+    current->dir_fd = dirfd(piter->dir_handle);
+#endif
+#ifdef DT_UNKNOWN
+    current->d_type = entry->d_type;
+#endif
+    return current;
 }
 
 void
@@ -422,11 +607,14 @@ sentry__path_touch(const sentry_path_t *path)
 char *
 sentry__path_read_to_buffer(const sentry_path_t *path, size_t *size_out)
 {
-    int fd = open(path->path, O_RDONLY);
+    int fd = path_open(path, O_RDONLY);
     if (fd < 0) {
         return NULL;
     }
-    size_t len = sentry__path_get_size(path);
+    struct stat buf;
+    size_t len = fstat(fd, &buf) == 0 && S_ISREG(buf.st_mode)
+        ? (size_t)buf.st_size
+        : 0;
     if (len == 0) {
         close(fd);
         char *rv = sentry_malloc(1);
@@ -469,6 +657,103 @@ sentry__path_read_to_buffer(const sentry_path_t *path, size_t *size_out)
     return rv;
 }
 
+bool
+sentry__path_mmap(sentry_mmap_t *rv, const sentry_path_t *path)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    int fd = path_open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *ptr = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps a reference to the file on its own
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = (size_t)sb.st_size;
+    return true;
+}
+
+bool
+sentry__path_mmap_shared(
+    sentry_mmap_t *rv, const sentry_path_t *path, size_t len)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    if (!len) {
+        return false;
+    }
+    int fd = open(path->path, O_RDWR | O_CREAT | O_TRUNC,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if (fd < 0) {
+        return false;
+    }
+    // the file is sparse, so this does not actually write `len` bytes
+    if (ftruncate(fd, (off_t)len) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = len;
+    return true;
+}
+
+bool
+sentry__path_mmap_existing_shared(sentry_mmap_t *rv, const sentry_path_t *path)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    int fd = open(path->path, O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *ptr = mmap(
+        NULL, (size_t)sb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = (size_t)sb.st_size;
+    return true;
+}
+
+void
+sentry__mmap_close(sentry_mmap_t *m)
+{
+    if (m->ptr) {
+        munmap(m->ptr, m->len);
+    }
+    m->ptr = NULL;
+    m->len = 0;
+}
+
 static int
 write_buffer_with_flags(
     const sentry_path_t *path, const char *buf, size_t buf_len, int flags)
@@ -503,3 +788,120 @@ sentry__path_append_buffer(
     return write_buffer_with_flags(
         path, buf, buf_len, O_RDWR | O_CREAT | O_APPEND);
 }
+
+struct sentry_filewriter_s {
+    int fd;
+    bool failed;
+};
+
+static sentry_filewriter_t *
+filewriter_new_with_flags(const sentry_path_t *path, int flags)
+{
+    int fd = open(path->path, flags,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if (fd < 0) {
+        SENTRY_TRACEF("failed to open file \"%s\" for writing (errno %d)",
+            path->path, errno);
+        return NULL;
+    }
+    sentry_filewriter_t *fw = SENTRY_MAKE(sentry_filewriter_t);
+    if (!fw) {
+        close(fd);
+        return NULL;
+    }
+    fw->fd = fd;
+    fw->failed = false;
+    return fw;
+}
+
+sentry_filewriter_t *
+sentry__filewriter_new(const sentry_path_t *path)
+{
+    return filewriter_new_with_flags(path, O_RDWR | O_CREAT | O_TRUNC);
+}
+
+sentry_filewriter_t *
+sentry__filewriter_new_append(const sentry_path_t *path)
+{
+    return filewriter_new_with_flags(path, O_RDWR | O_CREAT | O_APPEND);
+}
+
+int
+sentry__filewriter_write(
+    sentry_filewriter_t *fw, const char *buf, size_t buf_len)
+{
+    if (!fw->failed && write_loop(fw->fd, buf, buf_len) != 0) {
+        fw->failed = true;
+    }
+    return fw->failed ? 1 : 0;
+}
+
+int
+sentry__filewriter_close(sentry_filewriter_t *fw)
+{
+    if (!fw) {
+        return 1;
+    }
+    int rv = fw->failed ? 1 : 0;
+    if (close(fw->fd) != 0) {
+        rv = 1;
+    }
+    sentry_free(fw);
+    return rv;
+}
+
+struct sentry_filereader_s {
+    int fd;
+};
+
+sentry_filereader_t *
+sentry__filereader_new(const sentry_path_t *path)
+{
+    int fd = open(path->path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    sentry_filereader_t *fr = SENTRY_MAKE(sentry_filereader_t);
+    if (!fr) {
+        close(fd);
+        return NULL;
+    }
+    fr->fd = fd;
+    return fr;
+}
+
+size_t
+sentry__filereader_read(sentry_filereader_t *fr, char *buf, size_t buf_len)
+{
+    size_t offset = 0;
+    while (offset < buf_len) {
+        ssize_t n = read(fr->fd, buf + offset, buf_len - offset);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        } else if (n <= 0) {
+            break;
+        }
+        offset += (size_t)n;
+    }
+    return offset;
+}
+
+int
+sentry__filereader_seek(sentry_filereader_t *fr, uint64_t offset)
+{
+    off_t pos = (off_t)offset;
+    if (pos < 0 || (uint64_t)pos != offset) {
+        return 1;
+    }
+    return lseek(fr->fd, pos, SEEK_SET) == pos ? 0 : 1;
+}
+
+void
+sentry__filereader_close(sentry_filereader_t *fr)
+{
+    if (!fr) {
+        return;
+    }
+    close(fr->fd);
+    sentry_free(fr);
+}
@@ -4,6 +4,7 @@
 #include "sentry_core.h"
 #include "sentry_path.h"
 #include "sentry_string.h"
+#include "sentry_sync.h"
 #include "sentry_utils.h"
 
 #include <errno.h>
@@ -25,7 +26,10 @@ static const size_t MAX_READ_TO_BUFFER = 134217728;
 struct sentry_pathiter_s {
     HANDLE dir_handle;
     const sentry_path_t *parent;
+    // the entries are written into this one buffer, right after the parent
+    // path and a separator, which are at the first `prefix_len` characters
     sentry_path_t *current;
+    size_t prefix_len;
 };
 
 static size_t
@@ -84,14 +88,55 @@ static sentry_path_t *
 path_with_len(size_t len)
 {
     sentry_path_t *rv = SENTRY_MAKE(sentry_path_t);
+    if (!rv) {
+        return NULL;
+    }
     rv->path = sentry_malloc(sizeof(wchar_t) * len);
     if (!rv->path) {
         sentry_free(rv);
         return NULL;
     }
+    rv->path_str = NULL;
+    rv->attributes = INVALID_FILE_ATTRIBUTES;
     return rv;
 }
 
+/**
+ * Returns whether `s` only consists of ASCII characters, and writes its length
+ * into `len_out`. The names the SDK uses for its files all are, which allows
+ * comparing them to wide paths without converting them first.
+ */
+static bool
+is_ascii(const char *s, size_t *len_out)
+{
+    size_t len = 0;
+    for (; s[len]; len++) {
+        if ((unsigned char)s[len] >= 0x80) {
+            return false;
+        }
+    }
+    *len_out = len;
+    return true;
+}
+
+/**
+ * Compares the wide `s` to the ASCII string `ascii`, ignoring the case of the
+ * letters.
+ */
+static bool
+ascii_ieq(const wchar_t *s, const char *ascii)
+{
+    for (size_t i = 0;; i++) {
+        wchar_t c = s[i];
+        if (c >= 0x80 || tolower((int)c) != tolower((int)ascii[i])) {
+            return false;
+        }
+        if (!c) {
+            return true;
+        }
+    }
+}
+
 sentry_path_t *
 sentry__path_absolute(const sentry_path_t *path)
 {
@@ -192,15 +237,10 @@ sentry_path_t *
 sentry__path_from_str(const char *s)
 {
     size_t len = MultiByteToWideChar(CP_ACP, 0, s, -1, NULL, 0);
-    sentry_path_t *rv = SENTRY_MAKE(sentry_path_t);
+    sentry_path_t *rv = path_with_len(len);
     if (!rv) {
         return NULL;
     }
-    rv->path = sentry_malloc(sizeof(wchar_t) * len);
-    if (!rv->path) {
-        sentry_free(rv);
-        return NULL;
-    }
     MultiByteToWideChar(CP_ACP, 0, s, -1, rv->path, (int)len);
     return rv;
 }
@@ -235,9 +275,48 @@ sentry__path_filename(const sentry_path_t *path)
     return ptr;
 }
 
+const char *
+sentry__path_str(const sentry_path_t *path)
+{
+    // the path is otherwise immutable, and the string may be created by
+    // multiple threads at once, of which only the first one is kept
+    sentry_path_t *mut_path = (sentry_path_t *)path;
+    void *volatile *cached = (void *volatile *)&mut_path->path_str;
+    char *str = sentry__atomic_fetch_ptr(cached);
+    if (str) {
+        return str;
+    }
+    str = sentry__string_from_wstr(path->path);
+    if (str && !sentry__atomic_compare_swap_ptr(cached, NULL, str)) {
+        sentry_free(str);
+        str = sentry__atomic_fetch_ptr(cached);
+    }
+    return str;
+}
+
+const char *
+sentry__path_filename_str(const sentry_path_t *path)
+{
+    const char *str = sentry__path_str(path);
+    if (!str) {
+        return NULL;
+    }
+    const char *filename = str;
+    for (const char *c = str; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            filename = c + 1;
+        }
+    }
+    return filename;
+}
+
 bool
 sentry__path_filename_matches(const sentry_path_t *path, const char *filename)
 {
+    size_t len;
+    if (is_ascii(filename, &len)) {
+        return ascii_ieq(sentry__path_filename(path), filename);
+    }
     sentry_path_t *fn = sentry__path_from_str(filename);
     bool matches = _wcsicmp(sentry__path_filename(path), fn->path) == 0;
     sentry__path_free(fn);
@@ -247,9 +326,15 @@ sentry__path_filename_matches(const sentry_path_t *path, const char *filename)
 bool
 sentry__path_ends_with(const sentry_path_t *path, const char *suffix)
 {
-    sentry_path_t *s = sentry__path_from_str(suffix);
     size_t pathlen = wcslen(path->path);
-    size_t suffixlen = wcslen(s->path);
+    size_t suffixlen;
+    if (is_ascii(suffix, &suffixlen)) {
+        return suffixlen <= pathlen
+            && ascii_ieq(&path->path[pathlen - suffixlen], suffix);
+    }
+
+    sentry_path_t *s = sentry__path_from_str(suffix);
+    suffixlen = wcslen(s->path);
     if (suffixlen > pathlen) {
         sentry__path_free(s);
         return false;
@@ -260,9 +345,24 @@ sentry__path_ends_with(const sentry_path_t *path, const char *suffix)
     return matches;
 }
 
+/**
+ * Returns whether the attributes of the iterated `path` can be used, instead
+ * of querying them again. Symbolic links and junctions are reparse points,
+ * which need to be followed.
+ */
+static bool
+has_cached_attributes(const sentry_path_t *path)
+{
+    return path->attributes != INVALID_FILE_ATTRIBUTES
+        && !(path->attributes & FILE_ATTRIBUTE_REPARSE_POINT);
+}
+
 bool
 sentry__path_is_dir(const sentry_path_t *path)
 {
+    if (has_cached_attributes(path)) {
+        return (path->attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    }
     struct _stat buf;
     return _wstat(path->path, &buf) == 0 && S_ISDIR(buf.st_mode);
 }
@@ -270,6 +370,10 @@ sentry__path_is_dir(const sentry_path_t *path)
 bool
 sentry__path_is_file(const sentry_path_t *path)
 {
+    if (has_cached_attributes(path)) {
+        return !(path->attributes
+            & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE));
+    }
     struct _stat buf;
     return _wstat(path->path, &buf) == 0 && S_ISREG(buf.st_mode);
 }
@@ -285,33 +389,49 @@ sentry__path_get_size(const sentry_path_t *path)
     }
 }
 
-sentry_path_t *
-sentry__path_append_str(const sentry_path_t *base, const char *suffix)
+/**
+ * Creates a new path out of `base`, an optional separator, and the narrow
+ * string `other`, which is converted right into the new path.
+ */
+static sentry_path_t *
+path_concat_str(const sentry_path_t *base, bool need_sep, const char *other)
 {
-    // convert to wstr
-    sentry_path_t *suffix_path = sentry__path_from_str(suffix);
-    if (!suffix_path) {
+    size_t base_len = wcslen(base->path);
+    size_t other_len = MultiByteToWideChar(CP_ACP, 0, other, -1, NULL, 0);
+    if (!other_len) {
         return NULL;
     }
-
-    // concat into new path
-    size_t len_base = wcslen(base->path);
-    size_t len_suffix = wcslen(suffix_path->path);
-    size_t len = len_base + len_suffix + 1;
-    sentry_path_t *rv = path_with_len(len);
-    if (rv) {
-        memcpy(rv->path, base->path, len_base * sizeof(wchar_t));
-        memcpy(rv->path + len_base, suffix_path->path,
-            (len_suffix + 1) * sizeof(wchar_t));
+    sentry_path_t *rv = path_with_len(base_len + other_len + 1);
+    if (!rv) {
+        return NULL;
     }
-    sentry__path_free(suffix_path);
-
+    memcpy(rv->path, base->path, base_len * sizeof(wchar_t));
+    if (need_sep) {
+        rv->path[base_len++] = L'\\';
+    }
+    MultiByteToWideChar(
+        CP_ACP, 0, other, -1, rv->path + base_len, (int)other_len);
     return rv;
 }
 
+sentry_path_t *
+sentry__path_append_str(const sentry_path_t *base, const char *suffix)
+{
+    return path_concat_str(base, false, suffix);
+}
+
 sentry_path_t *
 sentry__path_join_str(const sentry_path_t *base, const char *other)
 {
+    if (!(isalpha((unsigned char)other[0]) && other[1] == ':')
+        && other[0] != '/' && other[0] != '\\') {
+        // relative paths are converted right into the joined path
+        size_t base_len = wcslen(base->path);
+        bool need_sep = base_len && base->path[base_len - 1] != L'/'
+            && base->path[base_len - 1] != L'\\';
+        return path_concat_str(base, need_sep, other);
+    }
+
     sentry_path_t *other_path = sentry__path_from_str(other);
     if (!other_path) {
         return NULL;
@@ -324,11 +444,13 @@ sentry__path_join_str(const sentry_path_t *base, const char *other)
 sentry_path_t *
 sentry__path_clone(const sentry_path_t *path)
 {
-    sentry_path_t *rv = SENTRY_MAKE(sentry_path_t);
+    // `_wcsdup` would bypass `sentry_malloc`, which is what frees the path
+    size_t len = wcslen(path->path) + 1;
+    sentry_path_t *rv = path_with_len(len);
     if (!rv) {
         return NULL;
     }
-    rv->path = _wcsdup(path->path);
+    memcpy(rv->path, path->path, sizeof(wchar_t) * len);
     return rv;
 }
 
@@ -348,6 +470,32 @@ sentry__path_remove(const sentry_path_t *path)
     }
 }
 
+int
+sentry__path_rename(const sentry_path_t *src, const sentry_path_t *dst)
+{
+    if (MoveFileExW(src->path, dst->path, MOVEFILE_REPLACE_EXISTING)) {
+        return 0;
+    }
+    return 1;
+}
+
+int
+sentry__path_sync(const sentry_path_t *path)
+{
+    if (sentry__path_is_dir(path)) {
+        return 0;
+    }
+    HANDLE handle = CreateFileW(path->path, GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return 1;
+    }
+    int rv = FlushFileBuffers(handle) ? 0 : 1;
+    CloseHandle(handle);
+    return rv;
+}
+
 int
 sentry__path_create_dir_all(const sentry_path_t *path)
 {
@@ -392,9 +540,48 @@ sentry__path_iter_directory(const sentry_path_t *path)
     rv->dir_handle = INVALID_HANDLE_VALUE;
     rv->parent = path;
     rv->current = NULL;
+    rv->prefix_len = 0;
     return rv;
 }
 
+/**
+ * Opens the directory of `piter`, and allocates the buffer for its entries,
+ * which also holds the search pattern at first.
+ */
+static bool
+pathiter_open(sentry_pathiter_t *piter, WIN32_FIND_DATAW *data)
+{
+    const wchar_t *parent = piter->parent->path;
+    size_t prefix_len = wcslen(parent);
+    bool need_sep = prefix_len && parent[prefix_len - 1] != L'/'
+        && parent[prefix_len - 1] != L'\\';
+    // the file names in `WIN32_FIND_DATAW` have at most `MAX_PATH` characters,
+    // including their terminator
+    piter->current = path_with_len(prefix_len + 1 + MAX_PATH);
+    if (!piter->current) {
+        return false;
+    }
+    wchar_t *buf = piter->current->path;
+    memcpy(buf, parent, sizeof(wchar_t) * prefix_len);
+    if (need_sep) {
+        buf[prefix_len++] = L'\\';
+    }
+    piter->prefix_len = prefix_len;
+    buf[prefix_len] = L'*';
+    buf[prefix_len + 1] = 0;
+
+#if _WIN32_WINNT >= 0x0601
+    // the basic info leaves out the short 8.3 names, and the large fetch gets
+    // the entries of big directories in fewer round trips
+    piter->dir_handle = FindFirstFileExW(buf, FindExInfoBasic, data,
+        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+#else
+    // both of the above need at least Windows 7
+    piter->dir_handle = FindFirstFileW(buf, data);
+#endif
+    return piter->dir_handle != INVALID_HANDLE_VALUE;
+}
+
 const sentry_path_t *
 sentry__pathiter_next(sentry_pathiter_t *piter)
 {
@@ -402,18 +589,7 @@ sentry__pathiter_next(sentry_pathiter_t *piter)
 
     while (true) {
         if (piter->dir_handle == INVALID_HANDLE_VALUE) {
-            size_t path_len = wcslen(piter->parent->path);
-            wchar_t *pattern = sentry_malloc(sizeof(wchar_t) * (path_len + 3));
-            if (!pattern) {
-                return NULL;
-            }
-            memcpy(pattern, piter->parent->path, sizeof(wchar_t) * path_len);
-            pattern[path_len] = L'\\';
-            pattern[path_len + 1] = L'*';
-            pattern[path_len + 2] = 0;
-            piter->dir_handle = FindFirstFileW(pattern, &data);
-            sentry_free(pattern);
-            if (piter->dir_handle == INVALID_HANDLE_VALUE) {
+            if (piter->current || !pathiter_open(piter, &data)) {
                 return NULL;
             }
         } else {
@@ -429,11 +605,15 @@ sentry__pathiter_next(sentry_pathiter_t *piter)
         }
     }
 
-    if (piter->current) {
-        sentry__path_free(piter->current);
-    }
-    piter->current = sentry__path_join_wstr(piter->parent, data.cFileName);
-    return piter->current;
+    // the entry replaces the previous one in the same buffer, which
+    // invalidates the UTF-8 string of the previous one
+    sentry_path_t *current = piter->current;
+    memcpy(current->path + piter->prefix_len, data.cFileName,
+        sizeof(wchar_t) * (wcslen(data.cFileName) + 1));
+    sentry_free(current->path_str);
+    current->path_str = NULL;
+    current->attributes = data.dwFileAttributes;
+    return current;
 }
 
 void
@@ -508,6 +688,123 @@ sentry__path_read_to_buffer(const sentry_path_t *path, size_t *size_out)
     return rv;
 }
 
+bool
+sentry__path_mmap(sentry_mmap_t *rv, const sentry_path_t *path)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    // sharing deletion allows removing the file while it is mapped
+    HANDLE file = CreateFileW(path->path, GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0
+        || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    // the view keeps a reference to the mapping on its own
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!ptr) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = (size_t)size.QuadPart;
+    return true;
+}
+
+bool
+sentry__path_mmap_shared(
+    sentry_mmap_t *rv, const sentry_path_t *path, size_t len)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    if (!len) {
+        return false;
+    }
+    HANDLE file = CreateFileW(path->path, GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // creating the mapping extends the file to `len` zeroed bytes
+    uint64_t size = (uint64_t)len;
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READWRITE,
+        (DWORD)(size >> 32), (DWORD)size, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, len);
+    CloseHandle(mapping);
+    if (!ptr) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = len;
+    return true;
+}
+
+bool
+sentry__path_mmap_existing_shared(sentry_mmap_t *rv, const sentry_path_t *path)
+{
+    rv->ptr = NULL;
+    rv->len = 0;
+    HANDLE file = CreateFileW(path->path, GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0
+        || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READWRITE, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!ptr) {
+        return false;
+    }
+
+    rv->ptr = ptr;
+    rv->len = (size_t)size.QuadPart;
+    return true;
+}
+
+void
+sentry__mmap_close(sentry_mmap_t *m)
+{
+    if (m->ptr) {
+        UnmapViewOfFile(m->ptr);
+    }
+    m->ptr = NULL;
+    m->len = 0;
+}
+
 static int
 write_buffer_with_mode(const sentry_path_t *path, const char *buf,
     size_t buf_len, const wchar_t *mode)
@@ -536,3 +833,114 @@ sentry__path_append_buffer(
 {
     return write_buffer_with_mode(path, buf, buf_len, L"ab");
 }
+
+struct sentry_filewriter_s {
+    FILE *f;
+    bool failed;
+};
+
+static sentry_filewriter_t *
+filewriter_new_with_mode(const sentry_path_t *path, const wchar_t *mode)
+{
+    FILE *f = _wfopen(path->path, mode);
+    if (!f) {
+        return NULL;
+    }
+    sentry_filewriter_t *fw = SENTRY_MAKE(sentry_filewriter_t);
+    if (!fw) {
+        fclose(f);
+        return NULL;
+    }
+    fw->f = f;
+    fw->failed = false;
+    return fw;
+}
+
+sentry_filewriter_t *
+sentry__filewriter_new(const sentry_path_t *path)
+{
+    return filewriter_new_with_mode(path, L"wb");
+}
+
+sentry_filewriter_t *
+sentry__filewriter_new_append(const sentry_path_t *path)
+{
+    return filewriter_new_with_mode(path, L"ab");
+}
+
+int
+sentry__filewriter_write(
+    sentry_filewriter_t *fw, const char *buf, size_t buf_len)
+{
+    if (!fw->failed && write_loop(fw->f, buf, buf_len) != 0) {
+        fw->failed = true;
+    }
+    return fw->failed ? 1 : 0;
+}
+
+int
+sentry__filewriter_close(sentry_filewriter_t *fw)
+{
+    if (!fw) {
+        return 1;
+    }
+    int rv = fw->failed ? 1 : 0;
+    if (fclose(fw->f) != 0) {
+        rv = 1;
+    }
+    sentry_free(fw);
+    return rv;
+}
+
+struct sentry_filereader_s {
+    FILE *f;
+};
+
+sentry_filereader_t *
+sentry__filereader_new(const sentry_path_t *path)
+{
+    FILE *f = _wfopen(path->path, L"rb");
+    if (!f) {
+        return NULL;
+    }
+    sentry_filereader_t *fr = SENTRY_MAKE(sentry_filereader_t);
+    if (!fr) {
+        fclose(f);
+        return NULL;
+    }
+    fr->f = f;
+    return fr;
+}
+
+size_t
+sentry__filereader_read(sentry_filereader_t *fr, char *buf, size_t buf_len)
+{
+    size_t offset = 0;
+    while (offset < buf_len) {
+        size_t n = fread(buf + offset, 1, buf_len - offset, fr->f);
+        if (n == 0) {
+            break;
+        }
+        offset += n;
+    }
+    return offset;
+}
+
+int
+sentry__filereader_seek(sentry_filereader_t *fr, uint64_t offset)
+{
+    if (offset > (uint64_t)INT64_MAX) {
+        return 1;
+    }
+    return _fseeki64(fr->f, (__int64)offset, SEEK_SET) == 0 ? 0 : 1;
+}
+
+void
+sentry__filereader_close(sentry_filereader_t *fr)
+{
+    if (!fr) {
+        return;
+    }
+    fclose(fr->f);
+    sentry_free(fr);
+}
@@ -1,5 +1,8 @@
 #include "sentry_alloc.h"
+#include "sentry_string.h"
 #include "sentry_sync.h"
+#include "sentry_value.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,25 +13,203 @@
 #    define WITH_PAGE_ALLOCATOR
 #endif
 
-void *
-sentry_malloc(size_t size)
+static sentry_malloc_function_t g_malloc_func = NULL;
+static sentry_free_function_t g_free_func = NULL;
+static void *g_allocator_data = NULL;
+
+void
+sentry_set_allocator(sentry_malloc_function_t malloc_func,
+    sentry_free_function_t free_func, void *user_data)
+{
+    // the pooled string buffers belong to the previous allocator
+    sentry__stringbuilder_pool_clear();
+    if (!malloc_func || !free_func) {
+        malloc_func = NULL;
+        free_func = NULL;
+        user_data = NULL;
+    }
+    g_malloc_func = malloc_func;
+    g_free_func = free_func;
+    g_allocator_data = user_data;
+}
+
+static void *
+raw_malloc(size_t size)
 {
 #ifdef WITH_PAGE_ALLOCATOR
     if (sentry__page_allocator_enabled()) {
         return sentry__page_allocator_alloc(size);
     }
 #endif
+    if (g_malloc_func) {
+        return g_malloc_func(size, g_allocator_data);
+    }
     return malloc(size);
 }
 
-void
-sentry_free(void *ptr)
+static void
+raw_free(void *ptr)
 {
 #ifdef WITH_PAGE_ALLOCATOR
-    /* page allocator can't free */
     if (sentry__page_allocator_enabled()) {
+        sentry__page_allocator_free(ptr);
         return;
     }
 #endif
+    if (g_free_func) {
+        if (ptr) {
+            g_free_func(ptr, g_allocator_data);
+        }
+        return;
+    }
     free(ptr);
 }
+
+#ifdef SENTRY_WITH_MEMORY_TAGS
+/**
+ * Every allocation is prefixed with the size and tag that it is accounted
+ * with. The header is padded, so that the payload stays aligned like that of
+ * `malloc`.
+ */
+typedef union {
+    struct {
+        size_t size;
+        sentry_memory_tag_t tag;
+    } info;
+    char padding[16];
+} tag_header_t;
+
+static volatile long g_tag_bytes[SENTRY_MEMORY_TAG_COUNT];
+static volatile long g_tag_peak_bytes[SENTRY_MEMORY_TAG_COUNT];
+static volatile long g_total_bytes = 0;
+static volatile long g_total_peak_bytes = 0;
+static SENTRY_THREAD_LOCAL sentry_memory_tag_t g_current_tag
+    = SENTRY_MEMORY_TAG_OTHER;
+
+static const char *const TAG_NAMES[SENTRY_MEMORY_TAG_COUNT] = {
+    "other",
+    "value",
+    "scope",
+    "transport",
+    "modulefinder",
+    "json",
+    "envelope",
+    "page_allocator",
+};
+
+static void
+account(volatile long *bytes, volatile long *peak_bytes, long diff)
+{
+    long current = sentry__atomic_fetch_and_add(bytes, diff) + diff;
+    long peak = sentry__atomic_fetch(peak_bytes);
+    while (current > peak
+        && !sentry__atomic_compare_swap(peak_bytes, peak, current)) {
+        peak = sentry__atomic_fetch(peak_bytes);
+    }
+}
+
+static void *
+tagged_malloc(size_t size, sentry_memory_tag_t tag)
+{
+    if (size > SIZE_MAX - sizeof(tag_header_t)) {
+        return NULL;
+    }
+#    ifdef WITH_PAGE_ALLOCATOR
+    if (sentry__page_allocator_enabled()) {
+        tag = SENTRY_MEMORY_TAG_PAGE_ALLOCATOR;
+    }
+#    endif
+    tag_header_t *header = raw_malloc(sizeof(tag_header_t) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.tag = tag;
+    account(&g_tag_bytes[tag], &g_tag_peak_bytes[tag], (long)size);
+    account(&g_total_bytes, &g_total_peak_bytes, (long)size);
+    return header + 1;
+}
+
+sentry_memory_tag_t
+sentry__memory_tag_enter(sentry_memory_tag_t tag)
+{
+    sentry_memory_tag_t previous = g_current_tag;
+    g_current_tag = tag;
+    return previous;
+}
+
+void
+sentry__memory_tag_leave(sentry_memory_tag_t previous)
+{
+    g_current_tag = previous;
+}
+
+void *
+sentry__malloc_default_tag(size_t size, sentry_memory_tag_t tag)
+{
+    return tagged_malloc(
+        size, g_current_tag == SENTRY_MEMORY_TAG_OTHER ? tag : g_current_tag);
+}
+
+static sentry_value_t
+bytes_to_value(volatile long *bytes, volatile long *peak_bytes)
+{
+    sentry_value_t rv = sentry_value_new_object();
+    sentry_value_set_by_key(rv, "current_bytes",
+        sentry_value_new_int64(sentry__atomic_fetch(bytes)));
+    sentry_value_set_by_key(rv, "peak_bytes",
+        sentry_value_new_int64(sentry__atomic_fetch(peak_bytes)));
+    return rv;
+}
+
+sentry_value_t
+sentry__memory_tags_to_value(void)
+{
+    // the values that make up the result are accounted themselves, so the
+    // counters are read before creating any of them
+    long bytes[SENTRY_MEMORY_TAG_COUNT + 1];
+    long peak_bytes[SENTRY_MEMORY_TAG_COUNT + 1];
+    for (size_t i = 0; i < SENTRY_MEMORY_TAG_COUNT; i++) {
+        bytes[i] = sentry__atomic_fetch(&g_tag_bytes[i]);
+        peak_bytes[i] = sentry__atomic_fetch(&g_tag_peak_bytes[i]);
+    }
+    bytes[SENTRY_MEMORY_TAG_COUNT] = sentry__atomic_fetch(&g_total_bytes);
+    peak_bytes[SENTRY_MEMORY_TAG_COUNT]
+        = sentry__atomic_fetch(&g_total_peak_bytes);
+
+    sentry_value_t rv = sentry_value_new_object();
+    for (size_t i = 0; i <= SENTRY_MEMORY_TAG_COUNT; i++) {
+        sentry_value_set_by_key(rv,
+            i < SENTRY_MEMORY_TAG_COUNT ? TAG_NAMES[i] : "total",
+            bytes_to_value(&bytes[i], &peak_bytes[i]));
+    }
+    return rv;
+}
+#endif
+
+void *
+sentry_malloc(size_t size)
+{
+#ifdef SENTRY_WITH_MEMORY_TAGS
+    return tagged_malloc(size, g_current_tag);
+#else
+    return raw_malloc(size);
+#endif
+}
+
+void
+sentry_free(void *ptr)
+{
+#ifdef SENTRY_WITH_MEMORY_TAGS
+    if (!ptr) {
+        return;
+    }
+    tag_header_t *header = (tag_header_t *)ptr - 1;
+    long size = (long)header->info.size;
+    sentry_memory_tag_t tag = header->info.tag;
+    account(&g_tag_bytes[tag], &g_tag_peak_bytes[tag], -size);
+    account(&g_total_bytes, &g_total_peak_bytes, -size);
+    ptr = header;
+#endif
+    raw_free(ptr);
+}
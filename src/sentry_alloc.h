@@ -8,4 +8,56 @@
  */
 #define SENTRY_MAKE(Type) (Type *)sentry_malloc(sizeof(Type))
 
+/**
+ * The subsystems that allocations are attributed to with the
+ * `SENTRY_MEMORY_TAGS` CMake option.
+ */
+typedef enum {
+    SENTRY_MEMORY_TAG_OTHER,
+    SENTRY_MEMORY_TAG_VALUE,
+    SENTRY_MEMORY_TAG_SCOPE,
+    SENTRY_MEMORY_TAG_TRANSPORT,
+    SENTRY_MEMORY_TAG_MODULEFINDER,
+    SENTRY_MEMORY_TAG_JSON,
+    SENTRY_MEMORY_TAG_ENVELOPE,
+    SENTRY_MEMORY_TAG_PAGE_ALLOCATOR,
+    SENTRY_MEMORY_TAG_COUNT,
+} sentry_memory_tag_t;
+
+#ifdef SENTRY_WITH_MEMORY_TAGS
+/**
+ * Attributes the allocations of the current thread to `tag`, until
+ * `sentry__memory_tag_leave` is called with the returned previous tag.
+ */
+sentry_memory_tag_t sentry__memory_tag_enter(sentry_memory_tag_t tag);
+void sentry__memory_tag_leave(sentry_memory_tag_t previous);
+
+/**
+ * Allocates like `sentry_malloc`, but attributes the allocation to `tag`
+ * unless the current thread has entered a tag.
+ */
+void *sentry__malloc_default_tag(size_t size, sentry_memory_tag_t tag);
+
+/**
+ * Returns the current and peak bytes of every tag, and of all of them
+ * together, as an object Value.
+ */
+sentry_value_t sentry__memory_tags_to_value(void);
+
+/**
+ * Brackets a block whose allocations are attributed to `Tag`. Every
+ * `SENTRY_MEMORY_TAG_ENTER` must be matched by a `SENTRY_MEMORY_TAG_LEAVE` in
+ * the same scope, before any `return`.
+ */
+#    define SENTRY_MEMORY_TAG_ENTER(Tag)                                       \
+        sentry_memory_tag_t sentry__previous_memory_tag                        \
+            = sentry__memory_tag_enter(Tag)
+#    define SENTRY_MEMORY_TAG_LEAVE()                                          \
+        sentry__memory_tag_leave(sentry__previous_memory_tag)
+#else
+#    define sentry__malloc_default_tag(Size, Tag) sentry_malloc(Size)
+#    define SENTRY_MEMORY_TAG_ENTER(Tag) ((void)0)
+#    define SENTRY_MEMORY_TAG_LEAVE() ((void)0)
+#endif
+
 #endif
@@ -1,5 +1,9 @@
 #include "sentry_backend.h"
 
+#include "sentry_modulefinder.h"
+#include "sentry_options.h"
+#include "sentry_string.h"
+
 void
 sentry__backend_free(sentry_backend_t *backend)
 {
@@ -11,3 +15,48 @@ sentry__backend_free(sentry_backend_t *backend)
     }
     sentry_free(backend);
 }
+
+typedef struct {
+    const sentry_options_t *options;
+    void (*callback)(void *start, size_t size, void *data);
+    void *data;
+    size_t total_size;
+} minidump_ranges_t;
+
+static void
+add_minidump_range(const char *name, void *start, size_t size, void *data)
+{
+    minidump_ranges_t *ranges = (minidump_ranges_t *)data;
+    bool included = false;
+    for (const sentry_minidump_module_t *module
+         = ranges->options->minidump_modules;
+         module && !included; module = module->next) {
+#ifdef SENTRY_PLATFORM_WINDOWS
+        // file names are case-insensitive on windows
+        included = _stricmp(module->name, name) == 0;
+#else
+        included = sentry__string_eq(module->name, name);
+#endif
+    }
+    size_t max_size = ranges->options->minidump_max_size;
+    if (!included || (max_size && ranges->total_size >= max_size)) {
+        return;
+    }
+    if (max_size && size > max_size - ranges->total_size) {
+        size = max_size - ranges->total_size;
+    }
+    ranges->total_size += size;
+    ranges->callback(start, size, ranges->data);
+}
+
+size_t
+sentry__backend_foreach_minidump_range(const sentry_options_t *options,
+    void (*callback)(void *start, size_t size, void *data), void *data)
+{
+    if (!options->minidump_modules) {
+        return 0;
+    }
+    minidump_ranges_t ranges = { options, callback, data, 0 };
+    sentry__modulefinder_foreach_writable_range(add_minidump_range, &ranges);
+    return ranges.total_size;
+}
@@ -19,15 +19,22 @@ struct sentry_backend_s {
     void (*except_func)(sentry_backend_t *, const struct sentry_ucontext_s *);
     void (*flush_scope_func)(
         sentry_backend_t *, const sentry_options_t *options);
-    // NOTE: The breadcrumb is not moved into the hook and does not need to be
-    // `decref`-d internally.
-    void (*add_breadcrumb_func)(sentry_backend_t *, sentry_value_t breadcrumb,
+    // NOTE: The `count` breadcrumbs are not moved into the hook and do not
+    // need to be `decref`-d internally.
+    void (*add_breadcrumbs_func)(sentry_backend_t *,
+        const sentry_value_t *breadcrumbs, size_t count,
         const sentry_options_t *options);
     void (*user_consent_changed_func)(sentry_backend_t *);
     uint64_t (*get_last_crash_func)(sentry_backend_t *);
+    // NOTE: This and the `prune_database_func` are invoked from the
+    // background thread that processes the old runs.
     void (*prune_database_func)(sentry_backend_t *);
     void *data;
     bool can_capture_after_shutdown;
+    // NOTE: Backends with this set are shut down and started again in the
+    // child process after a `fork`, with `reinit_after_fork`, so that they
+    // write their crashes into the run of the child.
+    bool restart_after_fork;
 };
 
 /**
@@ -40,4 +47,13 @@ void sentry__backend_free(sentry_backend_t *backend);
  */
 sentry_backend_t *sentry__backend_new(void);
 
+/**
+ * Invokes `callback` for the memory ranges of the modules that were added via
+ * `sentry_options_add_minidump_module`, which the minidump backends include in
+ * their dumps. The ranges are truncated to stay within the
+ * `minidump_max_size`, and their total size is returned.
+ */
+size_t sentry__backend_foreach_minidump_range(const sentry_options_t *options,
+    void (*callback)(void *start, size_t size, void *data), void *data);
+
 #endif
@@ -0,0 +1,403 @@
+#include "sentry_breadcrumb.h"
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+#include <string.h>
+
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#endif
+
+// Types and categories come from a small set of names, which are interned
+// into this table. Once it is full, breadcrumbs with other names are kept as
+// Values, which bounds the memory of the table.
+#define INTERNED_NAMES_MAX 64
+#define INTERNED_NAME_LEN_MAX 64
+
+static sentry_mutex_t g_names_lock = SENTRY__MUTEX_INIT;
+static char *g_names[INTERNED_NAMES_MAX];
+static size_t g_names_len = 0;
+
+typedef enum {
+    KEY_TIMESTAMP,
+    KEY_TYPE,
+    KEY_CATEGORY,
+    KEY_LEVEL,
+    KEY_MESSAGE,
+} breadcrumb_key_t;
+
+static const char *
+intern_name(const char *name, size_t len)
+{
+    if (len > INTERNED_NAME_LEN_MAX) {
+        return NULL;
+    }
+    const char *rv = NULL;
+    sentry__mutex_lock(&g_names_lock);
+    for (size_t i = 0; i < g_names_len; i++) {
+        if (strncmp(g_names[i], name, len) == 0 && g_names[i][len] == '\0') {
+            rv = g_names[i];
+            goto done;
+        }
+    }
+    if (g_names_len < INTERNED_NAMES_MAX) {
+        char *interned = sentry__string_clonen(name, len);
+        if (interned) {
+            g_names[g_names_len++] = interned;
+            rv = interned;
+        }
+    }
+
+done:
+    sentry__mutex_unlock(&g_names_lock);
+    return rv;
+}
+
+static bool
+parse_level(const char *level, int8_t *level_out)
+{
+    static const struct {
+        const char *name;
+        sentry_level_t level;
+    } levels[] = {
+        { "debug", SENTRY_LEVEL_DEBUG },
+        { "info", SENTRY_LEVEL_INFO },
+        { "warning", SENTRY_LEVEL_WARNING },
+        { "error", SENTRY_LEVEL_ERROR },
+        { "fatal", SENTRY_LEVEL_FATAL },
+    };
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (strcmp(level, levels[i].name) == 0) {
+            *level_out = (int8_t)levels[i].level;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Parses the `iso` timestamp, but only if formatting it again results in the
+ * very same string.
+ */
+static bool
+parse_timestamp(const char *iso, uint64_t *timestamp_out)
+{
+    uint64_t timestamp = sentry__iso8601_to_msec(iso);
+    if (!timestamp) {
+        return false;
+    }
+    char *formatted = sentry__msec_time_to_iso8601(timestamp);
+    bool is_same = formatted && strcmp(formatted, iso) == 0;
+    sentry_free(formatted);
+    *timestamp_out = timestamp;
+    return is_same;
+}
+
+static bool
+compact_pair(sentry_breadcrumb_t *crumb, const char *key, sentry_value_t value)
+{
+    if (sentry_value_get_type(value) != SENTRY_VALUE_TYPE_STRING) {
+        return false;
+    }
+    size_t len;
+    const char *s = sentry__value_as_string_n(value, &len);
+    breadcrumb_key_t key_id;
+    if (sentry__string_eq(key, "timestamp")) {
+        key_id = KEY_TIMESTAMP;
+        if (!parse_timestamp(s, &crumb->timestamp)) {
+            return false;
+        }
+    } else if (sentry__string_eq(key, "type")) {
+        key_id = KEY_TYPE;
+        crumb->type = intern_name(s, len);
+        if (!crumb->type) {
+            return false;
+        }
+    } else if (sentry__string_eq(key, "category")) {
+        key_id = KEY_CATEGORY;
+        crumb->category = intern_name(s, len);
+        if (!crumb->category) {
+            return false;
+        }
+    } else if (sentry__string_eq(key, "level")) {
+        key_id = KEY_LEVEL;
+        if (!parse_level(s, &crumb->level)) {
+            return false;
+        }
+    } else if (sentry__string_eq(key, "message")) {
+        key_id = KEY_MESSAGE;
+        // an embedded NUL byte would cut the message short
+        if (len >= SENTRY_BREADCRUMB_MESSAGE_MAX || strlen(s) != len) {
+            return false;
+        }
+        memcpy(crumb->message, s, len + 1);
+        crumb->message_len = (uint8_t)len;
+    } else {
+        return false;
+    }
+    crumb->keys[crumb->key_count++] = (uint8_t)key_id;
+    return true;
+}
+
+bool
+sentry__breadcrumb_compact(sentry_breadcrumb_t *crumb, sentry_value_t value)
+{
+    size_t len = sentry_value_get_type(value) == SENTRY_VALUE_TYPE_OBJECT
+        ? sentry_value_get_length(value)
+        : SENTRY_BREADCRUMB_KEYS_MAX + 1;
+    if (len > SENTRY_BREADCRUMB_KEYS_MAX) {
+        return false;
+    }
+    crumb->key_count = 0;
+    for (size_t i = 0; i < len; i++) {
+        const char *key;
+        sentry_value_t v = sentry__value_get_pair_by_index(value, i, &key);
+        if (!compact_pair(crumb, key, v)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+sentry_value_t
+sentry__breadcrumb_to_value(const sentry_breadcrumb_t *crumb)
+{
+    sentry_value_t rv = sentry__value_new_object_with_size(crumb->key_count);
+    for (size_t i = 0; i < crumb->key_count; i++) {
+        switch ((breadcrumb_key_t)crumb->keys[i]) {
+        case KEY_TIMESTAMP:
+            sentry_value_set_by_key(rv, SENTRY_KEY(timestamp),
+                sentry__value_new_string_owned(
+                    sentry__msec_time_to_iso8601(crumb->timestamp)));
+            break;
+        case KEY_TYPE:
+            sentry_value_set_by_key(
+                rv, SENTRY_KEY(type), sentry_value_new_string(crumb->type));
+            break;
+        case KEY_CATEGORY:
+            sentry_value_set_by_key(rv, SENTRY_KEY(category),
+                sentry_value_new_string(crumb->category));
+            break;
+        case KEY_LEVEL:
+            sentry_value_set_by_key(rv, SENTRY_KEY(level),
+                sentry__value_new_level((sentry_level_t)crumb->level));
+            break;
+        case KEY_MESSAGE:
+            sentry_value_set_by_key(rv, SENTRY_KEY(message),
+                sentry_value_new_string_n(crumb->message, crumb->message_len));
+            break;
+        }
+    }
+    return rv;
+}
+
+#define QUEUE_SLOT_COUNT 256
+#define QUEUE_BATCH_SIZE 32
+
+/**
+ * The buffered breadcrumbs form a bounded lock-free queue, like the records of
+ * the async logger. The `sequence` of a slot equals the unsigned position
+ * while the slot is free for the breadcrumb at that position, is one more once
+ * it was written, and advances by `QUEUE_SLOT_COUNT` once it was taken.
+ *
+ * Unlike the logger, the tail is claimed with a compare-and-swap as well,
+ * since a crashing thread bypasses `g_queue_lock` and may drain the queue
+ * concurrently to the queue thread. The queue thread announces that it is
+ * `waiting` before it checks for a written breadcrumb a final time, so the
+ * writers only need to wake it up, if it does.
+ */
+typedef struct {
+    volatile long sequence;
+    sentry_value_t breadcrumb;
+} queue_slot_t;
+
+static queue_slot_t g_queue[QUEUE_SLOT_COUNT];
+static volatile long g_queue_head = 0;
+static volatile long g_queue_tail = 0;
+static volatile long g_queue_running = 0;
+static volatile long g_queue_waiting = 0;
+static bool g_queue_ready = false;
+static sentry_mutex_t g_queue_lock = SENTRY__MUTEX_INIT;
+static sentry_cond_t g_queue_cond;
+static sentry_threadid_t g_queue_thread;
+
+/**
+ * Puts the `breadcrumb` into the next free slot. Returns false if the queue is
+ * full.
+ */
+static bool
+queue_push(sentry_value_t breadcrumb)
+{
+    unsigned long pos = (unsigned long)sentry__atomic_fetch(&g_queue_head);
+    while (true) {
+        queue_slot_t *slot = &g_queue[pos % QUEUE_SLOT_COUNT];
+        unsigned long sequence
+            = (unsigned long)sentry__atomic_fetch(&slot->sequence);
+        long diff = (long)(sequence - pos);
+        if (diff < 0) {
+            // the breadcrumb of the previous lap was not taken yet
+            return false;
+        }
+        if (diff == 0
+            && sentry__atomic_compare_swap(
+                &g_queue_head, (long)pos, (long)(pos + 1))) {
+            slot->breadcrumb = breadcrumb;
+            sentry__atomic_store(&slot->sequence, (long)(pos + 1));
+            return true;
+        }
+        // another thread took this position first
+        pos = (unsigned long)sentry__atomic_fetch(&g_queue_head);
+    }
+}
+
+/**
+ * Takes the oldest breadcrumb out of the queue. Returns false if there is no
+ * written breadcrumb.
+ */
+static bool
+queue_pop(sentry_value_t *breadcrumb_out)
+{
+    unsigned long pos = (unsigned long)sentry__atomic_fetch(&g_queue_tail);
+    while (true) {
+        queue_slot_t *slot = &g_queue[pos % QUEUE_SLOT_COUNT];
+        unsigned long sequence
+            = (unsigned long)sentry__atomic_fetch(&slot->sequence);
+        long diff = (long)(sequence - (pos + 1));
+        if (diff < 0) {
+            return false;
+        }
+        if (diff == 0
+            && sentry__atomic_compare_swap(
+                &g_queue_tail, (long)pos, (long)(pos + 1))) {
+            *breadcrumb_out = slot->breadcrumb;
+            sentry__atomic_store(
+                &slot->sequence, (long)(pos + QUEUE_SLOT_COUNT));
+            return true;
+        }
+        // the crashing thread took this breadcrumb first
+        pos = (unsigned long)sentry__atomic_fetch(&g_queue_tail);
+    }
+}
+
+/**
+ * Returns whether the oldest breadcrumb in the queue was written.
+ */
+static bool
+queue_has_breadcrumb(void)
+{
+    unsigned long pos = (unsigned long)sentry__atomic_fetch(&g_queue_tail);
+    queue_slot_t *slot = &g_queue[pos % QUEUE_SLOT_COUNT];
+    return (unsigned long)sentry__atomic_fetch(&slot->sequence) == pos + 1;
+}
+
+/**
+ * Adds the buffered breadcrumbs to the scope in batches. This must be called
+ * with `g_queue_lock` held, so that the breadcrumbs are added in order.
+ */
+static void
+queue_drain(void)
+{
+    sentry_value_t batch[QUEUE_BATCH_SIZE];
+    size_t len;
+    do {
+        len = 0;
+        while (len < QUEUE_BATCH_SIZE && queue_pop(&batch[len])) {
+            len++;
+        }
+        if (len) {
+            sentry_add_breadcrumbs(batch, len);
+        }
+    } while (len == QUEUE_BATCH_SIZE);
+}
+
+SENTRY_THREAD_FN
+queue_thread_func(void *UNUSED(data))
+{
+    sentry__mutex_lock(&g_queue_lock);
+    while (sentry__atomic_fetch(&g_queue_running)) {
+        queue_drain();
+        sentry__atomic_store(&g_queue_waiting, 1);
+        if (!queue_has_breadcrumb() && sentry__atomic_fetch(&g_queue_running)) {
+            sentry__cond_wait(&g_queue_cond, &g_queue_lock);
+        }
+        sentry__atomic_store(&g_queue_waiting, 0);
+    }
+    queue_drain();
+    sentry__mutex_unlock(&g_queue_lock);
+    return 0;
+}
+
+void
+sentry__breadcrumbs_start_buffered(void)
+{
+    if (sentry__atomic_fetch(&g_queue_running)) {
+        return;
+    }
+    if (!g_queue_ready) {
+        for (unsigned long i = 0; i < QUEUE_SLOT_COUNT; i++) {
+            g_queue[i].sequence = (long)i;
+        }
+        g_queue_ready = true;
+    }
+    sentry__cond_init(&g_queue_cond);
+    sentry__thread_init(&g_queue_thread);
+    sentry__atomic_store(&g_queue_running, 1);
+    if (sentry__thread_spawn(&g_queue_thread, queue_thread_func, NULL) != 0) {
+        sentry__atomic_store(&g_queue_running, 0);
+        sentry__thread_free(&g_queue_thread);
+    }
+}
+
+void
+sentry__breadcrumbs_stop_buffered(void)
+{
+    if (!sentry__atomic_store(&g_queue_running, 0)) {
+        return;
+    }
+    sentry__mutex_lock(&g_queue_lock);
+    sentry__cond_wake(&g_queue_cond);
+    sentry__mutex_unlock(&g_queue_lock);
+    sentry__thread_join(g_queue_thread);
+    sentry__thread_free(&g_queue_thread);
+
+    // add the breadcrumbs that were written while the thread was exiting
+    sentry__breadcrumbs_flush();
+}
+
+void
+sentry__breadcrumbs_flush(void)
+{
+    if (sentry__atomic_fetch(&g_queue_tail)
+        == sentry__atomic_fetch(&g_queue_head)) {
+        return;
+    }
+    sentry__mutex_lock(&g_queue_lock);
+    queue_drain();
+    sentry__mutex_unlock(&g_queue_lock);
+}
+
+void
+sentry__breadcrumbs_add_buffered(sentry_value_t breadcrumb)
+{
+    bool buffered = sentry__atomic_fetch(&g_queue_running);
+#ifdef SENTRY_PLATFORM_UNIX
+    // the queue thread might not run anymore while handling a crash
+    buffered = buffered && !sentry__page_allocator_enabled();
+#endif
+    if (buffered && !queue_push(breadcrumb)) {
+        // draining the full queue keeps the breadcrumbs in order
+        sentry__breadcrumbs_flush();
+        buffered = queue_push(breadcrumb);
+    }
+    if (!buffered) {
+        sentry_add_breadcrumb(breadcrumb);
+    } else if (sentry__atomic_fetch(&g_queue_waiting)) {
+        sentry__mutex_lock(&g_queue_lock);
+        sentry__cond_wake(&g_queue_cond);
+        sentry__mutex_unlock(&g_queue_lock);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SENTRY_BREADCRUMB_H_INCLUDED
+#define SENTRY_BREADCRUMB_H_INCLUDED
+
+#include "sentry_boot.h"
+
+// the longest message of a compact breadcrumb, including its NUL terminator
+#define SENTRY_BREADCRUMB_MESSAGE_MAX 96
+// the most keys a compact breadcrumb can have: timestamp, type, category,
+// level and message
+#define SENTRY_BREADCRUMB_KEYS_MAX 5
+
+/**
+ * A breadcrumb that only consists of a timestamp, type, category, level and a
+ * short message, which is stored without any allocation. The type and
+ * category point to interned strings, which are never freed. `keys` holds the
+ * order in which the keys were set, so that the breadcrumb expands into the
+ * very same Value it was made from.
+ */
+typedef struct {
+    uint64_t timestamp;
+    const char *type;
+    const char *category;
+    int8_t level;
+    uint8_t key_count;
+    uint8_t keys[SENTRY_BREADCRUMB_KEYS_MAX];
+    uint8_t message_len;
+    char message[SENTRY_BREADCRUMB_MESSAGE_MAX];
+} sentry_breadcrumb_t;
+
+/**
+ * Turns the breadcrumb Object `value`, like one created by
+ * `sentry_value_new_breadcrumb`, into the compact `crumb`.
+ * Returns false if `value` has any other keys or values that do not fit, in
+ * which case it needs to be kept as is.
+ */
+bool sentry__breadcrumb_compact(
+    sentry_breadcrumb_t *crumb, sentry_value_t value);
+
+/**
+ * Expands the compact `crumb` into a new breadcrumb Object.
+ */
+sentry_value_t sentry__breadcrumb_to_value(const sentry_breadcrumb_t *crumb);
+
+/**
+ * Starts the background thread that adds the breadcrumbs passed to
+ * `sentry__breadcrumbs_add_buffered` to the scope, in batches.
+ */
+void sentry__breadcrumbs_start_buffered(void);
+
+/**
+ * Stops the background thread, after adding all the buffered breadcrumbs.
+ */
+void sentry__breadcrumbs_stop_buffered(void);
+
+/**
+ * Puts the `breadcrumb` into a bounded lock-free queue, if the background
+ * thread is running, and adds it via `sentry_add_breadcrumb` otherwise. When
+ * the queue is full, it is drained on the calling thread. This takes ownership
+ * of the `breadcrumb`.
+ */
+void sentry__breadcrumbs_add_buffered(sentry_value_t breadcrumb);
+
+/**
+ * Adds all the buffered breadcrumbs to the scope on the calling thread. This
+ * is safe to be called while handling a crash.
+ */
+void sentry__breadcrumbs_flush(void);
+
+#endif
@@ -4,42 +4,115 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef SENTRY_PLATFORM_WINDOWS
+#    include <sched.h>
+#endif
+
 #include "sentry_alloc.h"
 #include "sentry_backend.h"
+#include "sentry_breadcrumb.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
+#include "sentry_dedup.h"
 #include "sentry_envelope.h"
+#include "sentry_metrics.h"
+#include "sentry_modulefinder.h"
+#include "sentry_offline.h"
 #include "sentry_options.h"
+#include "sentry_os.h"
 #include "sentry_path.h"
+#include "sentry_profiler.h"
 #include "sentry_random.h"
+#include "sentry_ratelimiter.h"
+#include "sentry_sampling.h"
 #include "sentry_scope.h"
 #include "sentry_session.h"
+#include "sentry_session_aggregator.h"
+#include "sentry_stats.h"
 #include "sentry_string.h"
 #include "sentry_sync.h"
+#include "sentry_tracepoint.h"
 #include "sentry_tracing.h"
 #include "sentry_transport.h"
+#include "sentry_unwinder.h"
 #include "sentry_value.h"
+#include "sentry_watchdog.h"
+
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#endif
 
 #ifdef SENTRY_INTEGRATION_QT
 #    include "integrations/sentry_integration_qt.h"
 #endif
 
-static sentry_options_t *g_options = NULL;
+/**
+ * The options are published through an atomic pointer, so that readers do not
+ * need to take `g_options_lock`, which only serializes the writers. Readers
+ * announce themselves in the counter of the current epoch while they load the
+ * pointer and increment its refcount. `sentry_close` ends the epoch, and only
+ * waits for the readers of that epoch to leave before it drops its reference,
+ * so new readers can not hold it up. Whoever needs both `g_options_lock` and
+ * the scope lock takes `g_options_lock` first.
+ */
+static sentry_options_t *volatile g_options = NULL;
+static volatile long g_options_epoch = 0;
+static volatile long g_options_readers[2] = { 0, 0 };
 static sentry_mutex_t g_options_lock = SENTRY__MUTEX_INIT;
 
 /// see sentry_get_crashed_last_run() for the possible values
 static int g_last_crash = -1;
 
+// loads the modules list and the system contexts in the background right
+// after `sentry_init`, so that the first event does not need to wait for them
+static sentry_threadid_t g_modules_thread;
+static bool g_modules_thread_running = false;
+
 const sentry_options_t *
 sentry__options_getref(void)
 {
-    sentry_options_t *options;
-    sentry__mutex_lock(&g_options_lock);
-    options = sentry__options_incref(g_options);
-    sentry__mutex_unlock(&g_options_lock);
+    long epoch;
+    for (;;) {
+        epoch = sentry__atomic_fetch(&g_options_epoch);
+        sentry__atomic_fetch_and_add(&g_options_readers[epoch & 1], 1);
+        // this reader is only counted if the epoch did not end in between
+        if (sentry__atomic_fetch(&g_options_epoch) == epoch) {
+            break;
+        }
+        sentry__atomic_fetch_and_add(&g_options_readers[epoch & 1], -1);
+    }
+    sentry_options_t *options = sentry__options_incref(
+        sentry__atomic_fetch_ptr((void *volatile *)&g_options));
+    sentry__atomic_fetch_and_add(&g_options_readers[epoch & 1], -1);
     return options;
 }
 
+static void
+publish_options(sentry_options_t *options)
+{
+    sentry__atomic_exchange_ptr((void *volatile *)&g_options, options);
+}
+
+/**
+ * Unpublishes the global options, and waits for the readers that might have
+ * loaded them without incrementing their refcount yet.
+ */
+static void
+retire_options(void)
+{
+    publish_options(NULL);
+    // readers of the new epoch can only see `NULL`, and the ones of the
+    // previous epoch are only about to incref the retired options
+    long epoch = sentry__atomic_fetch_and_add(&g_options_epoch, 1);
+    while (sentry__atomic_fetch(&g_options_readers[epoch & 1]) != 0) {
+#ifdef SENTRY_PLATFORM_WINDOWS
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
 sentry_options_t *
 sentry__options_lock(void)
 {
@@ -74,21 +147,482 @@ load_user_consent(sentry_options_t *opts)
     sentry_free(contents);
 }
 
+bool
+sentry__options_should_skip_upload(const sentry_options_t *options)
+{
+    return options->require_user_consent
+        && sentry__atomic_fetch((long *)&options->user_consent)
+        != SENTRY_USER_CONSENT_GIVEN;
+}
+
 bool
 sentry__should_skip_upload(void)
 {
     bool skip = true;
     SENTRY_WITH_OPTIONS (options) {
-        skip = options->require_user_consent
-            && sentry__atomic_fetch((long *)&options->user_consent)
-                != SENTRY_USER_CONSENT_GIVEN;
+        skip = sentry__options_should_skip_upload(options);
     }
     return skip;
 }
 
+/**
+ * This runs concurrently with the caller of `sentry_init`, and so do the
+ * logger and the allocator of the user that it calls, see
+ * `sentry_set_allocator`.
+ */
+SENTRY_THREAD_FN
+load_modules_in_background(void *UNUSED(data))
+{
+    sentry__scope_add_system_contexts();
+    sentry_value_decref(sentry_get_modules_list());
+    sentry__unwinder_prepare();
+    return 0;
+}
+
+static void
+join_modules_thread(void)
+{
+    if (g_modules_thread_running) {
+        sentry__thread_join(g_modules_thread);
+        sentry__thread_free(&g_modules_thread);
+        g_modules_thread_running = false;
+    }
+}
+
+// the old runs are processed in batches of this many runs, and the runs which
+// are not processed by the time of `sentry_close` stay on disk for next time
+#define OLD_RUNS_PER_BATCH 16
+
+/**
+ * The "sentry-old-runs" thread looks up the last crash, prunes the database of
+ * the backend, and then processes the old runs in batches, until there are no
+ * more, or until `sentry_close` asks it to `stop`. It exits on its own once it
+ * is done. The state is shared by the thread and `g_old_runs`.
+ *
+ * The backend must not be shut down while the thread still uses it. When
+ * `sentry_close` runs out of time before that, it leaves the shutdown of the
+ * backend to the thread, via `shutdown_backend`.
+ */
+typedef struct {
+    long refcount;
+    sentry_options_t *options;
+    sentry_threadid_t thread_id;
+    sentry_mutex_t lock;
+    sentry_cond_t signal;
+    volatile long stop;
+    bool backend_busy;
+    bool shutdown_backend;
+    bool done;
+} old_runs_state_t;
+
+static sentry_mutex_t g_old_runs_lock = SENTRY__MUTEX_INIT;
+static old_runs_state_t *g_old_runs = NULL;
+
+static void
+old_runs_state_free(old_runs_state_t *state)
+{
+    sentry__thread_free(&state->thread_id);
+    sentry__mutex_free(&state->lock);
+    sentry_options_free(state->options);
+    sentry_free(state);
+}
+
+static void
+old_runs_state_decref(old_runs_state_t *state)
+{
+    if (sentry__atomic_fetch_and_add(&state->refcount, -1) == 1) {
+        old_runs_state_free(state);
+    }
+}
+
+SENTRY_THREAD_FN
+process_old_runs_thread(void *data)
+{
+    old_runs_state_t *state = (old_runs_state_t *)data;
+    // the id is written by `start_processing_old_runs` while holding the lock
+    sentry__mutex_lock(&state->lock);
+    sentry_threadid_t thread_id = state->thread_id;
+    sentry__mutex_unlock(&state->lock);
+    if (sentry__thread_setname(thread_id, "sentry-old-runs")) {
+        SENTRY_WARN("failed to set the old runs thread name");
+    }
+
+    sentry_options_t *options = state->options;
+    sentry_backend_t *backend = options->backend;
+    uint64_t last_crash = 0;
+    if (backend && backend->get_last_crash_func) {
+        last_crash = backend->get_last_crash_func(backend);
+    }
+    sentry_old_runs_t *old_runs = sentry__old_runs_new(options, last_crash);
+    if (backend && backend->prune_database_func) {
+        backend->prune_database_func(backend);
+    }
+
+    sentry__mutex_lock(&state->lock);
+    state->backend_busy = false;
+    bool shutdown_backend = state->shutdown_backend;
+    sentry__cond_wake(&state->signal);
+    sentry__mutex_unlock(&state->lock);
+    if (shutdown_backend && backend->shutdown_func) {
+        SENTRY_TRACE("shutting down backend after processing old runs");
+        backend->shutdown_func(backend);
+    }
+
+    while (old_runs && !sentry__atomic_fetch(&state->stop)
+        && sentry__old_runs_process(old_runs, OLD_RUNS_PER_BATCH)) { }
+    sentry__old_runs_free(old_runs);
+
+    sentry__mutex_lock(&state->lock);
+    state->done = true;
+    sentry__cond_wake(&state->signal);
+    sentry__mutex_unlock(&state->lock);
+    // the id of this thread may be reused by another one
+    sentry__unwinder_cache_thread_name(0, NULL);
+    old_runs_state_decref(state);
+    return 0;
+}
+
+/**
+ * Waits for up to `timeout` milliseconds until the old runs thread is done, or
+ * only until it does not use the backend anymore, if `backend_only` is set.
+ * This must be called with the lock of `state` held. Returns true if it is.
+ */
+static bool
+wait_for_old_runs(old_runs_state_t *state, uint64_t timeout, bool backend_only)
+{
+    uint64_t deadline = sentry__monotonic_time() + timeout;
+    while (backend_only ? state->backend_busy : !state->done) {
+        uint64_t now = sentry__monotonic_time();
+        if (now >= deadline) {
+            return false;
+        }
+        // this will implicitly release the lock, and re-acquire on wake
+        sentry__cond_wait_timeout(&state->signal, &state->lock, deadline - now);
+    }
+    return true;
+}
+
+static void
+start_processing_old_runs(sentry_options_t *options)
+{
+    old_runs_state_t *state = SENTRY_MAKE(old_runs_state_t);
+    if (state) {
+        memset(state, 0, sizeof(old_runs_state_t));
+        // one for the thread, and one for `g_old_runs`
+        state->refcount = 2;
+        state->options = sentry__options_incref(options);
+        state->backend_busy = true;
+        sentry__mutex_init(&state->lock);
+        sentry__cond_init(&state->signal);
+        sentry__thread_init(&state->thread_id);
+
+        sentry__mutex_lock(&state->lock);
+        bool spawned = sentry__thread_spawn(
+                           &state->thread_id, process_old_runs_thread, state)
+            == 0;
+        sentry__mutex_unlock(&state->lock);
+        if (spawned) {
+            sentry__mutex_lock(&g_old_runs_lock);
+            g_old_runs = state;
+            sentry__mutex_unlock(&g_old_runs_lock);
+            return;
+        }
+        old_runs_state_free(state);
+    }
+
+    SENTRY_WARN("failed to process old runs in the background");
+    sentry_backend_t *backend = options->backend;
+    sentry__process_old_runs(options,
+        backend && backend->get_last_crash_func
+            ? backend->get_last_crash_func(backend)
+            : 0);
+    if (backend && backend->prune_database_func) {
+        backend->prune_database_func(backend);
+    }
+}
+
+/**
+ * Stops the old runs thread, and waits for it for up to the `shutdown_timeout`.
+ * Returns false if the thread still uses the backend after that, in which case
+ * the thread shuts the backend down once it is done with it.
+ */
+static bool
+stop_processing_old_runs(void)
+{
+    sentry__mutex_lock(&g_old_runs_lock);
+    old_runs_state_t *state = g_old_runs;
+    g_old_runs = NULL;
+    sentry__mutex_unlock(&g_old_runs_lock);
+    if (!state) {
+        return true;
+    }
+
+    sentry__atomic_store(&state->stop, 1);
+    sentry__mutex_lock(&state->lock);
+    bool done
+        = wait_for_old_runs(state, state->options->shutdown_timeout, false);
+    bool backend_released = !state->backend_busy;
+    if (!backend_released) {
+        state->shutdown_backend = true;
+    }
+    sentry__mutex_unlock(&state->lock);
+
+    if (done) {
+        sentry__thread_join(state->thread_id);
+    } else {
+        SENTRY_WARN("old runs were not processed in time, leaving them to the "
+                    "background");
+        sentry__thread_detach(state->thread_id);
+    }
+    old_runs_state_decref(state);
+    return backend_released;
+}
+
+/**
+ * Waits for up to `timeout` milliseconds until the old runs thread does not
+ * use the backend anymore. Returns true if it does not.
+ */
+static bool
+wait_for_old_runs_backend(uint64_t timeout)
+{
+    sentry__mutex_lock(&g_old_runs_lock);
+    old_runs_state_t *state = g_old_runs;
+    if (state) {
+        sentry__atomic_fetch_and_add(&state->refcount, 1);
+    }
+    sentry__mutex_unlock(&g_old_runs_lock);
+    if (!state) {
+        return true;
+    }
+
+    sentry__mutex_lock(&state->lock);
+    bool released = wait_for_old_runs(state, timeout, true);
+    sentry__mutex_unlock(&state->lock);
+    old_runs_state_decref(state);
+    return released;
+}
+
+// prepares the events that are captured while `async_capture` is enabled.
+// capturing only needs a shared lock, so that the worker is not stopped in
+// the middle of submitting an event.
+static sentry_bgworker_t *g_capture_worker = NULL;
+// the events that were submitted to the capture worker, and are not freed yet
+static volatile long g_capture_queue_depth = 0;
+static sentry_rwlock_t g_capture_lock = SENTRY__RWLOCK_INIT;
+
+static void
+start_async_capture(const sentry_options_t *options)
+{
+    if (!options->async_capture) {
+        return;
+    }
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        return;
+    }
+    sentry__bgworker_setname(bgw, "sentry-capture");
+    if (sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start capturing events asynchronously");
+        sentry__bgworker_decref(bgw);
+        return;
+    }
+    sentry__rwlock_lock(&g_capture_lock);
+    g_capture_worker = bgw;
+    sentry__rwlock_unlock(&g_capture_lock);
+}
+
+static void
+stop_async_capture(void)
+{
+    sentry__rwlock_lock(&g_capture_lock);
+    sentry_bgworker_t *bgw = g_capture_worker;
+    g_capture_worker = NULL;
+    sentry__rwlock_unlock(&g_capture_lock);
+    // this prepares and sends all the events that are still queued
+    if (bgw
+        && sentry__bgworker_shutdown(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT)
+            == 0) {
+        sentry__bgworker_decref(bgw);
+    }
+}
+
+/**
+ * Stops the background workers that `sentry_init` starts. The watchdog may
+ * wait for the options lock while reporting a hang, and the session and
+ * capture workers while sending, so they need to be stopped before taking it.
+ */
+static void
+stop_background_workers(void)
+{
+    stop_async_capture();
+    sentry__offline_stop();
+    sentry__watchdog_stop();
+    sentry__profiler_stop();
+    sentry__session_persister_stop();
+    sentry__session_aggregator_stop();
+    sentry__metrics_stop();
+}
+
+#ifdef SENTRY_PLATFORM_UNIX
+/**
+ * With `reinit_after_fork`, the background workers are stopped before every
+ * `fork`, since only the forking thread is copied into the child, where the
+ * locks that the other threads held would stay locked forever. For the same
+ * reason, the options and scope locks are held across the `fork`, in the same
+ * order as `sentry_init` and `sentry_close` take them. Both processes then
+ * start the workers again, and the child gets a run, a session and a transport
+ * of its own.
+ */
+static pthread_once_t g_fork_handlers_once = PTHREAD_ONCE_INIT;
+static bool g_fork_prepared = false;
+
+static void
+fork_prepare(void)
+{
+    bool reinit = false;
+    SENTRY_WITH_OPTIONS (options) {
+        reinit = options->reinit_after_fork;
+    }
+    if (!reinit) {
+        return;
+    }
+    stop_background_workers();
+    sentry__durability_stop();
+    sentry__logger_stop_async();
+    sentry__breadcrumbs_stop_buffered();
+    join_modules_thread();
+    sentry__mutex_lock(&g_options_lock);
+    (void)sentry__scope_lock();
+    g_fork_prepared = true;
+}
+
+static void
+restart_background_workers(void)
+{
+    SENTRY_WITH_OPTIONS (options) {
+        if (options->debug && options->logger_async) {
+            sentry__logger_start_async();
+        }
+        sentry__durability_start(options);
+        // the offline state keeps a reference to the options
+        sentry__offline_start((sentry_options_t *)options);
+        sentry__session_persister_start(options);
+        sentry__session_aggregator_start(options);
+        sentry__metrics_start(options);
+        start_async_capture(options);
+        sentry__watchdog_start(options);
+        sentry__profiler_start(options);
+#ifdef SENTRY_INTEGRATION_QT
+        if (options->qt_buffered_breadcrumbs) {
+            sentry__breadcrumbs_start_buffered();
+        }
+#endif
+    }
+}
+
+static void
+fork_parent(void)
+{
+    if (!g_fork_prepared) {
+        return;
+    }
+    g_fork_prepared = false;
+    sentry__scope_unlock();
+    sentry__mutex_unlock(&g_options_lock);
+    restart_background_workers();
+}
+
+static void
+fork_child(void)
+{
+    if (!g_fork_prepared) {
+        return;
+    }
+    g_fork_prepared = false;
+    // the old runs are left to the thread of the parent, which does not exist
+    // in the child, just like the owner of any of the locks it used. No other
+    // thread is left to hold a reference to the state, so it is freed as is,
+    // once its lock is re-initialized.
+    sentry__mutex_init(&g_old_runs_lock);
+    if (g_old_runs) {
+        sentry__mutex_init(&g_old_runs->lock);
+        old_runs_state_free(g_old_runs);
+        g_old_runs = NULL;
+    }
+
+    sentry_options_t *options = g_options;
+    bool start_session = false;
+    if (options) {
+        // the run of the parent is kept as it is, since its journal and crash
+        // writer may still buffer writes of the parent
+        sentry_run_t *run = sentry__run_new(options->database_path);
+        if (run) {
+            sentry__filelock_close_inherited(options->run->lock);
+            sentry__run_set_quota(run, options->max_database_size,
+                options->max_database_envelopes);
+            if (options->run_journal && !sentry__run_set_journal(run)) {
+                SENTRY_WARN("failed to create the run journal");
+            }
+            options->run = run;
+        } else {
+            SENTRY_WARN("failed to initialize run directory after `fork`");
+        }
+
+        // the session of the parent is for the parent to end
+        sentry__session_free(options->session);
+        options->session = NULL;
+        options->session_dirty = false;
+        start_session = options->auto_session_tracking
+            && options->session_mode != SENTRY_SESSION_MODE_REQUEST;
+
+        options->transport
+            = sentry__transport_new_after_fork(options->transport);
+        if (options->transport
+            && sentry__transport_startup(options->transport, options) != 0) {
+            SENTRY_WARN("failed to initialize transport after `fork`");
+        }
+
+        sentry_backend_t *backend = options->backend;
+        if (backend && backend->restart_after_fork) {
+            backend->shutdown_func(backend);
+            if (backend->startup_func(backend, options) != 0) {
+                SENTRY_WARN("failed to initialize backend after `fork`");
+            }
+        }
+    }
+    // the other threads of the parent do not exist in the child, so the
+    // options they were reading are never released, and the offline lock
+    // that one of them may have held is never unlocked
+    sentry__atomic_store(&g_options_readers[0], 0);
+    sentry__atomic_store(&g_options_readers[1], 0);
+    sentry__offline_reset_after_fork();
+    // the locks that `fork_prepare` took are held by the forking thread, which
+    // continues as the thread of the child, but under a new thread id. The
+    // locks still record the id it had in the parent as their owner, so they
+    // can not be unlocked, and are reinitialized instead
+    sentry__mutex_init(&g_options_lock);
+    sentry__scope_unlock_after_fork();
+
+    restart_background_workers();
+    if (start_session) {
+        sentry_start_session();
+    }
+}
+
+static void
+register_fork_handlers(void)
+{
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+#endif
+
+static void capture_dedup_summaries(sentry_value_t summaries);
+
 int
 sentry_init(sentry_options_t *options)
 {
+    stop_background_workers();
+
     // this function is to be called only once, so we do not allow more than one
     // caller
     sentry__mutex_lock(&g_options_lock);
@@ -102,6 +636,10 @@ sentry_init(sentry_options_t *options)
         logger = options->logger;
     }
     sentry__logger_set_global(logger);
+    if (options->debug && options->logger_async) {
+        sentry__logger_start_async();
+    }
+    sentry__tracepoints_register();
 
     // we need to ensure the dir exists, otherwise `path_absolute` will fail.
     if (sentry__path_create_dir_all(options->database_path)) {
@@ -130,8 +668,44 @@ sentry_init(sentry_options_t *options)
         SENTRY_WARN("failed to initialize run directory");
         goto fail;
     }
+    sentry__run_set_quota(options->run, options->max_database_size,
+        options->max_database_envelopes);
+    sentry__durability_start(options);
+    if (options->run_journal && !sentry__run_set_journal(options->run)) {
+        SENTRY_WARN("failed to create the run journal");
+    }
 
     load_user_consent(options);
+    sentry__modulefinder_set_database_path(options->database_path);
+
+    options->throttle = sentry_malloc(
+        sizeof(sentry_token_bucket_t) * SENTRY_RL_CATEGORY_COUNT);
+    if (!options->throttle) {
+        goto fail;
+    }
+    sentry__token_bucket_init(&options->throttle[SENTRY_RL_CATEGORY_ANY], 0);
+    sentry__token_bucket_init(&options->throttle[SENTRY_RL_CATEGORY_ERROR],
+        options->max_events_per_second);
+    sentry__token_bucket_init(
+        &options->throttle[SENTRY_RL_CATEGORY_SESSION], 0);
+    sentry__token_bucket_init(
+        &options->throttle[SENTRY_RL_CATEGORY_TRANSACTION],
+        options->max_transactions_per_second);
+    options->level_samplers
+        = sentry_malloc(sizeof(sentry_rate_sampler_t) * SENTRY_LEVEL_COUNT);
+    if (!options->level_samplers) {
+        goto fail;
+    }
+    for (size_t i = 0; i < SENTRY_LEVEL_COUNT; i++) {
+        sentry__rate_sampler_init(&options->level_samplers[i],
+            options->max_level_events_per_second[i]);
+    }
+    if (options->traces_sampler && options->traces_sampler_cache_ttl) {
+        options->traces_sampler_cache
+            = sentry__sampler_cache_new(options->traces_sampler_cache_ttl);
+    }
+
+    options->event_header = sentry__scope_new_event_header(options);
 
     if (!options->dsn || !options->dsn->is_valid) {
         const char *raw_dsn = sentry_options_get_dsn(options);
@@ -146,10 +720,13 @@ sentry_init(sentry_options_t *options)
         }
     }
 
-    uint64_t last_crash = 0;
-
     // and then we will start the backend, since it requires a valid run
     sentry_backend_t *backend = options->backend;
+#ifdef SENTRY_PLATFORM_UNIX
+    if (backend) {
+        sentry__page_allocator_reserve(options->crash_memory_reserve);
+    }
+#endif
     if (backend && backend->startup_func) {
         SENTRY_TRACE("starting backend");
         if (backend->startup_func(backend, options) != 0) {
@@ -157,12 +734,9 @@ sentry_init(sentry_options_t *options)
             goto fail;
         }
     }
-    if (backend && backend->get_last_crash_func) {
-        last_crash = backend->get_last_crash_func(backend);
-    }
 
     g_last_crash = sentry__has_crash_marker(options);
-    g_options = options;
+    publish_options(options);
 
     // *after* setting the global options, trigger a scope and consent flush,
     // since at least crashpad needs that.
@@ -177,20 +751,39 @@ sentry_init(sentry_options_t *options)
 
 #ifdef SENTRY_INTEGRATION_QT
     SENTRY_TRACE("setting up Qt integration");
+    if (options->qt_buffered_breadcrumbs) {
+        sentry__breadcrumbs_start_buffered();
+    }
     sentry_integration_setup_qt();
 #endif
 
     // after initializing the transport, we will submit all the unsent envelopes
     // and handle remaining sessions.
     SENTRY_TRACE("processing and pruning old runs");
-    sentry__process_old_runs(options, last_crash);
-    if (backend && backend->prune_database_func) {
-        backend->prune_database_func(backend);
+    start_processing_old_runs(options);
+    sentry__offline_start(options);
+
+    sentry__session_persister_start(options);
+    sentry__session_aggregator_start(options);
+    sentry__metrics_start(options);
+    start_async_capture(options);
+    if (options->auto_session_tracking
+        && options->session_mode != SENTRY_SESSION_MODE_REQUEST) {
+        sentry_start_session();
     }
 
-    if (options->auto_session_tracking) {
-        sentry_start_session();
+    sentry__thread_init(&g_modules_thread);
+    g_modules_thread_running = !sentry__thread_spawn(
+        &g_modules_thread, load_modules_in_background, NULL);
+
+    sentry__watchdog_start(options);
+    sentry__profiler_start(options);
+
+#ifdef SENTRY_PLATFORM_UNIX
+    if (options->reinit_after_fork) {
+        pthread_once(&g_fork_handlers_once, register_fork_handlers);
     }
+#endif
 
     sentry__mutex_unlock(&g_options_lock);
     return 0;
@@ -200,6 +793,7 @@ fail:
     if (transport) {
         sentry__transport_shutdown(transport, 0);
     }
+    sentry__durability_stop();
     sentry_options_free(options);
     sentry__mutex_unlock(&g_options_lock);
     return 1;
@@ -208,9 +802,20 @@ fail:
 int
 sentry_flush(uint64_t timeout)
 {
+    sentry__breadcrumbs_flush();
+    uint64_t started = sentry__monotonic_time();
+    sentry__rwlock_lock_shared(&g_capture_lock);
+    if (g_capture_worker) {
+        // the events that are still being prepared are sent afterwards
+        sentry__bgworker_flush(g_capture_worker, timeout);
+    }
+    sentry__rwlock_unlock_shared(&g_capture_lock);
+    uint64_t elapsed = sentry__monotonic_time() - started;
+
     int rv = 0;
     SENTRY_WITH_OPTIONS (options) {
-        rv = sentry__transport_flush(options->transport, timeout);
+        rv = sentry__transport_flush(
+            options->transport, elapsed < timeout ? timeout - elapsed : 0);
     }
     return rv;
 }
@@ -218,6 +823,12 @@ sentry_flush(uint64_t timeout)
 int
 sentry_close(void)
 {
+    // the buffered breadcrumbs need the options and the backend
+    sentry__breadcrumbs_stop_buffered();
+    // the duplicates are summarized while the transport is still running
+    capture_dedup_summaries(sentry__dedup_flush());
+    stop_background_workers();
+
     // this function is to be called only once, so we do not allow more than one
     // caller
     sentry__mutex_lock(&g_options_lock);
@@ -225,8 +836,10 @@ sentry_close(void)
 
     size_t dumped_envelopes = 0;
     if (options) {
+        bool backend_released = stop_processing_old_runs();
         sentry_end_session();
-        if (options->backend && options->backend->shutdown_func) {
+        if (backend_released && options->backend
+            && options->backend->shutdown_func) {
             SENTRY_TRACE("shutting down backend");
             options->backend->shutdown_func(options->backend);
         }
@@ -245,16 +858,23 @@ sentry_close(void)
                 || !options->backend->can_capture_after_shutdown)) {
             sentry__run_clean(options->run);
         }
+        sentry__durability_stop();
+        retire_options();
         sentry_options_free(options);
     } else {
         SENTRY_DEBUG("sentry_close() called, but options was empty");
     }
 
-    g_options = NULL;
     sentry__mutex_unlock(&g_options_lock);
 
+    // the thread adds to the scope, so it needs to be done before the cleanup
+    join_modules_thread();
     sentry__scope_cleanup();
-    sentry_clear_modulecache();
+    sentry__system_contexts_cleanup();
+    sentry__modulefinder_cleanup();
+    sentry__module_index_cleanup();
+    sentry__logger_stop_async();
+    sentry__tracepoints_unregister();
 
     return (int)dumped_envelopes;
 }
@@ -271,19 +891,54 @@ sentry_reinstall_backend(void)
     int rv = 0;
     SENTRY_WITH_OPTIONS (options) {
         sentry_backend_t *backend = options->backend;
-        if (backend && backend->shutdown_func) {
-            backend->shutdown_func(backend);
-        }
+        // the old runs thread may still be using the backend
+        if (!wait_for_old_runs_backend(options->shutdown_timeout)) {
+            SENTRY_WARN("the backend is still in use and was not reinstalled");
+            rv = 1;
+        } else {
+            if (backend && backend->shutdown_func) {
+                backend->shutdown_func(backend);
+            }
 
-        if (backend && backend->startup_func) {
-            if (backend->startup_func(backend, options)) {
-                rv = 1;
+            if (backend && backend->startup_func) {
+                if (backend->startup_func(backend, options)) {
+                    rv = 1;
+                }
             }
         }
     }
     return rv;
 }
 
+sentry_value_t
+sentry_get_transport_stats(void)
+{
+    sentry_value_t stats = sentry_value_new_null();
+    SENTRY_WITH_OPTIONS (options) {
+        stats = sentry__transport_get_stats(options->transport);
+    }
+    return stats;
+}
+
+sentry_value_t
+sentry_get_stats(void)
+{
+    sentry_value_t stats = sentry__stats_to_value();
+    size_t transport_queue_depth = 0;
+    SENTRY_WITH_OPTIONS (options) {
+        transport_queue_depth
+            = sentry__transport_get_queue_depth(options->transport);
+    }
+    sentry_value_set_by_key(stats, "transport_queue_depth",
+        sentry_value_new_uint64(transport_queue_depth));
+    sentry_value_set_by_key(stats, "capture_queue_depth",
+        sentry_value_new_uint64(
+            (unsigned long)sentry__atomic_fetch(&g_capture_queue_depth)));
+    sentry_value_set_by_key(stats, "modules_bytes",
+        sentry_value_new_uint64(sentry__modulefinder_get_memory_usage()));
+    return stats;
+}
+
 static void
 set_user_consent(sentry_user_consent_t new_val)
 {
@@ -311,6 +966,9 @@ set_user_consent(sentry_user_consent_t new_val)
             sentry__path_remove(consent_path);
             break;
         }
+        if (new_val != SENTRY_USER_CONSENT_UNKNOWN) {
+            sentry__durability_commit(consent_path, false);
+        }
         sentry__path_free(consent_path);
     }
 }
@@ -344,105 +1002,503 @@ sentry_user_consent_get(void)
     return rv;
 }
 
-void
-sentry__capture_envelope(
-    sentry_transport_t *transport, sentry_envelope_t *envelope)
+void
+sentry__capture_envelope(
+    sentry_transport_t *transport, sentry_envelope_t *envelope)
+{
+    bool has_consent = !sentry__should_skip_upload();
+    if (!has_consent) {
+        SENTRY_TRACE("discarding envelope due to missing user consent");
+        sentry_envelope_free(envelope);
+        return;
+    }
+    if (sentry__offline_store_envelope(transport, envelope)) {
+        return;
+    }
+    sentry__transport_send_envelope(transport, envelope);
+}
+
+static bool
+event_is_considered_error(sentry_value_t event)
+{
+    const char *level
+        = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
+    if (sentry__string_eq(level, "fatal")
+        || sentry__string_eq(level, "error")) {
+        return true;
+    }
+    if (!sentry_value_is_null(sentry_value_get_by_key(event, "exception"))) {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Returns the level of the `event`, which is an error if it has none.
+ */
+static sentry_level_t
+event_level(sentry_value_t event)
+{
+    const char *level
+        = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
+    if (sentry__string_eq(level, "debug")) {
+        return SENTRY_LEVEL_DEBUG;
+    } else if (sentry__string_eq(level, "info")) {
+        return SENTRY_LEVEL_INFO;
+    } else if (sentry__string_eq(level, "warning")) {
+        return SENTRY_LEVEL_WARNING;
+    } else if (sentry__string_eq(level, "fatal")) {
+        return SENTRY_LEVEL_FATAL;
+    }
+    return SENTRY_LEVEL_ERROR;
+}
+
+bool
+sentry__event_is_transaction(sentry_value_t event)
+{
+    sentry_value_t event_type = sentry_value_get_by_key(event, "type");
+    return sentry__string_eq("transaction", sentry_value_as_string(event_type));
+}
+
+sentry_uuid_t
+sentry_capture_event(sentry_value_t event)
+{
+    if (sentry__event_is_transaction(event)) {
+        return sentry_uuid_nil();
+    }
+    // the event should contain the breadcrumbs that came before it
+    sentry__breadcrumbs_flush();
+    SENTRY_TRACEPOINT(capture__start);
+    sentry_uuid_t event_id = sentry__capture_event(event);
+    SENTRY_TRACEPOINT(capture__end);
+    return event_id;
+}
+
+bool
+sentry__roll_dice(double probability)
+{
+    uint64_t rnd;
+    return probability >= 1.0 || sentry__getrandom(&rnd, sizeof(rnd))
+        || ((double)rnd / (double)UINT64_MAX) <= probability;
+}
+
+static sentry_envelope_t *prepare_event(const sentry_options_t *options,
+    sentry_value_t event, sentry_uuid_t *event_id, bool invoke_before_send,
+    bool scope_applied);
+
+/**
+ * Adds the current session to the `envelope` of an event, and sends it.
+ */
+static void
+send_event_envelope(
+    const sentry_options_t *options, sentry_envelope_t *envelope)
+{
+    if (options->session) {
+        sentry_options_t *mut_options = sentry__options_lock();
+        sentry__envelope_add_session(envelope, mut_options->session);
+        // we're assuming that if a session is added to an envelope
+        // it will be sent onwards.  This means we now need to set
+        // the init flag to false because we're no longer the
+        // initial session update.
+        mut_options->session->init = false;
+        sentry__options_unlock();
+    }
+    sentry__stats_add(SENTRY_STAT_EVENTS_SENT, 1);
+    sentry__capture_envelope(options->transport, envelope);
+}
+
+/**
+ * An event that has the scope of the capturing thread applied, and is
+ * prepared on the capture worker, along with the arena of its values.
+ */
+typedef struct {
+    sentry_value_t event;
+    sentry_value_arena_t *arena;
+} async_event_t;
+
+static void
+free_async_event(void *task_data)
+{
+    async_event_t *async_event = task_data;
+    sentry_value_decref(async_event->event);
+    sentry__value_arena_decref(async_event->arena);
+    sentry_free(async_event);
+    sentry__atomic_fetch_and_add(&g_capture_queue_depth, -1);
+}
+
+static void
+capture_async_event_task(void *task_data, void *UNUSED(state))
+{
+    async_event_t *async_event = task_data;
+    SENTRY_WITH_OPTIONS (options) {
+        sentry_value_arena_t *prev_arena
+            = sentry__value_arena_enter(async_event->arena);
+        SENTRY_TRACEPOINT(prepare__start);
+        sentry_envelope_t *envelope
+            = prepare_event(options, async_event->event, NULL, true, true);
+        SENTRY_TRACEPOINT(prepare__end);
+        async_event->event = sentry_value_new_null();
+        sentry__value_arena_leave(prev_arena);
+        if (envelope) {
+            send_event_envelope(options, envelope);
+        }
+    }
+}
+
+/**
+ * Snapshots the scope into `event`, and leaves the rest of preparing and
+ * sending it to the capture worker. Returns false if the capture worker is not
+ * running.
+ */
+static bool
+capture_event_async(const sentry_options_t *options, sentry_value_t event,
+    sentry_uuid_t *event_id)
+{
+    sentry__rwlock_lock_shared(&g_capture_lock);
+    if (!g_capture_worker) {
+        sentry__rwlock_unlock_shared(&g_capture_lock);
+        return false;
+    }
+    async_event_t *async_event = SENTRY_MAKE(async_event_t);
+    if (!async_event) {
+        sentry__rwlock_unlock_shared(&g_capture_lock);
+        return false;
+    }
+    async_event->event = event;
+    async_event->arena = sentry__value_arena_new();
+
+    // the scopes may change as soon as we return, but the values of the
+    // global scope are frozen, so this only shares them
+    sentry_value_arena_t *prev_arena
+        = sentry__value_arena_enter(async_event->arena);
+    SENTRY_WITH_SCOPE (scope) {
+        SENTRY_TRACE("merging scope into event");
+        sentry__scope_apply_to_event(scope, options, event,
+            SENTRY_SCOPE_BREADCRUMBS | SENTRY_SCOPE_THREAD);
+    }
+    sentry__ensure_event_id(event, event_id);
+    sentry__value_arena_leave(prev_arena);
+
+    sentry__atomic_fetch_and_add(&g_capture_queue_depth, 1);
+    if (sentry__bgworker_submit(g_capture_worker, capture_async_event_task,
+            free_async_event, async_event)
+        != 0) {
+        // the scope is already applied, so the event is prepared right away
+        capture_async_event_task(async_event, NULL);
+        free_async_event(async_event);
+    }
+    sentry__rwlock_unlock_shared(&g_capture_lock);
+    return true;
+}
+
+/**
+ * Returns true if an event of the given `level` is to be thrown away before
+ * doing any of the work of preparing it, because of missing consent, the
+ * sample rates, the rate limits of the transport or the client side
+ * throttling. Otherwise, the effective sample rate of the event is written to
+ * `sample_rate_out`.
+ */
+static bool
+should_discard(const sentry_options_t *options, sentry_level_t level,
+    bool is_error, bool is_transaction, double *sample_rate_out)
+{
+    if (sentry__options_should_skip_upload(options)) {
+        SENTRY_TRACE("discarding event due to missing user consent");
+        return true;
+    }
+
+    double sample_rate = options->sample_rate;
+    bool sampled = sentry__roll_dice(sample_rate);
+    if (sampled && !is_transaction) {
+        sentry_rate_sampler_t *sampler
+            = &options->level_samplers[level - SENTRY_LEVEL_DEBUG];
+        double level_sample_rate = sentry__rate_sampler_sample_rate(
+            sampler, sentry__monotonic_time());
+        sampled = sentry__roll_dice(level_sample_rate);
+        sample_rate *= level_sample_rate;
+    }
+
+    if (!sampled) {
+        SENTRY_DEBUG("throwing away event due to sample rate");
+        sentry__stats_add(SENTRY_STAT_EVENTS_SAMPLED_OUT, 1);
+    } else {
+        int category = is_transaction ? SENTRY_RL_CATEGORY_TRANSACTION
+                                      : SENTRY_RL_CATEGORY_ERROR;
+        bool is_rate_limited = sentry__transport_is_rate_limited(
+            options->transport, category);
+        if (is_rate_limited) {
+            SENTRY_DEBUG("throwing away event due to rate limits");
+        } else if (!sentry__token_bucket_take(&options->throttle[category],
+                       sentry__monotonic_time())) {
+            SENTRY_DEBUG("throwing away event due to client side throttling");
+            is_rate_limited = true;
+        }
+        if (!is_rate_limited) {
+            *sample_rate_out = sample_rate;
+            return false;
+        }
+        sentry__stats_add(SENTRY_STAT_EVENTS_RATE_LIMITED, 1);
+        sentry__transport_record_rate_limited(options->transport, category);
+    }
+
+    // the errors still count towards the health of the session
+    if (is_error) {
+        sentry__record_errors_on_current_session(1);
+    }
+    return true;
+}
+
+/**
+ * Returns true if the `event` is to be thrown away, see `should_discard`.
+ */
+static bool
+should_discard_event(
+    const sentry_options_t *options, sentry_value_t event, bool is_transaction)
+{
+    double sample_rate;
+    if (should_discard(options, event_level(event),
+            !is_transaction && event_is_considered_error(event),
+            is_transaction, &sample_rate)) {
+        return true;
+    }
+    if (!is_transaction && sample_rate < 1.0) {
+        sentry_value_set_by_key(
+            event, "sample_rate", sentry_value_new_double(sample_rate));
+    }
+    return false;
+}
+
+/**
+ * Prepares and sends the `event`, which is not a transaction, unless it is
+ * left to the capture worker. Returns false if it was discarded.
+ */
+static bool
+send_event(const sentry_options_t *options, sentry_value_t event,
+    sentry_uuid_t *event_id)
+{
+    if (options->async_capture
+        && capture_event_async(options, event, event_id)) {
+        // whether it is sent is only known once it is prepared
+        return true;
+    }
+    sentry_envelope_t *envelope
+        = sentry__prepare_event(options, event, event_id, true);
+    if (!envelope) {
+        return false;
+    }
+    send_event_envelope(options, envelope);
+    return true;
+}
+
+/**
+ * Sends a sentry event, along with the `profile` of a transaction, which may
+ * be null.
+ */
+static sentry_uuid_t
+capture_event(sentry_value_t event, sentry_value_t profile)
+{
+    sentry_uuid_t event_id;
+    sentry_envelope_t *envelope = NULL;
+
+    bool was_captured = false;
+    bool was_sent = false;
+    SENTRY_WITH_OPTIONS (options) {
+        was_captured = true;
+        sentry__stats_add(SENTRY_STAT_EVENTS_CAPTURED, 1);
+
+        bool is_transaction = sentry__event_is_transaction(event);
+        if (should_discard_event(options, event, is_transaction)) {
+            sentry_value_decref(event);
+        } else if (is_transaction) {
+            envelope = sentry__prepare_transaction(
+                options, event, profile, &event_id);
+            profile = sentry_value_new_null();
+            if (envelope) {
+                send_event_envelope(options, envelope);
+                was_sent = true;
+            }
+        } else {
+            was_sent = send_event(options, event, &event_id);
+        }
+    }
+    if (!was_captured) {
+        sentry_value_decref(event);
+    }
+    sentry_value_decref(profile);
+    return was_sent ? event_id : sentry_uuid_nil();
+}
+
+/**
+ * Sends the `summaries` of suppressed duplicates, which are not checked for
+ * duplicates themselves.
+ */
+static void
+capture_dedup_summaries(sentry_value_t summaries)
 {
-    bool has_consent = !sentry__should_skip_upload();
-    if (!has_consent) {
-        SENTRY_TRACE("discarding envelope due to missing user consent");
-        sentry_envelope_free(envelope);
-        return;
+    for (size_t i = 0; i < sentry_value_get_length(summaries); i++) {
+        capture_event(sentry_value_get_by_index_owned(summaries, i),
+            sentry_value_new_null());
     }
-    sentry__transport_send_envelope(transport, envelope);
+    sentry_value_decref(summaries);
 }
 
+/**
+ * Returns true if `event` is a duplicate of a recently captured event, in
+ * which case it is thrown away.
+ */
 static bool
-event_is_considered_error(sentry_value_t event)
+is_duplicate_event(sentry_value_t event)
 {
-    const char *level
-        = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
-    if (sentry__string_eq(level, "fatal")
-        || sentry__string_eq(level, "error")) {
-        return true;
+    if (sentry__event_is_transaction(event)) {
+        return false;
     }
-    if (!sentry_value_is_null(sentry_value_get_by_key(event, "exception"))) {
-        return true;
+    bool is_duplicate = false;
+    sentry_value_t summaries = sentry_value_new_null();
+    SENTRY_WITH_OPTIONS (options) {
+        is_duplicate = sentry__dedup_check(event, options->dedup_window,
+            options->dedup_summary, sentry__monotonic_time(), &summaries);
+    }
+    if (is_duplicate) {
+        SENTRY_DEBUG("throwing away duplicate event");
+        // the errors still count towards the health of the session
+        if (event_is_considered_error(event)) {
+            sentry__record_errors_on_current_session(1);
+        }
     }
-    return false;
-}
-
-bool
-sentry__event_is_transaction(sentry_value_t event)
-{
-    sentry_value_t event_type = sentry_value_get_by_key(event, "type");
-    return sentry__string_eq("transaction", sentry_value_as_string(event_type));
+    capture_dedup_summaries(summaries);
+    return is_duplicate;
 }
 
 sentry_uuid_t
-sentry_capture_event(sentry_value_t event)
+sentry__capture_event(sentry_value_t event)
 {
-    if (sentry__event_is_transaction(event)) {
+    if (is_duplicate_event(event)) {
+        sentry_value_decref(event);
         return sentry_uuid_nil();
-    } else {
-        return sentry__capture_event(event);
     }
+    return capture_event(event, sentry_value_new_null());
 }
 
-bool
-sentry__roll_dice(double probability)
+/**
+ * The arguments of `sentry_capture_exception_n`, which are only turned into
+ * an event once it is known to be sent.
+ */
+typedef struct {
+    sentry_level_t level;
+    const char *type;
+    size_t type_len;
+    const char *value;
+    size_t value_len;
+    void *const *ips;
+    size_t ips_len;
+} exception_capture_t;
+
+static sentry_value_t
+new_exception_event(void *data)
 {
-    uint64_t rnd;
-    return probability >= 1.0 || sentry__getrandom(&rnd, sizeof(rnd))
-        || ((double)rnd / (double)UINT64_MAX) <= probability;
+    const exception_capture_t *capture = data;
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_set_by_key(
+        event, SENTRY_KEY(level), sentry__value_new_level(capture->level));
+
+    sentry_value_t exception = sentry_value_new_object();
+    sentry_value_set_by_key(exception, SENTRY_KEY(type),
+        sentry_value_new_string_n(capture->type, capture->type_len));
+    sentry_value_set_by_key(exception, SENTRY_KEY(value),
+        sentry_value_new_string_n(capture->value, capture->value_len));
+    if (capture->ips && capture->ips_len) {
+        sentry_value_set_stacktrace(
+            exception, (void **)capture->ips, capture->ips_len);
+    }
+    sentry_event_add_exception(event, exception);
+    return event;
 }
 
 sentry_uuid_t
-sentry__capture_event(sentry_value_t event)
+sentry_capture_exception_n(sentry_level_t level, const char *type,
+    size_t type_len, const char *value, size_t value_len, void *const *ips,
+    size_t ips_len)
 {
+    if (level < SENTRY_LEVEL_DEBUG || level > SENTRY_LEVEL_FATAL) {
+        level = SENTRY_LEVEL_ERROR;
+    }
+    exception_capture_t capture = { level, type ? type : "",
+        type ? type_len : 0, value ? value : "", value ? value_len : 0, ips,
+        ips_len };
+    uint64_t hash = sentry__dedup_hash_exception(level, capture.type,
+        capture.type_len, capture.value, capture.value_len, ips, ips_len);
+
+    // the event should contain the breadcrumbs that came before it
+    sentry__breadcrumbs_flush();
+    SENTRY_TRACEPOINT(capture__start);
     sentry_uuid_t event_id;
-    sentry_envelope_t *envelope = NULL;
-
-    bool was_captured = false;
     bool was_sent = false;
+    sentry_value_t summaries = sentry_value_new_null();
     SENTRY_WITH_OPTIONS (options) {
-        was_captured = true;
-
-        if (sentry__event_is_transaction(event)) {
-            envelope = sentry__prepare_transaction(options, event, &event_id);
-        } else {
-            envelope = sentry__prepare_event(options, event, &event_id, true);
+        if (sentry__dedup_check_hash(hash, options->dedup_window,
+                options->dedup_summary, sentry__monotonic_time(),
+                new_exception_event, &capture, &summaries)) {
+            SENTRY_DEBUG("throwing away duplicate event");
+            sentry__record_errors_on_current_session(1);
+            continue;
+        }
+        sentry__stats_add(SENTRY_STAT_EVENTS_CAPTURED, 1);
+        double sample_rate;
+        if (should_discard(options, level, true, false, &sample_rate)) {
+            continue;
         }
-        if (envelope) {
-            if (options->session) {
-                sentry_options_t *mut_options = sentry__options_lock();
-                sentry__envelope_add_session(envelope, mut_options->session);
-                // we're assuming that if a session is added to an envelope
-                // it will be sent onwards.  This means we now need to set
-                // the init flag to false because we're no longer the
-                // initial session update.
-                mut_options->session->init = false;
-                sentry__options_unlock();
-            }
 
-            bool should_skip = !sentry__roll_dice(options->sample_rate);
-            if (should_skip) {
-                SENTRY_DEBUG("throwing away event due to sample rate");
-                sentry_envelope_free(envelope);
-            } else {
-                sentry__capture_envelope(options->transport, envelope);
-                was_sent = true;
-            }
+        // only an event that is sent is created, in an arena of its own
+        sentry_value_arena_t *arena = sentry__value_arena_new();
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+        sentry_value_t event = new_exception_event(&capture);
+        if (sample_rate < 1.0) {
+            sentry_value_set_by_key(
+                event, "sample_rate", sentry_value_new_double(sample_rate));
         }
+        sentry__value_arena_leave(prev_arena);
+        was_sent = send_event(options, event, &event_id);
+        sentry__value_arena_decref(arena);
     }
-    if (!was_captured) {
-        sentry_value_decref(event);
-    }
+    capture_dedup_summaries(summaries);
+    SENTRY_TRACEPOINT(capture__end);
     return was_sent ? event_id : sentry_uuid_nil();
 }
 
+/**
+ * Returns the sample rate for the transaction described by `tx_cxt`, which
+ * comes from the cache of the `traces_sampler` if possible.
+ */
+static double
+get_traces_sample_rate(const sentry_options_t *options, sentry_value_t tx_cxt,
+    sentry_value_t sampling_ctx)
+{
+    if (!options->traces_sampler) {
+        return options->traces_sample_rate;
+    }
+    const char *name = sentry_value_as_string(
+        sentry_value_get_by_key(tx_cxt, "transaction"));
+    const char *op
+        = sentry_value_as_string(sentry_value_get_by_key(tx_cxt, "op"));
+    uint64_t now = sentry__monotonic_time();
+    double rate;
+    if (options->traces_sampler_cache
+        && sentry__sampler_cache_get(
+            options->traces_sampler_cache, name, op, now, &rate)) {
+        return rate;
+    }
+    rate = options->traces_sampler(
+        name, op, sampling_ctx, options->traces_sampler_data);
+    if (options->traces_sampler_cache) {
+        sentry__sampler_cache_put(
+            options->traces_sampler_cache, name, op, now, rate);
+    }
+    return rate;
+}
+
 bool
-sentry__should_send_transaction(sentry_value_t tx_cxt)
+sentry__should_send_transaction(
+    sentry_value_t tx_cxt, sentry_value_t sampling_ctx)
 {
     sentry_value_t context_setting = sentry_value_get_by_key(tx_cxt, "sampled");
     if (!sentry_value_is_null(context_setting)) {
@@ -451,16 +1507,20 @@ sentry__should_send_transaction(sentry_value_t tx_cxt)
 
     bool send = false;
     SENTRY_WITH_OPTIONS (options) {
-        send = sentry__roll_dice(options->traces_sample_rate);
-        // TODO(tracing): Run through traces sampler function if rate is
-        // unavailable.
+        send = sentry__roll_dice(
+            get_traces_sample_rate(options, tx_cxt, sampling_ctx));
     }
     return send;
 }
 
-sentry_envelope_t *
-sentry__prepare_event(const sentry_options_t *options, sentry_value_t event,
-    sentry_uuid_t *event_id, bool invoke_before_send)
+/**
+ * Prepares the `event` within the arena that is current on the calling thread.
+ * If `scope_applied` is set, the scope has been merged into the event already,
+ * and only the debug information is added.
+ */
+static sentry_envelope_t *
+prepare_event(const sentry_options_t *options, sentry_value_t event,
+    sentry_uuid_t *event_id, bool invoke_before_send, bool scope_applied)
 {
     sentry_envelope_t *envelope = NULL;
 
@@ -468,62 +1528,125 @@ sentry__prepare_event(const sentry_options_t *options, sentry_value_t event,
         sentry__record_errors_on_current_session(1);
     }
 
-    SENTRY_WITH_SCOPE (scope) {
-        SENTRY_TRACE("merging scope into event");
-        sentry_scope_mode_t mode = SENTRY_SCOPE_ALL;
-        if (!options->symbolize_stacktraces) {
-            mode &= ~SENTRY_SCOPE_STACKTRACES;
+    // symbolizing is slow, so unless the `before_send` hook needs to see the
+    // symbolized event, it is left to whoever serializes the envelope, which
+    // is usually the transport worker
+    bool symbolize_later = options->symbolize_stacktraces
+        && !(options->before_send_func && invoke_before_send);
+
+    sentry_scope_mode_t mode = SENTRY_SCOPE_ALL;
+    if (!options->symbolize_stacktraces || symbolize_later) {
+        mode &= ~SENTRY_SCOPE_STACKTRACES;
+    }
+    if (scope_applied) {
+        sentry__apply_debug_info_to_event(options, event, mode);
+    } else {
+        SENTRY_WITH_SCOPE (scope) {
+            SENTRY_TRACE("merging scope into event");
+            sentry__scope_apply_to_event(scope, options, event, mode);
         }
-        sentry__scope_apply_to_event(scope, options, event, mode);
     }
 
     if (options->before_send_func && invoke_before_send) {
+        // the scope collections are shared as frozen snapshots, so give the
+        // hook copies of them that it is able to modify at any depth
+        sentry__value_make_mutable_deep(&event);
+
+        // the values that the hook creates and keeps around must not pin the
+        // arena of the event
         SENTRY_TRACE("invoking `before_send` hook");
+        sentry_value_arena_t *event_arena = sentry__value_arena_enter(NULL);
         event
             = options->before_send_func(event, NULL, options->before_send_data);
+        sentry__value_arena_leave(event_arena);
         if (sentry_value_is_null(event)) {
             SENTRY_TRACE("event was discarded by the `before_send` hook");
+            sentry__stats_add(SENTRY_STAT_EVENTS_DISCARDED, 1);
             return NULL;
         }
     }
 
     sentry__ensure_event_id(event, event_id);
     envelope = sentry__envelope_new();
-    if (!envelope || !sentry__envelope_add_event(envelope, event)) {
-        goto fail;
+    if (!envelope
+        || !(symbolize_later
+                ? sentry__envelope_add_unsymbolized_event(envelope, event)
+                : sentry__envelope_add_event(envelope, event))) {
+        sentry_envelope_free(envelope);
+        sentry_value_decref(event);
+        return NULL;
     }
 
     SENTRY_TRACE("adding attachments to envelope");
-    for (sentry_attachment_t *attachment = options->attachments; attachment;
-         attachment = attachment->next) {
-        sentry_envelope_item_t *item = sentry__envelope_add_from_path(
-            envelope, attachment->path, "attachment");
-        if (!item) {
-            continue;
+    sentry__envelope_add_attachments(envelope, options);
+    return envelope;
+}
+
+sentry_envelope_t *
+sentry__prepare_event(const sentry_options_t *options, sentry_value_t event,
+    sentry_uuid_t *event_id, bool invoke_before_send)
+{
+    // everything we add to the event from here on is allocated from an arena,
+    // which goes away together with the envelope.
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+    SENTRY_TRACEPOINT(prepare__start);
+    sentry_envelope_t *envelope = prepare_event(
+        options, event, event_id, invoke_before_send, false);
+    SENTRY_TRACEPOINT(prepare__end);
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
+    return envelope;
+}
+
+/**
+ * Fills in the details of the `transaction` that the `profile` is missing.
+ */
+static void
+apply_transaction_to_profile(
+    sentry_value_t profile, sentry_value_t transaction)
+{
+    sentry_uuid_t profile_id = sentry_uuid_new_v4();
+    sentry_value_set_by_key(
+        profile, "event_id", sentry__value_new_internal_uuid(&profile_id));
+    const char *keys[] = { "release", "environment" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        sentry_value_t value = sentry_value_get_by_key(transaction, keys[i]);
+        if (!sentry_value_is_null(value)) {
+            sentry_value_incref(value);
+            sentry_value_set_by_key(profile, keys[i], value);
         }
-        sentry__envelope_item_set_header(item, "filename",
-#ifdef SENTRY_PLATFORM_WINDOWS
-            sentry__value_new_string_from_wstr(
-#else
-            sentry_value_new_string(
-#endif
-                sentry__path_filename(attachment->path)));
     }
 
-    return envelope;
+    sentry_value_t profile_tx = sentry_value_get_by_key(profile, "transaction");
+    sentry_value_set_by_key(profile_tx, "id",
+        sentry_value_get_by_key_owned(transaction, "event_id"));
+    sentry_value_set_by_key(profile_tx, "name",
+        sentry_value_get_by_key_owned(transaction, "transaction"));
+    sentry_value_t trace = sentry_value_get_by_key(
+        sentry_value_get_by_key(transaction, "contexts"), "trace");
+    sentry_value_set_by_key(profile_tx, "trace_id",
+        sentry_value_get_by_key_owned(trace, "trace_id"));
 
-fail:
-    sentry_envelope_free(envelope);
-    sentry_value_decref(event);
-    return NULL;
+    // the frames are only symbolized on the server
+    sentry_value_t modules = sentry_get_modules_list();
+    if (!sentry_value_is_null(modules)) {
+        sentry_value_t debug_meta = sentry_value_new_object();
+        sentry_value_set_by_key(debug_meta, "images", modules);
+        sentry_value_set_by_key(profile, "debug_meta", debug_meta);
+    }
 }
 
 sentry_envelope_t *
 sentry__prepare_transaction(const sentry_options_t *options,
-    sentry_value_t transaction, sentry_uuid_t *event_id)
+    sentry_value_t transaction, sentry_value_t profile,
+    sentry_uuid_t *event_id)
 {
     sentry_envelope_t *envelope = NULL;
 
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+
     SENTRY_WITH_SCOPE (scope) {
         SENTRY_TRACE("merging scope into transaction");
         // Don't include debugging info
@@ -538,15 +1661,25 @@ sentry__prepare_transaction(const sentry_options_t *options,
         goto fail;
     }
 
+    if (!sentry_value_is_null(profile)) {
+        apply_transaction_to_profile(profile, transaction);
+        sentry__envelope_add_profile(envelope, profile);
+    }
+
     // TODO(tracing): Revisit when adding attachment support for transactions.
 
+done:
+    sentry_value_decref(profile);
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
     return envelope;
 
 fail:
     SENTRY_WARN("dropping transaction");
     sentry_envelope_free(envelope);
     sentry_value_decref(transaction);
-    return NULL;
+    envelope = NULL;
+    goto done;
 }
 
 void
@@ -560,6 +1693,21 @@ sentry_handle_exception(const sentry_ucontext_t *uctx)
     }
 }
 
+void
+sentry__get_memory_usage(sentry_memory_usage_t *usage)
+{
+    memset(usage, 0, sizeof(sentry_memory_usage_t));
+    SENTRY_WITH_SCOPE (scope) {
+        usage->scope = sentry__scope_get_memory_usage(scope);
+        usage->transaction = sentry__scope_get_transaction_memory_usage(scope);
+    }
+    usage->modules = sentry__modulefinder_get_memory_usage();
+    SENTRY_WITH_OPTIONS (options) {
+        usage->transport_queue
+            = sentry__transport_get_memory_usage(options->transport);
+    }
+}
+
 sentry_uuid_t
 sentry__new_event_id(void)
 {
@@ -593,7 +1741,7 @@ sentry_set_user(sentry_value_t user)
         sentry_options_t *options = sentry__options_lock();
         if (options && options->session) {
             sentry__session_sync_user(options->session, user);
-            sentry__run_write_session(options->run, options->session);
+            sentry__session_changed(options);
         }
         sentry__options_unlock();
     }
@@ -611,30 +1759,73 @@ sentry_remove_user(void)
 }
 
 void
-sentry_add_breadcrumb(sentry_value_t breadcrumb)
+sentry_add_breadcrumbs(sentry_value_t *breadcrumbs, size_t count)
 {
     size_t max_breadcrumbs = SENTRY_BREADCRUMBS_MAX;
     SENTRY_WITH_OPTIONS (options) {
-        if (options->backend && options->backend->add_breadcrumb_func) {
-            // the hook will *not* take ownership
-            options->backend->add_breadcrumb_func(
-                options->backend, breadcrumb, options);
-        }
         max_breadcrumbs = options->max_breadcrumbs;
     }
 
+    // the breadcrumbs that would be evicted by the later ones right away are
+    // dropped up front
+    size_t skipped = count > max_breadcrumbs ? count - max_breadcrumbs : 0;
+    for (size_t i = 0; i < skipped; i++) {
+        sentry_value_decref(breadcrumbs[i]);
+    }
+    breadcrumbs += skipped;
+    count -= skipped;
+    if (!count) {
+        return;
+    }
+
+    // the scope takes ownership, so keep a reference for the backend hook
+    for (size_t i = 0; i < count; i++) {
+        sentry_value_incref(breadcrumbs[i]);
+    }
+
     // the `no_flush` will avoid triggering *both* scope-change and
     // breadcrumb-add events.
     SENTRY_WITH_SCOPE_MUT_NO_FLUSH (scope) {
-        sentry__value_append_bounded(
-            scope->breadcrumbs, breadcrumb, max_breadcrumbs);
+        sentry__ringbuffer_set_max_size(scope->breadcrumbs, max_breadcrumbs);
+        size_t len = sentry__ringbuffer_len(scope->breadcrumbs);
+        size_t evicted = len + count > max_breadcrumbs
+            ? len + count - max_breadcrumbs
+            : 0;
+        for (size_t i = 0; i < count; i++) {
+            sentry__ringbuffer_append(scope->breadcrumbs, breadcrumbs[i]);
+        }
+        sentry__stats_add(SENTRY_STAT_BREADCRUMBS_ADDED, count + skipped);
+        if (evicted + skipped) {
+            sentry__stats_add(
+                SENTRY_STAT_BREADCRUMBS_EVICTED, evicted + skipped);
+        }
+    }
+
+    // the hook runs once the breadcrumbs are part of the scope, so it can also
+    // pick up the whole scope
+    SENTRY_WITH_OPTIONS (options) {
+        if (options->backend && options->backend->add_breadcrumbs_func) {
+            // the hook will *not* take ownership
+            options->backend->add_breadcrumbs_func(
+                options->backend, breadcrumbs, count, options);
+        }
     }
+    for (size_t i = 0; i < count; i++) {
+        sentry_value_decref(breadcrumbs[i]);
+    }
+}
+
+void
+sentry_add_breadcrumb(sentry_value_t breadcrumb)
+{
+    sentry_add_breadcrumbs(&breadcrumb, 1);
 }
 
 void
 sentry_set_tag(const char *key, const char *value)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->tags);
         sentry_value_set_by_key(
             scope->tags, key, sentry_value_new_string(value));
     }
@@ -644,6 +1835,7 @@ void
 sentry_remove_tag(const char *key)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->tags);
         sentry_value_remove_by_key(scope->tags, key);
     }
 }
@@ -652,6 +1844,7 @@ void
 sentry_set_extra(const char *key, sentry_value_t value)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->extra);
         sentry_value_set_by_key(scope->extra, key, value);
     }
 }
@@ -660,14 +1853,61 @@ void
 sentry_remove_extra(const char *key)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->extra);
         sentry_value_remove_by_key(scope->extra, key);
     }
 }
 
+void
+sentry_set_thread_tag(const char *key, const char *value)
+{
+    sentry_thread_scope_t *scope = sentry__thread_scope_get();
+    if (scope) {
+        sentry_value_set_by_key(
+            scope->tags, key, sentry_value_new_string(value));
+    }
+}
+
+void
+sentry_remove_thread_tag(const char *key)
+{
+    sentry_thread_scope_t *scope = sentry__thread_scope_get();
+    if (scope) {
+        sentry_value_remove_by_key(scope->tags, key);
+    }
+}
+
+void
+sentry_set_thread_extra(const char *key, sentry_value_t value)
+{
+    sentry_thread_scope_t *scope = sentry__thread_scope_get();
+    if (scope) {
+        sentry_value_set_by_key(scope->extra, key, value);
+    } else {
+        sentry_value_decref(value);
+    }
+}
+
+void
+sentry_remove_thread_extra(const char *key)
+{
+    sentry_thread_scope_t *scope = sentry__thread_scope_get();
+    if (scope) {
+        sentry_value_remove_by_key(scope->extra, key);
+    }
+}
+
+void
+sentry_clear_thread_scope(void)
+{
+    sentry__thread_scope_clear();
+}
+
 void
 sentry_set_context(const char *key, sentry_value_t value)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->contexts);
         sentry_value_set_by_key(scope->contexts, key, value);
     }
 }
@@ -676,6 +1916,7 @@ void
 sentry_remove_context(const char *key)
 {
     SENTRY_WITH_SCOPE_MUT (scope) {
+        sentry__value_make_mutable(&scope->contexts);
         sentry_value_remove_by_key(scope->contexts, key);
     }
 }
@@ -733,14 +1974,12 @@ sentry_transaction_t *
 sentry_transaction_start(
     sentry_transaction_context_t *opaque_tx_cxt, sentry_value_t sampling_ctx)
 {
-    // Just free this immediately until we implement proper support for
-    // traces_sampler.
-    sentry_value_decref(sampling_ctx);
-
     if (!opaque_tx_cxt) {
+        sentry_value_decref(sampling_ctx);
         return NULL;
     }
 
+    sentry__transaction_context_apply_trace_header(opaque_tx_cxt);
     sentry_value_t tx_cxt = opaque_tx_cxt->inner;
 
     // If the parent span ID is some empty-ish value, just remove it
@@ -758,62 +1997,59 @@ sentry_transaction_start(
 
     sentry__value_merge_objects(tx, tx_cxt);
 
-    bool should_sample = sentry__should_send_transaction(tx_cxt);
+    bool should_sample = sentry__should_send_transaction(tx_cxt, sampling_ctx);
+    sentry_value_decref(sampling_ctx);
     sentry_value_set_by_key(
         tx, "sampled", sentry_value_new_bool(should_sample));
 
-    sentry_value_set_by_key(tx, "start_timestamp",
-        sentry__value_new_string_owned(
-            sentry__msec_time_to_iso8601(sentry__msec_time())));
-
     sentry__transaction_context_free(opaque_tx_cxt);
-    return sentry__transaction_new(tx);
+    sentry_transaction_t *opaque_tx = sentry__transaction_new(tx);
+    if (opaque_tx) {
+        // this spares starting and finishing spans from taking the options
+        // lock
+        SENTRY_WITH_OPTIONS (options) {
+            opaque_tx->max_spans = options->max_spans;
+            if (should_sample && options->profiles_sample_rate > 0.0
+                && sentry__roll_dice(options->profiles_sample_rate)) {
+                opaque_tx->profile = sentry__profile_begin();
+            }
+            if (options->span_chunk_size || options->span_chunk_max_bytes) {
+                opaque_tx->stream_spans = true;
+                opaque_tx->max_span_bytes = options->span_chunk_max_bytes;
+                if (options->span_chunk_size) {
+                    opaque_tx->max_spans = options->span_chunk_size;
+                }
+            }
+        }
+    }
+    return opaque_tx;
 }
 
-sentry_uuid_t
-sentry_transaction_finish(sentry_transaction_t *opaque_tx)
+/**
+ * Builds the transaction event of `opaque_tx`, which covers the time from
+ * `start_ns` until now, and contains the given `spans`.
+ */
+static sentry_value_t
+transaction_to_event(const sentry_transaction_t *opaque_tx, uint64_t start_ns,
+    sentry_value_t spans)
 {
-    if (!opaque_tx || sentry_value_is_null(opaque_tx->inner)) {
-        SENTRY_DEBUG("no transaction available to finish");
-        goto fail;
-    }
-
     sentry_value_t tx = sentry__value_clone(opaque_tx->inner);
-
-    SENTRY_WITH_SCOPE_MUT (scope) {
-        if (scope->transaction_object) {
-            sentry_value_t scope_tx = scope->transaction_object->inner;
-
-            const char *tx_id = sentry_value_as_string(
-                sentry_value_get_by_key(tx, "span_id"));
-            const char *scope_tx_id = sentry_value_as_string(
-                sentry_value_get_by_key(scope_tx, "span_id"));
-            if (sentry__string_eq(tx_id, scope_tx_id)) {
-                sentry__transaction_decref(scope->transaction_object);
-                scope->transaction_object = NULL;
-            }
-        }
-    }
-    // The sampling decision should already be made for transactions
-    // during their construction. No need to recalculate here. See
-    // `sentry__should_skip_transaction`.
-    sentry_value_t sampled = sentry_value_get_by_key(tx, "sampled");
-    if (!sentry_value_is_true(sampled)) {
-        SENTRY_DEBUG("throwing away transaction due to sample rate or "
-                     "user-provided sampling value in transaction context");
-        sentry_value_decref(tx);
-        goto fail;
-    }
     sentry_value_remove_by_key(tx, "sampled");
 
     sentry_value_set_by_key(tx, "type", sentry_value_new_string("transaction"));
+    sentry_value_set_by_key(tx, "start_timestamp",
+        sentry__transaction_timestamp_to_value(opaque_tx, start_ns));
     sentry_value_set_by_key(tx, "timestamp",
-        sentry__value_new_string_owned(
-            sentry__msec_time_to_iso8601(sentry__msec_time())));
+        sentry__transaction_timestamp_to_value(
+            opaque_tx, sentry__monotonic_time_ns()));
     // TODO: This might not actually be necessary. Revisit after talking to
     // the relay team about this.
     sentry_value_set_by_key(tx, "level", sentry_value_new_string("info"));
 
+    if (!sentry_value_is_null(spans)) {
+        sentry_value_set_by_key(tx, "spans", spans);
+    }
+
     sentry_value_t name = sentry_value_get_by_key(tx, "transaction");
     if (sentry_value_is_null(name) || sentry_value_get_length(name) == 0) {
         sentry_value_set_by_key(tx, "transaction",
@@ -835,11 +2071,72 @@ sentry_transaction_finish(sentry_transaction_t *opaque_tx)
     sentry_value_remove_by_key(tx, "description");
     sentry_value_remove_by_key(tx, "status");
 
+    return tx;
+}
+
+/**
+ * Sends the finished spans of the still running `opaque_tx` as a chunk. The
+ * chunk is a transaction of its own, whose parent is the root span of
+ * `opaque_tx`.
+ */
+static void
+flush_span_chunk(sentry_transaction_t *opaque_tx)
+{
+    uint64_t start_ns;
+    sentry_value_t spans = sentry__transaction_take_spans(opaque_tx, &start_ns);
+    if (sentry_value_is_null(spans)) {
+        return;
+    }
+    sentry_value_t tx = transaction_to_event(opaque_tx, start_ns, spans);
+
+    sentry_value_t trace_context = sentry_value_get_by_key(
+        sentry_value_get_by_key(tx, "contexts"), "trace");
+    sentry_uuid_t span_id = sentry_uuid_new_v4();
+    sentry_value_set_by_key(trace_context, "parent_span_id",
+        sentry_value_get_by_key_owned(trace_context, "span_id"));
+    sentry_value_set_by_key(
+        trace_context, "span_id", sentry__value_new_span_uuid(&span_id));
+
+    SENTRY_DEBUGF("sending a chunk of %zu spans",
+        sentry_value_get_length(sentry_value_get_by_key(tx, "spans")));
+    sentry__capture_event(tx);
+}
+
+sentry_uuid_t
+sentry_transaction_finish(sentry_transaction_t *opaque_tx)
+{
+    if (!opaque_tx || sentry_value_is_null(opaque_tx->inner)) {
+        SENTRY_DEBUG("no transaction available to finish");
+        goto fail;
+    }
+
+    SENTRY_WITH_SCOPE_MUT (scope) {
+        if (scope->transaction_object == opaque_tx) {
+            sentry__transaction_decref(scope->transaction_object);
+            scope->transaction_object = NULL;
+        }
+    }
+    // The sampling decision should already be made for transactions
+    // during their construction. No need to recalculate here. See
+    // `sentry__should_skip_transaction`.
+    if (!sentry_value_is_true(
+            sentry_value_get_by_key(opaque_tx->inner, "sampled"))) {
+        SENTRY_DEBUG("throwing away transaction due to sample rate or "
+                     "user-provided sampling value in transaction context");
+        sentry__stats_add(SENTRY_STAT_EVENTS_CAPTURED, 1);
+        sentry__stats_add(SENTRY_STAT_EVENTS_SAMPLED_OUT, 1);
+        goto fail;
+    }
+
+    sentry_value_t tx = transaction_to_event(opaque_tx, opaque_tx->start_ns,
+        sentry__transaction_spans_to_value(opaque_tx));
+    sentry_value_t profile = sentry__profile_end(opaque_tx->profile);
+    opaque_tx->profile = NULL;
     sentry__transaction_decref(opaque_tx);
 
     // This takes ownership of the transaction, generates an event ID, merges
     // scope
-    return sentry__capture_event(tx);
+    return capture_event(tx, profile);
 fail:
     sentry__transaction_decref(opaque_tx);
     return sentry_uuid_nil();
@@ -872,6 +2169,16 @@ sentry_set_span(sentry_span_t *span)
 sentry_span_t *
 sentry_transaction_start_child(
     sentry_transaction_t *opaque_parent, char *operation, char *description)
+{
+    return sentry_transaction_start_child_n(opaque_parent, operation,
+        operation ? strlen(operation) : 0, description,
+        description ? strlen(description) : 0);
+}
+
+sentry_span_t *
+sentry_transaction_start_child_n(sentry_transaction_t *opaque_parent,
+    const char *operation, size_t operation_len, const char *description,
+    size_t description_len)
 {
     if (!opaque_parent || sentry_value_is_null(opaque_parent->inner)) {
         SENTRY_DEBUG("no transaction available to create a child under");
@@ -879,21 +2186,30 @@ sentry_transaction_start_child(
     }
     sentry_value_t parent = opaque_parent->inner;
 
-    // TODO: consider snapshotting this value during tx creation and storing in
-    // tx and span
-    size_t max_spans = SENTRY_SPANS_MAX;
-    SENTRY_WITH_OPTIONS (options) {
-        max_spans = options->max_spans;
+    // spans of an unsampled transaction are never sent, so there is no point
+    // in building them
+    if (!sentry_value_is_true(
+            sentry_value_get_by_key(parent, SENTRY_KEY(sampled)))) {
+        return sentry__span_new_noop(opaque_parent);
     }
 
-    sentry_value_t span
-        = sentry__value_span_new(max_spans, parent, operation, description);
+    sentry_value_t span = sentry__value_span_new(opaque_parent, parent,
+        operation, operation_len, description, description_len);
     return sentry__span_new(opaque_parent, span);
 }
 
 sentry_span_t *
 sentry_span_start_child(
     sentry_span_t *opaque_parent, char *operation, char *description)
+{
+    return sentry_span_start_child_n(opaque_parent, operation,
+        operation ? strlen(operation) : 0, description,
+        description ? strlen(description) : 0);
+}
+
+sentry_span_t *
+sentry_span_start_child_n(sentry_span_t *opaque_parent, const char *operation,
+    size_t operation_len, const char *description, size_t description_len)
 {
     if (!opaque_parent || sentry_value_is_null(opaque_parent->inner)) {
         SENTRY_DEBUG("no parent span available to create a child span under");
@@ -903,17 +2219,13 @@ sentry_span_start_child(
         SENTRY_DEBUG("no root transaction to create a child span under");
         return NULL;
     }
-    sentry_value_t parent = opaque_parent->inner;
-
-    // TODO: consider snapshotting this value during tx creation and storing in
-    // tx and span
-    size_t max_spans = SENTRY_SPANS_MAX;
-    SENTRY_WITH_OPTIONS (options) {
-        max_spans = options->max_spans;
+    if (opaque_parent->noop) {
+        return sentry__span_new_noop(opaque_parent->transaction);
     }
+    sentry_value_t parent = opaque_parent->inner;
 
-    sentry_value_t span
-        = sentry__value_span_new(max_spans, parent, operation, description);
+    sentry_value_t span = sentry__value_span_new(opaque_parent->transaction,
+        parent, operation, operation_len, description, description_len);
 
     return sentry__span_new(opaque_parent->transaction, span);
 }
@@ -926,6 +2238,10 @@ sentry_span_finish(sentry_span_t *opaque_span)
         goto fail;
     }
 
+    if (opaque_span->noop) {
+        goto fail;
+    }
+
     sentry_transaction_t *opaque_root_transaction = opaque_span->transaction;
     if (!opaque_root_transaction
         || sentry_value_is_null(opaque_root_transaction->inner)) {
@@ -937,75 +2253,57 @@ sentry_span_finish(sentry_span_t *opaque_span)
     sentry_value_t root_transaction = opaque_root_transaction->inner;
 
     if (!sentry_value_is_true(
-            sentry_value_get_by_key(root_transaction, "sampled"))) {
+            sentry_value_get_by_key(root_transaction, SENTRY_KEY(sampled)))) {
         SENTRY_DEBUG("root transaction is unsampled, dropping span");
         goto fail;
     }
 
     if (!sentry_value_is_null(
-            sentry_value_get_by_key(root_transaction, "timestamp"))) {
+            sentry_value_get_by_key(root_transaction, SENTRY_KEY(timestamp)))) {
         SENTRY_DEBUG("span's root transaction is already finished, aborting "
                      "span finish");
         goto fail;
     }
 
-    sentry_value_t span = sentry__value_clone(opaque_span->inner);
-
-    SENTRY_WITH_SCOPE_MUT (scope) {
-        if (scope->span) {
-            sentry_value_t scope_span = scope->span->inner;
-
-            const char *span_id = sentry_value_as_string(
-                sentry_value_get_by_key(span, "span_id"));
-            const char *scope_span_id = sentry_value_as_string(
-                sentry_value_get_by_key(scope_span, "span_id"));
-            if (sentry__string_eq(span_id, scope_span_id)) {
-                sentry__span_decref(scope->span);
-                scope->span = NULL;
-            }
+    bool removed_from_scope = false;
+    SENTRY_WITH_SCOPE_MUT_NO_FLUSH (scope) {
+        if (scope->span == opaque_span) {
+            sentry__span_decref(scope->span);
+            scope->span = NULL;
+            removed_from_scope = true;
+        }
+    }
+    if (removed_from_scope) {
+        // this lets the backends know about the span being gone
+        SENTRY_WITH_SCOPE_MUT (scope) {
+            (void)scope;
         }
     }
 
     // Note that the current API makes it impossible to set a sampled value
     // that's different from the span's root transaction, but let's just be safe
     // here.
-    if (!sentry_value_is_true(sentry_value_get_by_key(span, "sampled"))) {
+    if (!sentry_value_is_true(
+            sentry_value_get_by_key(opaque_span->inner, SENTRY_KEY(sampled)))) {
         SENTRY_DEBUG("span is unsampled, dropping span");
-        sentry_value_decref(span);
         goto fail;
     }
 
-    if (!sentry_value_is_null(sentry_value_get_by_key(span, "timestamp"))) {
+    if (opaque_span->finished) {
         SENTRY_DEBUG("span is already finished, aborting span finish");
-        sentry_value_decref(span);
-        goto fail;
-    }
-
-    sentry_value_set_by_key(span, "timestamp",
-        sentry__value_new_string_owned(
-            sentry__msec_time_to_iso8601(sentry__msec_time())));
-    sentry_value_remove_by_key(span, "sampled");
-
-    size_t max_spans = SENTRY_SPANS_MAX;
-    SENTRY_WITH_OPTIONS (options) {
-        max_spans = options->max_spans;
-    }
-
-    sentry_value_t spans = sentry_value_get_by_key(root_transaction, "spans");
-
-    if (sentry_value_get_length(spans) >= max_spans) {
-        SENTRY_DEBUG("reached maximum number of spans for transaction, "
-                     "discarding span");
-        sentry_value_decref(span);
         goto fail;
     }
 
-    if (sentry_value_is_null(spans)) {
-        spans = sentry_value_new_list();
-        sentry_value_set_by_key(root_transaction, "spans", spans);
+    // the span is only turned into a Value once the transaction is finished,
+    // or its spans are streamed. The transaction is kept alive in case this
+    // was the last reference to it.
+    sentry__transaction_incref(opaque_root_transaction);
+    if (sentry__transaction_add_finished_span(
+            opaque_root_transaction, opaque_span)
+        && sentry__transaction_should_flush_spans(opaque_root_transaction)) {
+        flush_span_chunk(opaque_root_transaction);
     }
-    sentry_value_append(spans, span);
-    sentry__span_decref(opaque_span);
+    sentry__transaction_decref(opaque_root_transaction);
     return;
 
 fail:
@@ -6,6 +6,7 @@
 
 #define SENTRY_BREADCRUMBS_MAX 100
 #define SENTRY_SPANS_MAX 1000
+#define SENTRY_TRANSPORT_MAX_QUEUE_SIZE 1000
 
 #if defined(__GNUC__) && (__GNUC__ >= 4)
 #    define MUST_USE __attribute__((warn_unused_result))
@@ -29,6 +30,12 @@
  */
 bool sentry__should_skip_upload(void);
 
+/**
+ * The same check against the given `options`, for callers which can not take
+ * the options lock.
+ */
+bool sentry__options_should_skip_upload(const sentry_options_t *options);
+
 /**
  * Given a well-formed event, returns whether an event is a transaction or not.
  * Defaults to false, which will also be returned if the event is malformed.
@@ -65,15 +72,16 @@ sentry_uuid_t sentry__capture_event(sentry_value_t event);
  * - discard the transaction if it is unsampled
  * - apply the scope to the transaction
  * - add the transaction to a new envelope
- * - add any attachments to the envelope
+ * - add the `profile` of the transaction to the envelope, unless it is null
  *
  * The function will ensure the transaction has a UUID and write it into the
- * `event_id` out-parameter. This takes ownership of the transaction, which
- * means that the caller no longer needs to call `sentry_value_decref` on the
- * transaction.
+ * `event_id` out-parameter. This takes ownership of the transaction and the
+ * profile, which means that the caller no longer needs to call
+ * `sentry_value_decref` on them.
  */
 sentry_envelope_t *sentry__prepare_transaction(const sentry_options_t *options,
-    sentry_value_t transaction, sentry_uuid_t *event_id);
+    sentry_value_t transaction, sentry_value_t profile,
+    sentry_uuid_t *event_id);
 
 /**
  * This function will submit the `envelope` to the given `transport`, first
@@ -96,7 +104,28 @@ sentry_value_t sentry__ensure_event_id(
     sentry_value_t event, sentry_uuid_t *uuid_out);
 
 /**
- * This will return an owned reference to the global options.
+ * The number of bytes the SDK keeps resident, see `sentry__get_memory_usage`.
+ */
+typedef struct sentry_memory_usage_s {
+    // The global scope, including its breadcrumbs.
+    size_t scope;
+    // The transaction or span that is attached to the global scope.
+    size_t transaction;
+    // The cached modules list.
+    size_t modules;
+    // The envelopes waiting in the send queue of the transport.
+    size_t transport_queue;
+} sentry_memory_usage_t;
+
+/**
+ * Fills `usage` with the number of bytes that are currently allocated for the
+ * values held by the SDK, as per `sentry__value_get_memory_usage`.
+ */
+void sentry__get_memory_usage(sentry_memory_usage_t *usage);
+
+/**
+ * This will return an owned reference to the global options. This does not
+ * take the options lock, so it can be used on hot paths.
  */
 const sentry_options_t *sentry__options_getref(void);
 
@@ -117,7 +146,8 @@ void sentry__options_unlock(void);
 // these for now are only needed outside of core for tests
 #ifdef SENTRY_UNITTEST
 bool sentry__roll_dice(double probability);
-bool sentry__should_send_transaction(sentry_value_t tx_cxt);
+bool sentry__should_send_transaction(
+    sentry_value_t tx_cxt, sentry_value_t sampling_ctx);
 #endif
 
 #endif
@@ -1,11 +1,25 @@
 #include "sentry_database.h"
 #include "sentry_alloc.h"
+#include "sentry_core.h"
 #include "sentry_envelope.h"
 #include "sentry_json.h"
+#include "sentry_offline.h"
 #include "sentry_options.h"
 #include "sentry_session.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_transport.h"
+#include "sentry_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+// serializes the updates of the index within this process, see
+// `sentry__run_set_quota`
+static sentry_mutex_t g_index_lock = SENTRY__MUTEX_INIT;
+// guards the attachment hashes of all runs
+static sentry_mutex_t g_attachment_hashes_lock = SENTRY__MUTEX_INIT;
+
 sentry_run_t *
 sentry__run_new(const sentry_path_t *database_path)
 {
@@ -48,6 +62,17 @@ sentry__run_new(const sentry_path_t *database_path)
     run->uuid = uuid;
     run->run_path = run_path;
     run->session_path = session_path;
+    run->crash_path = NULL;
+    run->crash_pending_path = NULL;
+    run->crash_writer = NULL;
+    run->journal = NULL;
+    run->index_path = NULL;
+    run->crash_index_path = NULL;
+    run->max_database_size = 0;
+    run->max_database_envelopes = 0;
+    run->attachment_hashes = NULL;
+    run->attachment_hashes_len = 0;
+    run->attachment_hashes_allocated = 0;
     run->lock = sentry__filelock_new(lock_path);
     if (!run->lock || !sentry__filelock_try_lock(run->lock)) {
         sentry__run_free(run);
@@ -58,9 +83,39 @@ sentry__run_new(const sentry_path_t *database_path)
     return run;
 }
 
+sentry_run_t *
+sentry__run_clone(const sentry_run_t *run)
+{
+    sentry_run_t *clone = SENTRY_MAKE(sentry_run_t);
+    if (!clone) {
+        return NULL;
+    }
+    memset(clone, 0, sizeof(sentry_run_t));
+    clone->uuid = run->uuid;
+    clone->run_path = sentry__path_clone(run->run_path);
+    clone->index_path
+        = run->index_path ? sentry__path_clone(run->index_path) : NULL;
+    clone->crash_index_path = run->crash_index_path
+        ? sentry__path_clone(run->crash_index_path)
+        : NULL;
+    clone->max_database_size = run->max_database_size;
+    clone->max_database_envelopes = run->max_database_envelopes;
+    if (!clone->run_path || (run->index_path && !clone->index_path)) {
+        sentry__run_free(clone);
+        return NULL;
+    }
+    return clone;
+}
+
 void
 sentry__run_clean(sentry_run_t *run)
 {
+    if (run->crash_writer) {
+        sentry__filewriter_close(run->crash_writer);
+        run->crash_writer = NULL;
+    }
+    sentry__journal_free(run->journal);
+    run->journal = NULL;
     sentry__path_remove_all(run->run_path);
     sentry__filelock_unlock(run->lock);
 }
@@ -73,57 +128,670 @@ sentry__run_free(sentry_run_t *run)
     }
     sentry__path_free(run->run_path);
     sentry__path_free(run->session_path);
-    sentry__filelock_free(run->lock);
+    if (run->lock) {
+        sentry__filelock_free(run->lock);
+    }
+    if (run->crash_writer) {
+        sentry__filewriter_close(run->crash_writer);
+    }
+    sentry__path_free(run->crash_path);
+    sentry__path_free(run->crash_pending_path);
+    sentry__journal_free(run->journal);
+    sentry__path_free(run->index_path);
+    sentry__path_free(run->crash_index_path);
+    sentry_free(run->attachment_hashes);
     sentry_free(run);
 }
 
 bool
-sentry__run_write_envelope(
-    const sentry_run_t *run, const sentry_envelope_t *envelope)
+sentry__run_add_attachment_hash(sentry_run_t *run, uint64_t hash)
 {
-    // 37 for the uuid, 9 for the `.envelope` suffix
-    char envelope_filename[37 + 9];
-    sentry_uuid_t event_id = sentry__envelope_get_event_id(envelope);
-    sentry_uuid_as_string(&event_id, envelope_filename);
-    strcpy(&envelope_filename[36], ".envelope");
+    bool added = false;
+    sentry__mutex_lock(&g_attachment_hashes_lock);
+    size_t low = 0;
+    size_t high = run->attachment_hashes_len;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (run->attachment_hashes[mid] < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < run->attachment_hashes_len
+        && run->attachment_hashes[low] == hash) {
+        goto done;
+    }
+    // an attachment that cannot be recorded is sent again the next time
+    added = true;
+    if (run->attachment_hashes_len == run->attachment_hashes_allocated) {
+        size_t allocated = run->attachment_hashes_allocated
+            ? run->attachment_hashes_allocated * 2
+            : 16;
+        uint64_t *hashes = sentry_malloc(sizeof(uint64_t) * allocated);
+        if (!hashes) {
+            goto done;
+        }
+        if (run->attachment_hashes_len) {
+            memcpy(hashes, run->attachment_hashes,
+                sizeof(uint64_t) * run->attachment_hashes_len);
+        }
+        sentry_free(run->attachment_hashes);
+        run->attachment_hashes = hashes;
+        run->attachment_hashes_allocated = allocated;
+    }
+    memmove(&run->attachment_hashes[low + 1], &run->attachment_hashes[low],
+        sizeof(uint64_t) * (run->attachment_hashes_len - low));
+    run->attachment_hashes[low] = hash;
+    run->attachment_hashes_len++;
+
+done:
+    sentry__mutex_unlock(&g_attachment_hashes_lock);
+    return added;
+}
+
+bool
+sentry__run_set_journal(sentry_run_t *run)
+{
+    if (!run->journal) {
+        sentry_path_t *journal_path
+            = sentry__path_join_str(run->run_path, "journal");
+        run->journal = journal_path ? sentry__journal_new(journal_path) : NULL;
+        sentry__path_free(journal_path);
+    }
+    return run->journal != NULL;
+}
+
+void
+sentry__run_set_quota(sentry_run_t *run, size_t max_size, size_t max_envelopes)
+{
+    sentry__path_free(run->index_path);
+    sentry__path_free(run->crash_index_path);
+    run->index_path = NULL;
+    run->crash_index_path = NULL;
+    run->max_database_size = max_size;
+    run->max_database_envelopes = max_envelopes;
+    if (max_size || max_envelopes) {
+        sentry_path_t *database_path = sentry__path_dir(run->run_path);
+        if (database_path) {
+            run->index_path
+                = sentry__path_join_str(database_path, "envelopes.index");
+            run->crash_index_path = run->index_path
+                ? sentry__path_append_str(run->index_path, ".crash")
+                : NULL;
+            sentry__path_free(database_path);
+        }
+    }
+}
+
+/**
+ * An entry of the index is a line of the form:
+ * `<timestamp> <priority> <size> <uuid>.run <filename>`
+ * where the envelopes of the offline backlog have `offline` as their run.
+ */
+typedef struct {
+    uint64_t timestamp;
+    long priority;
+    size_t size;
+    const char *run_name;
+    const char *filename;
+    bool evicted;
+} index_entry_t;
+
+/**
+ * Appends the entry of the envelope at `path` to the index. The index is only
+ * ever replaced under `g_index_lock`, which a crash can not take, since the
+ * crashed thread may hold it already. The entries of crash envelopes go to a
+ * file of their own instead, which `enforce_quota` merges into the index.
+ */
+static void
+index_add_entry(const sentry_run_t *run, const char *dir_name,
+    const char *filename, const sentry_envelope_t *envelope,
+    const sentry_path_t *path, bool is_crash)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry__stringbuilder_append_int64(&sb, (int64_t)sentry__msec_time());
+    sentry__stringbuilder_append_char(&sb, ' ');
+    sentry__stringbuilder_append_int64(
+        &sb, (int64_t)sentry__envelope_get_priority(envelope));
+    sentry__stringbuilder_append_char(&sb, ' ');
+    sentry__stringbuilder_append_int64(
+        &sb, (int64_t)sentry__path_get_size(path));
+    sentry__stringbuilder_append_char(&sb, ' ');
+    sentry__stringbuilder_append(&sb, dir_name);
+    sentry__stringbuilder_append_char(&sb, ' ');
+    sentry__stringbuilder_append(&sb, filename);
+    sentry__stringbuilder_append_char(&sb, '\n');
+
+    size_t len = sentry__stringbuilder_len(&sb);
+    char *line = sentry__stringbuilder_into_string(&sb);
+    if (!line) {
+        return;
+    }
+    if (is_crash) {
+        if (run->crash_index_path) {
+            sentry__path_append_buffer(run->crash_index_path, line, len);
+        }
+    } else {
+        sentry__mutex_lock(&g_index_lock);
+        sentry__path_append_buffer(run->index_path, line, len);
+        sentry__mutex_unlock(&g_index_lock);
+    }
+    sentry_free(line);
+}
+
+/**
+ * Splits the next space or newline delimited token off `*ptr`.
+ */
+static char *
+next_token(char **ptr, char *end)
+{
+    char *token = *ptr;
+    while (*ptr < end && **ptr != ' ' && **ptr != '\n') {
+        (*ptr)++;
+    }
+    if (*ptr < end) {
+        **ptr = '\0';
+        (*ptr)++;
+    }
+    return token;
+}
+
+/**
+ * Parses the entries of the index in `buf`, skipping over malformed lines,
+ * and returns their number.
+ */
+static size_t
+parse_index(char *buf, size_t buf_len, index_entry_t **entries_out)
+{
+    size_t line_count = 0;
+    for (size_t i = 0; i < buf_len; i++) {
+        line_count += buf[i] == '\n';
+    }
+    index_entry_t *entries = sentry_malloc(
+        sizeof(index_entry_t) * (line_count ? line_count : 1));
+    if (!entries) {
+        return 0;
+    }
+
+    size_t entry_count = 0;
+    char *ptr = buf;
+    char *end = buf + buf_len;
+    while (ptr < end && entry_count < line_count) {
+        char *line_end = memchr(ptr, '\n', end - ptr);
+        if (!line_end) {
+            // a line which is still being appended
+            break;
+        }
+        index_entry_t *entry = &entries[entry_count];
+        entry->timestamp = strtoull(next_token(&ptr, line_end), NULL, 10);
+        entry->priority = strtol(next_token(&ptr, line_end), NULL, 10);
+        entry->size = (size_t)strtoull(next_token(&ptr, line_end), NULL, 10);
+        entry->run_name = next_token(&ptr, line_end);
+        entry->filename = next_token(&ptr, line_end);
+        entry->evicted = false;
+        *line_end = '\0';
+        ptr = line_end + 1;
+        if (*entry->run_name && *entry->filename) {
+            entry_count++;
+        }
+    }
+    *entries_out = entries;
+    return entry_count;
+}
+
+static int
+compare_eviction_order(const void *a, const void *b)
+{
+    const index_entry_t *entry_a = *(const index_entry_t *const *)a;
+    const index_entry_t *entry_b = *(const index_entry_t *const *)b;
+    if (entry_a->priority != entry_b->priority) {
+        return entry_a->priority < entry_b->priority ? -1 : 1;
+    }
+    if (entry_a->timestamp != entry_b->timestamp) {
+        return entry_a->timestamp < entry_b->timestamp ? -1 : 1;
+    }
+    return 0;
+}
+
+static sentry_path_t *
+entry_path(const sentry_path_t *database_path, const index_entry_t *entry)
+{
+    sentry_path_t *run_path
+        = sentry__path_join_str(database_path, entry->run_name);
+    sentry_path_t *path
+        = run_path ? sentry__path_join_str(run_path, entry->filename) : NULL;
+    sentry__path_free(run_path);
+    return path;
+}
+
+/**
+ * Removes the envelope of `entry` from disk, if it is still there.
+ */
+static void
+evict_entry(const sentry_path_t *database_path, index_entry_t *entry)
+{
+    sentry_path_t *path = entry_path(database_path, entry);
+    if (path && sentry__path_is_file(path)) {
+        SENTRY_DEBUGF("evicting envelope \"%s\" to stay within the database "
+                      "quota",
+            entry->filename);
+        sentry__path_remove(path);
+    }
+    sentry__path_free(path);
+    entry->evicted = true;
+}
 
-    sentry_path_t *output_path
-        = sentry__path_join_str(run->run_path, envelope_filename);
+static void
+write_index(const sentry_path_t *index_path, const index_entry_t *entries,
+    size_t entry_count)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    for (size_t i = 0; i < entry_count; i++) {
+        const index_entry_t *entry = &entries[i];
+        if (entry->evicted) {
+            continue;
+        }
+        sentry__stringbuilder_append_int64(&sb, (int64_t)entry->timestamp);
+        sentry__stringbuilder_append_char(&sb, ' ');
+        sentry__stringbuilder_append_int64(&sb, (int64_t)entry->priority);
+        sentry__stringbuilder_append_char(&sb, ' ');
+        sentry__stringbuilder_append_int64(&sb, (int64_t)entry->size);
+        sentry__stringbuilder_append_char(&sb, ' ');
+        sentry__stringbuilder_append(&sb, entry->run_name);
+        sentry__stringbuilder_append_char(&sb, ' ');
+        sentry__stringbuilder_append(&sb, entry->filename);
+        sentry__stringbuilder_append_char(&sb, '\n');
+    }
+
+    // the new index replaces the old one in one go, so that a concurrent
+    // reader never sees it half written
+    size_t len = sentry__stringbuilder_len(&sb);
+    char *buf = sentry__stringbuilder_into_string(&sb);
+    sentry_path_t *tmp_path = sentry__path_append_str(index_path, ".tmp");
+    if (buf && tmp_path && sentry__path_write_buffer(tmp_path, buf, len) == 0) {
+        sentry__path_rename(tmp_path, index_path);
+    }
+    sentry__path_free(tmp_path);
+    sentry_free(buf);
+}
+
+/**
+ * Reads the entries of crash envelopes which were added since the last time,
+ * see `index_add_entry`, and appends them to `*buf`. The file is moved aside
+ * first, so that an entry which is added in the meantime is kept for the next
+ * time.
+ */
+static void
+read_crash_entries(const sentry_run_t *run, char **buf, size_t *buf_len,
+    sentry_path_t **merged_path_out)
+{
+    sentry_path_t *merged_path
+        = sentry__path_append_str(run->crash_index_path, ".merged");
+    if (!merged_path || !sentry__path_is_file(run->crash_index_path)
+        || sentry__path_rename(run->crash_index_path, merged_path)) {
+        sentry__path_free(merged_path);
+        return;
+    }
+    size_t crash_len = 0;
+    char *crash_buf = sentry__path_read_to_buffer(merged_path, &crash_len);
+    char *merged = crash_buf ? sentry_malloc(*buf_len + crash_len + 1) : NULL;
+    if (merged) {
+        if (*buf) {
+            memcpy(merged, *buf, *buf_len);
+        }
+        memcpy(merged + *buf_len, crash_buf, crash_len);
+        merged[*buf_len + crash_len] = '\0';
+        sentry_free(*buf);
+        *buf = merged;
+        *buf_len += crash_len;
+        *merged_path_out = merged_path;
+    } else {
+        sentry__path_free(merged_path);
+    }
+    sentry_free(crash_buf);
+}
+
+/**
+ * Evicts envelopes until the totals of the index are within the quota of the
+ * run again. Only the envelopes which are still on disk count, the entries of
+ * the ones that were sent or removed in the meantime are dropped. Another
+ * process that shares the database may be doing the same, in which case this
+ * one leaves it to that.
+ */
+static void
+enforce_quota(const sentry_run_t *run)
+{
+    sentry_path_t *lock_path
+        = sentry__path_append_str(run->index_path, ".lock");
+    sentry_filelock_t *lock
+        = lock_path ? sentry__filelock_new(lock_path) : NULL;
+    sentry_path_t *database_path
+        = lock ? sentry__path_dir(run->run_path) : NULL;
+    if (!database_path) {
+        sentry__filelock_free(lock);
+        return;
+    }
+    sentry__mutex_lock(&g_index_lock);
+    if (!sentry__filelock_try_lock(lock)) {
+        sentry__mutex_unlock(&g_index_lock);
+        sentry__path_free(database_path);
+        sentry__filelock_free(lock);
+        return;
+    }
+
+    size_t buf_len = 0;
+    char *buf = sentry__path_read_to_buffer(run->index_path, &buf_len);
+    sentry_path_t *merged_path = NULL;
+    read_crash_entries(run, &buf, &buf_len, &merged_path);
+    index_entry_t *entries = NULL;
+    size_t entry_count = buf ? parse_index(buf, buf_len, &entries) : 0;
+
+    size_t total_size = 0;
+    size_t live_count = 0;
+    size_t stale_count = 0;
+    for (size_t i = 0; i < entry_count; i++) {
+        sentry_path_t *path = entry_path(database_path, &entries[i]);
+        if (path && sentry__path_is_file(path)) {
+            total_size += entries[i].size;
+            live_count++;
+        } else {
+            entries[i].evicted = true;
+            stale_count++;
+        }
+        sentry__path_free(path);
+    }
+    size_t max_size = run->max_database_size;
+    size_t max_envelopes = run->max_database_envelopes;
+    bool over_quota = (max_size && total_size > max_size)
+        || (max_envelopes && live_count > max_envelopes);
+
+    index_entry_t **order = over_quota
+        ? sentry_malloc(sizeof(index_entry_t *) * live_count)
+        : NULL;
+    if (order) {
+        size_t order_len = 0;
+        for (size_t i = 0; i < entry_count; i++) {
+            if (!entries[i].evicted) {
+                order[order_len++] = &entries[i];
+            }
+        }
+        qsort(order, live_count, sizeof(index_entry_t *),
+            compare_eviction_order);
+
+        size_t remaining = live_count;
+        for (size_t i = 0; i < live_count; i++) {
+            if (!(max_size && total_size > max_size)
+                && !(max_envelopes && remaining > max_envelopes)) {
+                break;
+            }
+            evict_entry(database_path, order[i]);
+            total_size -= order[i]->size;
+            remaining--;
+        }
+    }
+    if (order || stale_count || merged_path) {
+        write_index(run->index_path, entries, entry_count);
+    }
+    if (merged_path) {
+        sentry__path_remove(merged_path);
+    }
+
+    sentry__path_free(merged_path);
+    sentry__path_free(database_path);
+    sentry_free(order);
+    sentry_free(entries);
+    sentry_free(buf);
+    sentry__filelock_unlock(lock);
+    sentry__mutex_unlock(&g_index_lock);
+    sentry__filelock_free(lock);
+}
+
+/**
+ * Writes the envelope to `<dir_path>/<filename>`, and adds it to the index of
+ * the quota, if there is one, as part of the directory `dir_name`.
+ */
+static bool
+write_envelope_file(const sentry_run_t *run, const sentry_path_t *dir_path,
+    const char *dir_name, const char *filename,
+    const sentry_envelope_t *envelope, bool is_crash)
+{
+    sentry_path_t *output_path = sentry__path_join_str(dir_path, filename);
     if (!output_path) {
         return false;
     }
 
     int rv = sentry_envelope_write_to_path(envelope, output_path);
-    sentry__path_free(output_path);
-
     if (rv) {
         SENTRY_DEBUG("writing envelope to file failed");
+    } else {
+        sentry__durability_commit(output_path, is_crash);
+        if (run->index_path) {
+            index_add_entry(
+                run, dir_name, filename, envelope, output_path, is_crash);
+            // the quota is only enforced on the next write, outside of the
+            // crash
+            if (!is_crash) {
+                enforce_quota(run);
+            }
+        }
     }
+    sentry__path_free(output_path);
 
     // the `write_to_path` returns > 0 on failure, but we would like a real bool
     return !rv;
 }
 
+static bool
+write_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope, bool is_crash)
+{
+    if (run->journal) {
+        size_t buf_len = 0;
+        char *buf = sentry_envelope_serialize(envelope, &buf_len);
+        int rv = buf ? sentry__journal_append(
+                           run->journal, SENTRY_JOURNAL_ENVELOPE, buf, buf_len)
+                     : 1;
+        sentry_free(buf);
+        if (!rv) {
+            sentry__durability_commit(
+                sentry__journal_get_path(run->journal), is_crash);
+            return true;
+        }
+        SENTRY_DEBUG("appending envelope to the run journal failed");
+    }
+
+    // 37 for the uuid, 9 for the `.envelope` suffix
+    char envelope_filename[37 + 9];
+    sentry_uuid_t event_id = sentry__envelope_get_event_id(envelope);
+    sentry_uuid_as_string(&event_id, envelope_filename);
+    strcpy(&envelope_filename[36], ".envelope");
+
+    char run_name[46];
+    sentry_uuid_as_string(&run->uuid, run_name);
+    strcpy(&run_name[36], ".run");
+    return write_envelope_file(run, run->run_path, run_name, envelope_filename,
+        envelope, is_crash);
+}
+
+sentry_path_t *
+sentry__run_write_spooled_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope)
+{
+    // `<uuid>.envelope`, with a uuid of its own, since the same event may be
+    // spooled more than once
+    char filename[37 + 9];
+    sentry_uuid_t uuid = sentry_uuid_new_v4();
+    sentry_uuid_as_string(&uuid, filename);
+    strcpy(&filename[36], ".envelope");
+
+    char run_name[46];
+    sentry_uuid_as_string(&run->uuid, run_name);
+    strcpy(&run_name[36], ".run");
+    if (!write_envelope_file(
+            run, run->run_path, run_name, filename, envelope, false)) {
+        return NULL;
+    }
+    return sentry__path_join_str(run->run_path, filename);
+}
+
 bool
-sentry__run_write_session(
-    const sentry_run_t *run, const sentry_session_t *session)
+sentry__run_write_offline_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope)
 {
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
-    if (!jw) {
+    sentry_path_t *database_path = sentry__path_dir(run->run_path);
+    sentry_path_t *backlog_path = database_path
+        ? sentry__path_join_str(database_path, SENTRY_OFFLINE_BACKLOG_DIR)
+        : NULL;
+    sentry__path_free(database_path);
+    if (!backlog_path || sentry__path_create_dir_all(backlog_path) != 0) {
+        sentry__path_free(backlog_path);
         return false;
     }
-    sentry__session_to_json(session, jw);
-    size_t buf_len;
-    char *buf = sentry__jsonwriter_into_string(jw, &buf_len);
-    if (!buf) {
+
+    // the names sort by importance first, and by age within the same
+    // importance, followed by a uuid
+    sentry_envelope_priority_t priority
+        = sentry__envelope_get_priority(envelope);
+    char filename[2 + 21 + 37 + 9];
+    snprintf(filename, sizeof(filename), "%d-%020" PRIu64 "-",
+        (int)(SENTRY_ENVELOPE_PRIORITY_CRASH - priority), sentry__msec_time());
+    size_t prefix_len = strlen(filename);
+    sentry_uuid_t event_id = sentry__envelope_get_event_id(envelope);
+    if (sentry_uuid_is_nil(&event_id)) {
+        // envelopes without an event, like sessions, would overwrite each
+        // other within the same millisecond
+        event_id = sentry_uuid_new_v4();
+    }
+    sentry_uuid_as_string(&event_id, &filename[prefix_len]);
+    strcpy(&filename[prefix_len + 36], ".envelope");
+
+    bool rv = write_envelope_file(run, backlog_path,
+        SENTRY_OFFLINE_BACKLOG_DIR, filename, envelope, false);
+    sentry__path_free(backlog_path);
+    return rv;
+}
+
+bool
+sentry__run_write_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope)
+{
+    return write_envelope(run, envelope, false);
+}
+
+bool
+sentry__run_prepare_crash_envelope(sentry_run_t *run)
+{
+    if (run->crash_writer) {
+        return true;
+    }
+    if (!run->crash_path) {
+        run->crash_path
+            = sentry__path_join_str(run->run_path, "crash.envelope");
+    }
+    if (!run->crash_pending_path) {
+        run->crash_pending_path
+            = sentry__path_join_str(run->run_path, "crash.envelope.pending");
+    }
+    if (!run->crash_path || !run->crash_pending_path) {
         return false;
     }
+    run->crash_writer = sentry__filewriter_new(run->crash_pending_path);
+    return run->crash_writer != NULL;
+}
 
-    int rv = sentry__path_write_buffer(run->session_path, buf, buf_len);
-    sentry_free(buf);
+bool
+sentry__run_write_crash_envelope(
+    sentry_run_t *run, const sentry_envelope_t *envelope)
+{
+    sentry_filewriter_t *fw = run->crash_writer;
+    if (!fw) {
+        return write_envelope(run, envelope, true);
+    }
+    run->crash_writer = NULL;
+
+    int rv = sentry__envelope_write_to_filewriter(envelope, fw);
+    if (sentry__filewriter_close(fw)) {
+        rv = 1;
+    }
+    // only a complete envelope is renamed, so that it is picked up on the next
+    // start
+    if (rv || sentry__path_rename(run->crash_pending_path, run->crash_path)) {
+        SENTRY_DEBUG("writing crash envelope to file failed");
+        return false;
+    }
+    sentry__durability_commit(run->crash_path, true);
+    // the quota is only enforced on the next write, outside of the crash
+    if (run->index_path) {
+        char run_name[46];
+        sentry_uuid_as_string(&run->uuid, run_name);
+        strcpy(&run_name[36], ".run");
+        index_add_entry(
+            run, run_name, "crash.envelope", envelope, run->crash_path, true);
+    }
+    return true;
+}
+
+bool
+sentry__run_write_session(
+    const sentry_run_t *run, const sentry_session_t *session)
+{
+    if (run->journal) {
+        sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+        if (!jw) {
+            return false;
+        }
+        sentry__session_to_json(session, jw);
+        size_t buf_len = 0;
+        char *buf = sentry__jsonwriter_into_string(jw, &buf_len);
+        int rv = buf ? sentry__journal_append(
+                           run->journal, SENTRY_JOURNAL_SESSION, buf, buf_len)
+                     : 1;
+        sentry_free(buf);
+        if (rv) {
+            SENTRY_DEBUG("appending session to the run journal failed");
+        } else {
+            sentry__durability_commit(
+                sentry__journal_get_path(run->journal), false);
+        }
+        return !rv;
+    }
+
+    // the session is written next to the old one and then replaces it, so a
+    // crash in the middle of writing leaves the previous session in place
+    sentry_path_t *tmp_path
+        = sentry__path_append_str(run->session_path, ".tmp");
+    sentry_filewriter_t *fw
+        = tmp_path ? sentry__filewriter_new(tmp_path) : NULL;
+    if (!fw) {
+        SENTRY_DEBUG("writing session to file failed");
+        sentry__path_free(tmp_path);
+        return false;
+    }
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new_filewriter(fw);
+    int rv = 1;
+    if (jw) {
+        sentry__session_to_json(session, jw);
+        rv = sentry__jsonwriter_flush(jw);
+        sentry__jsonwriter_free(jw);
+    }
+    if (sentry__filewriter_close(fw)) {
+        rv = 1;
+    }
+    if (!rv) {
+        rv = sentry__path_rename(tmp_path, run->session_path);
+    }
+    if (rv) {
+        sentry__path_remove(tmp_path);
+    }
+    sentry__path_free(tmp_path);
 
     if (rv) {
         SENTRY_DEBUG("writing session to file failed");
+    } else {
+        sentry__durability_commit(run->session_path, false);
     }
     return !rv;
 }
@@ -131,23 +799,154 @@ sentry__run_write_session(
 bool
 sentry__run_clear_session(const sentry_run_t *run)
 {
+    if (run->journal) {
+        return !sentry__journal_append(
+            run->journal, SENTRY_JOURNAL_SESSION_CLEARED, NULL, 0);
+    }
     int rv = sentry__path_remove(run->session_path);
     return !rv;
 }
 
+struct sentry_old_runs_s {
+    const sentry_options_t *options;
+    sentry_pathiter_t *db_iter;
+    uint64_t last_crash;
+};
+
+sentry_old_runs_t *
+sentry__old_runs_new(const sentry_options_t *options, uint64_t last_crash)
+{
+    sentry_old_runs_t *old_runs = SENTRY_MAKE(sentry_old_runs_t);
+    if (!old_runs) {
+        return NULL;
+    }
+    old_runs->options = options;
+    old_runs->db_iter = sentry__path_iter_directory(options->database_path);
+    old_runs->last_crash = last_crash;
+    if (!old_runs->db_iter) {
+        sentry_free(old_runs);
+        return NULL;
+    }
+    return old_runs;
+}
+
 void
-sentry__process_old_runs(const sentry_options_t *options, uint64_t last_crash)
+sentry__old_runs_free(sentry_old_runs_t *old_runs)
 {
-    sentry_pathiter_t *db_iter
-        = sentry__path_iter_directory(options->database_path);
-    if (!db_iter) {
+    if (!old_runs) {
         return;
     }
+    sentry__pathiter_free(old_runs->db_iter);
+    sentry_free(old_runs);
+}
+
+void
+sentry__old_runs_set_last_crash(
+    sentry_old_runs_t *old_runs, uint64_t last_crash)
+{
+    old_runs->last_crash = last_crash;
+}
+
+/**
+ * Old runs may be processed in the background while `sentry_close` holds the
+ * options lock, so the consent is checked without taking it.
+ */
+static void
+capture_old_envelope(
+    const sentry_options_t *options, sentry_envelope_t *envelope)
+{
+    if (sentry__options_should_skip_upload(options)) {
+        SENTRY_TRACE("discarding envelope due to missing user consent");
+        sentry_envelope_free(envelope);
+        return;
+    }
+    if (sentry__offline_store_envelope(options->transport, envelope)) {
+        return;
+    }
+    sentry__transport_send_envelope(options->transport, envelope);
+}
+
+/**
+ * The sessions of a batch of old runs are sent together, in envelopes of up
+ * to `SENTRY_MAX_ENVELOPE_ITEMS` sessions.
+ */
+typedef struct {
+    sentry_old_runs_t *old_runs;
+    sentry_envelope_t *session_envelope;
+    size_t session_num;
+    // the most recent session of the journal that is being read
+    sentry_session_t *journal_session;
+} old_runs_batch_t;
+
+static void
+add_old_session(old_runs_batch_t *batch, sentry_session_t *session)
+{
+    if (!session) {
+        return;
+    }
+    if (!batch->session_envelope) {
+        batch->session_envelope = sentry__envelope_new();
+    }
+    // this is just a heuristic: whenever the session was not closed properly,
+    // and we do have a crash that happened *after* the session was started,
+    // we will assume that the crash corresponds to the session and flag it as
+    // crashed. this should only happen when using crashpad, and there should
+    // normally be only a single unclosed session at a time.
+    if (session->status == SENTRY_SESSION_STATUS_OK) {
+        uint64_t last_crash = batch->old_runs->last_crash;
+        bool was_crash = last_crash && last_crash > session->started_ms;
+        if (was_crash) {
+            session->duration_ms = last_crash - session->started_ms;
+            session->errors += 1;
+            // we only set at most one unclosed session as crashed
+            batch->old_runs->last_crash = 0;
+        }
+        session->status = was_crash ? SENTRY_SESSION_STATUS_CRASHED
+                                    : SENTRY_SESSION_STATUS_ABNORMAL;
+    }
+    sentry__envelope_add_session(batch->session_envelope, session);
+
+    sentry__session_free(session);
+    if ((++batch->session_num) >= SENTRY_MAX_ENVELOPE_ITEMS) {
+        capture_old_envelope(batch->old_runs->options, batch->session_envelope);
+        batch->session_envelope = NULL;
+        batch->session_num = 0;
+    }
+}
+
+static void
+process_journal_record(sentry_journal_record_type_t type, const char *buf,
+    size_t len, void *data)
+{
+    old_runs_batch_t *batch = (old_runs_batch_t *)data;
+    switch (type) {
+    case SENTRY_JOURNAL_ENVELOPE:
+        capture_old_envelope(
+            batch->old_runs->options, sentry__envelope_from_buffer(buf, len));
+        break;
+    case SENTRY_JOURNAL_SESSION:
+        sentry__session_free(batch->journal_session);
+        batch->journal_session = sentry__session_from_json(buf, len);
+        break;
+    case SENTRY_JOURNAL_SESSION_CLEARED:
+        sentry__session_free(batch->journal_session);
+        batch->journal_session = NULL;
+        break;
+    }
+}
+
+bool
+sentry__old_runs_process(sentry_old_runs_t *old_runs, size_t max_runs)
+{
+    const sentry_options_t *options = old_runs->options;
     const sentry_path_t *run_dir;
-    sentry_envelope_t *session_envelope = NULL;
-    size_t session_num = 0;
+    old_runs_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.old_runs = old_runs;
+    size_t run_num = 0;
 
-    while ((run_dir = sentry__pathiter_next(db_iter)) != NULL) {
+    while (run_num < max_runs
+        && (run_dir = sentry__pathiter_next(old_runs->db_iter)) != NULL) {
         // skip over other files such as the saved consent or the last_crash
         // timestamp
         if (!sentry__path_is_dir(run_dir)
@@ -177,50 +976,20 @@ sentry__process_old_runs(const sentry_options_t *options, uint64_t last_crash)
 #endif
             continue;
         }
+        run_num++;
         sentry_pathiter_t *run_iter = sentry__path_iter_directory(run_dir);
         const sentry_path_t *file;
         while ((file = sentry__pathiter_next(run_iter)) != NULL) {
             if (sentry__path_filename_matches(file, "session.json")) {
-                if (!session_envelope) {
-                    session_envelope = sentry__envelope_new();
-                }
-                sentry_session_t *session = sentry__session_from_path(file);
-                if (session) {
-                    // this is just a heuristic: whenever the session was not
-                    // closed properly, and we do have a crash that happened
-                    // *after* the session was started, we will assume that the
-                    // crash corresponds to the session and flag it as crashed.
-                    // this should only happen when using crashpad, and there
-                    // should normally be only a single unclosed session at a
-                    // time.
-                    if (session->status == SENTRY_SESSION_STATUS_OK) {
-                        bool was_crash
-                            = last_crash && last_crash > session->started_ms;
-                        if (was_crash) {
-                            session->duration_ms
-                                = last_crash - session->started_ms;
-                            session->errors += 1;
-                            // we only set at most one unclosed session as
-                            // crashed
-                            last_crash = 0;
-                        }
-                        session->status = was_crash
-                            ? SENTRY_SESSION_STATUS_CRASHED
-                            : SENTRY_SESSION_STATUS_ABNORMAL;
-                    }
-                    sentry__envelope_add_session(session_envelope, session);
-
-                    sentry__session_free(session);
-                    if ((++session_num) >= SENTRY_MAX_ENVELOPE_ITEMS) {
-                        sentry__capture_envelope(
-                            options->transport, session_envelope);
-                        session_envelope = NULL;
-                        session_num = 0;
-                    }
-                }
+                add_old_session(
+                    &batch, sentry__session_from_path(file));
+            } else if (sentry__path_filename_matches(file, "journal")) {
+                sentry__journal_read(file, process_journal_record, &batch);
+                add_old_session(&batch, batch.journal_session);
+                batch.journal_session = NULL;
             } else if (sentry__path_ends_with(file, ".envelope")) {
                 sentry_envelope_t *envelope = sentry__envelope_from_path(file);
-                sentry__capture_envelope(options->transport, envelope);
+                capture_old_envelope(options, envelope);
             }
 
             sentry__path_remove(file);
@@ -230,9 +999,172 @@ sentry__process_old_runs(const sentry_options_t *options, uint64_t last_crash)
         sentry__path_remove_all(run_dir);
         sentry__filelock_free(lock);
     }
-    sentry__pathiter_free(db_iter);
 
-    sentry__capture_envelope(options->transport, session_envelope);
+    capture_old_envelope(options, batch.session_envelope);
+    return run_num == max_runs;
+}
+
+void
+sentry__process_old_runs(const sentry_options_t *options, uint64_t last_crash)
+{
+    sentry_old_runs_t *old_runs = sentry__old_runs_new(options, last_crash);
+    if (old_runs) {
+        sentry__old_runs_process(old_runs, SIZE_MAX);
+        sentry__old_runs_free(old_runs);
+    }
+}
+
+// the batched writes are flushed early once this many files are pending
+#define DURABILITY_MAX_PENDING 64
+
+static volatile long g_durability = SENTRY_DURABILITY_NONE;
+static sentry_mutex_t g_durability_lock = SENTRY__MUTEX_INIT;
+static sentry_path_t *g_pending_syncs[DURABILITY_MAX_PENDING];
+static size_t g_pending_sync_count = 0;
+static sentry_bgworker_t *g_durability_worker = NULL;
+
+static bool
+paths_equal(const sentry_path_t *a, const sentry_path_t *b)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return wcscmp(a->path, b->path) == 0;
+#else
+    return strcmp(a->path, b->path) == 0;
+#endif
+}
+
+static void
+sync_file_and_dir(const sentry_path_t *path)
+{
+    sentry__path_sync(path);
+    // a new file also needs its directory entry to be flushed
+    sentry_path_t *dir = sentry__path_dir(path);
+    if (dir) {
+        sentry__path_sync(dir);
+        sentry__path_free(dir);
+    }
+}
+
+static void
+flush_pending_syncs(void)
+{
+    sentry_path_t *pending[DURABILITY_MAX_PENDING];
+    sentry__mutex_lock(&g_durability_lock);
+    size_t pending_count = g_pending_sync_count;
+    memcpy(pending, g_pending_syncs, sizeof(sentry_path_t *) * pending_count);
+    g_pending_sync_count = 0;
+    sentry__mutex_unlock(&g_durability_lock);
+
+    // the flushes happen outside of the lock, so that they do not hold up the
+    // writes in the meantime
+    for (size_t i = 0; i < pending_count; i++) {
+        sentry__path_sync(pending[i]);
+        sentry__path_free(pending[i]);
+    }
+}
+
+static void
+flush_pending_syncs_task(void *UNUSED(task_data), void *UNUSED(state))
+{
+    flush_pending_syncs();
+}
+
+/**
+ * Adds `path` to the files that the next batch flushes, and returns false if
+ * there is no more room for it.
+ */
+static bool
+add_pending_sync(const sentry_path_t *path)
+{
+    bool added = true;
+    sentry__mutex_lock(&g_durability_lock);
+    bool is_pending = false;
+    for (size_t i = 0; i < g_pending_sync_count && !is_pending; i++) {
+        is_pending = paths_equal(g_pending_syncs[i], path);
+    }
+    if (!is_pending) {
+        sentry_path_t *clone = NULL;
+        if (g_pending_sync_count < DURABILITY_MAX_PENDING) {
+            clone = sentry__path_clone(path);
+        }
+        if (clone) {
+            g_pending_syncs[g_pending_sync_count++] = clone;
+        } else {
+            added = false;
+        }
+    }
+    sentry__mutex_unlock(&g_durability_lock);
+    return added;
+}
+
+void
+sentry__durability_start(const sentry_options_t *options)
+{
+    sentry__durability_stop();
+    sentry_durability_t durability = options->durability;
+    if (durability == SENTRY_DURABILITY_BATCHED) {
+        uint64_t interval = options->durability_interval
+            ? options->durability_interval
+            : SENTRY_DEFAULT_DURABILITY_INTERVAL;
+        sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+        if (bgw) {
+            sentry__bgworker_setname(bgw, "sentry-durability");
+            if (sentry__bgworker_start(bgw) != 0) {
+                sentry__bgworker_decref(bgw);
+                bgw = NULL;
+            } else if (sentry__bgworker_submit_periodic(bgw,
+                           flush_pending_syncs_task, NULL, NULL, interval,
+                           NULL)
+                != 0) {
+                if (sentry__bgworker_shutdown(bgw, 0) == 0) {
+                    sentry__bgworker_decref(bgw);
+                }
+                bgw = NULL;
+            }
+        }
+        if (!bgw) {
+            SENTRY_WARN("failed to start batching the flushes, flushing every "
+                        "write instead");
+            durability = SENTRY_DURABILITY_ALWAYS;
+        }
+        g_durability_worker = bgw;
+    }
+    sentry__atomic_store(&g_durability, (long)durability);
+}
+
+void
+sentry__durability_stop(void)
+{
+    sentry_bgworker_t *bgw = g_durability_worker;
+    g_durability_worker = NULL;
+    if (bgw && sentry__bgworker_shutdown(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT)
+            == 0) {
+        sentry__bgworker_decref(bgw);
+    }
+    flush_pending_syncs();
+    sentry__atomic_store(&g_durability, SENTRY_DURABILITY_NONE);
+}
+
+void
+sentry__durability_commit(const sentry_path_t *path, bool is_crash)
+{
+    long durability = sentry__atomic_fetch(&g_durability);
+    if (durability == SENTRY_DURABILITY_NONE
+        || (durability == SENTRY_DURABILITY_CRASH && !is_crash)) {
+        return;
+    }
+    if (durability == SENTRY_DURABILITY_ALWAYS || is_crash) {
+        sync_file_and_dir(path);
+        return;
+    }
+
+    sentry_path_t *dir = sentry__path_dir(path);
+    if (!add_pending_sync(path) || (dir && !add_pending_sync(dir))) {
+        // with no more room, the batch is flushed early instead
+        flush_pending_syncs();
+        sync_file_and_dir(path);
+    }
+    sentry__path_free(dir);
 }
 
 static const char *g_last_crash_filename = "last_crash";
@@ -254,6 +1186,9 @@ sentry__write_crash_marker(const sentry_options_t *options)
 
     size_t iso_time_len = strlen(iso_time);
     int rv = sentry__path_write_buffer(marker_path, iso_time, iso_time_len);
+    if (!rv) {
+        sentry__durability_commit(marker_path, true);
+    }
     sentry_free(iso_time);
     sentry__path_free(marker_path);
 
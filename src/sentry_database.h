@@ -3,6 +3,7 @@
 
 #include "sentry_boot.h"
 
+#include "sentry_journal.h"
 #include "sentry_path.h"
 #include "sentry_session.h"
 
@@ -11,6 +12,21 @@ typedef struct sentry_run_s {
     sentry_path_t *run_path;
     sentry_path_t *session_path;
     sentry_filelock_t *lock;
+    sentry_path_t *crash_path;
+    sentry_path_t *crash_pending_path;
+    sentry_filewriter_t *crash_writer;
+    // only set with a journal, see `sentry__run_set_journal`
+    sentry_journal_t *journal;
+    // only set with a quota, see `sentry__run_set_quota`
+    sentry_path_t *index_path;
+    sentry_path_t *crash_index_path;
+    size_t max_database_size;
+    size_t max_database_envelopes;
+    // the sorted hashes of the attachment contents that were added to an
+    // envelope, see `sentry__run_add_attachment_hash`
+    uint64_t *attachment_hashes;
+    size_t attachment_hashes_len;
+    size_t attachment_hashes_allocated;
 } sentry_run_t;
 
 /**
@@ -21,6 +37,45 @@ typedef struct sentry_run_s {
  */
 sentry_run_t *sentry__run_new(const sentry_path_t *database_path);
 
+/**
+ * Limits the envelopes in the database of this run to `max_size` bytes and
+ * `max_envelopes` files, where 0 means no limit.
+ *
+ * With a quota, every envelope that is written is recorded in the index at
+ * `<database>/envelopes.index`, along with its size, time and priority. Once
+ * the totals in the index exceed the quota, the envelopes with the lowest
+ * priority are evicted first, and within a priority the oldest ones, see
+ * `sentry__envelope_get_priority`. The index does not need to be exact:
+ * envelopes that were sent in the meantime are only dropped from it when they
+ * come up for eviction.
+ */
+void sentry__run_set_quota(
+    sentry_run_t *run, size_t max_size, size_t max_envelopes);
+
+/**
+ * Makes this run append its envelopes and session updates to a single journal
+ * at `<database>/<uuid>.run/journal` instead of writing a file for each of
+ * them, see `sentry_journal_t`. Crash envelopes still get a file of their
+ * own, see `sentry__run_prepare_crash_envelope`, and the quota only applies
+ * to envelope files.
+ * Returns false if the journal could not be created, in which case the run
+ * keeps writing individual files.
+ */
+bool sentry__run_set_journal(sentry_run_t *run);
+
+/**
+ * Records that an attachment with the contents `hash` was added to an envelope
+ * in this run. Returns false if it was already recorded before.
+ */
+bool sentry__run_add_attachment_hash(sentry_run_t *run, uint64_t hash);
+
+/**
+ * Returns a copy of `run` which writes envelopes into the same directory and
+ * under the same quota, but holds neither its lock nor its journal. This can
+ * be kept by a worker that may outlive the run.
+ */
+sentry_run_t *sentry__run_clone(const sentry_run_t *run);
+
 /**
  * This will clean up all the files belonging to this run.
  */
@@ -41,6 +96,51 @@ void sentry__run_free(sentry_run_t *run);
 bool sentry__run_write_envelope(
     const sentry_run_t *run, const sentry_envelope_t *envelope);
 
+/**
+ * This will serialize and write the given envelope to disk, like
+ * `sentry__run_write_envelope`, but into a file of its own, even when the run
+ * has a journal, and returns its path:
+ * `<database>/<uuid>.run/<uuid>.envelope`
+ * The transport spools the envelopes that it retries this way.
+ */
+sentry_path_t *sentry__run_write_spooled_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope);
+
+/**
+ * The directory in the database that holds the envelopes which were captured
+ * while the SDK was offline, see `sentry_set_offline`.
+ */
+#define SENTRY_OFFLINE_BACKLOG_DIR "offline"
+
+/**
+ * This will serialize and write the given envelope into the offline backlog,
+ * which is shared by all the runs of the database, into a file named:
+ * `<database>/offline/<rank>-<timestamp>-<event-uuid>.envelope`
+ * The `rank` is 0 for crashes, 1 for errors and 2 for transactions, so that
+ * the names sort by importance first, and by age within the same importance.
+ * Like the other envelopes, these count towards the quota of the run.
+ */
+bool sentry__run_write_offline_envelope(
+    const sentry_run_t *run, const sentry_envelope_t *envelope);
+
+/**
+ * This creates the file that a crash envelope of this run will be written to,
+ * and keeps it open:
+ * `<database>/<uuid>.run/crash.envelope.pending`
+ * That way, writing the envelope from within a signal handler neither needs to
+ * build any paths, nor open a new file.
+ */
+bool sentry__run_prepare_crash_envelope(sentry_run_t *run);
+
+/**
+ * This will write the given crash envelope into the file opened by
+ * `sentry__run_prepare_crash_envelope`, and rename it to:
+ * `<database>/<uuid>.run/crash.envelope`
+ * Without a prepared file, this falls back to `sentry__run_write_envelope`.
+ */
+bool sentry__run_write_crash_envelope(
+    sentry_run_t *run, const sentry_envelope_t *envelope);
+
 /**
  * This will serialize and write the given session to disk into a file named:
  * `<database>/<uuid>.run/session.json`
@@ -60,7 +160,8 @@ bool sentry__run_clear_session(const sentry_run_t *run);
  * More specifically, this function will iterate over all the  directories
  * inside the `database_path`. Directories matching `<database>/<uuid>.run/`
  * will be locked, and any files named  `<event-uuid>.envelope` or
- * `session.json` will be queued for sending to the  backend. The files and
+ * `session.json` will be queued for sending to the  backend, as well as the
+ * envelopes and the last session of a `journal`. The files and
  * directories matching these criteria will be deleted afterwards.
  * The following heuristic is applied to all unclosed sessions: If the session
  * was started before the timestamp given by `last_crash`, the session is closed
@@ -69,6 +170,56 @@ bool sentry__run_clear_session(const sentry_run_t *run);
 void sentry__process_old_runs(
     const sentry_options_t *options, uint64_t last_crash);
 
+/**
+ * The state of processing the old runs incrementally, see
+ * `sentry__process_old_runs`.
+ */
+typedef struct sentry_old_runs_s sentry_old_runs_t;
+
+/**
+ * Starts iterating over the old runs in the `database_path` of `options`,
+ * which need to outlive the iteration.
+ */
+sentry_old_runs_t *sentry__old_runs_new(
+    const sentry_options_t *options, uint64_t last_crash);
+
+/**
+ * Frees the state, leaving the runs that were not processed yet on disk.
+ */
+void sentry__old_runs_free(sentry_old_runs_t *old_runs);
+
+/**
+ * Sets the time of the last crash, which applies to the runs that are
+ * processed afterwards.
+ */
+void sentry__old_runs_set_last_crash(
+    sentry_old_runs_t *old_runs, uint64_t last_crash);
+
+/**
+ * Processes up to `max_runs` of the old runs, and returns true if there may
+ * be more of them.
+ */
+bool sentry__old_runs_process(sentry_old_runs_t *old_runs, size_t max_runs);
+
+/**
+ * Applies the durability policy of `options` to the data that is written to
+ * the database from now on, see `sentry_durability_t`. For the batched policy,
+ * this starts a worker which flushes the writes every `durability_interval`.
+ */
+void sentry__durability_start(const sentry_options_t *options);
+
+/**
+ * Flushes the writes that are still pending, and stops applying the policy.
+ */
+void sentry__durability_stop(void);
+
+/**
+ * Flushes the file at `path`, which was just written, along with its
+ * directory, as the policy demands. Data written on a crash is flushed right
+ * away with all policies but `SENTRY_DURABILITY_NONE`.
+ */
+void sentry__durability_commit(const sentry_path_t *path, bool is_crash);
+
 /**
  * This will write the current ISO8601 formatted timestamp into the
  * `<database>/last_crash` file.
@@ -0,0 +1,268 @@
+#include "sentry_dedup.h"
+
+#include "sentry_sync.h"
+#include "sentry_value.h"
+
+#include <string.h>
+
+// the number of distinct events that are tracked at the same time
+#define DEDUP_ENTRIES 32
+// the number of innermost frames of a stack trace that make up an event
+#define DEDUP_FRAMES 5
+
+/**
+ * An event that was captured within the window starting at `first_seen`, and
+ * the number of `duplicates` of it which were suppressed since then. The
+ * latest duplicate is kept as the `summary`.
+ */
+typedef struct {
+    bool used;
+    uint64_t hash;
+    uint64_t first_seen;
+    uint64_t duplicates;
+    sentry_value_t summary;
+} dedup_entry_t;
+
+static dedup_entry_t g_entries[DEDUP_ENTRIES];
+static size_t g_entry_count = 0;
+static sentry_mutex_t g_dedup_lock = SENTRY__MUTEX_INIT;
+
+static void
+hash_bytes(uint64_t *hash, const void *buf, size_t len)
+{
+    // FNV-1a
+    const unsigned char *ptr = buf;
+    for (size_t i = 0; i < len; i++) {
+        *hash ^= ptr[i];
+        *hash *= 1099511628211u;
+    }
+}
+
+static void
+hash_string(uint64_t *hash, sentry_value_t value)
+{
+    const char *str = sentry_value_as_string(value);
+    // the terminator separates adjacent strings
+    hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static void
+hash_frames(uint64_t *hash, sentry_value_t stacktrace)
+{
+    sentry_value_t frames = sentry_value_get_by_key(stacktrace, "frames");
+    size_t len = sentry_value_get_length(frames);
+    // the frames are ordered from the outermost to the innermost one
+    size_t start = len > DEDUP_FRAMES ? len - DEDUP_FRAMES : 0;
+    for (size_t i = start; i < len; i++) {
+        sentry_value_t frame = sentry_value_get_by_index(frames, i);
+        hash_string(hash, sentry_value_get_by_key(frame, "instruction_addr"));
+        hash_string(hash, sentry_value_get_by_key(frame, "function"));
+        hash_string(hash, sentry_value_get_by_key(frame, "filename"));
+        int32_t lineno
+            = sentry_value_as_int32(sentry_value_get_by_key(frame, "lineno"));
+        hash_bytes(hash, &lineno, sizeof(lineno));
+    }
+}
+
+/**
+ * Hashes the parts of `event` that tell it apart from other events, and
+ * returns false if it has none of them.
+ */
+static bool
+hash_event(sentry_value_t event, uint64_t *hash_out)
+{
+    uint64_t hash = 14695981039346656037u;
+    bool has_identity = false;
+
+    sentry_value_t exceptions = sentry_value_get_by_key(event, "exception");
+    if (sentry_value_get_type(exceptions) == SENTRY_VALUE_TYPE_OBJECT) {
+        exceptions = sentry_value_get_by_key(exceptions, "values");
+    }
+    for (size_t i = 0; i < sentry_value_get_length(exceptions); i++) {
+        sentry_value_t exception = sentry_value_get_by_index(exceptions, i);
+        hash_string(&hash, sentry_value_get_by_key(exception, "type"));
+        hash_string(&hash, sentry_value_get_by_key(exception, "value"));
+        hash_frames(&hash, sentry_value_get_by_key(exception, "stacktrace"));
+        has_identity = true;
+    }
+
+    sentry_value_t message = sentry_value_get_by_key(event, "message");
+    if (sentry_value_get_type(message) == SENTRY_VALUE_TYPE_OBJECT) {
+        message = sentry_value_get_by_key(message, "formatted");
+    }
+    if (sentry_value_get_type(message) == SENTRY_VALUE_TYPE_STRING) {
+        hash_string(&hash, message);
+        has_identity = true;
+    }
+
+    sentry_value_t fingerprint = sentry_value_get_by_key(event, "fingerprint");
+    for (size_t i = 0; i < sentry_value_get_length(fingerprint); i++) {
+        hash_string(&hash, sentry_value_get_by_index(fingerprint, i));
+        has_identity = true;
+    }
+    if (!has_identity) {
+        return false;
+    }
+
+    hash_string(&hash, sentry_value_get_by_key(event, "level"));
+    hash_string(&hash, sentry_value_get_by_key(event, "logger"));
+    *hash_out = hash;
+    return true;
+}
+
+/**
+ * Appends the summary of the duplicates of `entry` to `summaries`, if there
+ * were any, and starts counting anew.
+ */
+static void
+take_summary(dedup_entry_t *entry, sentry_value_t *summaries)
+{
+    sentry_value_t summary = entry->summary;
+    uint64_t duplicates = entry->duplicates;
+    entry->summary = sentry_value_new_null();
+    entry->duplicates = 0;
+    if (sentry_value_is_null(summary)) {
+        return;
+    }
+
+    // the summary is the latest duplicate, sent as a new event
+    sentry_value_remove_by_key(summary, "event_id");
+    sentry_value_t extra = sentry__value_get_mutable_by_key(summary, "extra");
+    if (sentry_value_get_type(extra) != SENTRY_VALUE_TYPE_OBJECT) {
+        extra = sentry_value_new_object();
+        sentry_value_set_by_key(summary, "extra", extra);
+    }
+    sentry_value_set_by_key(
+        extra, "duplicates_suppressed", sentry_value_new_uint64(duplicates));
+
+    if (sentry_value_is_null(*summaries)) {
+        *summaries = sentry_value_new_list();
+    }
+    sentry_value_append(*summaries, summary);
+}
+
+/**
+ * Returns true if `entry` should rather be used for a new event than `slot`,
+ * which prefers unused entries over the oldest ones.
+ */
+static bool
+is_better_slot(const dedup_entry_t *entry, const dedup_entry_t *slot)
+{
+    if (!entry->used || !slot->used) {
+        return !entry->used && slot->used;
+    }
+    return entry->first_seen < slot->first_seen;
+}
+
+/**
+ * Checks the event with the given `hash`, see `sentry__dedup_check_hash`.
+ */
+static bool
+dedup_check(uint64_t hash, uint64_t window_ms, bool keep_summary,
+    uint64_t now, sentry_value_t (*make_summary)(void *data), void *data,
+    sentry_value_t *summaries)
+{
+    dedup_entry_t *match = NULL;
+    dedup_entry_t *slot = NULL;
+    sentry__mutex_lock(&g_dedup_lock);
+    for (size_t i = 0; i < g_entry_count; i++) {
+        dedup_entry_t *entry = &g_entries[i];
+        if (entry->used && now > entry->first_seen
+            && now - entry->first_seen >= window_ms) {
+            // the window of this event ended, so its next occurrence is sent
+            // again
+            take_summary(entry, summaries);
+            entry->used = false;
+        }
+        if (entry->used && entry->hash == hash) {
+            match = entry;
+        } else if (!slot || is_better_slot(entry, slot)) {
+            slot = entry;
+        }
+    }
+
+    if (match) {
+        match->duplicates++;
+        if (keep_summary) {
+            sentry_value_decref(match->summary);
+            match->summary = make_summary(data);
+        }
+    } else {
+        if (g_entry_count < DEDUP_ENTRIES && (!slot || slot->used)) {
+            slot = &g_entries[g_entry_count++];
+            slot->duplicates = 0;
+            slot->summary = sentry_value_new_null();
+        } else if (slot->used) {
+            take_summary(slot, summaries);
+        }
+        slot->used = true;
+        slot->hash = hash;
+        slot->first_seen = now;
+    }
+    sentry__mutex_unlock(&g_dedup_lock);
+    return match != NULL;
+}
+
+static sentry_value_t
+incref_event(void *data)
+{
+    sentry_value_t *event = data;
+    sentry_value_incref(*event);
+    return *event;
+}
+
+bool
+sentry__dedup_check(sentry_value_t event, uint64_t window_ms,
+    bool keep_summary, uint64_t now, sentry_value_t *summaries)
+{
+    uint64_t hash;
+    if (!window_ms || !hash_event(event, &hash)) {
+        return false;
+    }
+    return dedup_check(hash, window_ms, keep_summary, now, incref_event,
+        &event, summaries);
+}
+
+uint64_t
+sentry__dedup_hash_exception(sentry_level_t level, const char *type,
+    size_t type_len, const char *value, size_t value_len, void *const *ips,
+    size_t ips_len)
+{
+    uint64_t hash = 14695981039346656037u;
+    hash_bytes(&hash, type, type_len);
+    hash_bytes(&hash, "", 1);
+    hash_bytes(&hash, value, value_len);
+    hash_bytes(&hash, "", 1);
+    // the innermost frames come first
+    for (size_t i = 0; i < ips_len && i < DEDUP_FRAMES; i++) {
+        uint64_t addr = (uint64_t)(size_t)ips[i];
+        hash_bytes(&hash, &addr, sizeof(addr));
+    }
+    hash_bytes(&hash, &level, sizeof(level));
+    return hash;
+}
+
+bool
+sentry__dedup_check_hash(uint64_t hash, uint64_t window_ms, bool keep_summary,
+    uint64_t now, sentry_value_t (*make_summary)(void *data), void *data,
+    sentry_value_t *summaries)
+{
+    if (!window_ms) {
+        return false;
+    }
+    return dedup_check(
+        hash, window_ms, keep_summary, now, make_summary, data, summaries);
+}
+
+sentry_value_t
+sentry__dedup_flush(void)
+{
+    sentry_value_t summaries = sentry_value_new_null();
+    sentry__mutex_lock(&g_dedup_lock);
+    for (size_t i = 0; i < g_entry_count; i++) {
+        take_summary(&g_entries[i], &summaries);
+    }
+    g_entry_count = 0;
+    sentry__mutex_unlock(&g_dedup_lock);
+    return summaries;
+}
@@ -0,0 +1,46 @@
+#ifndef SENTRY_DEDUP_H_INCLUDED
+#define SENTRY_DEDUP_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Checks whether an event with the same exception, top frames, message and
+ * fingerprint as `event` was already captured within the last `window_ms`,
+ * at the monotonic time `now`.
+ *
+ * Returns true if `event` is such a duplicate, in which case it is counted,
+ * and the latest one is kept around as the summary of the duplicates if
+ * `keep_summary` is set. The summaries of the duplicates whose window has
+ * ended are appended to the `summaries` list, which is created as needed.
+ */
+bool sentry__dedup_check(sentry_value_t event, uint64_t window_ms,
+    bool keep_summary, uint64_t now, sentry_value_t *summaries);
+
+/**
+ * Hashes an exception of the given `type` and `value` with the instruction
+ * addresses `ips`, ordered from the innermost frame, as captured by
+ * `sentry_capture_exception_n`. Unlike the hash of an event Value, this is
+ * computed without formatting or allocating anything, so the two never match.
+ */
+uint64_t sentry__dedup_hash_exception(sentry_level_t level, const char *type,
+    size_t type_len, const char *value, size_t value_len, void *const *ips,
+    size_t ips_len);
+
+/**
+ * Checks whether an event with the `hash` returned by
+ * `sentry__dedup_hash_exception` was already captured, like
+ * `sentry__dedup_check`. The event itself is only created, by calling
+ * `make_summary` with `data`, if it is a duplicate which is to be kept as the
+ * summary.
+ */
+bool sentry__dedup_check_hash(uint64_t hash, uint64_t window_ms,
+    bool keep_summary, uint64_t now, sentry_value_t (*make_summary)(void *data),
+    void *data, sentry_value_t *summaries);
+
+/**
+ * Forgets about all the events that were seen so far, and returns a list of
+ * the summaries of the duplicates that were not sent yet, or a null Value.
+ */
+sentry_value_t sentry__dedup_flush(void);
+
+#endif
@@ -0,0 +1,408 @@
+#include "sentry_dtoa.h"
+
+#include <string.h>
+
+/**
+ * This implements the Grisu2 algorithm by Florian Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers" (PLDI 2010).
+ *
+ * It only uses 64-bit integer arithmetic, so its output is independent of the
+ * platform, the libc and the current locale. The generated digits always
+ * round-trip, and are the shortest possible in all but a tiny fraction of
+ * cases, in which one more digit than necessary is produced.
+ */
+
+typedef struct {
+    uint64_t f;
+    int e;
+} diyfp_t;
+
+typedef struct {
+    uint64_t f;
+    int e;
+    int k;
+} cached_power_t;
+
+#define DIYFP_PRECISION 64
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_HIDDEN_BIT ((uint64_t)1 << DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_EXPONENT_BIAS (1023 + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_MIN_EXPONENT (1 - DOUBLE_EXPONENT_BIAS)
+
+// The range of binary exponents the scaled value needs to end up in, so that
+// the integral part of it fits into 32 bits.
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+
+// The normalized powers of ten `10^k`, for `k` in steps of 8, as
+// `f * 2^e` with `f` rounded to the nearest 64-bit integer.
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP 8
+static const cached_power_t CACHED_POWERS[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C, -980, -276 },
+    { 0xD3515C2831559A83, -954, -268 },
+    { 0x9D71AC8FADA6C9B5, -927, -260 },
+    { 0xEA9C227723EE8BCB, -901, -252 },
+    { 0xAECC49914078536D, -874, -244 },
+    { 0x823C12795DB6CE57, -847, -236 },
+    { 0xC21094364DFB5637, -821, -228 },
+    { 0x9096EA6F3848984F, -794, -220 },
+    { 0xD77485CB25823AC7, -768, -212 },
+    { 0xA086CFCD97BF97F4, -741, -204 },
+    { 0xEF340A98172AACE5, -715, -196 },
+    { 0xB23867FB2A35B28E, -688, -188 },
+    { 0x84C8D4DFD2C63F3B, -661, -180 },
+    { 0xC5DD44271AD3CDBA, -635, -172 },
+    { 0x936B9FCEBB25C996, -608, -164 },
+    { 0xDBAC6C247D62A584, -582, -156 },
+    { 0xA3AB66580D5FDAF6, -555, -148 },
+    { 0xF3E2F893DEC3F126, -529, -140 },
+    { 0xB5B5ADA8AAFF80B8, -502, -132 },
+    { 0x87625F056C7C4A8B, -475, -124 },
+    { 0xC9BCFF6034C13053, -449, -116 },
+    { 0x964E858C91BA2655, -422, -108 },
+    { 0xDFF9772470297EBD, -396, -100 },
+    { 0xA6DFBD9FB8E5B88F, -369, -92 },
+    { 0xF8A95FCF88747D94, -343, -84 },
+    { 0xB94470938FA89BCF, -316, -76 },
+    { 0x8A08F0F8BF0F156B, -289, -68 },
+    { 0xCDB02555653131B6, -263, -60 },
+    { 0x993FE2C6D07B7FAC, -236, -52 },
+    { 0xE45C10C42A2B3B06, -210, -44 },
+    { 0xAA242499697392D3, -183, -36 },
+    { 0xFD87B5F28300CA0E, -157, -28 },
+    { 0xBCE5086492111AEB, -130, -20 },
+    { 0x8CBCCC096F5088CC, -103, -12 },
+    { 0xD1B71758E219652C, -77, -4 },
+    { 0x9C40000000000000, -50, 4 },
+    { 0xE8D4A51000000000, -24, 12 },
+    { 0xAD78EBC5AC620000, 3, 20 },
+    { 0x813F3978F8940984, 30, 28 },
+    { 0xC097CE7BC90715B3, 56, 36 },
+    { 0x8F7E32CE7BEA5C70, 83, 44 },
+    { 0xD5D238A4ABE98068, 109, 52 },
+    { 0x9F4F2726179A2245, 136, 60 },
+    { 0xED63A231D4C4FB27, 162, 68 },
+    { 0xB0DE65388CC8ADA8, 189, 76 },
+    { 0x83C7088E1AAB65DB, 216, 84 },
+    { 0xC45D1DF942711D9A, 242, 92 },
+    { 0x924D692CA61BE758, 269, 100 },
+    { 0xDA01EE641A708DEA, 295, 108 },
+    { 0xA26DA3999AEF774A, 322, 116 },
+    { 0xF209787BB47D6B85, 348, 124 },
+    { 0xB454E4A179DD1877, 375, 132 },
+    { 0x865B86925B9BC5C2, 402, 140 },
+    { 0xC83553C5C8965D3D, 428, 148 },
+    { 0x952AB45CFA97A0B3, 455, 156 },
+    { 0xDE469FBD99A05FE3, 481, 164 },
+    { 0xA59BC234DB398C25, 508, 172 },
+    { 0xF6C69A72A3989F5C, 534, 180 },
+    { 0xB7DCBF5354E9BECE, 561, 188 },
+    { 0x88FCF317F22241E2, 588, 196 },
+    { 0xCC20CE9BD35C78A5, 614, 204 },
+    { 0x98165AF37B2153DF, 641, 212 },
+    { 0xE2A0B5DC971F303A, 667, 220 },
+    { 0xA8D9D1535CE3B396, 694, 228 },
+    { 0xFB9B7CD9A4A7443C, 720, 236 },
+    { 0xBB764C4CA7A44410, 747, 244 },
+    { 0x8BAB8EEFB6409C1A, 774, 252 },
+    { 0xD01FEF10A657842C, 800, 260 },
+    { 0x9B10A4E5E9913129, 827, 268 },
+    { 0xE7109BFBA19C0C9D, 853, 276 },
+    { 0xAC2820D9623BF429, 880, 284 },
+    { 0x80444B5E7AA7CF85, 907, 292 },
+    { 0xBF21E44003ACDD2D, 933, 300 },
+    { 0x8E679C2F5E44FF8F, 960, 308 },
+    { 0xD433179D9C8CB841, 986, 316 },
+    { 0x9E19DB92B4E31BA9, 1013, 324 },
+    { 0xEB96BF6EBADF77D9, 1039, 332 },
+    { 0xAF87023B9BF0EE6B, 1066, 340 },
+};
+
+static diyfp_t
+diyfp_sub(diyfp_t x, diyfp_t y)
+{
+    diyfp_t rv = { x.f - y.f, x.e };
+    return rv;
+}
+
+/**
+ * Returns `x * y`, rounded to the upper 64 bits of the 128-bit product.
+ */
+static diyfp_t
+diyfp_mul(diyfp_t x, diyfp_t y)
+{
+    uint64_t u_lo = x.f & 0xFFFFFFFFu;
+    uint64_t u_hi = x.f >> 32;
+    uint64_t v_lo = y.f & 0xFFFFFFFFu;
+    uint64_t v_hi = y.f >> 32;
+
+    uint64_t p0 = u_lo * v_lo;
+    uint64_t p1 = u_lo * v_hi;
+    uint64_t p2 = u_hi * v_lo;
+    uint64_t p3 = u_hi * v_hi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    q += (uint64_t)1 << 31;
+
+    diyfp_t rv = { p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32),
+        x.e + y.e + DIYFP_PRECISION };
+    return rv;
+}
+
+static diyfp_t
+diyfp_normalize(diyfp_t x)
+{
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/**
+ * Computes the normalized `v` of the positive, finite `value`, and the
+ * boundaries `m_minus` and `m_plus` halfway to its neighboring doubles, with
+ * the same exponent as `v`.
+ */
+static void
+compute_boundaries(
+    double value, diyfp_t *m_minus, diyfp_t *v_out, diyfp_t *m_plus)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t f = bits & (DOUBLE_HIDDEN_BIT - 1);
+    int e = (int)(bits >> DOUBLE_SIGNIFICAND_SIZE);
+
+    diyfp_t v;
+    if (e == 0) {
+        v.f = f;
+        v.e = DOUBLE_MIN_EXPONENT;
+    } else {
+        v.f = f + DOUBLE_HIDDEN_BIT;
+        v.e = e - DOUBLE_EXPONENT_BIAS;
+    }
+
+    // the lower neighbor is closer for exact powers of two
+    bool lower_boundary_is_closer = f == 0 && e > 1;
+    diyfp_t plus = { 2 * v.f + 1, v.e - 1 };
+    diyfp_t minus;
+    if (lower_boundary_is_closer) {
+        minus.f = 4 * v.f - 1;
+        minus.e = v.e - 2;
+    } else {
+        minus.f = 2 * v.f - 1;
+        minus.e = v.e - 1;
+    }
+
+    *m_plus = diyfp_normalize(plus);
+    minus.f <<= minus.e - m_plus->e;
+    minus.e = m_plus->e;
+    *m_minus = minus;
+    *v_out = diyfp_normalize(v);
+}
+
+/**
+ * Returns the cached power `c = 10^-k` so that the binary exponent of
+ * `c * 2^e` lies within `[GRISU_ALPHA, GRISU_GAMMA]`.
+ */
+static cached_power_t
+get_cached_power(int e)
+{
+    // `78913 / 2^18` approximates `log10(2)`
+    int f = GRISU_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1))
+        / CACHED_POWERS_DEC_STEP;
+    return CACHED_POWERS[index];
+}
+
+/**
+ * Returns the number of decimal digits of `n`, and writes the largest power
+ * of ten that is `<= n` into `pow10`.
+ */
+static int
+find_largest_pow10(uint32_t n, uint32_t *pow10)
+{
+    uint32_t p = 1000000000;
+    int digits = 10;
+    while (digits > 1 && n < p) {
+        p /= 10;
+        digits--;
+    }
+    *pow10 = p;
+    return digits;
+}
+
+/**
+ * Moves the last generated digit closer to the exact value `w`, as long as
+ * that stays within the rounding interval.
+ */
+static void
+grisu_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest,
+    uint64_t ten_k)
+{
+    while (rest < dist && delta - rest >= ten_k
+        && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+/**
+ * Generates the shortest digits of a number in `(m_minus, m_plus)` that is
+ * closest to `w`, and adjusts `*decimal_exponent` accordingly. Returns the
+ * number of digits written to `buf`.
+ */
+static int
+grisu_digit_gen(char *buf, int *decimal_exponent, diyfp_t m_minus, diyfp_t w,
+    diyfp_t m_plus)
+{
+    uint64_t delta = diyfp_sub(m_plus, m_minus).f;
+    uint64_t dist = diyfp_sub(m_plus, w).f;
+
+    // split `m_plus` into its integral part `p1` and fractional part `p2`
+    int shift = -m_plus.e;
+    uint64_t one = (uint64_t)1 << shift;
+    uint32_t p1 = (uint32_t)(m_plus.f >> shift);
+    uint64_t p2 = m_plus.f & (one - 1);
+
+    int len = 0;
+    uint32_t pow10;
+    int n = find_largest_pow10(p1, &pow10);
+    while (n > 0) {
+        buf[len++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *decimal_exponent += n;
+            grisu_round(
+                buf, len, dist, delta, rest, (uint64_t)pow10 << shift);
+            return len;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        buf[len++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        m++;
+
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    *decimal_exponent -= m;
+    grisu_round(buf, len, dist, delta, p2, one);
+    return len;
+}
+
+/**
+ * Writes the shortest digits of the positive, finite `value` into `buf`, so
+ * that `value == digits * 10^decimal_exponent` after rounding. Returns the
+ * number of digits, which is at most 17.
+ */
+static int
+grisu2(char *buf, int *decimal_exponent, double value)
+{
+    diyfp_t m_minus, v, m_plus;
+    compute_boundaries(value, &m_minus, &v, &m_plus);
+
+    cached_power_t cached = get_cached_power(m_plus.e);
+    diyfp_t c_minus_k = { cached.f, cached.e };
+
+    diyfp_t w = diyfp_mul(v, c_minus_k);
+    diyfp_t w_minus = diyfp_mul(m_minus, c_minus_k);
+    diyfp_t w_plus = diyfp_mul(m_plus, c_minus_k);
+
+    // the products may be off by one ulp, so shrink the interval to be safe
+    w_minus.f += 1;
+    w_plus.f -= 1;
+
+    *decimal_exponent = -cached.k;
+    return grisu_digit_gen(buf, decimal_exponent, w_minus, w, w_plus);
+}
+
+static size_t
+write_exponent(char *buf, int e)
+{
+    size_t len = 0;
+    buf[len++] = 'e';
+    if (e < 0) {
+        buf[len++] = '-';
+        e = -e;
+    } else {
+        buf[len++] = '+';
+    }
+    if (e >= 100) {
+        buf[len++] = (char)('0' + e / 100);
+        e %= 100;
+        buf[len++] = (char)('0' + e / 10);
+    } else {
+        buf[len++] = (char)('0' + e / 10);
+    }
+    buf[len++] = (char)('0' + e % 10);
+    return len;
+}
+
+size_t
+sentry__dtoa(double value, char *buf)
+{
+    size_t len = 0;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits >> 63) {
+        buf[len++] = '-';
+        value = -value;
+    }
+    if (value == 0) {
+        buf[len++] = '0';
+        buf[len] = '\0';
+        return len;
+    }
+
+    char digits[18];
+    int decimal_exponent;
+    int n = grisu2(digits, &decimal_exponent, value);
+    // the exponent of the first digit, as in `d.ddd * 10^x`
+    int x = n + decimal_exponent - 1;
+
+    if (x < -4 || x >= SENTRY_DTOA_MAX_FIXED_DIGITS) {
+        buf[len++] = digits[0];
+        if (n > 1) {
+            buf[len++] = '.';
+            memcpy(buf + len, digits + 1, (size_t)n - 1);
+            len += (size_t)n - 1;
+        }
+        len += write_exponent(buf + len, x);
+    } else if (decimal_exponent >= 0) {
+        memcpy(buf + len, digits, (size_t)n);
+        len += (size_t)n;
+        memset(buf + len, '0', (size_t)decimal_exponent);
+        len += (size_t)decimal_exponent;
+    } else if (x >= 0) {
+        memcpy(buf + len, digits, (size_t)x + 1);
+        len += (size_t)x + 1;
+        buf[len++] = '.';
+        memcpy(buf + len, digits + x + 1, (size_t)(n - x - 1));
+        len += (size_t)(n - x - 1);
+    } else {
+        buf[len++] = '0';
+        buf[len++] = '.';
+        memset(buf + len, '0', (size_t)(-x - 1));
+        len += (size_t)(-x - 1);
+        memcpy(buf + len, digits, (size_t)n);
+        len += (size_t)n;
+    }
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,27 @@
+#ifndef SENTRY_DTOA_H_INCLUDED
+#define SENTRY_DTOA_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * The size of a buffer that can hold any output of `sentry__dtoa`, including
+ * the terminating null byte.
+ */
+#define SENTRY_DTOA_BUF_SIZE 25
+
+/**
+ * Numbers with an exponent of at least this many digits, or smaller than
+ * `1e-4`, are written in exponential notation, like `printf("%.16g")`.
+ */
+#define SENTRY_DTOA_MAX_FIXED_DIGITS 16
+
+/**
+ * Writes the shortest decimal representation of the finite `value` that
+ * parses back to the same double into `buf`, which needs to hold at least
+ * `SENTRY_DTOA_BUF_SIZE` bytes. The output is the same on all platforms, and
+ * does not depend on the current locale. Returns the number of bytes written,
+ * not including the terminating null byte.
+ */
+size_t sentry__dtoa(double value, char *buf);
+
+#endif
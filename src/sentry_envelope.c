@@ -1,20 +1,56 @@
 #include "sentry_envelope.h"
 #include "sentry_alloc.h"
 #include "sentry_core.h"
+#include "sentry_database.h"
 #include "sentry_json.h"
 #include "sentry_options.h"
 #include "sentry_path.h"
 #include "sentry_ratelimiter.h"
+#include "sentry_scope.h"
 #include "sentry_string.h"
+#include "sentry_tracepoint.h"
 #include "sentry_transport.h"
 #include "sentry_value.h"
 #include <string.h>
 
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+#    include <limits.h>
+#    include <zlib.h>
+#endif
+
+// Files at least this large are memory-mapped instead of being read into a
+// heap buffer.
+#define MMAP_MIN_FILE_SIZE (64 * 1024)
+
+// The sizes of the latest payloads and headers of every kind, so that the next
+// ones can usually be serialized with a single allocation.
+static sentry_size_hint_t g_event_size_hint = SENTRY__SIZE_HINT_INIT;
+static sentry_size_hint_t g_transaction_size_hint = SENTRY__SIZE_HINT_INIT;
+static sentry_size_hint_t g_session_size_hint = SENTRY__SIZE_HINT_INIT;
+static sentry_size_hint_t g_profile_size_hint = SENTRY__SIZE_HINT_INIT;
+static sentry_size_hint_t g_headers_size_hint = SENTRY__SIZE_HINT_INIT;
+static sentry_size_hint_t g_item_headers_size_hint = SENTRY__SIZE_HINT_INIT;
+
 struct sentry_envelope_item_s {
     sentry_value_t headers;
     sentry_value_t event;
+    // `payload` points into `payload_mmap` when that is mapped
     char *payload;
     size_t payload_len;
+    sentry_mmap_t payload_mmap;
+    // file-backed items have no `payload`, their `payload_len` bytes at
+    // `payload_offset` are read from this path instead
+    sentry_path_t *payload_path;
+    uint64_t payload_offset;
+    // the serialized `headers` line including its surrounding newlines,
+    // created on first serialization and dropped whenever a header changes
+    char *serialized_headers;
+    size_t serialized_headers_len;
+    // the stacktraces of `event` still need to be symbolized, and its
+    // `payload` is only serialized after that, see `envelope_item_finalize`
+    bool symbolize;
+    // the size that `event` is trimmed to when it is serialized, or 0
+    size_t max_event_size;
 };
 
 struct sentry_envelope_s {
@@ -24,10 +60,25 @@ struct sentry_envelope_s {
             sentry_value_t headers;
             sentry_envelope_item_t items[SENTRY_MAX_ENVELOPE_ITEMS];
             size_t item_count;
+            // cached serialized `headers`, see `serialized_headers` above
+            char *serialized_headers;
+            size_t serialized_headers_len;
+            // see `max_event_size` of the items
+            size_t max_event_size;
         } items;
         struct {
             char *payload;
             size_t payload_len;
+            sentry_mmap_t payload_mmap;
+            // `payload` points into `shared` when this envelope shares it
+            // with others, see `sentry__envelope_share`
+            sentry_shared_payload_t *shared;
+            // Parsed lazily from `payload` on first access, see
+            // `raw_envelope_get_headers` and `raw_envelope_get_event`.
+            sentry_value_t headers;
+            sentry_value_t event;
+            bool headers_parsed;
+            bool event_parsed;
         } raw;
     } contents;
 };
@@ -52,15 +103,80 @@ envelope_add_item(sentry_envelope_t *envelope)
     rv->event = sentry_value_new_null();
     rv->payload = NULL;
     rv->payload_len = 0;
+    rv->payload_mmap.ptr = NULL;
+    rv->payload_mmap.len = 0;
+    rv->payload_path = NULL;
+    rv->payload_offset = 0;
+    rv->symbolize = false;
+    rv->max_event_size = 0;
+    rv->serialized_headers = NULL;
+    rv->serialized_headers_len = 0;
     return rv;
 }
 
+/**
+ * Reads the contents of the file at `path`, which are memory-mapped into
+ * `mapping` for large files, and read into a new heap buffer otherwise.
+ * The returned buffer has to be released with `free_file_contents`.
+ */
+static char *
+read_file_contents(
+    const sentry_path_t *path, size_t *len_out, sentry_mmap_t *mapping)
+{
+    if (sentry__path_get_size(path) >= MMAP_MIN_FILE_SIZE
+        && sentry__path_mmap(mapping, path)) {
+        *len_out = mapping->len;
+        return (char *)mapping->ptr;
+    }
+    mapping->ptr = NULL;
+    mapping->len = 0;
+    return sentry__path_read_to_buffer(path, len_out);
+}
+
+static void
+free_file_contents(char *buf, sentry_mmap_t *mapping)
+{
+    if (mapping && mapping->ptr) {
+        sentry__mmap_close(mapping);
+    } else {
+        sentry_free(buf);
+    }
+}
+
 static void
 envelope_item_cleanup(sentry_envelope_item_t *item)
 {
     sentry_value_decref(item->headers);
     sentry_value_decref(item->event);
-    sentry_free(item->payload);
+    free_file_contents(item->payload, &item->payload_mmap);
+    sentry__path_free(item->payload_path);
+    sentry_free(item->serialized_headers);
+}
+
+/**
+ * Opens the file at `path` for reading from `offset` on, or returns NULL.
+ */
+static sentry_filereader_t *
+open_file_payload(const sentry_path_t *path, uint64_t offset)
+{
+    sentry_filereader_t *fr = sentry__filereader_new(path);
+    if (fr && offset && sentry__filereader_seek(fr, offset) != 0) {
+        sentry__filereader_close(fr);
+        return NULL;
+    }
+    return fr;
+}
+
+/**
+ * Reads the next `len` bytes of a file-backed payload from `fr` into `buf`.
+ * Bytes that are missing because the file shrank since it was added, or could
+ * not be opened, are filled with zeros so the envelope framing stays intact.
+ */
+static void
+read_file_payload(sentry_filereader_t *fr, char *buf, size_t len)
+{
+    size_t read = fr ? sentry__filereader_read(fr, buf, len) : 0;
+    memset(buf + read, 0, len - read);
 }
 
 void
@@ -68,6 +184,9 @@ sentry__envelope_item_set_header(
     sentry_envelope_item_t *item, const char *key, sentry_value_t value)
 {
     sentry_value_set_by_key(item->headers, key, value);
+    sentry_free(item->serialized_headers);
+    item->serialized_headers = NULL;
+    item->serialized_headers_len = 0;
 }
 
 static int
@@ -75,7 +194,8 @@ envelope_item_get_ratelimiter_category(const sentry_envelope_item_t *item)
 {
     const char *ty = sentry_value_as_string(
         sentry_value_get_by_key(item->headers, "type"));
-    if (sentry__string_eq(ty, "session")) {
+    if (sentry__string_eq(ty, "session")
+        || sentry__string_eq(ty, "sessions")) {
         return SENTRY_RL_CATEGORY_SESSION;
     } else if (sentry__string_eq(ty, "transaction")) {
         return SENTRY_RL_CATEGORY_TRANSACTION;
@@ -85,21 +205,44 @@ envelope_item_get_ratelimiter_category(const sentry_envelope_item_t *item)
     return SENTRY_RL_CATEGORY_ERROR;
 }
 
+void
+sentry__envelope_count_rate_limited_items(const sentry_envelope_t *envelope,
+    const sentry_rate_limiter_t *rl, uint64_t *counts)
+{
+    if (envelope->is_raw) {
+        return;
+    }
+    for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
+        const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
+        int category = envelope_item_get_ratelimiter_category(item);
+        if (sentry__rate_limiter_is_disabled(rl, category)) {
+            counts[category]++;
+        }
+    }
+}
+
+/**
+ * Adds an item with the given payload, which is either an owned heap buffer,
+ * or points into `mapping` when that is given and mapped.
+ */
 static sentry_envelope_item_t *
-envelope_add_from_owned_buffer(
-    sentry_envelope_t *envelope, char *buf, size_t buf_len, const char *type)
+envelope_add_from_owned_buffer(sentry_envelope_t *envelope, char *buf,
+    size_t buf_len, sentry_mmap_t *mapping, const char *type)
 {
     if (!buf) {
         return NULL;
     }
     sentry_envelope_item_t *item = envelope_add_item(envelope);
     if (!item) {
-        sentry_free(buf);
+        free_file_contents(buf, mapping);
         return NULL;
     }
 
     item->payload = buf;
     item->payload_len = buf_len;
+    if (mapping) {
+        item->payload_mmap = *mapping;
+    }
     sentry_value_t length = sentry_value_new_int32((int32_t)buf_len);
     sentry__envelope_item_set_header(
         item, "type", sentry_value_new_string(type));
@@ -108,6 +251,18 @@ envelope_add_from_owned_buffer(
     return item;
 }
 
+static void
+shared_payload_decref(sentry_shared_payload_t *shared)
+{
+    if (sentry__atomic_fetch_and_add(&shared->refcount, -1) != 1) {
+        return;
+    }
+    sentry__mutex_free(&shared->lock);
+    sentry_free(shared->payload);
+    sentry_free(shared->compressed_payload);
+    sentry_free(shared);
+}
+
 void
 sentry_envelope_free(sentry_envelope_t *envelope)
 {
@@ -115,11 +270,19 @@ sentry_envelope_free(sentry_envelope_t *envelope)
         return;
     }
     if (envelope->is_raw) {
-        sentry_free(envelope->contents.raw.payload);
+        if (envelope->contents.raw.shared) {
+            shared_payload_decref(envelope->contents.raw.shared);
+        } else {
+            free_file_contents(envelope->contents.raw.payload,
+                &envelope->contents.raw.payload_mmap);
+        }
+        sentry_value_decref(envelope->contents.raw.headers);
+        sentry_value_decref(envelope->contents.raw.event);
         sentry_free(envelope);
         return;
     }
     sentry_value_decref(envelope->contents.items.headers);
+    sentry_free(envelope->contents.items.serialized_headers);
     for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
         envelope_item_cleanup(&envelope->contents.items.items[i]);
     }
@@ -134,12 +297,16 @@ sentry__envelope_set_header(
         return;
     }
     sentry_value_set_by_key(envelope->contents.items.headers, key, value);
+    sentry_free(envelope->contents.items.serialized_headers);
+    envelope->contents.items.serialized_headers = NULL;
+    envelope->contents.items.serialized_headers_len = 0;
 }
 
 sentry_envelope_t *
 sentry__envelope_new(void)
 {
-    sentry_envelope_t *rv = SENTRY_MAKE(sentry_envelope_t);
+    sentry_envelope_t *rv = sentry__malloc_default_tag(
+        sizeof(sentry_envelope_t), SENTRY_MEMORY_TAG_ENVELOPE);
     if (!rv) {
         return NULL;
     }
@@ -147,8 +314,12 @@ sentry__envelope_new(void)
     rv->is_raw = false;
     rv->contents.items.item_count = 0;
     rv->contents.items.headers = sentry_value_new_object();
+    rv->contents.items.serialized_headers = NULL;
+    rv->contents.items.serialized_headers_len = 0;
+    rv->contents.items.max_event_size = 0;
 
     SENTRY_WITH_OPTIONS (options) {
+        rv->contents.items.max_event_size = options->max_event_size;
         if (options->dsn && options->dsn->is_valid) {
             sentry__envelope_set_header(rv, "dsn",
                 sentry_value_new_string(sentry_options_get_dsn(options)));
@@ -158,11 +329,51 @@ sentry__envelope_new(void)
     return rv;
 }
 
+/**
+ * Creates a raw envelope which owns `buf`, or the `mapping` it points into, or
+ * a reference to the `shared` payload, which `buf` is then.
+ */
+static sentry_envelope_t *
+raw_envelope_new(char *buf, size_t buf_len, sentry_mmap_t *mapping,
+    sentry_shared_payload_t *shared)
+{
+    sentry_envelope_t *envelope = sentry__malloc_default_tag(
+        sizeof(sentry_envelope_t), SENTRY_MEMORY_TAG_ENVELOPE);
+    if (!envelope) {
+        if (shared) {
+            shared_payload_decref(shared);
+        } else {
+            free_file_contents(buf, mapping);
+        }
+        return NULL;
+    }
+
+    // the envelope is kept as raw bytes, so it can be sent again as-is, and
+    // is only parsed when someone asks for its contents
+    envelope->is_raw = true;
+    envelope->contents.raw.payload = buf;
+    envelope->contents.raw.payload_len = buf_len;
+    memset(&envelope->contents.raw.payload_mmap, 0, sizeof(sentry_mmap_t));
+    if (mapping) {
+        envelope->contents.raw.payload_mmap = *mapping;
+    }
+    envelope->contents.raw.shared = shared;
+    envelope->contents.raw.headers = sentry_value_new_null();
+    envelope->contents.raw.event = sentry_value_new_null();
+    envelope->contents.raw.headers_parsed = false;
+    envelope->contents.raw.event_parsed = false;
+
+    return envelope;
+}
+
 sentry_envelope_t *
 sentry__envelope_from_path(const sentry_path_t *path)
 {
     size_t buf_len;
-    char *buf = sentry__path_read_to_buffer(path, &buf_len);
+    sentry_mmap_t mapping;
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_ENVELOPE);
+    char *buf = read_file_contents(path, &buf_len, &mapping);
+    SENTRY_MEMORY_TAG_LEAVE();
     if (!buf) {
         SENTRY_WARNF("failed to read raw envelope from \"%" SENTRY_PATH_PRI
                      "\"",
@@ -170,34 +381,470 @@ sentry__envelope_from_path(const sentry_path_t *path)
         return NULL;
     }
 
-    sentry_envelope_t *envelope = SENTRY_MAKE(sentry_envelope_t);
-    if (!envelope) {
-        sentry_free(buf);
+    return raw_envelope_new(buf, buf_len, &mapping, NULL);
+}
+
+sentry_envelope_t *
+sentry__envelope_from_buffer(const char *buf, size_t buf_len)
+{
+    char *copy = sentry__malloc_default_tag(
+        buf_len ? buf_len : 1, SENTRY_MEMORY_TAG_ENVELOPE);
+    if (!copy) {
         return NULL;
     }
+    memcpy(copy, buf, buf_len);
+    return raw_envelope_new(copy, buf_len, NULL, NULL);
+}
+
+/**
+ * Reads an envelope file in chunks, so that its headers can be parsed without
+ * reading the item payloads in between.
+ */
+typedef struct {
+    sentry_filereader_t *file;
+    // the file offset of `buf[pos]`
+    uint64_t offset;
+    size_t pos;
+    size_t len;
+    char buf[4096];
+} envelope_stream_t;
+
+static bool
+stream_fill(envelope_stream_t *stream)
+{
+    if (stream->pos == stream->len) {
+        stream->pos = 0;
+        stream->len = sentry__filereader_read(
+            stream->file, stream->buf, sizeof(stream->buf));
+    }
+    return stream->pos < stream->len;
+}
 
-    envelope->is_raw = true;
-    envelope->contents.raw.payload = buf;
-    envelope->contents.raw.payload_len = buf_len;
+/**
+ * Appends the line at the current position to `sb`, and moves past its
+ * newline. Returns false at the end of the file.
+ */
+static bool
+stream_read_line(envelope_stream_t *stream, sentry_stringbuilder_t *sb)
+{
+    if (!stream_fill(stream)) {
+        return false;
+    }
+    while (stream_fill(stream)) {
+        const char *start = stream->buf + stream->pos;
+        size_t avail = stream->len - stream->pos;
+        const char *newline = memchr(start, '\n', avail);
+        size_t len = newline ? (size_t)(newline - start) : avail;
+        if (sentry__stringbuilder_append_buf(sb, start, len) != 0) {
+            return false;
+        }
+        stream->pos += len;
+        stream->offset += len;
+        if (newline) {
+            stream->pos++;
+            stream->offset++;
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the next `len` bytes into `buf`, and returns the number of bytes read.
+ */
+static size_t
+stream_read(envelope_stream_t *stream, char *buf, size_t len)
+{
+    size_t buffered = stream->len - stream->pos;
+    if (buffered > len) {
+        buffered = len;
+    }
+    memcpy(buf, stream->buf + stream->pos, buffered);
+    stream->pos += buffered;
+    size_t read = buffered
+        + sentry__filereader_read(stream->file, buf + buffered, len - buffered);
+    stream->offset += read;
+    return read;
+}
+
+/**
+ * Moves past the next `len` bytes, without reading them if possible.
+ * Returns 0 on success.
+ */
+static int
+stream_skip(envelope_stream_t *stream, uint64_t len)
+{
+    if (len <= stream->len - stream->pos) {
+        stream->pos += (size_t)len;
+        stream->offset += len;
+        return 0;
+    }
+    stream->offset += len;
+    stream->pos = 0;
+    stream->len = 0;
+    return sentry__filereader_seek(stream->file, stream->offset);
+}
+
+/**
+ * Parses the next line as a JSON object, or returns a null Value.
+ */
+static sentry_value_t
+stream_read_headers(envelope_stream_t *stream, sentry_stringbuilder_t *sb)
+{
+    sentry__stringbuilder_set_len(sb, 0);
+    if (!stream_read_line(stream, sb) || !sentry__stringbuilder_len(sb)) {
+        return sentry_value_new_null();
+    }
+    sentry_value_t headers
+        = sentry__value_from_json(sb->buf, sentry__stringbuilder_len(sb));
+    if (sentry_value_get_type(headers) != SENTRY_VALUE_TYPE_OBJECT) {
+        sentry_value_decref(headers);
+        return sentry_value_new_null();
+    }
+    return headers;
+}
+
+/**
+ * Adds the next item of `stream` to `envelope`, whose `item_headers` have been
+ * read already. Large attachments and other payloads, apart from events,
+ * transactions and sessions, are added as ranges of the file at `path`.
+ * Returns 0 on success.
+ */
+static int
+stream_read_item(sentry_envelope_t *envelope, envelope_stream_t *stream,
+    sentry_value_t item_headers, const sentry_path_t *path,
+    uint64_t file_size, sentry_stringbuilder_t *sb)
+{
+    sentry_envelope_item_t *item = envelope_add_item(envelope);
+    if (!item) {
+        sentry_value_decref(item_headers);
+        return 1;
+    }
+    sentry_value_decref(item->headers);
+    item->headers = item_headers;
+
+    sentry_value_t length = sentry_value_get_by_key(item_headers, "length");
+    if (sentry_value_is_null(length)) {
+        // without a length, the payload ends at the next newline
+        sentry__stringbuilder_set_len(sb, 0);
+        stream_read_line(stream, sb);
+        item->payload_len = sentry__stringbuilder_len(sb);
+        item->payload = sentry__stringbuilder_into_string(sb);
+        sentry__stringbuilder_init(sb);
+        sentry__envelope_item_set_header(item, "length",
+            sentry_value_new_int32((int32_t)item->payload_len));
+    } else {
+        double len = sentry_value_as_double(length);
+        if (!(len >= 0 && len <= (double)(file_size - stream->offset))) {
+            return 1;
+        }
+        item->payload_len = (size_t)len;
+
+        const char *type = sentry_value_as_string(
+            sentry_value_get_by_key(item_headers, "type"));
+        bool is_event = sentry__string_eq(type, "event")
+            || sentry__string_eq(type, "transaction");
+        if (is_event || sentry__string_eq(type, "session")
+            || item->payload_len < MMAP_MIN_FILE_SIZE) {
+            item->payload = sentry__malloc_default_tag(
+                item->payload_len + 1, SENTRY_MEMORY_TAG_ENVELOPE);
+            if (!item->payload
+                || stream_read(stream, item->payload, item->payload_len)
+                    != item->payload_len) {
+                return 1;
+            }
+            item->payload[item->payload_len] = '\0';
+            if (is_event) {
+                item->event = sentry__value_from_json(
+                    item->payload, item->payload_len);
+            }
+        } else {
+            item->payload_path = sentry__path_clone(path);
+            item->payload_offset = stream->offset;
+            if (!item->payload_path
+                || stream_skip(stream, item->payload_len) != 0) {
+                return 1;
+            }
+        }
+
+        // the newline after the payload
+        if (stream_fill(stream) && stream->buf[stream->pos] == '\n') {
+            stream->pos++;
+            stream->offset++;
+        }
+    }
+    return 0;
+}
+
+sentry_envelope_t *
+sentry__envelope_from_path_streamed(const sentry_path_t *path)
+{
+    envelope_stream_t *stream = sentry__malloc_default_tag(
+        sizeof(envelope_stream_t), SENTRY_MEMORY_TAG_ENVELOPE);
+    sentry_envelope_t *envelope = stream ? sentry__envelope_new() : NULL;
+    if (!envelope) {
+        sentry_free(stream);
+        return NULL;
+    }
+    stream->file = sentry__filereader_new(path);
+    stream->offset = 0;
+    stream->pos = 0;
+    stream->len = 0;
+    uint64_t file_size = sentry__path_get_size(path);
 
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry_value_t headers = stream->file ? stream_read_headers(stream, &sb)
+                                          : sentry_value_new_null();
+    int rv = sentry_value_is_null(headers);
+    if (!rv) {
+        // the stored headers already include the dsn of the envelope
+        sentry_value_decref(envelope->contents.items.headers);
+        envelope->contents.items.headers = headers;
+    }
+    while (!rv && stream->offset < file_size) {
+        sentry_value_t item_headers = stream_read_headers(stream, &sb);
+        rv = sentry_value_is_null(item_headers)
+            || stream_read_item(
+                envelope, stream, item_headers, path, file_size, &sb);
+    }
+    sentry__stringbuilder_cleanup(&sb);
+    sentry__filereader_close(stream->file);
+    sentry_free(stream);
+
+    if (rv) {
+        // anything that does not fit, like envelopes with too many items or
+        // invalid headers, is read as a raw envelope instead
+        sentry_envelope_free(envelope);
+        return sentry__envelope_from_path(path);
+    }
     return envelope;
 }
 
+sentry_envelope_t *
+sentry__envelope_new_shared(
+    const sentry_envelope_t *envelope, const sentry_rate_limiter_t *rl)
+{
+    sentry_serialized_envelope_t body;
+    if (sentry__envelope_serialize_segments(envelope, rl, &body) != 0) {
+        return NULL;
+    }
+    sentry_shared_payload_t *shared = SENTRY_MAKE(sentry_shared_payload_t);
+    char *buf = shared ? sentry__malloc_default_tag(
+                    body.total_len + 1, SENTRY_MEMORY_TAG_ENVELOPE)
+                       : NULL;
+    if (!buf) {
+        sentry_free(shared);
+        sentry__serialized_envelope_cleanup(&body);
+        return NULL;
+    }
+    sentry_envelope_body_reader_t reader;
+    sentry__envelope_body_reader_init(&reader, &body);
+    sentry__envelope_body_read(&reader, buf, body.total_len);
+    sentry__envelope_body_reader_cleanup(&reader);
+    buf[body.total_len] = '\0';
+
+    sentry__mutex_init(&shared->lock);
+    shared->refcount = 1;
+    shared->payload = buf;
+    shared->payload_len = body.total_len;
+    shared->compression_done = false;
+    shared->compressed_payload = NULL;
+    shared->compressed_len = 0;
+    sentry__serialized_envelope_cleanup(&body);
+    return raw_envelope_new(buf, shared->payload_len, NULL, shared);
+}
+
+sentry_envelope_t *
+sentry__envelope_share(const sentry_envelope_t *envelope)
+{
+    sentry_shared_payload_t *shared = sentry__envelope_get_shared(envelope);
+    if (!shared) {
+        return NULL;
+    }
+    sentry__atomic_fetch_and_add(&shared->refcount, 1);
+    return raw_envelope_new(shared->payload, shared->payload_len, NULL, shared);
+}
+
+sentry_shared_payload_t *
+sentry__envelope_get_shared(const sentry_envelope_t *envelope)
+{
+    return envelope && envelope->is_raw ? envelope->contents.raw.shared
+                                        : NULL;
+}
+
+/**
+ * Returns the length of the line starting at `ptr`, excluding the newline.
+ */
+static size_t
+line_len(const char *ptr, const char *end)
+{
+    const char *newline = memchr(ptr, '\n', (size_t)(end - ptr));
+    return (size_t)((newline ? newline : end) - ptr);
+}
+
+/**
+ * Returns the envelope headers of a raw envelope, parsing only its first line
+ * on first access.
+ */
+static sentry_value_t
+raw_envelope_get_headers(const sentry_envelope_t *envelope)
+{
+    // the parsed values are a cache, which does not change the envelope
+    sentry_envelope_t *mut = (sentry_envelope_t *)envelope;
+    if (!mut->contents.raw.headers_parsed) {
+        mut->contents.raw.headers_parsed = true;
+        const char *ptr = mut->contents.raw.payload;
+        const char *end = ptr + mut->contents.raw.payload_len;
+        mut->contents.raw.headers
+            = sentry__value_from_json(ptr, line_len(ptr, end));
+    }
+    return mut->contents.raw.headers;
+}
+
+/**
+ * Returns the first event or transaction of a raw envelope, parsing only that
+ * item payload on first access. All other items are skipped over using their
+ * `length` header, without parsing their payload.
+ */
+static sentry_value_t
+raw_envelope_get_event(const sentry_envelope_t *envelope)
+{
+    sentry_envelope_t *mut = (sentry_envelope_t *)envelope;
+    if (mut->contents.raw.event_parsed) {
+        return mut->contents.raw.event;
+    }
+    mut->contents.raw.event_parsed = true;
+
+    const char *ptr = mut->contents.raw.payload;
+    const char *end = ptr + mut->contents.raw.payload_len;
+    // skip the envelope headers
+    ptr += line_len(ptr, end);
+    while (ptr < end) {
+        // the newline after the previous line or payload
+        if (*ptr == '\n') {
+            ptr++;
+        }
+        size_t headers_len = line_len(ptr, end);
+        sentry_value_t item_headers = sentry__value_from_json(ptr, headers_len);
+        ptr += headers_len;
+        if (ptr < end) {
+            ptr++;
+        }
+
+        size_t remaining = (size_t)(end - ptr);
+        size_t payload_len = line_len(ptr, end);
+        double length = sentry_value_as_double(
+            sentry_value_get_by_key(item_headers, "length"));
+        if (length >= 0 && length <= (double)remaining) {
+            payload_len = (size_t)length;
+        }
+
+        const char *type = sentry_value_as_string(
+            sentry_value_get_by_key(item_headers, "type"));
+        bool is_event = strcmp(type, "event") == 0
+            || strcmp(type, "transaction") == 0;
+        sentry_value_decref(item_headers);
+        if (is_event) {
+            mut->contents.raw.event = sentry__value_from_json(ptr, payload_len);
+            break;
+        }
+        ptr += payload_len;
+    }
+    return mut->contents.raw.event;
+}
+
 sentry_uuid_t
 sentry__envelope_get_event_id(const sentry_envelope_t *envelope)
 {
+    sentry_value_t headers = envelope->is_raw
+        ? raw_envelope_get_headers(envelope)
+        : envelope->contents.items.headers;
+    return sentry__value_as_uuid(sentry_value_get_by_key(headers, "event_id"));
+}
+
+static sentry_envelope_priority_t
+event_get_priority(sentry_value_t event)
+{
+    const char *type
+        = sentry_value_as_string(sentry_value_get_by_key(event, "type"));
+    const char *level
+        = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
+    if (sentry__string_eq(type, "transaction")) {
+        return SENTRY_ENVELOPE_PRIORITY_TRANSACTION;
+    } else if (sentry__string_eq(level, "fatal")) {
+        return SENTRY_ENVELOPE_PRIORITY_CRASH;
+    }
+    return SENTRY_ENVELOPE_PRIORITY_ERROR;
+}
+
+sentry_envelope_priority_t
+sentry__envelope_get_priority(const sentry_envelope_t *envelope)
+{
+    if (envelope->is_raw) {
+        sentry_value_t event = raw_envelope_get_event(envelope);
+        return sentry_value_is_null(event) ? SENTRY_ENVELOPE_PRIORITY_ERROR
+                                           : event_get_priority(event);
+    }
+
+    sentry_envelope_priority_t priority = SENTRY_ENVELOPE_PRIORITY_TRANSACTION;
+    for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
+        const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
+        const char *type = sentry_value_as_string(
+            sentry_value_get_by_key(item->headers, "type"));
+        const char *attachment_type = sentry_value_as_string(
+            sentry_value_get_by_key(item->headers, "attachment_type"));
+        sentry_envelope_priority_t item_priority
+            = SENTRY_ENVELOPE_PRIORITY_ERROR;
+        if (sentry__string_eq(type, "event")) {
+            item_priority = event_get_priority(item->event);
+        } else if (sentry__string_eq(type, "transaction")) {
+            item_priority = SENTRY_ENVELOPE_PRIORITY_TRANSACTION;
+        } else if (sentry__string_eq(attachment_type, "event.minidump")) {
+            item_priority = SENTRY_ENVELOPE_PRIORITY_CRASH;
+        }
+        if (item_priority > priority) {
+            priority = item_priority;
+        }
+    }
+    return priority;
+}
+
+size_t
+sentry__envelope_get_memory_usage(const sentry_envelope_t *envelope)
+{
+    // memory-mapped and file-backed payloads live in their files, and are not
+    // counted
+    size_t size = sizeof(sentry_envelope_t);
     if (envelope->is_raw) {
-        return sentry_uuid_nil();
+        if (!envelope->contents.raw.payload_mmap.ptr) {
+            size += envelope->contents.raw.payload_len;
+        }
+        return size
+            + sentry__value_get_memory_usage(envelope->contents.raw.headers)
+            + sentry__value_get_memory_usage(envelope->contents.raw.event);
+    }
+    size += sentry__value_get_memory_usage(envelope->contents.items.headers)
+        + envelope->contents.items.serialized_headers_len;
+    for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
+        const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
+        size += sentry__value_get_memory_usage(item->headers)
+            + sentry__value_get_memory_usage(item->event)
+            + item->serialized_headers_len;
+        if (!item->payload_mmap.ptr && !item->payload_path) {
+            size += item->payload_len;
+        }
     }
-    return sentry_uuid_from_string(sentry_value_as_string(
-        sentry_value_get_by_key(envelope->contents.items.headers, "event_id")));
+    return size;
 }
 
 sentry_value_t
 sentry_envelope_get_event(const sentry_envelope_t *envelope)
 {
     if (envelope->is_raw) {
-        return sentry_value_new_null();
+        sentry_value_t event = raw_envelope_get_event(envelope);
+        return sentry__event_is_transaction(event) ? sentry_value_new_null()
+                                                   : event;
     }
     for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
 
@@ -214,7 +861,9 @@ sentry_value_t
 sentry_envelope_get_transaction(const sentry_envelope_t *envelope)
 {
     if (envelope->is_raw) {
-        return sentry_value_new_null();
+        sentry_value_t event = raw_envelope_get_event(envelope);
+        return sentry__event_is_transaction(event) ? event
+                                                   : sentry_value_new_null();
     }
     for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
         if (!sentry_value_is_null(envelope->contents.items.items[i].event)
@@ -226,29 +875,87 @@ sentry_envelope_get_transaction(const sentry_envelope_t *envelope)
     return sentry_value_new_null();
 }
 
-sentry_envelope_item_t *
-sentry__envelope_add_event(sentry_envelope_t *envelope, sentry_value_t event)
+static sentry_jsonwriter_t *
+new_sized_jsonwriter(sentry_size_hint_t *hint)
 {
-    sentry_envelope_item_t *item = envelope_add_item(envelope);
-    if (!item) {
-        return NULL;
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    if (jw) {
+        sentry__jsonwriter_reserve(jw, sentry__size_hint_get(hint));
     }
+    return jw;
+}
 
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+static char *
+sized_jsonwriter_into_string(
+    sentry_jsonwriter_t *jw, sentry_size_hint_t *hint, size_t *len_out)
+{
+    char *rv = sentry__jsonwriter_into_string(jw, len_out);
+    if (rv) {
+        sentry__size_hint_update(hint, *len_out);
+    }
+    return rv;
+}
+
+static int
+envelope_item_write_event(sentry_envelope_item_t *item)
+{
+    sentry_jsonwriter_t *jw = new_sized_jsonwriter(&g_event_size_hint);
     if (!jw) {
+        return 1;
+    }
+    SENTRY_TRACEPOINT(serialize__start);
+    if (sentry__jsonwriter_write_event(jw, item->event, item->max_event_size)) {
+        SENTRY_DEBUG("trimmed the event to the maximum event size");
+    }
+    item->payload = sized_jsonwriter_into_string(
+        jw, &g_event_size_hint, &item->payload_len);
+    SENTRY_TRACEPOINT1(serialize__end, item->payload_len);
+
+    sentry_value_t length = sentry_value_new_int32((int32_t)item->payload_len);
+    sentry__envelope_item_set_header(item, "length", length);
+    return 0;
+}
+
+/**
+ * Symbolizes and serializes the event of an item that was added via
+ * `sentry__envelope_add_unsymbolized_event`, right before the item is
+ * serialized itself.
+ */
+static void
+envelope_item_finalize(const sentry_envelope_item_t *item)
+{
+    if (!item->symbolize) {
+        return;
+    }
+    // the envelope is logically complete already, this only finishes it
+    sentry_envelope_item_t *mut = (sentry_envelope_item_t *)item;
+    mut->symbolize = false;
+    sentry__symbolize_stacktraces(mut->event);
+    if (envelope_item_write_event(mut) != 0) {
+        SENTRY_WARN("failed to serialize the symbolized event");
+    }
+}
+
+static sentry_envelope_item_t *
+envelope_add_event(
+    sentry_envelope_t *envelope, sentry_value_t event, bool symbolize)
+{
+    sentry_envelope_item_t *item = envelope_add_item(envelope);
+    if (!item) {
         return NULL;
     }
 
     sentry_value_t event_id = sentry__ensure_event_id(event, NULL);
 
     item->event = event;
-    sentry__jsonwriter_write_value(jw, event);
-    item->payload = sentry__jsonwriter_into_string(jw, &item->payload_len);
-
+    item->max_event_size = envelope->contents.items.max_event_size;
     sentry__envelope_item_set_header(
         item, "type", sentry_value_new_string("event"));
-    sentry_value_t length = sentry_value_new_int32((int32_t)item->payload_len);
-    sentry__envelope_item_set_header(item, "length", length);
+    if (symbolize) {
+        item->symbolize = true;
+    } else if (envelope_item_write_event(item) != 0) {
+        return NULL;
+    }
 
     sentry_value_incref(event_id);
     sentry__envelope_set_header(envelope, "event_id", event_id);
@@ -256,6 +963,47 @@ sentry__envelope_add_event(sentry_envelope_t *envelope, sentry_value_t event)
     return item;
 }
 
+sentry_envelope_item_t *
+sentry__envelope_add_event(sentry_envelope_t *envelope, sentry_value_t event)
+{
+    return envelope_add_event(envelope, event, false);
+}
+
+sentry_envelope_item_t *
+sentry__envelope_add_event_with_members(sentry_envelope_t *envelope,
+    sentry_value_t event, const char *members, size_t members_len)
+{
+    sentry_envelope_item_t *item = envelope_add_event(envelope, event, false);
+    if (!item || !members_len || item->payload_len < 2) {
+        return item;
+    }
+
+    // splice the members in before the closing brace of the event object
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    size_t event_len = item->payload_len - 1;
+    if (sentry__stringbuilder_append_buf(&sb, item->payload, event_len) != 0
+        || (event_len > 1 && sentry__stringbuilder_append_char(&sb, ',') != 0)
+        || sentry__stringbuilder_append_buf(&sb, members, members_len) != 0
+        || sentry__stringbuilder_append_char(&sb, '}') != 0) {
+        sentry__stringbuilder_cleanup(&sb);
+        return item;
+    }
+    sentry_free(item->payload);
+    item->payload_len = sentry__stringbuilder_len(&sb);
+    item->payload = sentry__stringbuilder_into_string(&sb);
+    sentry__envelope_item_set_header(
+        item, "length", sentry_value_new_int32((int32_t)item->payload_len));
+    return item;
+}
+
+sentry_envelope_item_t *
+sentry__envelope_add_unsymbolized_event(
+    sentry_envelope_t *envelope, sentry_value_t event)
+{
+    return envelope_add_event(envelope, event, true);
+}
+
 sentry_envelope_item_t *
 sentry__envelope_add_transaction(
     sentry_envelope_t *envelope, sentry_value_t transaction)
@@ -265,7 +1013,7 @@ sentry__envelope_add_transaction(
         return NULL;
     }
 
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    sentry_jsonwriter_t *jw = new_sized_jsonwriter(&g_transaction_size_hint);
     if (!jw) {
         return NULL;
     }
@@ -273,8 +1021,11 @@ sentry__envelope_add_transaction(
     sentry_value_t event_id = sentry__ensure_event_id(transaction, NULL);
 
     item->event = transaction;
+    SENTRY_TRACEPOINT(serialize__start);
     sentry__jsonwriter_write_value(jw, transaction);
-    item->payload = sentry__jsonwriter_into_string(jw, &item->payload_len);
+    item->payload = sized_jsonwriter_into_string(
+        jw, &g_transaction_size_hint, &item->payload_len);
+    SENTRY_TRACEPOINT1(serialize__end, item->payload_len);
 
     sentry__envelope_item_set_header(
         item, "type", sentry_value_new_string("transaction"));
@@ -295,6 +1046,23 @@ sentry__envelope_add_transaction(
     return item;
 }
 
+sentry_envelope_item_t *
+sentry__envelope_add_profile(
+    sentry_envelope_t *envelope, sentry_value_t profile)
+{
+    sentry_jsonwriter_t *jw = new_sized_jsonwriter(&g_profile_size_hint);
+    if (!jw) {
+        return NULL;
+    }
+    sentry__jsonwriter_write_value(jw, profile);
+    size_t payload_len = 0;
+    char *payload
+        = sized_jsonwriter_into_string(jw, &g_profile_size_hint, &payload_len);
+
+    return envelope_add_from_owned_buffer(
+        envelope, payload, payload_len, NULL, "profile");
+}
+
 sentry_envelope_item_t *
 sentry__envelope_add_session(
     sentry_envelope_t *envelope, const sentry_session_t *session)
@@ -302,17 +1070,198 @@ sentry__envelope_add_session(
     if (!envelope || !session) {
         return NULL;
     }
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    sentry_jsonwriter_t *jw = new_sized_jsonwriter(&g_session_size_hint);
     if (!jw) {
         return NULL;
     }
     sentry__session_to_json(session, jw);
     size_t payload_len = 0;
-    char *payload = sentry__jsonwriter_into_string(jw, &payload_len);
+    char *payload
+        = sized_jsonwriter_into_string(jw, &g_session_size_hint, &payload_len);
 
     // NOTE: function will check for `payload` internally and free it on error
     return envelope_add_from_owned_buffer(
-        envelope, payload, payload_len, "session");
+        envelope, payload, payload_len, NULL, "session");
+}
+
+bool
+sentry__envelope_merge_sessions(
+    sentry_envelope_t *envelope, sentry_envelope_t *other)
+{
+    if (envelope == other || envelope->is_raw || other->is_raw) {
+        return false;
+    }
+    size_t item_count = other->contents.items.item_count;
+    if (!item_count
+        || envelope->contents.items.item_count + item_count
+            > SENTRY_MAX_ENVELOPE_ITEMS) {
+        return false;
+    }
+    for (size_t i = 0; i < item_count; i++) {
+        const char *ty = sentry_value_as_string(sentry_value_get_by_key(
+            other->contents.items.items[i].headers, "type"));
+        if (!sentry__string_eq(ty, "session")) {
+            return false;
+        }
+    }
+
+    sentry_envelope_item_t *items = envelope->contents.items.items;
+    memcpy(&items[envelope->contents.items.item_count],
+        other->contents.items.items,
+        sizeof(sentry_envelope_item_t) * item_count);
+    envelope->contents.items.item_count += item_count;
+    other->contents.items.item_count = 0;
+    return true;
+}
+
+/**
+ * An FNV-1a hash of the contents of an attachment, which only needs to tell
+ * the attachments of a single run apart.
+ */
+static uint64_t
+hash_attachment(const char *buf, size_t len)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)buf[i];
+        hash *= 1099511628211u;
+    }
+    return hash ^ (uint64_t)len;
+}
+
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+static voidpf
+zlib_alloc(voidpf UNUSED(opaque), uInt items, uInt size)
+{
+    return sentry_malloc((size_t)items * size);
+}
+
+static void
+zlib_free(voidpf UNUSED(opaque), voidpf ptr)
+{
+    sentry_free(ptr);
+}
+
+/**
+ * Returns a new buffer with the gzip-compressed `buf`, or NULL if compression
+ * fails or would not make it any smaller.
+ */
+static char *
+gzip_attachment(const char *buf, size_t len, size_t *len_out)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // this also runs in the crash handler, where only `sentry_malloc` is safe
+    stream.zalloc = zlib_alloc;
+    stream.zfree = zlib_free;
+    // the `16` selects the gzip container instead of raw zlib
+    if (!len || len > UINT_MAX
+        || deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+               MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY)
+            != Z_OK) {
+        return NULL;
+    }
+    char *compressed = sentry_malloc(len);
+    int rv = Z_MEM_ERROR;
+    if (compressed) {
+        stream.next_in = (Bytef *)buf;
+        stream.avail_in = (uInt)len;
+        stream.next_out = (Bytef *)compressed;
+        stream.avail_out = (uInt)len;
+        // running out of output space means the contents are not compressible
+        rv = deflate(&stream, Z_FINISH);
+    }
+    *len_out = stream.total_out;
+    deflateEnd(&stream);
+    if (rv != Z_STREAM_END) {
+        sentry_free(compressed);
+        return NULL;
+    }
+    return compressed;
+}
+#endif
+
+/**
+ * Adds an attachment with `SENTRY_ATTACHMENT_COMPRESS` or
+ * `SENTRY_ATTACHMENT_DEDUPLICATE` from its contents, which are read right
+ * away. Returns NULL if it is skipped as a duplicate within `run`.
+ */
+static sentry_envelope_item_t *
+add_attachment_contents(sentry_envelope_t *envelope,
+    const sentry_attachment_t *attachment, sentry_run_t *run,
+    bool *is_compressed)
+{
+    *is_compressed = false;
+    if (!envelope) {
+        return NULL;
+    }
+    size_t buf_len;
+    sentry_mmap_t mapping;
+    char *buf = read_file_contents(attachment->path, &buf_len, &mapping);
+    if (!buf) {
+        return NULL;
+    }
+    if ((attachment->flags & SENTRY_ATTACHMENT_DEDUPLICATE) && run
+        && !sentry__run_add_attachment_hash(
+            run, hash_attachment(buf, buf_len))) {
+        SENTRY_DEBUG("skipping attachment that was already sent");
+        free_file_contents(buf, &mapping);
+        return NULL;
+    }
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+    if (attachment->flags & SENTRY_ATTACHMENT_COMPRESS) {
+        size_t compressed_len = 0;
+        char *compressed = gzip_attachment(buf, buf_len, &compressed_len);
+        if (compressed) {
+            free_file_contents(buf, &mapping);
+            *is_compressed = true;
+            return envelope_add_from_owned_buffer(
+                envelope, compressed, compressed_len, NULL, "attachment");
+        }
+    }
+#endif
+    return envelope_add_from_owned_buffer(
+        envelope, buf, buf_len, &mapping, "attachment");
+}
+
+void
+sentry__envelope_add_attachments(
+    sentry_envelope_t *envelope, const sentry_options_t *options)
+{
+    for (sentry_attachment_t *attachment = options->attachments; attachment;
+         attachment = attachment->next) {
+        bool is_compressed = false;
+        sentry_envelope_item_t *item;
+        if (attachment->flags
+            & (SENTRY_ATTACHMENT_COMPRESS | SENTRY_ATTACHMENT_DEDUPLICATE)) {
+            item = add_attachment_contents(
+                envelope, attachment, options->run, &is_compressed);
+        } else {
+            // attachments are only read when the envelope is sent, so the
+            // queue does not hold a copy of every attachment in memory
+            item = sentry__envelope_add_file_backed(
+                envelope, attachment->path, "attachment");
+        }
+        if (!item) {
+            continue;
+        }
+        sentry_value_t filename = sentry_value_new_string(
+            sentry__path_filename_str(attachment->path));
+        if (is_compressed) {
+            sentry_stringbuilder_t sb;
+            sentry__stringbuilder_init(&sb);
+            sentry__stringbuilder_append(&sb, sentry_value_as_string(filename));
+            sentry__stringbuilder_append(&sb, ".gz");
+            sentry_value_decref(filename);
+            filename = sentry__value_new_string_owned(
+                sentry__stringbuilder_into_string(&sb));
+        }
+        sentry__envelope_item_set_header(item, "filename", filename);
+        if (is_compressed) {
+            sentry__envelope_item_set_header(item, "content_type",
+                sentry_value_new_string("application/gzip"));
+        }
+    }
 }
 
 sentry_envelope_item_t *
@@ -322,7 +1271,7 @@ sentry__envelope_add_from_buffer(sentry_envelope_t *envelope, const char *buf,
     // NOTE: function will check for the clone of `buf` internally and free it
     // on error
     return envelope_add_from_owned_buffer(
-        envelope, sentry__string_clonen(buf, buf_len), buf_len, type);
+        envelope, sentry__string_clonen(buf, buf_len), buf_len, NULL, type);
 }
 
 sentry_envelope_item_t *
@@ -333,7 +1282,10 @@ sentry__envelope_add_from_path(
         return NULL;
     }
     size_t buf_len;
-    char *buf = sentry__path_read_to_buffer(path, &buf_len);
+    sentry_mmap_t mapping;
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_ENVELOPE);
+    char *buf = read_file_contents(path, &buf_len, &mapping);
+    SENTRY_MEMORY_TAG_LEAVE();
     if (!buf) {
         SENTRY_WARNF("failed to read envelope item from \"%" SENTRY_PATH_PRI
                      "\"",
@@ -341,74 +1293,207 @@ sentry__envelope_add_from_path(
         return NULL;
     }
     // NOTE: function will free `buf` on error
-    return envelope_add_from_owned_buffer(envelope, buf, buf_len, type);
+    return envelope_add_from_owned_buffer(
+        envelope, buf, buf_len, &mapping, type);
 }
 
-static void
-sentry__envelope_serialize_headers_into_stringbuilder(
-    const sentry_envelope_t *envelope, sentry_stringbuilder_t *sb)
+sentry_envelope_item_t *
+sentry__envelope_add_file_backed(
+    sentry_envelope_t *envelope, const sentry_path_t *path, const char *type)
 {
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(sb);
-    if (jw) {
-        sentry__jsonwriter_write_value(jw, envelope->contents.items.headers);
+    if (!envelope || !sentry__path_is_file(path)) {
+        return NULL;
+    }
+    sentry_path_t *payload_path = sentry__path_clone(path);
+    if (!payload_path) {
+        return NULL;
+    }
+    sentry_envelope_item_t *item = envelope_add_item(envelope);
+    if (!item) {
+        sentry__path_free(payload_path);
+        return NULL;
+    }
+
+    item->payload_path = payload_path;
+    item->payload_len = sentry__path_get_size(path);
+    sentry_value_t length = sentry_value_new_int32((int32_t)item->payload_len);
+    sentry__envelope_item_set_header(
+        item, "type", sentry_value_new_string(type));
+    sentry__envelope_item_set_header(item, "length", length);
+
+    return item;
+}
+
+/**
+ * Returns the serialized `headers`, which are cached in `*cache` until the
+ * headers are modified. Item headers are surrounded by newlines, so that they
+ * can be concatenated with the envelope headers and item payloads directly.
+ * Returns NULL when the headers could not be serialized.
+ */
+static const char *
+get_serialized_headers(sentry_value_t headers, bool is_item, char **cache,
+    size_t *cache_len, size_t *len_out)
+{
+    if (!*cache) {
+        sentry_size_hint_t *hint
+            = is_item ? &g_item_headers_size_hint : &g_headers_size_hint;
+        sentry_stringbuilder_t sb;
+        sentry__stringbuilder_init(&sb);
+        sentry__stringbuilder_reserve(&sb, sentry__size_hint_get(hint));
+        if (is_item) {
+            sentry__stringbuilder_append_char(&sb, '\n');
+        }
+        sentry_jsonwriter_t *jw = sentry__jsonwriter_new(&sb);
+        if (!jw) {
+            sentry__stringbuilder_cleanup(&sb);
+            return NULL;
+        }
+        sentry__jsonwriter_write_value(jw, headers);
         sentry__jsonwriter_free(jw);
+        if (is_item) {
+            sentry__stringbuilder_append_char(&sb, '\n');
+        }
+        *cache_len = sentry__stringbuilder_len(&sb);
+        *cache = sentry__stringbuilder_into_string(&sb);
+        if (!*cache) {
+            *cache_len = 0;
+            return NULL;
+        }
+        sentry__size_hint_update(hint, *cache_len);
     }
+    *len_out = *cache_len;
+    return *cache;
+}
+
+static const char *
+envelope_get_serialized_headers(
+    const sentry_envelope_t *envelope, size_t *len_out)
+{
+    // the cache is not part of the logical state of the envelope
+    sentry_envelope_t *mut = (sentry_envelope_t *)envelope;
+    return get_serialized_headers(mut->contents.items.headers, false,
+        &mut->contents.items.serialized_headers,
+        &mut->contents.items.serialized_headers_len, len_out);
+}
+
+static const char *
+envelope_item_get_serialized_headers(
+    const sentry_envelope_item_t *item, size_t *len_out)
+{
+    sentry_envelope_item_t *mut = (sentry_envelope_item_t *)item;
+    return get_serialized_headers(mut->headers, true,
+        &mut->serialized_headers, &mut->serialized_headers_len, len_out);
 }
 
 static void
 sentry__envelope_serialize_item_into_stringbuilder(
     const sentry_envelope_item_t *item, sentry_stringbuilder_t *sb)
 {
-    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(sb);
-    if (!jw) {
+    envelope_item_finalize(item);
+    size_t headers_len = 0;
+    const char *headers
+        = envelope_item_get_serialized_headers(item, &headers_len);
+    if (!headers) {
         return;
     }
-    sentry__stringbuilder_append_char(sb, '\n');
-
-    sentry__jsonwriter_write_value(jw, item->headers);
-    sentry__jsonwriter_free(jw);
+    sentry__stringbuilder_append_buf(sb, headers, headers_len);
 
-    sentry__stringbuilder_append_char(sb, '\n');
-
-    sentry__stringbuilder_append_buf(sb, item->payload, item->payload_len);
+    if (!item->payload_path) {
+        sentry__stringbuilder_append_buf(sb, item->payload, item->payload_len);
+        return;
+    }
+    char *buf = sentry__stringbuilder_reserve(sb, item->payload_len + 1);
+    if (!buf) {
+        return;
+    }
+    sentry_filereader_t *fr
+        = open_file_payload(item->payload_path, item->payload_offset);
+    read_file_payload(fr, buf, item->payload_len);
+    sentry__filereader_close(fr);
+    sentry__stringbuilder_set_len(
+        sb, sentry__stringbuilder_len(sb) + item->payload_len);
+    buf[item->payload_len] = '\0';
 }
 
 void
 sentry__envelope_serialize_into_stringbuilder(
     const sentry_envelope_t *envelope, sentry_stringbuilder_t *sb)
 {
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_ENVELOPE);
     if (envelope->is_raw) {
         sentry__stringbuilder_append_buf(sb, envelope->contents.raw.payload,
             envelope->contents.raw.payload_len);
+        SENTRY_MEMORY_TAG_LEAVE();
         return;
     }
 
     SENTRY_TRACE("serializing envelope into buffer");
-    sentry__envelope_serialize_headers_into_stringbuilder(envelope, sb);
+    size_t headers_len = 0;
+    const char *headers
+        = envelope_get_serialized_headers(envelope, &headers_len);
+
+    // all the parts are known up front, so the buffer is only allocated once
+    size_t total_len = headers ? headers_len : 0;
+    for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
+        const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
+        envelope_item_finalize(item);
+        size_t item_headers_len = 0;
+        if (envelope_item_get_serialized_headers(item, &item_headers_len)) {
+            total_len += item_headers_len + item->payload_len;
+        }
+    }
+    sentry__stringbuilder_reserve(sb, total_len + 1);
+
+    if (headers) {
+        sentry__stringbuilder_append_buf(sb, headers, headers_len);
+    }
 
     for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
         const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
         sentry__envelope_serialize_item_into_stringbuilder(item, sb);
     }
+    SENTRY_MEMORY_TAG_LEAVE();
 }
 
-char *
-sentry_envelope_serialize_ratelimited(const sentry_envelope_t *envelope,
-    const sentry_rate_limiter_t *rl, size_t *size_out, bool *owned_out)
+int
+sentry__envelope_serialize_segments(const sentry_envelope_t *envelope,
+    const sentry_rate_limiter_t *rl, sentry_serialized_envelope_t *out)
 {
+    memset(out, 0, sizeof(sentry_serialized_envelope_t));
     if (envelope->is_raw) {
-        *size_out = envelope->contents.raw.payload_len;
-        *owned_out = false;
-        return envelope->contents.raw.payload;
+        out->segments = sentry__malloc_default_tag(
+            sizeof(sentry_envelope_segment_t), SENTRY_MEMORY_TAG_ENVELOPE);
+        if (!out->segments) {
+            return 1;
+        }
+        out->segments[0].buf = envelope->contents.raw.payload;
+        out->segments[0].len = envelope->contents.raw.payload_len;
+        out->segments[0].path = NULL;
+        out->segments_len = 1;
+        out->total_len = envelope->contents.raw.payload_len;
+        return 0;
     }
-    *owned_out = true;
 
-    sentry_stringbuilder_t sb;
-    sentry__stringbuilder_init(&sb);
-    sentry__envelope_serialize_headers_into_stringbuilder(envelope, &sb);
+    // the envelope headers are followed by a segment for the headers of every
+    // item, and one for its payload, all of which point into the envelope
+    size_t item_count = envelope->contents.items.item_count;
+    out->segments = sentry__malloc_default_tag(
+        sizeof(sentry_envelope_segment_t) * (1 + 2 * item_count),
+        SENTRY_MEMORY_TAG_ENVELOPE);
+    if (!out->segments) {
+        return 1;
+    }
 
-    size_t serialized_items = 0;
-    for (size_t i = 0; i < envelope->contents.items.item_count; i++) {
+    sentry_envelope_segment_t *segment = &out->segments[out->segments_len++];
+    segment->buf = envelope_get_serialized_headers(envelope, &segment->len);
+    segment->path = NULL;
+    if (!segment->buf) {
+        sentry__serialized_envelope_cleanup(out);
+        return 1;
+    }
+    out->total_len += segment->len;
+
+    for (size_t i = 0; i < item_count; i++) {
         const sentry_envelope_item_t *item = &envelope->contents.items.items[i];
         if (rl) {
             int category = envelope_item_get_ratelimiter_category(item);
@@ -416,18 +1501,88 @@ sentry_envelope_serialize_ratelimited(const sentry_envelope_t *envelope,
                 continue;
             }
         }
-        sentry__envelope_serialize_item_into_stringbuilder(item, &sb);
-        serialized_items += 1;
+        envelope_item_finalize(item);
+        segment = &out->segments[out->segments_len++];
+        segment->buf
+            = envelope_item_get_serialized_headers(item, &segment->len);
+        segment->path = NULL;
+        if (!segment->buf) {
+            sentry__serialized_envelope_cleanup(out);
+            return 1;
+        }
+        out->total_len += segment->len;
+
+        segment = &out->segments[out->segments_len++];
+        segment->buf = item->payload;
+        segment->len = item->payload_len;
+        segment->path = item->payload_path;
+        segment->offset = item->payload_offset;
+        out->total_len += item->payload_len;
     }
 
-    if (!serialized_items) {
-        sentry__stringbuilder_cleanup(&sb);
-        *size_out = 0;
-        return NULL;
+    if (out->segments_len == 1) {
+        sentry__serialized_envelope_cleanup(out);
+        return 1;
     }
+    return 0;
+}
 
-    *size_out = sentry__stringbuilder_len(&sb);
-    return sentry__stringbuilder_into_string(&sb);
+void
+sentry__serialized_envelope_cleanup(sentry_serialized_envelope_t *out)
+{
+    sentry_free(out->segments);
+    sentry_free(out->headers);
+    memset(out, 0, sizeof(sentry_serialized_envelope_t));
+}
+
+void
+sentry__envelope_body_reader_init(sentry_envelope_body_reader_t *reader,
+    const sentry_serialized_envelope_t *body)
+{
+    reader->body = body;
+    reader->segment = 0;
+    reader->offset = 0;
+    reader->file = NULL;
+}
+
+size_t
+sentry__envelope_body_read(
+    sentry_envelope_body_reader_t *reader, char *buf, size_t buf_len)
+{
+    size_t written = 0;
+    while (written < buf_len && reader->segment < reader->body->segments_len) {
+        const sentry_envelope_segment_t *segment
+            = &reader->body->segments[reader->segment];
+        size_t len = segment->len - reader->offset;
+        if (len > buf_len - written) {
+            len = buf_len - written;
+        }
+        if (segment->path) {
+            if (reader->offset == 0) {
+                reader->file
+                    = open_file_payload(segment->path, segment->offset);
+            }
+            read_file_payload(reader->file, buf + written, len);
+        } else if (len) {
+            memcpy(buf + written, segment->buf + reader->offset, len);
+        }
+        written += len;
+        reader->offset += len;
+        if (reader->offset == segment->len) {
+            sentry__filereader_close(reader->file);
+            reader->file = NULL;
+            reader->segment++;
+            reader->offset = 0;
+        }
+    }
+    return written;
+}
+
+void
+sentry__envelope_body_reader_cleanup(sentry_envelope_body_reader_t *reader)
+{
+    sentry__filereader_close(reader->file);
+    reader->file = NULL;
 }
 
 char *
@@ -442,19 +1597,73 @@ sentry_envelope_serialize(const sentry_envelope_t *envelope, size_t *size_out)
     return sentry__stringbuilder_into_string(&sb);
 }
 
+static int
+write_buf_to_file(sentry_filewriter_t *fw, const char *buf, size_t len)
+{
+    return buf ? sentry__filewriter_write(fw, buf, len) : 1;
+}
+
+static int
+write_item_payload_to_file(
+    sentry_filewriter_t *fw, const sentry_envelope_item_t *item)
+{
+    if (!item->payload_path) {
+        return sentry__filewriter_write(fw, item->payload, item->payload_len);
+    }
+    sentry_filereader_t *fr
+        = open_file_payload(item->payload_path, item->payload_offset);
+    char buf[4096];
+    int rv = 0;
+    for (size_t remaining = item->payload_len; !rv && remaining;) {
+        size_t len = remaining < sizeof(buf) ? remaining : sizeof(buf);
+        read_file_payload(fr, buf, len);
+        rv = sentry__filewriter_write(fw, buf, len);
+        remaining -= len;
+    }
+    sentry__filereader_close(fr);
+    return rv;
+}
+
+int
+sentry__envelope_write_to_filewriter(
+    const sentry_envelope_t *envelope, sentry_filewriter_t *fw)
+{
+    // this writes the same output as `sentry_envelope_serialize`, but streams
+    // it to the file instead of building the whole buffer in-memory.
+    int rv = 0;
+    if (envelope->is_raw) {
+        rv = sentry__filewriter_write(fw, envelope->contents.raw.payload,
+            envelope->contents.raw.payload_len);
+    } else {
+        size_t len = 0;
+        const char *buf = envelope_get_serialized_headers(envelope, &len);
+        rv = write_buf_to_file(fw, buf, len);
+        for (size_t i = 0; !rv && i < envelope->contents.items.item_count;
+             i++) {
+            const sentry_envelope_item_t *item
+                = &envelope->contents.items.items[i];
+            envelope_item_finalize(item);
+            buf = envelope_item_get_serialized_headers(item, &len);
+            rv = write_buf_to_file(fw, buf, len)
+                || write_item_payload_to_file(fw, item);
+        }
+    }
+    return rv;
+}
+
 MUST_USE int
 sentry_envelope_write_to_path(
     const sentry_envelope_t *envelope, const sentry_path_t *path)
 {
-    // TODO: This currently builds the whole buffer in-memory.
-    // It would be nice to actually stream this to a file.
-    size_t buf_len = 0;
-    char *buf = sentry_envelope_serialize(envelope, &buf_len);
-
-    int rv = sentry__path_write_buffer(path, buf, buf_len);
-
-    sentry_free(buf);
+    sentry_filewriter_t *fw = sentry__filewriter_new(path);
+    if (!fw) {
+        return 1;
+    }
 
+    int rv = sentry__envelope_write_to_filewriter(envelope, fw);
+    if (sentry__filewriter_close(fw)) {
+        rv = 1;
+    }
     return rv;
 }
 
@@ -497,6 +1706,7 @@ const char *
 sentry__envelope_item_get_payload(
     const sentry_envelope_item_t *item, size_t *payload_len_out)
 {
+    envelope_item_finalize(item);
     if (payload_len_out) {
         *payload_len_out = item->payload_len;
     }
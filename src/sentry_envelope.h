@@ -7,6 +7,7 @@
 #include "sentry_path.h"
 #include "sentry_session.h"
 #include "sentry_string.h"
+#include "sentry_sync.h"
 
 #define SENTRY_MAX_ENVELOPE_ITEMS 10
 
@@ -23,6 +24,64 @@ sentry_envelope_t *sentry__envelope_new(void);
  */
 sentry_envelope_t *sentry__envelope_from_path(const sentry_path_t *path);
 
+/**
+ * This loads a previously serialized envelope from disk, like
+ * `sentry__envelope_from_path`, but only parses its headers and item headers,
+ * reading the file piece by piece. Large attachments are not read, and are
+ * added as file-backed items that point at their range of the file instead,
+ * so the file has to outlive the envelope. Envelopes that do not fit into
+ * individual items are loaded as raw envelopes.
+ */
+sentry_envelope_t *sentry__envelope_from_path_streamed(
+    const sentry_path_t *path);
+
+/**
+ * This loads a previously serialized envelope from a copy of the `buf_len`
+ * bytes at `buf`.
+ */
+sentry_envelope_t *sentry__envelope_from_buffer(
+    const char *buf, size_t buf_len);
+
+/**
+ * The serialized payload that a number of raw envelopes share, so that an
+ * envelope is serialized only once when it is sent to several destinations.
+ *
+ * The HTTP transports compress the payload only once as well: the first one
+ * to send it sets `compression_done` and `compressed_payload` under `lock`,
+ * and all of them send the same compressed bytes after that.
+ */
+typedef struct {
+    sentry_mutex_t lock;
+    long refcount;
+    char *payload;
+    size_t payload_len;
+    bool compression_done;
+    char *compressed_payload;
+    size_t compressed_len;
+} sentry_shared_payload_t;
+
+/**
+ * Serializes `envelope`, leaving out the items that are rate limited by `rl`,
+ * into a new raw envelope, whose payload can be shared with other envelopes
+ * via `sentry__envelope_share`.
+ * Returns NULL on failure, or when all the items are rate limited.
+ */
+sentry_envelope_t *sentry__envelope_new_shared(
+    const sentry_envelope_t *envelope, const sentry_rate_limiter_t *rl);
+
+/**
+ * Returns a new raw envelope that shares the payload of `envelope`, which was
+ * created by `sentry__envelope_new_shared`, or NULL if it was not. Every one
+ * of them is freed on its own, and the payload along with the last one.
+ */
+sentry_envelope_t *sentry__envelope_share(const sentry_envelope_t *envelope);
+
+/**
+ * Returns the payload that `envelope` shares with others, or NULL.
+ */
+sentry_shared_payload_t *sentry__envelope_get_shared(
+    const sentry_envelope_t *envelope);
+
 /**
  * This returns the UUID of the event associated with this envelope.
  * If there is no event inside this envelope, or the envelope was previously
@@ -30,24 +89,80 @@ sentry_envelope_t *sentry__envelope_from_path(const sentry_path_t *path);
  */
 sentry_uuid_t sentry__envelope_get_event_id(const sentry_envelope_t *envelope);
 
+/**
+ * How important it is to keep an envelope around, in ascending order.
+ */
+typedef enum {
+    SENTRY_ENVELOPE_PRIORITY_TRANSACTION,
+    SENTRY_ENVELOPE_PRIORITY_ERROR,
+    SENTRY_ENVELOPE_PRIORITY_CRASH,
+} sentry_envelope_priority_t;
+
+/**
+ * Returns the priority of the most important item in this envelope. Events
+ * with a `fatal` level and minidumps count as crashes, and items other than
+ * transactions as errors.
+ */
+sentry_envelope_priority_t sentry__envelope_get_priority(
+    const sentry_envelope_t *envelope);
+
+/**
+ * Returns the number of bytes allocated for the envelope and all of its items.
+ * See also `sentry__value_get_memory_usage`.
+ */
+size_t sentry__envelope_get_memory_usage(const sentry_envelope_t *envelope);
+
 /**
  * Add an event to this envelope.
  */
 sentry_envelope_item_t *sentry__envelope_add_event(
     sentry_envelope_t *envelope, sentry_value_t event);
 
+/**
+ * Add an event to this envelope, whose payload additionally contains the
+ * `members_len` bytes of pre-serialized JSON object members at `members`, like
+ * `"key":value,"other":value`. The event must not have any of these keys
+ * itself. `sentry_envelope_get_event` only returns the `event` without them.
+ */
+sentry_envelope_item_t *sentry__envelope_add_event_with_members(
+    sentry_envelope_t *envelope, sentry_value_t event, const char *members,
+    size_t members_len);
+
+/**
+ * Add an event to this envelope, whose stacktraces are symbolized only once
+ * the envelope is serialized, which typically happens on the transport worker.
+ * Until then, `sentry_envelope_get_event` returns the unsymbolized event.
+ */
+sentry_envelope_item_t *sentry__envelope_add_unsymbolized_event(
+    sentry_envelope_t *envelope, sentry_value_t event);
+
 /**
  * Add a transaction to this envelope.
  */
 sentry_envelope_item_t *sentry__envelope_add_transaction(
     sentry_envelope_t *envelope, sentry_value_t transaction);
 
+/**
+ * Add a profile to this envelope.
+ */
+sentry_envelope_item_t *sentry__envelope_add_profile(
+    sentry_envelope_t *envelope, sentry_value_t profile);
+
 /**
  * Add a session to this envelope.
  */
 sentry_envelope_item_t *sentry__envelope_add_session(
     sentry_envelope_t *envelope, const sentry_session_t *session);
 
+/**
+ * Moves all the items of `other` to the end of `envelope`, which is only done
+ * when `other` consists of session items only, as those can be sent along
+ * with any other item, and when they fit into `envelope`.
+ * Returns true if the items were moved, in which case `other` is left empty.
+ */
+bool sentry__envelope_merge_sessions(
+    sentry_envelope_t *envelope, sentry_envelope_t *other);
+
 /**
  * This will add the file contents from `path` as an envelope item of type
  * `type`.
@@ -55,6 +170,22 @@ sentry_envelope_item_t *sentry__envelope_add_session(
 sentry_envelope_item_t *sentry__envelope_add_from_path(
     sentry_envelope_t *envelope, const sentry_path_t *path, const char *type);
 
+/**
+ * This will add the file at `path` as an envelope item of type `type`, which
+ * only records its path and current size. The file contents are read, up to
+ * that size, whenever the envelope is serialized, so the file has to outlive
+ * the envelope. Such items have no in-memory payload.
+ */
+sentry_envelope_item_t *sentry__envelope_add_file_backed(
+    sentry_envelope_t *envelope, const sentry_path_t *path, const char *type);
+
+/**
+ * Adds a file-backed item for each of the attachments of `options`, along with
+ * its filename.
+ */
+void sentry__envelope_add_attachments(
+    sentry_envelope_t *envelope, const sentry_options_t *options);
+
 /**
  * This will add the given buffer as a new envelope item of type `type`.
  */
@@ -69,13 +200,83 @@ void sentry__envelope_item_set_header(
     sentry_envelope_item_t *item, const char *key, sentry_value_t value);
 
 /**
- * Serialize the envelope while applying the rate limits from `rl`.
- * Returns `NULL` when all items have been rate-limited, and might return a
- * pointer to borrowed data in case of a raw envelope, in which case `owned_out`
- * will be set to `false`.
+ * A contiguous part of a serialized envelope, which is either in memory at
+ * `buf`, or the `len` bytes at `offset` of the file at `path`.
+ */
+typedef struct {
+    const char *buf;
+    size_t len;
+    const sentry_path_t *path;
+    uint64_t offset;
+} sentry_envelope_segment_t;
+
+/**
+ * A serialized envelope, which is the concatenation of all its `segments`.
+ * The segments point either into the owned `headers` buffer, or directly at
+ * the cached headers and the item payloads or paths of the envelope, which
+ * thus has to outlive them and must not be modified in the meantime.
+ * File segments can be streamed using a `sentry_envelope_body_reader_t`.
+ */
+typedef struct {
+    sentry_envelope_segment_t *segments;
+    size_t segments_len;
+    size_t total_len;
+    char *headers;
+} sentry_serialized_envelope_t;
+
+/**
+ * Adds the number of items of `envelope` that are currently rate limited by
+ * `rl` to `counts`, which is indexed by their rate limiting category.
+ */
+void sentry__envelope_count_rate_limited_items(
+    const sentry_envelope_t *envelope, const sentry_rate_limiter_t *rl,
+    uint64_t *counts);
+
+/**
+ * Serialize the envelope into `out` while applying the rate limits from `rl`,
+ * without copying any of the item payloads.
+ * Returns 0 on success, and 1 on failure or when all items have been
+ * rate-limited. On success, `out` has to be freed via
+ * `sentry__serialized_envelope_cleanup`.
  */
-char *sentry_envelope_serialize_ratelimited(const sentry_envelope_t *envelope,
-    const sentry_rate_limiter_t *rl, size_t *size_out, bool *owned_out);
+int sentry__envelope_serialize_segments(const sentry_envelope_t *envelope,
+    const sentry_rate_limiter_t *rl, sentry_serialized_envelope_t *out);
+
+/**
+ * Frees the buffers of a serialized envelope.
+ */
+void sentry__serialized_envelope_cleanup(sentry_serialized_envelope_t *out);
+
+/**
+ * Reads the contents of a serialized envelope sequentially, including the
+ * contents of file segments.
+ */
+typedef struct {
+    const sentry_serialized_envelope_t *body;
+    size_t segment;
+    size_t offset;
+    sentry_filereader_t *file;
+} sentry_envelope_body_reader_t;
+
+/**
+ * Initializes `reader` to read `body` from its start.
+ */
+void sentry__envelope_body_reader_init(
+    sentry_envelope_body_reader_t *reader,
+    const sentry_serialized_envelope_t *body);
+
+/**
+ * Reads up to `buf_len` bytes of the body into `buf`, and returns the number
+ * of bytes read, which is less than `buf_len` only at the end of the body.
+ */
+size_t sentry__envelope_body_read(
+    sentry_envelope_body_reader_t *reader, char *buf, size_t buf_len);
+
+/**
+ * Closes any file that `reader` still has open.
+ */
+void sentry__envelope_body_reader_cleanup(
+    sentry_envelope_body_reader_t *reader);
 
 /**
  * Serialize a complete envelope with all its items into the given string
@@ -91,6 +292,15 @@ void sentry__envelope_serialize_into_stringbuilder(
 MUST_USE int sentry_envelope_write_to_path(
     const sentry_envelope_t *envelope, const sentry_path_t *path);
 
+/**
+ * Serialize the envelope piece by piece into the file opened by `fw`, which
+ * stays open. Apart from the envelope and item headers, which are small, this
+ * does not build anything in-memory.
+ * Returns 0 on success.
+ */
+int sentry__envelope_write_to_filewriter(
+    const sentry_envelope_t *envelope, sentry_filewriter_t *fw);
+
 // these for now are only needed for tests
 #ifdef SENTRY_UNITTEST
 size_t sentry__envelope_get_item_count(const sentry_envelope_t *envelope);
@@ -0,0 +1,325 @@
+#include "sentry_journal.h"
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_sync.h"
+
+#include <string.h>
+
+#define JOURNAL_MAGIC "SNTRYJRN"
+#define JOURNAL_VERSION 1
+
+// superseded session records are only compacted away once they take up at
+// least this many bytes
+#define JOURNAL_COMPACT_MIN_SIZE (64 * 1024)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} journal_header_t;
+
+/**
+ * Each record starts with this header, followed by `len` bytes of payload.
+ * `checksum` covers the `type`, the `len` and the payload.
+ */
+typedef struct {
+    uint32_t type;
+    uint32_t len;
+    uint32_t checksum;
+} journal_record_t;
+
+struct sentry_journal_s {
+    sentry_path_t *path;
+    sentry_filewriter_t *fw;
+    sentry_mutex_t lock;
+    // the size of the file, and how much of it is superseded session records
+    size_t size;
+    size_t superseded_size;
+    // the size of the most recent session record, including its header
+    size_t session_size;
+};
+
+static uint32_t
+crc32_update(uint32_t crc, const void *buf, size_t len)
+{
+    // a bitwise CRC-32, which is fast enough for the sizes of our records, and
+    // does not need a table
+    const unsigned char *ptr = buf;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *ptr++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t
+record_checksum(uint32_t type, uint32_t len, const char *payload)
+{
+    uint32_t crc = crc32_update(0, &type, sizeof(type));
+    crc = crc32_update(crc, &len, sizeof(len));
+    return crc32_update(crc, payload, len);
+}
+
+static bool
+is_session_record(uint32_t type)
+{
+    return type == SENTRY_JOURNAL_SESSION
+        || type == SENTRY_JOURNAL_SESSION_CLEARED;
+}
+
+static int
+write_header(sentry_filewriter_t *fw)
+{
+    journal_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    return sentry__filewriter_write(fw, (const char *)&header, sizeof(header));
+}
+
+static int
+write_record(sentry_filewriter_t *fw, uint32_t type, const char *buf,
+    uint32_t len, uint32_t checksum)
+{
+    journal_record_t record;
+    record.type = type;
+    record.len = len;
+    record.checksum = checksum;
+    // a crash in between the two writes leaves an incomplete record, which is
+    // where reading the journal stops
+    if (sentry__filewriter_write(fw, (const char *)&record, sizeof(record))) {
+        return 1;
+    }
+    return len ? sentry__filewriter_write(fw, buf, len) : 0;
+}
+
+/**
+ * Checks the journal header at the start of `*ptr`, and advances past it.
+ */
+static bool
+read_header(const char **ptr, const char *end)
+{
+    journal_header_t header;
+    if ((size_t)(end - *ptr) < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, *ptr, sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0
+        || header.version != JOURNAL_VERSION) {
+        return false;
+    }
+    *ptr += sizeof(header);
+    return true;
+}
+
+/**
+ * Reads the next valid record at `*ptr` into `record` and `payload`, and
+ * advances past it.
+ */
+static bool
+read_record(const char **ptr, const char *end, journal_record_t *record,
+    const char **payload)
+{
+    if ((size_t)(end - *ptr) < sizeof(journal_record_t)) {
+        return false;
+    }
+    // the records are not aligned, so their headers are copied out
+    memcpy(record, *ptr, sizeof(journal_record_t));
+    const char *record_payload = *ptr + sizeof(journal_record_t);
+    if ((size_t)(end - record_payload) < record->len
+        || record_checksum(record->type, record->len, record_payload)
+            != record->checksum) {
+        return false;
+    }
+    *payload = record_payload;
+    *ptr = record_payload + record->len;
+    return true;
+}
+
+sentry_journal_t *
+sentry__journal_new(const sentry_path_t *path)
+{
+    sentry_journal_t *journal = SENTRY_MAKE(sentry_journal_t);
+    if (!journal) {
+        return NULL;
+    }
+    memset(journal, 0, sizeof(sentry_journal_t));
+    journal->path = sentry__path_clone(path);
+    journal->fw = journal->path ? sentry__filewriter_new(journal->path) : NULL;
+    if (!journal->fw || write_header(journal->fw)) {
+        sentry__filewriter_close(journal->fw);
+        sentry__path_free(journal->path);
+        sentry_free(journal);
+        return NULL;
+    }
+    sentry__mutex_init(&journal->lock);
+    journal->size = sizeof(journal_header_t);
+    return journal;
+}
+
+void
+sentry__journal_free(sentry_journal_t *journal)
+{
+    if (!journal) {
+        return;
+    }
+    if (journal->fw) {
+        sentry__filewriter_close(journal->fw);
+    }
+    sentry__path_free(journal->path);
+    sentry__mutex_free(&journal->lock);
+    sentry_free(journal);
+}
+
+const sentry_path_t *
+sentry__journal_get_path(const sentry_journal_t *journal)
+{
+    return journal->path;
+}
+
+int
+sentry__journal_append(sentry_journal_t *journal,
+    sentry_journal_record_type_t type, const char *buf, size_t len)
+{
+    if (len > UINT32_MAX) {
+        return 1;
+    }
+    uint32_t checksum = record_checksum((uint32_t)type, (uint32_t)len, buf);
+
+    sentry__mutex_lock(&journal->lock);
+    int rv = 1;
+    if (journal->fw) {
+        rv = write_record(
+            journal->fw, (uint32_t)type, buf, (uint32_t)len, checksum);
+    }
+    if (!rv) {
+        size_t record_size = sizeof(journal_record_t) + len;
+        journal->size += record_size;
+        if (is_session_record(type)) {
+            journal->superseded_size += journal->session_size;
+            journal->session_size = record_size;
+        }
+        if (journal->superseded_size >= JOURNAL_COMPACT_MIN_SIZE
+            && journal->superseded_size
+                > journal->size - journal->superseded_size) {
+            sentry__journal_compact(journal);
+        }
+    }
+    sentry__mutex_unlock(&journal->lock);
+    return rv;
+}
+
+/**
+ * Writes the header, the envelope records and the most recent session record
+ * in `buf` to `fw`, and returns the number of bytes written, or 0 on failure.
+ */
+static size_t
+write_compacted(sentry_filewriter_t *fw, const char *buf, size_t buf_len,
+    size_t *session_size_out)
+{
+    const char *end = buf + buf_len;
+    const char *ptr = buf;
+    if (!read_header(&ptr, end)) {
+        return 0;
+    }
+    const char *records = ptr;
+    const char *last_session = NULL;
+    journal_record_t record;
+    const char *payload;
+    while (read_record(&ptr, end, &record, &payload)) {
+        if (is_session_record(record.type)) {
+            last_session = payload;
+        }
+    }
+
+    if (write_header(fw)) {
+        return 0;
+    }
+    size_t size = sizeof(journal_header_t);
+    *session_size_out = 0;
+    ptr = records;
+    while (read_record(&ptr, end, &record, &payload)) {
+        bool is_session = is_session_record(record.type);
+        // a cleared session does not need to be kept at all
+        if (is_session
+            && (payload != last_session
+                || record.type == SENTRY_JOURNAL_SESSION_CLEARED)) {
+            continue;
+        }
+        if (write_record(
+                fw, record.type, payload, record.len, record.checksum)) {
+            return 0;
+        }
+        size += sizeof(journal_record_t) + record.len;
+        if (is_session) {
+            *session_size_out = sizeof(journal_record_t) + record.len;
+        }
+    }
+    return size;
+}
+
+int
+sentry__journal_compact(sentry_journal_t *journal)
+{
+    sentry__mutex_lock(&journal->lock);
+    int rv = 1;
+    size_t buf_len = 0;
+    char *buf = sentry__path_read_to_buffer(journal->path, &buf_len);
+    sentry_path_t *tmp_path = sentry__path_append_str(journal->path, ".tmp");
+    sentry_filewriter_t *fw
+        = buf && tmp_path ? sentry__filewriter_new(tmp_path) : NULL;
+    if (fw) {
+        size_t session_size = 0;
+        size_t size = write_compacted(fw, buf, buf_len, &session_size);
+        bool written = sentry__filewriter_close(fw) == 0 && size;
+        // the open journal is closed first, so that it can be replaced on
+        // windows
+        sentry__filewriter_close(journal->fw);
+        if (written && sentry__path_rename(tmp_path, journal->path) == 0) {
+            journal->size = size;
+            journal->superseded_size = 0;
+            journal->session_size = session_size;
+            rv = 0;
+        } else {
+            sentry__path_remove(tmp_path);
+        }
+        journal->fw = sentry__filewriter_new_append(journal->path);
+    }
+    sentry__path_free(tmp_path);
+    sentry_free(buf);
+    sentry__mutex_unlock(&journal->lock);
+    if (rv) {
+        SENTRY_DEBUG("compacting the run journal failed");
+    }
+    return rv;
+}
+
+size_t
+sentry__journal_read(const sentry_path_t *path,
+    void (*callback)(sentry_journal_record_type_t type, const char *buf,
+        size_t len, void *data),
+    void *data)
+{
+    size_t buf_len = 0;
+    char *buf = sentry__path_read_to_buffer(path, &buf_len);
+    if (!buf) {
+        return 0;
+    }
+    const char *end = buf + buf_len;
+    const char *ptr = buf;
+    size_t record_count = 0;
+    journal_record_t record;
+    const char *payload;
+    if (read_header(&ptr, end)) {
+        while (read_record(&ptr, end, &record, &payload)) {
+            record_count++;
+            callback((sentry_journal_record_type_t)record.type, payload,
+                record.len, data);
+        }
+    }
+    sentry_free(buf);
+    return record_count;
+}
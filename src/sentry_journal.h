@@ -0,0 +1,74 @@
+#ifndef SENTRY_JOURNAL_H_INCLUDED
+#define SENTRY_JOURNAL_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_path.h"
+
+/**
+ * An append-only file of records, which replaces the individual files of a
+ * run, so that persisting an envelope or a session update is a single write
+ * to an already open file.
+ *
+ * The file starts with a header, which is followed by the records. Each record
+ * starts with its type, length and a CRC-32 checksum, which is followed by
+ * `len` bytes of payload. The header and record headers use the native byte
+ * order, so they can only be parsed on the same machine.
+ *
+ * A session record supersedes all the session records before it, and those
+ * are dropped once the journal is compacted.
+ */
+typedef struct sentry_journal_s sentry_journal_t;
+
+typedef enum {
+    SENTRY_JOURNAL_ENVELOPE = 1,
+    SENTRY_JOURNAL_SESSION = 2,
+    SENTRY_JOURNAL_SESSION_CLEARED = 3,
+} sentry_journal_record_type_t;
+
+/**
+ * Creates or truncates the journal at `path`, and keeps it open for appending.
+ * Returns `NULL` on failure.
+ */
+sentry_journal_t *sentry__journal_new(const sentry_path_t *path);
+
+/**
+ * Closes the journal. The file itself is left in place.
+ */
+void sentry__journal_free(sentry_journal_t *journal);
+
+/**
+ * Returns the path of the journal.
+ */
+const sentry_path_t *sentry__journal_get_path(const sentry_journal_t *journal);
+
+/**
+ * Appends a record of the given `type` with the `len` bytes at `buf` as its
+ * payload. This compacts the journal when the superseded session records
+ * take up more space than the rest of it. This is safe to call from multiple
+ * threads concurrently.
+ * Returns 0 on success.
+ */
+int sentry__journal_append(sentry_journal_t *journal,
+    sentry_journal_record_type_t type, const char *buf, size_t len);
+
+/**
+ * Rewrites the journal without the superseded session records, and replaces
+ * the old file with it in one go.
+ * Returns 0 on success.
+ */
+int sentry__journal_compact(sentry_journal_t *journal);
+
+/**
+ * Calls `callback` for the records of the journal at `path`, in the order
+ * they were appended. The payload is only valid for the duration of the call.
+ * Reading stops at the first record that is incomplete or does not match its
+ * checksum, since that is where a crash interrupted the writing.
+ * Returns the number of valid records.
+ */
+size_t sentry__journal_read(const sentry_path_t *path,
+    void (*callback)(sentry_journal_record_type_t type, const char *buf,
+        size_t len, void *data),
+    void *data);
+
+#endif
@@ -3,16 +3,31 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "../vendor/jsmn.h"
-
 #include "sentry_alloc.h"
+#include "sentry_dtoa.h"
 #include "sentry_json.h"
+#include "sentry_path.h"
 #include "sentry_string.h"
 #include "sentry_utils.h"
 #include "sentry_value.h"
 
+#if defined(__SSE2__) || defined(_M_X64)                                       \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define SENTRY_JSON_SSE2
+#    include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define SENTRY_JSON_NEON
+#    include <arm_neon.h>
+#endif
+
+// Writers with a sink pass their output on in chunks of about this size.
+#define SINK_CHUNK_SIZE 4096
+
 struct sentry_jsonwriter_s {
     sentry_stringbuilder_t *sb;
+    sentry_jsonwriter_sink_func_t sink;
+    void *sink_data;
+    int sink_rv;
     uint64_t want_comma;
     uint32_t depth;
     bool last_was_key;
@@ -24,19 +39,24 @@ sentry__jsonwriter_new(sentry_stringbuilder_t *sb)
 {
     bool owns_sb = false;
     if (!sb) {
-        sb = SENTRY_MAKE(sentry_stringbuilder_t);
+        sb = sentry__malloc_default_tag(
+            sizeof(sentry_stringbuilder_t), SENTRY_MEMORY_TAG_JSON);
         owns_sb = true;
         sentry__stringbuilder_init(sb);
     }
     if (!sb) {
         return NULL;
     }
-    sentry_jsonwriter_t *rv = SENTRY_MAKE(sentry_jsonwriter_t);
+    sentry_jsonwriter_t *rv = sentry__malloc_default_tag(
+        sizeof(sentry_jsonwriter_t), SENTRY_MEMORY_TAG_JSON);
     if (!rv) {
         return NULL;
     }
 
     rv->sb = sb;
+    rv->sink = NULL;
+    rv->sink_data = NULL;
+    rv->sink_rv = 0;
     rv->want_comma = 0;
     rv->depth = 0;
     rv->last_was_key = 0;
@@ -44,6 +64,73 @@ sentry__jsonwriter_new(sentry_stringbuilder_t *sb)
     return rv;
 }
 
+sentry_jsonwriter_t *
+sentry__jsonwriter_new_sink(sentry_jsonwriter_sink_func_t sink, void *data)
+{
+    sentry_jsonwriter_t *rv = sentry__jsonwriter_new(NULL);
+    if (!rv) {
+        return NULL;
+    }
+    rv->sink = sink;
+    rv->sink_data = data;
+    // chunks are passed on once they are full, so they rarely need to grow
+    sentry__jsonwriter_reserve(rv, 2 * SINK_CHUNK_SIZE);
+    return rv;
+}
+
+void
+sentry__jsonwriter_reserve(sentry_jsonwriter_t *jw, size_t len)
+{
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_JSON);
+    sentry__stringbuilder_reserve(jw->sb, len);
+    SENTRY_MEMORY_TAG_LEAVE();
+}
+
+static int
+write_to_filewriter(const char *buf, size_t len, void *data)
+{
+    return sentry__filewriter_write((sentry_filewriter_t *)data, buf, len);
+}
+
+sentry_jsonwriter_t *
+sentry__jsonwriter_new_filewriter(sentry_filewriter_t *fw)
+{
+    return sentry__jsonwriter_new_sink(write_to_filewriter, fw);
+}
+
+int
+sentry__jsonwriter_flush(sentry_jsonwriter_t *jw)
+{
+    if (!jw->sink) {
+        return 0;
+    }
+    size_t len = sentry__stringbuilder_len(jw->sb);
+    if (len && !jw->sink_rv) {
+        jw->sink_rv = jw->sink(jw->sb->buf, len, jw->sink_data);
+    }
+    sentry__stringbuilder_set_len(jw->sb, 0);
+    return jw->sink_rv;
+}
+
+size_t
+sentry__jsonwriter_get_len(const sentry_jsonwriter_t *jw)
+{
+    return sentry__stringbuilder_len(jw->sb);
+}
+
+bool
+sentry__jsonwriter_reset(sentry_jsonwriter_t *jw)
+{
+    if (jw->sink) {
+        return false;
+    }
+    sentry__stringbuilder_set_len(jw->sb, 0);
+    jw->want_comma = 0;
+    jw->depth = 0;
+    jw->last_was_key = false;
+    return true;
+}
+
 void
 sentry__jsonwriter_free(sentry_jsonwriter_t *jw)
 {
@@ -89,16 +176,32 @@ set_comma(sentry_jsonwriter_t *jw, bool val)
     }
 }
 
+static void
+flush_full_chunk(sentry_jsonwriter_t *jw)
+{
+    if (jw->sink && sentry__stringbuilder_len(jw->sb) >= SINK_CHUNK_SIZE) {
+        sentry__jsonwriter_flush(jw);
+    }
+}
+
 static void
 write_char(sentry_jsonwriter_t *jw, char c)
 {
     sentry__stringbuilder_append_char(jw->sb, c);
+    flush_full_chunk(jw);
+}
+
+static void
+write_buf(sentry_jsonwriter_t *jw, const char *buf, size_t len)
+{
+    sentry__stringbuilder_append_buf(jw->sb, buf, len);
+    flush_full_chunk(jw);
 }
 
 static void
 write_str(sentry_jsonwriter_t *jw, const char *str)
 {
-    sentry__stringbuilder_append(jw->sb, str);
+    write_buf(jw, str, strlen(str));
 }
 
 // The Lookup table and algorithm below are adapted from:
@@ -126,22 +229,69 @@ static unsigned char needs_escaping[256] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // F
 };
 
+/**
+ * Returns a pointer to the first byte in `[ptr, end)` that needs escaping, or
+ * `end` if there is none. Where available, this skips over clean runs 16 bytes
+ * at a time, and only looks at the remainder one byte at a time.
+ */
+static const unsigned char *
+find_escape(const unsigned char *ptr, const unsigned char *end)
+{
+#if defined(SENTRY_JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    while (end - ptr >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+        // there is no unsigned comparison, but `min(c, 0x1f) == c` is `c < 32`
+        __m128i mask = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        if (_mm_movemask_epi8(mask)) {
+            break;
+        }
+        ptr += 16;
+    }
+#elif defined(SENTRY_JSON_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    while (end - ptr >= 16) {
+        uint8x16_t chunk = vld1q_u8(ptr);
+        uint8x16_t mask = vorrq_u8(
+            vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+            vcltq_u8(chunk, control));
+        if (vmaxvq_u8(mask)) {
+            break;
+        }
+        ptr += 16;
+    }
+#endif
+    while (ptr < end && !needs_escaping[*ptr]) {
+        ptr++;
+    }
+    return ptr;
+}
+
 static void
-write_json_str(sentry_jsonwriter_t *jw, const char *str)
+write_json_str_n(sentry_jsonwriter_t *jw, const char *str, size_t str_len)
 {
     // using unsigned here because utf-8 is > 127 :-)
     const unsigned char *ptr = (const unsigned char *)str;
+    const unsigned char *end = ptr + str_len;
     write_char(jw, '"');
 
     const unsigned char *start = ptr;
-    for (; *ptr; ptr++) {
-        if (!needs_escaping[*ptr]) {
-            continue;
-        }
+    for (;; ptr++) {
+        ptr = find_escape(ptr, end);
 
         size_t len = ptr - start;
         if (len) {
-            sentry__stringbuilder_append_buf(jw->sb, (const char *)start, len);
+            write_buf(jw, (const char *)start, len);
+        }
+        if (ptr == end) {
+            break;
         }
 
         switch (*ptr) {
@@ -182,12 +332,42 @@ write_json_str(sentry_jsonwriter_t *jw, const char *str)
         start = ptr + 1;
     }
 
-    size_t len = ptr - start;
-    if (len) {
-        sentry__stringbuilder_append_buf(jw->sb, (const char *)start, len);
+    write_char(jw, '"');
+}
+
+size_t
+sentry__json_str_len(const char *str, size_t str_len)
+{
+    const unsigned char *ptr = (const unsigned char *)str;
+    const unsigned char *end = ptr + str_len;
+    // the surrounding quotes
+    size_t len = str_len + 2;
+    for (;; ptr++) {
+        ptr = find_escape(ptr, end);
+        if (ptr == end) {
+            return len;
+        }
+        switch (*ptr) {
+        case '\\':
+        case '"':
+        case '\b':
+        case '\f':
+        case '\n':
+        case '\r':
+        case '\t':
+            len += 1;
+            break;
+        default:
+            // `\u00XX`
+            len += *ptr < 32 ? 5 : 0;
+        }
     }
+}
 
-    write_char(jw, '"');
+static void
+write_json_str(sentry_jsonwriter_t *jw, const char *str)
+{
+    write_json_str_n(jw, str, strlen(str));
 }
 
 static bool
@@ -235,19 +415,37 @@ sentry__jsonwriter_write_int32(sentry_jsonwriter_t *jw, int32_t val)
 }
 
 void
-sentry__jsonwriter_write_double(sentry_jsonwriter_t *jw, double val)
+sentry__jsonwriter_write_int64(sentry_jsonwriter_t *jw, int64_t val)
 {
     if (can_write_item(jw)) {
         char buf[24];
-        // The MAX_SAFE_INTEGER is 9007199254740991, which has 16 digits
-        int written = sentry__snprintf_c(buf, sizeof(buf), "%.16g", val);
-        // print `null` if we have printf issues or a non-finite double, which
-        // can't be represented in JSON.
-        if (written < 0 || written >= (int)sizeof(buf) || !isfinite(val)) {
+        snprintf(buf, sizeof(buf), "%" PRId64, val);
+        write_str(jw, buf);
+    }
+}
+
+void
+sentry__jsonwriter_write_uint64(sentry_jsonwriter_t *jw, uint64_t val)
+{
+    if (can_write_item(jw)) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%" PRIu64, val);
+        write_str(jw, buf);
+    }
+}
+
+void
+sentry__jsonwriter_write_double(sentry_jsonwriter_t *jw, double val)
+{
+    if (can_write_item(jw)) {
+        // print `null` for a non-finite double, which can't be represented
+        // in JSON.
+        if (!isfinite(val)) {
             write_str(jw, "null");
         } else {
-            buf[written] = '\0';
-            write_str(jw, buf);
+            char buf[SENTRY_DTOA_BUF_SIZE];
+            size_t written = sentry__dtoa(val, buf);
+            write_buf(jw, buf, written);
         }
     }
 }
@@ -264,6 +462,28 @@ sentry__jsonwriter_write_str(sentry_jsonwriter_t *jw, const char *val)
     }
 }
 
+void
+sentry__jsonwriter_write_str_n(
+    sentry_jsonwriter_t *jw, const char *val, size_t len)
+{
+    if (!val) {
+        sentry__jsonwriter_write_null(jw);
+        return;
+    }
+    if (can_write_item(jw)) {
+        write_json_str_n(jw, val, len);
+    }
+}
+
+void
+sentry__jsonwriter_write_json(
+    sentry_jsonwriter_t *jw, const char *json, size_t len)
+{
+    if (can_write_item(jw)) {
+        write_buf(jw, json, len);
+    }
+}
+
 void
 sentry__jsonwriter_write_uuid(
     sentry_jsonwriter_t *jw, const sentry_uuid_t *uuid)
@@ -356,23 +576,32 @@ read_escaped_unicode_char(const char *buf)
     return uchar;
 }
 
-static bool
-decode_string_inplace(char *buf)
+/**
+ * Decodes the `len` bytes of the JSON string contents at `input` into
+ * `output`, which needs to hold at least `len + 1` bytes, as decoding never
+ * makes a string longer. Returns the length of the decoded string, or
+ * `(size_t)-1` if it contains invalid escapes.
+ */
+static size_t
+decode_string(const char *input, size_t len, char *output)
 {
-    const char *input = buf;
-    char *output = buf;
+    const char *end = input + len;
+    char *start = output;
 
 #define SIMPLE_ESCAPE(Char, Rep)                                               \
     case Char:                                                                 \
         *output++ = Rep;                                                       \
         break
 
-    while (*input) {
+    while (input < end) {
         char c = *input++;
         if (c != '\\') {
             *output++ = c;
             continue;
         }
+        if (input == end) {
+            return (size_t)-1;
+        }
         switch (*input++) {
             SIMPLE_ESCAPE('"', '"');
             SIMPLE_ESCAPE('\\', '\\');
@@ -383,27 +612,30 @@ decode_string_inplace(char *buf)
             SIMPLE_ESCAPE('r', '\r');
             SIMPLE_ESCAPE('t', '\t');
         case 'u': {
+            if (end - input < 4) {
+                return (size_t)-1;
+            }
             int32_t uchar = read_escaped_unicode_char(input);
             if (uchar == (int32_t)-1) {
-                return false;
+                return (size_t)-1;
             }
             input += 4;
 
             if (sentry__is_lead_surrogate(uchar)) {
                 uint16_t lead = (uint16_t)uchar;
-                if (input[0] != '\\' || input[1] != 'u') {
-                    return false;
+                if (end - input < 6 || input[0] != '\\' || input[1] != 'u') {
+                    return (size_t)-1;
                 }
                 input += 2;
                 int32_t trail = read_escaped_unicode_char(input);
                 if (trail == (int32_t)-1
                     || !sentry__is_trail_surrogate(trail)) {
-                    return false;
+                    return (size_t)-1;
                 }
                 input += 4;
                 uchar = sentry__surrogate_value(lead, trail);
             } else if (sentry__is_trail_surrogate(uchar)) {
-                return false;
+                return (size_t)-1;
             }
 
             if (uchar) {
@@ -412,149 +644,309 @@ decode_string_inplace(char *buf)
             break;
         }
         default:
-            return false;
+            return (size_t)-1;
         }
     }
 
 #undef SIMPLE_ESCAPE
 
     *output = 0;
+    return (size_t)(output - start);
+}
+
+// Deeper documents are rejected, to bound the recursion of the parser.
+#define MAX_PARSE_DEPTH 512
+
+typedef struct {
+    const char *pos;
+    const char *end;
+    size_t depth;
+} json_parser_t;
+
+static void
+skip_whitespace(json_parser_t *p)
+{
+    while (p->pos < p->end
+        && (*p->pos == ' ' || *p->pos == '\n' || *p->pos == '\r'
+            || *p->pos == '\t')) {
+        p->pos++;
+    }
+}
+
+static bool
+consume_literal(json_parser_t *p, const char *literal, size_t len)
+{
+    if ((size_t)(p->end - p->pos) < len || memcmp(p->pos, literal, len) != 0) {
+        return false;
+    }
+    p->pos += len;
     return true;
 }
 
-static size_t
-tokens_to_value(jsmntok_t *tokens, size_t token_count, const char *buf,
-    sentry_value_t *value_out)
+/**
+ * Scans the string starting at the current `"`, and returns its raw contents
+ * in `start_out` and `len_out`, not yet decoded. `escaped_out` tells whether
+ * the contents contain any escape sequences.
+ */
+static bool
+scan_string(json_parser_t *p, const char **start_out, size_t *len_out,
+    bool *escaped_out)
 {
-    size_t offset = 0;
+    const char *start = p->pos + 1;
+    const char *s = start;
+    bool escaped = false;
+    for (;;) {
+        if (s >= p->end) {
+            return false;
+        }
+        if (*s == '"') {
+            break;
+        }
+        if (*s == '\\') {
+            escaped = true;
+            s += 2;
+        } else {
+            s++;
+        }
+    }
+    *start_out = start;
+    *len_out = (size_t)(s - start);
+    *escaped_out = escaped;
+    p->pos = s + 1;
+    return true;
+}
+
+static bool
+parse_number(json_parser_t *p, sentry_value_t *value_out)
+{
+    const char *start = p->pos;
+    const char *s = start;
+    const char *end = p->end;
 
-#define POP() (offset < token_count ? &tokens[offset++] : NULL)
-#define NESTED_PARSE(Target)                                                   \
+#define SKIP_DIGITS()                                                          \
     do {                                                                       \
-        size_t child_consumed = tokens_to_value(                               \
-            tokens + offset, token_count - offset, buf, Target);               \
-        if (child_consumed == (size_t)-1) {                                    \
-            goto error;                                                        \
+        const char *digits = s;                                                \
+        while (s < end && *s >= '0' && *s <= '9') {                            \
+            s++;                                                               \
+        }                                                                      \
+        if (s == digits) {                                                     \
+            return false;                                                      \
         }                                                                      \
-        offset += child_consumed;                                              \
     } while (0)
 
-    jsmntok_t *root = POP();
-    sentry_value_t rv = sentry_value_new_null();
-
-    if (!root) {
-        goto error;
+    if (s < end && *s == '-') {
+        s++;
     }
-
-    switch (root->type) {
-    case JSMN_PRIMITIVE: {
-        switch (buf[root->start]) {
-        case 't':
-            rv = sentry_value_new_bool(true);
-            break;
-        case 'f':
-            rv = sentry_value_new_bool(false);
-            break;
-        case 'n':
-            rv = sentry_value_new_null();
-            break;
-        default: {
-            double val = sentry__strtod_c(buf + root->start, NULL);
-            if (val == (double)(int32_t)val) {
-                rv = sentry_value_new_int32((int32_t)val);
-            } else {
-                rv = sentry_value_new_double(val);
-            }
-            break;
+    SKIP_DIGITS();
+    if (s < end && *s == '.') {
+        s++;
+        SKIP_DIGITS();
+    }
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        s++;
+        if (s < end && (*s == '+' || *s == '-')) {
+            s++;
         }
+        SKIP_DIGITS();
+    }
+
+#undef SKIP_DIGITS
+
+    // the input is not necessarily null-terminated, so `strtod` gets a copy
+    char buf[64];
+    size_t len = (size_t)(s - start);
+    double val;
+    if (len < sizeof(buf)) {
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        val = sentry__strtod_c(buf, NULL);
+    } else {
+        char *copy = sentry__string_clonen(start, len);
+        if (!copy) {
+            return false;
         }
-        break;
+        val = sentry__strtod_c(copy, NULL);
+        sentry_free(copy);
     }
-    case JSMN_STRING: {
-        char *string
-            = sentry__string_clonen(buf + root->start, root->end - root->start);
-        if (decode_string_inplace(string)) {
-            rv = sentry__value_new_string_owned(string);
-        } else {
-            sentry_free(string);
-            rv = sentry_value_new_null();
+    p->pos = s;
+
+    if (val >= INT32_MIN && val <= INT32_MAX && val == (double)(int32_t)val) {
+        *value_out = sentry_value_new_int32((int32_t)val);
+    } else {
+        *value_out = sentry_value_new_double(val);
+    }
+    return true;
+}
+
+static bool parse_value(json_parser_t *p, sentry_value_t *value_out);
+
+static bool
+parse_object(json_parser_t *p, sentry_value_t *value_out)
+{
+    sentry_value_t rv = sentry_value_new_object();
+    p->pos++;
+    skip_whitespace(p);
+    if (p->pos < p->end && *p->pos == '}') {
+        p->pos++;
+        *value_out = rv;
+        return true;
+    }
+    for (;;) {
+        const char *key;
+        size_t key_len;
+        bool escaped;
+        if (p->pos >= p->end || *p->pos != '"'
+            || !scan_string(p, &key, &key_len, &escaped)) {
+            goto error;
         }
-        break;
-    }
-    case JSMN_OBJECT: {
-        rv = sentry_value_new_object();
-        for (int i = 0; i < root->size; i++) {
-            jsmntok_t *token = POP();
-            if (!token || token->type != JSMN_STRING) {
-                goto error;
-            }
+        skip_whitespace(p);
+        if (p->pos >= p->end || *p->pos != ':') {
+            goto error;
+        }
+        p->pos++;
 
-            sentry_value_t child;
-            NESTED_PARSE(&child);
+        sentry_value_t child;
+        if (!parse_value(p, &child)) {
+            goto error;
+        }
 
-            char *key = sentry__string_clonen(
-                buf + token->start, token->end - token->start);
-            if (decode_string_inplace(key)) {
-                sentry_value_set_by_key(rv, key, child);
+        if (!escaped) {
+            sentry_value_set_by_key_n(rv, key, key_len, child);
+        } else {
+            // keys with invalid escapes are skipped
+            char *decoded = sentry__malloc_default_tag(
+                key_len + 1, SENTRY_MEMORY_TAG_JSON);
+            size_t decoded_len
+                = decoded ? decode_string(key, key_len, decoded) : (size_t)-1;
+            if (decoded_len != (size_t)-1) {
+                sentry_value_set_by_key_n(rv, decoded, decoded_len, child);
             } else {
                 sentry_value_decref(child);
             }
-            sentry_free(key);
+            sentry_free(decoded);
         }
-        break;
-    }
-    case JSMN_ARRAY: {
-        rv = sentry_value_new_list();
-        for (int i = 0; i < root->size; i++) {
-            sentry_value_t child;
-            NESTED_PARSE(&child);
-            sentry_value_append(rv, child);
+
+        skip_whitespace(p);
+        if (p->pos < p->end && *p->pos == ',') {
+            p->pos++;
+            skip_whitespace(p);
+        } else if (p->pos < p->end && *p->pos == '}') {
+            p->pos++;
+            *value_out = rv;
+            return true;
+        } else {
+            goto error;
         }
-        break;
     }
-    case JSMN_UNDEFINED:
-        break;
-    }
-
-#undef POP
-#undef NESTED_PARSE
-
-    *value_out = rv;
-    return offset;
 
 error:
     sentry_value_decref(rv);
-    return (size_t)-1;
+    return false;
 }
 
-sentry_value_t
-sentry__value_from_json(const char *buf, size_t buflen)
+static bool
+parse_list(json_parser_t *p, sentry_value_t *value_out)
 {
-    int token_count;
-    jsmn_parser jsmn_p;
+    sentry_value_t rv = sentry_value_new_list();
+    p->pos++;
+    skip_whitespace(p);
+    if (p->pos < p->end && *p->pos == ']') {
+        p->pos++;
+        *value_out = rv;
+        return true;
+    }
+    for (;;) {
+        sentry_value_t child;
+        if (!parse_value(p, &child)) {
+            sentry_value_decref(rv);
+            return false;
+        }
+        sentry_value_append(rv, child);
+
+        skip_whitespace(p);
+        if (p->pos < p->end && *p->pos == ',') {
+            p->pos++;
+        } else if (p->pos < p->end && *p->pos == ']') {
+            p->pos++;
+            *value_out = rv;
+            return true;
+        } else {
+            sentry_value_decref(rv);
+            return false;
+        }
+    }
+}
 
-    jsmn_init(&jsmn_p);
-    token_count = jsmn_parse(&jsmn_p, buf, buflen, NULL, 0);
-    if (token_count <= 0) {
-        return sentry_value_new_null();
+static bool
+parse_value(json_parser_t *p, sentry_value_t *value_out)
+{
+    skip_whitespace(p);
+    if (p->pos >= p->end) {
+        return false;
     }
 
-    jsmntok_t *tokens = sentry_malloc(sizeof(jsmntok_t) * token_count);
-    jsmn_init(&jsmn_p);
-    token_count = jsmn_parse(&jsmn_p, buf, buflen, tokens, token_count);
-    if (token_count <= 0) {
-        sentry_free(tokens);
-        return sentry_value_new_null();
+    switch (*p->pos) {
+    case '{':
+    case '[': {
+        if (p->depth >= MAX_PARSE_DEPTH) {
+            return false;
+        }
+        p->depth++;
+        bool rv = *p->pos == '{' ? parse_object(p, value_out)
+                                 : parse_list(p, value_out);
+        p->depth--;
+        return rv;
+    }
+    case '"': {
+        const char *start;
+        size_t len;
+        bool escaped;
+        if (!scan_string(p, &start, &len, &escaped)) {
+            return false;
+        }
+        if (!escaped) {
+            *value_out = sentry_value_new_string_n(start, len);
+            return true;
+        }
+        // strings with invalid escapes turn into `null`
+        *value_out = sentry_value_new_null();
+        char *string = sentry_malloc(len + 1);
+        if (string && decode_string(start, len, string) != (size_t)-1) {
+            *value_out = sentry__value_new_string_owned(string);
+        } else {
+            sentry_free(string);
+        }
+        return true;
     }
+    case 't':
+        *value_out = sentry_value_new_bool(true);
+        return consume_literal(p, "true", 4);
+    case 'f':
+        *value_out = sentry_value_new_bool(false);
+        return consume_literal(p, "false", 5);
+    case 'n':
+        *value_out = sentry_value_new_null();
+        return consume_literal(p, "null", 4);
+    default:
+        return parse_number(p, value_out);
+    }
+}
 
-    sentry_value_t value_out;
-    size_t tokens_consumed
-        = tokens_to_value(tokens, (size_t)token_count, buf, &value_out);
-    sentry_free(tokens);
+sentry_value_t
+sentry__value_from_json(const char *buf, size_t buflen)
+{
+    // the input ends at the first NUL byte, if any
+    const char *nul = memchr(buf, '\0', buflen);
+    json_parser_t p = { buf, nul ? nul : buf + buflen, 0 };
 
-    if (tokens_consumed == (size_t)token_count) {
-        return value_out;
-    } else {
+    sentry_value_t rv;
+    if (!parse_value(&p, &rv)) {
         return sentry_value_new_null();
     }
+    skip_whitespace(&p);
+    if (p.pos != p.end) {
+        sentry_value_decref(rv);
+        return sentry_value_new_null();
+    }
+    return rv;
 }
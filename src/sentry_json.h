@@ -5,6 +5,7 @@
 
 typedef struct sentry_stringbuilder_s sentry_stringbuilder_t;
 typedef struct sentry_jsonwriter_s sentry_jsonwriter_t;
+typedef struct sentry_filewriter_s sentry_filewriter_t;
 
 /**
  * This creates a new JSON writer.
@@ -14,6 +15,57 @@ typedef struct sentry_jsonwriter_s sentry_jsonwriter_t;
  */
 sentry_jsonwriter_t *sentry__jsonwriter_new(sentry_stringbuilder_t *sb);
 
+/**
+ * A sink that receives the output of a JSON writer in chunks.
+ * Returns 0 on success.
+ */
+typedef int (*sentry_jsonwriter_sink_func_t)(
+    const char *buf, size_t len, void *data);
+
+/**
+ * This creates a new JSON writer that streams its output into `sink`.
+ *
+ * Instead of building the complete JSON in memory, the output is passed on to
+ * `sink` whenever a chunk of a few kilobytes is filled. The remainder is only
+ * passed on by `sentry__jsonwriter_flush`.
+ */
+sentry_jsonwriter_t *sentry__jsonwriter_new_sink(
+    sentry_jsonwriter_sink_func_t sink, void *data);
+
+/**
+ * This creates a new JSON writer that streams its output into the file
+ * opened by `sentry__filewriter_new`, see `sentry__jsonwriter_new_sink`.
+ */
+sentry_jsonwriter_t *sentry__jsonwriter_new_filewriter(sentry_filewriter_t *fw);
+
+/**
+ * Reserves room for `len` more bytes of output, which avoids growing the
+ * buffer repeatedly when the size of the output can be estimated.
+ */
+void sentry__jsonwriter_reserve(sentry_jsonwriter_t *jw, size_t len);
+
+/**
+ * Passes all the buffered output of the JSON writer on to its sink.
+ *
+ * Returns 0 if the sink accepted all of the output so far. Once the sink
+ * fails, the remaining output is discarded. This does nothing for writers
+ * without a sink.
+ */
+int sentry__jsonwriter_flush(sentry_jsonwriter_t *jw);
+
+/**
+ * Returns the number of bytes of output that the JSON writer holds in memory,
+ * which is all of it for writers without a sink.
+ */
+size_t sentry__jsonwriter_get_len(const sentry_jsonwriter_t *jw);
+
+/**
+ * Discards all the output of the JSON writer, so that it can be used as if it
+ * was new. Returns false and does nothing for writers with a sink, which may
+ * have passed some of their output on already.
+ */
+bool sentry__jsonwriter_reset(sentry_jsonwriter_t *jw);
+
 /**
  * Deallocates a JSON writer.
  */
@@ -40,6 +92,16 @@ void sentry__jsonwriter_write_bool(sentry_jsonwriter_t *jw, bool val);
  */
 void sentry__jsonwriter_write_int32(sentry_jsonwriter_t *jw, int32_t val);
 
+/**
+ * Write a 64-bit signed number, which will be encoded in a JSON number.
+ */
+void sentry__jsonwriter_write_int64(sentry_jsonwriter_t *jw, int64_t val);
+
+/**
+ * Write a 64-bit unsigned number, which will be encoded in a JSON number.
+ */
+void sentry__jsonwriter_write_uint64(sentry_jsonwriter_t *jw, uint64_t val);
+
 /**
  * Write a 64-bit float, encoded as JSON number.
  */
@@ -50,6 +112,25 @@ void sentry__jsonwriter_write_double(sentry_jsonwriter_t *jw, double val);
  */
 void sentry__jsonwriter_write_str(sentry_jsonwriter_t *jw, const char *val);
 
+/**
+ * Write a string of `len` bytes, which does not need to be zero-terminated.
+ */
+void sentry__jsonwriter_write_str_n(
+    sentry_jsonwriter_t *jw, const char *val, size_t len);
+
+/**
+ * Returns the number of bytes that writing the string of `len` bytes via
+ * `sentry__jsonwriter_write_str_n` takes, including its quotes.
+ */
+size_t sentry__json_str_len(const char *str, size_t len);
+
+/**
+ * Write `len` bytes of already serialized JSON, which need to be a single
+ * complete JSON value.
+ */
+void sentry__jsonwriter_write_json(
+    sentry_jsonwriter_t *jw, const char *json, size_t len);
+
 /**
  * Write a UUID as a JSON string.
  * See `sentry_uuid_as_string`.
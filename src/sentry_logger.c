@@ -1,12 +1,53 @@
 #include "sentry_logger.h"
 #include "sentry_core.h"
 #include "sentry_options.h"
+#include "sentry_sync.h"
 
 #include <stdio.h>
 #include <string.h>
 
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#endif
+
 static sentry_logger_t g_logger = { NULL, NULL };
 
+#define LOG_RECORD_COUNT 128
+#define LOG_RECORD_SIZE 256
+
+/**
+ * The records of the async logger form a bounded lock-free queue, which any
+ * thread can write to, and which only the logger thread reads from.
+ *
+ * The position of a record in the queue determines its slot in
+ * `g_log_records`. The `sequence` of a slot equals the position while the slot
+ * is free for the record at that position, is one more once that record was
+ * written, and advances by `LOG_RECORD_COUNT` once it was logged. Positions
+ * and sequences are unsigned, and wrap around together, which keeps the slots
+ * in order since `LOG_RECORD_COUNT` is a power of two. They are stored as
+ * `long` for the atomics.
+ *
+ * The logger thread announces that it is `waiting` before it checks for a
+ * written record a final time, so the writers only need to wake it up, if it
+ * does, without missing a record.
+ */
+typedef struct {
+    volatile long sequence;
+    sentry_level_t level;
+    char message[LOG_RECORD_SIZE];
+} log_record_t;
+
+static log_record_t g_log_records[LOG_RECORD_COUNT];
+static bool g_log_records_ready = false;
+static volatile long g_log_head = 0;
+static unsigned long g_log_tail = 0;
+static volatile long g_log_dropped = 0;
+static volatile long g_log_async = 0;
+static volatile long g_log_waiting = 0;
+static sentry_mutex_t g_log_lock = SENTRY__MUTEX_INIT;
+static sentry_cond_t g_log_cond;
+static sentry_threadid_t g_log_thread;
+
 void
 sentry__logger_set_global(sentry_logger_t logger)
 {
@@ -82,14 +123,164 @@ sentry__logger_describe(sentry_level_t level)
     }
 }
 
+/**
+ * Formats the message into the next free record. Returns false if the queue is
+ * full.
+ */
+static bool
+log_enqueue(sentry_level_t level, const char *message, va_list args)
+{
+    unsigned long pos = (unsigned long)sentry__atomic_fetch(&g_log_head);
+    while (true) {
+        log_record_t *record = &g_log_records[pos % LOG_RECORD_COUNT];
+        unsigned long sequence
+            = (unsigned long)sentry__atomic_fetch(&record->sequence);
+        // the distance of the sequence to the position, across a wrap around
+        long diff = (long)(sequence - pos);
+        if (diff < 0) {
+            // the record of the previous lap was not logged yet
+            return false;
+        }
+        if (diff == 0
+            && sentry__atomic_compare_swap(
+                &g_log_head, (long)pos, (long)(pos + 1))) {
+            record->level = level;
+            vsnprintf(record->message, LOG_RECORD_SIZE, message, args);
+            sentry__atomic_store(&record->sequence, (long)(pos + 1));
+            return true;
+        }
+        // another thread took this position first
+        pos = (unsigned long)sentry__atomic_fetch(&g_log_head);
+    }
+}
+
+static void
+log_formatted(
+    sentry_logger_t logger, sentry_level_t level, const char *message, ...)
+{
+    va_list args;
+    va_start(args, message);
+    logger.logger_func(level, message, args, logger.logger_data);
+    va_end(args);
+}
+
+/**
+ * Returns whether the next record in the queue was written. This must be
+ * called with `g_log_lock` held.
+ */
+static bool
+log_has_record(void)
+{
+    log_record_t *record = &g_log_records[g_log_tail % LOG_RECORD_COUNT];
+    return (unsigned long)sentry__atomic_fetch(&record->sequence)
+        == g_log_tail + 1;
+}
+
+/**
+ * Logs the written records, in order. This must be called with `g_log_lock`
+ * held, since only one reader may consume the records.
+ */
+static void
+log_drain(void)
+{
+    sentry_logger_t logger = g_logger;
+    while (log_has_record()) {
+        log_record_t *record = &g_log_records[g_log_tail % LOG_RECORD_COUNT];
+        if (logger.logger_func) {
+            log_formatted(logger, record->level, "%s", record->message);
+        }
+        sentry__atomic_store(
+            &record->sequence, (long)(g_log_tail + LOG_RECORD_COUNT));
+        g_log_tail++;
+    }
+
+    long dropped = sentry__atomic_store(&g_log_dropped, 0);
+    if (dropped && logger.logger_func) {
+        log_formatted(logger, SENTRY_LEVEL_WARNING,
+            "%ld log messages were dropped", dropped);
+    }
+}
+
+SENTRY_THREAD_FN
+log_thread_func(void *UNUSED(data))
+{
+    sentry__mutex_lock(&g_log_lock);
+    while (sentry__atomic_fetch(&g_log_async)) {
+        log_drain();
+        sentry__atomic_store(&g_log_waiting, 1);
+        if (!log_has_record() && sentry__atomic_fetch(&g_log_async)) {
+            sentry__cond_wait(&g_log_cond, &g_log_lock);
+        }
+        sentry__atomic_store(&g_log_waiting, 0);
+    }
+    log_drain();
+    sentry__mutex_unlock(&g_log_lock);
+    return 0;
+}
+
+void
+sentry__logger_start_async(void)
+{
+    if (sentry__atomic_fetch(&g_log_async)) {
+        return;
+    }
+    if (!g_log_records_ready) {
+        for (unsigned long i = 0; i < LOG_RECORD_COUNT; i++) {
+            g_log_records[i].sequence = (long)i;
+        }
+        g_log_records_ready = true;
+    }
+    sentry__cond_init(&g_log_cond);
+    sentry__thread_init(&g_log_thread);
+    sentry__atomic_store(&g_log_async, 1);
+    if (sentry__thread_spawn(&g_log_thread, log_thread_func, NULL) != 0) {
+        sentry__atomic_store(&g_log_async, 0);
+        sentry__thread_free(&g_log_thread);
+    }
+}
+
+void
+sentry__logger_stop_async(void)
+{
+    if (!sentry__atomic_store(&g_log_async, 0)) {
+        return;
+    }
+    sentry__mutex_lock(&g_log_lock);
+    sentry__cond_wake(&g_log_cond);
+    sentry__mutex_unlock(&g_log_lock);
+    sentry__thread_join(g_log_thread);
+    sentry__thread_free(&g_log_thread);
+
+    // log the records that were written while the thread was exiting
+    sentry__mutex_lock(&g_log_lock);
+    log_drain();
+    sentry__mutex_unlock(&g_log_lock);
+}
+
 void
 sentry__logger_log(sentry_level_t level, const char *message, ...)
 {
     sentry_logger_t logger = g_logger;
-    if (logger.logger_func) {
-        va_list args;
-        va_start(args, message);
+    if (!logger.logger_func) {
+        return;
+    }
+    va_list args;
+    va_start(args, message);
+    bool async = sentry__atomic_fetch(&g_log_async);
+#ifdef SENTRY_PLATFORM_UNIX
+    // the logger thread might not run anymore while handling a crash
+    async = async && !sentry__page_allocator_enabled();
+#endif
+    if (!async) {
         logger.logger_func(level, message, args, logger.logger_data);
-        va_end(args);
+    } else if (log_enqueue(level, message, args)) {
+        if (sentry__atomic_fetch(&g_log_waiting)) {
+            sentry__mutex_lock(&g_log_lock);
+            sentry__cond_wake(&g_log_cond);
+            sentry__mutex_unlock(&g_log_lock);
+        }
+    } else {
+        sentry__atomic_fetch_and_add(&g_log_dropped, 1);
     }
+    va_end(args);
 }
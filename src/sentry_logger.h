@@ -17,21 +17,76 @@ const char *sentry__logger_describe(sentry_level_t level);
 
 void sentry__logger_log(sentry_level_t level, const char *message, ...);
 
-#define SENTRY_TRACEF(message, ...)                                            \
-    sentry__logger_log(SENTRY_LEVEL_DEBUG, message, __VA_ARGS__)
+/**
+ * Starts the background thread that passes the messages to the global logger,
+ * which are then buffered instead of being logged right away.
+ */
+void sentry__logger_start_async(void);
 
-#define SENTRY_TRACE(message) sentry__logger_log(SENTRY_LEVEL_DEBUG, message)
+/**
+ * Logs the buffered messages, and stops the background thread. The messages
+ * are logged right away again afterwards.
+ */
+void sentry__logger_stop_async(void);
 
-#define SENTRY_DEBUGF(message, ...)                                            \
-    sentry__logger_log(SENTRY_LEVEL_INFO, message, __VA_ARGS__)
+/**
+ * The messages that are logged with a `sentry_level_t` below this are compiled
+ * out, see the `SENTRY_MIN_LOG_LEVEL` CMake option.
+ */
+#ifndef SENTRY_MIN_LOG_LEVEL
+#    define SENTRY_MIN_LOG_LEVEL -1
+#endif
+
+// the arguments of disabled messages are still type-checked, but the call is
+// removed as dead code, so they are never evaluated
+#define SENTRY__LOG_DISABLED(...)                                              \
+    do {                                                                       \
+        if (0) {                                                               \
+            sentry__logger_log(__VA_ARGS__);                                   \
+        }                                                                      \
+    } while (0)
 
-#define SENTRY_DEBUG(message) sentry__logger_log(SENTRY_LEVEL_INFO, message)
+#if SENTRY_MIN_LOG_LEVEL <= -1
+#    define SENTRY_TRACEF(message, ...)                                        \
+        sentry__logger_log(SENTRY_LEVEL_DEBUG, message, __VA_ARGS__)
+#    define SENTRY_TRACE(message)                                              \
+        sentry__logger_log(SENTRY_LEVEL_DEBUG, message)
+#else
+#    define SENTRY_TRACEF(message, ...)                                        \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_DEBUG, message, __VA_ARGS__)
+#    define SENTRY_TRACE(message)                                              \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_DEBUG, message)
+#endif
 
-#define SENTRY_WARNF(message, ...)                                             \
-    sentry__logger_log(SENTRY_LEVEL_WARNING, message, __VA_ARGS__)
+#if SENTRY_MIN_LOG_LEVEL <= 0
+#    define SENTRY_DEBUGF(message, ...)                                        \
+        sentry__logger_log(SENTRY_LEVEL_INFO, message, __VA_ARGS__)
+#    define SENTRY_DEBUG(message) sentry__logger_log(SENTRY_LEVEL_INFO, message)
+#else
+#    define SENTRY_DEBUGF(message, ...)                                        \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_INFO, message, __VA_ARGS__)
+#    define SENTRY_DEBUG(message)                                              \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_INFO, message)
+#endif
 
-#define SENTRY_WARN(message) sentry__logger_log(SENTRY_LEVEL_WARNING, message)
+#if SENTRY_MIN_LOG_LEVEL <= 1
+#    define SENTRY_WARNF(message, ...)                                         \
+        sentry__logger_log(SENTRY_LEVEL_WARNING, message, __VA_ARGS__)
+#    define SENTRY_WARN(message)                                               \
+        sentry__logger_log(SENTRY_LEVEL_WARNING, message)
+#else
+#    define SENTRY_WARNF(message, ...)                                         \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_WARNING, message, __VA_ARGS__)
+#    define SENTRY_WARN(message)                                               \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_WARNING, message)
+#endif
 
-#define SENTRY_ERROR(message) sentry__logger_log(SENTRY_LEVEL_ERROR, message)
+#if SENTRY_MIN_LOG_LEVEL <= 2
+#    define SENTRY_ERROR(message)                                              \
+        sentry__logger_log(SENTRY_LEVEL_ERROR, message)
+#else
+#    define SENTRY_ERROR(message)                                              \
+        SENTRY__LOG_DISABLED(SENTRY_LEVEL_ERROR, message)
+#endif
 
 #endif
@@ -0,0 +1,567 @@
+#include "sentry_metrics.h"
+
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_dtoa.h"
+#include "sentry_envelope.h"
+#include "sentry_options.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_utils.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS_BUCKET_MS (10 * 1000)
+#define METRICS_FLUSH_INTERVAL_MS (10 * 1000)
+#define METRICS_KEY_LEN 128
+#define METRICS_UNIT_LEN 32
+#define METRICS_TAGS_LEN 256
+#define METRICS_MIN_SLOTS 16
+
+#define SLOT_EMPTY 0
+#define SLOT_CLAIMED 1
+#define SLOT_READY 2
+
+#define METRIC_COUNTER 'c'
+#define METRIC_GAUGE 'g'
+#define METRIC_DISTRIBUTION 'd'
+#define METRIC_SET 's'
+
+/**
+ * The aggregate of one bucket, type, key, unit and tags. A slot is claimed by
+ * the first metric that needs it, and is only compared against once it is
+ * ready. Counters and gauges are aggregated in the slot itself, under its
+ * spinlock, which is only held for a few instructions.
+ */
+typedef struct {
+    volatile long state;
+    volatile long lock;
+    uint64_t bucket_ms;
+    uint64_t hash;
+    char type;
+    char key[METRICS_KEY_LEN];
+    char unit[METRICS_UNIT_LEN];
+    char tags[METRICS_TAGS_LEN];
+    // the sum of a counter, or the last value of a gauge
+    double value;
+    double min;
+    double max;
+    double sum;
+    uint64_t count;
+} metric_slot_t;
+
+/**
+ * A single value of a distribution, or the hash of a set member, which is
+ * only sorted to its slot once the table is flushed.
+ */
+typedef struct {
+    uint32_t slot;
+    double value;
+} metric_value_t;
+
+/**
+ * An open addressing hash table of slots, and the values of its
+ * distributions and sets. `writers` counts the metrics that are currently
+ * recording into the table.
+ */
+typedef struct {
+    metric_slot_t *slots;
+    size_t slot_count;
+    metric_value_t *values;
+    size_t value_capacity;
+    volatile long value_count;
+    volatile long writers;
+    volatile long dropped;
+} metric_table_t;
+
+/**
+ * The metrics record into the active table, while the other one is being
+ * flushed, just like the request sessions of `sentry_session_aggregator.c`.
+ */
+static metric_table_t g_tables[2];
+static volatile long g_active_table = 0;
+static volatile long g_aggregating = 0;
+
+// serializes starting, stopping and flushing
+static sentry_mutex_t g_metrics_lock = SENTRY__MUTEX_INIT;
+static sentry_bgworker_t *g_metrics_worker = NULL;
+
+static void
+hash_bytes(uint64_t *hash, const void *buf, size_t len)
+{
+    // FNV-1a
+    const unsigned char *ptr = buf;
+    for (size_t i = 0; i < len; i++) {
+        *hash ^= ptr[i];
+        *hash *= 1099511628211u;
+    }
+}
+
+static size_t
+truncated_len(const char *str, size_t max_len)
+{
+    size_t len = 0;
+    while (str && len < max_len - 1 && str[len]) {
+        len++;
+    }
+    return len;
+}
+
+static bool
+slot_matches(const metric_slot_t *slot, const char *str, size_t len,
+    size_t offset)
+{
+    const char *field = (const char *)slot + offset;
+    return strncmp(field, str ? str : "", len) == 0 && field[len] == '\0';
+}
+
+static metric_slot_t *
+find_slot(metric_table_t *table, char type, uint64_t bucket_ms, uint64_t hash,
+    const char *key, size_t key_len, const char *unit, size_t unit_len,
+    const char *tags, size_t tags_len)
+{
+    for (size_t i = 0; i < table->slot_count; i++) {
+        metric_slot_t *slot = &table->slots[(hash + i) % table->slot_count];
+        long state = sentry__atomic_fetch(&slot->state);
+        if (state == SLOT_EMPTY
+            && sentry__atomic_compare_swap(
+                &slot->state, SLOT_EMPTY, SLOT_CLAIMED)) {
+            slot->bucket_ms = bucket_ms;
+            slot->hash = hash;
+            slot->type = type;
+            memcpy(slot->key, key, key_len);
+            slot->key[key_len] = '\0';
+            if (unit_len) {
+                memcpy(slot->unit, unit, unit_len);
+            }
+            slot->unit[unit_len] = '\0';
+            if (tags_len) {
+                memcpy(slot->tags, tags, tags_len);
+            }
+            slot->tags[tags_len] = '\0';
+            sentry__atomic_store(&slot->state, SLOT_READY);
+            return slot;
+        }
+        // another metric is just filling in this slot
+        while (state != SLOT_READY) {
+            state = sentry__atomic_fetch(&slot->state);
+        }
+        if (slot->hash == hash && slot->bucket_ms == bucket_ms
+            && slot->type == type
+            && slot_matches(slot, key, key_len, offsetof(metric_slot_t, key))
+            && slot_matches(
+                slot, unit, unit_len, offsetof(metric_slot_t, unit))
+            && slot_matches(
+                slot, tags, tags_len, offsetof(metric_slot_t, tags))) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static void
+aggregate_value(metric_table_t *table, metric_slot_t *slot, double value)
+{
+    if (slot->type == METRIC_DISTRIBUTION || slot->type == METRIC_SET) {
+        long index = sentry__atomic_fetch_and_add(&table->value_count, 1);
+        if ((size_t)index >= table->value_capacity) {
+            sentry__atomic_fetch_and_add(&table->dropped, 1);
+            return;
+        }
+        table->values[index].slot = (uint32_t)(slot - table->slots);
+        table->values[index].value = value;
+        return;
+    }
+
+    while (!sentry__atomic_compare_swap(&slot->lock, 0, 1)) {
+        // the lock is only held for a few instructions
+    }
+    if (slot->type == METRIC_COUNTER) {
+        slot->value += value;
+    } else {
+        if (!slot->count || value < slot->min) {
+            slot->min = value;
+        }
+        if (!slot->count || value > slot->max) {
+            slot->max = value;
+        }
+        slot->value = value;
+        slot->sum += value;
+        slot->count++;
+    }
+    sentry__atomic_store(&slot->lock, 0);
+}
+
+static void
+record_metric(char type, const char *key, double value, const char *unit,
+    const char *tags)
+{
+    if (!key || !*key || !sentry__atomic_fetch(&g_aggregating)) {
+        return;
+    }
+    uint64_t bucket_ms
+        = sentry__msec_time() / METRICS_BUCKET_MS * METRICS_BUCKET_MS;
+    size_t key_len = truncated_len(key, METRICS_KEY_LEN);
+    size_t unit_len = truncated_len(unit, METRICS_UNIT_LEN);
+    size_t tags_len = truncated_len(tags, METRICS_TAGS_LEN);
+    uint64_t hash = 14695981039346656037u;
+    hash_bytes(&hash, &type, 1);
+    hash_bytes(&hash, &bucket_ms, sizeof(bucket_ms));
+    hash_bytes(&hash, key, key_len);
+    hash_bytes(&hash, "@", 1);
+    hash_bytes(&hash, unit, unit_len);
+    hash_bytes(&hash, "|", 1);
+    hash_bytes(&hash, tags, tags_len);
+
+    while (true) {
+        long index = sentry__atomic_fetch(&g_active_table);
+        metric_table_t *table = &g_tables[index];
+        sentry__atomic_fetch_and_add(&table->writers, 1);
+        // the tables may have been swapped or freed in the meantime, in which
+        // case nobody might wait for us
+        if (!sentry__atomic_fetch(&g_aggregating)) {
+            sentry__atomic_fetch_and_add(&table->writers, -1);
+            return;
+        }
+        if (sentry__atomic_fetch(&g_active_table) == index) {
+            metric_slot_t *slot = find_slot(table, type, bucket_ms, hash, key,
+                key_len, unit, unit_len, tags, tags_len);
+            if (slot) {
+                aggregate_value(table, slot, value);
+            } else {
+                sentry__atomic_fetch_and_add(&table->dropped, 1);
+            }
+            sentry__atomic_fetch_and_add(&table->writers, -1);
+            return;
+        }
+        sentry__atomic_fetch_and_add(&table->writers, -1);
+    }
+}
+
+void
+sentry_metrics_increment(
+    const char *key, double value, const char *unit, const char *tags)
+{
+    record_metric(METRIC_COUNTER, key, value, unit, tags);
+}
+
+void
+sentry_metrics_gauge(
+    const char *key, double value, const char *unit, const char *tags)
+{
+    record_metric(METRIC_GAUGE, key, value, unit, tags);
+}
+
+void
+sentry_metrics_distribution(
+    const char *key, double value, const char *unit, const char *tags)
+{
+    record_metric(METRIC_DISTRIBUTION, key, value, unit, tags);
+}
+
+void
+sentry_metrics_set(
+    const char *key, const char *value, const char *unit, const char *tags)
+{
+    // the members of a set are only counted, so their hash is enough
+    uint64_t hash = 14695981039346656037u;
+    hash_bytes(&hash, value ? value : "", value ? strlen(value) : 0);
+    record_metric(METRIC_SET, key, (double)(uint32_t)hash, unit, tags);
+}
+
+/**
+ * Appends `str`, with the characters that are not in `allowed` replaced, so
+ * that they can not break the `statsd` format.
+ */
+static void
+append_sanitized(
+    sentry_stringbuilder_t *sb, const char *str, const char *allowed)
+{
+    for (; *str; str++) {
+        char c = *str;
+        bool is_allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || strchr(allowed, c);
+        sentry__stringbuilder_append_char(sb, is_allowed ? c : '_');
+    }
+}
+
+static void
+append_double(sentry_stringbuilder_t *sb, double value)
+{
+    char buf[SENTRY_DTOA_BUF_SIZE];
+    size_t len = sentry__dtoa(value, buf);
+    sentry__stringbuilder_append_buf(sb, buf, len);
+}
+
+static int
+compare_values(const void *a, const void *b)
+{
+    const metric_value_t *value_a = a;
+    const metric_value_t *value_b = b;
+    if (value_a->slot != value_b->slot) {
+        return value_a->slot < value_b->slot ? -1 : 1;
+    }
+    if (value_a->value != value_b->value) {
+        return value_a->value < value_b->value ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Appends the values of `slot` to the `statsd` line, and returns false if it
+ * has none. `*value_pos` is the position of the values of `slot` in the
+ * sorted values of the table, and is advanced past them.
+ */
+static bool
+append_slot_values(sentry_stringbuilder_t *sb, const metric_table_t *table,
+    size_t slot_index, size_t value_count, size_t *value_pos)
+{
+    const metric_slot_t *slot = &table->slots[slot_index];
+    if (slot->type == METRIC_COUNTER) {
+        sentry__stringbuilder_append_char(sb, ':');
+        append_double(sb, slot->value);
+        return true;
+    }
+    if (slot->type == METRIC_GAUGE) {
+        if (!slot->count) {
+            return false;
+        }
+        double values[] = { slot->value, slot->min, slot->max, slot->sum };
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+            sentry__stringbuilder_append_char(sb, ':');
+            append_double(sb, values[i]);
+        }
+        sentry__stringbuilder_append_char(sb, ':');
+        sentry__stringbuilder_append_int64(sb, (int64_t)slot->count);
+        return true;
+    }
+
+    bool has_values = false;
+    const metric_value_t *prev = NULL;
+    for (; *value_pos < value_count
+         && table->values[*value_pos].slot == slot_index;
+         (*value_pos)++) {
+        const metric_value_t *value = &table->values[*value_pos];
+        // set members are only sent once
+        if (slot->type == METRIC_SET && prev && prev->value == value->value) {
+            continue;
+        }
+        sentry__stringbuilder_append_char(sb, ':');
+        append_double(sb, value->value);
+        prev = value;
+        has_values = true;
+    }
+    return has_values;
+}
+
+/**
+ * Writes the ready slots of `table`, which needs to be inactive, as `statsd`
+ * lines, like `key@unit:value:value|type|#tags|T1700000000`.
+ */
+static void
+write_statsd(sentry_stringbuilder_t *sb, metric_table_t *table)
+{
+    size_t value_count = (size_t)sentry__atomic_fetch(&table->value_count);
+    if (value_count > table->value_capacity) {
+        value_count = table->value_capacity;
+    }
+    qsort(table->values, value_count, sizeof(metric_value_t), compare_values);
+
+    size_t value_pos = 0;
+    for (size_t i = 0; i < table->slot_count; i++) {
+        const metric_slot_t *slot = &table->slots[i];
+        if (slot->state != SLOT_READY) {
+            continue;
+        }
+        size_t line_start = sb->len;
+        append_sanitized(sb, slot->key, "_-.");
+        sentry__stringbuilder_append_char(sb, '@');
+        append_sanitized(sb, slot->unit[0] ? slot->unit : "none", "_");
+        if (!append_slot_values(sb, table, i, value_count, &value_pos)) {
+            // all of its values were dropped
+            sb->len = line_start;
+            continue;
+        }
+        sentry__stringbuilder_append_char(sb, '|');
+        sentry__stringbuilder_append_char(sb, slot->type);
+        if (slot->tags[0]) {
+            sentry__stringbuilder_append(sb, "|#");
+            append_sanitized(sb, slot->tags, "_-.:,/ ");
+        }
+        sentry__stringbuilder_append(sb, "|T");
+        sentry__stringbuilder_append_int64(
+            sb, (int64_t)(slot->bucket_ms / 1000));
+        sentry__stringbuilder_append_char(sb, '\n');
+    }
+}
+
+static void
+flush_metrics(const sentry_options_t *options)
+{
+    sentry__mutex_lock(&g_metrics_lock);
+    long index = sentry__atomic_fetch(&g_active_table);
+    metric_table_t *table = &g_tables[index];
+    if (!table->slots) {
+        sentry__mutex_unlock(&g_metrics_lock);
+        return;
+    }
+    sentry__atomic_store(&g_active_table, 1 - index);
+    while (sentry__atomic_fetch(&table->writers)) {
+        // the metrics only update a few values, so this is short
+    }
+
+    long dropped = sentry__atomic_fetch(&table->dropped);
+    if (dropped) {
+        SENTRY_DEBUGF("dropped %ld metrics, since they did not fit into the "
+                      "metrics memory",
+            dropped);
+    }
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    write_statsd(&sb, table);
+    sentry_envelope_t *envelope = NULL;
+    if (sb.len) {
+        envelope = sentry__envelope_new();
+        if (envelope
+            && !sentry__envelope_add_from_buffer(
+                envelope, sb.buf, sb.len, "statsd")) {
+            sentry_envelope_free(envelope);
+            envelope = NULL;
+        }
+    }
+    sentry__stringbuilder_cleanup(&sb);
+
+    // the table is inactive, and nobody else writes to it now
+    memset(table->slots, 0, sizeof(metric_slot_t) * table->slot_count);
+    sentry__atomic_store(&table->value_count, 0);
+    sentry__atomic_store(&table->dropped, 0);
+    sentry__mutex_unlock(&g_metrics_lock);
+
+    if (envelope) {
+        sentry__capture_envelope(options->transport, envelope);
+    }
+}
+
+static void
+flush_metrics_task(void *UNUSED(task_data), void *UNUSED(state))
+{
+    sentry__metrics_flush();
+}
+
+void
+sentry__metrics_flush(void)
+{
+    SENTRY_WITH_OPTIONS (options) {
+        flush_metrics(options);
+    }
+}
+
+static void
+free_tables(void)
+{
+    for (size_t i = 0; i < 2; i++) {
+        // the `writers` are left alone, since metrics that come in late may
+        // still update them
+        metric_table_t *table = &g_tables[i];
+        sentry_free(table->slots);
+        sentry_free(table->values);
+        table->slots = NULL;
+        table->slot_count = 0;
+        table->values = NULL;
+        table->value_capacity = 0;
+    }
+}
+
+static bool
+allocate_tables(size_t max_memory)
+{
+    // each table gets half of the memory, which is split evenly between its
+    // slots and its values
+    size_t table_memory = max_memory / 4;
+    size_t slot_count = table_memory / sizeof(metric_slot_t);
+    if (slot_count < METRICS_MIN_SLOTS) {
+        slot_count = METRICS_MIN_SLOTS;
+    }
+    size_t value_capacity = table_memory / sizeof(metric_value_t);
+    for (size_t i = 0; i < 2; i++) {
+        metric_table_t *table = &g_tables[i];
+        table->slots = sentry_malloc(sizeof(metric_slot_t) * slot_count);
+        table->values = value_capacity
+            ? sentry_malloc(sizeof(metric_value_t) * value_capacity)
+            : NULL;
+        if (!table->slots || (value_capacity && !table->values)) {
+            free_tables();
+            return false;
+        }
+        memset(table->slots, 0, sizeof(metric_slot_t) * slot_count);
+        table->slot_count = slot_count;
+        table->value_capacity = value_capacity;
+        sentry__atomic_store(&table->value_count, 0);
+        sentry__atomic_store(&table->dropped, 0);
+    }
+    return true;
+}
+
+void
+sentry__metrics_start(const sentry_options_t *options)
+{
+    if (!options->enable_metrics) {
+        return;
+    }
+
+    sentry__mutex_lock(&g_metrics_lock);
+    if (g_metrics_worker) {
+        goto done;
+    }
+    if (!allocate_tables(options->metrics_max_memory)) {
+        goto done;
+    }
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        free_tables();
+        goto done;
+    }
+    sentry__bgworker_setname(bgw, "sentry-metrics");
+    if (sentry__bgworker_submit_periodic(bgw, flush_metrics_task, NULL, NULL,
+            METRICS_FLUSH_INTERVAL_MS, NULL)
+            != 0
+        || sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start aggregating metrics");
+        sentry__bgworker_decref(bgw);
+        free_tables();
+        goto done;
+    }
+    g_metrics_worker = bgw;
+    sentry__atomic_store(&g_active_table, 0);
+    sentry__atomic_store(&g_aggregating, 1);
+
+done:
+    sentry__mutex_unlock(&g_metrics_lock);
+}
+
+void
+sentry__metrics_stop(void)
+{
+    sentry__mutex_lock(&g_metrics_lock);
+    sentry_bgworker_t *bgw = g_metrics_worker;
+    g_metrics_worker = NULL;
+    sentry__atomic_store(&g_aggregating, 0);
+    sentry__mutex_unlock(&g_metrics_lock);
+    if (!bgw) {
+        return;
+    }
+
+    if (sentry__bgworker_shutdown(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT) == 0) {
+        sentry__bgworker_decref(bgw);
+    }
+    // both tables may still hold metrics, and each flush waits for the
+    // metrics that are still recording into its table
+    sentry__metrics_flush();
+    sentry__metrics_flush();
+
+    sentry__mutex_lock(&g_metrics_lock);
+    free_tables();
+    sentry__mutex_unlock(&g_metrics_lock);
+}
@@ -0,0 +1,24 @@
+#ifndef SENTRY_METRICS_H_INCLUDED
+#define SENTRY_METRICS_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Allocates the buckets within the memory cap of `options`, and starts
+ * sending them periodically, if metrics are enabled.
+ */
+void sentry__metrics_start(const sentry_options_t *options);
+
+/**
+ * Stops aggregating metrics, sends the buckets that were aggregated so far,
+ * and frees them. This must not be called with the options lock held, since
+ * sending the buckets needs it.
+ */
+void sentry__metrics_stop(void);
+
+/**
+ * Sends the buckets that were aggregated so far.
+ */
+void sentry__metrics_flush(void);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SENTRY_MODULEFINDER_H_INCLUDED
+#define SENTRY_MODULEFINDER_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_path.h"
+
+/**
+ * Returns the number of bytes allocated for the cached modules list, as per
+ * `sentry__value_get_memory_usage`. This is `0` as long as the modules have
+ * not been loaded, and does not trigger loading them.
+ */
+size_t sentry__modulefinder_get_memory_usage(void);
+
+/**
+ * Frees the cached modules list, along with everything the modulefinder keeps
+ * around to update it incrementally. This is called from `sentry_close`,
+ * whereas `sentry_clear_modulecache` only invalidates the modules list.
+ */
+void sentry__modulefinder_cleanup(void);
+
+/**
+ * Sets the database directory, in which the modulefinder may persist
+ * information about modules across processes. Without one, nothing is
+ * persisted.
+ */
+void sentry__modulefinder_set_database_path(const sentry_path_t *database_path);
+
+/**
+ * Invokes `callback` for every writable memory range of the loaded modules,
+ * which holds their global variables, along with the file name of the module.
+ * This is not supported on AIX.
+ */
+void sentry__modulefinder_foreach_writable_range(
+    void (*callback)(const char *name, void *start, size_t size, void *data),
+    void *data);
+
+/**
+ * The address range of the module at `index` of a modules list.
+ */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    size_t index;
+} sentry_module_range_t;
+
+/**
+ * An immutable index of the address ranges of a modules list, sorted by their
+ * start address, which answers which module contains an address with a binary
+ * search.
+ */
+typedef struct sentry_module_index_s sentry_module_index_t;
+
+/**
+ * Returns the index of the `modules` list, as returned by
+ * `sentry_get_modules_list`. The index of the most recent list is cached, so
+ * it is only built once for every version of the modules list. The index
+ * keeps a reference to the list, and needs to be released with
+ * `sentry__module_index_decref`. Returns NULL if `modules` is not a list.
+ */
+sentry_module_index_t *sentry__module_index_get(sentry_value_t modules);
+
+/**
+ * Releases a reference to the `index`, which may be NULL.
+ */
+void sentry__module_index_decref(sentry_module_index_t *index);
+
+/**
+ * Returns the range of the module that contains `addr`, or NULL.
+ */
+const sentry_module_range_t *sentry__module_index_find(
+    const sentry_module_index_t *index, uint64_t addr);
+
+/**
+ * Returns a borrowed reference to the module in the modules list of the
+ * `index` that contains `addr`, or a null Value.
+ */
+sentry_value_t sentry__module_index_find_module(
+    const sentry_module_index_t *index, uint64_t addr);
+
+/**
+ * Frees the cached index, which is called from `sentry_close`.
+ */
+void sentry__module_index_cleanup(void);
+
+#endif
@@ -0,0 +1,347 @@
+#include "sentry_offline.h"
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_database.h"
+#include "sentry_envelope.h"
+#include "sentry_options.h"
+#include "sentry_path.h"
+#include "sentry_sync.h"
+#include "sentry_transport.h"
+
+#include <string.h>
+
+// The backlog is uploaded in batches of this many envelopes, at most one per
+// interval, and a batch waits for the send queue of the transport to drain
+// below the size of a batch first.
+#define OFFLINE_BATCH_SIZE 8
+#define OFFLINE_BATCH_INTERVAL_MS 1000
+
+static volatile long g_offline = 0;
+
+/**
+ * The worker is only started once there is a backlog to upload, or a
+ * connectivity probe to call, so that most apps never need its thread. The
+ * upload of the backlog is a chain of delayed tasks, which ends once the
+ * backlog is empty or the SDK is offline again, and which starts again when
+ * the SDK goes online.
+ */
+typedef struct {
+    sentry_options_t *options;
+    sentry_path_t *backlog_path;
+    sentry_bgworker_t *worker;
+    // whether the backlog may have envelopes, so that an empty backlog is not
+    // listed again
+    volatile long has_backlog;
+    // whether the next upload task is queued, so that there is only one chain
+    volatile long upload_scheduled;
+} offline_state_t;
+
+// guards `g_offline_state`, which is only set between `sentry__offline_start`
+// and `sentry__offline_stop`, and the start of its worker
+static sentry_mutex_t g_offline_lock = SENTRY__MUTEX_INIT;
+static offline_state_t *g_offline_state = NULL;
+
+static void
+free_offline_state(offline_state_t *state)
+{
+    sentry__path_free(state->backlog_path);
+    sentry_options_free(state->options);
+    sentry_free(state);
+}
+
+static void upload_backlog_task(void *task_data, void *UNUSED(state));
+
+static void
+schedule_upload(offline_state_t *state, uint64_t delay_ms)
+{
+    if (!sentry__atomic_compare_swap(&state->upload_scheduled, 0, 1)) {
+        return;
+    }
+    int rv = delay_ms
+        ? sentry__bgworker_submit_delayed(state->worker, upload_backlog_task,
+              NULL, state, delay_ms, NULL)
+        : sentry__bgworker_submit(
+              state->worker, upload_backlog_task, NULL, state);
+    if (rv != 0) {
+        sentry__atomic_store(&state->upload_scheduled, 0);
+    }
+}
+
+/**
+ * Starts the worker of `state`, unless it is running already.
+ * This must be called with `g_offline_lock` held. Returns true if it runs.
+ */
+static bool
+start_worker(offline_state_t *state)
+{
+    if (state->worker) {
+        return true;
+    }
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        return false;
+    }
+    sentry__bgworker_setname(bgw, "sentry-offline");
+    if (sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start uploading the offline backlog");
+        sentry__bgworker_decref(bgw);
+        return false;
+    }
+    state->worker = bgw;
+    return true;
+}
+
+/**
+ * Starts uploading the backlog of `state` if there is one, and the SDK is
+ * online. This must be called with `g_offline_lock` held.
+ */
+static void
+resume_upload(offline_state_t *state)
+{
+    if (!sentry__atomic_fetch(&g_offline)
+        && sentry__atomic_fetch(&state->has_backlog) && start_worker(state)) {
+        schedule_upload(state, 0);
+    }
+}
+
+void
+sentry_set_offline(int offline)
+{
+    long value = offline ? 1 : 0;
+    if (!sentry__atomic_compare_swap(&g_offline, !value, value)) {
+        return;
+    }
+    if (value) {
+        SENTRY_DEBUG("the SDK is offline, envelopes are written to the "
+                     "database until it is online again");
+        return;
+    }
+    SENTRY_DEBUG("the SDK is online again, uploading the offline backlog");
+    sentry__mutex_lock(&g_offline_lock);
+    if (g_offline_state) {
+        resume_upload(g_offline_state);
+    }
+    sentry__mutex_unlock(&g_offline_lock);
+}
+
+int
+sentry_is_offline(void)
+{
+    return sentry__atomic_fetch(&g_offline) ? 1 : 0;
+}
+
+static int
+compare_filenames(const sentry_path_t *a, const sentry_path_t *b)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return wcscmp(sentry__path_filename(a), sentry__path_filename(b));
+#else
+    return strcmp(sentry__path_filename(a), sentry__path_filename(b));
+#endif
+}
+
+/**
+ * Collects the paths of the up to `OFFLINE_BATCH_SIZE` envelopes of the
+ * backlog that come first by their name, which orders them by importance and
+ * then by age, see `sentry__run_write_offline_envelope`.
+ */
+static size_t
+collect_batch(const sentry_path_t *backlog_path, sentry_path_t **batch)
+{
+    size_t batch_len = 0;
+    sentry_pathiter_t *iter = sentry__path_iter_directory(backlog_path);
+    const sentry_path_t *path;
+    while (iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        if (!sentry__path_ends_with(path, ".envelope")) {
+            continue;
+        }
+        // an insertion into the sorted batch, which drops its last path once
+        // it is full
+        size_t pos = batch_len;
+        while (pos > 0 && compare_filenames(path, batch[pos - 1]) < 0) {
+            pos--;
+        }
+        if (pos == OFFLINE_BATCH_SIZE) {
+            continue;
+        }
+        sentry_path_t *clone = sentry__path_clone(path);
+        if (!clone) {
+            continue;
+        }
+        if (batch_len == OFFLINE_BATCH_SIZE) {
+            sentry__path_free(batch[--batch_len]);
+        }
+        memmove(&batch[pos + 1], &batch[pos],
+            sizeof(sentry_path_t *) * (batch_len - pos));
+        batch[pos] = clone;
+        batch_len++;
+    }
+    sentry__pathiter_free(iter);
+    return batch_len;
+}
+
+static bool
+backlog_is_empty(const sentry_path_t *backlog_path)
+{
+    bool is_empty = true;
+    sentry_pathiter_t *iter = sentry__path_iter_directory(backlog_path);
+    const sentry_path_t *path;
+    while (is_empty && iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        is_empty = !sentry__path_ends_with(path, ".envelope");
+    }
+    sentry__pathiter_free(iter);
+    return is_empty;
+}
+
+static void
+upload_backlog_task(void *task_data, void *UNUSED(state))
+{
+    offline_state_t *state = (offline_state_t *)task_data;
+    const sentry_options_t *options = state->options;
+    sentry__atomic_store(&state->upload_scheduled, 0);
+    if (sentry__atomic_fetch(&g_offline)
+        || !sentry__atomic_fetch(&state->has_backlog)) {
+        return;
+    }
+    if (sentry__options_should_skip_upload(options)
+        || sentry__transport_get_queue_depth(options->transport)
+            >= OFFLINE_BATCH_SIZE) {
+        schedule_upload(state, OFFLINE_BATCH_INTERVAL_MS);
+        return;
+    }
+
+    // this is cleared before listing the backlog, so that an envelope that is
+    // written in the meantime sets it again
+    sentry__atomic_store(&state->has_backlog, 0);
+    sentry_path_t *batch[OFFLINE_BATCH_SIZE];
+    size_t batch_len = collect_batch(state->backlog_path, batch);
+    bool has_more = batch_len == OFFLINE_BATCH_SIZE;
+    size_t uploaded = 0;
+    for (size_t i = 0; i < batch_len; i++) {
+        if (sentry__atomic_fetch(&g_offline)) {
+            has_more = true;
+        } else {
+            // the envelope is read into memory, so that its file can be
+            // removed while it is queued
+            size_t buf_len = 0;
+            char *buf = sentry__path_read_to_buffer(batch[i], &buf_len);
+            sentry_envelope_t *envelope
+                = buf ? sentry__envelope_from_buffer(buf, buf_len) : NULL;
+            sentry_free(buf);
+            sentry__path_remove(batch[i]);
+            if (envelope) {
+                sentry__transport_send_envelope(options->transport, envelope);
+                uploaded++;
+            }
+        }
+        sentry__path_free(batch[i]);
+    }
+    if (has_more) {
+        sentry__atomic_store(&state->has_backlog, 1);
+    }
+    if (sentry__atomic_fetch(&state->has_backlog)) {
+        schedule_upload(state, OFFLINE_BATCH_INTERVAL_MS);
+    }
+    if (uploaded) {
+        SENTRY_DEBUGF(
+            "uploading %zu envelopes of the offline backlog", uploaded);
+    }
+}
+
+static void
+probe_connectivity_task(void *task_data, void *UNUSED(state))
+{
+    const offline_state_t *state = (const offline_state_t *)task_data;
+    const sentry_options_t *options = state->options;
+    sentry_set_offline(
+        !options->connectivity_probe_func(options->connectivity_probe_data));
+}
+
+void
+sentry__offline_start(sentry_options_t *options)
+{
+    sentry_path_t *backlog_path = sentry__path_join_str(
+        options->database_path, SENTRY_OFFLINE_BACKLOG_DIR);
+    offline_state_t *state
+        = backlog_path ? SENTRY_MAKE(offline_state_t) : NULL;
+    if (!state) {
+        sentry__path_free(backlog_path);
+        return;
+    }
+    memset(state, 0, sizeof(offline_state_t));
+    state->options = sentry__options_incref(options);
+    state->backlog_path = backlog_path;
+    // earlier runs may have left a backlog
+    state->has_backlog = !backlog_is_empty(backlog_path);
+
+    sentry__mutex_lock(&g_offline_lock);
+    g_offline_state = state;
+    if (options->connectivity_probe_func && start_worker(state)
+        && (sentry__bgworker_submit(
+                state->worker, probe_connectivity_task, NULL, state)
+                != 0
+            || sentry__bgworker_submit_periodic(state->worker,
+                   probe_connectivity_task, NULL, state,
+                   options->connectivity_probe_interval, NULL)
+                != 0)) {
+        SENTRY_WARN("failed to start calling the connectivity probe");
+    }
+    resume_upload(state);
+    sentry__mutex_unlock(&g_offline_lock);
+}
+
+void
+sentry__offline_stop(void)
+{
+    sentry__mutex_lock(&g_offline_lock);
+    offline_state_t *state = g_offline_state;
+    g_offline_state = NULL;
+    sentry__mutex_unlock(&g_offline_lock);
+    if (!state) {
+        return;
+    }
+    if (state->worker) {
+        if (sentry__bgworker_shutdown(
+                state->worker, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT)
+            != 0) {
+            // the worker may still use the state, so both are leaked
+            return;
+        }
+        sentry__bgworker_decref(state->worker);
+    }
+    free_offline_state(state);
+}
+
+void
+sentry__offline_reset_after_fork(void)
+{
+    sentry__mutex_init(&g_offline_lock);
+}
+
+bool
+sentry__offline_store_envelope(
+    const sentry_transport_t *transport, sentry_envelope_t *envelope)
+{
+    if (!envelope || !sentry__atomic_fetch(&g_offline)) {
+        return false;
+    }
+    bool stored = false;
+    sentry__mutex_lock(&g_offline_lock);
+    offline_state_t *state = g_offline_state;
+    if (state && transport && transport == state->options->transport
+        && state->options->run) {
+        stored = sentry__run_write_offline_envelope(
+            state->options->run, envelope);
+        if (stored) {
+            sentry__atomic_store(&state->has_backlog, 1);
+            // the SDK may have gone online while this was written
+            resume_upload(state);
+        }
+    }
+    sentry__mutex_unlock(&g_offline_lock);
+    if (stored) {
+        SENTRY_TRACE("wrote envelope to the offline backlog");
+        sentry_envelope_free(envelope);
+    }
+    return stored;
+}
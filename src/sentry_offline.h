@@ -0,0 +1,33 @@
+#ifndef SENTRY_OFFLINE_H_INCLUDED
+#define SENTRY_OFFLINE_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Starts uploading the offline backlog of the database of `options` while the
+ * SDK is online, and calling the connectivity probe. The worker that does this
+ * is only started once there is a backlog or a probe.
+ */
+void sentry__offline_start(sentry_options_t *options);
+
+/**
+ * Stops the worker, leaving the envelopes that were not uploaded yet in the
+ * backlog for the next start.
+ */
+void sentry__offline_stop(void);
+
+/**
+ * Reinitializes the lock of the offline backlog in the child of a `fork`,
+ * since another thread of the parent may have held it.
+ */
+void sentry__offline_reset_after_fork(void);
+
+/**
+ * Writes `envelope` into the offline backlog instead of sending it to
+ * `transport`, if the SDK is offline, and `transport` is the one of the SDK.
+ * Returns true if the envelope was written, which frees it.
+ */
+bool sentry__offline_store_envelope(
+    const sentry_transport_t *transport, sentry_envelope_t *envelope);
+
+#endif
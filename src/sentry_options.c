@@ -4,6 +4,8 @@
 #include "sentry_database.h"
 #include "sentry_logger.h"
 #include "sentry_path.h"
+#include "sentry_ratelimiter.h"
+#include "sentry_sampling.h"
 #include "sentry_string.h"
 #include "sentry_sync.h"
 #include "sentry_transport.h"
@@ -37,8 +39,18 @@ sentry_options_new(void)
         opts->environment = sentry__string_clone("production");
     }
     opts->max_breadcrumbs = SENTRY_BREADCRUMBS_MAX;
+    opts->transport_max_concurrent_requests = 1;
+    opts->transport_max_queue_size = SENTRY_TRANSPORT_MAX_QUEUE_SIZE;
+    opts->transport_connect_timeout = SENTRY_DEFAULT_TRANSPORT_CONNECT_TIMEOUT;
+    opts->transport_low_speed_limit = SENTRY_DEFAULT_TRANSPORT_LOW_SPEED_LIMIT;
+    opts->transport_low_speed_time = SENTRY_DEFAULT_TRANSPORT_LOW_SPEED_TIME;
+    opts->transport_tcp_nodelay = true;
+    opts->transport_tcp_keepalive = true;
     opts->user_consent = SENTRY_USER_CONSENT_UNKNOWN;
     opts->auto_session_tracking = true;
+    opts->session_persist_interval = SENTRY_DEFAULT_SESSION_PERSIST_INTERVAL;
+    opts->connectivity_probe_interval
+        = SENTRY_DEFAULT_CONNECTIVITY_PROBE_INTERVAL;
     opts->system_crash_reporter_enabled = false;
     opts->symbolize_stacktraces =
     // AIX doesn't have reliable debug IDs for server-side symbolication,
@@ -52,10 +64,16 @@ sentry_options_new(void)
     opts->backend = sentry__backend_new();
     opts->transport = sentry__transport_new_default();
     opts->sample_rate = 1.0;
+    opts->dedup_summary = true;
+    opts->max_event_size = SENTRY_DEFAULT_MAX_EVENT_SIZE;
     opts->refcount = 1;
     opts->shutdown_timeout = SENTRY_DEFAULT_SHUTDOWN_TIMEOUT;
+    opts->crash_memory_reserve = SENTRY_DEFAULT_CRASH_MEMORY_RESERVE;
+    opts->durability_interval = SENTRY_DEFAULT_DURABILITY_INTERVAL;
     opts->traces_sample_rate = 0.0;
     opts->max_spans = 0;
+    opts->profiling_interval = 10;
+    opts->metrics_max_memory = 1024 * 1024;
 
     return opts;
 }
@@ -83,6 +101,14 @@ sentry_options_free(sentry_options_t *opts)
         return;
     }
     sentry__dsn_decref(opts->dsn);
+    sentry_mirror_dsn_t *next_mirror = opts->mirror_dsns;
+    while (next_mirror) {
+        sentry_mirror_dsn_t *mirror = next_mirror;
+        next_mirror = mirror->next;
+
+        sentry__dsn_decref(mirror->dsn);
+        sentry_free(mirror);
+    }
     sentry_free(opts->release);
     sentry_free(opts->environment);
     sentry_free(opts->dist);
@@ -101,7 +127,29 @@ sentry_options_free(sentry_options_t *opts)
 
         sentry__attachment_free(attachment);
     }
+    sentry_minidump_module_t *next_module = opts->minidump_modules;
+    while (next_module) {
+        sentry_minidump_module_t *module = next_module;
+        next_module = module->next;
+
+        sentry_free(module->name);
+        sentry_free(module);
+    }
     sentry__run_free(opts->run);
+    sentry_value_decref(opts->event_header);
+    if (opts->throttle) {
+        for (size_t i = 0; i < SENTRY_RL_CATEGORY_COUNT; i++) {
+            sentry__token_bucket_cleanup(&opts->throttle[i]);
+        }
+        sentry_free(opts->throttle);
+    }
+    if (opts->level_samplers) {
+        for (size_t i = 0; i < SENTRY_LEVEL_COUNT; i++) {
+            sentry__rate_sampler_cleanup(&opts->level_samplers[i]);
+        }
+        sentry_free(opts->level_samplers);
+    }
+    sentry__sampler_cache_free(opts->traces_sampler_cache);
 
     sentry_free(opts);
 }
@@ -130,6 +178,21 @@ sentry_options_set_on_crash(
     opts->on_crash_data = data;
 }
 
+void
+sentry_options_set_connectivity_probe(sentry_options_t *opts,
+    sentry_connectivity_probe_function_t func, void *data)
+{
+    opts->connectivity_probe_func = func;
+    opts->connectivity_probe_data = data;
+}
+
+void
+sentry_options_set_connectivity_probe_interval(
+    sentry_options_t *opts, uint64_t interval_ms)
+{
+    opts->connectivity_probe_interval = interval_ms ? interval_ms : 1;
+}
+
 void
 sentry_options_set_dsn(sentry_options_t *opts, const char *raw_dsn)
 {
@@ -143,6 +206,25 @@ sentry_options_get_dsn(const sentry_options_t *opts)
     return opts->dsn ? opts->dsn->raw : NULL;
 }
 
+void
+sentry_options_add_mirror_dsn(sentry_options_t *opts, const char *raw_dsn)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new(raw_dsn);
+    if (!dsn || !dsn->is_valid) {
+        SENTRY_WARN("ignoring invalid mirror DSN");
+        sentry__dsn_decref(dsn);
+        return;
+    }
+    sentry_mirror_dsn_t *mirror = SENTRY_MAKE(sentry_mirror_dsn_t);
+    if (!mirror) {
+        sentry__dsn_decref(dsn);
+        return;
+    }
+    mirror->dsn = dsn;
+    mirror->next = opts->mirror_dsns;
+    opts->mirror_dsns = mirror;
+}
+
 void
 sentry_options_set_sample_rate(sentry_options_t *opts, double sample_rate)
 {
@@ -160,6 +242,99 @@ sentry_options_get_sample_rate(const sentry_options_t *opts)
     return opts->sample_rate;
 }
 
+void
+sentry_options_set_max_events_per_second(
+    sentry_options_t *opts, size_t max_events)
+{
+    opts->max_events_per_second = max_events;
+}
+
+size_t
+sentry_options_get_max_events_per_second(const sentry_options_t *opts)
+{
+    return opts->max_events_per_second;
+}
+
+void
+sentry_options_set_max_events_per_second_for_level(
+    sentry_options_t *opts, sentry_level_t level, size_t max_events)
+{
+    if (level >= SENTRY_LEVEL_DEBUG && level <= SENTRY_LEVEL_FATAL) {
+        opts->max_level_events_per_second[level - SENTRY_LEVEL_DEBUG]
+            = max_events;
+    }
+}
+
+size_t
+sentry_options_get_max_events_per_second_for_level(
+    const sentry_options_t *opts, sentry_level_t level)
+{
+    if (level >= SENTRY_LEVEL_DEBUG && level <= SENTRY_LEVEL_FATAL) {
+        return opts->max_level_events_per_second[level - SENTRY_LEVEL_DEBUG];
+    }
+    return 0;
+}
+
+void
+sentry_options_set_async_capture(sentry_options_t *opts, int val)
+{
+    opts->async_capture = !!val;
+}
+
+int
+sentry_options_get_async_capture(const sentry_options_t *opts)
+{
+    return opts->async_capture;
+}
+
+void
+sentry_options_set_reinit_after_fork(sentry_options_t *opts, int val)
+{
+    opts->reinit_after_fork = !!val;
+}
+
+int
+sentry_options_get_reinit_after_fork(const sentry_options_t *opts)
+{
+    return opts->reinit_after_fork;
+}
+
+void
+sentry_options_set_dedup_window(sentry_options_t *opts, uint64_t window_ms)
+{
+    opts->dedup_window = window_ms;
+}
+
+uint64_t
+sentry_options_get_dedup_window(const sentry_options_t *opts)
+{
+    return opts->dedup_window;
+}
+
+void
+sentry_options_set_dedup_summary(sentry_options_t *opts, int val)
+{
+    opts->dedup_summary = !!val;
+}
+
+int
+sentry_options_get_dedup_summary(const sentry_options_t *opts)
+{
+    return opts->dedup_summary;
+}
+
+void
+sentry_options_set_max_event_size(sentry_options_t *opts, size_t bytes)
+{
+    opts->max_event_size = bytes;
+}
+
+size_t
+sentry_options_get_max_event_size(const sentry_options_t *opts)
+{
+    return opts->max_event_size;
+}
+
 void
 sentry_options_set_release(sentry_options_t *opts, const char *release)
 {
@@ -239,6 +414,155 @@ sentry_options_get_transport_thread_name(const sentry_options_t *opts)
     return opts->transport_thread_name;
 }
 
+void
+sentry_options_set_transport_max_concurrent_requests(
+    sentry_options_t *opts, size_t max_requests)
+{
+    opts->transport_max_concurrent_requests = max_requests ? max_requests : 1;
+}
+
+size_t
+sentry_options_get_transport_max_concurrent_requests(
+    const sentry_options_t *opts)
+{
+    return opts->transport_max_concurrent_requests;
+}
+
+void
+sentry_options_set_transport_max_queue_size(
+    sentry_options_t *opts, size_t max_envelopes)
+{
+    opts->transport_max_queue_size = max_envelopes;
+}
+
+size_t
+sentry_options_get_transport_max_queue_size(const sentry_options_t *opts)
+{
+    return opts->transport_max_queue_size;
+}
+
+void
+sentry_options_set_transport_max_queue_bytes(
+    sentry_options_t *opts, size_t max_bytes)
+{
+    opts->transport_max_queue_bytes = max_bytes;
+}
+
+size_t
+sentry_options_get_transport_max_queue_bytes(const sentry_options_t *opts)
+{
+    return opts->transport_max_queue_bytes;
+}
+
+void
+sentry_options_set_transport_warmup(sentry_options_t *opts, int warmup)
+{
+    opts->transport_warmup = !!warmup;
+}
+
+int
+sentry_options_get_transport_warmup(const sentry_options_t *opts)
+{
+    return opts->transport_warmup;
+}
+
+void
+sentry_options_set_transport_connect_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms)
+{
+    opts->transport_connect_timeout = timeout_ms;
+}
+
+uint64_t
+sentry_options_get_transport_connect_timeout(const sentry_options_t *opts)
+{
+    return opts->transport_connect_timeout;
+}
+
+void
+sentry_options_set_transport_request_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms)
+{
+    opts->transport_request_timeout = timeout_ms;
+}
+
+uint64_t
+sentry_options_get_transport_request_timeout(const sentry_options_t *opts)
+{
+    return opts->transport_request_timeout;
+}
+
+void
+sentry_options_set_transport_low_speed_limit(
+    sentry_options_t *opts, size_t bytes_per_second, uint64_t duration_ms)
+{
+    opts->transport_low_speed_limit = bytes_per_second;
+    opts->transport_low_speed_time = duration_ms;
+}
+
+size_t
+sentry_options_get_transport_low_speed_limit(const sentry_options_t *opts)
+{
+    return opts->transport_low_speed_limit;
+}
+
+uint64_t
+sentry_options_get_transport_low_speed_time(const sentry_options_t *opts)
+{
+    return opts->transport_low_speed_time;
+}
+
+void
+sentry_options_set_transport_tcp_nodelay(sentry_options_t *opts, int val)
+{
+    opts->transport_tcp_nodelay = !!val;
+}
+
+int
+sentry_options_get_transport_tcp_nodelay(const sentry_options_t *opts)
+{
+    return opts->transport_tcp_nodelay;
+}
+
+void
+sentry_options_set_transport_tcp_keepalive(sentry_options_t *opts, int val)
+{
+    opts->transport_tcp_keepalive = !!val;
+}
+
+int
+sentry_options_get_transport_tcp_keepalive(const sentry_options_t *opts)
+{
+    return opts->transport_tcp_keepalive;
+}
+
+void
+sentry_options_set_transport_ip_resolve(
+    sentry_options_t *opts, sentry_ip_resolve_t ip_resolve)
+{
+    opts->transport_ip_resolve = ip_resolve;
+}
+
+sentry_ip_resolve_t
+sentry_options_get_transport_ip_resolve(const sentry_options_t *opts)
+{
+    return opts->transport_ip_resolve;
+}
+
+void
+sentry_options_set_transport_happy_eyeballs_timeout(
+    sentry_options_t *opts, uint64_t timeout_ms)
+{
+    opts->transport_happy_eyeballs_timeout = timeout_ms;
+}
+
+uint64_t
+sentry_options_get_transport_happy_eyeballs_timeout(
+    const sentry_options_t *opts)
+{
+    return opts->transport_happy_eyeballs_timeout;
+}
+
 void
 sentry_options_set_debug(sentry_options_t *opts, int debug)
 {
@@ -264,6 +588,32 @@ sentry_options_get_max_breadcrumbs(const sentry_options_t *opts)
     return opts->max_breadcrumbs;
 }
 
+void
+sentry_options_set_qt_buffered_breadcrumbs(
+    sentry_options_t *opts, int buffered)
+{
+    opts->qt_buffered_breadcrumbs = !!buffered;
+}
+
+int
+sentry_options_get_qt_buffered_breadcrumbs(const sentry_options_t *opts)
+{
+    return opts->qt_buffered_breadcrumbs;
+}
+
+void
+sentry_options_set_crash_memory_reserve(
+    sentry_options_t *opts, size_t reserve_size)
+{
+    opts->crash_memory_reserve = reserve_size;
+}
+
+size_t
+sentry_options_get_crash_memory_reserve(const sentry_options_t *opts)
+{
+    return opts->crash_memory_reserve;
+}
+
 void
 sentry_options_set_logger(
     sentry_options_t *opts, sentry_logger_function_t func, void *userdata)
@@ -272,6 +622,18 @@ sentry_options_set_logger(
     opts->logger.logger_data = userdata;
 }
 
+void
+sentry_options_set_logger_async(sentry_options_t *opts, int async)
+{
+    opts->logger_async = !!async;
+}
+
+int
+sentry_options_get_logger_async(const sentry_options_t *opts)
+{
+    return opts->logger_async;
+}
+
 void
 sentry_options_set_auto_session_tracking(sentry_options_t *opts, int val)
 {
@@ -284,6 +646,32 @@ sentry_options_get_auto_session_tracking(const sentry_options_t *opts)
     return opts->auto_session_tracking;
 }
 
+void
+sentry_options_set_session_persist_interval(
+    sentry_options_t *opts, uint64_t interval_ms)
+{
+    opts->session_persist_interval = interval_ms;
+}
+
+uint64_t
+sentry_options_get_session_persist_interval(const sentry_options_t *opts)
+{
+    return opts->session_persist_interval;
+}
+
+void
+sentry_options_set_session_mode(
+    sentry_options_t *opts, sentry_session_mode_t mode)
+{
+    opts->session_mode = mode;
+}
+
+sentry_session_mode_t
+sentry_options_get_session_mode(const sentry_options_t *opts)
+{
+    return opts->session_mode;
+}
+
 void
 sentry_options_set_require_user_consent(sentry_options_t *opts, int val)
 {
@@ -308,6 +696,54 @@ sentry_options_get_symbolize_stacktraces(const sentry_options_t *opts)
     return opts->symbolize_stacktraces;
 }
 
+void
+sentry_options_set_only_referenced_images(sentry_options_t *opts, int val)
+{
+    opts->only_referenced_images = !!val;
+}
+
+int
+sentry_options_get_only_referenced_images(const sentry_options_t *opts)
+{
+    return opts->only_referenced_images;
+}
+
+void
+sentry_options_set_precomputed_crash_event(sentry_options_t *opts, int val)
+{
+    opts->precomputed_crash_event = !!val;
+}
+
+int
+sentry_options_get_precomputed_crash_event(const sentry_options_t *opts)
+{
+    return opts->precomputed_crash_event;
+}
+
+void
+sentry_options_set_capture_all_threads(sentry_options_t *opts, int val)
+{
+    opts->capture_all_threads = !!val;
+}
+
+int
+sentry_options_get_capture_all_threads(const sentry_options_t *opts)
+{
+    return opts->capture_all_threads;
+}
+
+void
+sentry_options_set_app_hang_timeout(sentry_options_t *opts, uint64_t timeout)
+{
+    opts->app_hang_timeout = timeout;
+}
+
+uint64_t
+sentry_options_get_app_hang_timeout(const sentry_options_t *opts)
+{
+    return opts->app_hang_timeout;
+}
+
 void
 sentry_options_set_system_crash_reporter_enabled(
     sentry_options_t *opts, int enabled)
@@ -328,8 +764,65 @@ sentry_options_get_shutdown_timeout(sentry_options_t *opts)
     return opts->shutdown_timeout;
 }
 
+void
+sentry_options_set_scope_flush_delay(sentry_options_t *opts, uint64_t delay_ms)
+{
+    opts->scope_flush_delay = delay_ms;
+}
+
+uint64_t
+sentry_options_get_scope_flush_delay(sentry_options_t *opts)
+{
+    return opts->scope_flush_delay;
+}
+
+void
+sentry_options_set_minidump_mode(
+    sentry_options_t *opts, sentry_minidump_mode_t mode)
+{
+    opts->minidump_mode = mode;
+}
+
+sentry_minidump_mode_t
+sentry_options_get_minidump_mode(const sentry_options_t *opts)
+{
+    return opts->minidump_mode;
+}
+
+void
+sentry_options_add_minidump_module(
+    sentry_options_t *opts, const char *module_name)
+{
+    if (!module_name) {
+        return;
+    }
+    sentry_minidump_module_t *module = SENTRY_MAKE(sentry_minidump_module_t);
+    if (!module) {
+        return;
+    }
+    module->name = sentry__string_clone(module_name);
+    if (!module->name) {
+        sentry_free(module);
+        return;
+    }
+    module->next = opts->minidump_modules;
+    opts->minidump_modules = module;
+}
+
+void
+sentry_options_set_minidump_max_size(sentry_options_t *opts, size_t max_size)
+{
+    opts->minidump_max_size = max_size;
+}
+
+size_t
+sentry_options_get_minidump_max_size(const sentry_options_t *opts)
+{
+    return opts->minidump_max_size;
+}
+
 static void
-add_attachment(sentry_options_t *opts, sentry_path_t *path)
+add_attachment(sentry_options_t *opts, sentry_path_t *path, int flags)
 {
     if (!path) {
         return;
@@ -340,6 +833,7 @@ add_attachment(sentry_options_t *opts, sentry_path_t *path)
         return;
     }
     attachment->path = path;
+    attachment->flags = flags;
     attachment->next = opts->attachments;
     opts->attachments = attachment;
 }
@@ -347,7 +841,14 @@ add_attachment(sentry_options_t *opts, sentry_path_t *path)
 void
 sentry_options_add_attachment(sentry_options_t *opts, const char *path)
 {
-    add_attachment(opts, sentry__path_from_str(path));
+    add_attachment(opts, sentry__path_from_str(path), 0);
+}
+
+void
+sentry_options_add_attachment_with_flags(
+    sentry_options_t *opts, const char *path, int flags)
+{
+    add_attachment(opts, sentry__path_from_str(path), flags);
 }
 
 void
@@ -364,11 +865,81 @@ sentry_options_set_database_path(sentry_options_t *opts, const char *path)
     opts->database_path = sentry__path_from_str(path);
 }
 
+void
+sentry_options_set_max_database_size(sentry_options_t *opts, size_t max_size)
+{
+    opts->max_database_size = max_size;
+}
+
+size_t
+sentry_options_get_max_database_size(const sentry_options_t *opts)
+{
+    return opts->max_database_size;
+}
+
+void
+sentry_options_set_max_database_envelopes(
+    sentry_options_t *opts, size_t max_envelopes)
+{
+    opts->max_database_envelopes = max_envelopes;
+}
+
+size_t
+sentry_options_get_max_database_envelopes(const sentry_options_t *opts)
+{
+    return opts->max_database_envelopes;
+}
+
+void
+sentry_options_set_durability(
+    sentry_options_t *opts, sentry_durability_t durability)
+{
+    opts->durability = durability;
+}
+
+sentry_durability_t
+sentry_options_get_durability(const sentry_options_t *opts)
+{
+    return opts->durability;
+}
+
+void
+sentry_options_set_durability_interval(
+    sentry_options_t *opts, uint64_t interval_ms)
+{
+    opts->durability_interval = interval_ms;
+}
+
+uint64_t
+sentry_options_get_durability_interval(const sentry_options_t *opts)
+{
+    return opts->durability_interval;
+}
+
+void
+sentry_options_set_run_journal(sentry_options_t *opts, int enabled)
+{
+    opts->run_journal = !!enabled;
+}
+
+int
+sentry_options_get_run_journal(const sentry_options_t *opts)
+{
+    return opts->run_journal;
+}
+
 #ifdef SENTRY_PLATFORM_WINDOWS
 void
 sentry_options_add_attachmentw(sentry_options_t *opts, const wchar_t *path)
 {
-    add_attachment(opts, sentry__path_from_wstr(path));
+    add_attachment(opts, sentry__path_from_wstr(path), 0);
+}
+
+void
+sentry_options_add_attachment_with_flagsw(
+    sentry_options_t *opts, const wchar_t *path, int flags)
+{
+    add_attachment(opts, sentry__path_from_wstr(path), flags);
 }
 
 void
@@ -437,6 +1008,123 @@ sentry_options_get_traces_sample_rate(sentry_options_t *opts)
     return opts->traces_sample_rate;
 }
 
+void
+sentry_options_set_traces_sampler(sentry_options_t *opts,
+    sentry_traces_sampler_function_t func, void *user_data)
+{
+    opts->traces_sampler = func;
+    opts->traces_sampler_data = user_data;
+
+    if (func && opts->max_spans == 0) {
+        opts->max_spans = SENTRY_SPANS_MAX;
+    }
+}
+
+void
+sentry_options_set_traces_sampler_cache_ttl(
+    sentry_options_t *opts, uint64_t ttl_ms)
+{
+    opts->traces_sampler_cache_ttl = ttl_ms;
+}
+
+uint64_t
+sentry_options_get_traces_sampler_cache_ttl(const sentry_options_t *opts)
+{
+    return opts->traces_sampler_cache_ttl;
+}
+
+void
+sentry_options_set_span_chunk_size(sentry_options_t *opts, size_t span_count)
+{
+    opts->span_chunk_size = span_count;
+}
+
+size_t
+sentry_options_get_span_chunk_size(const sentry_options_t *opts)
+{
+    return opts->span_chunk_size;
+}
+
+void
+sentry_options_set_span_chunk_max_bytes(sentry_options_t *opts, size_t bytes)
+{
+    opts->span_chunk_max_bytes = bytes;
+}
+
+size_t
+sentry_options_get_span_chunk_max_bytes(const sentry_options_t *opts)
+{
+    return opts->span_chunk_max_bytes;
+}
+
+void
+sentry_options_set_profiles_sample_rate(
+    sentry_options_t *opts, double sample_rate)
+{
+    if (sample_rate < 0.0) {
+        sample_rate = 0.0;
+    } else if (sample_rate > 1.0) {
+        sample_rate = 1.0;
+    }
+    opts->profiles_sample_rate = sample_rate;
+}
+
+double
+sentry_options_get_profiles_sample_rate(const sentry_options_t *opts)
+{
+    return opts->profiles_sample_rate;
+}
+
+void
+sentry_options_set_profiling_interval(
+    sentry_options_t *opts, uint64_t interval_ms)
+{
+    opts->profiling_interval = interval_ms;
+}
+
+uint64_t
+sentry_options_get_profiling_interval(const sentry_options_t *opts)
+{
+    return opts->profiling_interval;
+}
+
+void
+sentry_options_set_enable_metrics(sentry_options_t *opts, int enable_metrics)
+{
+    opts->enable_metrics = !!enable_metrics;
+}
+
+int
+sentry_options_get_enable_metrics(const sentry_options_t *opts)
+{
+    return opts->enable_metrics;
+}
+
+void
+sentry_options_set_metrics_max_memory(sentry_options_t *opts, size_t bytes)
+{
+    opts->metrics_max_memory = bytes;
+}
+
+size_t
+sentry_options_get_metrics_max_memory(const sentry_options_t *opts)
+{
+    return opts->metrics_max_memory;
+}
+
+void
+sentry_options_set_max_transactions_per_second(
+    sentry_options_t *opts, size_t max_transactions)
+{
+    opts->max_transactions_per_second = max_transactions;
+}
+
+size_t
+sentry_options_get_max_transactions_per_second(const sentry_options_t *opts)
+{
+    return opts->max_transactions_per_second;
+}
+
 void
 sentry_options_set_backend(sentry_options_t *opts, sentry_backend_t *backend)
 {
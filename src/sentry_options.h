@@ -11,8 +11,30 @@
 // https://docs.sentry.io/error-reporting/configuration/?platform=native#shutdown-timeout
 #define SENTRY_DEFAULT_SHUTDOWN_TIMEOUT 2000
 
+// handling a typical crash takes around 100KiB
+#define SENTRY_DEFAULT_CRASH_MEMORY_RESERVE (256 * 1024)
+
+#define SENTRY_DEFAULT_DURABILITY_INTERVAL 1000
+
+#define SENTRY_DEFAULT_SESSION_PERSIST_INTERVAL 5000
+
+#define SENTRY_DEFAULT_CONNECTIVITY_PROBE_INTERVAL 30000
+
+#define SENTRY_DEFAULT_TRANSPORT_CONNECT_TIMEOUT 10000
+// requests slower than 1 byte per second for 30 seconds are aborted
+#define SENTRY_DEFAULT_TRANSPORT_LOW_SPEED_LIMIT 1
+#define SENTRY_DEFAULT_TRANSPORT_LOW_SPEED_TIME 30000
+
+// the server rejects larger events
+#define SENTRY_DEFAULT_MAX_EVENT_SIZE (1024 * 1024)
+
+// the number of levels, from `SENTRY_LEVEL_DEBUG` to `SENTRY_LEVEL_FATAL`
+#define SENTRY_LEVEL_COUNT (SENTRY_LEVEL_FATAL - SENTRY_LEVEL_DEBUG + 1)
+
 typedef struct sentry_path_s sentry_path_t;
 typedef struct sentry_run_s sentry_run_t;
+typedef struct sentry_token_bucket_s sentry_token_bucket_t;
+typedef struct sentry_rate_sampler_s sentry_rate_sampler_t;
 struct sentry_backend_s;
 
 /**
@@ -22,9 +44,30 @@ struct sentry_backend_s;
 typedef struct sentry_attachment_s sentry_attachment_t;
 struct sentry_attachment_s {
     sentry_path_t *path;
+    // the `SENTRY_ATTACHMENT_*` flags
+    int flags;
     sentry_attachment_t *next;
 };
 
+/**
+ * This is a linked list of the module names registered via
+ * `sentry_options_add_minidump_module`.
+ */
+typedef struct sentry_minidump_module_s sentry_minidump_module_t;
+struct sentry_minidump_module_s {
+    char *name;
+    sentry_minidump_module_t *next;
+};
+
+/**
+ * This is a linked list of the DSNs added via `sentry_options_add_mirror_dsn`.
+ */
+typedef struct sentry_mirror_dsn_s sentry_mirror_dsn_t;
+struct sentry_mirror_dsn_s {
+    sentry_dsn_t *dsn;
+    sentry_mirror_dsn_t *next;
+};
+
 /**
  * This is the main options struct, which is being accessed throughout all of
  * the sentry internals.
@@ -32,6 +75,7 @@ struct sentry_attachment_s {
 typedef struct sentry_options_s {
     double sample_rate;
     sentry_dsn_t *dsn;
+    sentry_mirror_dsn_t *mirror_dsns;
     char *release;
     char *environment;
     char *dist;
@@ -41,14 +85,52 @@ typedef struct sentry_options_s {
     sentry_path_t *database_path;
     sentry_path_t *handler_path;
     sentry_logger_t logger;
+    bool logger_async;
     size_t max_breadcrumbs;
+    bool qt_buffered_breadcrumbs;
+    size_t max_events_per_second;
+    // indexed by the level, starting at `SENTRY_LEVEL_DEBUG`
+    size_t max_level_events_per_second[SENTRY_LEVEL_COUNT];
+    bool async_capture;
+    bool reinit_after_fork;
+    uint64_t dedup_window;
+    bool dedup_summary;
+    size_t max_event_size;
+    size_t transport_max_concurrent_requests;
+    size_t transport_max_queue_size;
+    size_t transport_max_queue_bytes;
+    size_t crash_memory_reserve;
+    bool transport_warmup;
+    uint64_t transport_connect_timeout;
+    uint64_t transport_request_timeout;
+    size_t transport_low_speed_limit;
+    uint64_t transport_low_speed_time;
+    bool transport_tcp_nodelay;
+    bool transport_tcp_keepalive;
+    sentry_ip_resolve_t transport_ip_resolve;
+    uint64_t transport_happy_eyeballs_timeout;
     bool debug;
     bool auto_session_tracking;
+    uint64_t session_persist_interval;
+    sentry_session_mode_t session_mode;
     bool require_user_consent;
     bool symbolize_stacktraces;
+    bool only_referenced_images;
+    bool precomputed_crash_event;
+    bool capture_all_threads;
+    uint64_t app_hang_timeout;
     bool system_crash_reporter_enabled;
+    uint64_t scope_flush_delay;
+    sentry_minidump_mode_t minidump_mode;
+    size_t minidump_max_size;
+    size_t max_database_size;
+    size_t max_database_envelopes;
+    bool run_journal;
+    sentry_durability_t durability;
+    uint64_t durability_interval;
 
     sentry_attachment_t *attachments;
+    sentry_minidump_module_t *minidump_modules;
     sentry_run_t *run;
 
     sentry_transport_t *transport;
@@ -56,15 +138,41 @@ typedef struct sentry_options_s {
     void *before_send_data;
     sentry_crash_function_t on_crash_func;
     void *on_crash_data;
+    sentry_connectivity_probe_function_t connectivity_probe_func;
+    void *connectivity_probe_data;
+    uint64_t connectivity_probe_interval;
 
     /* Experimentally exposed */
     double traces_sample_rate;
+    sentry_traces_sampler_function_t traces_sampler;
+    void *traces_sampler_data;
+    uint64_t traces_sampler_cache_ttl;
     size_t max_spans;
+    size_t span_chunk_size;
+    size_t span_chunk_max_bytes;
+    double profiles_sample_rate;
+    uint64_t profiling_interval;
+    bool enable_metrics;
+    size_t metrics_max_memory;
+    size_t max_transactions_per_second;
 
     /* everything from here on down are options which are stored here but
        not exposed through the options API */
     struct sentry_backend_s *backend;
     sentry_session_t *session;
+    // whether `session` changed since it was last written to disk
+    bool session_dirty;
+    // the client side throttling of every rate limiting category, which is
+    // set up by `sentry_init`
+    sentry_token_bucket_t *throttle;
+    // the adaptive sampling of every level, which is set up by `sentry_init`
+    sentry_rate_sampler_t *level_samplers;
+    // the sample rates of the `traces_sampler`, which is set up by
+    // `sentry_init` if they should be cached
+    struct sentry_sampler_cache_s *traces_sampler_cache;
+    // the members shared by every event, see
+    // `sentry__scope_new_event_header`, which is set up by `sentry_init`
+    sentry_value_t event_header;
 
     long user_consent;
     long refcount;
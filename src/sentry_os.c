@@ -1,6 +1,9 @@
 #include "sentry_os.h"
+#include "sentry_path.h"
 #include "sentry_string.h"
+#include "sentry_sync.h"
 #include "sentry_utils.h"
+#include "sentry_value.h"
 
 #ifdef SENTRY_PLATFORM_WINDOWS
 
@@ -226,3 +229,133 @@ sentry__get_os_context(void)
 }
 
 #endif
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+
+static void
+set_device_resources(sentry_value_t device)
+{
+    SYSTEM_INFO info;
+    GetNativeSystemInfo(&info);
+    sentry_value_set_by_key(device, "processor_count",
+        sentry_value_new_int32((int32_t)info.dwNumberOfProcessors));
+
+    MEMORYSTATUSEX memory;
+    memory.dwLength = sizeof(memory);
+    if (GlobalMemoryStatusEx(&memory)) {
+        sentry_value_set_by_key(device, "memory_size",
+            sentry_value_new_uint64(memory.ullTotalPhys));
+    }
+}
+
+#elif defined(SENTRY_PLATFORM_DARWIN)
+
+#    include <sys/sysctl.h>
+
+static void
+set_device_resources(sentry_value_t device)
+{
+    int processor_count = 0;
+    size_t len = sizeof(processor_count);
+    if (sysctlbyname("hw.logicalcpu", &processor_count, &len, NULL, 0) == 0) {
+        sentry_value_set_by_key(device, "processor_count",
+            sentry_value_new_int32((int32_t)processor_count));
+    }
+
+    uint64_t memory_size = 0;
+    len = sizeof(memory_size);
+    if (sysctlbyname("hw.memsize", &memory_size, &len, NULL, 0) == 0) {
+        sentry_value_set_by_key(
+            device, "memory_size", sentry_value_new_uint64(memory_size));
+    }
+}
+
+#elif defined(SENTRY_PLATFORM_UNIX)
+
+#    include <unistd.h>
+
+static void
+set_device_resources(sentry_value_t device)
+{
+    long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processor_count > 0) {
+        sentry_value_set_by_key(device, "processor_count",
+            sentry_value_new_int32((int32_t)processor_count));
+    }
+#    ifdef _SC_PHYS_PAGES
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) {
+        sentry_value_set_by_key(device, "memory_size",
+            sentry_value_new_uint64((uint64_t)pages * (uint64_t)page_size));
+    }
+#    endif
+}
+
+#else
+
+static void
+set_device_resources(sentry_value_t UNUSED(device))
+{
+}
+
+#endif
+
+static sentry_value_t
+get_device_context(void)
+{
+    sentry_value_t device = sentry_value_new_object();
+    sentry_value_set_by_key(
+        device, "arch", sentry_value_new_string(SENTRY_CPU_ARCHITECTURE));
+    set_device_resources(device);
+    return device;
+}
+
+static sentry_value_t
+get_app_context(void)
+{
+    sentry_value_t app = sentry_value_new_object();
+    sentry_path_t *exe = sentry__path_current_exe();
+    if (exe) {
+        sentry_value_set_by_key(app, "app_name",
+            sentry_value_new_string(sentry__path_filename_str(exe)));
+        sentry__path_free(exe);
+    }
+    return app;
+}
+
+static sentry_mutex_t g_system_contexts_lock = SENTRY__MUTEX_INIT;
+static sentry_value_t g_system_contexts = { 0 };
+
+sentry_value_t
+sentry__get_system_contexts(void)
+{
+    sentry__mutex_lock(&g_system_contexts_lock);
+    if (!g_system_contexts._bits) {
+        // the contexts outlive whatever arena the caller may have entered
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
+        sentry_value_t contexts = sentry_value_new_object();
+        sentry_value_t os = sentry__get_os_context();
+        if (!sentry_value_is_null(os)) {
+            sentry_value_set_by_key(contexts, "os", os);
+        }
+        sentry_value_set_by_key(contexts, "device", get_device_context());
+        sentry_value_set_by_key(contexts, "app", get_app_context());
+        sentry__value_arena_leave(prev_arena);
+        sentry_value_freeze(contexts);
+        g_system_contexts = contexts;
+    }
+    sentry_value_t rv = g_system_contexts;
+    sentry_value_incref(rv);
+    sentry__mutex_unlock(&g_system_contexts_lock);
+    return rv;
+}
+
+void
+sentry__system_contexts_cleanup(void)
+{
+    sentry__mutex_lock(&g_system_contexts_lock);
+    sentry_value_decref(g_system_contexts);
+    g_system_contexts._bits = 0;
+    sentry__mutex_unlock(&g_system_contexts_lock);
+}
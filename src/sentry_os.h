@@ -3,6 +3,35 @@
 
 #include "sentry_boot.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#    define SENTRY_CPU_ARCHITECTURE "x86_64"
+#elif defined(__i386__) || defined(_M_IX86)
+#    define SENTRY_CPU_ARCHITECTURE "x86"
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define SENTRY_CPU_ARCHITECTURE "arm64"
+#elif defined(__arm__) || defined(_M_ARM)
+#    define SENTRY_CPU_ARCHITECTURE "arm"
+#else
+#    define SENTRY_CPU_ARCHITECTURE "unknown"
+#endif
+
+/**
+ * Queries the OS context, which describes the name and version of the
+ * operating system.
+ */
 sentry_value_t sentry__get_os_context(void);
 
+/**
+ * Returns a frozen Object with the `os`, `device` and `app` contexts, which
+ * is computed on first use and shared by all callers afterwards, until
+ * `sentry__system_contexts_cleanup` is called. Concurrent callers wait for
+ * the first one to compute it.
+ */
+sentry_value_t sentry__get_system_contexts(void);
+
+/**
+ * Drops the cached system contexts.
+ */
+void sentry__system_contexts_cleanup(void);
+
 #endif
@@ -15,6 +15,20 @@ typedef char sentry_pathchar_t;
 
 struct sentry_path_s {
     sentry_pathchar_t *path;
+#ifdef SENTRY_PLATFORM_WINDOWS
+    // the UTF-8 encoding of `path`, which `sentry__path_str` creates on first
+    // use
+    char *volatile path_str;
+    // the attributes that a directory iterator found along with the path, or
+    // `INVALID_FILE_ATTRIBUTES`
+    DWORD attributes;
+#else
+    // the open directory that a directory iterator found the path in, which
+    // the file operations resolve the filename against, or -1
+    int dir_fd;
+    // the `d_type` of the directory entry, or 0 if it is not known
+    unsigned char d_type;
+#endif
 };
 
 struct sentry_filelock_s {
@@ -26,6 +40,16 @@ struct sentry_filelock_s {
 typedef struct sentry_path_s sentry_path_t;
 typedef struct sentry_pathiter_s sentry_pathiter_t;
 typedef struct sentry_filelock_s sentry_filelock_t;
+typedef struct sentry_filewriter_s sentry_filewriter_t;
+typedef struct sentry_filereader_s sentry_filereader_t;
+
+/**
+ * A memory mapping of a complete file.
+ */
+typedef struct {
+    void *ptr;
+    size_t len;
+} sentry_mmap_t;
 
 /**
  * NOTE on encodings:
@@ -90,6 +114,19 @@ void sentry__path_free(sentry_path_t *path);
  */
 const sentry_pathchar_t *sentry__path_filename(const sentry_path_t *path);
 
+/**
+ * Returns the path as a UTF-8 string, which is borrowed from `path`. On
+ * Windows, the wide path is converted on the first call only, and the result
+ * is kept along with the path until it is freed.
+ */
+const char *sentry__path_str(const sentry_path_t *path);
+
+/**
+ * Returns the last path segment like `sentry__path_filename`, as a UTF-8
+ * string that is borrowed from `path`, see `sentry__path_str`.
+ */
+const char *sentry__path_filename_str(const sentry_path_t *path);
+
 /**
  * Returns whether the last path segment matches `filename`.
  */
@@ -119,6 +156,23 @@ bool sentry__path_is_file(const sentry_path_t *path);
  */
 int sentry__path_remove(const sentry_path_t *path);
 
+/**
+ * Renames the file referred to by `src` to `dst`, replacing any existing file
+ * at `dst`. This does not allocate, and is safe to use within a signal handler.
+ * Returns 0 on success.
+ */
+int sentry__path_rename(const sentry_path_t *src, const sentry_path_t *dst);
+
+/**
+ * This flushes the content of the file at `path` to stable storage. For a
+ * directory, this flushes its entries, so that files which were created,
+ * renamed or removed within it survive a power loss. Directories can not be
+ * flushed on windows, which succeeds without doing anything.
+ *
+ * Returns 0 on success.
+ */
+int sentry__path_sync(const sentry_path_t *path);
+
 /**
  * Recursively remove the given directory and everything in it.
  * Returns 0 on success.
@@ -149,6 +203,40 @@ size_t sentry__path_get_size(const sentry_path_t *path);
  */
 char *sentry__path_read_to_buffer(const sentry_path_t *path, size_t *size_out);
 
+/**
+ * This will map the complete content of the non-empty file at `path` into
+ * memory, read-only. The mapping stays valid even when the file is removed,
+ * and needs to be released with `sentry__mmap_close`.
+ * Returns `false` and leaves `rv` empty on failure.
+ */
+bool sentry__path_mmap(sentry_mmap_t *rv, const sentry_path_t *path);
+
+/**
+ * This will create or truncate the file at `path` to `len` zeroed bytes, and
+ * map it into memory, writable and shared with the file. Writes to the
+ * mapping thus end up in the file even if the process crashes. The mapping
+ * needs to be released with `sentry__mmap_close`.
+ * Returns `false` and leaves `rv` empty on failure.
+ */
+bool sentry__path_mmap_shared(
+    sentry_mmap_t *rv, const sentry_path_t *path, size_t len);
+
+/**
+ * This will map the complete content of the existing, non-empty file at
+ * `path` into memory, writable and shared with the file and every other
+ * process that maps it. The mapping needs to be released with
+ * `sentry__mmap_close`.
+ * Returns `false` and leaves `rv` empty on failure.
+ */
+bool sentry__path_mmap_existing_shared(
+    sentry_mmap_t *rv, const sentry_path_t *path);
+
+/**
+ * This will release a mapping created by `sentry__path_mmap`,
+ * `sentry__path_mmap_shared` or `sentry__path_mmap_existing_shared`.
+ */
+void sentry__mmap_close(sentry_mmap_t *m);
+
 /**
  * This will truncate the given file and write the given `buf` into it.
  */
@@ -161,6 +249,62 @@ int sentry__path_write_buffer(
 int sentry__path_append_buffer(
     const sentry_path_t *path, const char *buf, size_t buf_len);
 
+/**
+ * This will truncate the given file and open it for writing. The file can then
+ * be written to in multiple steps using `sentry__filewriter_write`.
+ */
+sentry_filewriter_t *sentry__filewriter_new(const sentry_path_t *path);
+
+/**
+ * Like `sentry__filewriter_new`, but keeps the existing content of the file,
+ * and appends to it.
+ */
+sentry_filewriter_t *sentry__filewriter_new_append(const sentry_path_t *path);
+
+/**
+ * This will append `buf` to the file opened by `sentry__filewriter_new`.
+ *
+ * Returns 0 on success.
+ */
+int sentry__filewriter_write(
+    sentry_filewriter_t *fw, const char *buf, size_t buf_len);
+
+/**
+ * This will close the file and free the writer.
+ *
+ * Returns 0 if all the writes were successful.
+ */
+int sentry__filewriter_close(sentry_filewriter_t *fw);
+
+/**
+ * This will open the given file for reading. The file can then be read in
+ * multiple steps using `sentry__filereader_read`.
+ */
+sentry_filereader_t *sentry__filereader_new(const sentry_path_t *path);
+
+/**
+ * This will read up to `buf_len` bytes from the file opened by
+ * `sentry__filereader_new` into `buf`.
+ *
+ * Returns the number of bytes read, which is less than `buf_len` only at the
+ * end of the file or on failure.
+ */
+size_t sentry__filereader_read(
+    sentry_filereader_t *fr, char *buf, size_t buf_len);
+
+/**
+ * This will move the position of the reader to `offset` bytes from the start
+ * of the file, from where the next `sentry__filereader_read` continues.
+ *
+ * Returns 0 on success.
+ */
+int sentry__filereader_seek(sentry_filereader_t *fr, uint64_t offset);
+
+/**
+ * This will close the file and free the reader.
+ */
+void sentry__filereader_close(sentry_filereader_t *fr);
+
 /**
  * Create a new directory iterator for `path`.
  */
@@ -168,7 +312,7 @@ sentry_pathiter_t *sentry__path_iter_directory(const sentry_path_t *path);
 
 /**
  * This will return a borrowed path to the next file or directory for the given
- * `piter`.
+ * `piter`, which is only valid until the next call.
  */
 const sentry_path_t *sentry__pathiter_next(sentry_pathiter_t *piter);
 
@@ -199,6 +343,14 @@ void sentry__filelock_unlock(sentry_filelock_t *lock);
  */
 void sentry__filelock_free(sentry_filelock_t *lock);
 
+#ifdef SENTRY_PLATFORM_UNIX
+/**
+ * Closes a lock that was inherited from the parent process by `fork`, without
+ * unlocking or removing it, so that the parent keeps holding it.
+ */
+void sentry__filelock_close_inherited(sentry_filelock_t *lock);
+#endif
+
 /* windows specific API additions */
 #ifdef SENTRY_PLATFORM_WINDOWS
 /**
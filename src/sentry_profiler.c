@@ -0,0 +1,514 @@
+#include "sentry_profiler.h"
+
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_os.h"
+#include "sentry_sync.h"
+#include "sentry_unwinder.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_FRAMES 128
+// every sample takes up its elapsed time, its frame count and its frames
+#define SAMPLE_HEADER_WORDS 2
+// the samples are stored in chunks of 32 KiB, which are allocated as needed,
+// up to 512 KiB per profile
+#define CHUNK_WORDS ((size_t)1 << 12)
+#define MAX_CHUNKS 16
+// profiles are capped at this duration, like in the other SDKs
+#define MAX_PROFILE_DURATION_MS 30000
+// how long the profiled thread has to respond to being unwound
+#define UNWIND_TIMEOUT_MS 10
+
+typedef struct sentry_profile_chunk_s {
+    struct sentry_profile_chunk_s *next;
+    size_t len;
+    uint64_t words[CHUNK_WORDS];
+} sentry_profile_chunk_t;
+
+/**
+ * The profiler thread appends the samples while it holds `g_profile_lock`,
+ * and the thread that ends the profile only reads them once the profile was
+ * detached under the same lock. A sample never spans two chunks, and samples
+ * that do not fit into the last chunk allowed are dropped.
+ */
+struct sentry_profile_s {
+    long tid;
+    uint64_t start_timestamp_us;
+    uint64_t start_ns;
+    sentry_profile_chunk_t *first_chunk;
+    sentry_profile_chunk_t *last_chunk;
+    size_t chunk_count;
+    size_t dropped;
+};
+
+static volatile long g_running = 0;
+static sentry_bgworker_t *g_profiler = NULL;
+static sentry_mutex_t g_profiler_lock = SENTRY__MUTEX_INIT;
+
+// this guards the lifetime of the active profile, which is only held by the
+// profiler thread for the duration of a sample
+static sentry_mutex_t g_profile_lock = SENTRY__MUTEX_INIT;
+static sentry_profile_t *g_active_profile = NULL;
+
+/**
+ * Returns a chunk with room for `needed` more words, which is allocated if the
+ * last one is full, or NULL when the profile has no chunks left.
+ */
+static sentry_profile_chunk_t *
+reserve_words(sentry_profile_t *profile, size_t needed)
+{
+    sentry_profile_chunk_t *chunk = profile->last_chunk;
+    if (chunk && CHUNK_WORDS - chunk->len >= needed) {
+        return chunk;
+    }
+    if (profile->chunk_count >= MAX_CHUNKS) {
+        return NULL;
+    }
+    chunk = SENTRY_MAKE(sentry_profile_chunk_t);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->len = 0;
+    if (profile->last_chunk) {
+        profile->last_chunk->next = chunk;
+    } else {
+        profile->first_chunk = chunk;
+    }
+    profile->last_chunk = chunk;
+    profile->chunk_count++;
+    return chunk;
+}
+
+static void
+take_sample(sentry_profile_t *profile)
+{
+    uint64_t elapsed_ns = sentry__monotonic_time_ns() - profile->start_ns;
+    if (elapsed_ns > (uint64_t)MAX_PROFILE_DURATION_MS * 1000000) {
+        return;
+    }
+
+    void *frames[MAX_FRAMES];
+    size_t frame_count = sentry__unwind_thread(
+        profile->tid, &frames[0], MAX_FRAMES, UNWIND_TIMEOUT_MS);
+    if (!frame_count) {
+        return;
+    }
+
+    sentry_profile_chunk_t *chunk
+        = reserve_words(profile, SAMPLE_HEADER_WORDS + frame_count);
+    if (!chunk) {
+        profile->dropped++;
+        return;
+    }
+    chunk->words[chunk->len++] = elapsed_ns;
+    chunk->words[chunk->len++] = frame_count;
+    for (size_t i = 0; i < frame_count; i++) {
+        chunk->words[chunk->len++] = (uint64_t)(uintptr_t)frames[i];
+    }
+}
+
+static void
+free_profile(sentry_profile_t *profile)
+{
+    sentry_profile_chunk_t *chunk = profile->first_chunk;
+    while (chunk) {
+        sentry_profile_chunk_t *next = chunk->next;
+        sentry_free(chunk);
+        chunk = next;
+    }
+    sentry_free(profile);
+}
+
+static void
+sample_active_profile(void *UNUSED(task_data), void *UNUSED(state))
+{
+    sentry__mutex_lock(&g_profile_lock);
+    if (g_active_profile) {
+        take_sample(g_active_profile);
+    }
+    sentry__mutex_unlock(&g_profile_lock);
+}
+
+void
+sentry__profiler_start(const sentry_options_t *options)
+{
+    if (options->profiles_sample_rate <= 0.0) {
+        return;
+    }
+
+    sentry__mutex_lock(&g_profiler_lock);
+    if (g_profiler) {
+        goto done;
+    }
+
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        goto done;
+    }
+    sentry__bgworker_setname(bgw, "sentry-profiler");
+
+    uint64_t interval = options->profiling_interval;
+    if (!interval) {
+        interval = 1;
+    }
+    if (sentry__bgworker_submit_periodic(
+            bgw, sample_active_profile, NULL, NULL, interval, NULL)
+            != 0
+        || sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start the profiler");
+        sentry__bgworker_decref(bgw);
+        goto done;
+    }
+
+    sentry__unwinder_threads_begin();
+    sentry__atomic_store(&g_running, 1);
+    g_profiler = bgw;
+    SENTRY_DEBUGF(
+        "started the profiler with an interval of %" PRIu64 " ms", interval);
+
+done:
+    sentry__mutex_unlock(&g_profiler_lock);
+}
+
+void
+sentry__profiler_stop(void)
+{
+    sentry__mutex_lock(&g_profiler_lock);
+    sentry_bgworker_t *bgw = g_profiler;
+    g_profiler = NULL;
+    if (bgw) {
+        sentry__atomic_store(&g_running, 0);
+        // a sample takes at most the unwind timeout
+        if (sentry__bgworker_shutdown(bgw, UNWIND_TIMEOUT_MS * 10) == 0) {
+            sentry__bgworker_decref(bgw);
+            sentry__unwinder_threads_end();
+        }
+        SENTRY_DEBUG("stopped the profiler");
+    }
+    sentry__mutex_unlock(&g_profiler_lock);
+}
+
+sentry_profile_t *
+sentry__profile_begin(void)
+{
+    if (!sentry__atomic_fetch(&g_running)) {
+        return NULL;
+    }
+    long tid = sentry__unwinder_current_tid();
+    if (!tid) {
+        return NULL;
+    }
+
+    sentry_profile_t *profile = NULL;
+    sentry__mutex_lock(&g_profile_lock);
+    if (!g_active_profile) {
+        profile = SENTRY_MAKE(sentry_profile_t);
+    }
+    if (profile) {
+        profile->tid = tid;
+        profile->start_timestamp_us = sentry__usec_time();
+        profile->start_ns = sentry__monotonic_time_ns();
+        profile->first_chunk = NULL;
+        profile->last_chunk = NULL;
+        profile->chunk_count = 0;
+        profile->dropped = 0;
+        g_active_profile = profile;
+    }
+    sentry__mutex_unlock(&g_profile_lock);
+    return profile;
+}
+
+static void
+detach_profile(sentry_profile_t *profile)
+{
+    sentry__mutex_lock(&g_profile_lock);
+    if (g_active_profile == profile) {
+        g_active_profile = NULL;
+    }
+    sentry__mutex_unlock(&g_profile_lock);
+}
+
+void
+sentry__profile_discard(sentry_profile_t *profile)
+{
+    if (profile) {
+        detach_profile(profile);
+        free_profile(profile);
+    }
+}
+
+static uint64_t
+hash_word(uint64_t word)
+{
+    word ^= word >> 33;
+    word *= 0xff51afd7ed558ccdULL;
+    word ^= word >> 33;
+    return word;
+}
+
+static size_t
+table_size_for(size_t len)
+{
+    size_t size = 16;
+    while (size < len * 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+/**
+ * Deduplicates the frames and stacks of the samples. Neither can outnumber
+ * the words of the profile, so everything is allocated upfront, and the
+ * open addressing tables never fill up. The slots of the tables hold indexes
+ * plus one, so that 0 marks an empty slot.
+ */
+typedef struct {
+    uint64_t *frames;
+    size_t frame_count;
+    uint32_t *frame_slots;
+    size_t frame_mask;
+
+    uint32_t *stack_frames;
+    size_t stack_frames_len;
+    size_t *stack_offsets;
+    size_t *stack_lens;
+    size_t stack_count;
+    uint32_t *stack_slots;
+    size_t stack_mask;
+} stack_interner_t;
+
+static bool
+interner_init(stack_interner_t *interner, size_t frame_words, size_t samples)
+{
+    memset(interner, 0, sizeof(stack_interner_t));
+    size_t frame_slots = table_size_for(frame_words);
+    size_t stack_slots = table_size_for(samples);
+    interner->frames = sentry_malloc(sizeof(uint64_t) * frame_words);
+    interner->frame_slots = sentry_malloc(sizeof(uint32_t) * frame_slots);
+    interner->stack_frames = sentry_malloc(sizeof(uint32_t) * frame_words);
+    interner->stack_offsets = sentry_malloc(sizeof(size_t) * samples);
+    interner->stack_lens = sentry_malloc(sizeof(size_t) * samples);
+    interner->stack_slots = sentry_malloc(sizeof(uint32_t) * stack_slots);
+    if (!interner->frames || !interner->frame_slots || !interner->stack_frames
+        || !interner->stack_offsets || !interner->stack_lens
+        || !interner->stack_slots) {
+        return false;
+    }
+    memset(interner->frame_slots, 0, sizeof(uint32_t) * frame_slots);
+    memset(interner->stack_slots, 0, sizeof(uint32_t) * stack_slots);
+    interner->frame_mask = frame_slots - 1;
+    interner->stack_mask = stack_slots - 1;
+    return true;
+}
+
+static void
+interner_cleanup(stack_interner_t *interner)
+{
+    sentry_free(interner->frames);
+    sentry_free(interner->frame_slots);
+    sentry_free(interner->stack_frames);
+    sentry_free(interner->stack_offsets);
+    sentry_free(interner->stack_lens);
+    sentry_free(interner->stack_slots);
+}
+
+static uint32_t
+intern_frame(stack_interner_t *interner, uint64_t addr)
+{
+    size_t slot = hash_word(addr) & interner->frame_mask;
+    while (interner->frame_slots[slot]) {
+        uint32_t index = interner->frame_slots[slot] - 1;
+        if (interner->frames[index] == addr) {
+            return index;
+        }
+        slot = (slot + 1) & interner->frame_mask;
+    }
+    uint32_t index = (uint32_t)interner->frame_count++;
+    interner->frames[index] = addr;
+    interner->frame_slots[slot] = index + 1;
+    return index;
+}
+
+static uint32_t
+intern_stack(stack_interner_t *interner, const uint32_t *frames, size_t len)
+{
+    uint64_t hash = len;
+    for (size_t i = 0; i < len; i++) {
+        hash = hash_word(hash ^ frames[i]);
+    }
+    size_t slot = hash & interner->stack_mask;
+    while (interner->stack_slots[slot]) {
+        uint32_t index = interner->stack_slots[slot] - 1;
+        if (interner->stack_lens[index] == len
+            && memcmp(interner->stack_frames + interner->stack_offsets[index],
+                   frames, sizeof(uint32_t) * len)
+                == 0) {
+            return index;
+        }
+        slot = (slot + 1) & interner->stack_mask;
+    }
+    uint32_t index = (uint32_t)interner->stack_count++;
+    interner->stack_offsets[index] = interner->stack_frames_len;
+    interner->stack_lens[index] = len;
+    memcpy(interner->stack_frames + interner->stack_frames_len, frames,
+        sizeof(uint32_t) * len);
+    interner->stack_frames_len += len;
+    interner->stack_slots[slot] = index + 1;
+    return index;
+}
+
+static sentry_value_t
+interned_frames_to_value(const stack_interner_t *interner)
+{
+    sentry_value_t frames
+        = sentry__value_new_list_with_size(interner->frame_count);
+    for (size_t i = 0; i < interner->frame_count; i++) {
+        sentry_value_t frame = sentry_value_new_object();
+        sentry_value_set_by_key(frame, "instruction_addr",
+            sentry__value_new_addr(interner->frames[i]));
+        sentry_value_append(frames, frame);
+    }
+    return frames;
+}
+
+static sentry_value_t
+interned_stacks_to_value(const stack_interner_t *interner)
+{
+    sentry_value_t stacks
+        = sentry__value_new_list_with_size(interner->stack_count);
+    for (size_t i = 0; i < interner->stack_count; i++) {
+        const uint32_t *frames
+            = interner->stack_frames + interner->stack_offsets[i];
+        sentry_value_t stack
+            = sentry__value_new_list_with_size(interner->stack_lens[i]);
+        for (size_t j = 0; j < interner->stack_lens[i]; j++) {
+            sentry_value_append(
+                stack, sentry_value_new_int32((int32_t)frames[j]));
+        }
+        sentry_value_append(stacks, stack);
+    }
+    return stacks;
+}
+
+/**
+ * Returns the samples of `profile` along with their deduplicated stacks and
+ * frames, in the `profile` format of https://develop.sentry.dev/sdk/profiles/
+ */
+static sentry_value_t
+drain_samples(const sentry_profile_t *profile, const char *thread_id)
+{
+    // the first pass only counts, so that the interner can be sized
+    size_t sample_count = 0;
+    size_t frame_words = 0;
+    for (const sentry_profile_chunk_t *chunk = profile->first_chunk; chunk;
+         chunk = chunk->next) {
+        for (size_t pos = 0; pos < chunk->len;) {
+            size_t frame_count = (size_t)chunk->words[pos + 1];
+            sample_count++;
+            frame_words += frame_count;
+            pos += SAMPLE_HEADER_WORDS + frame_count;
+        }
+    }
+    if (!sample_count) {
+        return sentry_value_new_null();
+    }
+
+    stack_interner_t interner;
+    if (!interner_init(&interner, frame_words, sample_count)) {
+        interner_cleanup(&interner);
+        return sentry_value_new_null();
+    }
+
+    sentry_value_t samples = sentry__value_new_list_with_size(sample_count);
+    uint32_t stack[MAX_FRAMES];
+    for (const sentry_profile_chunk_t *chunk = profile->first_chunk; chunk;
+         chunk = chunk->next) {
+        for (size_t pos = 0; pos < chunk->len;) {
+            uint64_t elapsed_ns = chunk->words[pos++];
+            size_t frame_count = (size_t)chunk->words[pos++];
+            for (size_t i = 0; i < frame_count; i++) {
+                stack[i] = intern_frame(&interner, chunk->words[pos++]);
+            }
+
+            char elapsed[32];
+            snprintf(elapsed, sizeof(elapsed), "%" PRIu64, elapsed_ns);
+            sentry_value_t sample = sentry_value_new_object();
+            sentry_value_set_by_key(sample, "stack_id",
+                sentry_value_new_int32(
+                    (int32_t)intern_stack(&interner, stack, frame_count)));
+            sentry_value_set_by_key(
+                sample, "thread_id", sentry_value_new_string(thread_id));
+            sentry_value_set_by_key(sample, "elapsed_since_start_ns",
+                sentry_value_new_string(elapsed));
+            sentry_value_append(samples, sample);
+        }
+    }
+
+    sentry_value_t rv = sentry_value_new_object();
+    sentry_value_set_by_key(rv, "samples", samples);
+    sentry_value_set_by_key(rv, "stacks", interned_stacks_to_value(&interner));
+    sentry_value_set_by_key(rv, "frames", interned_frames_to_value(&interner));
+    interner_cleanup(&interner);
+    return rv;
+}
+
+sentry_value_t
+sentry__profile_end(sentry_profile_t *profile)
+{
+    if (!profile) {
+        return sentry_value_new_null();
+    }
+    // once detached, the profiler thread no longer appends to it
+    detach_profile(profile);
+
+    char thread_id[32];
+    snprintf(thread_id, sizeof(thread_id), "%ld", profile->tid);
+    sentry_value_t samples = drain_samples(profile, thread_id);
+    if (profile->dropped) {
+        SENTRY_DEBUGF("dropped %zu samples that did not fit into the profile",
+            profile->dropped);
+    }
+    if (sentry_value_is_null(samples)) {
+        free_profile(profile);
+        return samples;
+    }
+
+    char name_buf[16];
+    const char *name = sentry__unwinder_thread_name(profile->tid, name_buf);
+    sentry_value_t thread = sentry_value_new_object();
+    if (name) {
+        sentry_value_set_by_key(thread, "name", sentry_value_new_string(name));
+    }
+    sentry_value_t thread_metadata = sentry_value_new_object();
+    sentry_value_set_by_key(thread_metadata, thread_id, thread);
+    sentry_value_set_by_key(samples, "thread_metadata", thread_metadata);
+
+    sentry_value_t rv = sentry_value_new_object();
+    sentry_value_set_by_key(rv, "version", sentry_value_new_string("1"));
+    sentry_value_set_by_key(rv, "platform", sentry_value_new_string("native"));
+    sentry_value_set_by_key(rv, "timestamp",
+        sentry__value_new_string_owned(
+            sentry__usec_time_to_iso8601(profile->start_timestamp_us)));
+    sentry_value_t system_contexts = sentry__get_system_contexts();
+    sentry_value_t os = sentry_value_get_by_key(system_contexts, "os");
+    sentry_value_incref(os);
+    sentry_value_set_by_key(rv, "os", os);
+    sentry_value_decref(system_contexts);
+    sentry_value_t device = sentry_value_new_object();
+    sentry_value_set_by_key(device, "architecture",
+        sentry_value_new_string(SENTRY_CPU_ARCHITECTURE));
+    sentry_value_set_by_key(rv, "device", device);
+    sentry_value_t transaction = sentry_value_new_object();
+    sentry_value_set_by_key(
+        transaction, "active_thread_id", sentry_value_new_string(thread_id));
+    sentry_value_set_by_key(rv, "transaction", transaction);
+    sentry_value_set_by_key(rv, "profile", samples);
+
+    free_profile(profile);
+    return rv;
+}
@@ -0,0 +1,49 @@
+#ifndef SENTRY_PROFILER_H_INCLUDED
+#define SENTRY_PROFILER_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_options.h"
+
+/**
+ * A sampling profile of the thread that started a transaction.
+ *
+ * The profiler thread unwinds the profiled thread every `profiling_interval`
+ * milliseconds, and appends the stack to the samples of the profile, which
+ * grow in chunks, so that the profiled thread is only interrupted for the
+ * unwind itself. The stacks are only deduplicated once the profile ends.
+ *
+ * Only one profile is active at a time, and this is only supported on Linux.
+ */
+typedef struct sentry_profile_s sentry_profile_t;
+
+/**
+ * Starts the profiler thread, if `options` has a profiles sample rate.
+ */
+void sentry__profiler_start(const sentry_options_t *options);
+
+/**
+ * Stops the profiler thread. Profiles that are still active stop getting
+ * samples, but can still be ended.
+ */
+void sentry__profiler_stop(void);
+
+/**
+ * Starts profiling the calling thread. Returns `NULL` if the profiler is not
+ * running, or another profile is already active.
+ */
+sentry_profile_t *sentry__profile_begin(void);
+
+/**
+ * Ends and frees `profile`, and returns a new Object Value with its samples,
+ * which only lacks the details of its transaction to be sent. Returns a null
+ * Value if it has no samples.
+ */
+sentry_value_t sentry__profile_end(sentry_profile_t *profile);
+
+/**
+ * Ends and frees `profile`, without looking at its samples.
+ */
+void sentry__profile_discard(sentry_profile_t *profile);
+
+#endif
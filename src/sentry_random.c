@@ -1,8 +1,11 @@
 #include "sentry_boot.h"
 
 #include "sentry_random.h"
+#include "sentry_sync.h"
 #include "sentry_utils.h"
 
+#include <string.h>
+
 #ifdef SENTRY_PLATFORM_DARWIN
 #    include <stdlib.h>
 
@@ -18,7 +21,35 @@ getrandom_arc4random(void *dst, size_t bytes)
 #ifdef SENTRY_PLATFORM_UNIX
 #    include <errno.h>
 #    include <fcntl.h>
+#    include <pthread.h>
 #    include <unistd.h>
+#endif
+#ifdef SENTRY_PLATFORM_LINUX
+#    include <sys/syscall.h>
+#    ifdef SYS_getrandom
+
+// the syscall is used directly, since older libcs have no wrapper for it
+static int
+getrandom_syscall(void *dst, size_t bytes)
+{
+    char *d = dst;
+    while (bytes > 0) {
+        long n = syscall(SYS_getrandom, d, bytes, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            // most likely `ENOSYS` on kernels before 3.17
+            return 1;
+        }
+        d += n;
+        bytes -= (size_t)n;
+    }
+    return 0;
+}
+#        define HAVE_GETRANDOM
+#    endif
+#endif
+#ifdef SENTRY_PLATFORM_UNIX
 
 static int
 getrandom_devurandom(void *dst, size_t bytes)
@@ -76,14 +107,19 @@ getrandom_rtlgenrandom(void *dst, size_t bytes)
 #    define HAVE_RTLGENRANDOM
 #endif
 
-int
-sentry__getrandom(void *dst, size_t len)
+static int
+getrandom_system(void *dst, size_t len)
 {
 #ifdef HAVE_ARC4RANDOM
     if (getrandom_arc4random(dst, len) == 0) {
         return 0;
     }
 #endif
+#ifdef HAVE_GETRANDOM
+    if (getrandom_syscall(dst, len) == 0) {
+        return 0;
+    }
+#endif
 #ifdef HAVE_URANDOM
     if (getrandom_devurandom(dst, len) == 0) {
         return 0;
@@ -96,3 +132,72 @@ sentry__getrandom(void *dst, size_t len)
 #endif
     return 1;
 }
+
+#ifndef HAVE_ARC4RANDOM
+/**
+ * Small requests, like the ones for UUIDs and sampling decisions, are served
+ * from a per-thread pool, which is refilled from the system in larger chunks.
+ * Bytes are wiped from the pool as they are handed out.
+ *
+ * A forked child would otherwise hand out the very same bytes as its parent,
+ * so the pools are discarded in the child.
+ */
+#    define POOL_SIZE 256
+#    define POOL_MAX_REQUEST 32
+
+static SENTRY_THREAD_LOCAL unsigned char g_pool[POOL_SIZE];
+static SENTRY_THREAD_LOCAL size_t g_pool_pos = POOL_SIZE;
+static SENTRY_THREAD_LOCAL long g_pool_generation = 0;
+static volatile long g_fork_generation = 0;
+
+#    ifdef SENTRY_PLATFORM_UNIX
+static pthread_once_t g_atfork_once = PTHREAD_ONCE_INIT;
+
+static void
+discard_pools_after_fork(void)
+{
+    sentry__atomic_fetch_and_add(&g_fork_generation, 1);
+}
+
+static void
+register_atfork(void)
+{
+    pthread_atfork(NULL, NULL, discard_pools_after_fork);
+}
+#    endif
+
+static int
+getrandom_pooled(void *dst, size_t len)
+{
+#    ifdef SENTRY_PLATFORM_UNIX
+    pthread_once(&g_atfork_once, register_atfork);
+#    endif
+    long generation = sentry__atomic_fetch(&g_fork_generation);
+    if (g_pool_generation != generation) {
+        memset(g_pool, 0, sizeof(g_pool));
+        g_pool_pos = POOL_SIZE;
+        g_pool_generation = generation;
+    }
+    if (POOL_SIZE - g_pool_pos < len) {
+        if (getrandom_system(g_pool, POOL_SIZE) != 0) {
+            return 1;
+        }
+        g_pool_pos = 0;
+    }
+    memcpy(dst, g_pool + g_pool_pos, len);
+    memset(g_pool + g_pool_pos, 0, len);
+    g_pool_pos += len;
+    return 0;
+}
+#endif
+
+int
+sentry__getrandom(void *dst, size_t len)
+{
+#ifndef HAVE_ARC4RANDOM
+    if (len <= POOL_MAX_REQUEST) {
+        return getrandom_pooled(dst, len);
+    }
+#endif
+    return getrandom_system(dst, len);
+}
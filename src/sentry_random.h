@@ -4,7 +4,9 @@
 #include "sentry_boot.h"
 
 /**
- * Utility function to get random bytes.
+ * Utility function to get cryptographically secure random bytes. Small
+ * requests are served from a per-thread buffer, so they rarely need a syscall.
+ * Returns 0 on success.
  */
 int sentry__getrandom(void *dst, size_t len);
 
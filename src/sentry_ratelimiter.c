@@ -1,22 +1,35 @@
 #include "sentry_ratelimiter.h"
 #include "sentry_alloc.h"
 #include "sentry_slice.h"
+#include "sentry_sync.h"
 #include "sentry_utils.h"
 
-#define MAX_RATE_LIMITS 4
-
+// The deadlines are only ever written from the transport thread, but are read
+// from any thread that captures an event. They are stored as whole seconds of
+// monotonic time, rounded up, so that they fit into an atomic `long` on every
+// platform.
 struct sentry_rate_limiter_s {
-    uint64_t disabled_until[MAX_RATE_LIMITS];
+    volatile long disabled_until[SENTRY_RL_CATEGORY_COUNT];
 };
 
+static void
+set_disabled_until(sentry_rate_limiter_t *rl, int category, uint64_t until)
+{
+    sentry__atomic_store(
+        &rl->disabled_until[category], (long)((until + 999) / 1000));
+}
+
 sentry_rate_limiter_t *
 sentry__rate_limiter_new(void)
 {
     sentry_rate_limiter_t *rl = SENTRY_MAKE(sentry_rate_limiter_t);
-    rl->disabled_until[SENTRY_RL_CATEGORY_ANY] = 0;
-    rl->disabled_until[SENTRY_RL_CATEGORY_ERROR] = 0;
-    rl->disabled_until[SENTRY_RL_CATEGORY_SESSION] = 0;
-    rl->disabled_until[SENTRY_RL_CATEGORY_TRANSACTION] = 0;
+    if (!rl) {
+        return NULL;
+    }
+    set_disabled_until(rl, SENTRY_RL_CATEGORY_ANY, 0);
+    set_disabled_until(rl, SENTRY_RL_CATEGORY_ERROR, 0);
+    set_disabled_until(rl, SENTRY_RL_CATEGORY_SESSION, 0);
+    set_disabled_until(rl, SENTRY_RL_CATEGORY_TRANSACTION, 0);
     return rl;
 }
 
@@ -41,18 +54,20 @@ sentry__rate_limiter_update_from_header(
 
         sentry_slice_t categories = sentry__slice_split_at(slice, ':');
         if (categories.len == 0) {
-            rl->disabled_until[SENTRY_RL_CATEGORY_ANY] = retry_after;
+            set_disabled_until(rl, SENTRY_RL_CATEGORY_ANY, retry_after);
         }
 
         while (categories.len > 0) {
             sentry_slice_t category = sentry__slice_split_at(categories, ';');
             if (sentry__slice_eqs(category, "error")) {
-                rl->disabled_until[SENTRY_RL_CATEGORY_ERROR] = retry_after;
+                set_disabled_until(
+                    rl, SENTRY_RL_CATEGORY_ERROR, retry_after);
             } else if (sentry__slice_eqs(category, "session")) {
-                rl->disabled_until[SENTRY_RL_CATEGORY_SESSION] = retry_after;
+                set_disabled_until(
+                    rl, SENTRY_RL_CATEGORY_SESSION, retry_after);
             } else if (sentry__slice_eqs(category, "transaction")) {
-                rl->disabled_until[SENTRY_RL_CATEGORY_TRANSACTION]
-                    = retry_after;
+                set_disabled_until(
+                    rl, SENTRY_RL_CATEGORY_TRANSACTION, retry_after);
             }
 
             categories = sentry__slice_advance(categories, category.len);
@@ -77,16 +92,16 @@ sentry__rate_limiter_update_from_http_retry_after(
     sentry_slice_t slice = sentry__slice_from_str(retry_after);
     uint64_t eta = 60;
     sentry__slice_consume_uint64(&slice, &eta);
-    rl->disabled_until[SENTRY_RL_CATEGORY_ANY]
-        = sentry__monotonic_time() + eta * 1000;
+    set_disabled_until(rl, SENTRY_RL_CATEGORY_ANY,
+        sentry__monotonic_time() + eta * 1000);
     return true;
 }
 
 bool
 sentry__rate_limiter_update_from_429(sentry_rate_limiter_t *rl)
 {
-    rl->disabled_until[SENTRY_RL_CATEGORY_ANY]
-        = sentry__monotonic_time() + 60 * 1000;
+    set_disabled_until(
+        rl, SENTRY_RL_CATEGORY_ANY, sentry__monotonic_time() + 60 * 1000);
     return true;
 }
 
@@ -94,8 +109,9 @@ bool
 sentry__rate_limiter_is_disabled(const sentry_rate_limiter_t *rl, int category)
 {
     uint64_t now = sentry__monotonic_time();
-    return rl->disabled_until[SENTRY_RL_CATEGORY_ANY] > now
-        || rl->disabled_until[category] > now;
+    return sentry__rate_limiter_get_disabled_until(rl, SENTRY_RL_CATEGORY_ANY)
+        > now
+        || sentry__rate_limiter_get_disabled_until(rl, category) > now;
 }
 
 void
@@ -107,11 +123,110 @@ sentry__rate_limiter_free(sentry_rate_limiter_t *rl)
     sentry_free(rl);
 }
 
-#ifdef SENTRY_UNITTEST
 uint64_t
 sentry__rate_limiter_get_disabled_until(
     const sentry_rate_limiter_t *rl, int category)
 {
-    return rl->disabled_until[category];
+    // `sentry__atomic_fetch` only takes a mutable pointer, but does not modify
+    // the value.
+    long seconds = sentry__atomic_fetch(
+        (volatile long *)&rl->disabled_until[category]);
+    return (uint64_t)seconds * 1000;
+}
+
+void
+sentry__token_bucket_init(sentry_token_bucket_t *bucket, uint64_t rate)
+{
+    sentry__mutex_init(&bucket->lock);
+    bucket->rate = rate;
+    bucket->tokens = rate * 1000;
+    bucket->refilled_at = sentry__monotonic_time();
+}
+
+void
+sentry__token_bucket_cleanup(sentry_token_bucket_t *bucket)
+{
+    sentry__mutex_free(&bucket->lock);
+}
+
+bool
+sentry__token_bucket_take(sentry_token_bucket_t *bucket, uint64_t now)
+{
+    if (!bucket->rate) {
+        return true;
+    }
+
+    sentry__mutex_lock(&bucket->lock);
+    // `rate` thousandths of a token are added per millisecond, and the bucket
+    // is full after a second
+    uint64_t capacity = bucket->rate * 1000;
+    uint64_t elapsed
+        = now > bucket->refilled_at ? now - bucket->refilled_at : 0;
+    if (elapsed > 1000) {
+        elapsed = 1000;
+    }
+    bucket->tokens += elapsed * bucket->rate;
+    if (bucket->tokens > capacity) {
+        bucket->tokens = capacity;
+    }
+    if (now > bucket->refilled_at) {
+        bucket->refilled_at = now;
+    }
+
+    bool taken = bucket->tokens >= 1000;
+    if (taken) {
+        bucket->tokens -= 1000;
+    }
+    sentry__mutex_unlock(&bucket->lock);
+    return taken;
+}
+
+void
+sentry__rate_sampler_init(sentry_rate_sampler_t *sampler, uint64_t max_rate)
+{
+    sentry__mutex_init(&sampler->lock);
+    sampler->max_rate = max_rate;
+    sampler->window_start = sentry__monotonic_time();
+    sampler->current = 0;
+    sampler->previous = 0;
+}
+
+void
+sentry__rate_sampler_cleanup(sentry_rate_sampler_t *sampler)
+{
+    sentry__mutex_free(&sampler->lock);
+}
+
+double
+sentry__rate_sampler_sample_rate(sentry_rate_sampler_t *sampler, uint64_t now)
+{
+    if (!sampler->max_rate) {
+        return 1.0;
+    }
+
+    sentry__mutex_lock(&sampler->lock);
+    uint64_t elapsed
+        = now > sampler->window_start ? now - sampler->window_start : 0;
+    if (elapsed >= 2000) {
+        sampler->previous = 0;
+        sampler->current = 0;
+        sampler->window_start = now;
+        elapsed = 0;
+    } else if (elapsed >= 1000) {
+        sampler->previous = sampler->current;
+        sampler->current = 0;
+        sampler->window_start += 1000;
+        elapsed -= 1000;
+    }
+    sampler->current += 1;
+
+    // the previous window is weighted by how much of it still overlaps with
+    // the second before `now`
+    double estimate
+        = (double)sampler->previous * (double)(1000 - elapsed) / 1000.0
+        + (double)sampler->current;
+    double max_rate = (double)sampler->max_rate;
+    sentry__mutex_unlock(&sampler->lock);
+
+    return estimate > max_rate ? max_rate / estimate : 1.0;
 }
-#endif
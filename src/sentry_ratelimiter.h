@@ -3,10 +3,13 @@
 
 #include "sentry_boot.h"
 
+#include "sentry_sync.h"
+
 #define SENTRY_RL_CATEGORY_ANY 0
 #define SENTRY_RL_CATEGORY_ERROR 1
 #define SENTRY_RL_CATEGORY_SESSION 2
 #define SENTRY_RL_CATEGORY_TRANSACTION 3
+#define SENTRY_RL_CATEGORY_COUNT 4
 
 typedef struct sentry_rate_limiter_s sentry_rate_limiter_t;
 
@@ -43,17 +46,79 @@ bool sentry__rate_limiter_update_from_429(sentry_rate_limiter_t *rl);
 /**
  * This will return `true` if the specified `category` is currently rate
  * limited.
+ *
+ * This does not take any lock, and can be called from any thread while the
+ * transport thread updates the rate limiter.
  */
 bool sentry__rate_limiter_is_disabled(
     const sentry_rate_limiter_t *rl, int category);
 
-#ifdef SENTRY_UNITTEST
 /**
- * The rate limiters state is completely opaque. Unless in tests, where we would
- * want to actually peek into the specific rate limiting `category`.
+ * Returns the monotonic time in milliseconds until which the specified
+ * `category` is rate limited, which is in the past if it is not limited.
  */
 uint64_t sentry__rate_limiter_get_disabled_until(
     const sentry_rate_limiter_t *rl, int category);
-#endif
+
+/**
+ * A token bucket for client side throttling, which allows `rate` takes per
+ * second on average, and bursts of up to `rate` takes.
+ */
+typedef struct sentry_token_bucket_s {
+    sentry_mutex_t lock;
+    uint64_t rate;
+    // the available tokens, in thousandths of a token
+    uint64_t tokens;
+    uint64_t refilled_at;
+} sentry_token_bucket_t;
+
+/**
+ * Initializes a full `bucket`. A `rate` of 0 means that takes always succeed.
+ */
+void sentry__token_bucket_init(sentry_token_bucket_t *bucket, uint64_t rate);
+
+/**
+ * Frees the resources of the `bucket`.
+ */
+void sentry__token_bucket_cleanup(sentry_token_bucket_t *bucket);
+
+/**
+ * Takes a token out of the `bucket`, after refilling it for the time that
+ * passed until `now`, in monotonic milliseconds.
+ * Returns `false` if the bucket is empty, and the take should be throttled.
+ */
+bool sentry__token_bucket_take(sentry_token_bucket_t *bucket, uint64_t now);
+
+/**
+ * An adaptive sampler, which estimates the rate of incoming events over a
+ * sliding window of one second, and lowers the sample rate so that about
+ * `max_rate` events per second are kept.
+ */
+typedef struct sentry_rate_sampler_s {
+    sentry_mutex_t lock;
+    uint64_t max_rate;
+    uint64_t window_start;
+    // the number of events in the current and in the previous window
+    uint64_t current;
+    uint64_t previous;
+} sentry_rate_sampler_t;
+
+/**
+ * Initializes the `sampler`. A `max_rate` of 0 means that all events are kept.
+ */
+void sentry__rate_sampler_init(
+    sentry_rate_sampler_t *sampler, uint64_t max_rate);
+
+/**
+ * Frees the resources of the `sampler`.
+ */
+void sentry__rate_sampler_cleanup(sentry_rate_sampler_t *sampler);
+
+/**
+ * Counts an incoming event at `now`, in monotonic milliseconds, and returns
+ * the sample rate it should be kept with, between 0 and 1.
+ */
+double sentry__rate_sampler_sample_rate(
+    sentry_rate_sampler_t *sampler, uint64_t now);
 
 #endif
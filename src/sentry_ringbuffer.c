@@ -0,0 +1,257 @@
+#include "sentry_ringbuffer.h"
+#include "sentry_alloc.h"
+#include "sentry_breadcrumb.h"
+#include "sentry_value.h"
+
+#include <string.h>
+
+// the number of items the storage grows to on the first append
+#define RINGBUFFER_INITIAL_SIZE 8
+
+/**
+ * An item is either a Value, or a breadcrumb that was turned into a compact
+ * record, which is only expanded back into a Value by
+ * `sentry__ringbuffer_to_list`.
+ */
+typedef struct {
+    bool is_compact;
+    union {
+        sentry_value_t value;
+        sentry_breadcrumb_t crumb;
+    } u;
+} ringbuffer_item_t;
+
+/**
+ * The items live in `items[start..start + len]`, wrapping around at
+ * `max_size`. The storage for `allocated` items grows as items are appended,
+ * until it reaches `max_size`, and `start` stays 0 until then.
+ * `snapshot` caches the last list returned by `sentry__ringbuffer_to_list`.
+ */
+struct sentry_ringbuffer_s {
+    ringbuffer_item_t *items;
+    size_t allocated;
+    size_t max_size;
+    size_t start;
+    size_t len;
+    sentry_value_t snapshot;
+};
+
+sentry_ringbuffer_t *
+sentry__ringbuffer_new(size_t max_size)
+{
+    sentry_ringbuffer_t *rb = SENTRY_MAKE(sentry_ringbuffer_t);
+    if (!rb) {
+        return NULL;
+    }
+    rb->items = NULL;
+    rb->allocated = 0;
+    rb->max_size = max_size;
+    rb->start = 0;
+    rb->len = 0;
+    rb->snapshot = sentry_value_new_null();
+    return rb;
+}
+
+static ringbuffer_item_t *
+ringbuffer_at(const sentry_ringbuffer_t *rb, size_t i)
+{
+    return &rb->items[(rb->start + i) % rb->max_size];
+}
+
+static void
+item_store(ringbuffer_item_t *item, sentry_value_t v)
+{
+    item->is_compact = sentry__breadcrumb_compact(&item->u.crumb, v);
+    if (item->is_compact) {
+        sentry_value_decref(v);
+    } else {
+        item->u.value = v;
+    }
+}
+
+static void
+item_drop(ringbuffer_item_t *item)
+{
+    if (!item->is_compact) {
+        sentry_value_decref(item->u.value);
+    }
+}
+
+static bool
+ringbuffer_reserve(sentry_ringbuffer_t *rb, size_t allocated)
+{
+    ringbuffer_item_t *items
+        = sentry_malloc(sizeof(ringbuffer_item_t) * allocated);
+    if (!items) {
+        return false;
+    }
+    if (rb->items) {
+        // this is only called while `start` is 0
+        memcpy(items, rb->items, sizeof(ringbuffer_item_t) * rb->len);
+        sentry_free(rb->items);
+    }
+    rb->items = items;
+    rb->allocated = allocated;
+    return true;
+}
+
+static void
+ringbuffer_invalidate(sentry_ringbuffer_t *rb)
+{
+    sentry_value_decref(rb->snapshot);
+    rb->snapshot = sentry_value_new_null();
+}
+
+static void
+ringbuffer_clear(sentry_ringbuffer_t *rb)
+{
+    ringbuffer_invalidate(rb);
+    for (size_t i = 0; i < rb->len; i++) {
+        item_drop(ringbuffer_at(rb, i));
+    }
+    sentry_free(rb->items);
+    rb->items = NULL;
+    rb->allocated = 0;
+    rb->start = 0;
+    rb->len = 0;
+}
+
+void
+sentry__ringbuffer_free(sentry_ringbuffer_t *rb)
+{
+    if (!rb) {
+        return;
+    }
+    ringbuffer_clear(rb);
+    sentry_free(rb);
+}
+
+int
+sentry__ringbuffer_append(sentry_ringbuffer_t *rb, sentry_value_t v)
+{
+    if (!rb || !rb->max_size) {
+        goto fail;
+    }
+    if (rb->len == rb->allocated && rb->allocated < rb->max_size) {
+        size_t allocated = rb->allocated ? rb->allocated * 2
+                                         : RINGBUFFER_INITIAL_SIZE;
+        if (!ringbuffer_reserve(rb,
+                allocated < rb->max_size ? allocated : rb->max_size)) {
+            goto fail;
+        }
+    }
+
+    ringbuffer_invalidate(rb);
+    if (rb->len < rb->max_size) {
+        item_store(ringbuffer_at(rb, rb->len), v);
+        rb->len++;
+    } else {
+        ringbuffer_item_t *oldest = ringbuffer_at(rb, 0);
+        item_drop(oldest);
+        item_store(oldest, v);
+        rb->start = (rb->start + 1) % rb->max_size;
+    }
+    return 0;
+
+fail:
+    sentry_value_decref(v);
+    return 1;
+}
+
+void
+sentry__ringbuffer_set_max_size(sentry_ringbuffer_t *rb, size_t max_size)
+{
+    if (!rb || rb->max_size == max_size) {
+        return;
+    }
+    if (!rb->len || !max_size) {
+        ringbuffer_clear(rb);
+        rb->max_size = max_size;
+        return;
+    }
+
+    // the new storage only fits the items that are kept, and grows again on
+    // the next append
+    size_t to_drop = rb->len > max_size ? rb->len - max_size : 0;
+    size_t allocated = rb->len - to_drop;
+    ringbuffer_item_t *items
+        = sentry_malloc(sizeof(ringbuffer_item_t) * allocated);
+    if (!items) {
+        ringbuffer_clear(rb);
+        rb->max_size = max_size;
+        return;
+    }
+    ringbuffer_invalidate(rb);
+    for (size_t i = 0; i < rb->len; i++) {
+        ringbuffer_item_t *item = ringbuffer_at(rb, i);
+        if (i < to_drop) {
+            item_drop(item);
+        } else {
+            items[i - to_drop] = *item;
+        }
+    }
+    sentry_free(rb->items);
+    rb->items = items;
+    rb->allocated = allocated;
+    rb->max_size = max_size;
+    rb->start = 0;
+    rb->len -= to_drop;
+}
+
+size_t
+sentry__ringbuffer_len(const sentry_ringbuffer_t *rb)
+{
+    return rb ? rb->len : 0;
+}
+
+size_t
+sentry__ringbuffer_get_memory_usage(const sentry_ringbuffer_t *rb)
+{
+    if (!rb) {
+        return 0;
+    }
+    size_t size = sizeof(sentry_ringbuffer_t);
+    size_t items_size = 0;
+    size += sizeof(ringbuffer_item_t) * rb->allocated;
+    for (size_t i = 0; i < rb->len; i++) {
+        const ringbuffer_item_t *item = ringbuffer_at(rb, i);
+        if (!item->is_compact) {
+            items_size += sentry__value_get_memory_usage(item->u.value);
+        }
+    }
+    // the snapshot shares all of the Value items, so only count the list
+    // itself and the expanded breadcrumbs
+    if (!sentry_value_is_null(rb->snapshot)) {
+        size += sentry__value_get_memory_usage(rb->snapshot) - items_size;
+    }
+    return size + items_size;
+}
+
+sentry_value_t
+sentry__ringbuffer_to_list(sentry_ringbuffer_t *rb)
+{
+    if (!rb) {
+        return sentry_value_new_list();
+    }
+    if (sentry_value_is_null(rb->snapshot)) {
+        // the snapshot outlives the event it is built for, so keep it out of
+        // the event arena
+        sentry_value_arena_t *prev_arena = sentry__value_arena_enter(NULL);
+        sentry_value_t list = sentry__value_new_list_with_size(rb->len);
+        for (size_t i = 0; i < rb->len; i++) {
+            const ringbuffer_item_t *item = ringbuffer_at(rb, i);
+            if (item->is_compact) {
+                sentry_value_append(
+                    list, sentry__breadcrumb_to_value(&item->u.crumb));
+            } else {
+                sentry_value_incref(item->u.value);
+                sentry_value_append(list, item->u.value);
+            }
+        }
+        sentry__value_arena_leave(prev_arena);
+        sentry_value_freeze(list);
+        rb->snapshot = list;
+    }
+    sentry_value_incref(rb->snapshot);
+    return rb->snapshot;
+}
@@ -0,0 +1,50 @@
+#ifndef SENTRY_RINGBUFFER_H_INCLUDED
+#define SENTRY_RINGBUFFER_H_INCLUDED
+
+#include "sentry_boot.h"
+
+typedef struct sentry_ringbuffer_s sentry_ringbuffer_t;
+
+/**
+ * Creates a new ring buffer of values, which holds at most `max_size` of the
+ * most recently appended values.
+ */
+sentry_ringbuffer_t *sentry__ringbuffer_new(size_t max_size);
+
+/**
+ * Frees the ring buffer, and drops all of its values.
+ */
+void sentry__ringbuffer_free(sentry_ringbuffer_t *rb);
+
+/**
+ * Appends the value `v` to the ring buffer, which takes ownership of it.
+ * Once the ring buffer is full, this replaces the oldest value in constant
+ * time.
+ */
+int sentry__ringbuffer_append(sentry_ringbuffer_t *rb, sentry_value_t v);
+
+/**
+ * Changes the maximum number of values the ring buffer can hold, dropping the
+ * oldest values if there are more than that.
+ */
+void sentry__ringbuffer_set_max_size(sentry_ringbuffer_t *rb, size_t max_size);
+
+/**
+ * Returns the number of values currently in the ring buffer.
+ */
+size_t sentry__ringbuffer_len(const sentry_ringbuffer_t *rb);
+
+/**
+ * Returns the number of bytes allocated for the ring buffer and its values,
+ * as per `sentry__value_get_memory_usage`.
+ */
+size_t sentry__ringbuffer_get_memory_usage(const sentry_ringbuffer_t *rb);
+
+/**
+ * Returns a frozen list Value with all the values of the ring buffer, in the
+ * order in which they were appended. The list is cached and shared by all
+ * callers until the ring buffer is modified again.
+ */
+sentry_value_t sentry__ringbuffer_to_list(sentry_ringbuffer_t *rb);
+
+#endif
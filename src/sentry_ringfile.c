@@ -0,0 +1,160 @@
+#include "sentry_ringfile.h"
+#include "sentry_alloc.h"
+#include "sentry_sync.h"
+
+#include <string.h>
+
+#define RINGFILE_MAGIC "SNTRYRNG"
+#define RINGFILE_VERSION 1
+
+/**
+ * The header at the start of the file. `written` counts all the records that
+ * were ever appended, so record `n` lives in slot `n % slot_count`.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t long_size;
+    volatile long written;
+} ringfile_header_t;
+
+/**
+ * Each slot starts with this header, followed by `len` bytes of the record.
+ * `seq` is `n + 1` for record `n` once it is completely written, and 0 while
+ * the slot is being overwritten.
+ */
+typedef struct {
+    volatile long seq;
+    volatile long len;
+} ringfile_slot_t;
+
+struct sentry_ringfile_s {
+    sentry_mmap_t mapping;
+    ringfile_header_t *header;
+    size_t slot_count;
+    size_t slot_size;
+};
+
+static ringfile_slot_t *
+ringfile_slot(const char *slots, size_t slot_size, size_t slot_count, long n)
+{
+    return (ringfile_slot_t *)(slots
+        + ((size_t)n % slot_count) * (sizeof(ringfile_slot_t) + slot_size));
+}
+
+sentry_ringfile_t *
+sentry__ringfile_new(
+    const sentry_path_t *path, size_t slot_count, size_t slot_size)
+{
+    // keep the slots aligned for their atomic header fields
+    slot_size = (slot_size + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+    if (!slot_count || !slot_size || slot_count > UINT32_MAX
+        || slot_size > UINT32_MAX
+        || slot_count > (SIZE_MAX - sizeof(ringfile_header_t))
+                / (sizeof(ringfile_slot_t) + slot_size)) {
+        return NULL;
+    }
+    sentry_ringfile_t *rf = SENTRY_MAKE(sentry_ringfile_t);
+    if (!rf) {
+        return NULL;
+    }
+    size_t len = sizeof(ringfile_header_t)
+        + slot_count * (sizeof(ringfile_slot_t) + slot_size);
+    if (!sentry__path_mmap_shared(&rf->mapping, path, len)) {
+        sentry_free(rf);
+        return NULL;
+    }
+    rf->slot_count = slot_count;
+    rf->slot_size = slot_size;
+
+    // the mapping starts out zeroed, so all the slots are empty
+    rf->header = rf->mapping.ptr;
+    memcpy(rf->header->magic, RINGFILE_MAGIC, sizeof(rf->header->magic));
+    rf->header->version = RINGFILE_VERSION;
+    rf->header->slot_count = (uint32_t)slot_count;
+    rf->header->slot_size = (uint32_t)slot_size;
+    rf->header->long_size = (uint32_t)sizeof(long);
+    return rf;
+}
+
+void
+sentry__ringfile_free(sentry_ringfile_t *rf)
+{
+    if (!rf) {
+        return;
+    }
+    sentry__mmap_close(&rf->mapping);
+    sentry_free(rf);
+}
+
+int
+sentry__ringfile_append(sentry_ringfile_t *rf, const char *buf, size_t len)
+{
+    if (len > rf->slot_size) {
+        return 1;
+    }
+    long n = sentry__atomic_fetch_and_add(&rf->header->written, 1);
+    ringfile_slot_t *slot = ringfile_slot((const char *)(rf->header + 1),
+        rf->slot_size, rf->slot_count, n);
+
+    sentry__atomic_store(&slot->seq, 0);
+    sentry__atomic_store(&slot->len, (long)len);
+    memcpy(slot + 1, buf, len);
+    sentry__atomic_store(&slot->seq, n + 1);
+    return 0;
+}
+
+int
+sentry__ringfile_read(
+    const sentry_ringfile_t *rf, sentry_stringbuilder_t *records)
+{
+    return sentry__ringfile_parse(rf->mapping.ptr, rf->mapping.len, records);
+}
+
+int
+sentry__ringfile_parse(
+    const char *buf, size_t buf_len, sentry_stringbuilder_t *records)
+{
+    if (!buf || buf_len < sizeof(ringfile_header_t)) {
+        return 1;
+    }
+    const ringfile_header_t *header = (const ringfile_header_t *)buf;
+    size_t slot_count = header->slot_count;
+    size_t slot_size = header->slot_size;
+    if (memcmp(header->magic, RINGFILE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != RINGFILE_VERSION
+        || header->long_size != sizeof(long) || !slot_count || !slot_size
+        || slot_size % sizeof(long) != 0
+        || (buf_len - sizeof(ringfile_header_t)) / slot_count
+            < sizeof(ringfile_slot_t) + slot_size) {
+        return 1;
+    }
+
+    // this may be a read-only mapping, so these are plain volatile reads
+    // instead of atomic ones
+    long written = header->written;
+    long oldest = (size_t)written > slot_count ? written - (long)slot_count : 0;
+    for (long n = oldest; n < written; n++) {
+        const ringfile_slot_t *slot
+            = ringfile_slot(buf + sizeof(ringfile_header_t), slot_size,
+                slot_count, n);
+        long seq = slot->seq;
+        long len = slot->len;
+        if (seq != n + 1 || len < 0 || (size_t)len > slot_size) {
+            continue;
+        }
+        size_t records_len = sentry__stringbuilder_len(records);
+        if (sentry__stringbuilder_append_buf(
+                records, (const char *)(slot + 1), (size_t)len)
+            != 0) {
+            return 1;
+        }
+        // the slot was overwritten while copying it
+        if (slot->seq != seq) {
+            sentry__stringbuilder_set_len(records, records_len);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef SENTRY_RINGFILE_H_INCLUDED
+#define SENTRY_RINGFILE_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_path.h"
+#include "sentry_string.h"
+
+/**
+ * A ring of fixed-size record slots, living in a file that is mapped into
+ * memory. Appending a record is a plain copy into the mapping without any
+ * syscall, and the most recent records survive a crash of the process.
+ *
+ * The file starts with a header describing the slots, which is followed by
+ * `slot_count` slots of `slot_size` bytes. The header and slots use the native
+ * byte order and `long` width, so they can only be parsed on the same machine.
+ */
+typedef struct sentry_ringfile_s sentry_ringfile_t;
+
+/**
+ * Creates or truncates the file at `path`, and maps a ring of `slot_count`
+ * slots into memory, which can each hold a record of up to `slot_size` bytes.
+ * Returns `NULL` on failure.
+ */
+sentry_ringfile_t *sentry__ringfile_new(
+    const sentry_path_t *path, size_t slot_count, size_t slot_size);
+
+/**
+ * Unmaps the ring. The file itself is left in place.
+ */
+void sentry__ringfile_free(sentry_ringfile_t *rf);
+
+/**
+ * Appends a copy of the `len` bytes at `buf` as a record to the ring,
+ * replacing the oldest record once the ring is full. This is safe to call from
+ * multiple threads concurrently.
+ * Returns 0 on success, and 1 if the record does not fit into a slot.
+ */
+int sentry__ringfile_append(sentry_ringfile_t *rf, const char *buf, size_t len);
+
+/**
+ * Appends the records of the ring to `records`, from the oldest to the most
+ * recent one. Records which are concurrently being written are skipped.
+ * Returns 0 on success.
+ */
+int sentry__ringfile_read(
+    const sentry_ringfile_t *rf, sentry_stringbuilder_t *records);
+
+/**
+ * Like `sentry__ringfile_read`, but parses the `buf_len` bytes of a ring file
+ * that were mapped or read from disk. Returns 1 if the content is not a valid
+ * ring file.
+ */
+int sentry__ringfile_parse(
+    const char *buf, size_t buf_len, sentry_stringbuilder_t *records);
+
+#endif
@@ -0,0 +1,125 @@
+#include "sentry_sampling.h"
+#include "sentry_alloc.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+
+#include <string.h>
+
+#define SAMPLER_CACHE_ENTRIES 64
+
+typedef struct {
+    uint64_t hash;
+    char *name;
+    char *op;
+    double rate;
+    // 0 marks an empty entry
+    uint64_t expires_at;
+} sampler_cache_entry_t;
+
+struct sentry_sampler_cache_s {
+    sentry_mutex_t lock;
+    uint64_t ttl_ms;
+    sampler_cache_entry_t entries[SAMPLER_CACHE_ENTRIES];
+};
+
+static uint64_t
+hash_str(uint64_t hash, const char *str)
+{
+    // the terminating null byte is hashed as well, so that a name and an op
+    // can not be shifted into each other
+    const char *ptr = str ? str : "";
+    do {
+        hash ^= (unsigned char)*ptr;
+        hash *= 1099511628211u;
+    } while (*ptr++);
+    return hash;
+}
+
+static uint64_t
+hash_key(const char *name, const char *op)
+{
+    return hash_str(hash_str(14695981039346656037u, name), op);
+}
+
+static bool
+entry_matches(const sampler_cache_entry_t *entry, uint64_t hash,
+    const char *name, const char *op)
+{
+    return entry->expires_at && entry->hash == hash
+        && sentry__string_eq(entry->name, name ? name : "")
+        && sentry__string_eq(entry->op, op ? op : "");
+}
+
+sentry_sampler_cache_t *
+sentry__sampler_cache_new(uint64_t ttl_ms)
+{
+    sentry_sampler_cache_t *cache = SENTRY_MAKE(sentry_sampler_cache_t);
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(sentry_sampler_cache_t));
+    sentry__mutex_init(&cache->lock);
+    cache->ttl_ms = ttl_ms;
+    return cache;
+}
+
+void
+sentry__sampler_cache_free(sentry_sampler_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < SAMPLER_CACHE_ENTRIES; i++) {
+        sentry_free(cache->entries[i].name);
+        sentry_free(cache->entries[i].op);
+    }
+    sentry__mutex_free(&cache->lock);
+    sentry_free(cache);
+}
+
+bool
+sentry__sampler_cache_get(sentry_sampler_cache_t *cache, const char *name,
+    const char *op, uint64_t now, double *rate_out)
+{
+    uint64_t hash = hash_key(name, op);
+    bool found = false;
+    sentry__mutex_lock(&cache->lock);
+    sampler_cache_entry_t *entry
+        = &cache->entries[hash % SAMPLER_CACHE_ENTRIES];
+    if (entry_matches(entry, hash, name, op) && now < entry->expires_at) {
+        *rate_out = entry->rate;
+        found = true;
+    }
+    sentry__mutex_unlock(&cache->lock);
+    return found;
+}
+
+void
+sentry__sampler_cache_put(sentry_sampler_cache_t *cache, const char *name,
+    const char *op, uint64_t now, double rate)
+{
+    uint64_t hash = hash_key(name, op);
+    sentry__mutex_lock(&cache->lock);
+    sampler_cache_entry_t *entry
+        = &cache->entries[hash % SAMPLER_CACHE_ENTRIES];
+    if (!entry_matches(entry, hash, name, op)) {
+        char *entry_name = sentry__string_clone(name ? name : "");
+        char *entry_op = sentry__string_clone(op ? op : "");
+        if (!entry_name || !entry_op) {
+            sentry_free(entry_name);
+            sentry_free(entry_op);
+            sentry__mutex_unlock(&cache->lock);
+            return;
+        }
+        sentry_free(entry->name);
+        sentry_free(entry->op);
+        entry->hash = hash;
+        entry->name = entry_name;
+        entry->op = entry_op;
+    }
+    entry->rate = rate;
+    // an entry that expires at 0 would count as empty
+    uint64_t expires_at = now + cache->ttl_ms;
+    entry->expires_at = expires_at ? expires_at : 1;
+    sentry__mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,41 @@
+#ifndef SENTRY_SAMPLING_H_INCLUDED
+#define SENTRY_SAMPLING_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * A cache of the sample rates that the `traces_sampler` returned, keyed by
+ * the name and operation of a transaction. It has a fixed number of entries,
+ * and a name and operation whose entry is taken by another one just calls the
+ * sampler again.
+ */
+typedef struct sentry_sampler_cache_s sentry_sampler_cache_t;
+
+/**
+ * Creates a cache whose sample rates expire `ttl_ms` milliseconds after they
+ * were inserted.
+ */
+sentry_sampler_cache_t *sentry__sampler_cache_new(uint64_t ttl_ms);
+
+/**
+ * Frees the `cache`.
+ */
+void sentry__sampler_cache_free(sentry_sampler_cache_t *cache);
+
+/**
+ * Looks up the sample rate that was inserted for `name` and `op`, which may
+ * both be `NULL`, and that did not expire by `now`, in monotonic
+ * milliseconds. Returns false if there is none.
+ * This is safe to call from multiple threads concurrently.
+ */
+bool sentry__sampler_cache_get(sentry_sampler_cache_t *cache, const char *name,
+    const char *op, uint64_t now, double *rate_out);
+
+/**
+ * Inserts the sample `rate` for `name` and `op` at `now`, replacing whatever
+ * was in its entry.
+ */
+void sentry__sampler_cache_put(sentry_sampler_cache_t *cache, const char *name,
+    const char *op, uint64_t now, double rate);
+
+#endif
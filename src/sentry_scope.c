@@ -1,12 +1,15 @@
 #include "sentry_scope.h"
+#include "sentry_alloc.h"
 #include "sentry_backend.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
+#include "sentry_modulefinder.h"
 #include "sentry_options.h"
 #include "sentry_os.h"
 #include "sentry_string.h"
 #include "sentry_symbolizer.h"
 #include "sentry_sync.h"
+#include "sentry_tracepoint.h"
 #include "sentry_tracing.h"
 #include "sentry_value.h"
 
@@ -20,9 +23,80 @@
 #    define SENTRY_BACKEND "inproc"
 #endif
 
-static bool g_scope_initialized = false;
+static volatile long g_scope_initialized = 0;
 static sentry_scope_t g_scope = { 0 };
-static sentry_mutex_t g_lock = SENTRY__MUTEX_INIT;
+static sentry_rwlock_t g_lock = SENTRY__RWLOCK_INIT;
+
+// The rwlock is not recursive, so nested locks on the same thread are counted
+// here and only the outermost one actually locks.
+static SENTRY_THREAD_LOCAL long g_lock_depth = 0;
+static SENTRY_THREAD_LOCAL bool g_lock_exclusive = false;
+#ifdef SENTRY_WITH_MEMORY_TAGS
+// What is allocated while holding the exclusive lock is attributed to the
+// scope, and the tag that was current before is restored on unlock.
+static SENTRY_THREAD_LOCAL sentry_memory_tag_t g_lock_previous_memory_tag
+    = SENTRY_MEMORY_TAG_OTHER;
+#endif
+
+// Set once all the copy-on-write values of the scope have been frozen for
+// concurrent readers, and reset by every writer. The freezing itself is
+// serialized on `g_freeze_lock`.
+static volatile long g_scope_frozen = 0;
+static sentry_mutex_t g_freeze_lock = SENTRY__MUTEX_INIT;
+
+// The sections of the scope that are passed to
+// `sentry__value_cache_serialized` when freezing, so that events serialize
+// them only once per change. These hold a reference, and are only accessed
+// under `g_freeze_lock`.
+typedef enum {
+    SECTION_USER,
+    SECTION_TAGS,
+    SECTION_EXTRA,
+    SECTION_CONTEXTS,
+    SECTION_SDK,
+    SECTION_COUNT,
+} scope_section_t;
+static sentry_value_t g_cached_sections[SECTION_COUNT] = { { 0 } };
+
+// Set once the system contexts are part of the contexts of the scope, see
+// `sentry__scope_add_system_contexts`. Until then, every event gets them added
+// on its own.
+static volatile long g_system_contexts_added = 0;
+
+static SENTRY_THREAD_LOCAL sentry_thread_scope_t *g_thread_scope = NULL;
+
+/**
+ * Replaces the cached `section` with `value`, unless it is cached already.
+ * Sections that changed are copy-on-write and get a new Value, so comparing
+ * them is enough to tell whether they need to be serialized again.
+ */
+static void
+cache_section(scope_section_t section, sentry_value_t value)
+{
+    sentry_value_t *cached = &g_cached_sections[section];
+    if (cached->_bits == value._bits) {
+        return;
+    }
+    sentry__value_uncache_serialized(*cached);
+    sentry_value_decref(*cached);
+    sentry_value_incref(value);
+    *cached = value;
+    if (!sentry_value_is_null(value)) {
+        sentry__value_cache_serialized(value);
+    }
+}
+
+static void
+uncache_sections(void)
+{
+    sentry__mutex_lock(&g_freeze_lock);
+    for (size_t i = 0; i < SECTION_COUNT; i++) {
+        sentry__value_uncache_serialized(g_cached_sections[i]);
+        sentry_value_decref(g_cached_sections[i]);
+        g_cached_sections[i]._bits = 0;
+    }
+    sentry__mutex_unlock(&g_freeze_lock);
+}
 
 static sentry_value_t
 get_client_sdk(void)
@@ -58,10 +132,29 @@ get_client_sdk(void)
     return client_sdk;
 }
 
+sentry_value_t
+sentry__scope_new_event_header(const sentry_options_t *options)
+{
+    sentry_value_t header = sentry_value_new_object();
+    sentry_value_set_by_key(
+        header, SENTRY_KEY(platform), sentry_value_new_string("native"));
+    const char *keys[] = { "release", "dist", "environment" };
+    const char *values[]
+        = { options->release, options->dist, options->environment };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (values[i] && *values[i]) {
+            sentry_value_set_by_key(
+                header, keys[i], sentry_value_new_string(values[i]));
+        }
+    }
+    sentry_value_freeze(header);
+    return header;
+}
+
 static sentry_scope_t *
 get_scope(void)
 {
-    if (g_scope_initialized) {
+    if (sentry__atomic_fetch(&g_scope_initialized)) {
         return &g_scope;
     }
 
@@ -72,14 +165,13 @@ get_scope(void)
     g_scope.tags = sentry_value_new_object();
     g_scope.extra = sentry_value_new_object();
     g_scope.contexts = sentry_value_new_object();
-    sentry_value_set_by_key(g_scope.contexts, "os", sentry__get_os_context());
-    g_scope.breadcrumbs = sentry_value_new_list();
+    g_scope.breadcrumbs = sentry__ringbuffer_new(SENTRY_BREADCRUMBS_MAX);
     g_scope.level = SENTRY_LEVEL_ERROR;
     g_scope.client_sdk = get_client_sdk();
     g_scope.transaction_object = NULL;
     g_scope.span = NULL;
 
-    g_scope_initialized = true;
+    sentry__atomic_store(&g_scope_initialized, 1);
 
     return &g_scope;
 }
@@ -87,34 +179,183 @@ get_scope(void)
 void
 sentry__scope_cleanup(void)
 {
-    sentry__mutex_lock(&g_lock);
-    if (g_scope_initialized) {
-        g_scope_initialized = false;
+    sentry__rwlock_lock(&g_lock);
+    if (sentry__atomic_fetch(&g_scope_initialized)) {
+        sentry__atomic_store(&g_scope_initialized, 0);
+        sentry__atomic_store(&g_scope_frozen, 0);
+        sentry__atomic_store(&g_system_contexts_added, 0);
         sentry_free(g_scope.transaction);
         sentry_value_decref(g_scope.fingerprint);
         sentry_value_decref(g_scope.user);
         sentry_value_decref(g_scope.tags);
         sentry_value_decref(g_scope.extra);
         sentry_value_decref(g_scope.contexts);
-        sentry_value_decref(g_scope.breadcrumbs);
+        sentry__ringbuffer_free(g_scope.breadcrumbs);
         sentry_value_decref(g_scope.client_sdk);
         sentry__transaction_decref(g_scope.transaction_object);
         sentry__span_decref(g_scope.span);
     }
-    sentry__mutex_unlock(&g_lock);
+    sentry__rwlock_unlock(&g_lock);
+    uncache_sections();
+}
+
+size_t
+sentry__scope_get_memory_usage(const sentry_scope_t *scope)
+{
+    size_t size = sizeof(sentry_scope_t)
+        + sentry__value_get_memory_usage(scope->fingerprint)
+        + sentry__value_get_memory_usage(scope->user)
+        + sentry__value_get_memory_usage(scope->tags)
+        + sentry__value_get_memory_usage(scope->extra)
+        + sentry__value_get_memory_usage(scope->contexts)
+        + sentry__ringbuffer_get_memory_usage(scope->breadcrumbs)
+        + sentry__value_get_memory_usage(scope->client_sdk);
+    if (scope->transaction) {
+        size += strlen(scope->transaction) + 1;
+    }
+    return size;
+}
+
+size_t
+sentry__scope_get_transaction_memory_usage(const sentry_scope_t *scope)
+{
+    size_t size = 0;
+    if (scope->transaction_object) {
+        size += sentry__transaction_get_memory_usage(scope->transaction_object);
+    }
+    if (scope->span) {
+        size += sizeof(sentry_span_t)
+            + sentry__value_get_memory_usage(scope->span->inner);
+        if (scope->span->transaction) {
+            size += sentry__transaction_get_memory_usage(
+                scope->span->transaction);
+        }
+    }
+    return size;
 }
 
 sentry_scope_t *
 sentry__scope_lock(void)
 {
-    sentry__mutex_lock(&g_lock);
+    if (g_lock_depth++ == 0) {
+        SENTRY_TRACEPOINT1(scope__lock__wait, 1);
+        sentry__rwlock_lock(&g_lock);
+        SENTRY_TRACEPOINT1(scope__lock__acquire, 1);
+        g_lock_exclusive = true;
+#ifdef SENTRY_WITH_MEMORY_TAGS
+        g_lock_previous_memory_tag
+            = sentry__memory_tag_enter(SENTRY_MEMORY_TAG_SCOPE);
+#endif
+    }
     return get_scope();
 }
 
+static void
+freeze_scope(sentry_scope_t *scope)
+{
+    sentry__mutex_lock(&g_freeze_lock);
+    if (!sentry__atomic_fetch(&g_scope_frozen)) {
+        // this also freezes all of them
+        cache_section(SECTION_USER, scope->user);
+        cache_section(SECTION_TAGS, scope->tags);
+        cache_section(SECTION_EXTRA, scope->extra);
+        cache_section(SECTION_CONTEXTS, scope->contexts);
+        cache_section(SECTION_SDK, scope->client_sdk);
+        // this caches the list inside the ring buffer
+        sentry_value_decref(sentry__ringbuffer_to_list(scope->breadcrumbs));
+        sentry__atomic_store(&g_scope_frozen, 1);
+    }
+    sentry__mutex_unlock(&g_freeze_lock);
+}
+
+const sentry_scope_t *
+sentry__scope_lock_shared(void)
+{
+    if (g_lock_depth++ > 0) {
+        return get_scope();
+    }
+    g_lock_exclusive = false;
+    SENTRY_TRACEPOINT1(scope__lock__wait, 0);
+    sentry__rwlock_lock_shared(&g_lock);
+    // the scope is lazily created, which needs the exclusive lock
+    while (!sentry__atomic_fetch(&g_scope_initialized)) {
+        sentry__rwlock_unlock_shared(&g_lock);
+        sentry__rwlock_lock(&g_lock);
+        get_scope();
+        sentry__rwlock_unlock(&g_lock);
+        sentry__rwlock_lock_shared(&g_lock);
+    }
+    if (!sentry__atomic_fetch(&g_scope_frozen)) {
+        freeze_scope(&g_scope);
+    }
+    SENTRY_TRACEPOINT1(scope__lock__acquire, 0);
+    return &g_scope;
+}
+
 void
 sentry__scope_unlock(void)
 {
-    sentry__mutex_unlock(&g_lock);
+    if (--g_lock_depth > 0) {
+        return;
+    }
+    if (g_lock_exclusive) {
+#ifdef SENTRY_WITH_MEMORY_TAGS
+        sentry__memory_tag_leave(g_lock_previous_memory_tag);
+#endif
+        sentry__atomic_store(&g_scope_frozen, 0);
+        sentry__rwlock_unlock(&g_lock);
+    } else {
+        sentry__rwlock_unlock_shared(&g_lock);
+    }
+}
+
+#ifdef SENTRY_PLATFORM_UNIX
+void
+sentry__scope_unlock_after_fork(void)
+{
+    g_lock_depth = 0;
+    g_lock_exclusive = false;
+#    ifdef SENTRY_WITH_MEMORY_TAGS
+    sentry__memory_tag_leave(g_lock_previous_memory_tag);
+#    endif
+    sentry__atomic_store(&g_scope_frozen, 0);
+    sentry_rwlock_t lock = SENTRY__RWLOCK_INIT;
+    g_lock = lock;
+}
+#endif
+
+/**
+ * Adds the members of `src` that `dst` does not have yet to it.
+ */
+static void
+add_missing_members(sentry_value_t dst, sentry_value_t src)
+{
+    for (size_t i = 0;; i++) {
+        const char *key;
+        sentry_value_t value = sentry__value_get_pair_by_index(src, i, &key);
+        if (!key) {
+            break;
+        }
+        if (sentry_value_is_null(sentry_value_get_by_key(dst, key))) {
+            sentry_value_incref(value);
+            sentry_value_set_by_key(dst, key, value);
+        }
+    }
+}
+
+void
+sentry__scope_add_system_contexts(void)
+{
+    // computing them may take a while, so this happens outside of the lock
+    sentry_value_t system_contexts = sentry__get_system_contexts();
+    SENTRY_WITH_SCOPE_MUT_NO_FLUSH (scope) {
+        if (!sentry__atomic_fetch(&g_system_contexts_added)) {
+            sentry__value_make_mutable(&scope->contexts);
+            add_missing_members(scope->contexts, system_contexts);
+            sentry__atomic_store(&g_system_contexts_added, 1);
+        }
+    }
+    sentry_value_decref(system_contexts);
 }
 
 void
@@ -130,9 +371,61 @@ sentry__scope_flush_unlock()
     }
 }
 
+sentry_thread_scope_t *
+sentry__thread_scope_get(void)
+{
+    if (g_thread_scope) {
+        return g_thread_scope;
+    }
+    sentry_thread_scope_t *thread_scope = SENTRY_MAKE(sentry_thread_scope_t);
+    if (!thread_scope) {
+        return NULL;
+    }
+    thread_scope->tags = sentry_value_new_object();
+    thread_scope->extra = sentry_value_new_object();
+    g_thread_scope = thread_scope;
+    return thread_scope;
+}
+
+void
+sentry__thread_scope_clear(void)
+{
+    sentry_thread_scope_t *thread_scope = g_thread_scope;
+    if (!thread_scope) {
+        return;
+    }
+    g_thread_scope = NULL;
+    sentry_value_decref(thread_scope->tags);
+    sentry_value_decref(thread_scope->extra);
+    sentry_free(thread_scope);
+}
+
+bool
+sentry__thread_scope_has_values(void)
+{
+    return g_thread_scope
+        && (sentry_value_get_length(g_thread_scope->tags)
+            || sentry_value_get_length(g_thread_scope->extra));
+}
+
+static void
+merge_thread_values(sentry_value_t event, const char *key, sentry_value_t src)
+{
+    if (sentry_value_get_length(src) == 0) {
+        return;
+    }
+    // the event may still share the frozen scope values at this point
+    sentry_value_t dst = sentry__value_get_mutable_by_key(event, key);
+    if (sentry_value_is_null(dst)) {
+        dst = sentry_value_new_object();
+        sentry_value_set_by_key(event, key, dst);
+    }
+    sentry__value_merge_objects(dst, src);
+}
+
 static void
-sentry__foreach_stacktrace(
-    sentry_value_t event, void (*func)(sentry_value_t stacktrace))
+sentry__foreach_stacktrace(sentry_value_t event,
+    void (*func)(sentry_value_t stacktrace, void *data), void *data)
 {
     // We have stacktraces at the following locations:
     // * `exception[.values].X.stacktrace`:
@@ -150,7 +443,7 @@ sentry__foreach_stacktrace(
             sentry_value_t stacktrace = sentry_value_get_by_key(
                 sentry_value_get_by_index(exception, i), "stacktrace");
             if (!sentry_value_is_null(stacktrace)) {
-                func(stacktrace);
+                func(stacktrace, data);
             }
         }
     }
@@ -165,54 +458,45 @@ sentry__foreach_stacktrace(
             sentry_value_t stacktrace = sentry_value_get_by_key(
                 sentry_value_get_by_index(threads, i), "stacktrace");
             if (!sentry_value_is_null(stacktrace)) {
-                func(stacktrace);
+                func(stacktrace, data);
             }
         }
     }
 }
 
+/**
+ * All the frames of an event that are to be symbolized, to be passed to the
+ * symbolizer as one batch.
+ */
+typedef struct {
+    sentry_value_t *frames;
+    void **addrs;
+    size_t len;
+    size_t cap;
+    // frozen frames are shared, and can not be symbolized in place
+    bool skip_frozen;
+} frame_batch_t;
+
 static void
-sentry__symbolize_frame(const sentry_frame_info_t *info, void *data)
+count_stacktrace_frames(sentry_value_t stacktrace, void *data)
 {
-    // See https://develop.sentry.dev/sdk/event-payloads/stacktrace/
-    sentry_value_t frame = *(sentry_value_t *)data;
-
-    if (info->symbol
-        && sentry_value_is_null(sentry_value_get_by_key(frame, "function"))) {
-        sentry_value_set_by_key(
-            frame, "function", sentry_value_new_string(info->symbol));
-    }
-
-    if (info->object_name
-        && sentry_value_is_null(sentry_value_get_by_key(frame, "package"))) {
-        sentry_value_set_by_key(
-            frame, "package", sentry_value_new_string(info->object_name));
-    }
-
-    if (info->symbol_addr
-        && sentry_value_is_null(
-            sentry_value_get_by_key(frame, "symbol_addr"))) {
-        sentry_value_set_by_key(frame, "symbol_addr",
-            sentry__value_new_addr((uint64_t)(size_t)info->symbol_addr));
-    }
-
-    if (info->load_addr
-        && sentry_value_is_null(sentry_value_get_by_key(frame, "image_addr"))) {
-        sentry_value_set_by_key(frame, "image_addr",
-            sentry__value_new_addr((uint64_t)(size_t)info->load_addr));
-    }
+    frame_batch_t *batch = data;
+    batch->cap += sentry_value_get_length(
+        sentry_value_get_by_key(stacktrace, "frames"));
 }
 
 static void
-sentry__symbolize_stacktrace(sentry_value_t stacktrace)
+collect_stacktrace_frames(sentry_value_t stacktrace, void *data)
 {
+    frame_batch_t *batch = data;
     sentry_value_t frames = sentry_value_get_by_key(stacktrace, "frames");
-    if (sentry_value_get_type(frames) != SENTRY_VALUE_TYPE_LIST) {
+    if (sentry_value_get_type(frames) != SENTRY_VALUE_TYPE_LIST
+        || (batch->skip_frozen && sentry_value_is_frozen(frames))) {
         return;
     }
 
     size_t len = sentry_value_get_length(frames);
-    for (size_t i = 0; i < len; i++) {
+    for (size_t i = 0; i < len && batch->len < batch->cap; i++) {
         sentry_value_t frame = sentry_value_get_by_index(frames, i);
 
         sentry_value_t addr_value
@@ -221,21 +505,115 @@ sentry__symbolize_stacktrace(sentry_value_t stacktrace)
             continue;
         }
 
-        // The addr is saved as a hex-number inside the value.
-        size_t addr
-            = (size_t)strtoll(sentry_value_as_string(addr_value), NULL, 0);
+        size_t addr = (size_t)sentry__value_as_addr(addr_value);
         if (!addr) {
             continue;
         }
-        sentry__symbolize((void *)addr, sentry__symbolize_frame, &frame);
+        batch->frames[batch->len] = frame;
+        batch->addrs[batch->len] = (void *)addr;
+        batch->len++;
     }
 }
 
+static void
+use_symbolized_frames(sentry_value_t stacktrace, void *UNUSED(data))
+{
+    sentry_value_t frames = sentry_value_get_by_key(stacktrace, "frames");
+    if (sentry_value_get_type(frames) != SENTRY_VALUE_TYPE_LIST
+        || !sentry_value_is_frozen(frames)) {
+        return;
+    }
+    sentry_value_t symbolized = sentry__symbolizer_symbolize_frames(frames);
+    if (!sentry_value_is_null(symbolized)) {
+        sentry_value_set_by_key(stacktrace, "frames", symbolized);
+    }
+}
+
+static void
+symbolize_batch_frame(const sentry_frame_info_t *info, size_t index, void *data)
+{
+    frame_batch_t *batch = data;
+    sentry__symbolize_frame(info, &batch->frames[index]);
+}
+
+void
+sentry__symbolize_stacktraces(sentry_value_t event)
+{
+    // the frames of all the exception and thread stacktraces are symbolized
+    // in one go, so the symbolizer can group them by module
+    // interned stacktraces are swapped for their shared symbolized frames
+    sentry__foreach_stacktrace(event, use_symbolized_frames, NULL);
+
+    frame_batch_t batch = { NULL, NULL, 0, 0, true };
+    sentry__foreach_stacktrace(event, count_stacktrace_frames, &batch);
+    if (!batch.cap) {
+        return;
+    }
+    batch.frames = sentry_malloc(sizeof(sentry_value_t) * batch.cap);
+    batch.addrs = sentry_malloc(sizeof(void *) * batch.cap);
+    if (batch.frames && batch.addrs) {
+        sentry__foreach_stacktrace(event, collect_stacktrace_frames, &batch);
+        sentry__symbolize_many(
+            batch.addrs, batch.len, symbolize_batch_frame, &batch);
+    }
+    sentry_free(batch.frames);
+    sentry_free(batch.addrs);
+}
+
+/**
+ * Returns a new list of the modules in `modules` which contain any of the
+ * instruction addresses in the stacktraces of `event`, in their original order.
+ */
+static sentry_value_t
+referenced_images(sentry_value_t modules, sentry_value_t event)
+{
+    sentry_value_t images = sentry_value_new_list();
+    frame_batch_t batch = { NULL, NULL, 0, 0, false };
+    sentry__foreach_stacktrace(event, count_stacktrace_frames, &batch);
+    size_t modules_len = sentry_value_get_length(modules);
+    if (!batch.cap || !modules_len) {
+        return images;
+    }
+    batch.frames = sentry_malloc(sizeof(sentry_value_t) * batch.cap);
+    batch.addrs = sentry_malloc(sizeof(void *) * batch.cap);
+    bool *referenced = sentry_malloc(sizeof(bool) * modules_len);
+    if (!batch.frames || !batch.addrs || !referenced) {
+        goto done;
+    }
+    sentry__foreach_stacktrace(event, collect_stacktrace_frames, &batch);
+    memset(referenced, 0, sizeof(bool) * modules_len);
+
+    sentry_module_index_t *index = sentry__module_index_get(modules);
+    for (size_t i = 0; index && i < batch.len; i++) {
+        uint64_t addr = (uint64_t)(size_t)batch.addrs[i];
+        const sentry_module_range_t *range
+            = sentry__module_index_find(index, addr);
+        if (range) {
+            referenced[range->index] = true;
+        }
+    }
+    sentry__module_index_decref(index);
+
+    for (size_t i = 0; i < modules_len; i++) {
+        if (referenced[i]) {
+            sentry_value_t module = sentry_value_get_by_index(modules, i);
+            sentry_value_incref(module);
+            sentry_value_append(images, module);
+        }
+    }
+
+done:
+    sentry_free(batch.frames);
+    sentry_free(batch.addrs);
+    sentry_free(referenced);
+    return images;
+}
+
 sentry_value_t
 sentry__get_span_or_transaction(const sentry_scope_t *scope)
 {
     if (scope->span) {
-        return scope->span->inner;
+        return sentry__span_get_trace_value(scope->span);
     } else if (scope->transaction_object) {
         return scope->transaction_object->inner;
     } else {
@@ -247,10 +625,11 @@ sentry__get_span_or_transaction(const sentry_scope_t *scope)
 sentry_value_t
 sentry__scope_get_span_or_transaction()
 {
+    sentry_value_t rv = sentry_value_new_null();
     SENTRY_WITH_SCOPE (scope) {
-        return sentry__get_span_or_transaction(scope);
+        rv = sentry__get_span_or_transaction(scope);
     }
-    return sentry_value_new_null();
+    return rv;
 }
 #endif
 
@@ -274,18 +653,31 @@ sentry__scope_apply_to_event(const sentry_scope_t *scope,
             SET(Key, Source);                                                  \
         }                                                                      \
     } while (0)
-#define PLACE_CLONED_VALUE(Key, Source)                                        \
+#define PLACE_FROZEN_VALUE(Key, Source)                                        \
     do {                                                                       \
         if (IS_NULL(Key) && !sentry_value_is_null(Source)) {                   \
-            SET(Key, sentry__value_clone(Source));                             \
+            sentry_value_freeze(Source);                                       \
+            sentry_value_incref(Source);                                       \
+            SET(Key, Source);                                                  \
         }                                                                      \
     } while (0)
 
-    PLACE_STRING("platform", "native");
-
-    PLACE_STRING("release", options->release);
-    PLACE_STRING("dist", options->dist);
-    PLACE_STRING("environment", options->environment);
+    // options that did not go through `sentry_init` have no header yet
+    sentry_value_t header = options->event_header;
+    if (!header._bits) {
+        header = sentry__scope_new_event_header(options);
+    } else {
+        sentry_value_incref(header);
+    }
+    const char *key;
+    sentry_value_t value;
+    for (size_t i = 0;
+        !sentry_value_is_null(
+            value = sentry__value_get_pair_by_index(header, i, &key));
+        i++) {
+        PLACE_VALUE(key, value);
+    }
+    sentry_value_decref(header);
 
     // is not transaction and has no level
     if (IS_NULL("type") && IS_NULL("level")) {
@@ -300,7 +692,7 @@ sentry__scope_apply_to_event(const sentry_scope_t *scope,
     sentry_value_t event_tags = sentry_value_get_by_key(event, "tags");
     if (sentry_value_is_null(event_tags)) {
         if (!sentry_value_is_null(scope->tags)) {
-            PLACE_CLONED_VALUE("tags", scope->tags);
+            PLACE_FROZEN_VALUE("tags", scope->tags);
         }
     } else {
         sentry__value_merge_objects(event_tags, scope->tags);
@@ -308,25 +700,41 @@ sentry__scope_apply_to_event(const sentry_scope_t *scope,
     sentry_value_t event_extra = sentry_value_get_by_key(event, "extra");
     if (sentry_value_is_null(event_extra)) {
         if (!sentry_value_is_null(scope->extra)) {
-            PLACE_CLONED_VALUE("extra", scope->extra);
+            PLACE_FROZEN_VALUE("extra", scope->extra);
         }
     } else {
         sentry__value_merge_objects(event_extra, scope->extra);
     }
 
-    sentry_value_t contexts = sentry__value_clone(scope->contexts);
+    if ((mode & SENTRY_SCOPE_THREAD) && g_thread_scope) {
+        merge_thread_values(event, "tags", g_thread_scope->tags);
+        merge_thread_values(event, "extra", g_thread_scope->extra);
+    }
 
     // prep contexts sourced from scope; data about transaction on scope needs
-    // to be extracted and inserted
+    // to be extracted and inserted, otherwise they can be shared as-is
+    sentry_value_t contexts;
     sentry_value_t scope_trace = sentry__value_get_trace_context(
         sentry__get_span_or_transaction(scope));
-    if (!sentry_value_is_null(scope_trace)) {
+    if (sentry_value_is_null(scope_trace)) {
+        sentry_value_freeze(scope->contexts);
+        sentry_value_incref(scope->contexts);
+        contexts = scope->contexts;
+    } else {
+        contexts = sentry__value_clone(scope->contexts);
         if (sentry_value_is_null(contexts)) {
             contexts = sentry_value_new_object();
         }
         sentry_value_set_by_key(contexts, "trace", scope_trace);
     }
 
+    if (!sentry__atomic_fetch(&g_system_contexts_added)) {
+        sentry__value_make_mutable(&contexts);
+        sentry_value_t system_contexts = sentry__get_system_contexts();
+        add_missing_members(contexts, system_contexts);
+        sentry_value_decref(system_contexts);
+    }
+
     // merge contexts sourced from scope into the event
     sentry_value_t event_contexts = sentry_value_get_by_key(event, "contexts");
     if (sentry_value_is_null(event_contexts)) {
@@ -337,11 +745,36 @@ sentry__scope_apply_to_event(const sentry_scope_t *scope,
     sentry_value_decref(contexts);
 
     if (mode & SENTRY_SCOPE_BREADCRUMBS) {
-        PLACE_CLONED_VALUE("breadcrumbs", scope->breadcrumbs);
+        if (IS_NULL("breadcrumbs")) {
+            SET("breadcrumbs", sentry__ringbuffer_to_list(scope->breadcrumbs));
+        }
     }
 
+    sentry__apply_debug_info_to_event(options, event, mode);
+
+#undef PLACE_FROZEN_VALUE
+#undef PLACE_VALUE
+#undef PLACE_STRING
+#undef SET
+#undef IS_NULL
+}
+
+void
+sentry__apply_debug_info_to_event(const sentry_options_t *options,
+    sentry_value_t event, sentry_scope_mode_t mode)
+{
     if (mode & SENTRY_SCOPE_MODULES) {
         sentry_value_t modules = sentry_get_modules_list();
+        if (!sentry_value_is_null(modules) && options
+            && options->only_referenced_images) {
+            sentry_value_t images = referenced_images(modules, event);
+            sentry_value_decref(modules);
+            modules = images;
+            if (!sentry_value_get_length(modules)) {
+                sentry_value_decref(modules);
+                modules = sentry_value_new_null();
+            }
+        }
         if (!sentry_value_is_null(modules)) {
             sentry_value_t debug_meta = sentry_value_new_object();
             sentry_value_set_by_key(debug_meta, "images", modules);
@@ -350,12 +783,6 @@ sentry__scope_apply_to_event(const sentry_scope_t *scope,
     }
 
     if (mode & SENTRY_SCOPE_STACKTRACES) {
-        sentry__foreach_stacktrace(event, sentry__symbolize_stacktrace);
+        sentry__symbolize_stacktraces(event);
     }
-
-#undef PLACE_CLONED_VALUE
-#undef PLACE_VALUE
-#undef PLACE_STRING
-#undef SET
-#undef IS_NULL
 }
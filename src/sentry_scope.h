@@ -3,6 +3,7 @@
 
 #include "sentry_boot.h"
 
+#include "sentry_ringbuffer.h"
 #include "sentry_session.h"
 #include "sentry_value.h"
 
@@ -16,7 +17,7 @@ typedef struct sentry_scope_s {
     sentry_value_t tags;
     sentry_value_t extra;
     sentry_value_t contexts;
-    sentry_value_t breadcrumbs;
+    sentry_ringbuffer_t *breadcrumbs;
     sentry_level_t level;
     sentry_value_t client_sdk;
 
@@ -32,6 +33,16 @@ typedef struct sentry_scope_s {
     sentry_span_t *span;
 } sentry_scope_t;
 
+/**
+ * Tags and extra set via `sentry_set_thread_tag` and friends, which only apply
+ * to the events captured on the thread that set them. These are owned by that
+ * thread, so they are accessed without any locking.
+ */
+typedef struct sentry_thread_scope_s {
+    sentry_value_t tags;
+    sentry_value_t extra;
+} sentry_thread_scope_t;
+
 /**
  * When applying a scope to an event object, this specifies all the additional
  * data that should be added to the event.
@@ -44,25 +55,67 @@ typedef enum {
     SENTRY_SCOPE_MODULES = 0x2,
     // Symbolize all the stacktraces on-device which are found in the event.
     SENTRY_SCOPE_STACKTRACES = 0x4,
+    // Merge the scope of the calling thread into the event.
+    SENTRY_SCOPE_THREAD = 0x8,
     // All of the above.
     SENTRY_SCOPE_ALL = ~0,
 } sentry_scope_mode_t;
 
 /**
- * This will acquire a lock on the global scope.
+ * This will acquire an exclusive lock on the global scope.
+ *
+ * Nested locks on the same thread reuse the outermost one, which means that
+ * a thread holding a shared lock must not ask for an exclusive one.
  */
 sentry_scope_t *sentry__scope_lock(void);
 
 /**
- * Release the lock on the global scope.
+ * This will acquire a shared lock on the global scope, which allows any number
+ * of concurrent readers. All the copy-on-write values of the scope are frozen
+ * when handed out this way, so sharing them with events does not modify the
+ * scope.
+ */
+const sentry_scope_t *sentry__scope_lock_shared(void);
+
+/**
+ * Release the shared or exclusive lock on the global scope.
  */
 void sentry__scope_unlock(void);
 
+#ifdef SENTRY_PLATFORM_UNIX
+/**
+ * Releases the exclusive lock that was taken before a `fork`, in the child.
+ * The lock still records the thread id that the forking thread had in the
+ * parent as its owner, so it is reinitialized rather than unlocked.
+ */
+void sentry__scope_unlock_after_fork(void);
+#endif
+
 /**
  * This will free all the data attached to the global scope
  */
 void sentry__scope_cleanup(void);
 
+/**
+ * Returns the number of bytes allocated for the data of the `scope`, as per
+ * `sentry__value_get_memory_usage`. This does not include the transaction or
+ * span attached to the scope.
+ */
+size_t sentry__scope_get_memory_usage(const sentry_scope_t *scope);
+
+/**
+ * Returns the number of bytes allocated for the transaction or span that is
+ * attached to the `scope`, including the transaction a span belongs to.
+ */
+size_t sentry__scope_get_transaction_memory_usage(const sentry_scope_t *scope);
+
+/**
+ * Adds the `os`, `device` and `app` contexts from `sentry__get_system_contexts`
+ * to the contexts of the scope, unless they were set already. Until this is
+ * called, `sentry__scope_apply_to_event` adds them to every event.
+ */
+void sentry__scope_add_system_contexts(void);
+
 /**
  * This will notify any backend of scope changes.
  * This function must be called while holding the scope lock, and it will be
@@ -70,6 +123,30 @@ void sentry__scope_cleanup(void);
  */
 void sentry__scope_flush_unlock();
 
+/**
+ * Returns the scope of the calling thread, creating it on first use, or `NULL`
+ * on allocation failure.
+ */
+sentry_thread_scope_t *sentry__thread_scope_get(void);
+
+/**
+ * Frees the scope of the calling thread.
+ */
+void sentry__thread_scope_clear(void);
+
+/**
+ * Returns true if the calling thread has set any tags or extra of its own.
+ */
+bool sentry__thread_scope_has_values(void);
+
+/**
+ * Creates the frozen Object of the members that are the same for every event,
+ * which are the `platform`, and the `release`, `dist` and `environment` of the
+ * `options`. `sentry__scope_apply_to_event` adds these shared Values to every
+ * event that does not set them itself, instead of creating new ones.
+ */
+sentry_value_t sentry__scope_new_event_header(const sentry_options_t *options);
+
 /**
  * This will merge the requested data which is in the given `scope` to the given
  * `event`.
@@ -80,12 +157,27 @@ void sentry__scope_apply_to_event(const sentry_scope_t *scope,
     const sentry_options_t *options, sentry_value_t event,
     sentry_scope_mode_t mode);
 
+/**
+ * This will add the modules list to the given `event`, and symbolize its
+ * stacktraces, as requested by the `SENTRY_SCOPE_MODULES` and
+ * `SENTRY_SCOPE_STACKTRACES` bits of `mode`. These do not depend on the scope,
+ * so this does not need the scope lock.
+ */
+void sentry__apply_debug_info_to_event(const sentry_options_t *options,
+    sentry_value_t event, sentry_scope_mode_t mode);
+
+/**
+ * This will symbolize all the stacktraces which are found in the given
+ * `event` on-device, the same as `SENTRY_SCOPE_STACKTRACES` does.
+ */
+void sentry__symbolize_stacktraces(sentry_value_t event);
+
 /**
  * These are convenience macros to automatically lock/unlock a scope inside a
  * code block.
  */
 #define SENTRY_WITH_SCOPE(Scope)                                               \
-    for (const sentry_scope_t *Scope = sentry__scope_lock(); Scope;            \
+    for (const sentry_scope_t *Scope = sentry__scope_lock_shared(); Scope;     \
          sentry__scope_unlock(), Scope = NULL)
 #define SENTRY_WITH_SCOPE_MUT(Scope)                                           \
     for (sentry_scope_t *Scope = sentry__scope_lock(); Scope;                  \
@@ -6,12 +6,29 @@
 #include "sentry_options.h"
 #include "sentry_scope.h"
 #include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_transport.h"
 #include "sentry_utils.h"
 #include "sentry_value.h"
 
 #include <assert.h>
 #include <string.h>
 
+/**
+ * While the persister runs, changes to the current session only mark it as
+ * dirty, and the first change arms a single delayed write of the session on
+ * the worker of the transport. Custom transports do not have one, so the
+ * persister starts a worker of its own for them, once it is first needed.
+ * Otherwise every change is written right away. The state of the persister is
+ * guarded by its lock, which is taken inside the options lock.
+ */
+static sentry_mutex_t g_persister_lock = SENTRY__MUTEX_INIT;
+static sentry_bgworker_t *g_persister = NULL;
+static bool g_owns_persister = false;
+static uint64_t g_persist_interval = 0;
+static bool g_persist_scheduled = false;
+static uint64_t g_persist_timer_id = 0;
+
 static const char *
 status_as_string(sentry_session_status_t status)
 {
@@ -210,21 +227,159 @@ sentry__session_from_path(const sentry_path_t *path)
     return rv;
 }
 
+/**
+ * Writes the current session to disk if it changed since it was last written.
+ * This needs to be called with the options lock held.
+ */
+static void
+persist_dirty_session(sentry_options_t *options)
+{
+    if (options->session && options->session_dirty
+        && sentry__run_write_session(options->run, options->session)) {
+        options->session_dirty = false;
+    }
+}
+
+static void
+persist_session_task(void *task_data, void *UNUSED(state))
+{
+    sentry_options_t *options = sentry__options_lock();
+    sentry__mutex_lock(&g_persister_lock);
+    // the write of a stopped persister is left to
+    // `sentry__session_persister_stop`
+    bool is_current = g_persist_scheduled && g_persister == task_data;
+    if (is_current) {
+        g_persist_scheduled = false;
+    }
+    sentry__mutex_unlock(&g_persister_lock);
+    if (options && is_current) {
+        persist_dirty_session(options);
+    }
+    sentry__options_unlock();
+}
+
+/**
+ * Starts the worker of the persister, which needs to be called with the lock
+ * of the persister held. Returns false if that fails.
+ */
+static bool
+start_own_persister(void)
+{
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        return false;
+    }
+    sentry__bgworker_setname(bgw, "sentry-session");
+    if (sentry__bgworker_start(bgw) != 0) {
+        sentry__bgworker_decref(bgw);
+        return false;
+    }
+    g_persister = bgw;
+    g_owns_persister = true;
+    return true;
+}
+
+/**
+ * Arms the write of the dirty session, unless it already is. Returns false if
+ * the persister does not run, or fails to schedule the write.
+ */
+static bool
+schedule_persist(void)
+{
+    sentry__mutex_lock(&g_persister_lock);
+    if (g_persist_interval && !g_persist_scheduled
+        && (g_persister || start_own_persister())) {
+        g_persist_scheduled = sentry__bgworker_submit_delayed(g_persister,
+                                  persist_session_task, NULL, g_persister,
+                                  g_persist_interval, &g_persist_timer_id)
+            == 0;
+    }
+    bool scheduled = g_persist_scheduled;
+    sentry__mutex_unlock(&g_persister_lock);
+    return scheduled;
+}
+
+void
+sentry__session_persister_start(const sentry_options_t *options)
+{
+    sentry__mutex_lock(&g_persister_lock);
+    if (!g_persist_interval) {
+        g_persister = sentry__transport_get_bgworker(options->transport);
+        g_owns_persister = false;
+        g_persist_interval = options->session_persist_interval;
+        g_persist_scheduled = false;
+    }
+    sentry__mutex_unlock(&g_persister_lock);
+}
+
+void
+sentry__session_persister_stop(void)
+{
+    sentry__mutex_lock(&g_persister_lock);
+    sentry_bgworker_t *bgw = g_persister;
+    bool owned = g_owns_persister;
+    bool scheduled = g_persist_scheduled;
+    uint64_t timer_id = g_persist_timer_id;
+    bool was_running = g_persist_interval != 0;
+    g_persister = NULL;
+    g_owns_persister = false;
+    g_persist_interval = 0;
+    g_persist_scheduled = false;
+    sentry__mutex_unlock(&g_persister_lock);
+    if (!was_running) {
+        return;
+    }
+
+    // a write that is already due needs the options lock, which is held while
+    // the transport shuts down, so it has to be done before returning
+    if (owned) {
+        if (sentry__bgworker_shutdown(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT)
+            == 0) {
+            sentry__bgworker_decref(bgw);
+        }
+    } else if (scheduled && !sentry__bgworker_cancel_timer(bgw, timer_id)) {
+        sentry__bgworker_flush(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT);
+    }
+    // whatever the persister did not get to is written right away
+    sentry_options_t *options = sentry__options_lock();
+    if (options) {
+        persist_dirty_session(options);
+    }
+    sentry__options_unlock();
+}
+
+void
+sentry__session_changed(sentry_options_t *options)
+{
+    // a crash ends the session right away, and sends it with the crash, so
+    // there is no point in writing it from the signal handler
+    if (!sentry__block_for_signal_handler()) {
+        options->session_dirty = true;
+    } else if (schedule_persist()) {
+        options->session_dirty = true;
+    } else {
+        sentry__run_write_session(options->run, options->session);
+    }
+}
+
 void
 sentry_start_session(void)
 {
     sentry_end_session();
+    // the options lock is always taken before the scope lock
+    sentry_options_t *options = sentry__options_lock();
     SENTRY_WITH_SCOPE (scope) {
-        sentry_options_t *options = sentry__options_lock();
         if (options) {
             options->session = sentry__session_new();
+            options->session_dirty = false;
             if (options->session) {
                 sentry__session_sync_user(options->session, scope->user);
+                // the start of a session is always written right away
                 sentry__run_write_session(options->run, options->session);
             }
         }
-        sentry__options_unlock();
     }
+    sentry__options_unlock();
 }
 
 void
@@ -233,6 +388,7 @@ sentry__record_errors_on_current_session(uint32_t error_count)
     sentry_options_t *options = sentry__options_lock();
     if (options && options->session) {
         options->session->errors += error_count;
+        sentry__session_changed(options);
     }
     sentry__options_unlock();
 }
@@ -245,6 +401,7 @@ sentry__end_session_internal(void)
     if (options) {
         session = options->session;
         options->session = NULL;
+        options->session_dirty = false;
         sentry__run_clear_session(options->run);
     }
     sentry__options_unlock();
@@ -70,6 +70,28 @@ sentry_session_t *sentry__end_current_session_with_status(
  */
 void sentry__record_errors_on_current_session(uint32_t error_count);
 
+/**
+ * Persists the change of the current session of `options`, either right away,
+ * or with the delayed write that the session persister schedules for it. This
+ * needs to be called with the options lock held.
+ */
+void sentry__session_changed(sentry_options_t *options);
+
+/**
+ * Starts persisting the session lazily, if `options` has a session persist
+ * interval. From then on, `sentry__session_changed` only marks the session as
+ * dirty, and schedules a write on the worker of the transport, at most once
+ * per interval.
+ */
+void sentry__session_persister_start(const sentry_options_t *options);
+
+/**
+ * Stops the session persister, and writes the session if it is still dirty.
+ * This must not be called with the options lock held, or after the transport
+ * was shut down, since the persister needs both.
+ */
+void sentry__session_persister_stop(void);
+
 /**
  * This will update a sessions `distinct_id`, which is based on the user.
  */
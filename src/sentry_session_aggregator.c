@@ -0,0 +1,298 @@
+#include "sentry_session_aggregator.h"
+
+#include "sentry_core.h"
+#include "sentry_envelope.h"
+#include "sentry_json.h"
+#include "sentry_options.h"
+#include "sentry_sync.h"
+#include "sentry_utils.h"
+
+#include <string.h>
+
+#define AGGREGATOR_SLOTS 256
+#define AGGREGATOR_DID_LEN 64
+#define AGGREGATOR_BUCKET_MS (60 * 1000)
+#define AGGREGATOR_FLUSH_INTERVAL_MS (60 * 1000)
+#define AGGREGATOR_STATUS_COUNT 4
+
+#define SLOT_EMPTY 0
+#define SLOT_CLAIMED 1
+#define SLOT_READY 2
+
+static const char *const g_status_names[AGGREGATOR_STATUS_COUNT]
+    = { "exited", "errored", "crashed", "abnormal" };
+
+/**
+ * The request sessions of one minute and distinct id. A slot is claimed by
+ * the first request that needs it, and is only compared against once it is
+ * ready.
+ */
+typedef struct {
+    volatile long state;
+    uint64_t started_ms;
+    uint64_t hash;
+    char did[AGGREGATOR_DID_LEN];
+    volatile long counts[AGGREGATOR_STATUS_COUNT];
+} aggregate_slot_t;
+
+/**
+ * An open addressing hash table of slots. `writers` counts the requests that
+ * are currently recording into the table.
+ */
+typedef struct {
+    aggregate_slot_t slots[AGGREGATOR_SLOTS];
+    volatile long writers;
+    volatile long dropped;
+} aggregate_table_t;
+
+/**
+ * The requests record into the active table, while the other one is being
+ * flushed. A flush swaps the tables, and waits for the requests that are
+ * still recording into the previously active one, so the request path never
+ * needs to take a lock.
+ */
+static aggregate_table_t g_tables[2];
+static volatile long g_active_table = 0;
+static volatile long g_aggregating = 0;
+
+// serializes starting, stopping and flushing
+static sentry_mutex_t g_aggregator_lock = SENTRY__MUTEX_INIT;
+static sentry_bgworker_t *g_aggregator = NULL;
+
+static uint64_t
+hash_key(uint64_t started_ms, const char *did, size_t did_len)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < sizeof(started_ms); i++) {
+        hash ^= (started_ms >> (i * 8)) & 0xff;
+        hash *= 1099511628211u;
+    }
+    for (size_t i = 0; i < did_len; i++) {
+        hash ^= (unsigned char)did[i];
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+static aggregate_slot_t *
+find_slot(aggregate_table_t *table, uint64_t started_ms, uint64_t hash,
+    const char *did, size_t did_len)
+{
+    for (size_t i = 0; i < AGGREGATOR_SLOTS; i++) {
+        aggregate_slot_t *slot
+            = &table->slots[(hash + i) % AGGREGATOR_SLOTS];
+        long state = sentry__atomic_fetch(&slot->state);
+        if (state == SLOT_EMPTY
+            && sentry__atomic_compare_swap(
+                &slot->state, SLOT_EMPTY, SLOT_CLAIMED)) {
+            slot->started_ms = started_ms;
+            slot->hash = hash;
+            memcpy(slot->did, did, did_len);
+            slot->did[did_len] = '\0';
+            sentry__atomic_store(&slot->state, SLOT_READY);
+            return slot;
+        }
+        // another request is just filling in this slot
+        while (state != SLOT_READY) {
+            state = sentry__atomic_fetch(&slot->state);
+        }
+        if (slot->hash == hash && slot->started_ms == started_ms
+            && strncmp(slot->did, did, did_len) == 0
+            && slot->did[did_len] == '\0') {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void
+sentry_record_request_session(
+    sentry_request_session_status_t status, const char *distinct_id)
+{
+    if ((unsigned)status >= AGGREGATOR_STATUS_COUNT
+        || !sentry__atomic_fetch(&g_aggregating)) {
+        return;
+    }
+    uint64_t started_ms
+        = sentry__msec_time() / AGGREGATOR_BUCKET_MS * AGGREGATOR_BUCKET_MS;
+    size_t did_len = distinct_id ? strlen(distinct_id) : 0;
+    if (did_len >= AGGREGATOR_DID_LEN) {
+        did_len = AGGREGATOR_DID_LEN - 1;
+    }
+    uint64_t hash = hash_key(started_ms, distinct_id, did_len);
+
+    while (true) {
+        long index = sentry__atomic_fetch(&g_active_table);
+        aggregate_table_t *table = &g_tables[index];
+        sentry__atomic_fetch_and_add(&table->writers, 1);
+        // the tables may have been swapped in the meantime, in which case the
+        // flush might not wait for us
+        if (sentry__atomic_fetch(&g_active_table) == index) {
+            aggregate_slot_t *slot
+                = find_slot(table, started_ms, hash, distinct_id, did_len);
+            if (slot) {
+                sentry__atomic_fetch_and_add(&slot->counts[status], 1);
+            } else {
+                sentry__atomic_fetch_and_add(&table->dropped, 1);
+            }
+            sentry__atomic_fetch_and_add(&table->writers, -1);
+            return;
+        }
+        sentry__atomic_fetch_and_add(&table->writers, -1);
+    }
+}
+
+/**
+ * Writes the ready slots of `table` as a `sessions` payload, and returns the
+ * number of aggregates that were written.
+ */
+static size_t
+write_aggregates(sentry_jsonwriter_t *jw, const aggregate_table_t *table,
+    const sentry_options_t *options)
+{
+    size_t aggregate_count = 0;
+    sentry__jsonwriter_write_object_start(jw);
+    sentry__jsonwriter_write_key(jw, "attrs");
+    sentry__jsonwriter_write_object_start(jw);
+    sentry__jsonwriter_write_key(jw, "release");
+    sentry__jsonwriter_write_str(jw, options->release);
+    sentry__jsonwriter_write_key(jw, "environment");
+    sentry__jsonwriter_write_str(jw, options->environment);
+    sentry__jsonwriter_write_object_end(jw);
+
+    sentry__jsonwriter_write_key(jw, "aggregates");
+    sentry__jsonwriter_write_list_start(jw);
+    for (size_t i = 0; i < AGGREGATOR_SLOTS; i++) {
+        const aggregate_slot_t *slot = &table->slots[i];
+        if (slot->state != SLOT_READY) {
+            continue;
+        }
+        aggregate_count++;
+        sentry__jsonwriter_write_object_start(jw);
+        sentry__jsonwriter_write_key(jw, "started");
+        sentry__jsonwriter_write_msec_timestamp(jw, slot->started_ms);
+        if (slot->did[0]) {
+            sentry__jsonwriter_write_key(jw, "did");
+            sentry__jsonwriter_write_str(jw, slot->did);
+        }
+        for (size_t status = 0; status < AGGREGATOR_STATUS_COUNT; status++) {
+            if (slot->counts[status]) {
+                sentry__jsonwriter_write_key(jw, g_status_names[status]);
+                sentry__jsonwriter_write_int64(jw, slot->counts[status]);
+            }
+        }
+        sentry__jsonwriter_write_object_end(jw);
+    }
+    sentry__jsonwriter_write_list_end(jw);
+    sentry__jsonwriter_write_object_end(jw);
+    return aggregate_count;
+}
+
+static void
+flush_aggregates(const sentry_options_t *options)
+{
+    sentry__mutex_lock(&g_aggregator_lock);
+    long index = sentry__atomic_fetch(&g_active_table);
+    sentry__atomic_store(&g_active_table, 1 - index);
+    aggregate_table_t *table = &g_tables[index];
+    while (sentry__atomic_fetch(&table->writers)) {
+        // the requests only increment a few counters, so this is short
+    }
+
+    long dropped = sentry__atomic_fetch(&table->dropped);
+    if (dropped) {
+        SENTRY_DEBUGF("dropped %ld request sessions, since there were too "
+                      "many distinct ids",
+            dropped);
+    }
+    sentry_envelope_t *envelope = NULL;
+    // just like the application sessions, aggregates need a release
+    sentry_jsonwriter_t *jw
+        = options && options->release ? sentry__jsonwriter_new(NULL) : NULL;
+    if (jw) {
+        size_t aggregate_count = write_aggregates(jw, table, options);
+        size_t buf_len = 0;
+        char *buf = sentry__jsonwriter_into_string(jw, &buf_len);
+        if (buf && aggregate_count) {
+            envelope = sentry__envelope_new();
+            if (!sentry__envelope_add_from_buffer(
+                    envelope, buf, buf_len, "sessions")) {
+                sentry_envelope_free(envelope);
+                envelope = NULL;
+            }
+        }
+        sentry_free(buf);
+    }
+    // the table is inactive, and nobody else writes to it now
+    memset(table->slots, 0, sizeof(table->slots));
+    sentry__atomic_store(&table->dropped, 0);
+    sentry__mutex_unlock(&g_aggregator_lock);
+
+    if (envelope) {
+        sentry__capture_envelope(options->transport, envelope);
+    }
+}
+
+static void
+flush_aggregates_task(void *UNUSED(task_data), void *UNUSED(state))
+{
+    sentry__session_aggregator_flush();
+}
+
+void
+sentry__session_aggregator_flush(void)
+{
+    SENTRY_WITH_OPTIONS (options) {
+        flush_aggregates(options);
+    }
+}
+
+void
+sentry__session_aggregator_start(const sentry_options_t *options)
+{
+    if (options->session_mode != SENTRY_SESSION_MODE_REQUEST) {
+        return;
+    }
+
+    sentry__mutex_lock(&g_aggregator_lock);
+    if (g_aggregator) {
+        goto done;
+    }
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    if (!bgw) {
+        goto done;
+    }
+    sentry__bgworker_setname(bgw, "sentry-sessions");
+    if (sentry__bgworker_submit_periodic(bgw, flush_aggregates_task, NULL,
+            NULL, AGGREGATOR_FLUSH_INTERVAL_MS, NULL)
+            != 0
+        || sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start aggregating the request sessions");
+        sentry__bgworker_decref(bgw);
+        goto done;
+    }
+    g_aggregator = bgw;
+    sentry__atomic_store(&g_aggregating, 1);
+
+done:
+    sentry__mutex_unlock(&g_aggregator_lock);
+}
+
+void
+sentry__session_aggregator_stop(void)
+{
+    sentry__mutex_lock(&g_aggregator_lock);
+    sentry_bgworker_t *bgw = g_aggregator;
+    g_aggregator = NULL;
+    sentry__atomic_store(&g_aggregating, 0);
+    sentry__mutex_unlock(&g_aggregator_lock);
+
+    if (bgw) {
+        if (sentry__bgworker_shutdown(bgw, SENTRY_DEFAULT_SHUTDOWN_TIMEOUT)
+            == 0) {
+            sentry__bgworker_decref(bgw);
+        }
+        sentry__session_aggregator_flush();
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SENTRY_SESSION_AGGREGATOR_H_INCLUDED
+#define SENTRY_SESSION_AGGREGATOR_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Starts counting the request sessions, and sending them periodically as
+ * session aggregates, if the sessions of `options` are tracked per request.
+ */
+void sentry__session_aggregator_start(const sentry_options_t *options);
+
+/**
+ * Stops counting the request sessions, and sends the ones that were counted
+ * so far. This must not be called with the options lock held, since sending
+ * the aggregates needs it.
+ */
+void sentry__session_aggregator_stop(void);
+
+/**
+ * Sends the request sessions that were counted so far.
+ */
+void sentry__session_aggregator_flush(void);
+
+#endif
@@ -0,0 +1,348 @@
+#include "sentry_sidecar.h"
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_envelope.h"
+#include "sentry_options.h"
+#include "sentry_sync.h"
+
+#include <string.h>
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#else
+#    include <errno.h>
+#    include <signal.h>
+#    include <unistd.h>
+#endif
+
+#define SIDECAR_MAGIC "SNTRYSCR"
+#define SIDECAR_VERSION 2
+
+/**
+ * The header at the start of the file. `head` counts all the bytes the
+ * producer ever wrote and `tail` all the bytes the consumer ever read, so
+ * byte `n` lives at offset `n % capacity`. Only the producer advances `head`
+ * and only the consumer advances `tail`. They are 64 bits wide everywhere, so
+ * that they never wrap around and `n % capacity` stays valid for any capacity,
+ * and they come right after `capacity` to be 8-byte aligned on all platforms.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t long_size;
+    uint64_t capacity;
+    volatile uint64_t head;
+    volatile uint64_t tail;
+    volatile long pid;
+    volatile long closed;
+    volatile long dropped;
+} sidecar_header_t;
+
+struct sentry_sidecar_ring_s {
+    sentry_mmap_t mapping;
+    sidecar_header_t *header;
+    char *data;
+    size_t capacity;
+    bool is_producer;
+};
+
+static long
+current_pid(void)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return (long)GetCurrentProcessId();
+#else
+    return (long)getpid();
+#endif
+}
+
+static bool
+process_is_alive(long pid)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    HANDLE process
+        = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    if (!process) {
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    DWORD exit_code = 0;
+    bool alive = GetExitCodeProcess(process, &exit_code)
+        && exit_code == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    // a process of another user is alive as well, even if we may not signal it
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+static size_t
+ring_used(const sentry_sidecar_ring_t *ring)
+{
+    uint64_t head = sentry__atomic_fetch_u64(&ring->header->head);
+    uint64_t tail = sentry__atomic_fetch_u64(&ring->header->tail);
+    // a corrupted header must not turn into a small count on 32-bit
+    uint64_t used = head - tail;
+    return used > ring->capacity ? ring->capacity + 1 : (size_t)used;
+}
+
+static void
+ring_write(
+    sentry_sidecar_ring_t *ring, uint64_t pos, const void *buf, size_t len)
+{
+    size_t offset = (size_t)(pos % ring->capacity);
+    size_t first = ring->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->data + offset, buf, first);
+    memcpy(ring->data, (const char *)buf + first, len - first);
+}
+
+static void
+ring_read(
+    const sentry_sidecar_ring_t *ring, uint64_t pos, void *buf, size_t len)
+{
+    size_t offset = (size_t)(pos % ring->capacity);
+    size_t first = ring->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(buf, ring->data + offset, first);
+    memcpy((char *)buf + first, ring->data, len - first);
+}
+
+sentry_sidecar_ring_t *
+sentry__sidecar_ring_new(const sentry_path_t *path, size_t capacity)
+{
+    if (capacity <= sizeof(uint32_t)
+        || capacity > SIZE_MAX - sizeof(sidecar_header_t)) {
+        return NULL;
+    }
+    sentry_sidecar_ring_t *ring = SENTRY_MAKE(sentry_sidecar_ring_t);
+    if (!ring) {
+        return NULL;
+    }
+    if (!sentry__path_mmap_shared(
+            &ring->mapping, path, sizeof(sidecar_header_t) + capacity)) {
+        sentry_free(ring);
+        return NULL;
+    }
+    ring->header = ring->mapping.ptr;
+    ring->data = (char *)(ring->header + 1);
+    ring->capacity = capacity;
+    ring->is_producer = true;
+
+    // the mapping starts out zeroed, so the ring is empty, and the magic is
+    // written last so that a consumer does not pick up a half-written header
+    ring->header->version = SIDECAR_VERSION;
+    ring->header->long_size = (uint32_t)sizeof(long);
+    ring->header->capacity = (uint64_t)capacity;
+    sentry__atomic_store(&ring->header->pid, current_pid());
+    memcpy(ring->header->magic, SIDECAR_MAGIC, sizeof(ring->header->magic));
+    return ring;
+}
+
+sentry_sidecar_ring_t *
+sentry__sidecar_ring_open(const sentry_path_t *path)
+{
+    sentry_sidecar_ring_t *ring = SENTRY_MAKE(sentry_sidecar_ring_t);
+    if (!ring) {
+        return NULL;
+    }
+    if (!sentry__path_mmap_existing_shared(&ring->mapping, path)) {
+        sentry_free(ring);
+        return NULL;
+    }
+    const sidecar_header_t *header = ring->mapping.ptr;
+    if (ring->mapping.len < sizeof(sidecar_header_t)
+        || memcmp(header->magic, SIDECAR_MAGIC, sizeof(header->magic)) != 0
+        || header->version != SIDECAR_VERSION
+        || header->long_size != sizeof(long)
+        || header->capacity <= sizeof(uint32_t)
+        || header->capacity
+            > ring->mapping.len - sizeof(sidecar_header_t)) {
+        sentry__mmap_close(&ring->mapping);
+        sentry_free(ring);
+        return NULL;
+    }
+    ring->header = ring->mapping.ptr;
+    ring->data = (char *)(ring->header + 1);
+    ring->capacity = (size_t)header->capacity;
+    ring->is_producer = false;
+    return ring;
+}
+
+void
+sentry__sidecar_ring_free(sentry_sidecar_ring_t *ring)
+{
+    if (!ring) {
+        return;
+    }
+    if (ring->is_producer) {
+        sentry__atomic_store(&ring->header->closed, 1);
+    }
+    sentry__sidecar_ring_abandon(ring);
+}
+
+void
+sentry__sidecar_ring_abandon(sentry_sidecar_ring_t *ring)
+{
+    if (!ring) {
+        return;
+    }
+    sentry__mmap_close(&ring->mapping);
+    sentry_free(ring);
+}
+
+bool
+sentry__sidecar_ring_is_own(const sentry_sidecar_ring_t *ring)
+{
+    return sentry__atomic_fetch(&ring->header->pid) == current_pid();
+}
+
+int
+sentry__sidecar_ring_push(
+    sentry_sidecar_ring_t *ring, const char *buf, size_t len)
+{
+    size_t needed = sizeof(uint32_t) + len;
+    size_t used = ring_used(ring);
+    if (len > UINT32_MAX || used > ring->capacity
+        || needed > ring->capacity - used) {
+        sentry__atomic_fetch_and_add(&ring->header->dropped, 1);
+        return 1;
+    }
+    uint64_t head = sentry__atomic_fetch_u64(&ring->header->head);
+    uint32_t record_len = (uint32_t)len;
+    ring_write(ring, head, &record_len, sizeof(record_len));
+    ring_write(ring, head + sizeof(record_len), buf, len);
+    // this publishes the record to the consumer
+    sentry__atomic_store_u64(&ring->header->head, head + needed);
+    return 0;
+}
+
+int
+sentry__sidecar_ring_pop(
+    sentry_sidecar_ring_t *ring, sentry_stringbuilder_t *record)
+{
+    size_t used = ring_used(ring);
+    if (!used) {
+        return 1;
+    }
+    uint64_t tail = sentry__atomic_fetch_u64(&ring->header->tail);
+    uint32_t record_len = 0;
+    if (used < sizeof(record_len) || used > ring->capacity) {
+        goto corrupted;
+    }
+    ring_read(ring, tail, &record_len, sizeof(record_len));
+    if (record_len > used - sizeof(record_len)) {
+        goto corrupted;
+    }
+
+    sentry__stringbuilder_set_len(record, 0);
+    char *buf = sentry__stringbuilder_reserve(record, (size_t)record_len + 1);
+    if (!buf) {
+        return -1;
+    }
+    ring_read(ring, tail + sizeof(record_len), buf, record_len);
+    buf[record_len] = '\0';
+    sentry__stringbuilder_set_len(record, record_len);
+    sentry__atomic_store_u64(
+        &ring->header->tail, tail + sizeof(record_len) + record_len);
+    return 0;
+
+corrupted:
+    sentry__atomic_store_u64(&ring->header->tail, tail + used);
+    return -1;
+}
+
+size_t
+sentry__sidecar_ring_pending(const sentry_sidecar_ring_t *ring)
+{
+    return ring_used(ring);
+}
+
+size_t
+sentry__sidecar_ring_dropped(const sentry_sidecar_ring_t *ring)
+{
+    return (size_t)sentry__atomic_fetch(&ring->header->dropped);
+}
+
+bool
+sentry__sidecar_ring_is_orphaned(const sentry_sidecar_ring_t *ring)
+{
+    return sentry__atomic_fetch(&ring->header->closed)
+        || !process_is_alive(sentry__atomic_fetch(&ring->header->pid));
+}
+
+/**
+ * Forwards the records of the ring at `path` to `transport`, and removes the
+ * ring once its producer is gone and all of its records are forwarded.
+ */
+static int
+drain_ring(const sentry_path_t *path, sentry_transport_t *transport,
+    sentry_stringbuilder_t *record)
+{
+    sentry_sidecar_ring_t *ring = sentry__sidecar_ring_open(path);
+    if (!ring) {
+        return 0;
+    }
+    // this is checked before draining, so that the records which the producer
+    // pushed right before closing the ring are still forwarded
+    bool orphaned = sentry__sidecar_ring_is_orphaned(ring);
+    int forwarded = 0;
+    int rv;
+    while ((rv = sentry__sidecar_ring_pop(ring, record)) != 1) {
+        if (rv != 0) {
+            SENTRY_WARN("skipping the corrupted records of a sidecar ring");
+            continue;
+        }
+        sentry_envelope_t *envelope = sentry__envelope_from_buffer(
+            record->buf, sentry__stringbuilder_len(record));
+        if (envelope) {
+            sentry__capture_envelope(transport, envelope);
+            forwarded++;
+        }
+    }
+    size_t dropped = sentry__sidecar_ring_dropped(ring);
+    sentry__sidecar_ring_free(ring);
+
+    if (orphaned) {
+        if (dropped) {
+            SENTRY_WARNF("a sidecar ring dropped %zu envelopes because it was "
+                         "full",
+                dropped);
+        }
+        sentry__path_remove(path);
+    }
+    return forwarded;
+}
+
+int
+sentry_sidecar_drain(const char *directory)
+{
+    sentry_path_t *dir_path
+        = directory ? sentry__path_from_str(directory) : NULL;
+    sentry_pathiter_t *iter = dir_path && sentry__path_is_dir(dir_path)
+        ? sentry__path_iter_directory(dir_path)
+        : NULL;
+    int forwarded = -1;
+    SENTRY_WITH_OPTIONS (options) {
+        if (!iter) {
+            continue;
+        }
+        forwarded = 0;
+        sentry_stringbuilder_t record;
+        sentry__stringbuilder_init(&record);
+        const sentry_path_t *path;
+        while ((path = sentry__pathiter_next(iter)) != NULL) {
+            if (sentry__path_ends_with(path, "." SENTRY_SIDECAR_RING_EXT)) {
+                forwarded += drain_ring(path, options->transport, &record);
+            }
+        }
+        sentry__stringbuilder_cleanup(&record);
+    }
+    sentry__pathiter_free(iter);
+    sentry__path_free(dir_path);
+    return forwarded;
+}
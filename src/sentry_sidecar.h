@@ -0,0 +1,93 @@
+#ifndef SENTRY_SIDECAR_H_INCLUDED
+#define SENTRY_SIDECAR_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_path.h"
+#include "sentry_string.h"
+
+/**
+ * A single-producer, single-consumer ring of serialized envelopes, living in
+ * a file that is mapped into the memory of both the application, which
+ * produces the envelopes via the sidecar transport, and an uploader process,
+ * which drains the rings of all the applications on the host via
+ * `sentry_sidecar_drain`.
+ *
+ * The file starts with a header, which is followed by `capacity` bytes of
+ * records. Each record is a `uint32_t` length followed by the serialized
+ * envelope, and records wrap around the end of the ring. The header and
+ * records use the native byte order and `long` width, so they can only be
+ * shared on the same machine.
+ */
+typedef struct sentry_sidecar_ring_s sentry_sidecar_ring_t;
+
+/**
+ * The file extension of the rings in a sidecar directory.
+ */
+#define SENTRY_SIDECAR_RING_EXT "ring"
+
+/**
+ * Creates or truncates the file at `path`, and maps an empty ring of
+ * `capacity` bytes into memory, which is produced by the calling process.
+ * Returns `NULL` on failure.
+ */
+sentry_sidecar_ring_t *sentry__sidecar_ring_new(
+    const sentry_path_t *path, size_t capacity);
+
+/**
+ * Maps the existing ring at `path` into memory, to consume its records.
+ * Returns `NULL` if the file does not contain a valid ring.
+ */
+sentry_sidecar_ring_t *sentry__sidecar_ring_open(const sentry_path_t *path);
+
+/**
+ * Unmaps the ring. When called by the producer, the ring is marked as closed
+ * first, so that the consumer removes it once it is drained.
+ */
+void sentry__sidecar_ring_free(sentry_sidecar_ring_t *ring);
+
+/**
+ * Unmaps the ring without closing it, which a forked child does with the ring
+ * of its parent, which keeps producing into it.
+ */
+void sentry__sidecar_ring_abandon(sentry_sidecar_ring_t *ring);
+
+/**
+ * Whether the ring was created by the calling process.
+ */
+bool sentry__sidecar_ring_is_own(const sentry_sidecar_ring_t *ring);
+
+/**
+ * Appends a copy of the `len` bytes at `buf` as a record to the ring. This
+ * must only be called by the producer, and not concurrently.
+ * Returns 0 on success, and 1 if the ring does not have enough room left, in
+ * which case the record is counted as dropped.
+ */
+int sentry__sidecar_ring_push(
+    sentry_sidecar_ring_t *ring, const char *buf, size_t len);
+
+/**
+ * Moves the oldest record of the ring into `record`, replacing its content.
+ * Returns 0 on success, 1 if the ring is empty, and -1 if the ring is
+ * corrupted, in which case all of its records are skipped.
+ */
+int sentry__sidecar_ring_pop(
+    sentry_sidecar_ring_t *ring, sentry_stringbuilder_t *record);
+
+/**
+ * The number of bytes the consumer has not read yet.
+ */
+size_t sentry__sidecar_ring_pending(const sentry_sidecar_ring_t *ring);
+
+/**
+ * The number of records that were dropped because the ring was full.
+ */
+size_t sentry__sidecar_ring_dropped(const sentry_sidecar_ring_t *ring);
+
+/**
+ * Whether the producer of the ring is gone, either because it closed the ring
+ * or because its process exited, so that no more records will arrive.
+ */
+bool sentry__sidecar_ring_is_orphaned(const sentry_sidecar_ring_t *ring);
+
+#endif
@@ -0,0 +1,262 @@
+#include "sentry_slab.h"
+#include "sentry_alloc.h"
+#include "sentry_sync.h"
+
+#include <string.h>
+
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#    include <pthread.h>
+#endif
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_CLASS_COUNT 4
+
+/* the block sizes, including the header that points back to their slab */
+static const size_t SLAB_CLASS_SIZES[SLAB_CLASS_COUNT] = { 32, 64, 128, 256 };
+
+typedef struct slab_heap_s slab_heap_t;
+
+typedef struct slab_s {
+    struct slab_s *next;
+    slab_heap_t *heap;
+    size_t class_index;
+} slab_t;
+
+/**
+ * Blocks are prefixed by a pointer to their slab, which is `NULL` for blocks
+ * that were allocated with `sentry_malloc`. Free blocks link to the next free
+ * block of their list right after that.
+ */
+typedef struct block_s {
+    slab_t *slab;
+    struct block_s *next;
+} block_t;
+
+#define BLOCK_HEADER_SIZE offsetof(block_t, next)
+
+/**
+ * The slabs of a thread. Only the owning thread touches the free lists and
+ * bump pointers. Other threads push the blocks they free to `remote_blocks`.
+ *
+ * The heap holds a reference for its thread and one for every allocated block,
+ * so it stays around until both the thread and all its blocks are gone.
+ */
+struct slab_heap_s {
+    long refcount;
+    block_t *free_blocks[SLAB_CLASS_COUNT];
+    slab_t *bump_slabs[SLAB_CLASS_COUNT];
+    char *bump_pos[SLAB_CLASS_COUNT];
+    size_t bump_remaining[SLAB_CLASS_COUNT];
+    slab_t *slabs;
+    void *volatile remote_blocks;
+};
+
+static SENTRY_THREAD_LOCAL slab_heap_t *g_heap = NULL;
+
+static void
+heap_decref(slab_heap_t *heap)
+{
+    if (sentry__atomic_fetch_and_add(&heap->refcount, -1) != 1) {
+        return;
+    }
+    slab_t *slab = heap->slabs;
+    while (slab) {
+        slab_t *next = slab->next;
+        sentry_free(slab);
+        slab = next;
+    }
+    sentry_free(heap);
+}
+
+/**
+ * Called when a thread with a heap exits. Blocks that this thread frees from
+ * now on are handed back like those of any other thread.
+ */
+static void
+heap_thread_exit(void *heap)
+{
+    g_heap = NULL;
+    heap_decref(heap);
+}
+
+#if defined(SENTRY_PLATFORM_WINDOWS) && _WIN32_WINNT >= 0x0600
+static INIT_ONCE g_key_once = INIT_ONCE_STATIC_INIT;
+static DWORD g_key = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI
+heap_fls_callback(PVOID heap)
+{
+    heap_thread_exit(heap);
+}
+
+static BOOL CALLBACK
+make_key(PINIT_ONCE UNUSED(once), PVOID UNUSED(param), PVOID *UNUSED(ctx))
+{
+    g_key = FlsAlloc(heap_fls_callback);
+    return TRUE;
+}
+
+static bool
+register_heap(slab_heap_t *heap)
+{
+    InitOnceExecuteOnce(&g_key_once, make_key, NULL, NULL);
+    return g_key != FLS_OUT_OF_INDEXES && FlsSetValue(g_key, heap);
+}
+#elif defined(SENTRY_PLATFORM_UNIX)
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_key;
+static bool g_key_valid = false;
+
+static void
+make_key(void)
+{
+    g_key_valid = pthread_key_create(&g_key, heap_thread_exit) == 0;
+}
+
+static bool
+register_heap(slab_heap_t *heap)
+{
+    pthread_once(&g_key_once, make_key);
+    return g_key_valid && pthread_setspecific(g_key, heap) == 0;
+}
+#else
+// without a way to get notified of exiting threads, the heaps would leak
+static bool
+register_heap(slab_heap_t *UNUSED(heap))
+{
+    return false;
+}
+#endif
+
+/**
+ * Returns the heap of the current thread, creating it on first use. Returns
+ * `NULL` if the slabs can not be used.
+ */
+static slab_heap_t *
+get_heap(void)
+{
+    if (g_heap) {
+        return g_heap;
+    }
+#ifdef SENTRY_PLATFORM_UNIX
+    // a crash is only handled once, so the slabs would only add overhead
+    if (sentry__page_allocator_enabled()) {
+        return NULL;
+    }
+#endif
+    slab_heap_t *heap = SENTRY_MAKE(slab_heap_t);
+    if (!heap) {
+        return NULL;
+    }
+    memset(heap, 0, sizeof(slab_heap_t));
+    heap->refcount = 1;
+    if (!register_heap(heap)) {
+        sentry_free(heap);
+        return NULL;
+    }
+    g_heap = heap;
+    return heap;
+}
+
+/**
+ * Moves the blocks that other threads have freed to the free lists.
+ */
+static void
+heap_collect_remote(slab_heap_t *heap)
+{
+    if (!sentry__atomic_fetch_ptr(&heap->remote_blocks)) {
+        return;
+    }
+    block_t *block = sentry__atomic_exchange_ptr(&heap->remote_blocks, NULL);
+    while (block) {
+        block_t *next = block->next;
+        size_t class_index = block->slab->class_index;
+        block->next = heap->free_blocks[class_index];
+        heap->free_blocks[class_index] = block;
+        block = next;
+    }
+}
+
+static block_t *
+heap_alloc(slab_heap_t *heap, size_t class_index)
+{
+    block_t *block = heap->free_blocks[class_index];
+    if (!block) {
+        heap_collect_remote(heap);
+        block = heap->free_blocks[class_index];
+    }
+    if (block) {
+        heap->free_blocks[class_index] = block->next;
+    } else {
+        size_t block_size = SLAB_CLASS_SIZES[class_index];
+        if (heap->bump_remaining[class_index] < block_size) {
+            slab_t *slab = sentry__malloc_default_tag(
+                SLAB_SIZE, SENTRY_MEMORY_TAG_VALUE);
+            if (!slab) {
+                return NULL;
+            }
+            slab->next = heap->slabs;
+            slab->heap = heap;
+            slab->class_index = class_index;
+            heap->slabs = slab;
+            heap->bump_slabs[class_index] = slab;
+            heap->bump_pos[class_index] = (char *)slab + sizeof(slab_t);
+            heap->bump_remaining[class_index] = SLAB_SIZE - sizeof(slab_t);
+        }
+        block = (block_t *)(void *)heap->bump_pos[class_index];
+        block->slab = heap->bump_slabs[class_index];
+        heap->bump_pos[class_index] += block_size;
+        heap->bump_remaining[class_index] -= block_size;
+    }
+    sentry__atomic_fetch_and_add(&heap->refcount, 1);
+    return block;
+}
+
+void *
+sentry__slab_alloc(size_t size)
+{
+    size_t class_index = 0;
+    while (class_index < SLAB_CLASS_COUNT
+        && SLAB_CLASS_SIZES[class_index] < size + BLOCK_HEADER_SIZE) {
+        class_index++;
+    }
+    slab_heap_t *heap = class_index < SLAB_CLASS_COUNT ? get_heap() : NULL;
+    block_t *block = heap ? heap_alloc(heap, class_index) : NULL;
+    if (!block) {
+        block = sentry__malloc_default_tag(
+            BLOCK_HEADER_SIZE + size, SENTRY_MEMORY_TAG_VALUE);
+        if (!block) {
+            return NULL;
+        }
+        block->slab = NULL;
+    }
+    return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+void
+sentry__slab_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    block_t *block = (block_t *)(void *)((char *)ptr - BLOCK_HEADER_SIZE);
+    slab_t *slab = block->slab;
+    if (!slab) {
+        sentry_free(block);
+        return;
+    }
+    slab_heap_t *heap = slab->heap;
+    if (heap == g_heap) {
+        block->next = heap->free_blocks[slab->class_index];
+        heap->free_blocks[slab->class_index] = block;
+    } else {
+        void *head;
+        do {
+            head = sentry__atomic_fetch_ptr(&heap->remote_blocks);
+            block->next = head;
+        } while (!sentry__atomic_compare_swap_ptr(
+            &heap->remote_blocks, head, block));
+    }
+    heap_decref(heap);
+}
@@ -0,0 +1,34 @@
+#ifndef SENTRY_SLAB_H_INCLUDED
+#define SENTRY_SLAB_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Thread-local slabs for the small nodes of Values.
+ *
+ * Every thread allocates blocks of a few fixed size classes from its own slabs,
+ * which are carved out of 64 KiB chunks, and reuses freed blocks through
+ * per-class free lists, so allocating is mostly popping a free list or bumping
+ * a pointer, without any locking. Blocks that are freed on another thread are
+ * handed back to their owner through a lock-free list, which the owner picks
+ * up once its own free lists run dry.
+ *
+ * The slabs of a thread are released once the thread has exited and all of
+ * its blocks have been freed. Allocations that are too large for the biggest
+ * size class, or that happen while the page allocator is enabled, are served
+ * by `sentry_malloc` instead.
+ *
+ * This is only built with `SENTRY_VALUE_SLABS`.
+ */
+
+/**
+ * Allocates `size` bytes, aligned to 8 bytes.
+ */
+void *sentry__slab_alloc(size_t size);
+
+/**
+ * Frees a block allocated with `sentry__slab_alloc`, on any thread.
+ */
+void sentry__slab_free(void *ptr);
+
+#endif
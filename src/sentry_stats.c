@@ -0,0 +1,318 @@
+#include "sentry_stats.h"
+#include "sentry_alloc.h"
+#include "sentry_sync.h"
+
+#ifdef SENTRY_WITH_LOCK_STATS
+#    include "sentry_utils.h"
+
+#    include <string.h>
+#endif
+
+#define STATS_SLOT_COUNT 64
+#define CACHE_LINE_SIZE 128
+
+/**
+ * The counters of one or more threads, which are padded to separate cache
+ * lines, so that threads do not contend on the slots of others.
+ */
+typedef struct {
+    volatile long counters[SENTRY_STAT_COUNT];
+    char padding[CACHE_LINE_SIZE
+        - SENTRY_STAT_COUNT * sizeof(long) % CACHE_LINE_SIZE];
+} stats_slot_t;
+
+static stats_slot_t g_slots[STATS_SLOT_COUNT];
+static volatile long g_next_slot = 0;
+static SENTRY_THREAD_LOCAL stats_slot_t *g_slot = NULL;
+
+static const char *const STAT_NAMES[SENTRY_STAT_COUNT] = {
+    "events_captured",
+    "events_sampled_out",
+    "events_discarded",
+    "events_rate_limited",
+    "events_sent",
+    "breadcrumbs_added",
+    "breadcrumbs_evicted",
+    "spans_dropped",
+    "envelopes_dumped",
+};
+
+void
+sentry__stats_add(sentry_stat_t stat, long count)
+{
+    stats_slot_t *slot = g_slot;
+    if (!slot) {
+        // the slots are handed out round-robin, and are shared once there are
+        // more threads than slots, which is still correct, since slots are
+        // only ever added to atomically
+        long index = sentry__atomic_fetch_and_add(&g_next_slot, 1);
+        slot = &g_slots[(unsigned long)index % STATS_SLOT_COUNT];
+        g_slot = slot;
+    }
+    sentry__atomic_fetch_and_add(&slot->counters[stat], count);
+}
+
+uint64_t
+sentry__stats_get(sentry_stat_t stat)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < STATS_SLOT_COUNT; i++) {
+        sum += (unsigned long)sentry__atomic_fetch(&g_slots[i].counters[stat]);
+    }
+    return sum;
+}
+
+sentry_value_t
+sentry__stats_to_value(void)
+{
+    sentry_value_t rv = sentry_value_new_object();
+    for (size_t i = 0; i < SENTRY_STAT_COUNT; i++) {
+        sentry_value_set_by_key(rv, STAT_NAMES[i],
+            sentry_value_new_uint64(sentry__stats_get((sentry_stat_t)i)));
+    }
+#ifdef SENTRY_WITH_LOCK_STATS
+    sentry_value_set_by_key(rv, "locks", sentry__lock_stats_to_value());
+#endif
+#ifdef SENTRY_WITH_MEMORY_TAGS
+    sentry_value_set_by_key(rv, "memory", sentry__memory_tags_to_value());
+#endif
+    return rv;
+}
+
+#ifdef SENTRY_WITH_LOCK_STATS
+#    define LOCK_SLOT_COUNT 64
+#    define LOCK_WAIT_BUCKET_COUNT 7
+#    define HELD_LOCK_COUNT 16
+
+/**
+ * The statistics of one lock. The times are in microseconds, and the wait
+ * times are counted in buckets of powers of ten, from below 1us to 100ms and
+ * more.
+ */
+typedef struct {
+    const char *file;
+    const char *name;
+    volatile long ready;
+    volatile long acquisitions;
+    volatile long wait_us;
+    volatile long max_wait_us;
+    volatile long max_hold_us;
+    volatile long wait_buckets[LOCK_WAIT_BUCKET_COUNT];
+} lock_slot_t;
+
+typedef struct {
+    const void *lock;
+    long slot;
+    uint64_t acquired;
+} held_lock_t;
+
+static lock_slot_t g_lock_slots[LOCK_SLOT_COUNT];
+static volatile long g_lock_slots_claiming = 0;
+static SENTRY_THREAD_LOCAL held_lock_t g_held_locks[HELD_LOCK_COUNT];
+static SENTRY_THREAD_LOCAL size_t g_held_lock_count = 0;
+
+static const char *const LOCK_WAIT_BUCKET_NAMES[LOCK_WAIT_BUCKET_COUNT] = {
+    "lt_1us",
+    "lt_10us",
+    "lt_100us",
+    "lt_1ms",
+    "lt_10ms",
+    "lt_100ms",
+    "ge_100ms",
+};
+
+static void
+update_max(volatile long *max, long value)
+{
+    long current = sentry__atomic_fetch(max);
+    while (value > current
+        && !sentry__atomic_compare_swap(max, current, value)) {
+        current = sentry__atomic_fetch(max);
+    }
+}
+
+static const char *
+file_basename(const char *file)
+{
+    const char *basename = file;
+    for (const char *c = file; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            basename = c + 1;
+        }
+    }
+    return basename;
+}
+
+/**
+ * Returns the slot of the lock called `name` in `file`, claiming a new one if
+ * there is none yet. Returns -1 if all the slots are taken, or if another
+ * thread is claiming one concurrently, in which case the acquisition is not
+ * recorded instead of waiting, as this might run in a signal handler.
+ */
+static long
+find_lock_slot(const char *file, const char *name)
+{
+    if (!sentry__atomic_compare_swap(&g_lock_slots_claiming, 0, 1)) {
+        return -1;
+    }
+    long rv = -1;
+    file = file_basename(file);
+    // the locks are usually passed by address
+    if (*name == '&') {
+        name++;
+    }
+    for (long i = 0; i < LOCK_SLOT_COUNT; i++) {
+        lock_slot_t *slot = &g_lock_slots[i];
+        if (!sentry__atomic_fetch(&slot->ready)) {
+            slot->file = file;
+            slot->name = name;
+            sentry__atomic_store(&slot->ready, 1);
+            rv = i;
+            break;
+        }
+        if (strcmp(slot->file, file) == 0 && strcmp(slot->name, name) == 0) {
+            rv = i;
+            break;
+        }
+    }
+    sentry__atomic_store(&g_lock_slots_claiming, 0);
+    return rv;
+}
+
+uint64_t
+sentry__lock_stats_begin(void)
+{
+    return sentry__monotonic_time_ns();
+}
+
+void
+sentry__lock_stats_acquired(const void *lock, const char *file,
+    const char *name, volatile long *slot_index, uint64_t started)
+{
+    uint64_t now = sentry__monotonic_time_ns();
+    long index = sentry__atomic_fetch(slot_index);
+    if (index < 0) {
+        index = find_lock_slot(file, name);
+        if (index < 0) {
+            return;
+        }
+        sentry__atomic_store(slot_index, index);
+    }
+
+    lock_slot_t *slot = &g_lock_slots[index];
+    long wait_us = (long)((now - started) / 1000);
+    size_t bucket = 0;
+    long limit = 1;
+    while (bucket < LOCK_WAIT_BUCKET_COUNT - 1 && wait_us >= limit) {
+        bucket++;
+        limit *= 10;
+    }
+    sentry__atomic_fetch_and_add(&slot->acquisitions, 1);
+    sentry__atomic_fetch_and_add(&slot->wait_us, wait_us);
+    sentry__atomic_fetch_and_add(&slot->wait_buckets[bucket], 1);
+    update_max(&slot->max_wait_us, wait_us);
+
+    // locks that are nested deeper than this are not timed while held
+    if (g_held_lock_count < HELD_LOCK_COUNT) {
+        held_lock_t *held = &g_held_locks[g_held_lock_count++];
+        held->lock = lock;
+        held->slot = index;
+        held->acquired = now;
+    }
+}
+
+/**
+ * Returns the most recent acquisition of `lock` by the current thread.
+ */
+static held_lock_t *
+find_held_lock(const void *lock)
+{
+    for (size_t i = g_held_lock_count; i > 0; i--) {
+        if (g_held_locks[i - 1].lock == lock) {
+            return &g_held_locks[i - 1];
+        }
+    }
+    return NULL;
+}
+
+static void
+record_hold(held_lock_t *held, uint64_t now)
+{
+    if (held->acquired) {
+        update_max(&g_lock_slots[held->slot].max_hold_us,
+            (long)((now - held->acquired) / 1000));
+    }
+}
+
+void
+sentry__lock_stats_released(const void *lock)
+{
+    held_lock_t *held = find_held_lock(lock);
+    if (!held) {
+        return;
+    }
+    record_hold(held, sentry__monotonic_time_ns());
+    // locks are usually, but not necessarily, released in reverse order
+    size_t index = (size_t)(held - g_held_locks);
+    memmove(held, held + 1,
+        (g_held_lock_count - index - 1) * sizeof(held_lock_t));
+    g_held_lock_count--;
+}
+
+void
+sentry__lock_stats_wait_begin(const void *lock)
+{
+    held_lock_t *held = find_held_lock(lock);
+    if (held) {
+        record_hold(held, sentry__monotonic_time_ns());
+        held->acquired = 0;
+    }
+}
+
+int
+sentry__lock_stats_wait_end(const void *lock, int rv)
+{
+    held_lock_t *held = find_held_lock(lock);
+    if (held) {
+        held->acquired = sentry__monotonic_time_ns();
+    }
+    return rv;
+}
+
+sentry_value_t
+sentry__lock_stats_to_value(void)
+{
+    sentry_value_t rv = sentry_value_new_object();
+    for (size_t i = 0; i < LOCK_SLOT_COUNT; i++) {
+        lock_slot_t *slot = &g_lock_slots[i];
+        if (!sentry__atomic_fetch(&slot->ready)) {
+            break;
+        }
+        sentry_value_t lock = sentry_value_new_object();
+        sentry_value_set_by_key(lock, "acquisitions",
+            sentry_value_new_uint64(
+                (unsigned long)sentry__atomic_fetch(&slot->acquisitions)));
+        sentry_value_set_by_key(lock, "wait_us",
+            sentry_value_new_uint64(
+                (unsigned long)sentry__atomic_fetch(&slot->wait_us)));
+        sentry_value_set_by_key(lock, "max_wait_us",
+            sentry_value_new_uint64(
+                (unsigned long)sentry__atomic_fetch(&slot->max_wait_us)));
+        sentry_value_set_by_key(lock, "max_hold_us",
+            sentry_value_new_uint64(
+                (unsigned long)sentry__atomic_fetch(&slot->max_hold_us)));
+        sentry_value_t buckets = sentry_value_new_object();
+        for (size_t j = 0; j < LOCK_WAIT_BUCKET_COUNT; j++) {
+            sentry_value_set_by_key(buckets, LOCK_WAIT_BUCKET_NAMES[j],
+                sentry_value_new_uint64((unsigned long)sentry__atomic_fetch(
+                    &slot->wait_buckets[j])));
+        }
+        sentry_value_set_by_key(lock, "wait_histogram", buckets);
+
+        char key[128];
+        snprintf(key, sizeof(key), "%s:%s", slot->file, slot->name);
+        sentry_value_set_by_key(rv, key, lock);
+    }
+    return rv;
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef SENTRY_STATS_H_INCLUDED
+#define SENTRY_STATS_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * The counters of the SDK itself, see `sentry_get_stats`.
+ */
+typedef enum {
+    SENTRY_STAT_EVENTS_CAPTURED,
+    SENTRY_STAT_EVENTS_SAMPLED_OUT,
+    SENTRY_STAT_EVENTS_DISCARDED,
+    SENTRY_STAT_EVENTS_RATE_LIMITED,
+    SENTRY_STAT_EVENTS_SENT,
+    SENTRY_STAT_BREADCRUMBS_ADDED,
+    SENTRY_STAT_BREADCRUMBS_EVICTED,
+    SENTRY_STAT_SPANS_DROPPED,
+    SENTRY_STAT_ENVELOPES_DUMPED,
+    SENTRY_STAT_COUNT,
+} sentry_stat_t;
+
+/**
+ * Adds `count` to the counter `stat`.
+ *
+ * Every thread counts into its own slot, so this is a single uncontended
+ * atomic addition, as long as there are fewer threads than slots. The slots
+ * are only summed up when the counters are read.
+ */
+void sentry__stats_add(sentry_stat_t stat, long count);
+
+/**
+ * Returns the sum of the counter `stat` over all threads.
+ */
+uint64_t sentry__stats_get(sentry_stat_t stat);
+
+/**
+ * Returns the counters as an object Value, keyed by their names.
+ */
+sentry_value_t sentry__stats_to_value(void);
+
+#ifdef SENTRY_WITH_LOCK_STATS
+/**
+ * Returns the statistics of all the locks that have been acquired so far, as
+ * an object Value keyed by the names of the locks.
+ */
+sentry_value_t sentry__lock_stats_to_value(void);
+#endif
+
+#endif
@@ -1,10 +1,96 @@
+#include <limits.h>
 #include <string.h>
 
 #include "sentry_alloc.h"
 #include "sentry_string.h"
+#include "sentry_sync.h"
+
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#endif
 
 #define INITIAL_BUFFER_SIZE 128
 
+/**
+ * Released buffers are kept in a few lock-free slots, with their size stored
+ * in their first bytes. Larger buffers are freed right away, so the pool only
+ * ever holds on to a bounded amount of memory.
+ */
+#define POOL_SLOTS 4
+#define POOL_MAX_BUFFER_SIZE (64 * 1024)
+
+static void *volatile g_pool[POOL_SLOTS];
+
+static bool
+pool_enabled(void)
+{
+#ifdef SENTRY_PLATFORM_UNIX
+    // page allocations must never end up in the hands of the system allocator
+    return !sentry__page_allocator_enabled();
+#else
+    return true;
+#endif
+}
+
+/**
+ * Takes a pooled buffer of at least `min_size` bytes and returns it, along
+ * with its size in `*size_out`, or returns `NULL` if there is none. Buffers
+ * of more than twice the size are not handed out, since the built strings
+ * often outlive their builder.
+ */
+static char *
+pool_take(size_t min_size, size_t *size_out)
+{
+    if (min_size > POOL_MAX_BUFFER_SIZE || !pool_enabled()) {
+        return NULL;
+    }
+    for (size_t i = 0; i < POOL_SLOTS; i++) {
+        if (!sentry__atomic_fetch_ptr(&g_pool[i])) {
+            continue;
+        }
+        char *buf = sentry__atomic_exchange_ptr(&g_pool[i], NULL);
+        if (!buf) {
+            continue;
+        }
+        size_t size;
+        memcpy(&size, buf, sizeof(size));
+        if (size >= min_size && size / 2 <= min_size) {
+            *size_out = size;
+            return buf;
+        }
+        if (!sentry__atomic_compare_swap_ptr(&g_pool[i], NULL, buf)) {
+            sentry_free(buf);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Puts `buf` of `size` bytes into the pool, or frees it if the pool is full.
+ */
+static void
+pool_put(char *buf, size_t size)
+{
+    if (size >= sizeof(size_t) && size <= POOL_MAX_BUFFER_SIZE
+        && pool_enabled()) {
+        memcpy(buf, &size, sizeof(size));
+        for (size_t i = 0; i < POOL_SLOTS; i++) {
+            if (sentry__atomic_compare_swap_ptr(&g_pool[i], NULL, buf)) {
+                return;
+            }
+        }
+    }
+    sentry_free(buf);
+}
+
+void
+sentry__stringbuilder_pool_clear(void)
+{
+    for (size_t i = 0; i < POOL_SLOTS; i++) {
+        sentry_free(sentry__atomic_exchange_ptr(&g_pool[i], NULL));
+    }
+}
+
 void
 sentry__stringbuilder_init(sentry_stringbuilder_t *sb)
 {
@@ -17,11 +103,22 @@ char *
 sentry__stringbuilder_reserve(sentry_stringbuilder_t *sb, size_t len)
 {
     size_t needed = sb->len + len;
-    if (!sb->buf || needed > sb->allocated) {
-        size_t new_alloc_size = sb->allocated;
-        if (new_alloc_size == 0) {
-            new_alloc_size = INITIAL_BUFFER_SIZE;
+    if (!sb->buf) {
+        // the first reservation is used as is, since it is usually a good
+        // estimate of the final size
+        size_t new_alloc_size
+            = needed > INITIAL_BUFFER_SIZE ? needed : INITIAL_BUFFER_SIZE;
+        char *new_buf = pool_take(new_alloc_size, &new_alloc_size);
+        if (!new_buf) {
+            new_buf = sentry_malloc(new_alloc_size);
+        }
+        if (!new_buf) {
+            return NULL;
         }
+        sb->buf = new_buf;
+        sb->allocated = new_alloc_size;
+    } else if (needed > sb->allocated) {
+        size_t new_alloc_size = sb->allocated;
         while (new_alloc_size < needed) {
             new_alloc_size = new_alloc_size * 2;
         }
@@ -29,10 +126,8 @@ sentry__stringbuilder_reserve(sentry_stringbuilder_t *sb, size_t len)
         if (!new_buf) {
             return NULL;
         }
-        if (sb->buf) {
-            memcpy(new_buf, sb->buf, sb->allocated);
-            sentry_free(sb->buf);
-        }
+        memcpy(new_buf, sb->buf, sb->allocated);
+        sentry_free(sb->buf);
         sb->buf = new_buf;
         sb->allocated = new_alloc_size;
     }
@@ -63,7 +158,23 @@ sentry__stringbuilder_into_string(sentry_stringbuilder_t *sb)
 void
 sentry__stringbuilder_cleanup(sentry_stringbuilder_t *sb)
 {
-    sentry_free(sb->buf);
+    if (sb->buf) {
+        pool_put(sb->buf, sb->allocated);
+    }
+}
+
+size_t
+sentry__size_hint_get(sentry_size_hint_t *hint)
+{
+    size_t size = (size_t)sentry__atomic_fetch(&hint->size);
+    return size + size / 8;
+}
+
+void
+sentry__size_hint_update(sentry_size_hint_t *hint, size_t size)
+{
+    sentry__atomic_store(
+        &hint->size, size < (size_t)LONG_MAX ? (long)size : LONG_MAX);
 }
 
 size_t
@@ -24,6 +24,11 @@ void sentry__stringbuilder_init(sentry_stringbuilder_t *sb);
 /**
  * Resizes the stringbuilder buffer to make sure there is at least `len` bytes
  * available at the end, and returns a pointer *to the reservation*.
+ *
+ * Reserving the expected size up front, for example from a
+ * `sentry_size_hint_t`, allows building a string with a single allocation.
+ * The first reservation of a builder may reuse a buffer that another builder
+ * released with `sentry__stringbuilder_cleanup`.
  */
 char *sentry__stringbuilder_reserve(sentry_stringbuilder_t *sb, size_t len);
 
@@ -94,10 +99,37 @@ char *sentry__stringbuilder_into_string(sentry_stringbuilder_t *sb);
 char *sentry_stringbuilder_take_string(sentry_stringbuilder_t *sb);
 
 /**
- * Deallocates the string builder.
+ * Deallocates the string builder. Buffers of up to a few dozen kilobytes are
+ * kept in a small pool to be reused by the next builders.
  */
 void sentry__stringbuilder_cleanup(sentry_stringbuilder_t *sb);
 
+/**
+ * Frees the buffers that are kept for reuse by the string builders.
+ */
+void sentry__stringbuilder_pool_clear(void);
+
+/**
+ * Remembers the size of the latest string of one kind, like a serialized
+ * event, so that the next one can reserve enough memory up front.
+ */
+typedef struct {
+    volatile long size;
+} sentry_size_hint_t;
+
+#define SENTRY__SIZE_HINT_INIT { 0 }
+
+/**
+ * Returns the number of bytes to reserve for the next string of the kind of
+ * `hint`, which includes some slack for strings that come out a bit larger.
+ */
+size_t sentry__size_hint_get(sentry_size_hint_t *hint);
+
+/**
+ * Records that a string of the kind of `hint` came out as `size` bytes.
+ */
+void sentry__size_hint_update(sentry_size_hint_t *hint, size_t size);
+
 /**
  * Returns the number of bytes in the string builder.
  */
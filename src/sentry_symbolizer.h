@@ -14,8 +14,69 @@ typedef struct sentry_frame_info_s {
 /**
  * This will symbolize the provided `addr`, and call `func` with a populated
  * frame info and the given `data`.
+ *
+ * Results are cached per address, so repeatedly symbolizing the same address
+ * does not hit the platform symbolizer again. `func` is invoked while the
+ * cache is locked, and must not symbolize any addresses itself.
  */
 bool sentry__symbolize(
     void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data);
 
+/**
+ * Symbolizes all the `len` addresses in `addrs` in one go, and calls `func`
+ * with a populated frame info, the index of the address in `addrs` and the
+ * given `data` for each of the addresses that could be symbolized.
+ * Returns the number of addresses that were symbolized.
+ *
+ * Addresses missing from the cache are sorted, so that the addresses of the
+ * same module are looked up in one contiguous pass, and duplicates are only
+ * looked up once. The same restrictions as for `sentry__symbolize` apply to
+ * `func`.
+ */
+size_t sentry__symbolize_many(void *const *addrs, size_t len,
+    void (*func)(const sentry_frame_info_t *, size_t, void *), void *data);
+
+/**
+ * Like `sentry__symbolize`, but bypasses the cache.
+ */
+bool sentry__symbolize_uncached(
+    void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data);
+
+/**
+ * The platform specific symbolizer behind `sentry__symbolize_many`, which
+ * bypasses the cache. The `len` addresses in `addrs` are sorted, and `func` is
+ * called with the index of each address that could be symbolized.
+ */
+void sentry__symbolize_many_uncached(void *const *addrs, size_t len,
+    void (*func)(const sentry_frame_info_t *, size_t, void *), void *data);
+
+/**
+ * Fills in the `function`, `package`, `symbol_addr` and `image_addr` of the
+ * frame object pointed to by `data` from `info`, unless they are already set.
+ */
+void sentry__symbolize_frame(const sentry_frame_info_t *info, void *data);
+
+/**
+ * Returns a frozen list of frames for the `len` instruction addresses in
+ * `ips`, with the outermost frame first. Recurring stacktraces share the same
+ * list instead of building their frames again. Returns `null` if the frames
+ * can not be interned, for example from within the signal handler.
+ */
+sentry_value_t sentry__symbolizer_intern_frames(void *const *ips, size_t len);
+
+/**
+ * Returns a frozen and symbolized copy of the `frames` that were returned by
+ * `sentry__symbolizer_intern_frames`. As long as the stacktrace stays
+ * interned, it is only symbolized once, and its copy is shared as well.
+ * Returns `null` for any other list of frames.
+ */
+sentry_value_t sentry__symbolizer_symbolize_frames(sentry_value_t frames);
+
+/**
+ * Drops all the cached symbols and interned stacktraces. This is done along
+ * with clearing the module cache, as a reloaded module may now live at an
+ * address that was cached.
+ */
+void sentry__symbolizer_clear_cache(void);
+
 #endif
@@ -2,6 +2,8 @@
 #include "sentry_alloc.h"
 #include "sentry_core.h"
 #include "sentry_string.h"
+#include "sentry_tracepoint.h"
+#include "sentry_unwinder.h"
 #include "sentry_utils.h"
 #include <stdio.h>
 #include <string.h>
@@ -75,7 +77,14 @@ sentry__thread_setname(sentry_threadid_t thread_id, const char *thread_name)
     }
     return pthread_setname_np(thread_name);
 #    elif defined(SENTRY_PLATFORM_LINUX) /* and possibly others (like BSDs) */
-    return pthread_setname_np(thread_id, thread_name);
+    int rv = pthread_setname_np(thread_id, thread_name);
+    if (rv == 0 && pthread_equal(thread_id, pthread_self())) {
+        sentry__unwinder_cache_thread_name(0, thread_name);
+    } else if (rv == 0) {
+        // the id of another thread is not known, so all names are read again
+        sentry__unwinder_reset_thread_names();
+    }
+    return rv;
 #    else
     /* XXX: AIX doesn't have it, but PASE does via ILE APIs. */
     return 0;
@@ -96,13 +105,50 @@ sentry__thread_setname(sentry_threadid_t thread_id, const char *thread_name)
  * one by the background thread for the currently executed task. The refcount
  * will be dropped when the task finished executing, and when the task is
  * removed from the queue (either after being executed, or when the task was
- * concurrently removed from the queue).
+ * concurrently removed from the queue). Tasks stay in the queue while they
+ * are executing.
  *
  * Each access to the queue itself must be done using the `task_lock`.
  * There are two signals, `submit` *to* the worker, signaling a new task, and
  * `done` *from* the worker signaling that it will close down and can be joined.
+ *
+ * Submitting a task does not take the `task_lock` though. Submitted tasks are
+ * pushed onto the lock-free `incoming` stack instead, which is moved to the
+ * queue by whoever holds the `task_lock` next, usually the worker itself.
+ * As tasks are only ever removed from `incoming` all at once, that stack is
+ * not subject to the ABA problem. A submitter only signals `submit`, which
+ * needs the `task_lock`, when the worker announced that it is `waiting`.
+ *
+ * Tasks submitted via `sentry__bgworker_submit_bounded` are `bounded`, and are
+ * accounted for in the atomic `queued_tasks` and `queued_bytes` from the time
+ * they are pushed to `incoming` until they are removed from the queue. Other
+ * tasks are always appended to the queue and never dropped. A bounded task
+ * that does not fit into the queue limits takes the `task_lock` to drop
+ * another task.
+ *
+ * Tasks submitted via `sentry__bgworker_submit_delayed` and
+ * `sentry__bgworker_submit_periodic` are timers, which are kept in the separate
+ * `timers` min-heap, ordered by their `execute_after` time and `timer_id`.
+ * Once a timer is due, the worker moves a one-shot timer to the end of the
+ * queue, and it is `fired` until it is removed from the queue again. A
+ * periodic timer stays in the heap, and the worker queues it again every
+ * `interval_ms`, unless it is still `queued` from the previous time.
+ *
+ * A flush has to wait for the one-shot timers that are due before its
+ * deadline, and for the tasks those submit in turn. It does so by submitting
+ * barriers until no timer fired in the meantime (which `timer_generation`
+ * counts), and none is due before the deadline anymore. A barrier that has to
+ * wait for a timer becomes a timer itself, due at the same time.
+ *
+ * The worker only ever wakes up for a reason: An idle worker without timers
+ * waits on `submit` indefinitely, otherwise it waits until the next timer is
+ * due.
  */
 
+// The longest single wait for a timer, which keeps the wait below the
+// `INFINITE` timeout on Windows.
+#define MAX_TIMER_WAIT_MS (24 * 60 * 60 * 1000ULL)
+
 struct sentry_bgworker_task_s;
 typedef struct sentry_bgworker_task_s {
     struct sentry_bgworker_task_s *next_task;
@@ -110,6 +156,16 @@ typedef struct sentry_bgworker_task_s {
     sentry_task_exec_func_t exec_func;
     void (*cleanup_func)(void *task_data);
     void *task_data;
+    bool bounded;
+    sentry_task_priority_t priority;
+    size_t size;
+    uint64_t execute_after;
+    bool barrier;
+    bool executing;
+    bool queued;
+    uint64_t timer_id;
+    uint64_t interval_ms;
+    bool fired;
 } sentry_bgworker_task_t;
 
 static void
@@ -137,10 +193,24 @@ struct sentry_bgworker_s {
     sentry_mutex_t task_lock;
     sentry_bgworker_task_t *first_task;
     sentry_bgworker_task_t *last_task;
+    sentry_bgworker_task_t **timers;
+    size_t timers_len;
+    size_t timers_cap;
+    uint64_t last_timer_id;
+    size_t fired_timers;
+    uint64_t timer_generation;
+    sentry_bgworker_task_t *volatile incoming;
     void *state;
     void (*free_state)(void *state);
+    size_t max_tasks;
+    size_t max_bytes;
+    bool (*can_drop)(void *task_data);
+    volatile long queued_tasks;
+    volatile long queued_bytes;
+    size_t dropped[SENTRY_TASK_PRIORITY_COUNT];
     long refcount;
     long running;
+    volatile long waiting;
 };
 
 sentry_bgworker_t *
@@ -184,6 +254,16 @@ sentry__bgworker_decref(sentry_bgworker_t *bgw)
         sentry__task_decref(task);
         task = next_task;
     }
+    for (size_t i = 0; i < bgw->timers_len; i++) {
+        sentry__task_decref(bgw->timers[i]);
+    }
+    sentry_free(bgw->timers);
+    task = bgw->incoming;
+    while (task) {
+        sentry_bgworker_task_t *next_task = task->next_task;
+        sentry__task_decref(task);
+        task = next_task;
+    }
     if (bgw->free_state) {
         bgw->free_state(bgw->state);
     }
@@ -199,6 +279,150 @@ sentry__bgworker_get_state(sentry_bgworker_t *bgw)
     return bgw->state;
 }
 
+/**
+ * Creates a new task. This cleans up `task_data` if it fails.
+ */
+static sentry_bgworker_task_t *
+sentry__bgworker_task_new(sentry_task_exec_func_t exec_func,
+    void (*cleanup_func)(void *task_data), void *task_data)
+{
+    sentry_bgworker_task_t *task = SENTRY_MAKE(sentry_bgworker_task_t);
+    if (!task) {
+        if (cleanup_func) {
+            cleanup_func(task_data);
+        }
+        return NULL;
+    }
+    memset(task, 0, sizeof(sentry_bgworker_task_t));
+    task->refcount = 1;
+    task->exec_func = exec_func;
+    task->cleanup_func = cleanup_func;
+    task->task_data = task_data;
+    return task;
+}
+
+/**
+ * Updates the queue accounting for `task` that was removed from the queue.
+ * This must only be called when the `task_lock` is held!
+ */
+static void
+sentry__bgworker_task_removed(
+    sentry_bgworker_t *bgw, sentry_bgworker_task_t *task)
+{
+    task->queued = false;
+    if (task->fired) {
+        task->fired = false;
+        bgw->fired_timers--;
+        bgw->timer_generation++;
+    }
+    if (task->bounded) {
+        sentry__atomic_fetch_and_add(&bgw->queued_tasks, -1);
+        sentry__atomic_fetch_and_add(&bgw->queued_bytes, -(long)task->size);
+    }
+}
+
+/**
+ * Reserves room for a bounded task of `size` bytes in `queued_tasks` and
+ * `queued_bytes`, returning false if that would exceed the queue limits.
+ * This does not need the `task_lock`.
+ */
+static bool
+sentry__bgworker_reserve(sentry_bgworker_t *bgw, size_t size)
+{
+    size_t tasks
+        = (size_t)sentry__atomic_fetch_and_add(&bgw->queued_tasks, 1) + 1;
+    size_t bytes
+        = (size_t)sentry__atomic_fetch_and_add(&bgw->queued_bytes, (long)size)
+        + size;
+    if ((!bgw->max_tasks || tasks <= bgw->max_tasks)
+        && (!bgw->max_bytes || bytes <= bgw->max_bytes)) {
+        return true;
+    }
+    sentry__atomic_fetch_and_add(&bgw->queued_tasks, -1);
+    sentry__atomic_fetch_and_add(&bgw->queued_bytes, -(long)size);
+    return false;
+}
+
+/**
+ * Inserts `task` into the queue. Bounded tasks are queued before the first
+ * task of a lower priority, but never before the first task, as that might be
+ * executing. Other tasks are appended.
+ * This must only be called when the `task_lock` is held!
+ */
+static void
+sentry__bgworker_insert_task(
+    sentry_bgworker_t *bgw, sentry_bgworker_task_t *task)
+{
+    sentry_bgworker_task_t *prev_task = bgw->last_task;
+    if (task->bounded) {
+        prev_task = bgw->first_task;
+        while (prev_task && prev_task->next_task
+            && !(prev_task->next_task->bounded
+                && prev_task->next_task->priority < task->priority)) {
+            prev_task = prev_task->next_task;
+        }
+    }
+    if (!prev_task) {
+        task->next_task = bgw->first_task;
+        bgw->first_task = task;
+    } else {
+        task->next_task = prev_task->next_task;
+        prev_task->next_task = task;
+    }
+    if (!task->next_task) {
+        bgw->last_task = task;
+    }
+    task->queued = true;
+}
+
+/**
+ * Moves all the `incoming` tasks to the queue, in the order of submission.
+ * This must only be called when the `task_lock` is held!
+ */
+static void
+sentry__bgworker_queue_incoming_tasks(sentry_bgworker_t *bgw)
+{
+    sentry_bgworker_task_t *task = sentry__atomic_exchange_ptr(
+        (void *volatile *)&bgw->incoming, NULL);
+    // `incoming` is a stack, so reverse it first
+    sentry_bgworker_task_t *reversed = NULL;
+    while (task) {
+        sentry_bgworker_task_t *next_task = task->next_task;
+        task->next_task = reversed;
+        reversed = task;
+        task = next_task;
+    }
+    while (reversed) {
+        sentry_bgworker_task_t *next_task = reversed->next_task;
+        sentry__bgworker_insert_task(bgw, reversed);
+        reversed = next_task;
+    }
+}
+
+/**
+ * Pushes `task` onto the `incoming` stack, and wakes up the worker if it is
+ * waiting for new tasks.
+ */
+static void
+sentry__bgworker_push_incoming(
+    sentry_bgworker_t *bgw, sentry_bgworker_task_t *task)
+{
+    sentry_bgworker_task_t *head;
+    do {
+        head = sentry__atomic_fetch_ptr((void *volatile *)&bgw->incoming);
+        task->next_task = head;
+    } while (!sentry__atomic_compare_swap_ptr(
+        (void *volatile *)&bgw->incoming, head, task));
+
+    // the worker announces that it is `waiting` before it checks `incoming`
+    // a final time, so either it sees this task, or we see that flag
+    if (sentry__atomic_fetch(&bgw->waiting)) {
+        sentry__mutex_lock(&bgw->task_lock);
+        sentry__cond_wake(&bgw->submit_signal);
+        sentry__mutex_unlock(&bgw->task_lock);
+    }
+}
+
 /**
  * Check if the bgworker is done running and can be shut down.
  * This function does *not* internally lock, and it should only be called when
@@ -210,6 +434,204 @@ sentry__bgworker_is_done(sentry_bgworker_t *bgw)
     return !bgw->first_task && !sentry__atomic_fetch(&bgw->running);
 }
 
+/**
+ * Removes the executed `task` from the queue, and returns false if it was
+ * already removed concurrently.
+ * This must only be called when the `task_lock` is held!
+ */
+static bool
+sentry__bgworker_pop_task(sentry_bgworker_t *bgw, sentry_bgworker_task_t *task)
+{
+    sentry_bgworker_task_t *prev_task = NULL;
+    sentry_bgworker_task_t **link = &bgw->first_task;
+    while (*link && *link != task) {
+        prev_task = *link;
+        link = &prev_task->next_task;
+    }
+    if (!*link) {
+        return false;
+    }
+    *link = task->next_task;
+    if (task == bgw->last_task) {
+        bgw->last_task = prev_task;
+    }
+    sentry__bgworker_task_removed(bgw, task);
+    return true;
+}
+
+/**
+ * The timer heap operations below must only be called when the `task_lock`
+ * is held!
+ */
+static bool
+sentry__timer_is_before(
+    const sentry_bgworker_task_t *a, const sentry_bgworker_task_t *b)
+{
+    return a->execute_after < b->execute_after
+        || (a->execute_after == b->execute_after && a->timer_id < b->timer_id);
+}
+
+static void
+sentry__timers_swap(sentry_bgworker_t *bgw, size_t a, size_t b)
+{
+    sentry_bgworker_task_t *task = bgw->timers[a];
+    bgw->timers[a] = bgw->timers[b];
+    bgw->timers[b] = task;
+}
+
+static void
+sentry__timers_sift_up(sentry_bgworker_t *bgw, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!sentry__timer_is_before(bgw->timers[i], bgw->timers[parent])) {
+            break;
+        }
+        sentry__timers_swap(bgw, i, parent);
+        i = parent;
+    }
+}
+
+static void
+sentry__timers_sift_down(sentry_bgworker_t *bgw, size_t i)
+{
+    while (true) {
+        size_t first = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < bgw->timers_len
+            && sentry__timer_is_before(bgw->timers[left], bgw->timers[first])) {
+            first = left;
+        }
+        if (right < bgw->timers_len
+            && sentry__timer_is_before(
+                bgw->timers[right], bgw->timers[first])) {
+            first = right;
+        }
+        if (first == i) {
+            break;
+        }
+        sentry__timers_swap(bgw, i, first);
+        i = first;
+    }
+}
+
+static bool
+sentry__timers_push(sentry_bgworker_t *bgw, sentry_bgworker_task_t *task)
+{
+    if (bgw->timers_len == bgw->timers_cap) {
+        size_t cap = bgw->timers_cap ? bgw->timers_cap * 2 : 8;
+        sentry_bgworker_task_t **timers
+            = sentry_malloc(sizeof(sentry_bgworker_task_t *) * cap);
+        if (!timers) {
+            return false;
+        }
+        if (bgw->timers_len) {
+            memcpy(timers, bgw->timers,
+                sizeof(sentry_bgworker_task_t *) * bgw->timers_len);
+        }
+        sentry_free(bgw->timers);
+        bgw->timers = timers;
+        bgw->timers_cap = cap;
+    }
+    task->timer_id = ++bgw->last_timer_id;
+    bgw->timers[bgw->timers_len] = task;
+    sentry__timers_sift_up(bgw, bgw->timers_len++);
+    return true;
+}
+
+static sentry_bgworker_task_t *
+sentry__timers_remove(sentry_bgworker_t *bgw, size_t i)
+{
+    sentry_bgworker_task_t *task = bgw->timers[i];
+    bgw->timers[i] = bgw->timers[--bgw->timers_len];
+    if (i < bgw->timers_len) {
+        sentry__timers_sift_down(bgw, i);
+        sentry__timers_sift_up(bgw, i);
+    }
+    return task;
+}
+
+/**
+ * Returns the time at which the next one-shot timer is due, which is
+ * `UINT64_MAX` if there is none.
+ */
+static uint64_t
+sentry__timers_next_one_shot(sentry_bgworker_t *bgw)
+{
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < bgw->timers_len; i++) {
+        const sentry_bgworker_task_t *task = bgw->timers[i];
+        if (!task->interval_ms && !task->barrier
+            && task->execute_after < next) {
+            next = task->execute_after;
+        }
+    }
+    return next;
+}
+
+/**
+ * Moves the timers which are due to the end of the queue, and returns the
+ * number of milliseconds until the next one is due, up to `max_wait_ms`.
+ * This must only be called when the `task_lock` is held!
+ */
+static uint64_t
+sentry__bgworker_queue_timers(sentry_bgworker_t *bgw, uint64_t max_wait_ms)
+{
+    uint64_t now = sentry__monotonic_time();
+    while (bgw->timers_len) {
+        sentry_bgworker_task_t *task = bgw->timers[0];
+        if (task->execute_after > now) {
+            uint64_t wait_ms = task->execute_after - now;
+            return wait_ms < max_wait_ms ? wait_ms : max_wait_ms;
+        }
+        if (!task->interval_ms) {
+            // the reference of the heap moves to the queue
+            sentry__timers_remove(bgw, 0);
+            if (!task->barrier) {
+                task->fired = true;
+                bgw->fired_timers++;
+            }
+            sentry__bgworker_insert_task(bgw, task);
+            continue;
+        }
+
+        // periodic timers skip the times they fall behind, and are only queued
+        // once at a time
+        uint64_t next = task->execute_after + task->interval_ms;
+        task->execute_after = next > now ? next : now + task->interval_ms;
+        sentry__timers_sift_down(bgw, 0);
+        if (!task->queued) {
+            sentry__task_incref(task);
+            sentry__bgworker_insert_task(bgw, task);
+        }
+    }
+    return max_wait_ms;
+}
+
+/**
+ * Adds `task` to the timers, due in `delay_ms`, and wakes up the worker.
+ * This cleans up `task` if it fails, and otherwise returns its timer id.
+ */
+static uint64_t
+sentry__bgworker_schedule(
+    sentry_bgworker_t *bgw, sentry_bgworker_task_t *task, uint64_t delay_ms)
+{
+    task->execute_after = sentry__monotonic_time() + delay_ms;
+    sentry__mutex_lock(&bgw->task_lock);
+    bool pushed = sentry__timers_push(bgw, task);
+    uint64_t timer_id = task->timer_id;
+    if (pushed) {
+        sentry__cond_wake(&bgw->submit_signal);
+    }
+    sentry__mutex_unlock(&bgw->task_lock);
+    if (!pushed) {
+        sentry__task_decref(task);
+        return 0;
+    }
+    return timer_id;
+}
+
 SENTRY_THREAD_FN
 worker_thread(void *data)
 {
@@ -224,6 +646,9 @@ worker_thread(void *data)
 
     sentry__mutex_lock(&bgw->task_lock);
     while (true) {
+        sentry__bgworker_queue_incoming_tasks(bgw);
+        uint64_t wait_ms
+            = sentry__bgworker_queue_timers(bgw, MAX_TIMER_WAIT_MS);
         if (sentry__bgworker_is_done(bgw)) {
             sentry__cond_wake(&bgw->done_signal);
             sentry__mutex_unlock(&bgw->task_lock);
@@ -232,35 +657,47 @@ worker_thread(void *data)
 
         sentry_bgworker_task_t *task = bgw->first_task;
         if (!task) {
+            sentry__atomic_store(&bgw->waiting, 1);
+            if (sentry__atomic_fetch_ptr((void *volatile *)&bgw->incoming)) {
+                sentry__atomic_store(&bgw->waiting, 0);
+                continue;
+            }
             // this will implicitly release the lock, and re-acquire on wake
-            sentry__cond_wait_timeout(
-                &bgw->submit_signal, &bgw->task_lock, 1000);
+            if (bgw->timers_len) {
+                sentry__cond_wait_timeout(&bgw->submit_signal,
+                    &bgw->task_lock, wait_ms ? wait_ms : 1);
+            } else {
+                sentry__cond_wait(&bgw->submit_signal, &bgw->task_lock);
+            }
+            sentry__atomic_store(&bgw->waiting, 0);
             continue;
         }
 
+        task->executing = true;
         sentry__task_incref(task);
         sentry__mutex_unlock(&bgw->task_lock);
 
         SENTRY_TRACE("executing task on worker thread");
+        SENTRY_TRACEPOINT(bgworker__task__start);
         task->exec_func(task->task_data, bgw->state);
-        // the task can have a refcount of 2, this `decref` here corresponds
-        // to the `incref` above which signifies that the task _is being
-        // processed_.
-        sentry__task_decref(task);
+        SENTRY_TRACEPOINT(bgworker__task__end);
 
         // check if the queue has been modified concurrently.
-        // if not, we pop it and `decref` again, removing the _is inside
-        // list_ refcount.
+        // if not, we pop it and `decref`, removing the _is inside list_
+        // refcount.
         sentry__mutex_lock(&bgw->task_lock);
-        if (bgw->first_task == task) {
-            bgw->first_task = task->next_task;
-            if (task == bgw->last_task) {
-                bgw->last_task = NULL;
-            }
+        task->executing = false;
+        if (sentry__bgworker_pop_task(bgw, task)) {
             sentry__task_decref(task);
         }
+        // the task can have a refcount of 2, this `decref` here corresponds
+        // to the `incref` above which signifies that the task _is being
+        // processed_.
+        sentry__task_decref(task);
     }
     SENTRY_TRACE("background worker thread shut down");
+    // the id of this thread may be reused by another one
+    sentry__unwinder_cache_thread_name(0, NULL);
     // this decref corresponds to the one done below in `sentry__bgworker_start`
     sentry__bgworker_decref(bgw);
     return 0;
@@ -281,6 +718,25 @@ sentry__bgworker_start(sentry_bgworker_t *bgw)
     return 0;
 }
 
+/**
+ * Submits a `barrier` task, which is executed once all the tasks queued before
+ * it have finished executing, and which does not count as a fired timer.
+ */
+static int
+sentry__bgworker_submit_barrier(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data)
+{
+    sentry_bgworker_task_t *task
+        = sentry__bgworker_task_new(exec_func, cleanup_func, task_data);
+    if (!task) {
+        return 1;
+    }
+    task->barrier = true;
+    sentry__bgworker_push_incoming(bgw, task);
+    return 0;
+}
+
 typedef struct {
     long refcount;
     bool was_flushed;
@@ -308,19 +764,18 @@ sentry__flush_task_decref(sentry_flush_task_t *task)
     }
 }
 
-int
-sentry__bgworker_flush(sentry_bgworker_t *bgw, uint64_t timeout)
+/**
+ * Submits a flush barrier, which is due in `delay_ms`, and waits for it to be
+ * executed until `deadline`. Returns true if it was.
+ */
+static bool
+sentry__bgworker_flush_barrier(
+    sentry_bgworker_t *bgw, uint64_t delay_ms, uint64_t deadline)
 {
-    if (!sentry__atomic_fetch(&bgw->running)) {
-        SENTRY_WARN("trying to flush non-running thread");
-        return 0;
-    }
-    SENTRY_TRACE("flushing background worker thread");
-
     sentry_flush_task_t *flush_task
         = sentry_malloc(sizeof(sentry_flush_task_t));
     if (!flush_task) {
-        return 1;
+        return false;
     }
     memset(flush_task, 0, sizeof(sentry_flush_task_t));
     flush_task->refcount = 2; // this thread + background worker
@@ -331,25 +786,72 @@ sentry__bgworker_flush(sentry_bgworker_t *bgw, uint64_t timeout)
     sentry__mutex_lock(&flush_task->lock);
 
     /* submit the task that triggers our condvar once it runs */
-    sentry__bgworker_submit(bgw, sentry__flush_task,
-        (void (*)(void *))sentry__flush_task_decref, flush_task);
+    if (!delay_ms) {
+        sentry__bgworker_submit_barrier(bgw, sentry__flush_task,
+            (void (*)(void *))sentry__flush_task_decref, flush_task);
+    } else {
+        sentry_bgworker_task_t *task
+            = sentry__bgworker_task_new(sentry__flush_task,
+                (void (*)(void *))sentry__flush_task_decref, flush_task);
+        if (task) {
+            task->barrier = true;
+            sentry__bgworker_schedule(bgw, task, delay_ms);
+        }
+    }
 
-    uint64_t started = sentry__monotonic_time();
     bool was_flushed = false;
     while (true) {
         was_flushed = flush_task->was_flushed;
 
         uint64_t now = sentry__monotonic_time();
-        if (was_flushed || (now > started && now - started > timeout)) {
+        if (was_flushed || now > deadline) {
             sentry__mutex_unlock(&flush_task->lock);
             sentry__flush_task_decref(flush_task);
-
-            // return `0` on success
-            return !was_flushed;
+            return was_flushed;
         }
 
         // this will implicitly release the lock, and re-acquire on wake
-        sentry__cond_wait_timeout(&flush_task->signal, &flush_task->lock, 250);
+        sentry__cond_wait_timeout(
+            &flush_task->signal, &flush_task->lock, deadline - now + 1);
+    }
+}
+
+int
+sentry__bgworker_flush(sentry_bgworker_t *bgw, uint64_t timeout)
+{
+    if (!sentry__atomic_fetch(&bgw->running)) {
+        SENTRY_WARN("trying to flush non-running thread");
+        return 0;
+    }
+    SENTRY_TRACE("flushing background worker thread");
+
+    uint64_t deadline = sentry__monotonic_time() + timeout;
+    uint64_t delay_ms = 0;
+    while (true) {
+        sentry__mutex_lock(&bgw->task_lock);
+        uint64_t generation = bgw->timer_generation;
+        sentry__mutex_unlock(&bgw->task_lock);
+
+        if (!sentry__bgworker_flush_barrier(bgw, delay_ms, deadline)) {
+            return 1;
+        }
+
+        // timers that fired in the meantime might have submitted more tasks,
+        // and timers that are due before the deadline need another barrier
+        sentry__mutex_lock(&bgw->task_lock);
+        bool fired = bgw->fired_timers || bgw->timer_generation != generation;
+        uint64_t next_timer = sentry__timers_next_one_shot(bgw);
+        sentry__mutex_unlock(&bgw->task_lock);
+
+        uint64_t now = sentry__monotonic_time();
+        if (fired) {
+            delay_ms = 0;
+        } else if (next_timer <= deadline) {
+            delay_ms = next_timer > now ? next_timer - now : 0;
+        } else {
+            // return `0` on success
+            return 0;
+        }
     }
 }
 
@@ -370,7 +872,7 @@ sentry__bgworker_shutdown(sentry_bgworker_t *bgw, uint64_t timeout)
     SENTRY_TRACE("shutting down background worker thread");
 
     /* submit a task to shut down the queue */
-    sentry__bgworker_submit(bgw, shutdown_task, NULL, bgw);
+    sentry__bgworker_submit_barrier(bgw, shutdown_task, NULL, bgw);
 
     uint64_t started = sentry__monotonic_time();
     sentry__mutex_lock(&bgw->task_lock);
@@ -382,7 +884,8 @@ sentry__bgworker_shutdown(sentry_bgworker_t *bgw, uint64_t timeout)
         }
 
         uint64_t now = sentry__monotonic_time();
-        if (now > started && now - started > timeout) {
+        uint64_t elapsed = now > started ? now - started : 0;
+        if (elapsed > timeout) {
             sentry__atomic_store(&bgw->running, 0);
             sentry__thread_detach(bgw->thread_id);
             sentry__mutex_unlock(&bgw->task_lock);
@@ -392,7 +895,8 @@ sentry__bgworker_shutdown(sentry_bgworker_t *bgw, uint64_t timeout)
         }
 
         // this will implicitly release the lock, and re-acquire on wake
-        sentry__cond_wait_timeout(&bgw->done_signal, &bgw->task_lock, 250);
+        sentry__cond_wait_timeout(
+            &bgw->done_signal, &bgw->task_lock, timeout - elapsed + 1);
     }
 }
 
@@ -401,40 +905,196 @@ sentry__bgworker_submit(sentry_bgworker_t *bgw,
     sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
     void *task_data)
 {
-    sentry_bgworker_task_t *task = SENTRY_MAKE(sentry_bgworker_task_t);
+    sentry_bgworker_task_t *task
+        = sentry__bgworker_task_new(exec_func, cleanup_func, task_data);
     if (!task) {
-        if (cleanup_func) {
-            cleanup_func(task_data);
+        return 1;
+    }
+
+    SENTRY_TRACE("submitting task to background worker thread");
+    sentry__bgworker_push_incoming(bgw, task);
+
+    return 0;
+}
+
+int
+sentry__bgworker_submit_delayed(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, uint64_t delay_ms, uint64_t *timer_id)
+{
+    sentry_bgworker_task_t *task
+        = sentry__bgworker_task_new(exec_func, cleanup_func, task_data);
+    if (!task) {
+        return 1;
+    }
+
+    SENTRY_TRACE("submitting delayed task to background worker thread");
+    uint64_t id = sentry__bgworker_schedule(bgw, task, delay_ms);
+    if (timer_id) {
+        *timer_id = id;
+    }
+    return id ? 0 : 1;
+}
+
+int
+sentry__bgworker_submit_periodic(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, uint64_t interval_ms, uint64_t *timer_id)
+{
+    sentry_bgworker_task_t *task
+        = sentry__bgworker_task_new(exec_func, cleanup_func, task_data);
+    if (!task) {
+        return 1;
+    }
+    task->interval_ms = interval_ms ? interval_ms : 1;
+
+    SENTRY_TRACE("submitting periodic task to background worker thread");
+    uint64_t id = sentry__bgworker_schedule(bgw, task, task->interval_ms);
+    if (timer_id) {
+        *timer_id = id;
+    }
+    return id ? 0 : 1;
+}
+
+bool
+sentry__bgworker_cancel_timer(sentry_bgworker_t *bgw, uint64_t timer_id)
+{
+    sentry_bgworker_task_t *task = NULL;
+    sentry__mutex_lock(&bgw->task_lock);
+    for (size_t i = 0; timer_id && i < bgw->timers_len; i++) {
+        if (bgw->timers[i]->timer_id == timer_id) {
+            task = sentry__timers_remove(bgw, i);
+            break;
+        }
+    }
+    // a periodic timer might still be queued, but not executing yet
+    if (task && task->queued && !task->executing
+        && sentry__bgworker_pop_task(bgw, task)) {
+        sentry__task_decref(task);
+    }
+    sentry__mutex_unlock(&bgw->task_lock);
+
+    if (!task) {
+        return false;
+    }
+    sentry__task_decref(task);
+    return true;
+}
+
+void
+sentry__bgworker_set_queue_limits(sentry_bgworker_t *bgw, size_t max_tasks,
+    size_t max_bytes, bool (*can_drop)(void *task_data))
+{
+    sentry__mutex_lock(&bgw->task_lock);
+    bgw->max_tasks = max_tasks;
+    bgw->max_bytes = max_bytes;
+    bgw->can_drop = can_drop;
+    sentry__mutex_unlock(&bgw->task_lock);
+}
+
+/**
+ * Drops the oldest droppable task of the lowest priority, as long as that
+ * priority is not higher than `priority`. Executing tasks and the first task,
+ * which might be about to execute, are never dropped. Returns false if no task
+ * could be dropped.
+ * This must only be called when the `task_lock` is held!
+ */
+static bool
+sentry__bgworker_drop_task(
+    sentry_bgworker_t *bgw, sentry_task_priority_t priority)
+{
+    sentry_bgworker_task_t *victim = NULL;
+    sentry_bgworker_task_t *victim_prev = NULL;
+    sentry_bgworker_task_t *prev_task = bgw->first_task;
+    sentry_bgworker_task_t *task = prev_task ? prev_task->next_task : NULL;
+    for (; task; prev_task = task, task = task->next_task) {
+        if (!task->bounded || task->executing || task->priority > priority
+            || (victim && task->priority >= victim->priority)
+            || (bgw->can_drop && !bgw->can_drop(task->task_data))) {
+            continue;
         }
+        victim = task;
+        victim_prev = prev_task;
+    }
+    if (!victim) {
+        return false;
+    }
+
+    victim_prev->next_task = victim->next_task;
+    if (victim == bgw->last_task) {
+        bgw->last_task = victim_prev;
+    }
+    sentry__bgworker_task_removed(bgw, victim);
+    bgw->dropped[victim->priority]++;
+    SENTRY_DEBUG("dropping queued task because the queue is full");
+    sentry__task_decref(victim);
+    return true;
+}
+
+int
+sentry__bgworker_submit_bounded(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, sentry_task_priority_t priority, size_t size)
+{
+    sentry_bgworker_task_t *task
+        = sentry__bgworker_task_new(exec_func, cleanup_func, task_data);
+    if (!task) {
         return 1;
     }
-    task->next_task = NULL;
-    task->refcount = 1;
-    task->exec_func = exec_func;
-    task->cleanup_func = cleanup_func;
-    task->task_data = task_data;
+    task->bounded = true;
+    task->priority = priority;
+    task->size = size;
 
     SENTRY_TRACE("submitting task to background worker thread");
+    if (sentry__bgworker_reserve(bgw, size)) {
+        sentry__bgworker_push_incoming(bgw, task);
+        return 0;
+    }
+
+    // the queue is full, so we have to look for a task to drop
     sentry__mutex_lock(&bgw->task_lock);
-    if (!bgw->first_task) {
-        bgw->first_task = task;
+    sentry__bgworker_queue_incoming_tasks(bgw);
+    bool fits = !bgw->max_bytes || size <= bgw->max_bytes;
+    while (fits && !sentry__bgworker_reserve(bgw, size)) {
+        fits = sentry__bgworker_drop_task(bgw, priority);
     }
-    if (bgw->last_task) {
-        bgw->last_task->next_task = task;
+    if (!fits) {
+        bgw->dropped[priority]++;
+        sentry__mutex_unlock(&bgw->task_lock);
+        SENTRY_DEBUG("dropping task because the queue is full");
+        sentry__task_decref(task);
+        return 1;
     }
-    bgw->last_task = task;
+    sentry__bgworker_insert_task(bgw, task);
     sentry__cond_wake(&bgw->submit_signal);
     sentry__mutex_unlock(&bgw->task_lock);
 
     return 0;
 }
 
+size_t
+sentry__bgworker_get_dropped(
+    sentry_bgworker_t *bgw, sentry_task_priority_t priority)
+{
+    sentry__mutex_lock(&bgw->task_lock);
+    size_t dropped = bgw->dropped[priority];
+    sentry__mutex_unlock(&bgw->task_lock);
+    return dropped;
+}
+
+size_t
+sentry__bgworker_get_queue_depth(sentry_bgworker_t *bgw)
+{
+    return (size_t)sentry__atomic_fetch(&bgw->queued_tasks);
+}
+
 size_t
 sentry__bgworker_foreach_matching(sentry_bgworker_t *bgw,
     sentry_task_exec_func_t exec_func,
     bool (*callback)(void *task_data, void *data), void *data)
 {
     sentry__mutex_lock(&bgw->task_lock);
+    sentry__bgworker_queue_incoming_tasks(bgw);
     sentry_bgworker_task_t *task = bgw->first_task;
     sentry_bgworker_task_t *prev_task = NULL;
     size_t dropped = 0;
@@ -453,6 +1113,7 @@ sentry__bgworker_foreach_matching(sentry_bgworker_t *bgw,
             } else {
                 bgw->first_task = next_task;
             }
+            sentry__bgworker_task_removed(bgw, task);
             sentry__task_decref(task);
             dropped++;
         } else {
@@ -462,6 +1123,21 @@ sentry__bgworker_foreach_matching(sentry_bgworker_t *bgw,
         task = next_task;
     }
     bgw->last_task = prev_task;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < bgw->timers_len; i++) {
+        task = bgw->timers[i];
+        if (task->exec_func == exec_func && callback(task->task_data, data)) {
+            sentry__task_decref(task);
+            dropped++;
+        } else {
+            bgw->timers[kept++] = task;
+        }
+    }
+    bgw->timers_len = kept;
+    for (size_t i = kept / 2; i > 0; i--) {
+        sentry__timers_sift_down(bgw, i - 1);
+    }
     sentry__mutex_unlock(&bgw->task_lock);
 
     return dropped;
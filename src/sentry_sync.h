@@ -13,6 +13,12 @@
 #    define THREAD_FUNCTION_API
 #endif
 
+#ifdef _MSC_VER
+#    define SENTRY_THREAD_LOCAL __declspec(thread)
+#else
+#    define SENTRY_THREAD_LOCAL __thread
+#endif
+
 #if defined(__MINGW32__) && !defined(__MINGW64__)
 #    define UNSIGNED_MINGW unsigned
 #else
@@ -170,8 +176,8 @@ typedef struct sentry__winmutex_s sentry_mutex_t;
             INIT_ONCE_STATIC_INIT, { 0 }                                       \
         }
 #    define sentry__mutex_init(Lock) sentry__winmutex_init(Lock)
-#    define sentry__mutex_lock(Lock) sentry__winmutex_lock(Lock)
-#    define sentry__mutex_unlock(Lock)                                         \
+#    define sentry__mutex_lock_raw(Lock) sentry__winmutex_lock(Lock)
+#    define sentry__mutex_unlock_raw(Lock)                                     \
         LeaveCriticalSection(&(Lock)->critical_section)
 #    define sentry__mutex_free(Lock)                                           \
         DeleteCriticalSection(&(Lock)->critical_section)
@@ -196,24 +202,43 @@ typedef CONDITION_VARIABLE_PREVISTA sentry_cond_t;
 #        define sentry__cond_init(CondVar)                                     \
             InitializeConditionVariable_PREVISTA(CondVar)
 #        define sentry__cond_wake WakeConditionVariable_PREVISTA
-#        define sentry__cond_wait_timeout(CondVar, Lock, Timeout)              \
+#        define sentry__cond_wait_timeout_raw(CondVar, Lock, Timeout)          \
             SleepConditionVariableCS_PREVISTA(                                 \
                 CondVar, &(Lock)->critical_section, Timeout)
 #    else
 typedef CONDITION_VARIABLE sentry_cond_t;
 #        define sentry__cond_init(CondVar) InitializeConditionVariable(CondVar)
 #        define sentry__cond_wake WakeConditionVariable
-#        define sentry__cond_wait_timeout(CondVar, Lock, Timeout)              \
+#        define sentry__cond_wait_timeout_raw(CondVar, Lock, Timeout)          \
             SleepConditionVariableCS(                                          \
                 CondVar, &(Lock)->critical_section, Timeout)
 #    endif
-#    define sentry__cond_wait(CondVar, Lock)                                   \
-        sentry__cond_wait_timeout(CondVar, Lock, INFINITE)
+#    define sentry__cond_wait_raw(CondVar, Lock)                               \
+        sentry__cond_wait_timeout_raw(CondVar, Lock, INFINITE)
+
+// slim reader/writer locks are only available starting with Vista, before
+// that all readers are simply serialized on a mutex
+#    if _WIN32_WINNT < 0x0600
+typedef sentry_mutex_t sentry_rwlock_t;
+#        define SENTRY__RWLOCK_INIT SENTRY__MUTEX_INIT
+#        define sentry__rwlock_lock_shared_raw sentry__mutex_lock_raw
+#        define sentry__rwlock_unlock_shared_raw sentry__mutex_unlock_raw
+#        define sentry__rwlock_lock_raw sentry__mutex_lock_raw
+#        define sentry__rwlock_unlock_raw sentry__mutex_unlock_raw
+#    else
+typedef SRWLOCK sentry_rwlock_t;
+#        define SENTRY__RWLOCK_INIT SRWLOCK_INIT
+#        define sentry__rwlock_lock_shared_raw AcquireSRWLockShared
+#        define sentry__rwlock_unlock_shared_raw ReleaseSRWLockShared
+#        define sentry__rwlock_lock_raw AcquireSRWLockExclusive
+#        define sentry__rwlock_unlock_raw ReleaseSRWLockExclusive
+#    endif
 
 #else
 #    include <errno.h>
 #    include <pthread.h>
 #    include <sys/time.h>
+#    include <time.h>
 
 /* on unix systems signal handlers can interrupt anything which means that
    we're restricted in what we can do.  In particular it's possible that
@@ -276,7 +301,7 @@ typedef pthread_cond_t sentry_cond_t;
             sentry_mutex_t tmp = SENTRY__MUTEX_INIT;                           \
             *(Mutex) = tmp;                                                    \
         } while (0)
-#    define sentry__mutex_lock(Mutex)                                          \
+#    define sentry__mutex_lock_raw(Mutex)                                      \
         do {                                                                   \
             if (sentry__block_for_signal_handler()) {                          \
                 int rv = pthread_mutex_lock(Mutex);                            \
@@ -284,7 +309,7 @@ typedef pthread_cond_t sentry_cond_t;
                 assert(rv == 0);                                               \
             }                                                                  \
         } while (0)
-#    define sentry__mutex_unlock(Mutex)                                        \
+#    define sentry__mutex_unlock_raw(Mutex)                                    \
         do {                                                                   \
             if (sentry__block_for_signal_handler()) {                          \
                 pthread_mutex_unlock(Mutex);                                   \
@@ -292,12 +317,53 @@ typedef pthread_cond_t sentry_cond_t;
         } while (0)
 #    define sentry__mutex_free(Lock) pthread_mutex_destroy(Lock)
 
-#    define sentry__cond_init(CondVar)                                         \
+// reader/writer locks are not recursive, neither in shared nor in exclusive
+// mode. They are bypassed during signal handling just like the mutexes above.
+typedef pthread_rwlock_t sentry_rwlock_t;
+#    define SENTRY__RWLOCK_INIT PTHREAD_RWLOCK_INITIALIZER
+#    define sentry__rwlock_lock_shared_raw(RwLock)                             \
         do {                                                                   \
-            sentry_cond_t tmp = PTHREAD_COND_INITIALIZER;                      \
-            *(CondVar) = tmp;                                                  \
+            if (sentry__block_for_signal_handler()) {                          \
+                int rv = pthread_rwlock_rdlock(RwLock);                        \
+                (void)rv;                                                      \
+                assert(rv == 0);                                               \
+            }                                                                  \
         } while (0)
-#    define sentry__cond_wait(Cond, Mutex)                                     \
+#    define sentry__rwlock_lock_raw(RwLock)                                    \
+        do {                                                                   \
+            if (sentry__block_for_signal_handler()) {                          \
+                int rv = pthread_rwlock_wrlock(RwLock);                        \
+                (void)rv;                                                      \
+                assert(rv == 0);                                               \
+            }                                                                  \
+        } while (0)
+#    define sentry__rwlock_unlock_raw(RwLock)                                  \
+        do {                                                                   \
+            if (sentry__block_for_signal_handler()) {                          \
+                pthread_rwlock_unlock(RwLock);                                 \
+            }                                                                  \
+        } while (0)
+#    define sentry__rwlock_unlock_shared_raw sentry__rwlock_unlock_raw
+
+#    ifdef SENTRY_PLATFORM_DARWIN
+// Darwin lacks `pthread_condattr_setclock`, but its relative timed waits
+// (see `sentry__cond_wait_timeout`) are not affected by wall-clock jumps.
+#        define sentry__cond_init(CondVar)                                     \
+            do {                                                               \
+                sentry_cond_t tmp = PTHREAD_COND_INITIALIZER;                  \
+                *(CondVar) = tmp;                                              \
+            } while (0)
+#    else
+#        define sentry__cond_init(CondVar)                                     \
+            do {                                                               \
+                pthread_condattr_t attr;                                       \
+                pthread_condattr_init(&attr);                                  \
+                pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);             \
+                pthread_cond_init(CondVar, &attr);                             \
+                pthread_condattr_destroy(&attr);                               \
+            } while (0)
+#    endif
+#    define sentry__cond_wait_raw(Cond, Mutex)                                 \
         do {                                                                   \
             if (sentry__block_for_signal_handler()) {                          \
                 pthread_cond_wait(Cond, Mutex);                                \
@@ -315,21 +381,96 @@ typedef pthread_cond_t sentry_cond_t;
 #    define sentry__current_thread pthread_self
 
 static inline int
-sentry__cond_wait_timeout(
+sentry__cond_wait_timeout_raw(
     sentry_cond_t *cv, sentry_mutex_t *mutex, uint64_t msecs)
 {
     if (!sentry__block_for_signal_handler()) {
         return 0;
     }
-    struct timeval now;
-    struct timespec lock_time;
-    gettimeofday(&now, NULL);
-    lock_time.tv_sec = now.tv_sec + msecs / 1000ULL;
-    lock_time.tv_nsec = (now.tv_usec + 1000ULL * (msecs % 1000)) * 1000ULL;
-    return pthread_cond_timedwait(cv, mutex, &lock_time);
+#    ifdef SENTRY_PLATFORM_DARWIN
+    struct timespec timeout;
+    timeout.tv_sec = (time_t)(msecs / 1000);
+    timeout.tv_nsec = (long)(msecs % 1000) * 1000000L;
+    return pthread_cond_timedwait_relative_np(cv, mutex, &timeout);
+#    else
+    // the condition variable was initialized to use the monotonic clock
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t)(msecs / 1000);
+    deadline.tv_nsec += (long)(msecs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cv, mutex, &deadline);
+#    endif
 }
 #endif
 
+#ifdef SENTRY_WITH_LOCK_STATS
+/**
+ * With the `SENTRY_LOCK_STATS` CMake option, every lock records how often it
+ * is acquired, how long threads wait for it and how long it is held at most.
+ *
+ * The statistics of a lock are keyed by the file and the expression that it
+ * is locked with, like `sentry_core.c:g_options_lock`. The time spent waiting
+ * on a condition variable does not count towards holding its mutex.
+ */
+uint64_t sentry__lock_stats_begin(void);
+void sentry__lock_stats_acquired(const void *lock, const char *file,
+    const char *name, volatile long *slot, uint64_t started);
+void sentry__lock_stats_released(const void *lock);
+void sentry__lock_stats_wait_begin(const void *lock);
+int sentry__lock_stats_wait_end(const void *lock, int rv);
+
+// the slot of the lock is looked up once per call site
+#    define SENTRY__LOCK_WITH_STATS(LockFunc, Lock)                            \
+        do {                                                                   \
+            static volatile long sentry__lock_slot = -1;                       \
+            uint64_t sentry__lock_started = sentry__lock_stats_begin();        \
+            LockFunc(Lock);                                                    \
+            sentry__lock_stats_acquired(Lock, __FILE__, #Lock,                 \
+                &sentry__lock_slot, sentry__lock_started);                     \
+        } while (0)
+#    define SENTRY__UNLOCK_WITH_STATS(UnlockFunc, Lock)                        \
+        do {                                                                   \
+            sentry__lock_stats_released(Lock);                                 \
+            UnlockFunc(Lock);                                                  \
+        } while (0)
+
+#    define sentry__mutex_lock(Mutex)                                          \
+        SENTRY__LOCK_WITH_STATS(sentry__mutex_lock_raw, Mutex)
+#    define sentry__mutex_unlock(Mutex)                                        \
+        SENTRY__UNLOCK_WITH_STATS(sentry__mutex_unlock_raw, Mutex)
+#    define sentry__rwlock_lock(RwLock)                                        \
+        SENTRY__LOCK_WITH_STATS(sentry__rwlock_lock_raw, RwLock)
+#    define sentry__rwlock_unlock(RwLock)                                      \
+        SENTRY__UNLOCK_WITH_STATS(sentry__rwlock_unlock_raw, RwLock)
+#    define sentry__rwlock_lock_shared(RwLock)                                 \
+        SENTRY__LOCK_WITH_STATS(sentry__rwlock_lock_shared_raw, RwLock)
+#    define sentry__rwlock_unlock_shared(RwLock)                               \
+        SENTRY__UNLOCK_WITH_STATS(sentry__rwlock_unlock_shared_raw, RwLock)
+#    define sentry__cond_wait(Cond, Mutex)                                     \
+        do {                                                                   \
+            sentry__lock_stats_wait_begin(Mutex);                              \
+            sentry__cond_wait_raw(Cond, Mutex);                                \
+            sentry__lock_stats_wait_end(Mutex, 0);                             \
+        } while (0)
+#    define sentry__cond_wait_timeout(Cond, Mutex, Timeout)                    \
+        (sentry__lock_stats_wait_begin(Mutex),                                 \
+            sentry__lock_stats_wait_end(                                       \
+                Mutex, sentry__cond_wait_timeout_raw(Cond, Mutex, Timeout)))
+#else
+#    define sentry__mutex_lock sentry__mutex_lock_raw
+#    define sentry__mutex_unlock sentry__mutex_unlock_raw
+#    define sentry__rwlock_lock sentry__rwlock_lock_raw
+#    define sentry__rwlock_unlock sentry__rwlock_unlock_raw
+#    define sentry__rwlock_lock_shared sentry__rwlock_lock_shared_raw
+#    define sentry__rwlock_unlock_shared sentry__rwlock_unlock_shared_raw
+#    define sentry__cond_wait sentry__cond_wait_raw
+#    define sentry__cond_wait_timeout sentry__cond_wait_timeout_raw
+#endif
+
 static inline long
 sentry__atomic_fetch_and_add(volatile long *val, long diff)
 {
@@ -364,11 +505,124 @@ sentry__atomic_fetch(volatile long *val)
     return sentry__atomic_fetch_and_add(val, 0);
 }
 
+/**
+ * Replaces the value at `val` with `desired`, if it is still `expected`.
+ * Returns true if it was replaced.
+ */
+static inline bool
+sentry__atomic_compare_swap(volatile long *val, long expected, long desired)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    if SIZEOF_LONG == 8
+    return InterlockedCompareExchange64((LONG64 *)val, desired, expected)
+        == expected;
+#    else
+    return InterlockedCompareExchange((LONG *)val, desired, expected)
+        == expected;
+#    endif
+#else
+    return __atomic_compare_exchange_n(
+        val, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Stores the 64-bit `value` at `val`, which also works where `long` only has
+ * 32 bits, like on Windows.
+ */
+static inline void
+sentry__atomic_store_u64(volatile uint64_t *val, uint64_t value)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    InterlockedExchange64((LONG64 volatile *)val, (LONG64)value);
+#else
+    __atomic_store_n(val, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline uint64_t
+sentry__atomic_fetch_u64(volatile uint64_t *val)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return (uint64_t)InterlockedCompareExchange64(
+        (LONG64 volatile *)val, 0, 0);
+#else
+    return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void *
+sentry__atomic_exchange_ptr(void *volatile *ptr, void *value)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return InterlockedExchangePointer((PVOID volatile *)ptr, value);
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Replaces the pointer at `ptr` with `desired`, if it is still `expected`.
+ * Returns true if it was replaced.
+ */
+static inline bool
+sentry__atomic_compare_swap_ptr(
+    void *volatile *ptr, void *expected, void *desired)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return InterlockedCompareExchangePointer(
+               (PVOID volatile *)ptr, desired, expected)
+        == expected;
+#else
+    return __atomic_compare_exchange_n(
+        ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void *
+sentry__atomic_fetch_ptr(void *volatile *ptr)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    return InterlockedCompareExchangePointer((PVOID volatile *)ptr, NULL, NULL);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Sets the name of the thread `thread_id`, where supported, and updates the
+ * cached name that `sentry__unwinder_thread_name` returns.
+ * Returns 0 on success.
+ */
+int sentry__thread_setname(
+    sentry_threadid_t thread_id, const char *thread_name);
+
+/**
+ * A background worker runs its tasks on exactly one thread, one after the
+ * other. Its users rely on that: the transports share handles that are not
+ * synchronized between their tasks, and the async capture runs `before_send`
+ * and the other user hooks on it, which are not expected to run concurrently.
+ * Work that is independent of a worker gets a worker of its own instead, like
+ * the profiler and the watchdog do.
+ */
 struct sentry_bgworker_s;
 typedef struct sentry_bgworker_s sentry_bgworker_t;
 
 typedef void (*sentry_task_exec_func_t)(void *task_data, void *state);
 
+/**
+ * The priority of a task submitted via `sentry__bgworker_submit_bounded`.
+ * Tasks of a higher priority are executed first, and tasks of a lower priority
+ * are dropped first when the queue is full.
+ */
+typedef enum {
+    SENTRY_TASK_PRIORITY_LOW,
+    SENTRY_TASK_PRIORITY_NORMAL,
+    SENTRY_TASK_PRIORITY_HIGH,
+} sentry_task_priority_t;
+
+#define SENTRY_TASK_PRIORITY_COUNT 3
+
 /**
  * Creates a new background worker thread.
  *
@@ -389,13 +643,16 @@ void *sentry__bgworker_get_state(sentry_bgworker_t *bgw);
 void sentry__bgworker_decref(sentry_bgworker_t *bgw);
 
 /**
- * Start a new background worker thread associated with `bgw`.
+ * Start the background worker thread associated with `bgw`.
  * Returns 0 on success.
  */
 int sentry__bgworker_start(sentry_bgworker_t *bgw);
 
 /**
  * This will try to flush the background worker thread queue, with a `timeout`.
+ * This waits for all the tasks submitted before, as well as for delayed tasks
+ * that are due before the timeout expires, and the tasks they submit. Periodic
+ * tasks are not waited for.
  * Returns 0 on success.
  */
 int sentry__bgworker_flush(sentry_bgworker_t *bgw, uint64_t timeout);
@@ -422,11 +679,88 @@ int sentry__bgworker_submit(sentry_bgworker_t *bgw,
     sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
     void *task_data);
 
+/**
+ * This will submit a new task to the background thread, which is queued once
+ * `delay_ms` milliseconds have passed. Delayed tasks that are not yet queued
+ * do not keep the worker from shutting down, and are dropped in that case.
+ *
+ * If `timer_id` is given, it receives an id that can be used to cancel the
+ * task via `sentry__bgworker_cancel_timer`.
+ *
+ * Takes ownership of `data`, freeing it using the provided `cleanup_func`.
+ * Returns 0 on success.
+ */
+int sentry__bgworker_submit_delayed(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, uint64_t delay_ms, uint64_t *timer_id);
+
+/**
+ * This will submit a new task to the background thread, which is queued every
+ * `interval_ms` milliseconds, starting `interval_ms` from now. The task is
+ * not queued again while it is still queued or executing, and skips the times
+ * it fell behind. Periodic tasks do not keep the worker from shutting down.
+ *
+ * If `timer_id` is given, it receives an id that can be used to cancel the
+ * task via `sentry__bgworker_cancel_timer`.
+ *
+ * Takes ownership of `data`, freeing it using the provided `cleanup_func`
+ * once the task is cancelled, or the worker is freed.
+ * Returns 0 on success.
+ */
+int sentry__bgworker_submit_periodic(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, uint64_t interval_ms, uint64_t *timer_id);
+
+/**
+ * Cancels the delayed or periodic task with the given `timer_id`. A delayed
+ * task can only be cancelled as long as it is not due, and a periodic task
+ * that is currently executing finishes. Returns true if it was cancelled.
+ */
+bool sentry__bgworker_cancel_timer(sentry_bgworker_t *bgw, uint64_t timer_id);
+
+/**
+ * Limits the number and accumulated size of the tasks that are submitted via
+ * `sentry__bgworker_submit_bounded`. A limit of `0` means unlimited.
+ *
+ * When a task does not fit, the oldest queued task of the lowest priority is
+ * dropped to make room for it, as long as its priority is not higher than
+ * that of the new task, otherwise the new task is dropped. Tasks for which
+ * `can_drop` returns false, and the task currently being executed are never
+ * dropped. `can_drop` is called while the queue is locked.
+ */
+void sentry__bgworker_set_queue_limits(sentry_bgworker_t *bgw,
+    size_t max_tasks, size_t max_bytes, bool (*can_drop)(void *task_data));
+
+/**
+ * This will submit a new task of the given `priority` and `size` in bytes to
+ * the background thread, which is queued after all the other tasks of the
+ * same or a higher priority, and is subject to the queue limits.
+ *
+ * Takes ownership of `data`, freeing it using the provided `cleanup_func`.
+ * Returns 0 on success, and 1 if the task was dropped.
+ */
+int sentry__bgworker_submit_bounded(sentry_bgworker_t *bgw,
+    sentry_task_exec_func_t exec_func, void (*cleanup_func)(void *task_data),
+    void *task_data, sentry_task_priority_t priority, size_t size);
+
+/**
+ * Returns the number of tasks of the given `priority` that were dropped
+ * because the queue was full.
+ */
+size_t sentry__bgworker_get_dropped(
+    sentry_bgworker_t *bgw, sentry_task_priority_t priority);
+
+/**
+ * Returns the number of bounded tasks that are currently queued, including
+ * the one that is being executed. This does not lock the queue.
+ */
+size_t sentry__bgworker_get_queue_depth(sentry_bgworker_t *bgw);
+
 /**
  * This function will iterate through all the current tasks of the worker
- * thread, and will call the `callback` function for each task with a matching
- * `exec_func`. The callback can return `true` to indicate if the current task
- * should be dropped from the queue.
+ * thread, including delayed ones, and will call the `callback` function for
+ * each task with a matching `exec_func`. The callback can return `true` to
+ * indicate if the current task should be dropped from the queue.
  * The function will return the number of dropped tasks.
  */
 size_t sentry__bgworker_foreach_matching(sentry_bgworker_t *bgw,
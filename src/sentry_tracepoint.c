@@ -0,0 +1,67 @@
+#include "sentry_tracepoint.h"
+#include "sentry_sync.h"
+
+#if defined(SENTRY_WITH_TRACEPOINTS) && defined(SENTRY_PLATFORM_WINDOWS)
+// {5f9a7c1e-3b2d-4e8a-9c61-0d4b7e2a8f13}
+TRACELOGGING_DEFINE_PROVIDER(g_sentry_trace_provider, "Sentry.Native",
+    (0x5f9a7c1e, 0x3b2d, 0x4e8a, 0x9c, 0x61, 0x0d, 0x4b, 0x7e, 0x2a, 0x8f,
+        0x13));
+
+static long g_registered = 0;
+
+void
+sentry__tracepoints_register(void)
+{
+    if (sentry__atomic_store(&g_registered, 1) == 0) {
+        TraceLoggingRegister(g_sentry_trace_provider);
+    }
+}
+
+void
+sentry__tracepoints_unregister(void)
+{
+    if (sentry__atomic_store(&g_registered, 0) == 1) {
+        TraceLoggingUnregister(g_sentry_trace_provider);
+    }
+}
+
+#elif defined(SENTRY_WITH_TRACEPOINTS) && defined(SENTRY_PLATFORM_DARWIN)
+static void *volatile g_log = NULL;
+
+os_log_t
+sentry__tracepoint_log(void)
+{
+    os_log_t log = sentry__atomic_fetch_ptr(&g_log);
+    return log ? log : OS_LOG_DISABLED;
+}
+
+void
+sentry__tracepoints_register(void)
+{
+    // the handle is never released, so that it stays valid for tracepoints
+    // on other threads, like those of a transport that is still shutting down
+    if (!sentry__atomic_fetch_ptr(&g_log)) {
+        os_log_t log = os_log_create(
+            "io.sentry.native", OS_LOG_CATEGORY_POINTS_OF_INTEREST);
+        if (!sentry__atomic_compare_swap_ptr(&g_log, NULL, log)) {
+            os_release(log);
+        }
+    }
+}
+
+void
+sentry__tracepoints_unregister(void)
+{
+}
+
+#else
+void
+sentry__tracepoints_register(void)
+{
+}
+
+void
+sentry__tracepoints_unregister(void)
+{
+}
+#endif
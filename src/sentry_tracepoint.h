@@ -0,0 +1,96 @@
+#ifndef SENTRY_TRACEPOINT_H_INCLUDED
+#define SENTRY_TRACEPOINT_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Static tracepoints on the hot paths of the SDK, which are compiled in with
+ * the `SENTRY_TRACEPOINTS` CMake option.
+ *
+ * They map to USDT probes of the `sentry` provider on Linux, to TraceLogging
+ * events of the `Sentry.Native` ETW provider on Windows and to signpost events
+ * of the `io.sentry.native` subsystem on macOS. Each of them is only a `nop`,
+ * or a check whether the provider is enabled, until a tracer attaches.
+ *
+ * Tracepoints come in `start` and `end` pairs, and take at most two integer
+ * arguments:
+ *
+ * - `capture__start`, `capture__end`
+ * - `prepare__start`, `prepare__end`
+ * - `serialize__start`, `serialize__end(payload_len)`
+ * - `transport__send__start(body_len)`, `transport__send__end(status_code)`
+ * - `bgworker__task__start`, `bgworker__task__end`
+ * - `scope__lock__wait(exclusive)`, `scope__lock__acquire(exclusive)`
+ * - `crash__start`, `crash__event`, `crash__end`
+ *
+ * The crash tracepoints are fired from within the crash handler, so they use
+ * `SENTRY_CRASH_TRACEPOINT`, which is not available as a signpost.
+ */
+
+#if defined(SENTRY_WITH_TRACEPOINTS) && defined(SENTRY_PLATFORM_LINUX)
+#    include <sys/sdt.h>
+
+#    define SENTRY_TRACEPOINT(Name) DTRACE_PROBE(sentry, Name)
+#    define SENTRY_TRACEPOINT1(Name, Arg)                                      \
+        DTRACE_PROBE1(sentry, Name, (uint64_t)(Arg))
+#    define SENTRY_TRACEPOINT2(Name, Arg1, Arg2)                               \
+        DTRACE_PROBE2(sentry, Name, (uint64_t)(Arg1), (uint64_t)(Arg2))
+#    define SENTRY_CRASH_TRACEPOINT(Name) SENTRY_TRACEPOINT(Name)
+
+#elif defined(SENTRY_WITH_TRACEPOINTS) && defined(SENTRY_PLATFORM_WINDOWS)
+#    include <TraceLoggingProvider.h>
+
+TRACELOGGING_DECLARE_PROVIDER(g_sentry_trace_provider);
+
+#    define SENTRY_TRACEPOINT(Name)                                            \
+        TraceLoggingWrite(g_sentry_trace_provider, #Name)
+#    define SENTRY_TRACEPOINT1(Name, Arg)                                      \
+        TraceLoggingWrite(g_sentry_trace_provider, #Name,                      \
+            TraceLoggingUInt64((uint64_t)(Arg), "arg0"))
+#    define SENTRY_TRACEPOINT2(Name, Arg1, Arg2)                               \
+        TraceLoggingWrite(g_sentry_trace_provider, #Name,                      \
+            TraceLoggingUInt64((uint64_t)(Arg1), "arg0"),                      \
+            TraceLoggingUInt64((uint64_t)(Arg2), "arg1"))
+#    define SENTRY_CRASH_TRACEPOINT(Name) SENTRY_TRACEPOINT(Name)
+
+#elif defined(SENTRY_WITH_TRACEPOINTS) && defined(SENTRY_PLATFORM_DARWIN)
+#    include <os/signpost.h>
+
+/**
+ * Returns the log handle that the signposts are emitted to.
+ */
+os_log_t sentry__tracepoint_log(void);
+
+#    define SENTRY_TRACEPOINT(Name)                                            \
+        os_signpost_event_emit(                                                \
+            sentry__tracepoint_log(), OS_SIGNPOST_ID_EXCLUSIVE, #Name)
+#    define SENTRY_TRACEPOINT1(Name, Arg)                                      \
+        os_signpost_event_emit(sentry__tracepoint_log(),                       \
+            OS_SIGNPOST_ID_EXCLUSIVE, #Name, "%llu",                           \
+            (unsigned long long)(Arg))
+#    define SENTRY_TRACEPOINT2(Name, Arg1, Arg2)                               \
+        os_signpost_event_emit(sentry__tracepoint_log(),                       \
+            OS_SIGNPOST_ID_EXCLUSIVE, #Name, "%llu %llu",                      \
+            (unsigned long long)(Arg1), (unsigned long long)(Arg2))
+// `os_log` is not safe to use from a signal handler
+#    define SENTRY_CRASH_TRACEPOINT(Name) ((void)0)
+
+#else
+#    define SENTRY_TRACEPOINT(Name) ((void)0)
+#    define SENTRY_TRACEPOINT1(Name, Arg) ((void)0)
+#    define SENTRY_TRACEPOINT2(Name, Arg1, Arg2) ((void)0)
+#    define SENTRY_CRASH_TRACEPOINT(Name) ((void)0)
+#endif
+
+/**
+ * Registers the tracepoint provider, if the platform needs one. This is called
+ * from `sentry_init` and is a no-op when the provider is already registered.
+ */
+void sentry__tracepoints_register(void);
+
+/**
+ * Unregisters the tracepoint provider again, from `sentry_close`.
+ */
+void sentry__tracepoints_unregister(void);
+
+#endif
@@ -1,61 +1,90 @@
 #include "sentry_tracing.h"
 #include "sentry_alloc.h"
+#include "sentry_core.h"
 #include "sentry_logger.h"
+#include "sentry_profiler.h"
+#include "sentry_stats.h"
 #include "sentry_string.h"
 #include "sentry_utils.h"
+#include "sentry_uuid.h"
 #include "sentry_value.h"
 #include <string.h>
 
-sentry_value_t
-sentry__value_new_span(sentry_value_t parent, const char *operation)
+static sentry_value_t
+new_string_n(const char *value, size_t value_len)
 {
-    sentry_value_t span = sentry_value_new_object();
+    return value ? sentry_value_new_string_n(value, value_len)
+                 : sentry_value_new_null();
+}
 
-    sentry_value_set_by_key(span, "op", sentry_value_new_string(operation));
+static size_t
+string_len(const char *value)
+{
+    return value ? strlen(value) : 0;
+}
 
+sentry_value_t
+sentry__value_new_span(
+    sentry_value_t parent, const char *operation, size_t operation_len)
+{
     sentry_uuid_t span_id = sentry_uuid_new_v4();
-    sentry_value_set_by_key(
-        span, "span_id", sentry__value_new_span_uuid(&span_id));
-
-    sentry_value_set_by_key(span, "status", sentry_value_new_string("ok"));
 
-    if (!sentry_value_is_null(parent)) {
-        sentry_value_set_by_key(span, "trace_id",
-            sentry_value_get_by_key_owned(parent, "trace_id"));
-        sentry_value_set_by_key(span, "parent_span_id",
-            sentry_value_get_by_key_owned(parent, "span_id"));
-        sentry_value_set_by_key(
-            span, "sampled", sentry_value_get_by_key_owned(parent, "sampled"));
-    }
-
-    return span;
+    // Without a parent, the inherited pairs are skipped, but their space is
+    // still reserved, which leaves room for the `trace_id` and `transaction`
+    // of a transaction context.
+    bool has_parent = !sentry_value_is_null(parent);
+    sentry_value_pair_t pairs[] = {
+        { SENTRY_KEY(op), new_string_n(operation, operation_len) },
+        { SENTRY_KEY(span_id), sentry__value_new_span_uuid(&span_id) },
+        { SENTRY_KEY(status), sentry_value_new_string("ok") },
+        { has_parent ? SENTRY_KEY(trace_id) : NULL,
+            sentry_value_get_by_key_owned(parent, SENTRY_KEY(trace_id)) },
+        { has_parent ? SENTRY_KEY(parent_span_id) : NULL,
+            sentry_value_get_by_key_owned(parent, SENTRY_KEY(span_id)) },
+        { has_parent ? SENTRY_KEY(sampled) : NULL,
+            sentry_value_get_by_key_owned(parent, SENTRY_KEY(sampled)) },
+    };
+    return sentry_value_new_object_from_pairs(
+        pairs, sizeof(pairs) / sizeof(pairs[0]));
 }
 
 sentry_value_t
-sentry__value_transaction_context_new(const char *name, const char *operation)
+sentry__value_transaction_context_new(const char *name, size_t name_len,
+    const char *operation, size_t operation_len)
 {
-    sentry_value_t transaction_context
-        = sentry__value_new_span(sentry_value_new_null(), operation);
+    sentry_value_t transaction_context = sentry__value_new_span(
+        sentry_value_new_null(), operation, operation_len);
 
     sentry_uuid_t trace_id = sentry_uuid_new_v4();
-    sentry_value_set_by_key(transaction_context, "trace_id",
+    sentry_value_set_by_key(transaction_context, SENTRY_KEY(trace_id),
         sentry__value_new_internal_uuid(&trace_id));
 
-    sentry_value_set_by_key(
-        transaction_context, "transaction", sentry_value_new_string(name));
+    sentry_value_set_by_key(transaction_context, SENTRY_KEY(transaction),
+        new_string_n(name, name_len));
 
     return transaction_context;
 }
 
 sentry_transaction_context_t *
 sentry_transaction_context_new(const char *name, const char *operation)
+{
+    return sentry_transaction_context_new_n(
+        name, string_len(name), operation, string_len(operation));
+}
+
+sentry_transaction_context_t *
+sentry_transaction_context_new_n(const char *name, size_t name_len,
+    const char *operation, size_t operation_len)
 {
     sentry_transaction_context_t *tx_cxt
         = SENTRY_MAKE(sentry_transaction_context_t);
     if (!tx_cxt) {
         return NULL;
     }
-    tx_cxt->inner = sentry__value_transaction_context_new(name, operation);
+    tx_cxt->inner = sentry__value_transaction_context_new(
+        name, name_len, operation, operation_len);
+    tx_cxt->trace_id = sentry_uuid_nil();
+    tx_cxt->parent_span_id = sentry_uuid_nil();
 
     if (sentry_value_is_null(tx_cxt->inner)) {
         sentry_free(tx_cxt);
@@ -133,37 +162,85 @@ sentry_transaction_context_update_from_header(
         }
     }
 
-    // https://develop.sentry.dev/sdk/performance/#header-sentry-trace
-    // sentry-trace = traceid-spanid(-sampled)?
-    const char *trace_id_start = value;
-    const char *trace_id_end = strchr(trace_id_start, '-');
-    if (!trace_id_end) {
+    sentry_trace_header_t header;
+    if (!sentry__trace_header_parse(&header, value)) {
         return;
     }
+    tx_cxt->trace_id = header.trace_id;
+    tx_cxt->parent_span_id = header.span_id;
+    if (header.sampled >= 0) {
+        sentry_value_set_by_key(tx_cxt->inner, SENTRY_KEY(sampled),
+            sentry_value_new_bool(header.sampled));
+    }
+}
 
-    sentry_value_t inner = tx_cxt->inner;
-
-    char *s
-        = sentry__string_clonen(trace_id_start, trace_id_end - trace_id_start);
-    sentry_value_t trace_id = sentry__value_new_string_owned(s);
-    sentry_value_set_by_key(inner, "trace_id", trace_id);
-
-    const char *span_id_start = trace_id_end + 1;
-    const char *span_id_end = strchr(span_id_start, '-');
-    if (!span_id_end) {
-        // no sampled flag
-        sentry_value_t parent_span_id = sentry_value_new_string(span_id_start);
-        sentry_value_set_by_key(inner, "parent_span_id", parent_span_id);
+void
+sentry__transaction_context_apply_trace_header(
+    sentry_transaction_context_t *tx_cxt)
+{
+    if (sentry_uuid_is_nil(&tx_cxt->trace_id)) {
         return;
     }
-    // else: we have a sampled flag
+    sentry_value_set_by_key(tx_cxt->inner, SENTRY_KEY(trace_id),
+        sentry__value_new_internal_uuid(&tx_cxt->trace_id));
+    sentry_value_set_by_key(tx_cxt->inner, SENTRY_KEY(parent_span_id),
+        sentry__value_new_span_uuid(&tx_cxt->parent_span_id));
+    tx_cxt->trace_id = sentry_uuid_nil();
+    tx_cxt->parent_span_id = sentry_uuid_nil();
+}
+
+bool
+sentry__trace_header_parse(sentry_trace_header_t *header, const char *value)
+{
+    // sentry-trace = traceid-spanid(-sampled)?
+    // the hex parsing stops at a null byte, so a short `value` is never read
+    // past its end
+    if (!value || !sentry__uuid_from_hex(&header->trace_id, value, 16)
+        || value[32] != '-'
+        || !sentry__uuid_from_hex(&header->span_id, value + 33, 8)) {
+        return false;
+    }
+    const char *rest = value + 33 + 16;
+    if (rest[0] == '\0') {
+        header->sampled = -1;
+    } else if (rest[0] == '-') {
+        header->sampled = rest[1] == '1';
+    } else {
+        return false;
+    }
+    return true;
+}
 
-    s = sentry__string_clonen(span_id_start, span_id_end - span_id_start);
-    sentry_value_t parent_span_id = sentry__value_new_string_owned(s);
-    sentry_value_set_by_key(inner, "parent_span_id", parent_span_id);
+size_t
+sentry__trace_header_format(char buf[SENTRY_TRACE_HEADER_SIZE],
+    const sentry_uuid_t *trace_id, const sentry_uuid_t *span_id, bool sampled)
+{
+    sentry__uuid_to_hex(trace_id, 16, buf);
+    buf[32] = '-';
+    sentry__uuid_to_hex(span_id, 8, buf + 33);
+    buf[49] = '-';
+    buf[50] = sampled ? '1' : '0';
+    buf[51] = '\0';
+    return 51;
+}
 
-    bool sampled = *(span_id_end + 1) == '1';
-    sentry_value_set_by_key(inner, "sampled", sentry_value_new_bool(sampled));
+/**
+ * Parses the hex id in the String Value `id` of `byte_count` bytes, or returns
+ * a nil id if it is not one. The raw bytes of a UUID Value are used as is.
+ */
+static sentry_uuid_t
+id_from_value(sentry_value_t id, size_t byte_count)
+{
+    sentry_uuid_t rv;
+    if (sentry__value_get_uuid(id, &rv)) {
+        return rv;
+    }
+    const char *str = sentry_value_as_string(id);
+    if (strlen(str) != byte_count * 2
+        || !sentry__uuid_from_hex(&rv, str, byte_count)) {
+        return sentry_uuid_nil();
+    }
+    return rv;
 }
 
 sentry_transaction_t *
@@ -179,6 +256,20 @@ sentry__transaction_new(sentry_value_t inner)
     }
 
     tx->inner = inner;
+    tx->max_spans = SENTRY_SPANS_MAX;
+    tx->stream_spans = false;
+    tx->max_span_bytes = 0;
+    tx->span_bytes = 0;
+    tx->start_timestamp_us = sentry__usec_time();
+    tx->start_ns = sentry__monotonic_time_ns();
+    tx->trace_id = id_from_value(
+        sentry_value_get_by_key(inner, SENTRY_KEY(trace_id)), 16);
+    tx->span_id
+        = id_from_value(sentry_value_get_by_key(inner, SENTRY_KEY(span_id)), 8);
+    tx->spans = NULL;
+    tx->span_count = 0;
+    tx->span_capacity = 0;
+    tx->profile = NULL;
 
     return tx;
 }
@@ -200,6 +291,11 @@ sentry__transaction_decref(sentry_transaction_t *tx)
 
     if (sentry_value_refcount(tx->inner) <= 1) {
         sentry_value_decref(tx->inner);
+        for (size_t i = 0; i < tx->span_count; i++) {
+            sentry_value_decref(tx->spans[i].inner);
+        }
+        sentry_free(tx->spans);
+        sentry__profile_discard(tx->profile);
         sentry_free(tx);
     } else {
         sentry_value_decref(tx->inner);
@@ -243,6 +339,11 @@ sentry__span_new(sentry_transaction_t *tx, sentry_value_t inner)
     }
 
     span->inner = inner;
+    span->start_ns = sentry__monotonic_time_ns();
+    span->finished = false;
+    span->noop = false;
+    span->span_id
+        = id_from_value(sentry_value_get_by_key(inner, SENTRY_KEY(span_id)), 8);
 
     sentry__transaction_incref(tx);
     span->transaction = tx;
@@ -250,37 +351,189 @@ sentry__span_new(sentry_transaction_t *tx, sentry_value_t inner)
     return span;
 }
 
+sentry_span_t *
+sentry__span_new_noop(sentry_transaction_t *tx)
+{
+    // the empty object still carries the refcount of the span
+    sentry_span_t *span = sentry__span_new(tx, sentry_value_new_object());
+    if (span) {
+        span->start_ns = 0;
+        span->noop = true;
+    }
+    return span;
+}
+
 sentry_value_t
-sentry__value_span_new(
-    size_t max_spans, sentry_value_t parent, char *operation, char *description)
+sentry__span_get_trace_value(const sentry_span_t *span)
 {
-    if (!sentry_value_is_null(sentry_value_get_by_key(parent, "timestamp"))) {
+    return span->noop ? span->transaction->inner : span->inner;
+}
+
+sentry_value_t
+sentry__value_span_new(const sentry_transaction_t *tx, sentry_value_t parent,
+    const char *operation, size_t operation_len, const char *description,
+    size_t description_len)
+{
+    if (!sentry_value_is_null(
+            sentry_value_get_by_key(parent, SENTRY_KEY(timestamp)))) {
         SENTRY_DEBUG("span's parent is already finished, not creating span");
         goto fail;
     }
 
-    sentry_value_t spans = sentry_value_get_by_key(parent, "spans");
     // This only checks that the number of _completed_ spans matches the
     // number of max spans. This means that the number of in-flight spans
     // can exceed the max number of spans.
-    if (sentry_value_get_length(spans) >= max_spans) {
+    if (tx->span_count >= tx->max_spans) {
         SENTRY_DEBUG("reached maximum number of spans for transaction, not "
                      "creating span");
+        sentry__stats_add(SENTRY_STAT_SPANS_DROPPED, 1);
         goto fail;
     }
 
-    sentry_value_t child = sentry__value_new_span(parent, operation);
-    sentry_value_set_by_key(
-        child, "description", sentry_value_new_string(description));
-    sentry_value_set_by_key(child, "start_timestamp",
-        sentry__value_new_string_owned(
-            sentry__msec_time_to_iso8601(sentry__msec_time())));
+    sentry_value_t child
+        = sentry__value_new_span(parent, operation, operation_len);
+    sentry_value_set_by_key(child, SENTRY_KEY(description),
+        new_string_n(description, description_len));
 
     return child;
 fail:
     return sentry_value_new_null();
 }
 
+bool
+sentry__transaction_add_finished_span(
+    sentry_transaction_t *tx, sentry_span_t *span)
+{
+    if (tx->span_count >= tx->max_spans) {
+        SENTRY_DEBUG("reached maximum number of spans for transaction, "
+                     "discarding span");
+        sentry__stats_add(SENTRY_STAT_SPANS_DROPPED, 1);
+        sentry__span_decref(span);
+        return false;
+    }
+    if (tx->span_count == tx->span_capacity) {
+        size_t capacity = tx->span_capacity ? tx->span_capacity * 2 : 16;
+        sentry_span_record_t *spans
+            = sentry_malloc(sizeof(sentry_span_record_t) * capacity);
+        if (!spans) {
+            sentry__span_decref(span);
+            return false;
+        }
+        if (tx->span_count) {
+            memcpy(spans, tx->spans,
+                sizeof(sentry_span_record_t) * tx->span_count);
+        }
+        sentry_free(tx->spans);
+        tx->spans = spans;
+        tx->span_capacity = capacity;
+    }
+
+    sentry_span_record_t *record = &tx->spans[tx->span_count++];
+    record->start_ns = span->start_ns;
+    record->end_ns = sentry__monotonic_time_ns();
+    if (sentry_value_refcount(span->inner) <= 1) {
+        // this was the last reference to the span, so its value is moved
+        // into the record as it is
+        record->inner = span->inner;
+        sentry__transaction_decref(span->transaction);
+        sentry_free(span);
+    } else {
+        // the span can still be modified through the other references, so
+        // the record gets a snapshot of it
+        record->inner = sentry__value_clone(span->inner);
+        span->finished = true;
+        sentry__span_decref(span);
+    }
+    if (tx->max_span_bytes) {
+        tx->span_bytes += sentry__value_get_memory_usage(record->inner);
+    }
+    return true;
+}
+
+bool
+sentry__transaction_should_flush_spans(const sentry_transaction_t *tx)
+{
+    return tx->stream_spans
+        && (tx->span_count >= tx->max_spans
+            || (tx->max_span_bytes && tx->span_bytes >= tx->max_span_bytes));
+}
+
+sentry_value_t
+sentry__transaction_timestamp_to_value(
+    const sentry_transaction_t *tx, uint64_t time_ns)
+{
+    // the monotonic clock never goes backwards, but play it safe
+    uint64_t offset_us
+        = time_ns > tx->start_ns ? (time_ns - tx->start_ns) / 1000 : 0;
+    return sentry__value_new_string_owned(
+        sentry__usec_time_to_iso8601(tx->start_timestamp_us + offset_us));
+}
+
+static sentry_value_t
+record_to_value(
+    const sentry_transaction_t *tx, const sentry_span_record_t *record)
+{
+    sentry_value_t span = record->inner;
+    sentry_value_remove_by_key(span, SENTRY_KEY(sampled));
+    sentry_value_set_by_key(span, SENTRY_KEY(start_timestamp),
+        sentry__transaction_timestamp_to_value(tx, record->start_ns));
+    sentry_value_set_by_key(span, SENTRY_KEY(timestamp),
+        sentry__transaction_timestamp_to_value(tx, record->end_ns));
+    return span;
+}
+
+sentry_value_t
+sentry__transaction_spans_to_value(const sentry_transaction_t *tx)
+{
+    if (!tx->span_count) {
+        return sentry_value_new_null();
+    }
+    sentry_value_t spans = sentry__value_new_list_with_size(tx->span_count);
+    for (size_t i = 0; i < tx->span_count; i++) {
+        sentry_value_t span = record_to_value(tx, &tx->spans[i]);
+        sentry_value_incref(span);
+        sentry_value_append(spans, span);
+    }
+    return spans;
+}
+
+sentry_value_t
+sentry__transaction_take_spans(
+    sentry_transaction_t *tx, uint64_t *start_ns_out)
+{
+    *start_ns_out = tx->start_ns;
+    if (!tx->span_count) {
+        return sentry_value_new_null();
+    }
+    sentry_value_t spans = sentry__value_new_list_with_size(tx->span_count);
+    uint64_t start_ns = UINT64_MAX;
+    for (size_t i = 0; i < tx->span_count; i++) {
+        const sentry_span_record_t *record = &tx->spans[i];
+        if (record->start_ns < start_ns) {
+            start_ns = record->start_ns;
+        }
+        // the list takes over the reference of the record
+        sentry_value_append(spans, record_to_value(tx, record));
+    }
+    *start_ns_out = start_ns;
+    // the records are reused for the next chunk
+    tx->span_count = 0;
+    tx->span_bytes = 0;
+    return spans;
+}
+
+size_t
+sentry__transaction_get_memory_usage(const sentry_transaction_t *tx)
+{
+    size_t size = sizeof(sentry_transaction_t)
+        + sentry__value_get_memory_usage(tx->inner)
+        + sizeof(sentry_span_record_t) * tx->span_capacity;
+    for (size_t i = 0; i < tx->span_count; i++) {
+        size += sentry__value_get_memory_usage(tx->spans[i].inner);
+    }
+    return size;
+}
+
 sentry_value_t
 sentry__value_get_trace_context(sentry_value_t span)
 {
@@ -288,8 +541,10 @@ sentry__value_get_trace_context(sentry_value_t span)
         return sentry_value_new_null();
     }
 
-    if (sentry_value_is_null(sentry_value_get_by_key(span, "trace_id"))
-        || sentry_value_is_null(sentry_value_get_by_key(span, "span_id"))) {
+    if (sentry_value_is_null(
+            sentry_value_get_by_key(span, SENTRY_KEY(trace_id)))
+        || sentry_value_is_null(
+            sentry_value_get_by_key(span, SENTRY_KEY(span_id)))) {
         return sentry_value_new_null();
     }
 
@@ -327,43 +582,56 @@ sentry_transaction_set_name(sentry_transaction_t *tx, const char *name)
 }
 
 static void
-set_tag(sentry_value_t item, const char *tag, const char *value)
+set_tag(sentry_value_t item, const char *tag, size_t tag_len,
+    const char *value, size_t value_len)
 {
-    sentry_value_t tags = sentry_value_get_by_key(item, "tags");
+    sentry_value_t tags = sentry_value_get_by_key(item, SENTRY_KEY(tags));
     if (sentry_value_is_null(tags)) {
         tags = sentry_value_new_object();
-        sentry_value_set_by_key(item, "tags", tags);
+        sentry_value_set_by_key(item, SENTRY_KEY(tags), tags);
     }
 
-    char *s = sentry__string_clonen(value, 200);
-    if (s) {
-        sentry_value_set_by_key(tags, tag, sentry__value_new_string_owned(s));
-    } else {
-        sentry_value_set_by_key(tags, tag, sentry_value_new_null());
-    }
+    sentry_value_set_by_key_n(tags, tag, tag_len,
+        new_string_n(value, value_len < 200 ? value_len : 200));
 }
 
 void
 sentry_transaction_set_tag(
     sentry_transaction_t *tx, const char *tag, const char *value)
+{
+    sentry_transaction_set_tag_n(
+        tx, tag, string_len(tag), value, string_len(value));
+}
+
+void
+sentry_transaction_set_tag_n(sentry_transaction_t *tx, const char *tag,
+    size_t tag_len, const char *value, size_t value_len)
 {
     if (tx) {
-        set_tag(tx->inner, tag, value);
+        set_tag(tx->inner, tag, tag_len, value, value_len);
     }
 }
 
 void
 sentry_span_set_tag(sentry_span_t *span, const char *tag, const char *value)
 {
-    if (span) {
-        set_tag(span->inner, tag, value);
+    sentry_span_set_tag_n(
+        span, tag, string_len(tag), value, string_len(value));
+}
+
+void
+sentry_span_set_tag_n(sentry_span_t *span, const char *tag, size_t tag_len,
+    const char *value, size_t value_len)
+{
+    if (span && !span->noop) {
+        set_tag(span->inner, tag, tag_len, value, value_len);
     }
 }
 
 static void
 remove_tag(sentry_value_t item, const char *tag)
 {
-    sentry_value_t tags = sentry_value_get_by_key(item, "tags");
+    sentry_value_t tags = sentry_value_get_by_key(item, SENTRY_KEY(tags));
     if (!sentry_value_is_null(tags)) {
         sentry_value_remove_by_key(tags, tag);
     }
@@ -380,43 +648,60 @@ sentry_transaction_remove_tag(sentry_transaction_t *tx, const char *tag)
 void
 sentry_span_remove_tag(sentry_span_t *span, const char *tag)
 {
-    if (span) {
+    if (span && !span->noop) {
         remove_tag(span->inner, tag);
     }
 }
 
 static void
-set_data(sentry_value_t item, const char *key, sentry_value_t value)
+set_data(
+    sentry_value_t item, const char *key, size_t key_len, sentry_value_t value)
 {
-    sentry_value_t data = sentry_value_get_by_key(item, "data");
+    sentry_value_t data = sentry_value_get_by_key(item, SENTRY_KEY(data));
     if (sentry_value_is_null(data)) {
         data = sentry_value_new_object();
-        sentry_value_set_by_key(item, "data", data);
+        sentry_value_set_by_key(item, SENTRY_KEY(data), data);
     }
-    sentry_value_set_by_key(data, key, value);
+    sentry_value_set_by_key_n(data, key, key_len, value);
 }
 
 void
 sentry_transaction_set_data(
     sentry_transaction_t *tx, const char *key, sentry_value_t value)
+{
+    sentry_transaction_set_data_n(tx, key, string_len(key), value);
+}
+
+void
+sentry_transaction_set_data_n(sentry_transaction_t *tx, const char *key,
+    size_t key_len, sentry_value_t value)
 {
     if (tx) {
-        set_data(tx->inner, key, value);
+        set_data(tx->inner, key, key_len, value);
     }
 }
 
 void
 sentry_span_set_data(sentry_span_t *span, const char *key, sentry_value_t value)
 {
-    if (span) {
-        set_data(span->inner, key, value);
+    sentry_span_set_data_n(span, key, string_len(key), value);
+}
+
+void
+sentry_span_set_data_n(sentry_span_t *span, const char *key, size_t key_len,
+    sentry_value_t value)
+{
+    if (span && !span->noop) {
+        set_data(span->inner, key, key_len, value);
+    } else {
+        sentry_value_decref(value);
     }
 }
 
 static void
 remove_data(sentry_value_t item, const char *key)
 {
-    sentry_value_t data = sentry_value_get_by_key(item, "data");
+    sentry_value_t data = sentry_value_get_by_key(item, SENTRY_KEY(data));
     if (!sentry_value_is_null(data)) {
         sentry_value_remove_by_key(data, key);
     }
@@ -433,7 +718,7 @@ sentry_transaction_remove_data(sentry_transaction_t *tx, const char *key)
 void
 sentry_span_remove_data(sentry_span_t *span, const char *key)
 {
-    if (span) {
+    if (span && !span->noop) {
         remove_data(span->inner, key);
     }
 }
@@ -484,13 +769,14 @@ sentry_status_to_string(sentry_span_status_t status)
 void
 set_status(sentry_value_t item, sentry_span_status_t status)
 {
-    sentry_value_set_by_key(item, "status", sentry_status_to_string(status));
+    sentry_value_set_by_key(
+        item, SENTRY_KEY(status), sentry_status_to_string(status));
 }
 
 void
 sentry_span_set_status(sentry_span_t *span, sentry_span_status_t status)
 {
-    if (span) {
+    if (span && !span->noop) {
         set_status(span->inner, status);
     }
 }
@@ -505,22 +791,18 @@ sentry_transaction_set_status(
 }
 
 static void
-sentry__span_iter_headers(sentry_value_t span,
+iter_headers(const sentry_transaction_t *tx, const sentry_uuid_t *span_id,
     sentry_iter_headers_function_t callback, void *userdata)
 {
-    sentry_value_t trace_id = sentry_value_get_by_key(span, "trace_id");
-    sentry_value_t span_id = sentry_value_get_by_key(span, "span_id");
-    sentry_value_t sampled = sentry_value_get_by_key(span, "sampled");
-
-    if (sentry_value_is_null(trace_id) || sentry_value_is_null(span_id)) {
+    if (sentry_uuid_is_nil(&tx->trace_id) || sentry_uuid_is_nil(span_id)) {
         return;
     }
+    // spans can not have a sampling decision of their own
+    bool sampled = sentry_value_is_true(
+        sentry_value_get_by_key(tx->inner, SENTRY_KEY(sampled)));
 
-    char buf[64];
-    snprintf(buf, sizeof(buf), "%s-%s-%s", sentry_value_as_string(trace_id),
-        sentry_value_as_string(span_id),
-        sentry_value_is_true(sampled) ? "1" : "0");
-
+    char buf[SENTRY_TRACE_HEADER_SIZE];
+    sentry__trace_header_format(buf, &tx->trace_id, span_id, sampled);
     callback("sentry-trace", buf, userdata);
 }
 
@@ -529,7 +811,9 @@ sentry_span_iter_headers(sentry_span_t *span,
     sentry_iter_headers_function_t callback, void *userdata)
 {
     if (span) {
-        sentry__span_iter_headers(span->inner, callback, userdata);
+        const sentry_transaction_t *tx = span->transaction;
+        iter_headers(tx, span->noop ? &tx->span_id : &span->span_id, callback,
+            userdata);
     }
 }
 
@@ -538,6 +822,6 @@ sentry_transaction_iter_headers(sentry_transaction_t *tx,
     sentry_iter_headers_function_t callback, void *userdata)
 {
     if (tx) {
-        sentry__span_iter_headers(tx->inner, callback, userdata);
+        iter_headers(tx, &tx->span_id, callback, userdata);
     }
 }
@@ -10,13 +10,38 @@ typedef struct sentry_span_s {
     sentry_value_t inner;
     // The transaction the span is contained in.
     sentry_transaction_t *transaction;
+    // The `sentry__monotonic_time_ns` at which the span was started.
+    uint64_t start_ns;
+    // Whether the span was finished while somebody else still referenced it.
+    bool finished;
+    // Whether this is a placeholder for a span that is never sent, because
+    // its transaction is unsampled. Its `inner` is an empty object.
+    bool noop;
+    // The `span_id` of `inner`, which is nil for no-op spans.
+    sentry_uuid_t span_id;
 } sentry_span_t;
 
+/**
+ * A finished span. The timestamps are only formatted, and the span is only
+ * added to the `spans` of its transaction, once the transaction is finished.
+ * Both are `sentry__monotonic_time_ns` times.
+ */
+typedef struct {
+    sentry_value_t inner;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} sentry_span_record_t;
+
 /**
  * A transaction context.
  */
 typedef struct sentry_transaction_context_s {
     sentry_value_t inner;
+    // The ids of the last valid `sentry-trace` header, which are only turned
+    // into the `trace_id` and `parent_span_id` of `inner` once the
+    // transaction is started. These are nil without a header.
+    sentry_uuid_t trace_id;
+    sentry_uuid_t parent_span_id;
 } sentry_transaction_context_t;
 
 /**
@@ -24,8 +49,67 @@ typedef struct sentry_transaction_context_s {
  */
 typedef struct sentry_transaction_s {
     sentry_value_t inner;
+    // The `max_spans` option at the time the transaction was started, or the
+    // `span_chunk_size` option if spans are streamed.
+    size_t max_spans;
+    // Whether the finished spans are sent in chunks once there are
+    // `max_spans` of them, or they take up `max_span_bytes`, instead of being
+    // dropped. `span_bytes` is only counted if `max_span_bytes` is set.
+    bool stream_spans;
+    size_t max_span_bytes;
+    size_t span_bytes;
+    // The wall clock and monotonic times at which the transaction was started.
+    // All the timestamps of the transaction are relative to these, so that
+    // they have sub-millisecond precision, and are not skewed by changes of
+    // the wall clock.
+    uint64_t start_timestamp_us;
+    uint64_t start_ns;
+    // The `trace_id` and `span_id` of `inner`, which are nil if it has none.
+    sentry_uuid_t trace_id;
+    sentry_uuid_t span_id;
+    sentry_span_record_t *spans;
+    size_t span_count;
+    size_t span_capacity;
+    // The profile of the thread that started the transaction, if it is
+    // profiled.
+    struct sentry_profile_s *profile;
 } sentry_transaction_t;
 
+/**
+ * The ids and sampling decision of a `sentry-trace` header.
+ * See https://develop.sentry.dev/sdk/performance/#header-sentry-trace
+ */
+typedef struct {
+    sentry_uuid_t trace_id;
+    // only the first 8 bytes are used
+    sentry_uuid_t span_id;
+    // -1 if the header has no sampling decision
+    int sampled;
+} sentry_trace_header_t;
+
+// the size of a formatted `traceid-spanid-sampled`, including its null byte
+#define SENTRY_TRACE_HEADER_SIZE (32 + 1 + 16 + 2 + 1)
+
+/**
+ * Parses the `sentry-trace` header `value` into `header`, without allocating.
+ * Returns false if it is not a valid header.
+ */
+bool sentry__trace_header_parse(
+    sentry_trace_header_t *header, const char *value);
+
+/**
+ * Formats a `sentry-trace` header into `buf`, without allocating, and returns
+ * its length, not counting the terminating null byte.
+ */
+size_t sentry__trace_header_format(char buf[SENTRY_TRACE_HEADER_SIZE],
+    const sentry_uuid_t *trace_id, const sentry_uuid_t *span_id, bool sampled);
+
+/**
+ * Turns the ids of the trace header of `tx_cxt` into Values of its `inner`.
+ */
+void sentry__transaction_context_apply_trace_header(
+    sentry_transaction_context_t *tx_cxt);
+
 void sentry__transaction_context_free(sentry_transaction_context_t *tx_cxt);
 
 sentry_transaction_t *sentry__transaction_new(sentry_value_t inner);
@@ -35,11 +119,66 @@ void sentry__transaction_decref(sentry_transaction_t *tx);
 void sentry__span_incref(sentry_span_t *span);
 void sentry__span_decref(sentry_span_t *span);
 
-sentry_value_t sentry__value_span_new(size_t max_spans, sentry_value_t parent,
-    char *operation, char *description);
+sentry_value_t sentry__value_span_new(const sentry_transaction_t *tx,
+    sentry_value_t parent, const char *operation, size_t operation_len,
+    const char *description, size_t description_len);
 sentry_span_t *sentry__span_new(
     sentry_transaction_t *parent_tx, sentry_value_t inner);
 
+/**
+ * Creates a no-op span in the unsampled transaction `parent_tx`, which skips
+ * building the span Value, and is never recorded.
+ */
+sentry_span_t *sentry__span_new_noop(sentry_transaction_t *parent_tx);
+
+/**
+ * Returns the Value that describes `span` for trace propagation. This is the
+ * transaction for no-op spans.
+ */
+sentry_value_t sentry__span_get_trace_value(const sentry_span_t *span);
+
+/**
+ * Records the finished `span` in its transaction, and releases the reference
+ * to `span`. The span is dropped if the transaction already has its
+ * `max_spans` finished spans. Returns true if it was recorded.
+ */
+bool sentry__transaction_add_finished_span(
+    sentry_transaction_t *tx, sentry_span_t *span);
+
+/**
+ * Returns true if the finished spans of `tx`, which streams its spans, should
+ * be sent as a chunk now.
+ */
+bool sentry__transaction_should_flush_spans(const sentry_transaction_t *tx);
+
+/**
+ * Moves the finished spans of `tx` into a new List Value, which is serialized
+ * like `sentry__transaction_spans_to_value`, and writes the earliest start
+ * time among them to `start_ns_out`. Returns a null Value if there are none.
+ */
+sentry_value_t sentry__transaction_take_spans(
+    sentry_transaction_t *tx, uint64_t *start_ns_out);
+
+/**
+ * Returns a new String Value with the ISO8601 timestamp of the monotonic time
+ * `time_ns` in `tx`.
+ */
+sentry_value_t sentry__transaction_timestamp_to_value(
+    const sentry_transaction_t *tx, uint64_t time_ns);
+
+/**
+ * Returns a new List Value with the finished spans of `tx`, as they are
+ * serialized in its `spans`, or a null Value if there are none.
+ */
+sentry_value_t sentry__transaction_spans_to_value(
+    const sentry_transaction_t *tx);
+
+/**
+ * Returns the number of bytes allocated for `tx`, including its finished
+ * spans.
+ */
+size_t sentry__transaction_get_memory_usage(const sentry_transaction_t *tx);
+
 /**
  * Returns an object containing tracing information extracted from a
  * transaction / span which should be included in an event.
@@ -3,11 +3,56 @@
 #include "sentry_envelope.h"
 #include "sentry_options.h"
 #include "sentry_ratelimiter.h"
+#include "sentry_stats.h"
 #include "sentry_string.h"
+#include "sentry_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+#    include <zlib.h>
+#endif
 
 #define ENVELOPE_MIME "application/x-sentry-envelope"
-// The headers we use are: `x-sentry-auth`, `content-type`, `content-length`
-#define MAX_HTTP_HEADERS 3
+// Bodies smaller than this are sent uncompressed, as compressing them costs
+// more time than is saved on the wire.
+#define COMPRESSION_MIN_BODY_SIZE 1024
+
+static const char *const g_priority_names[SENTRY_TASK_PRIORITY_COUNT]
+    = { "transaction", "session", "event" };
+
+static const char *const g_rate_limit_names[SENTRY_RL_CATEGORY_COUNT]
+    = { "any", "error", "session", "transaction" };
+
+// The upper bounds of the request latency histogram buckets, in milliseconds.
+// The last bucket holds all the requests that took longer than that.
+#define LATENCY_BUCKETS 8
+static const uint64_t g_latency_bounds_ms[LATENCY_BUCKETS - 1]
+    = { 50, 100, 250, 500, 1000, 2500, 5000 };
+
+// The number of distinct HTTP status codes and client errors that are
+// counted; any others are ignored.
+#define MAX_OUTCOME_CODES 16
+
+typedef struct {
+    long code;
+    uint64_t count;
+} transport_outcome_t;
+
+struct sentry_transport_stats_s {
+    sentry_mutex_t lock;
+    uint64_t requests;
+    uint64_t latency_sum_ms;
+    uint64_t latency_buckets[LATENCY_BUCKETS];
+    uint64_t bytes_sent;
+    uint64_t bytes_uncompressed;
+    size_t queue_depth;
+    size_t queue_high_water;
+    transport_outcome_t status_codes[MAX_OUTCOME_CODES];
+    transport_outcome_t errors[MAX_OUTCOME_CODES];
+    uint64_t rate_limited[SENTRY_RL_CATEGORY_COUNT];
+};
 
 typedef struct sentry_transport_s {
     void (*send_envelope_func)(sentry_envelope_t *envelope, void *state);
@@ -16,8 +61,16 @@ typedef struct sentry_transport_s {
     int (*flush_func)(uint64_t timeout, void *state);
     void (*free_func)(void *state);
     size_t (*dump_func)(sentry_run_t *run, void *state);
+    size_t (*memory_usage_func)(void *state);
+    sentry_transport_t *(*factory_func)(void);
+    sentry_bgworker_t *bgworker;
+    const sentry_rate_limiter_t *rate_limiter;
+    sentry_transport_stats_t *stats;
     void *state;
     bool running;
+    // the transports that send to the mirror DSNs, which are created by the
+    // factory function on startup, see `start_mirrors`
+    struct sentry_transport_s *next_mirror;
 } sentry_transport_t;
 
 sentry_transport_t *
@@ -66,6 +119,47 @@ sentry_transport_set_flush_func(sentry_transport_t *transport,
     transport->flush_func = flush_func;
 }
 
+/**
+ * Sends `envelope` to the transport and all of its mirrors. The envelope is
+ * serialized only once into a payload that all of them share, except for the
+ * ones that currently rate limit some of its items, which get a copy without
+ * those items instead.
+ */
+static void
+fan_out_envelope(sentry_transport_t *transport, sentry_envelope_t *envelope)
+{
+    sentry_envelope_t *shared = NULL;
+    for (sentry_transport_t *destination = transport; destination;
+         destination = destination->next_mirror) {
+        const sentry_rate_limiter_t *rl = destination->rate_limiter;
+        uint64_t counts[SENTRY_RL_CATEGORY_COUNT] = { 0 };
+        if (rl) {
+            sentry__envelope_count_rate_limited_items(envelope, rl, counts);
+        }
+        bool is_limited = false;
+        for (size_t i = 0; i < SENTRY_RL_CATEGORY_COUNT; i++) {
+            is_limited = is_limited || counts[i];
+        }
+
+        sentry_envelope_t *copy = NULL;
+        if (is_limited) {
+            sentry__transport_stats_record_rate_limits(
+                destination->stats, envelope, rl);
+            copy = sentry__envelope_new_shared(envelope, rl);
+        } else {
+            if (!shared) {
+                shared = sentry__envelope_new_shared(envelope, NULL);
+            }
+            copy = sentry__envelope_share(shared);
+        }
+        if (copy) {
+            destination->send_envelope_func(copy, destination->state);
+        }
+    }
+    sentry_envelope_free(shared);
+    sentry_envelope_free(envelope);
+}
+
 void
 sentry__transport_send_envelope(
     sentry_transport_t *transport, sentry_envelope_t *envelope)
@@ -79,7 +173,52 @@ sentry__transport_send_envelope(
         return;
     }
     SENTRY_TRACE("sending envelope");
-    transport->send_envelope_func(envelope, transport->state);
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_TRANSPORT);
+    if (transport->next_mirror) {
+        fan_out_envelope(transport, envelope);
+    } else {
+        transport->send_envelope_func(envelope, transport->state);
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
+}
+
+/**
+ * Creates and starts a transport of the same kind for every mirror DSN.
+ *
+ * The mirrors are started with a copy of the options that has their DSN
+ * instead, and no run directory, so that they do not spool failed envelopes
+ * into it, which would be sent to the DSN on the next start.
+ */
+static void
+start_mirrors(sentry_transport_t *transport, const sentry_options_t *options)
+{
+    if (!options->mirror_dsns || transport->next_mirror) {
+        return;
+    }
+    if (!transport->factory_func) {
+        SENTRY_WARN("the transport does not support mirror DSNs");
+        return;
+    }
+    sentry_options_t mirror_options = *options;
+    mirror_options.mirror_dsns = NULL;
+    mirror_options.run = NULL;
+    for (const sentry_mirror_dsn_t *mirror_dsn = options->mirror_dsns;
+         mirror_dsn; mirror_dsn = mirror_dsn->next) {
+        sentry_transport_t *mirror = transport->factory_func();
+        if (!mirror) {
+            continue;
+        }
+        mirror_options.dsn = mirror_dsn->dsn;
+        if (sentry__transport_startup(mirror, &mirror_options) != 0) {
+            SENTRY_WARNF("failed to start the transport for the mirror DSN "
+                         "\"%s\"",
+                mirror_dsn->dsn->raw);
+            sentry_transport_free(mirror);
+            continue;
+        }
+        mirror->next_mirror = transport->next_mirror;
+        transport->next_mirror = mirror;
+    }
 }
 
 int
@@ -90,30 +229,261 @@ sentry__transport_startup(
         SENTRY_TRACE("starting transport");
         int rv = transport->startup_func(options, transport->state);
         transport->running = rv == 0;
-        return rv;
+        if (rv != 0) {
+            return rv;
+        }
     }
+    start_mirrors(transport, options);
     return 0;
 }
 
+/**
+ * Returns what is left of `timeout` since `start`, so that the mirrors all
+ * share the timeout of the transport.
+ */
+static uint64_t
+remaining_timeout(uint64_t start, uint64_t timeout)
+{
+    uint64_t elapsed = sentry__monotonic_time() - start;
+    return elapsed < timeout ? timeout - elapsed : 0;
+}
+
 int
 sentry__transport_flush(sentry_transport_t *transport, uint64_t timeout)
 {
-    if (transport->flush_func && transport->running) {
-        SENTRY_TRACE("flushing transport");
-        return transport->flush_func(timeout, transport->state);
+    uint64_t start = sentry__monotonic_time();
+    int rv = 0;
+    for (; transport; transport = transport->next_mirror) {
+        if (transport->flush_func && transport->running) {
+            SENTRY_TRACE("flushing transport");
+            if (transport->flush_func(
+                    remaining_timeout(start, timeout), transport->state)
+                != 0) {
+                rv = 1;
+            }
+        }
     }
-    return 0;
+    return rv;
 }
 
 int
 sentry__transport_shutdown(sentry_transport_t *transport, uint64_t timeout)
 {
-    if (transport->shutdown_func && transport->running) {
-        SENTRY_TRACE("shutting down transport");
-        transport->running = false;
-        return transport->shutdown_func(timeout, transport->state);
+    uint64_t start = sentry__monotonic_time();
+    int rv = 0;
+    for (; transport; transport = transport->next_mirror) {
+        if (transport->shutdown_func && transport->running) {
+            SENTRY_TRACE("shutting down transport");
+            transport->running = false;
+            if (transport->shutdown_func(
+                    remaining_timeout(start, timeout), transport->state)
+                != 0) {
+                rv = 1;
+            }
+        }
     }
-    return 0;
+    return rv;
+}
+
+void
+sentry__transport_set_rate_limiter(
+    sentry_transport_t *transport, const sentry_rate_limiter_t *rl)
+{
+    transport->rate_limiter = rl;
+}
+
+bool
+sentry__transport_is_rate_limited(
+    const sentry_transport_t *transport, int category)
+{
+    // an envelope is rejected only when none of the destinations would take it
+    if (!transport) {
+        return false;
+    }
+    for (; transport; transport = transport->next_mirror) {
+        if (!transport->rate_limiter
+            || !sentry__rate_limiter_is_disabled(
+                transport->rate_limiter, category)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+sentry__transport_set_stats(
+    sentry_transport_t *transport, sentry_transport_stats_t *stats)
+{
+    transport->stats = stats;
+}
+
+void
+sentry__transport_record_rate_limited(
+    sentry_transport_t *transport, int category)
+{
+    sentry_transport_stats_t *stats = transport ? transport->stats : NULL;
+    if (!stats) {
+        return;
+    }
+    sentry__mutex_lock(&stats->lock);
+    stats->rate_limited[category]++;
+    sentry__mutex_unlock(&stats->lock);
+}
+
+static sentry_value_t
+outcomes_to_value(const transport_outcome_t *outcomes)
+{
+    sentry_value_t rv = sentry_value_new_object();
+    for (size_t i = 0; i < MAX_OUTCOME_CODES && outcomes[i].count; i++) {
+        char key[24];
+        snprintf(key, sizeof(key), "%ld", outcomes[i].code);
+        sentry_value_set_by_key(
+            rv, key, sentry_value_new_uint64(outcomes[i].count));
+    }
+    return rv;
+}
+
+sentry_value_t
+sentry__transport_get_stats(sentry_transport_t *transport)
+{
+    sentry_transport_stats_t *stats = transport ? transport->stats : NULL;
+    if (!stats) {
+        return sentry_value_new_null();
+    }
+
+    sentry_value_t rv = sentry_value_new_object();
+    sentry__mutex_lock(&stats->lock);
+    sentry_value_set_by_key(
+        rv, "requests", sentry_value_new_uint64(stats->requests));
+    sentry_value_set_by_key(
+        rv, "latency_ms_sum", sentry_value_new_uint64(stats->latency_sum_ms));
+    sentry_value_t bounds = sentry_value_new_list();
+    sentry_value_t buckets = sentry_value_new_list();
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        if (i < LATENCY_BUCKETS - 1) {
+            sentry_value_append(
+                bounds, sentry_value_new_uint64(g_latency_bounds_ms[i]));
+        }
+        sentry_value_append(
+            buckets, sentry_value_new_uint64(stats->latency_buckets[i]));
+    }
+    sentry_value_set_by_key(rv, "latency_ms_bounds", bounds);
+    sentry_value_set_by_key(rv, "latency_ms_buckets", buckets);
+    sentry_value_set_by_key(
+        rv, "bytes_sent", sentry_value_new_uint64(stats->bytes_sent));
+    sentry_value_set_by_key(rv, "bytes_uncompressed",
+        sentry_value_new_uint64(stats->bytes_uncompressed));
+    sentry_value_set_by_key(rv, "queue_depth",
+        sentry_value_new_uint64((uint64_t)stats->queue_depth));
+    sentry_value_set_by_key(rv, "queue_high_water",
+        sentry_value_new_uint64((uint64_t)stats->queue_high_water));
+    sentry_value_set_by_key(
+        rv, "status_codes", outcomes_to_value(stats->status_codes));
+    sentry_value_set_by_key(rv, "errors", outcomes_to_value(stats->errors));
+    sentry_value_t rate_limited = sentry_value_new_object();
+    for (size_t i = 0; i < SENTRY_RL_CATEGORY_COUNT; i++) {
+        sentry_value_set_by_key(rate_limited, g_rate_limit_names[i],
+            sentry_value_new_uint64(stats->rate_limited[i]));
+    }
+    sentry_value_set_by_key(rv, "rate_limited", rate_limited);
+    sentry__mutex_unlock(&stats->lock);
+    return rv;
+}
+
+sentry_transport_stats_t *
+sentry__transport_stats_new(void)
+{
+    sentry_transport_stats_t *stats = SENTRY_MAKE(sentry_transport_stats_t);
+    if (!stats) {
+        return NULL;
+    }
+    memset(stats, 0, sizeof(sentry_transport_stats_t));
+    sentry__mutex_init(&stats->lock);
+    return stats;
+}
+
+void
+sentry__transport_stats_free(sentry_transport_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    sentry__mutex_free(&stats->lock);
+    sentry_free(stats);
+}
+
+static void
+record_outcome(transport_outcome_t *outcomes, long code)
+{
+    for (size_t i = 0; i < MAX_OUTCOME_CODES; i++) {
+        if (!outcomes[i].count) {
+            outcomes[i].code = code;
+        }
+        if (outcomes[i].code == code) {
+            outcomes[i].count++;
+            return;
+        }
+    }
+}
+
+void
+sentry__transport_stats_record_request(sentry_transport_stats_t *stats,
+    uint64_t latency_ms, size_t bytes_sent, size_t bytes_uncompressed,
+    long status_code, long error_code)
+{
+    if (!stats) {
+        return;
+    }
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1
+        && latency_ms > g_latency_bounds_ms[bucket]) {
+        bucket++;
+    }
+
+    sentry__mutex_lock(&stats->lock);
+    stats->requests++;
+    stats->latency_sum_ms += latency_ms;
+    stats->latency_buckets[bucket]++;
+    stats->bytes_sent += bytes_sent;
+    stats->bytes_uncompressed += bytes_uncompressed;
+    if (status_code) {
+        record_outcome(stats->status_codes, status_code);
+    } else {
+        record_outcome(stats->errors, error_code);
+    }
+    sentry__mutex_unlock(&stats->lock);
+}
+
+void
+sentry__transport_stats_record_rate_limits(sentry_transport_stats_t *stats,
+    const sentry_envelope_t *envelope, const sentry_rate_limiter_t *rl)
+{
+    if (!stats || !rl) {
+        return;
+    }
+    uint64_t counts[SENTRY_RL_CATEGORY_COUNT] = { 0 };
+    sentry__envelope_count_rate_limited_items(envelope, rl, counts);
+
+    sentry__mutex_lock(&stats->lock);
+    for (size_t i = 0; i < SENTRY_RL_CATEGORY_COUNT; i++) {
+        stats->rate_limited[i] += counts[i];
+    }
+    sentry__mutex_unlock(&stats->lock);
+}
+
+void
+sentry__transport_stats_record_queue_depth(
+    sentry_transport_stats_t *stats, size_t depth)
+{
+    if (!stats) {
+        return;
+    }
+    sentry__mutex_lock(&stats->lock);
+    stats->queue_depth = depth;
+    if (depth > stats->queue_high_water) {
+        stats->queue_high_water = depth;
+    }
+    sentry__mutex_unlock(&stats->lock);
 }
 
 void
@@ -130,24 +500,234 @@ sentry__transport_dump_queue(sentry_transport_t *transport, sentry_run_t *run)
         return 0;
     }
     size_t dumped = transport->dump_func(run, transport->state);
+    sentry__stats_add(SENTRY_STAT_ENVELOPES_DUMPED, (long)dumped);
     if (dumped) {
         SENTRY_TRACEF("dumped %zu in-flight envelopes to disk", dumped);
     }
     return dumped;
 }
 
+void
+sentry__transport_set_memory_usage_func(
+    sentry_transport_t *transport, size_t (*memory_usage_func)(void *state))
+{
+    transport->memory_usage_func = memory_usage_func;
+}
+
+void
+sentry__transport_set_factory_func(
+    sentry_transport_t *transport, sentry_transport_t *(*factory_func)(void))
+{
+    transport->factory_func = factory_func;
+}
+
+void
+sentry__transport_set_bgworker(
+    sentry_transport_t *transport, sentry_bgworker_t *bgworker)
+{
+    transport->bgworker = bgworker;
+}
+
+sentry_bgworker_t *
+sentry__transport_get_bgworker(sentry_transport_t *transport)
+{
+    return transport ? transport->bgworker : NULL;
+}
+
+sentry_transport_t *
+sentry__transport_new_after_fork(sentry_transport_t *transport)
+{
+    if (!transport || !transport->factory_func) {
+        return transport;
+    }
+    SENTRY_DEBUG("replacing the transport of the parent process");
+    return transport->factory_func();
+}
+
+size_t
+sentry__transport_get_queue_depth(sentry_transport_t *transport)
+{
+    sentry_transport_stats_t *stats = transport ? transport->stats : NULL;
+    if (!stats) {
+        return 0;
+    }
+    sentry__mutex_lock(&stats->lock);
+    size_t depth = stats->queue_depth;
+    sentry__mutex_unlock(&stats->lock);
+    return depth;
+}
+
+size_t
+sentry__transport_get_memory_usage(sentry_transport_t *transport)
+{
+    size_t size = 0;
+    for (; transport; transport = transport->next_mirror) {
+        if (transport->memory_usage_func) {
+            size += transport->memory_usage_func(transport->state);
+        }
+    }
+    return size;
+}
+
+sentry_task_priority_t
+sentry__envelope_get_task_priority(const sentry_envelope_t *envelope)
+{
+    if (!sentry_value_is_null(sentry_envelope_get_event(envelope))) {
+        return SENTRY_TASK_PRIORITY_HIGH;
+    }
+    if (!sentry_value_is_null(sentry_envelope_get_transaction(envelope))) {
+        return SENTRY_TASK_PRIORITY_LOW;
+    }
+    return SENTRY_TASK_PRIORITY_NORMAL;
+}
+
+void
+sentry__transport_log_dropped_envelopes(sentry_bgworker_t *bgworker)
+{
+    for (int i = SENTRY_TASK_PRIORITY_COUNT - 1; i >= 0; i--) {
+        size_t dropped
+            = sentry__bgworker_get_dropped(bgworker, (sentry_task_priority_t)i);
+        if (dropped) {
+            SENTRY_WARNF("dropped %zu %s envelopes because the send queue was "
+                         "full",
+                dropped, g_priority_names[i]);
+        }
+    }
+}
+
 void
 sentry_transport_free(sentry_transport_t *transport)
 {
     if (!transport) {
         return;
     }
+    sentry_transport_free(transport->next_mirror);
     if (transport->free_func) {
         transport->free_func(transport->state);
     }
     sentry_free(transport);
 }
 
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+/**
+ * Gzip-compresses the segments of `body`, streaming them in chunks into a
+ * single output buffer which then replaces them.
+ * Returns `false`, leaving `body` as-is, when compression fails or would not
+ * make the body any smaller.
+ */
+static bool
+gzip_body(sentry_serialized_envelope_t *body)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // the `16` selects the gzip container instead of raw zlib
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+            MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY)
+        != Z_OK) {
+        return false;
+    }
+
+    uLong capacity = deflateBound(&stream, (uLong)body->total_len);
+    if (capacity >= body->total_len) {
+        capacity = (uLong)body->total_len;
+    }
+    char *compressed = sentry_malloc(capacity);
+    if (!compressed) {
+        deflateEnd(&stream);
+        return false;
+    }
+    stream.next_out = (Bytef *)compressed;
+    stream.avail_out = (uInt)capacity;
+
+    sentry_envelope_body_reader_t reader;
+    sentry__envelope_body_reader_init(&reader, body);
+    char chunk[16384];
+    int rv = Z_OK;
+    while (rv == Z_OK) {
+        size_t chunk_len
+            = sentry__envelope_body_read(&reader, chunk, sizeof(chunk));
+        bool is_last = chunk_len < sizeof(chunk);
+        stream.next_in = (Bytef *)chunk;
+        stream.avail_in = (uInt)chunk_len;
+        rv = deflate(&stream, is_last ? Z_FINISH : Z_NO_FLUSH);
+        // running out of output space means the body is not compressible
+        if (rv == Z_OK && (stream.avail_in || is_last)) {
+            rv = Z_BUF_ERROR;
+        }
+    }
+    sentry__envelope_body_reader_cleanup(&reader);
+    size_t compressed_len = stream.total_out;
+    deflateEnd(&stream);
+    // the compressed body is a single owned segment
+    sentry_envelope_segment_t *segment
+        = rv == Z_STREAM_END ? SENTRY_MAKE(sentry_envelope_segment_t) : NULL;
+    if (!segment) {
+        sentry_free(compressed);
+        return false;
+    }
+
+    sentry__serialized_envelope_cleanup(body);
+    body->segments = segment;
+    body->segments[0].buf = compressed;
+    body->segments[0].path = NULL;
+    body->segments[0].len = compressed_len;
+    body->segments_len = 1;
+    body->total_len = compressed_len;
+    body->headers = compressed;
+    return true;
+}
+#endif
+
+/**
+ * Points `body` at the payload that is shared between several destinations,
+ * which is compressed by the first one to send it, so that all of them send
+ * the same compressed bytes. Returns 0 on success.
+ */
+static int
+serialize_shared_payload(sentry_shared_payload_t *shared,
+    sentry_serialized_envelope_t *body, bool *is_compressed)
+{
+    memset(body, 0, sizeof(sentry_serialized_envelope_t));
+    body->segments = sentry__malloc_default_tag(
+        sizeof(sentry_envelope_segment_t), SENTRY_MEMORY_TAG_ENVELOPE);
+    if (!body->segments) {
+        return 1;
+    }
+    body->segments[0].buf = shared->payload;
+    body->segments[0].len = shared->payload_len;
+    body->segments[0].path = NULL;
+    body->segments_len = 1;
+    body->total_len = shared->payload_len;
+
+    sentry__mutex_lock(&shared->lock);
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+    if (!shared->compression_done) {
+        shared->compression_done = true;
+        sentry_serialized_envelope_t compressed = *body;
+        compressed.segments = SENTRY_MAKE(sentry_envelope_segment_t);
+        if (compressed.segments) {
+            compressed.segments[0] = body->segments[0];
+            if (shared->payload_len >= COMPRESSION_MIN_BODY_SIZE
+                && gzip_body(&compressed)) {
+                // the compressed buffer is owned by the shared payload now
+                shared->compressed_payload = compressed.headers;
+                shared->compressed_len = compressed.total_len;
+                compressed.headers = NULL;
+            }
+            sentry__serialized_envelope_cleanup(&compressed);
+        }
+    }
+#endif
+    *is_compressed = shared->compressed_payload != NULL;
+    if (*is_compressed) {
+        body->segments[0].buf = shared->compressed_payload;
+        body->segments[0].len = shared->compressed_len;
+        body->total_len = shared->compressed_len;
+    }
+    sentry__mutex_unlock(&shared->lock);
+    return 0;
+}
+
 sentry_prepared_http_request_t *
 sentry__prepare_http_request(sentry_envelope_t *envelope,
     const sentry_dsn_t *dsn, const sentry_rate_limiter_t *rl)
@@ -156,52 +736,61 @@ sentry__prepare_http_request(sentry_envelope_t *envelope,
         return NULL;
     }
 
-    size_t body_len = 0;
-    bool body_owned = true;
-    char *body = sentry_envelope_serialize_ratelimited(
-        envelope, rl, &body_len, &body_owned);
-    if (!body) {
-        return NULL;
+    sentry_serialized_envelope_t body;
+    bool is_compressed = false;
+    size_t uncompressed_len = 0;
+    sentry_shared_payload_t *shared = sentry__envelope_get_shared(envelope);
+    if (shared) {
+        if (serialize_shared_payload(shared, &body, &is_compressed) != 0) {
+            return NULL;
+        }
+        uncompressed_len = shared->payload_len;
+    } else {
+        if (sentry__envelope_serialize_segments(envelope, rl, &body) != 0) {
+            return NULL;
+        }
+        uncompressed_len = body.total_len;
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+        is_compressed = body.total_len >= COMPRESSION_MIN_BODY_SIZE
+            && gzip_body(&body);
+#endif
     }
 
     sentry_prepared_http_request_t *req
         = SENTRY_MAKE(sentry_prepared_http_request_t);
     if (!req) {
-        if (body_owned) {
-            sentry_free(body);
-        }
-        return NULL;
-    }
-    req->headers = sentry_malloc(
-        sizeof(sentry_prepared_http_header_t) * MAX_HTTP_HEADERS);
-    if (!req->headers) {
-        sentry_free(req);
-        if (body_owned) {
-            sentry_free(body);
-        }
+        sentry__serialized_envelope_cleanup(&body);
         return NULL;
     }
     req->headers_len = 0;
 
     req->method = "POST";
-    req->url = sentry__dsn_get_envelope_url(dsn);
+    req->url = dsn->envelope_url;
 
     sentry_prepared_http_header_t *h;
     h = &req->headers[req->headers_len++];
     h->key = "x-sentry-auth";
-    h->value = sentry__dsn_get_auth_header(dsn);
+    h->value = dsn->auth_header;
 
     h = &req->headers[req->headers_len++];
     h->key = "content-type";
-    h->value = sentry__string_clone(ENVELOPE_MIME);
+    h->value = ENVELOPE_MIME;
+    req->static_headers_len = req->headers_len;
+
+    req->uncompressed_len = uncompressed_len;
+    if (is_compressed) {
+        h = &req->headers[req->headers_len++];
+        h->key = "content-encoding";
+        h->value = "gzip";
+    }
 
     h = &req->headers[req->headers_len++];
     h->key = "content-length";
-    h->value = sentry__int64_to_string((int64_t)body_len);
+    snprintf(req->content_length, sizeof(req->content_length), "%llu",
+        (unsigned long long)body.total_len);
+    h->value = req->content_length;
 
     req->body = body;
-    req->body_len = body_len;
-    req->body_owned = body_owned;
 
     return req;
 }
@@ -212,13 +801,6 @@ sentry__prepared_http_request_free(sentry_prepared_http_request_t *req)
     if (!req) {
         return;
     }
-    sentry_free(req->url);
-    for (size_t i = 0; i < req->headers_len; i++) {
-        sentry_free(req->headers[i].value);
-    }
-    sentry_free(req->headers);
-    if (req->body_owned) {
-        sentry_free(req->body);
-    }
+    sentry__serialized_envelope_cleanup(&req->body);
     sentry_free(req);
 }
@@ -3,9 +3,13 @@
 
 #include "sentry_boot.h"
 
+#include "sentry_envelope.h"
+#include "sentry_sync.h"
+
 typedef struct sentry_dsn_s sentry_dsn_t;
 typedef struct sentry_run_s sentry_run_t;
 typedef struct sentry_rate_limiter_s sentry_rate_limiter_t;
+typedef struct sentry_transport_stats_s sentry_transport_stats_t;
 
 /**
  * Sets the dump function of the transport.
@@ -18,13 +22,133 @@ void sentry__transport_set_dump_func(sentry_transport_t *transport,
     size_t (*dump_func)(sentry_run_t *run, void *state));
 
 /**
- * Submit the given envelope to the transport.
+ * Sets the memory usage function of the transport.
+ *
+ * This function returns the number of bytes held by the envelopes in the
+ * internal send queue, as per `sentry__envelope_get_memory_usage`.
+ */
+void sentry__transport_set_memory_usage_func(
+    sentry_transport_t *transport, size_t (*memory_usage_func)(void *state));
+
+/**
+ * Sets the factory function of the transport.
+ *
+ * This function creates another transport of the same kind, which still needs
+ * to be started. It creates the transports for the mirror DSNs on startup, and
+ * the transport that replaces this one in the child process after a `fork`,
+ * for transports that send from a worker thread, which is not forked along.
+ * See `sentry__transport_new_after_fork`.
+ */
+void sentry__transport_set_factory_func(
+    sentry_transport_t *transport, sentry_transport_t *(*factory_func)(void));
+
+/**
+ * Sets the worker thread that the transport sends from.
+ *
+ * The worker is owned by the transport state, and has to live as long as the
+ * transport. Other tasks that are cheap and infrequent can be submitted to it
+ * instead of starting a thread of their own, see
+ * `sentry__transport_get_bgworker`.
+ */
+void sentry__transport_set_bgworker(
+    sentry_transport_t *transport, sentry_bgworker_t *bgworker);
+
+/**
+ * Returns the worker thread that the transport sends from, or NULL if it does
+ * not have one, like custom transports.
+ */
+sentry_bgworker_t *sentry__transport_get_bgworker(
+    sentry_transport_t *transport);
+
+/**
+ * Sets the rate limiter of the transport.
+ *
+ * The rate limiter is owned by the transport state, and has to live as long as
+ * the transport. It is used to reject rate limited events before they are
+ * prepared, see `sentry__transport_is_rate_limited`.
+ */
+void sentry__transport_set_rate_limiter(
+    sentry_transport_t *transport, const sentry_rate_limiter_t *rl);
+
+/**
+ * Returns `true` if the rate limiter of the transport currently rejects the
+ * given `category`, and so do the ones of all its mirrors. Transports without
+ * a rate limiter never reject anything.
+ *
+ * This does not take any lock.
+ */
+bool sentry__transport_is_rate_limited(
+    const sentry_transport_t *transport, int category);
+
+/**
+ * Sets the statistics of the transport, which can be queried using
+ * `sentry_get_transport_stats`.
+ *
+ * The statistics are owned by the transport state, and have to live as long
+ * as the transport.
+ */
+void sentry__transport_set_stats(
+    sentry_transport_t *transport, sentry_transport_stats_t *stats);
+
+/**
+ * Records that an envelope was rejected before being queued, because its
+ * `category` is rate limited.
+ */
+void sentry__transport_record_rate_limited(
+    sentry_transport_t *transport, int category);
+
+/**
+ * Returns the statistics of the transport as a new object, or `null` if the
+ * transport does not collect any.
+ */
+sentry_value_t sentry__transport_get_stats(sentry_transport_t *transport);
+
+/**
+ * Creates new, empty transport statistics.
+ *
+ * All the `sentry__transport_stats_*` functions can be called from any thread.
+ */
+sentry_transport_stats_t *sentry__transport_stats_new(void);
+
+/**
+ * Frees the transport statistics.
+ */
+void sentry__transport_stats_free(sentry_transport_stats_t *stats);
+
+/**
+ * Records a finished request, which took `latency_ms`, and sent `bytes_sent`
+ * bytes of a body that had `bytes_uncompressed` bytes before compression.
+ * The `status_code` is the HTTP status of the response, or 0 if there was
+ * none, which is when `error_code` holds the error of the HTTP client.
+ */
+void sentry__transport_stats_record_request(sentry_transport_stats_t *stats,
+    uint64_t latency_ms, size_t bytes_sent, size_t bytes_uncompressed,
+    long status_code, long error_code);
+
+/**
+ * Records the items of `envelope` that are dropped because they are currently
+ * rate limited by `rl`.
+ */
+void sentry__transport_stats_record_rate_limits(sentry_transport_stats_t *stats,
+    const sentry_envelope_t *envelope, const sentry_rate_limiter_t *rl);
+
+/**
+ * Records the current depth of the send queue, which also updates its
+ * high-water mark.
+ */
+void sentry__transport_stats_record_queue_depth(
+    sentry_transport_stats_t *stats, size_t depth);
+
+/**
+ * Submit the given envelope to the transport, and to the transports of the
+ * mirror DSNs, which all get the same serialized payload.
  */
 void sentry__transport_send_envelope(
     sentry_transport_t *transport, sentry_envelope_t *envelope);
 
 /**
- * Calls the transports startup hook.
+ * Calls the transports startup hook, and creates and starts the transports
+ * for the mirror DSNs of `options` using its factory function.
  *
  * Returns 0 on success.
  */
@@ -50,35 +174,86 @@ int sentry__transport_shutdown(sentry_transport_t *transport, uint64_t timeout);
  */
 sentry_transport_t *sentry__transport_new_default(void);
 
+/**
+ * Returns the transport to use in the child process after a `fork`, which is a
+ * new one that still needs to be started if `transport` has a fork function,
+ * or NULL if that fails, and `transport` itself otherwise.
+ *
+ * The replaced transport is abandoned without being shut down or freed: its
+ * worker thread only exists in the parent, and freeing its state would close
+ * the connections that it shares with the parent.
+ */
+sentry_transport_t *sentry__transport_new_after_fork(
+    sentry_transport_t *transport);
+
 /**
  * This function will instruct the platform specific transport to dump all the
- * envelopes in its send queue to disk.
+ * envelopes in its send queue to disk. The send queues of the mirrors are not
+ * dumped, as the dumped envelopes are sent to the DSN only.
  */
 size_t sentry__transport_dump_queue(
     sentry_transport_t *transport, sentry_run_t *run);
 
+/**
+ * Returns the number of envelopes in the send queue of the transport, or 0 if
+ * the transport does not collect statistics.
+ */
+size_t sentry__transport_get_queue_depth(sentry_transport_t *transport);
+
+/**
+ * Returns the number of bytes held by the envelopes in the send queues of the
+ * transport and its mirrors, or 0 if the transport does not report it.
+ */
+size_t sentry__transport_get_memory_usage(sentry_transport_t *transport);
+
+/**
+ * Returns the priority of `envelope` in the send queue of a transport. Events
+ * take precedence over sessions, which take precedence over transactions.
+ */
+sentry_task_priority_t sentry__envelope_get_task_priority(
+    const sentry_envelope_t *envelope);
+
+/**
+ * Logs the number of envelopes the send queue `bgworker` of a transport
+ * dropped because it was full.
+ */
+void sentry__transport_log_dropped_envelopes(sentry_bgworker_t *bgworker);
+
+// The headers we use are: `x-sentry-auth`, `content-type`, `content-length`
+// and `content-encoding`
+#define SENTRY_MAX_HTTP_HEADERS 4
+
 typedef struct sentry_prepared_http_header_s {
     const char *key;
-    char *value;
+    const char *value;
 } sentry_prepared_http_header_t;
 
 /**
  * This represents a HTTP request, with method, url, headers and a body.
+ * The body is split into segments, which need to be sent in order.
+ * The url and header values are borrowed from the DSN, which has to outlive
+ * the request.
  */
 typedef struct sentry_prepared_http_request_s {
     const char *method;
-    char *url;
-    sentry_prepared_http_header_t *headers;
+    const char *url;
+    sentry_prepared_http_header_t headers[SENTRY_MAX_HTTP_HEADERS];
     size_t headers_len;
-    char *body;
-    size_t body_len;
-    bool body_owned;
+    // the first `static_headers_len` headers are the same for every request
+    // to the same DSN
+    size_t static_headers_len;
+    char content_length[24];
+    sentry_serialized_envelope_t body;
+    // the size of the body before it was compressed
+    size_t uncompressed_len;
 } sentry_prepared_http_request_t;
 
 /**
- * Consumes the given envelope and transforms it into into a prepared http
- * request. This can return NULL when all the items in the envelope have been
- * rate limited.
+ * Transforms the given envelope into into a prepared http request. This can
+ * return NULL when all the items in the envelope have been rate limited.
+ * The request body references the item payloads of the envelope, so the
+ * envelope has to outlive the request. Envelopes with a shared payload are
+ * compressed only once for all of their requests.
  */
 sentry_prepared_http_request_t *sentry__prepare_http_request(
     sentry_envelope_t *envelope, const sentry_dsn_t *dsn,
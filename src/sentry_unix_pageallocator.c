@@ -2,6 +2,7 @@
 #include "sentry_core.h"
 #include "sentry_unix_spinlock.h"
 
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -12,24 +13,140 @@
 
 #define ALIGN 8
 
-struct page_header;
-struct page_header {
-    struct page_header *next;
-    size_t num_pages;
+// pages are mapped at least this many at a time once the reserve is used up
+#define MIN_CHUNK_PAGES 16
+
+// allocations up to the largest size class are rounded up to a power of two,
+// and freed ones are kept in a list per size class to be reused
+#define MIN_CLASS_SHIFT 4
+#define SIZE_CLASS_COUNT 9
+#define MAX_CLASS_SIZE ((size_t)1 << (MIN_CLASS_SHIFT + SIZE_CLASS_COUNT - 1))
+
+/**
+ * A contiguous range of mapped pages that allocations are carved from. The
+ * reserve is the first of these.
+ */
+struct chunk_header;
+struct chunk_header {
+    struct chunk_header *next;
+    size_t size;
+};
+
+/**
+ * Every allocation is preceded by its usable size, which also decides the
+ * free list it goes into.
+ */
+struct block_header {
+    size_t size;
+};
+
+struct free_block;
+struct free_block {
+    struct free_block *next;
 };
 
 struct page_allocator_s {
     size_t page_size;
-    struct page_header *last_page;
-    char *current_page;
-    size_t page_offset;
-    size_t pages_allocated;
+    struct chunk_header *chunks;
+    char *current;
+    char *current_end;
+    // blocks larger than the largest size class are reused first-fit
+    struct free_block *free_lists[SIZE_CLASS_COUNT + 1];
+    size_t mapped;
+    size_t in_use;
+    size_t high_water_mark;
 };
 
 static struct page_allocator_s g_page_allocator_backing = { 0 };
 static struct page_allocator_s *g_alloc = NULL;
 static sentry_spinlock_t g_lock = SENTRY__SPINLOCK_INIT;
 
+// the reserve is mapped ahead of time, and handed over once enabled
+static struct chunk_header *g_reserve = NULL;
+
+static size_t
+page_size(void)
+{
+    return g_alloc ? g_alloc->page_size : (size_t)getpagesize();
+}
+
+static struct chunk_header *
+map_chunk(size_t size, bool prefault)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    if (prefault) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void *rv = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (rv == MAP_FAILED) {
+        return NULL;
+    }
+
+#if defined(__has_feature)
+#    if __has_feature(memory_sanitizer)
+    __msan_unpoison(rv, size);
+#    endif
+#endif
+
+#ifndef MAP_POPULATE
+    // the pages need to be backed by memory before we crash, not after
+    if (prefault) {
+        size_t step = page_size();
+        for (size_t offset = 0; offset < size; offset += step) {
+            ((volatile char *)rv)[offset] = 0;
+        }
+    }
+#endif
+
+    struct chunk_header *chunk = (struct chunk_header *)rv;
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
+
+static void
+use_chunk(struct chunk_header *chunk)
+{
+    chunk->next = g_alloc->chunks;
+    g_alloc->chunks = chunk;
+    g_alloc->mapped += chunk->size;
+    g_alloc->current = (char *)chunk + sizeof(struct chunk_header);
+    g_alloc->current_end = (char *)chunk + chunk->size;
+}
+
+void
+sentry__page_allocator_reserve(size_t size)
+{
+    size_t pages = (size + page_size() - 1) / page_size();
+    size = pages * page_size();
+
+    sentry__spinlock_lock(&g_lock);
+    bool has_reserve = g_alloc || (g_reserve && g_reserve->size >= size);
+    sentry__spinlock_unlock(&g_lock);
+    if (has_reserve || !size) {
+        return;
+    }
+
+    struct chunk_header *reserve = map_chunk(size, true);
+    if (!reserve) {
+        SENTRY_WARN("failed to map the memory reserve for crash handling");
+        return;
+    }
+
+    sentry__spinlock_lock(&g_lock);
+    struct chunk_header *previous = reserve;
+    if (!g_alloc) {
+        previous = g_reserve;
+        g_reserve = reserve;
+    }
+    sentry__spinlock_unlock(&g_lock);
+    if (previous) {
+        munmap(previous, previous->size);
+    }
+}
+
 bool
 sentry__page_allocator_enabled(void)
 {
@@ -42,38 +159,67 @@ sentry__page_allocator_enable(void)
     sentry__spinlock_lock(&g_lock);
     if (!g_alloc) {
         g_alloc = &g_page_allocator_backing;
+        memset(g_alloc, 0, sizeof(struct page_allocator_s));
         g_alloc->page_size = getpagesize();
-        g_alloc->last_page = NULL;
-        g_alloc->current_page = NULL;
-        g_alloc->page_offset = 0;
-        g_alloc->pages_allocated = 0;
+        if (g_reserve) {
+            use_chunk(g_reserve);
+            g_reserve = NULL;
+        }
     }
     sentry__spinlock_unlock(&g_lock);
 }
 
-static void *
-get_pages(size_t num_pages)
+static size_t
+size_class_of(size_t size)
 {
-    void *rv = mmap(NULL, g_alloc->page_size * num_pages,
-        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (rv == MAP_FAILED) {
-        return NULL;
+    size_t size_class = 0;
+    while (size_class < SIZE_CLASS_COUNT
+        && ((size_t)1 << (MIN_CLASS_SHIFT + size_class)) < size) {
+        size_class++;
     }
+    return size_class;
+}
 
-#if defined(__has_feature)
-#    if __has_feature(memory_sanitizer)
-    __msan_unpoison(rv, g_alloc->page_size * num_pages);
-#    endif
-#endif
-
-    struct page_header *header = (struct page_header *)rv;
-    header->next = g_alloc->last_page;
-    header->num_pages = num_pages;
-    g_alloc->last_page = header;
+static struct block_header *
+reuse_block(size_t size_class, size_t size)
+{
+    struct free_block **link = &g_alloc->free_lists[size_class];
+    while (*link) {
+        struct block_header *header = (struct block_header *)*link - 1;
+        if (header->size >= size) {
+            *link = (*link)->next;
+            return header;
+        }
+        // only the list of large blocks has blocks of different sizes
+        link = &(*link)->next;
+    }
+    return NULL;
+}
 
-    g_alloc->pages_allocated += num_pages;
+static struct block_header *
+new_block(size_t size)
+{
+    size_t needed = sizeof(struct block_header) + size;
+    if ((size_t)(g_alloc->current_end - g_alloc->current) < needed) {
+        size_t chunk_size = sizeof(struct chunk_header) + needed;
+        size_t pages
+            = (chunk_size + g_alloc->page_size - 1) / g_alloc->page_size;
+        if (pages < MIN_CHUNK_PAGES) {
+            pages = MIN_CHUNK_PAGES;
+        }
+        // whatever is left of the previous chunk is lost
+        struct chunk_header *chunk
+            = map_chunk(pages * g_alloc->page_size, false);
+        if (!chunk) {
+            return NULL;
+        }
+        use_chunk(chunk);
+    }
 
-    return rv;
+    struct block_header *header = (struct block_header *)g_alloc->current;
+    header->size = size;
+    g_alloc->current += needed;
+    return header;
 }
 
 void *
@@ -84,59 +230,90 @@ sentry__page_allocator_alloc(size_t size)
     }
 
     // make sure the requested size is correctly aligned
-    size_t diff = size % ALIGN;
-    size = size + ALIGN - diff;
-
-    char *rv = NULL;
+    size = (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    size_t size_class = size_class_of(size);
+    if (size_class < SIZE_CLASS_COUNT) {
+        size = (size_t)1 << (MIN_CLASS_SHIFT + size_class);
+    }
 
     sentry__spinlock_lock(&g_lock);
 
-    // current page is large enough
-    if (g_alloc->current_page
-        && g_alloc->page_size - g_alloc->page_offset >= size) {
-        rv = g_alloc->current_page + g_alloc->page_offset;
-        g_alloc->page_offset += size;
-        if (g_alloc->page_offset == g_alloc->page_size) {
-            g_alloc->page_offset = 0;
-            g_alloc->current_page = NULL;
+    struct block_header *header = reuse_block(size_class, size);
+    if (!header) {
+        header = new_block(size);
+    }
+    if (header) {
+        g_alloc->in_use += header->size;
+        if (g_alloc->in_use > g_alloc->high_water_mark) {
+            g_alloc->high_water_mark = g_alloc->in_use;
         }
-    } else {
-        // allocate new pages
+    }
 
-        size_t requested_size = size + sizeof(struct page_header);
-        size_t pages
-            = (requested_size + g_alloc->page_size - 1) / g_alloc->page_size;
-        size_t actual_size = g_alloc->page_size * pages;
-
-        rv = get_pages(pages);
-
-        if (rv) {
-            size_t diff = actual_size - requested_size;
-            g_alloc->page_offset
-                = (g_alloc->page_size - diff) % g_alloc->page_size;
-            g_alloc->current_page = g_alloc->page_offset
-                ? rv + g_alloc->page_size * (pages - 1)
-                : NULL;
-            rv += sizeof(struct page_header);
+    sentry__spinlock_unlock(&g_lock);
+    return header ? header + 1 : NULL;
+}
+
+static bool
+owns_allocation(const char *ptr)
+{
+    for (struct chunk_header *chunk = g_alloc->chunks; chunk;
+         chunk = chunk->next) {
+        if (ptr > (char *)chunk && ptr < (char *)chunk + chunk->size) {
+            return true;
         }
     }
+    return false;
+}
+
+void
+sentry__page_allocator_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
 
+    sentry__spinlock_lock(&g_lock);
+    // anything allocated before the page allocator was enabled is leaked
+    if (owns_allocation(ptr)) {
+        struct block_header *header = (struct block_header *)ptr - 1;
+        size_t size_class = size_class_of(header->size);
+        struct free_block *block = (struct free_block *)ptr;
+        block->next = g_alloc->free_lists[size_class];
+        g_alloc->free_lists[size_class] = block;
+        g_alloc->in_use -= header->size;
+    }
+    sentry__spinlock_unlock(&g_lock);
+}
+
+void
+sentry__page_allocator_get_stats(sentry_page_allocator_stats_t *stats)
+{
+    memset(stats, 0, sizeof(sentry_page_allocator_stats_t));
+    sentry__spinlock_lock(&g_lock);
+    if (g_alloc) {
+        stats->mapped = g_alloc->mapped;
+        stats->in_use = g_alloc->in_use;
+        stats->high_water_mark = g_alloc->high_water_mark;
+    } else if (g_reserve) {
+        stats->mapped = g_reserve->size;
+    }
     sentry__spinlock_unlock(&g_lock);
-    return rv;
 }
 
 #ifdef SENTRY_UNITTEST
 void
 sentry__page_allocator_disable(void)
 {
-    if (!g_alloc) {
-        return;
+    struct chunk_header *chunks = g_reserve;
+    g_reserve = NULL;
+    if (g_alloc) {
+        chunks = g_alloc->chunks;
+        g_alloc = NULL;
     }
-    struct page_header *next;
-    for (struct page_header *cur = g_alloc->last_page; cur; cur = next) {
+    struct chunk_header *next;
+    for (struct chunk_header *cur = chunks; cur; cur = next) {
         next = cur->next;
-        munmap(cur, cur->num_pages * g_alloc->page_size);
+        munmap(cur, cur->size);
     }
-    g_alloc = NULL;
 }
 #endif
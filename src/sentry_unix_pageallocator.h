@@ -3,6 +3,14 @@
 
 #include "sentry_boot.h"
 
+/**
+ * Maps `size` bytes of memory ahead of time and makes sure they are backed by
+ * physical pages, so that the page allocator can serve its first allocations
+ * without mapping any more memory once it is enabled. This does nothing if the
+ * page allocator is already enabled, or there is a reserve of at least `size`.
+ */
+void sentry__page_allocator_reserve(size_t size);
+
 /**
  * Returns the state of the page allocator.
  */
@@ -21,6 +29,28 @@ void sentry__page_allocator_enable(void);
  */
 void *sentry__page_allocator_alloc(size_t size);
 
+/**
+ * This is a replacement for `free`. Allocations of the page allocator are kept
+ * around to be reused by later allocations of the same size class, anything
+ * else is leaked.
+ */
+void sentry__page_allocator_free(void *ptr);
+
+typedef struct {
+    // The number of bytes that are mapped, including the reserve.
+    size_t mapped;
+    // The number of bytes that are currently allocated.
+    size_t in_use;
+    // The largest number of bytes that were allocated at any time.
+    size_t high_water_mark;
+} sentry_page_allocator_stats_t;
+
+/**
+ * Fills `stats` with the memory used by the page allocator since it was
+ * enabled.
+ */
+void sentry__page_allocator_get_stats(sentry_page_allocator_stats_t *stats);
+
 #ifdef SENTRY_UNITTEST
 /**
  * This disables the page allocator, which invalidates every allocation that was
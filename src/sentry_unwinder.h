@@ -0,0 +1,70 @@
+#ifndef SENTRY_UNWINDER_H_INCLUDED
+#define SENTRY_UNWINDER_H_INCLUDED
+
+#include "sentry_boot.h"
+
+/**
+ * Sets up the state that the unwinders keep across unwinds ahead of time, so
+ * that unwinding from within a signal handler does not have to create it.
+ * This is optional, and may take a while.
+ */
+void sentry__unwinder_prepare(void);
+
+/**
+ * Installs the signal handler that other threads use to hand their context
+ * over to `sentry__unwind_thread`. Calls need to be balanced with
+ * `sentry__unwinder_threads_end`, the last of which restores the previous
+ * handler. This may be called from within a signal handler.
+ */
+void sentry__unwinder_threads_begin(void);
+void sentry__unwinder_threads_end(void);
+
+/**
+ * Unwinds the stack of the thread `tid` of this process into `ptrs`, and
+ * returns the number of frames. The thread is interrupted for the duration of
+ * the unwind, and 0 is returned if it did not respond within `timeout_ms`.
+ * Concurrent calls are serialized, and 0 is also returned if an unwind that is
+ * in progress did not finish within `timeout_ms`.
+ *
+ * This is only supported on Linux, and needs to be enclosed in
+ * `sentry__unwinder_threads_begin` and `sentry__unwinder_threads_end`.
+ */
+size_t sentry__unwind_thread(
+    long tid, void **ptrs, size_t max_frames, uint64_t timeout_ms);
+
+/**
+ * Returns the id of the calling thread, as used by `sentry__unwind_thread`, or
+ * 0 where that is not supported.
+ */
+long sentry__unwinder_current_tid(void);
+
+/**
+ * Reads the name of the thread `tid` into `name` without allocating, and
+ * returns it, or NULL if the name is not known.
+ *
+ * The names are cached after they have been read once, so that looking them
+ * up for every event is cheap. Names that are changed without going through
+ * `sentry__thread_setname` are not noticed until the cache is reset.
+ */
+const char *sentry__unwinder_thread_name(long tid, char name[16]);
+
+/**
+ * Caches `name` as the name of the thread `tid`, or of the calling thread if
+ * `tid` is 0. A NULL `name` drops the cached name, for example when the thread
+ * exits. Names are truncated to 15 characters, like the system does.
+ */
+void sentry__unwinder_cache_thread_name(long tid, const char *name);
+
+/**
+ * Drops the cached names of all the threads.
+ */
+void sentry__unwinder_reset_thread_names(void);
+
+/**
+ * Invokes `callback` for every thread of the process, until it returns false,
+ * and returns the number of threads visited. This does not allocate.
+ */
+size_t sentry__unwinder_foreach_thread(
+    bool (*callback)(long tid, void *data), void *data);
+
+#endif
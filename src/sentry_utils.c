@@ -267,6 +267,10 @@ sentry__dsn_new(const char *raw_dsn)
 
     if (dsn->public_key && dsn->host && dsn->path) {
         dsn->is_valid = true;
+        // the DSN is immutable, so the strings that every request uses are
+        // only built once
+        dsn->auth_header = sentry__dsn_get_auth_header(dsn);
+        dsn->envelope_url = sentry__dsn_get_envelope_url(dsn);
     }
 
 exit:
@@ -297,6 +301,8 @@ sentry__dsn_decref(sentry_dsn_t *dsn)
         sentry_free(dsn->public_key);
         sentry_free(dsn->secret_key);
         sentry_free(dsn->project_id);
+        sentry_free(dsn->auth_header);
+        sentry_free(dsn->envelope_url);
         sentry_free(dsn);
     }
 }
@@ -356,116 +362,164 @@ sentry__dsn_get_minidump_url(const sentry_dsn_t *dsn)
     return sentry__stringbuilder_into_string(&sb);
 }
 
-char *
-sentry__msec_time_to_iso8601(uint64_t time)
+/* "YYYY-MM-DDThh:mm:ss" */
+#define ISO8601_PREFIX_LEN 19
+/* 9999-12-31T23:59:59Z, the last second with a four digit year */
+#define ISO8601_MAX_SECS 253402300799ULL
+
+/**
+ * The date and time of the second that was formatted last on this thread, as
+ * consecutive timestamps mostly fall into the same second.
+ */
+static SENTRY_THREAD_LOCAL uint64_t g_iso8601_secs = UINT64_MAX;
+static SENTRY_THREAD_LOCAL char g_iso8601_prefix[ISO8601_PREFIX_LEN];
+
+static void
+write_digits(char *buf, uint32_t value, int digits)
 {
-    char buf[64];
-    size_t buf_len = sizeof(buf);
-    time_t secs = time / 1000;
-    struct tm *tm;
-#ifdef SENTRY_PLATFORM_WINDOWS
-    tm = gmtime(&secs);
-#else
-    struct tm tm_buf;
-    tm = gmtime_r(&secs, &tm_buf);
-#endif
-    // It might as well be that the `time` parameter is broken in some way and
-    // would create a broken `tm` that then later causes formatting issues. We
-    // have seen super strange timestamps in some event payloads.
-    if (!tm || tm->tm_year > 9000) {
-        return NULL;
+    while (digits--) {
+        buf[digits] = (char)('0' + value % 10);
+        value /= 10;
     }
-    size_t written = strftime(buf, buf_len, "%Y-%m-%dT%H:%M:%S", tm);
-    if (written == 0) {
+}
+
+/**
+ * Converts the number of days since epoch into a civil date, see
+ * http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+ */
+static void
+civil_from_days(uint64_t days, uint32_t *y, uint32_t *m, uint32_t *d)
+{
+    // shifted to 0000-03-01, which is never negative for times since epoch
+    uint64_t z = days + 719468;
+    uint64_t era = z / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (uint32_t)(era * 400) + yoe + (*m <= 2);
+}
+
+/**
+ * The inverse of `civil_from_days`, see
+ * http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ */
+static int64_t
+days_from_civil(uint32_t y, uint32_t m, uint32_t d)
+{
+    y -= m <= 2;
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + (int64_t)doe - 719468;
+}
+
+/**
+ * Formats `time_secs` since epoch, followed by the `fraction` of a second with
+ * `digits` decimal digits unless it is 0.
+ */
+static char *
+format_iso8601(uint64_t time_secs, uint32_t fraction, int digits)
+{
+    // It might as well be that the `time` parameter is broken in some way. We
+    // have seen super strange timestamps in some event payloads.
+    if (time_secs > ISO8601_MAX_SECS) {
         return NULL;
     }
+    char *prefix = g_iso8601_prefix;
+    if (g_iso8601_secs != time_secs) {
+        uint32_t y, m, d;
+        civil_from_days(time_secs / 86400, &y, &m, &d);
+        uint32_t secs_of_day = (uint32_t)(time_secs % 86400);
+        write_digits(prefix, y, 4);
+        prefix[4] = '-';
+        write_digits(prefix + 5, m, 2);
+        prefix[7] = '-';
+        write_digits(prefix + 8, d, 2);
+        prefix[10] = 'T';
+        write_digits(prefix + 11, secs_of_day / 3600, 2);
+        prefix[13] = ':';
+        write_digits(prefix + 14, secs_of_day / 60 % 60, 2);
+        prefix[16] = ':';
+        write_digits(prefix + 17, secs_of_day % 60, 2);
+        g_iso8601_secs = time_secs;
+    }
+
+    char buf[32];
+    size_t written = ISO8601_PREFIX_LEN;
+    memcpy(buf, prefix, written);
+    if (fraction) {
+        buf[written++] = '.';
+        write_digits(buf + written, fraction, digits);
+        written += (size_t)digits;
+    }
+    buf[written++] = 'Z';
+    return sentry__string_clonen(buf, written);
+}
 
-    int msecs = time % 1000;
-    if (msecs) {
-        size_t rv = (size_t)snprintf(
-            buf + written, buf_len - written, ".%03d", msecs);
-        if (rv >= buf_len - written) {
-            return NULL;
-        }
-        written += rv;
-    }
+char *
+sentry__msec_time_to_iso8601(uint64_t time)
+{
+    return format_iso8601(time / 1000, (uint32_t)(time % 1000), 3);
+}
 
-    if (written + 2 > buf_len) {
-        return NULL;
+char *
+sentry__usec_time_to_iso8601(uint64_t time)
+{
+    return format_iso8601(time / 1000000, (uint32_t)(time % 1000000), 6);
+}
+
+/**
+ * Parses the `digits` decimal digits at `s` into `*value`.
+ */
+static bool
+parse_digits(const char *s, int digits, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < digits; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        *value = *value * 10 + (uint32_t)(s[i] - '0');
     }
-    buf[written] = 'Z';
-    buf[written + 1] = '\0';
-    return sentry__string_clone(buf);
+    return true;
 }
 
 uint64_t
 sentry__iso8601_to_msec(const char *iso)
 {
-    size_t len = strlen(iso);
-    if (len != 20 && len != 24) {
+    uint32_t y, M, d, h, m, s, msec = 0;
+    if (!parse_digits(iso, 4, &y) || iso[4] != '-'
+        || !parse_digits(iso + 5, 2, &M) || iso[7] != '-'
+        || !parse_digits(iso + 8, 2, &d) || iso[10] != 'T'
+        || !parse_digits(iso + 11, 2, &h) || iso[13] != ':'
+        || !parse_digits(iso + 14, 2, &m) || iso[16] != ':'
+        || !parse_digits(iso + 17, 2, &s)) {
         return 0;
     }
-    // The code is adapted from: https://stackoverflow.com/a/26896792
-    int y, M, d, h, m, s, msec = 0;
-    int consumed = 0;
-    if (sscanf(iso, "%d-%d-%dT%d:%d:%d%n", &y, &M, &d, &h, &m, &s, &consumed)
-            < 6
-        || consumed != 19) {
-        return 0;
-    }
-    iso += consumed;
+    iso += ISO8601_PREFIX_LEN;
     // we optionally have millisecond precision
     if (iso[0] == '.') {
-        if (sscanf(iso, ".%d%n", &msec, &consumed) < 1 || consumed != 4) {
+        if (!parse_digits(iso + 1, 3, &msec)) {
             return 0;
         }
-        iso += consumed;
+        iso += 4;
     }
     // the string is terminated by `Z`
-    if (iso[0] != 'Z') {
+    if (iso[0] != 'Z' || iso[1] != '\0' || M < 1 || M > 12 || y < 1970) {
         return 0;
     }
 
-    struct tm tm;
-    tm.tm_year = y - 1900;
-    tm.tm_mon = M - 1;
-    tm.tm_mday = d;
-    tm.tm_hour = h;
-    tm.tm_min = m;
-    tm.tm_sec = s;
-#ifdef SENTRY_PLATFORM_WINDOWS
-    time_t time = _mkgmtime(&tm);
-#elif defined(SENTRY_PLATFORM_AIX)
-    /*
-     * timegm is a GNU extension that AIX doesn't support. We'll have to fake
-     * it by setting TZ instead w/ mktime, then unsets it. Changes global env.
-     */
-    time_t time;
-    char *tz_env;
-    tz_env = getenv("TZ");
-    if (tz_env) {
-        /* make a copy of it, since it'll change when we set it to UTC */
-        tz_env = strdup(tz_env);
-    }
-    setenv("TZ", "UTC", 1);
-    tzset();
-    time = mktime(&tm);
-    /* revert */
-    if (tz_env) {
-        setenv("TZ", tz_env, 1);
-        free(tz_env);
-    } else {
-        unsetenv("TZ");
-    }
-    tzset();
-#else
-    time_t time = timegm(&tm);
-#endif
-    if (time == -1) {
+    // like `timegm`, this carries over days, hours, etc. that are out of range
+    int64_t secs = (days_from_civil(y, M, 1) + (int64_t)d - 1) * 86400
+        + (int64_t)h * 3600 + (int64_t)m * 60 + (int64_t)s;
+    if (secs < 0) {
         return 0;
     }
-
-    return (uint64_t)time * 1000 + msec;
+    return (uint64_t)secs * 1000 + msec;
 }
 
 #ifdef SENTRY_PLATFORM_WINDOWS
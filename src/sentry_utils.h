@@ -50,6 +50,10 @@ typedef struct sentry_dsn_s {
     char *secret_key;
     char *public_key;
     char *project_id;
+    // the `X-Sentry-Auth` header and envelope endpoint url, which are computed
+    // once for valid DSNs, so that every request can borrow them
+    char *auth_header;
+    char *envelope_url;
     int port;
     long refcount;
     bool is_valid;
@@ -121,6 +125,30 @@ sentry__msec_time(void)
 #endif
 }
 
+/**
+ * Returns the number of microseconds since the unix epoch.
+ */
+static inline uint64_t
+sentry__usec_time(void)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    FILETIME file_time;
+    GetSystemTimeAsFileTime(&file_time);
+
+    uint64_t timestamp = (uint64_t)file_time.dwLowDateTime
+        + ((uint64_t)file_time.dwHighDateTime << 32);
+    timestamp -= 116444736000000000LL; // convert to unix epoch
+    timestamp /= 10LL; // 100ns -> 1us
+
+    return timestamp;
+#else
+    struct timeval tv;
+    return (gettimeofday(&tv, NULL) == 0)
+        ? (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec
+        : 0;
+#endif
+}
+
 /**
  * Returns a monotonic millisecond resolution time.
  *
@@ -176,11 +204,61 @@ sentry__monotonic_time(void)
 #endif
 }
 
+/**
+ * Returns a monotonic nanosecond resolution time.
+ *
+ * This should be used to measure durations, like those of spans, which are
+ * converted to timestamps relative to a base from `sentry__usec_time`.
+ */
+static inline uint64_t
+sentry__monotonic_time_ns(void)
+{
+#ifdef SENTRY_PLATFORM_WINDOWS
+    static LARGE_INTEGER qpc_frequency = { { 0, 0 } };
+
+    if (!qpc_frequency.QuadPart) {
+        QueryPerformanceFrequency(&qpc_frequency);
+    }
+    if (!qpc_frequency.QuadPart) {
+        return sentry__monotonic_time() * 1000000;
+    }
+
+    // this is split up so that multiplying the counter does not overflow
+    LARGE_INTEGER qpc_counter;
+    QueryPerformanceCounter(&qpc_counter);
+    uint64_t counter = (uint64_t)qpc_counter.QuadPart;
+    uint64_t frequency = (uint64_t)qpc_frequency.QuadPart;
+    return counter / frequency * 1000000000
+        + counter % frequency * 1000000000 / frequency;
+#elif defined(SENTRY_PLATFORM_DARWIN)
+#    if defined(MAC_OS_X_VERSION_10_12) && __has_builtin(__builtin_available)
+    if (__builtin_available(macOS 10.12, *)) {
+        struct timespec tv;
+        return (clock_gettime(CLOCK_MONOTONIC, &tv) == 0)
+            ? (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_nsec
+            : 0;
+    }
+#    endif
+    return sentry__monotonic_time() * 1000000;
+#else
+    struct timespec tv;
+    return (clock_gettime(CLOCK_MONOTONIC, &tv) == 0)
+        ? (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_nsec
+        : 0;
+#endif
+}
+
 /**
  * Formats a timestamp (milliseconds since epoch) into ISO8601 format.
  */
 char *sentry__msec_time_to_iso8601(uint64_t time);
 
+/**
+ * Formats a timestamp (microseconds since epoch) into ISO8601 format, with
+ * up to microsecond precision.
+ */
+char *sentry__usec_time_to_iso8601(uint64_t time);
+
 /**
  * Parses a ISO8601 formatted string into a millisecond resolution timestamp.
  * This only accepts the format `YYYY-MM-DD'T'hh:mm:ss(.zzz)'Z'`, which is
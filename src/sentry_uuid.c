@@ -102,25 +102,58 @@ sentry_uuid_as_string(const sentry_uuid_t *uuid, char str[37])
 #undef B
 }
 
+void
+sentry__uuid_to_hex(const sentry_uuid_t *uuid, size_t byte_count, char *str)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < byte_count && i < 16; i++) {
+        unsigned char byte = (unsigned char)uuid->bytes[i];
+        str[i * 2] = digits[byte >> 4];
+        str[i * 2 + 1] = digits[byte & 0xf];
+    }
+}
+
+static int
+hex_digit_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return 10 + (c - 'a');
+    } else if (c >= 'A' && c <= 'F') {
+        return 10 + (c - 'A');
+    }
+    return -1;
+}
+
+bool
+sentry__uuid_from_hex(sentry_uuid_t *uuid, const char *str, size_t byte_count)
+{
+    memset(uuid->bytes, 0, 16);
+    for (size_t i = 0; i < byte_count && i < 16; i++) {
+        int high = hex_digit_value(str[i * 2]);
+        // this stops at a null byte, so `str` is never read past its end
+        int low = high < 0 ? -1 : hex_digit_value(str[i * 2 + 1]);
+        if (low < 0) {
+            return false;
+        }
+        uuid->bytes[i] = (char)((high << 4) | low);
+    }
+    return byte_count <= 16;
+}
+
 void
 sentry__internal_uuid_as_string(const sentry_uuid_t *uuid, char str[37])
 {
-#define B(X) (unsigned char)uuid->bytes[X]
-    snprintf(str, 33,
-        "%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%"
-        "02hhx%02hhx%02hhx%02hhx%02hhx%02hhx",
-        B(0), B(1), B(2), B(3), B(4), B(5), B(6), B(7), B(8), B(9), B(10),
-        B(11), B(12), B(13), B(14), B(15));
-#undef B
+    sentry__uuid_to_hex(uuid, 16, str);
+    str[32] = '\0';
 }
 
 void
 sentry__span_uuid_as_string(const sentry_uuid_t *uuid, char str[17])
 {
-#define B(X) (unsigned char)uuid->bytes[X]
-    snprintf(str, 17, "%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx", B(0),
-        B(1), B(2), B(3), B(4), B(5), B(6), B(7));
-#undef B
+    sentry__uuid_to_hex(uuid, 8, str);
+    str[16] = '\0';
 }
 
 #ifdef SENTRY_PLATFORM_WINDOWS
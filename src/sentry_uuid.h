@@ -13,6 +13,21 @@ void sentry__internal_uuid_as_string(const sentry_uuid_t *uuid, char str[37]);
  * Converts a sentry UUID to a string representation used for span IDs.
  */
 void sentry__span_uuid_as_string(const sentry_uuid_t *uuid, char str[17]);
+
+/**
+ * Writes the first `byte_count` bytes of `uuid` as `2 * byte_count` lowercase
+ * hex digits to `str`, without a terminating null byte.
+ */
+void sentry__uuid_to_hex(
+    const sentry_uuid_t *uuid, size_t byte_count, char *str);
+
+/**
+ * Parses exactly `2 * byte_count` hex digits at `str` into the first
+ * `byte_count` bytes of `uuid`, and zeroes the rest of it.
+ * Returns false if any of them is not a hex digit.
+ */
+bool sentry__uuid_from_hex(
+    sentry_uuid_t *uuid, const char *str, size_t byte_count);
 #endif
 
 #ifdef SENTRY_PLATFORM_WINDOWS
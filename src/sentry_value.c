@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
@@ -20,13 +22,23 @@
 
 #include "sentry_alloc.h"
 #include "sentry_core.h"
+#include "sentry_dtoa.h"
 #include "sentry_json.h"
 #include "sentry_string.h"
+#include "sentry_symbolizer.h"
 #include "sentry_sync.h"
+#include "sentry_unwinder.h"
 #include "sentry_utils.h"
 #include "sentry_uuid.h"
 #include "sentry_value.h"
 
+#ifdef SENTRY_PLATFORM_UNIX
+#    include "sentry_unix_pageallocator.h"
+#endif
+#ifdef SENTRY_WITH_VALUE_SLABS
+#    include "sentry_slab.h"
+#endif
+
 /**
  * Pointer Tagging of `sentry_value_t`
  *
@@ -54,24 +66,116 @@
 #define CONST_TRUE 0x6
 #define CONST_NULL 0xa
 
-#define THING_TYPE_MASK 0x7f
+#define THING_TYPE_MASK 0x3f
+#define THING_TYPE_ARENA 0x40
 #define THING_TYPE_FROZEN 0x80
 #define THING_TYPE_LIST 0
 #define THING_TYPE_OBJECT 1
 #define THING_TYPE_STRING 2
 #define THING_TYPE_DOUBLE 3
+#define THING_TYPE_INT64 4
+#define THING_TYPE_UINT64 5
+#define THING_TYPE_ADDR 6
+#define THING_TYPE_UUID 7
 
 /* internal value helpers */
 
+/**
+ * The payload of lists, objects and copied strings is stored inline, directly
+ * following the `thing_t` in the same allocation, in which case `_ptr` points
+ * just past the thing. Strings also cache their byte length in `len`, unless
+ * it does not fit, in which case it is `THING_LEN_UNKNOWN`.
+ *
+ * Addresses are stored as a plain `_u64`, but are exposed as hex strings for
+ * compatibility. Their length is known upfront and kept in `len`, but the
+ * string is only formatted into an inline buffer when it is first read, see
+ * `addr_payload_t`. The serializers never need it, and format into a buffer
+ * on the stack instead. UUIDs work the same way, with their raw bytes and the
+ * form they are rendered in stored inline, see `uuid_payload_t`.
+ */
 typedef struct {
     union {
         void *_ptr;
         double _double;
+        int64_t _i64;
+        uint64_t _u64;
     } payload;
     long refcount;
     uint8_t type;
+    uint32_t len;
 } thing_t;
 
+#define THING_LEN_UNKNOWN UINT32_MAX
+/* "0x" + 16 hex digits + NUL */
+#define ADDR_BUF_SIZE 19
+/* 32 hex digits + 4 dashes + NUL */
+#define UUID_BUF_SIZE 37
+
+typedef enum {
+    UUID_FORM_DEFAULT,
+    UUID_FORM_INTERNAL,
+    UUID_FORM_SPAN,
+} uuid_form_t;
+
+/**
+ * The states of the inline string of an address or UUID thing. Since those
+ * are frozen and shared between threads, the first reader claims the string
+ * and formats it, and publishes it once it is complete.
+ */
+#define LAZY_STR_UNFORMATTED 0
+#define LAZY_STR_FORMATTING 1
+#define LAZY_STR_FORMATTED 2
+
+typedef struct {
+    volatile long str_state;
+    char str[ADDR_BUF_SIZE];
+} addr_payload_t;
+
+typedef struct {
+    sentry_uuid_t uuid;
+    uint8_t form;
+    volatile long str_state;
+    char str[UUID_BUF_SIZE];
+} uuid_payload_t;
+
+/**
+ * Value Arenas
+ *
+ * While an arena is entered on the current thread, all the values created on
+ * that thread are bump-allocated from it, including their container storage
+ * and string payloads. Such things are flagged with `THING_TYPE_ARENA` and are
+ * prefixed by a pointer to their arena, so any later growth of a container is
+ * served from the same arena.
+ *
+ * Every arena thing holds a reference to its arena, and the arena memory is
+ * released in one go once the last of its things has been freed, which means
+ * values escaping the tree they were built for are still safe to use.
+ * An arena is meant for a value tree that is built up by a single thread at a
+ * time, but escaped containers may still grow from other threads, so the
+ * allocations of an arena are serialized by its spinlock.
+ */
+#define ARENA_CHUNK_SIZE 8192
+#define ARENA_ALIGN 8
+
+typedef struct arena_chunk_s {
+    struct arena_chunk_s *next;
+} arena_chunk_t;
+
+struct sentry_value_arena_s {
+    long refcount;
+    volatile long lock;
+    arena_chunk_t *chunks;
+    char *pos;
+    size_t remaining;
+};
+
+typedef struct {
+    sentry_value_arena_t *arena;
+    thing_t thing;
+} arena_thing_t;
+
+static SENTRY_THREAD_LOCAL sentry_value_arena_t *g_current_arena = NULL;
+
 typedef struct {
     sentry_value_t *items;
     size_t len;
@@ -80,15 +184,40 @@ typedef struct {
 
 typedef struct {
     char *k;
+    size_t k_len;
     sentry_value_t v;
 } obj_pair_t;
 
+/**
+ * Objects keep their pairs in a flat array, which is compact and fast enough
+ * for the small objects that make up most of an event. Once an object grows
+ * past `OBJ_INDEX_THRESHOLD` pairs, an open-addressing hash index is built
+ * on top of the array, which maps keys to the position of their pair.
+ * Slots hold `position + 1`, so a `0` slot is empty.
+ */
+#define OBJ_INDEX_THRESHOLD 16
+
 typedef struct {
     obj_pair_t *pairs;
     size_t len;
     size_t allocated;
+    size_t *index;
+    size_t index_allocated;
 } obj_t;
 
+#define INTERNED_KEY_INIT(Name) #Name,
+const struct sentry_interned_keys_s sentry__interned_keys
+    = { SENTRY_INTERNED_KEYS(INTERNED_KEY_INIT) };
+#undef INTERNED_KEY_INIT
+
+static bool
+key_is_interned(const char *k)
+{
+    uintptr_t start = (uintptr_t)&sentry__interned_keys;
+    return (uintptr_t)k >= start
+        && (uintptr_t)k < start + sizeof(sentry__interned_keys);
+}
+
 static const char *
 level_as_string(sentry_level_t level)
 {
@@ -107,308 +236,926 @@ level_as_string(sentry_level_t level)
     }
 }
 
-static bool
-reserve(void **buf, size_t item_size, size_t *allocated, size_t min_len)
+sentry_value_arena_t *
+sentry__value_arena_new(void)
 {
-    if (*allocated >= min_len) {
-        return true;
-    }
-    size_t new_allocated = *allocated;
-    if (new_allocated == 0) {
-        new_allocated = 16;
+#ifdef SENTRY_PLATFORM_UNIX
+    // a crash is only handled once, so an arena would only add overhead
+    if (sentry__page_allocator_enabled()) {
+        return NULL;
     }
-    while (new_allocated < min_len) {
-        new_allocated *= 2;
+#endif
+    sentry_value_arena_t *arena = SENTRY_MAKE(sentry_value_arena_t);
+    if (!arena) {
+        return NULL;
     }
+    memset(arena, 0, sizeof(sentry_value_arena_t));
+    arena->refcount = 1;
+    return arena;
+}
 
-    void *new_buf = sentry_malloc(new_allocated * item_size);
-    if (!new_buf) {
-        return false;
+void
+sentry__value_arena_decref(sentry_value_arena_t *arena)
+{
+    if (!arena || sentry__atomic_fetch_and_add(&arena->refcount, -1) != 1) {
+        return;
     }
-
-    if (*buf) {
-        memcpy(new_buf, *buf, *allocated * item_size);
-        sentry_free(*buf);
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        sentry_free(chunk);
+        chunk = next;
     }
-    *buf = new_buf;
-    *allocated = new_allocated;
-    return true;
+    sentry_free(arena);
 }
 
-static int
-thing_get_type(const thing_t *thing)
+sentry_value_arena_t *
+sentry__value_arena_enter(sentry_value_arena_t *arena)
 {
-    return thing->type & (uint8_t)THING_TYPE_MASK;
+    sentry_value_arena_t *previous = g_current_arena;
+    g_current_arena = arena;
+    return previous;
+}
+
+void
+sentry__value_arena_leave(sentry_value_arena_t *previous)
+{
+    g_current_arena = previous;
 }
 
 static void
-thing_free(thing_t *thing)
+arena_lock(sentry_value_arena_t *arena)
 {
-    switch (thing_get_type(thing)) {
-    case THING_TYPE_LIST: {
-        list_t *list = thing->payload._ptr;
-        for (size_t i = 0; i < list->len; i++) {
-            sentry_value_decref(list->items[i]);
-        }
-        sentry_free(list->items);
-        sentry_free(list);
-        break;
-    }
-    case THING_TYPE_OBJECT: {
-        obj_t *obj = thing->payload._ptr;
-        for (size_t i = 0; i < obj->len; i++) {
-            sentry_free(obj->pairs[i].k);
-            sentry_value_decref(obj->pairs[i].v);
-        }
-        sentry_free(obj->pairs);
-        sentry_free(obj);
-        break;
+    while (!sentry__atomic_compare_swap(&arena->lock, 0, 1)) {
+        // the lock is only held for a few instructions
     }
-    case THING_TYPE_STRING: {
-        sentry_free(thing->payload._ptr);
-        break;
-    }
-    }
-    sentry_free(thing);
 }
 
-static int
-thing_is_frozen(const thing_t *thing)
+static void
+arena_unlock(sentry_value_arena_t *arena)
 {
-    return (thing->type >> 7) != 0;
+    sentry__atomic_store(&arena->lock, 0);
 }
 
-static void
-thing_freeze(thing_t *thing)
+static void *
+arena_alloc(sentry_value_arena_t *arena, size_t size)
 {
-    if (thing_is_frozen(thing)) {
-        return;
-    }
-    thing->type |= 0x80;
-    switch (thing_get_type(thing)) {
-    case THING_TYPE_LIST: {
-        const list_t *l = thing->payload._ptr;
-        for (size_t i = 0; i < l->len; i++) {
-            sentry_value_freeze(l->items[i]);
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_lock(arena);
+    if (size > arena->remaining) {
+        // the chunk header is padded so that allocations stay aligned
+        size_t header_size = (sizeof(arena_chunk_t) + ARENA_ALIGN - 1)
+            & ~(size_t)(ARENA_ALIGN - 1);
+        size_t chunk_size = header_size + size;
+        if (chunk_size < ARENA_CHUNK_SIZE) {
+            chunk_size = ARENA_CHUNK_SIZE;
         }
-        break;
-    }
-    case THING_TYPE_OBJECT: {
-        const obj_t *o = thing->payload._ptr;
-        for (size_t i = 0; i < o->len; i++) {
-            sentry_value_freeze(o->pairs[i].v);
+        arena_chunk_t *chunk = sentry__malloc_default_tag(
+            chunk_size, SENTRY_MEMORY_TAG_VALUE);
+        if (!chunk) {
+            arena_unlock(arena);
+            return NULL;
         }
-        break;
-    }
-    default:;
-    }
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->pos = (char *)chunk + header_size;
+        arena->remaining = chunk_size - header_size;
+    }
+    void *rv = arena->pos;
+    arena->pos += size;
+    arena->remaining -= size;
+    arena_unlock(arena);
+    return rv;
 }
 
-static sentry_value_t
-new_thing_value(void *ptr, uint8_t thing_type)
+/**
+ * Grows the allocation at `ptr` from `old_size` to `new_size` bytes in place,
+ * which works if it is the last allocation of the current chunk, and the chunk
+ * has enough room left. Containers that are appended to while being built are
+ * usually the last allocation, unless their items were created in the arena
+ * in between.
+ */
+static bool
+arena_grow(
+    sentry_value_arena_t *arena, void *ptr, size_t old_size, size_t new_size)
 {
-    thing_t *thing = sentry_malloc(sizeof(thing_t));
-    if (!thing) {
-        return sentry_value_new_null();
+    uintptr_t mask = ~(uintptr_t)(ARENA_ALIGN - 1);
+    uintptr_t end = ((uintptr_t)ptr + old_size + ARENA_ALIGN - 1) & mask;
+    uintptr_t new_end = ((uintptr_t)ptr + new_size + ARENA_ALIGN - 1) & mask;
+    arena_lock(arena);
+    bool grown = end == (uintptr_t)arena->pos
+        && new_end - end <= arena->remaining;
+    if (grown) {
+        arena->pos += new_end - end;
+        arena->remaining -= new_end - end;
     }
-    thing->payload._ptr = ptr;
-    thing->refcount = 1;
-    thing->type = thing_type;
-
-    sentry_value_t rv;
-    rv._bits = (uint64_t)(size_t)thing;
-    return rv;
+    arena_unlock(arena);
+    return grown;
 }
 
-static thing_t *
-value_as_thing(sentry_value_t value)
+/**
+ * Allocates the memory of values outside of arenas, which comes from the
+ * thread-local slabs if they are built in.
+ */
+static void *
+heap_alloc(size_t size)
 {
-    if (value._bits & TAG_MASK) {
-        return NULL;
-    }
-    return (thing_t *)(size_t)value._bits;
+#ifdef SENTRY_WITH_VALUE_SLABS
+    return sentry__slab_alloc(size);
+#else
+    return sentry__malloc_default_tag(size, SENTRY_MEMORY_TAG_VALUE);
+#endif
 }
 
-static thing_t *
-value_as_unfrozen_thing(sentry_value_t value)
+static void
+heap_free(void *ptr)
 {
-    thing_t *thing = value_as_thing(value);
-    return thing && !thing_is_frozen(thing) ? thing : NULL;
+#ifdef SENTRY_WITH_VALUE_SLABS
+    sentry__slab_free(ptr);
+#else
+    sentry_free(ptr);
+#endif
 }
 
-/* public api implementations */
+static void *
+value_alloc(sentry_value_arena_t *arena, size_t size)
+{
+    return arena ? arena_alloc(arena, size) : heap_alloc(size);
+}
 
-void
-sentry_value_incref(sentry_value_t value)
+static void
+value_dealloc(sentry_value_arena_t *arena, void *ptr)
 {
-    thing_t *thing = value_as_thing(value);
-    if (thing) {
-        sentry__atomic_fetch_and_add(&thing->refcount, 1);
+    if (!arena) {
+        heap_free(ptr);
     }
 }
 
-void
-sentry_value_decref(sentry_value_t value)
+static char *
+value_string_clonen(sentry_value_arena_t *arena, const char *str, size_t n)
 {
-    thing_t *thing = value_as_thing(value);
-    if (thing && sentry__atomic_fetch_and_add(&thing->refcount, -1) == 1) {
-        thing_free(thing);
+    char *rv = value_alloc(arena, n + 1);
+    if (rv) {
+        memcpy(rv, str, n);
+        rv[n] = 0;
     }
+    return rv;
 }
 
-size_t
-sentry_value_refcount(sentry_value_t value)
+/**
+ * Object keys are copied, unless they are interned, in which case the pair
+ * references the static key directly.
+ */
+static char *
+key_clone(sentry_value_arena_t *arena, const char *k, size_t k_len)
 {
-    thing_t *thing = value_as_thing(value);
-    return thing ? (size_t)sentry__atomic_fetch(&thing->refcount) : 1;
+    return key_is_interned(k) && strlen(k) == k_len
+        ? (char *)k
+        : value_string_clonen(arena, k, k_len);
 }
 
-void
-sentry_value_freeze(sentry_value_t value)
+static void
+key_free(sentry_value_arena_t *arena, char *k)
 {
-    thing_t *thing = value_as_thing(value);
-    if (thing) {
-        thing_freeze(thing);
+    if (!key_is_interned(k)) {
+        value_dealloc(arena, k);
     }
 }
 
-int
-sentry_value_is_frozen(sentry_value_t value)
+/**
+ * Grows `*buf` to hold at least `min_len` items. `inline_buf` is the storage
+ * that was allocated together with the container, which is never freed.
+ */
+static bool
+reserve(sentry_value_arena_t *arena, void **buf, const void *inline_buf,
+    size_t item_size, size_t *allocated, size_t min_len)
 {
-    const thing_t *thing = value_as_thing(value);
-    return thing ? thing_is_frozen(thing) : true;
+    if (*allocated >= min_len) {
+        return true;
+    }
+    size_t new_allocated = *allocated;
+    if (new_allocated == 0) {
+        new_allocated = 16;
+    }
+    while (new_allocated < min_len) {
+        new_allocated *= 2;
+    }
+
+    if (arena && *buf
+        && arena_grow(
+            arena, *buf, *allocated * item_size, new_allocated * item_size)) {
+        *allocated = new_allocated;
+        return true;
+    }
+
+    void *new_buf = value_alloc(arena, new_allocated * item_size);
+    if (!new_buf) {
+        return false;
+    }
+
+    if (*buf) {
+        memcpy(new_buf, *buf, *allocated * item_size);
+        if (*buf != inline_buf) {
+            value_dealloc(arena, *buf);
+        }
+    }
+    *buf = new_buf;
+    *allocated = new_allocated;
+    return true;
 }
 
-sentry_value_t
-sentry_value_new_null(void)
+/**
+ * Shrinks a separately allocated `*buf` to hold exactly `len` items, so that
+ * containers which are frozen to be kept around, like the scope or the module
+ * cache, do not hold on to the slack of their growth. Arena memory can not be
+ * given back, so arena containers are left alone.
+ */
+static void
+shrink_to_fit(sentry_value_arena_t *arena, void **buf, const void *inline_buf,
+    size_t item_size, size_t *allocated, size_t len)
 {
-    sentry_value_t rv;
-    rv._bits = (uint64_t)CONST_NULL;
-    return rv;
+    if (arena || *buf == inline_buf || *allocated == len) {
+        return;
+    }
+    void *new_buf = NULL;
+    if (len) {
+        new_buf = heap_alloc(len * item_size);
+        if (!new_buf) {
+            return;
+        }
+        memcpy(new_buf, *buf, len * item_size);
+    }
+    heap_free(*buf);
+    *buf = new_buf;
+    *allocated = len;
 }
 
-sentry_value_t
-sentry_value_new_int32(int32_t value)
+static void *
+list_inline_items(const list_t *l)
 {
-    sentry_value_t rv;
-    rv._bits = ((uint64_t)(uint32_t)value) << 32 | TAG_INT32;
-    return rv;
+    return (char *)l + sizeof(list_t);
 }
 
-sentry_value_t
-sentry_value_new_double(double value)
+static void *
+obj_inline_pairs(const obj_t *o)
 {
-    thing_t *thing = sentry_malloc(sizeof(thing_t));
-    if (!thing) {
-        return sentry_value_new_null();
-    }
-    thing->payload._double = value;
-    thing->refcount = 1;
-    thing->type = (uint8_t)(THING_TYPE_DOUBLE | THING_TYPE_FROZEN);
+    return (char *)o + sizeof(obj_t);
+}
 
-    sentry_value_t rv;
-    rv._bits = (uint64_t)(size_t)thing;
-    return rv;
+static size_t
+obj_hash_key(const char *k, size_t k_len)
+{
+    // FNV-1a
+    size_t hash = (size_t)2166136261u;
+    for (size_t i = 0; i < k_len; i++) {
+        hash ^= (unsigned char)k[i];
+        hash *= (size_t)16777619u;
+    }
+    return hash;
 }
 
-sentry_value_t
-sentry_value_new_bool(int value)
+static bool
+obj_pair_has_key(const obj_pair_t *pair, const char *k, size_t k_len)
 {
-    sentry_value_t rv;
-    rv._bits = (uint64_t)(value ? CONST_TRUE : CONST_FALSE);
-    return rv;
+    return pair->k_len == k_len
+        && (pair->k == k || memcmp(pair->k, k, k_len) == 0);
 }
 
-sentry_value_t
-sentry_value_new_string(const char *value)
+static void
+obj_index_insert(obj_t *o, size_t hash, size_t pos)
 {
-    char *s = sentry__string_clone(value);
-    if (!s) {
-        return sentry_value_new_null();
+    size_t mask = o->index_allocated - 1;
+    size_t slot = hash & mask;
+    while (o->index[slot]) {
+        slot = (slot + 1) & mask;
     }
-    return sentry__value_new_string_owned(s);
+    o->index[slot] = pos + 1;
 }
 
-sentry_value_t
-sentry_value_new_list(void)
+/**
+ * (Re-)builds the hash index of `o`, sized so that it stays at most half
+ * full. Objects below the threshold drop their index. On allocation failure
+ * the object silently falls back to linear lookups.
+ */
+static void
+obj_index_rebuild(obj_t *o)
 {
-    list_t *l = SENTRY_MAKE(list_t);
-    if (l) {
-        memset(l, 0, sizeof(list_t));
-        sentry_value_t rv = new_thing_value(l, THING_TYPE_LIST);
-        if (sentry_value_is_null(rv)) {
-            sentry_free(l);
+    if (o->len < OBJ_INDEX_THRESHOLD) {
+        sentry_free(o->index);
+        o->index = NULL;
+        o->index_allocated = 0;
+        return;
+    }
+
+    size_t new_allocated = OBJ_INDEX_THRESHOLD * 2;
+    while (new_allocated < o->len * 2) {
+        new_allocated *= 2;
+    }
+    if (new_allocated != o->index_allocated) {
+        size_t *new_index = sentry__malloc_default_tag(
+            new_allocated * sizeof(size_t), SENTRY_MEMORY_TAG_VALUE);
+        sentry_free(o->index);
+        o->index = new_index;
+        o->index_allocated = new_index ? new_allocated : 0;
+        if (!new_index) {
+            return;
         }
-        return rv;
-    } else {
-        return sentry_value_new_null();
+    }
+    memset(o->index, 0, o->index_allocated * sizeof(size_t));
+    for (size_t i = 0; i < o->len; i++) {
+        obj_index_insert(
+            o, obj_hash_key(o->pairs[i].k, o->pairs[i].k_len), i);
     }
 }
 
-sentry_value_t
-sentry__value_new_list_with_size(size_t size)
-{
-    list_t *l = SENTRY_MAKE(list_t);
-    if (l) {
-        memset(l, 0, sizeof(list_t));
-        l->allocated = size;
-        if (size) {
-            l->items = sentry_malloc(sizeof(sentry_value_t) * size);
-            if (!l->items) {
-                sentry_free(l);
-                return sentry_value_new_null();
+/**
+ * Returns the position of the pair with the `k_len` bytes long key `k`, or
+ * `o->len` if there is no such pair.
+ */
+static size_t
+obj_find(const obj_t *o, const char *k, size_t k_len)
+{
+    if (o->index) {
+        size_t mask = o->index_allocated - 1;
+        size_t slot = obj_hash_key(k, k_len) & mask;
+        size_t pos;
+        while ((pos = o->index[slot]) != 0) {
+            if (obj_pair_has_key(&o->pairs[pos - 1], k, k_len)) {
+                return pos - 1;
             }
+            slot = (slot + 1) & mask;
         }
-        sentry_value_t rv = new_thing_value(l, THING_TYPE_LIST);
-        if (sentry_value_is_null(rv)) {
-            sentry_free(l->items);
-            sentry_free(l);
+        return o->len;
+    }
+    for (size_t i = 0; i < o->len; i++) {
+        if (obj_pair_has_key(&o->pairs[i], k, k_len)) {
+            return i;
         }
-        return rv;
+    }
+    return o->len;
+}
+
+static int
+thing_get_type(const thing_t *thing)
+{
+    return thing->type & (uint8_t)THING_TYPE_MASK;
+}
+
+static sentry_value_arena_t *
+thing_get_arena(const thing_t *thing)
+{
+    if (!(thing->type & THING_TYPE_ARENA)) {
+        return NULL;
+    }
+    return ((const arena_thing_t *)(const void *)((const char *)thing
+                - offsetof(arena_thing_t, thing)))
+        ->arena;
+}
+
+/**
+ * Allocates a new thing with `extra` bytes of trailing storage for its payload,
+ * from the current arena if there is one, or otherwise from the heap.
+ */
+static thing_t *
+thing_new(size_t extra, uint8_t thing_type)
+{
+    sentry_value_arena_t *arena = g_current_arena;
+    thing_t *thing;
+    if (arena) {
+        arena_thing_t *at = arena_alloc(arena, sizeof(arena_thing_t) + extra);
+        if (!at) {
+            return NULL;
+        }
+        sentry__atomic_fetch_and_add(&arena->refcount, 1);
+        at->arena = arena;
+        thing = &at->thing;
+        thing_type |= THING_TYPE_ARENA;
     } else {
-        return sentry_value_new_null();
+        thing = heap_alloc(sizeof(thing_t) + extra);
+        if (!thing) {
+            return NULL;
+        }
     }
+    thing->payload._ptr = NULL;
+    thing->refcount = 1;
+    thing->type = thing_type;
+    thing->len = 0;
+    return thing;
 }
 
-sentry_value_t
-sentry_value_new_object(void)
+static void *
+thing_get_extra(const thing_t *thing)
+{
+    return (char *)thing + sizeof(thing_t);
+}
+
+/**
+ * Frees a separately allocated payload of `thing`. Only strings created with
+ * `sentry__value_new_string_owned` have one, which was allocated with
+ * `sentry_malloc` by the caller.
+ */
+static void
+thing_free_payload(thing_t *thing)
+{
+    if (thing->payload._ptr != thing_get_extra(thing)) {
+        sentry_free(thing->payload._ptr);
+    }
+}
+
+static size_t
+thing_string_len(const thing_t *thing)
+{
+    return thing->len != THING_LEN_UNKNOWN
+        ? thing->len
+        : strlen((const char *)thing->payload._ptr);
+}
+
+static void
+thing_set_string_len(thing_t *thing, size_t len)
+{
+    thing->len
+        = len < (size_t)THING_LEN_UNKNOWN ? (uint32_t)len : THING_LEN_UNKNOWN;
+}
+
+/**
+ * Formats `addr` as a `0x` prefixed lower-case hex number into `buf`, which
+ * needs to hold at least `ADDR_BUF_SIZE` bytes, and returns its length.
+ */
+static size_t
+format_addr(char *buf, uint64_t addr)
+{
+    static const char hex[] = "0123456789abcdef";
+    char digits[16];
+    size_t n = 0;
+    do {
+        digits[n++] = hex[addr & 0xf];
+        addr >>= 4;
+    } while (addr);
+
+    size_t len = 0;
+    buf[len++] = '0';
+    buf[len++] = 'x';
+    while (n) {
+        buf[len++] = digits[--n];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static size_t
+addr_len(uint64_t addr)
+{
+    size_t len = 3;
+    while (addr >>= 4) {
+        len++;
+    }
+    return len;
+}
+
+/**
+ * Returns true if the caller claimed the lazy string of `str_state`, and needs
+ * to format and publish it via `lazy_str_publish`, or false if it is already
+ * formatted.
+ */
+static bool
+lazy_str_claim(volatile long *str_state)
 {
-    obj_t *o = SENTRY_MAKE(obj_t);
-    if (o) {
-        memset(o, 0, sizeof(obj_t));
-        sentry_value_t rv = new_thing_value(o, THING_TYPE_OBJECT);
-        if (sentry_value_is_null(rv)) {
-            sentry_free(o);
+    for (;;) {
+        long state = sentry__atomic_fetch(str_state);
+        if (state == LAZY_STR_FORMATTED) {
+            return false;
         }
-        return rv;
+        if (state == LAZY_STR_UNFORMATTED
+            && sentry__atomic_compare_swap(
+                str_state, LAZY_STR_UNFORMATTED, LAZY_STR_FORMATTING)) {
+            return true;
+        }
+        // another reader is formatting it, which only takes a few
+        // instructions
+    }
+}
+
+static void
+lazy_str_publish(volatile long *str_state)
+{
+    sentry__atomic_store(str_state, LAZY_STR_FORMATTED);
+}
+
+/**
+ * Returns the hex string of an address thing, of length `len`, formatting it
+ * on first use.
+ */
+static const char *
+thing_addr_string(const thing_t *thing)
+{
+    addr_payload_t *payload = thing_get_extra(thing);
+    if (lazy_str_claim(&payload->str_state)) {
+        format_addr(payload->str, thing->payload._u64);
+        lazy_str_publish(&payload->str_state);
+    }
+    return payload->str;
+}
+
+/**
+ * Formats the UUID of `payload` in its form into `buf`, which needs to hold at
+ * least `UUID_BUF_SIZE` bytes, and returns its length.
+ */
+static size_t
+format_uuid(char *buf, const uuid_payload_t *payload)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t byte_count = payload->form == UUID_FORM_SPAN ? 8 : 16;
+    bool has_dashes = payload->form == UUID_FORM_DEFAULT;
+    size_t len = 0;
+    for (size_t i = 0; i < byte_count; i++) {
+        if (has_dashes && (i == 4 || i == 6 || i == 8 || i == 10)) {
+            buf[len++] = '-';
+        }
+        unsigned char byte = (unsigned char)payload->uuid.bytes[i];
+        buf[len++] = hex[byte >> 4];
+        buf[len++] = hex[byte & 0xf];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static size_t
+uuid_len(uuid_form_t form)
+{
+    switch (form) {
+    case UUID_FORM_SPAN:
+        return 16;
+    case UUID_FORM_INTERNAL:
+        return 32;
+    case UUID_FORM_DEFAULT:
+    default:
+        return 36;
+    }
+}
+
+/**
+ * Returns the string of a UUID thing, of length `len`, formatting it on first
+ * use, just like `thing_addr_string`.
+ */
+static const char *
+thing_uuid_string(const thing_t *thing)
+{
+    uuid_payload_t *payload = thing->payload._ptr;
+    if (lazy_str_claim(&payload->str_state)) {
+        format_uuid(payload->str, payload);
+        lazy_str_publish(&payload->str_state);
+    }
+    return payload->str;
+}
+
+static void
+thing_free(thing_t *thing)
+{
+    sentry_value_arena_t *arena = thing_get_arena(thing);
+    switch (thing_get_type(thing)) {
+    case THING_TYPE_LIST: {
+        list_t *list = thing->payload._ptr;
+        for (size_t i = 0; i < list->len; i++) {
+            sentry_value_decref(list->items[i]);
+        }
+        if (list->items != list_inline_items(list)) {
+            value_dealloc(arena, list->items);
+        }
+        thing_free_payload(thing);
+        break;
+    }
+    case THING_TYPE_OBJECT: {
+        obj_t *obj = thing->payload._ptr;
+        for (size_t i = 0; i < obj->len; i++) {
+            key_free(arena, obj->pairs[i].k);
+            sentry_value_decref(obj->pairs[i].v);
+        }
+        if (obj->pairs != obj_inline_pairs(obj)) {
+            value_dealloc(arena, obj->pairs);
+        }
+        sentry_free(obj->index);
+        thing_free_payload(thing);
+        break;
+    }
+    case THING_TYPE_STRING: {
+        thing_free_payload(thing);
+        break;
+    }
+    }
+    if (arena) {
+        sentry__value_arena_decref(arena);
     } else {
+        heap_free(thing);
+    }
+}
+
+static int
+thing_is_frozen(const thing_t *thing)
+{
+    return (thing->type >> 7) != 0;
+}
+
+static void
+thing_freeze(thing_t *thing)
+{
+    if (thing_is_frozen(thing)) {
+        return;
+    }
+    thing->type |= 0x80;
+    switch (thing_get_type(thing)) {
+    case THING_TYPE_LIST: {
+        list_t *l = thing->payload._ptr;
+        shrink_to_fit(thing_get_arena(thing), (void **)&l->items,
+            list_inline_items(l), sizeof(l->items[0]), &l->allocated, l->len);
+        for (size_t i = 0; i < l->len; i++) {
+            sentry_value_freeze(l->items[i]);
+        }
+        break;
+    }
+    case THING_TYPE_OBJECT: {
+        obj_t *o = thing->payload._ptr;
+        shrink_to_fit(thing_get_arena(thing), (void **)&o->pairs,
+            obj_inline_pairs(o), sizeof(o->pairs[0]), &o->allocated, o->len);
+        for (size_t i = 0; i < o->len; i++) {
+            sentry_value_freeze(o->pairs[i].v);
+        }
+        break;
+    }
+    default:;
+    }
+}
+
+static sentry_value_t
+thing_to_value(thing_t *thing)
+{
+    sentry_value_t rv;
+    rv._bits = (uint64_t)(size_t)thing;
+    return rv;
+}
+
+static sentry_value_t
+new_thing_value(void *ptr, uint8_t thing_type)
+{
+    thing_t *thing = heap_alloc(sizeof(thing_t));
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    thing->payload._ptr = ptr;
+    thing->refcount = 1;
+    thing->type = thing_type;
+    thing->len = 0;
+
+    return thing_to_value(thing);
+}
+
+/**
+ * Creates a new list, with room for exactly `size` items allocated together
+ * with the list itself.
+ */
+static sentry_value_t
+new_list_value(size_t size)
+{
+    thing_t *thing = thing_new(
+        sizeof(list_t) + sizeof(sentry_value_t) * size, THING_TYPE_LIST);
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    list_t *l = thing_get_extra(thing);
+    memset(l, 0, sizeof(list_t));
+    thing->payload._ptr = l;
+    if (size) {
+        l->items = list_inline_items(l);
+        l->allocated = size;
+    }
+    return thing_to_value(thing);
+}
+
+/**
+ * Creates a new object, with room for exactly `size` pairs allocated together
+ * with the object itself.
+ */
+static sentry_value_t
+new_object_value(size_t size)
+{
+    thing_t *thing = thing_new(
+        sizeof(obj_t) + sizeof(obj_pair_t) * size, THING_TYPE_OBJECT);
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    obj_t *o = thing_get_extra(thing);
+    memset(o, 0, sizeof(obj_t));
+    thing->payload._ptr = o;
+    if (size) {
+        o->pairs = obj_inline_pairs(o);
+        o->allocated = size;
+    }
+    return thing_to_value(thing);
+}
+
+static thing_t *
+value_as_thing(sentry_value_t value)
+{
+    if (value._bits & TAG_MASK) {
+        return NULL;
+    }
+    return (thing_t *)(size_t)value._bits;
+}
+
+static thing_t *
+value_as_unfrozen_thing(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    return thing && !thing_is_frozen(thing) ? thing : NULL;
+}
+
+/* public api implementations */
+
+void
+sentry_value_incref(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    if (thing) {
+        sentry__atomic_fetch_and_add(&thing->refcount, 1);
+    }
+}
+
+void
+sentry_value_decref(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    if (thing && sentry__atomic_fetch_and_add(&thing->refcount, -1) == 1) {
+        thing_free(thing);
+    }
+}
+
+size_t
+sentry_value_refcount(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    return thing ? (size_t)sentry__atomic_fetch(&thing->refcount) : 1;
+}
+
+void
+sentry_value_freeze(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    if (thing) {
+        thing_freeze(thing);
+    }
+}
+
+int
+sentry_value_is_frozen(sentry_value_t value)
+{
+    const thing_t *thing = value_as_thing(value);
+    return thing ? thing_is_frozen(thing) : true;
+}
+
+sentry_value_t
+sentry_value_new_null(void)
+{
+    sentry_value_t rv;
+    rv._bits = (uint64_t)CONST_NULL;
+    return rv;
+}
+
+sentry_value_t
+sentry_value_new_int32(int32_t value)
+{
+    sentry_value_t rv;
+    rv._bits = ((uint64_t)(uint32_t)value) << 32 | TAG_INT32;
+    return rv;
+}
+
+sentry_value_t
+sentry_value_new_int64(int64_t value)
+{
+    thing_t *thing
+        = thing_new(0, (uint8_t)(THING_TYPE_INT64 | THING_TYPE_FROZEN));
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    thing->payload._i64 = value;
+
+    return thing_to_value(thing);
+}
+
+sentry_value_t
+sentry_value_new_uint64(uint64_t value)
+{
+    thing_t *thing
+        = thing_new(0, (uint8_t)(THING_TYPE_UINT64 | THING_TYPE_FROZEN));
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    thing->payload._u64 = value;
+
+    return thing_to_value(thing);
+}
+
+sentry_value_t
+sentry_value_new_double(double value)
+{
+    thing_t *thing
+        = thing_new(0, (uint8_t)(THING_TYPE_DOUBLE | THING_TYPE_FROZEN));
+    if (!thing) {
+        return sentry_value_new_null();
+    }
+    thing->payload._double = value;
+
+    return thing_to_value(thing);
+}
+
+sentry_value_t
+sentry_value_new_bool(int value)
+{
+    sentry_value_t rv;
+    rv._bits = (uint64_t)(value ? CONST_TRUE : CONST_FALSE);
+    return rv;
+}
+
+sentry_value_t
+sentry_value_new_string(const char *value)
+{
+    if (!value) {
+        return sentry_value_new_null();
+    }
+    return sentry_value_new_string_n(value, strlen(value));
+}
+
+sentry_value_t
+sentry_value_new_string_n(const char *value, size_t len)
+{
+    thing_t *thing = thing_new(len + 1, THING_TYPE_STRING | THING_TYPE_FROZEN);
+    if (!thing) {
         return sentry_value_new_null();
     }
+    char *s = thing_get_extra(thing);
+    memcpy(s, value, len);
+    s[len] = '\0';
+    thing->payload._ptr = s;
+    thing_set_string_len(thing, len);
+    return thing_to_value(thing);
+}
+
+sentry_value_t
+sentry_value_new_list(void)
+{
+    return new_list_value(0);
+}
+
+sentry_value_t
+sentry__value_new_list_with_size(size_t size)
+{
+    return new_list_value(size);
+}
+
+sentry_value_t
+sentry_value_new_object(void)
+{
+    return new_object_value(0);
 }
 
 sentry_value_t
 sentry__value_new_object_with_size(size_t size)
 {
-    obj_t *o = SENTRY_MAKE(obj_t);
-    if (o) {
-        memset(o, 0, sizeof(obj_t));
-        o->allocated = size;
-        if (size) {
-            o->pairs = sentry_malloc(sizeof(obj_pair_t) * size);
-            if (!o->pairs) {
-                sentry_free(o);
-                return sentry_value_new_null();
-            }
+    return new_object_value(size);
+}
+
+sentry_value_t
+sentry_value_new_object_from_pairs(const sentry_value_pair_t *pairs, size_t len)
+{
+    sentry_value_t rv = new_object_value(len);
+    if (sentry_value_is_null(rv)) {
+        for (size_t i = 0; i < len; i++) {
+            sentry_value_decref(pairs[i].value);
+        }
+        return rv;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (pairs[i].key) {
+            sentry_value_set_by_key(rv, pairs[i].key, pairs[i].value);
+        } else {
+            sentry_value_decref(pairs[i].value);
         }
-        sentry_value_t rv = new_thing_value(o, THING_TYPE_OBJECT);
-        if (sentry_value_is_null(rv)) {
-            sentry_free(o->pairs);
-            sentry_free(o);
+    }
+    return rv;
+}
+
+sentry_value_t
+sentry_value_new_list_from_values(const sentry_value_t *values, size_t len)
+{
+    sentry_value_t rv = new_list_value(len);
+    if (sentry_value_is_null(rv)) {
+        for (size_t i = 0; i < len; i++) {
+            sentry_value_decref(values[i]);
         }
         return rv;
-    } else {
-        return sentry_value_new_null();
     }
+    list_t *l = value_as_thing(rv)->payload._ptr;
+    memcpy(l->items, values, sizeof(sentry_value_t) * len);
+    l->len = len;
+    return rv;
 }
 
 sentry_value_type_t
@@ -428,6 +1175,13 @@ sentry_value_get_type(sentry_value_t value)
             return SENTRY_VALUE_TYPE_OBJECT;
         case THING_TYPE_DOUBLE:
             return SENTRY_VALUE_TYPE_DOUBLE;
+        case THING_TYPE_INT64:
+            return SENTRY_VALUE_TYPE_INT64;
+        case THING_TYPE_UINT64:
+            return SENTRY_VALUE_TYPE_UINT64;
+        case THING_TYPE_ADDR:
+        case THING_TYPE_UUID:
+            return SENTRY_VALUE_TYPE_STRING;
         }
         assert(!"unreachable");
     } else if ((value._bits & TAG_MASK) == TAG_CONST) {
@@ -441,33 +1195,46 @@ sentry_value_get_type(sentry_value_t value)
 
 int
 sentry_value_set_by_key(sentry_value_t value, const char *k, sentry_value_t v)
+{
+    return sentry_value_set_by_key_n(value, k, strlen(k), v);
+}
+
+int
+sentry_value_set_by_key_n(
+    sentry_value_t value, const char *k, size_t k_len, sentry_value_t v)
 {
     thing_t *thing = value_as_unfrozen_thing(value);
     if (!thing || thing_get_type(thing) != THING_TYPE_OBJECT) {
         goto fail;
     }
     obj_t *o = thing->payload._ptr;
-    for (size_t i = 0; i < o->len; i++) {
-        obj_pair_t *pair = &o->pairs[i];
-        if (sentry__string_eq(pair->k, k)) {
-            sentry_value_decref(pair->v);
-            pair->v = v;
-            return 0;
-        }
+    size_t pos = obj_find(o, k, k_len);
+    if (pos < o->len) {
+        obj_pair_t *pair = &o->pairs[pos];
+        sentry_value_decref(pair->v);
+        pair->v = v;
+        return 0;
     }
 
-    if (!reserve((void **)&o->pairs, sizeof(o->pairs[0]), &o->allocated,
-            o->len + 1)) {
+    sentry_value_arena_t *arena = thing_get_arena(thing);
+    if (!reserve(arena, (void **)&o->pairs, obj_inline_pairs(o),
+            sizeof(o->pairs[0]), &o->allocated, o->len + 1)) {
         goto fail;
     }
 
     obj_pair_t pair;
-    pair.k = sentry__string_clone(k);
+    pair.k = key_clone(arena, k, k_len);
     if (!pair.k) {
         goto fail;
     }
+    pair.k_len = k_len;
     pair.v = v;
     o->pairs[o->len++] = pair;
+    if (o->index && o->len * 2 <= o->index_allocated) {
+        obj_index_insert(o, obj_hash_key(k, k_len), o->len - 1);
+    } else if (o->len >= OBJ_INDEX_THRESHOLD) {
+        obj_index_rebuild(o);
+    }
     return 0;
 
 fail:
@@ -477,24 +1244,33 @@ fail:
 
 int
 sentry_value_remove_by_key(sentry_value_t value, const char *k)
+{
+    return sentry_value_remove_by_key_n(value, k, strlen(k));
+}
+
+int
+sentry_value_remove_by_key_n(sentry_value_t value, const char *k, size_t k_len)
 {
     thing_t *thing = value_as_unfrozen_thing(value);
     if (!thing || thing_get_type(thing) != THING_TYPE_OBJECT) {
         return 1;
     }
     obj_t *o = thing->payload._ptr;
-    for (size_t i = 0; i < o->len; i++) {
-        obj_pair_t *pair = &o->pairs[i];
-        if (sentry__string_eq(pair->k, k)) {
-            sentry_free(pair->k);
-            sentry_value_decref(pair->v);
-            memmove(o->pairs + i, o->pairs + i + 1,
-                (o->len - i - 1) * sizeof(o->pairs[0]));
-            o->len--;
-            return 0;
-        }
+    size_t i = obj_find(o, k, k_len);
+    if (i >= o->len) {
+        return 1;
     }
-    return 1;
+    obj_pair_t *pair = &o->pairs[i];
+    key_free(thing_get_arena(thing), pair->k);
+    sentry_value_decref(pair->v);
+    memmove(o->pairs + i, o->pairs + i + 1,
+        (o->len - i - 1) * sizeof(o->pairs[0]));
+    o->len--;
+    // the positions of all the following pairs have shifted
+    if (o->index) {
+        obj_index_rebuild(o);
+    }
+    return 0;
 }
 
 int
@@ -507,7 +1283,8 @@ sentry_value_append(sentry_value_t value, sentry_value_t v)
 
     list_t *l = thing->payload._ptr;
 
-    if (!reserve((void **)&l->items, sizeof(l->items[0]), &l->allocated,
+    if (!reserve(thing_get_arena(thing), (void **)&l->items,
+            list_inline_items(l), sizeof(l->items[0]), &l->allocated,
             l->len + 1)) {
         goto fail;
     }
@@ -520,9 +1297,30 @@ fail:
     return 1;
 }
 
+bool
+sentry__value_get_uuid(sentry_value_t value, sentry_uuid_t *uuid_out)
+{
+    const thing_t *thing = value_as_thing(value);
+    if (!thing || thing_get_type(thing) != THING_TYPE_UUID) {
+        return false;
+    }
+    const uuid_payload_t *payload = thing->payload._ptr;
+    *uuid_out = payload->uuid;
+    if (payload->form == UUID_FORM_SPAN) {
+        // a span id only consists of the first half, just like when it is
+        // parsed from its string
+        memset(&uuid_out->bytes[8], 0, 8);
+    }
+    return true;
+}
+
 sentry_uuid_t
 sentry__value_as_uuid(sentry_value_t value)
 {
+    sentry_uuid_t uuid;
+    if (sentry__value_get_uuid(value, &uuid)) {
+        return uuid;
+    }
     const char *val = sentry_value_as_string(value);
     if (val) {
         return sentry_uuid_from_string(val);
@@ -544,6 +1342,16 @@ sentry__value_stringify(sentry_value_t value)
             sentry_value_is_true(value) ? "true" : "false");
     case SENTRY_VALUE_TYPE_STRING:
         return sentry__string_clone(sentry_value_as_string(value));
+    case SENTRY_VALUE_TYPE_INT64: {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%" PRId64, sentry_value_as_int64(value));
+        return sentry__string_clone(buf);
+    }
+    case SENTRY_VALUE_TYPE_UINT64: {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%" PRIu64, sentry_value_as_uint64(value));
+        return sentry__string_clone(buf);
+    }
     default: {
         char buf[24];
         size_t written = (size_t)sentry__snprintf_c(
@@ -579,12 +1387,17 @@ sentry__value_clone(sentry_value_t value)
         sentry_value_t rv = sentry__value_new_object_with_size(obj->len);
         for (size_t i = 0; i < obj->len; i++) {
             sentry_value_incref(obj->pairs[i].v);
-            sentry_value_set_by_key(rv, obj->pairs[i].k, obj->pairs[i].v);
+            sentry_value_set_by_key_n(
+                rv, obj->pairs[i].k, obj->pairs[i].k_len, obj->pairs[i].v);
         }
         return rv;
     }
     case THING_TYPE_STRING:
     case THING_TYPE_DOUBLE:
+    case THING_TYPE_INT64:
+    case THING_TYPE_UINT64:
+    case THING_TYPE_ADDR:
+    case THING_TYPE_UUID:
         sentry_value_incref(value);
         return value;
     default:
@@ -592,6 +1405,110 @@ sentry__value_clone(sentry_value_t value)
     }
 }
 
+size_t
+sentry__value_get_memory_usage(sentry_value_t value)
+{
+    const thing_t *thing = value_as_thing(value);
+    if (!thing) {
+        return 0;
+    }
+    size_t size = thing_get_arena(thing) ? sizeof(arena_thing_t)
+                                         : sizeof(thing_t);
+    switch (thing_get_type(thing)) {
+    case THING_TYPE_LIST: {
+        const list_t *list = thing->payload._ptr;
+        size += sizeof(list_t) + list->allocated * sizeof(sentry_value_t);
+        for (size_t i = 0; i < list->len; i++) {
+            size += sentry__value_get_memory_usage(list->items[i]);
+        }
+        break;
+    }
+    case THING_TYPE_OBJECT: {
+        const obj_t *obj = thing->payload._ptr;
+        size += sizeof(obj_t) + obj->allocated * sizeof(obj_pair_t)
+            + obj->index_allocated * sizeof(size_t);
+        for (size_t i = 0; i < obj->len; i++) {
+            if (!key_is_interned(obj->pairs[i].k)) {
+                size += obj->pairs[i].k_len + 1;
+            }
+            size += sentry__value_get_memory_usage(obj->pairs[i].v);
+        }
+        break;
+    }
+    case THING_TYPE_STRING:
+        size += thing_string_len(thing) + 1;
+        break;
+    case THING_TYPE_ADDR:
+        size += sizeof(addr_payload_t);
+        break;
+    case THING_TYPE_UUID:
+        size += sizeof(uuid_payload_t);
+        break;
+    }
+    return size;
+}
+
+void
+sentry__value_make_mutable(sentry_value_t *value)
+{
+    const thing_t *thing = value_as_thing(*value);
+    if (!thing || !thing_is_frozen(thing)
+        || (thing_get_type(thing) != THING_TYPE_LIST
+            && thing_get_type(thing) != THING_TYPE_OBJECT)) {
+        return;
+    }
+    sentry_value_t clone = sentry__value_clone(*value);
+    if (sentry_value_is_null(clone)) {
+        return;
+    }
+    sentry_value_decref(*value);
+    *value = clone;
+}
+
+void
+sentry__value_make_mutable_deep(sentry_value_t *value)
+{
+    sentry__value_make_mutable(value);
+    thing_t *thing = value_as_thing(*value);
+    if (!thing || thing_is_frozen(thing)) {
+        return;
+    }
+    switch (thing_get_type(thing)) {
+    case THING_TYPE_LIST: {
+        list_t *list = thing->payload._ptr;
+        for (size_t i = 0; i < list->len; i++) {
+            sentry__value_make_mutable_deep(&list->items[i]);
+        }
+        break;
+    }
+    case THING_TYPE_OBJECT: {
+        obj_t *obj = thing->payload._ptr;
+        for (size_t i = 0; i < obj->len; i++) {
+            sentry__value_make_mutable_deep(&obj->pairs[i].v);
+        }
+        break;
+    }
+    }
+}
+
+sentry_value_t
+sentry__value_get_mutable_by_key(sentry_value_t value, const char *k)
+{
+    sentry_value_t rv = sentry_value_get_by_key(value, k);
+    if (!sentry_value_is_frozen(rv) || sentry_value_is_frozen(value)) {
+        return rv;
+    }
+    sentry_value_t mutable_rv = sentry_value_get_by_key_owned(value, k);
+    sentry__value_make_mutable(&mutable_rv);
+    if (mutable_rv._bits == rv._bits) {
+        sentry_value_decref(mutable_rv);
+        return rv;
+    }
+    // this releases the reference the object held on the frozen original
+    sentry_value_set_by_key(value, k, mutable_rv);
+    return mutable_rv;
+}
+
 int
 sentry__value_append_bounded(sentry_value_t value, sentry_value_t v, size_t max)
 {
@@ -642,8 +1559,9 @@ sentry_value_set_by_index(sentry_value_t value, size_t index, sentry_value_t v)
     }
 
     list_t *l = thing->payload._ptr;
-    if (!reserve(
-            (void *)&l->items, sizeof(l->items[0]), &l->allocated, index + 1)) {
+    if (!reserve(thing_get_arena(thing), (void *)&l->items,
+            list_inline_items(l), sizeof(l->items[0]), &l->allocated,
+            index + 1)) {
         goto fail;
     }
 
@@ -685,15 +1603,19 @@ sentry_value_remove_by_index(sentry_value_t value, size_t index)
 
 sentry_value_t
 sentry_value_get_by_key(sentry_value_t value, const char *k)
+{
+    return sentry_value_get_by_key_n(value, k, strlen(k));
+}
+
+sentry_value_t
+sentry_value_get_by_key_n(sentry_value_t value, const char *k, size_t k_len)
 {
     const thing_t *thing = value_as_thing(value);
     if (thing && thing_get_type(thing) == THING_TYPE_OBJECT) {
-        obj_t *o = thing->payload._ptr;
-        for (size_t i = 0; i < o->len; i++) {
-            obj_pair_t *pair = &o->pairs[i];
-            if (sentry__string_eq(pair->k, k)) {
-                return pair->v;
-            }
+        const obj_t *o = thing->payload._ptr;
+        size_t pos = obj_find(o, k, k_len);
+        if (pos < o->len) {
+            return o->pairs[pos].v;
         }
     }
     return sentry_value_new_null();
@@ -702,7 +1624,14 @@ sentry_value_get_by_key(sentry_value_t value, const char *k)
 sentry_value_t
 sentry_value_get_by_key_owned(sentry_value_t value, const char *k)
 {
-    sentry_value_t rv = sentry_value_get_by_key(value, k);
+    return sentry_value_get_by_key_owned_n(value, k, strlen(k));
+}
+
+sentry_value_t
+sentry_value_get_by_key_owned_n(
+    sentry_value_t value, const char *k, size_t k_len)
+{
+    sentry_value_t rv = sentry_value_get_by_key_n(value, k, k_len);
     sentry_value_incref(rv);
     return rv;
 }
@@ -720,6 +1649,22 @@ sentry_value_get_by_index(sentry_value_t value, size_t index)
     return sentry_value_new_null();
 }
 
+sentry_value_t
+sentry__value_get_pair_by_index(
+    sentry_value_t value, size_t index, const char **key_out)
+{
+    const thing_t *thing = value_as_thing(value);
+    if (thing && thing_get_type(thing) == THING_TYPE_OBJECT) {
+        const obj_t *o = thing->payload._ptr;
+        if (index < o->len) {
+            *key_out = o->pairs[index].k;
+            return o->pairs[index].v;
+        }
+    }
+    *key_out = NULL;
+    return sentry_value_new_null();
+}
+
 sentry_value_t
 sentry_value_get_by_index_owned(sentry_value_t value, size_t index)
 {
@@ -731,11 +1676,14 @@ sentry_value_get_by_index_owned(sentry_value_t value, size_t index)
 size_t
 sentry_value_get_length(sentry_value_t value)
 {
-    const thing_t *thing = value_as_thing(value);
+    thing_t *thing = value_as_thing(value);
     if (thing) {
         switch (thing_get_type(thing)) {
         case THING_TYPE_STRING:
-            return strlen(thing->payload._ptr);
+            return thing_string_len(thing);
+        case THING_TYPE_ADDR:
+        case THING_TYPE_UUID:
+            return thing->len;
         case THING_TYPE_LIST:
             return ((const list_t *)thing->payload._ptr)->len;
         case THING_TYPE_OBJECT:
@@ -755,116 +1703,579 @@ sentry_value_as_int32(sentry_value_t value)
     }
 }
 
-double
-sentry_value_as_double(sentry_value_t value)
+int64_t
+sentry_value_as_int64(sentry_value_t value)
+{
+    if ((value._bits & TAG_MASK) == TAG_INT32) {
+        return (int64_t)sentry_value_as_int32(value);
+    }
+
+    const thing_t *thing = value_as_thing(value);
+    if (thing
+        && (thing_get_type(thing) == THING_TYPE_INT64
+            || thing_get_type(thing) == THING_TYPE_UINT64)) {
+        return thing->payload._i64;
+    } else {
+        return 0;
+    }
+}
+
+uint64_t
+sentry_value_as_uint64(sentry_value_t value)
+{
+    return (uint64_t)sentry_value_as_int64(value);
+}
+
+double
+sentry_value_as_double(sentry_value_t value)
+{
+    if ((value._bits & TAG_MASK) == TAG_INT32) {
+        return (double)sentry_value_as_int32(value);
+    }
+
+    const thing_t *thing = value_as_thing(value);
+    if (!thing) {
+        return NAN;
+    }
+    switch (thing_get_type(thing)) {
+    case THING_TYPE_DOUBLE:
+        return thing->payload._double;
+    case THING_TYPE_INT64:
+        return (double)thing->payload._i64;
+    case THING_TYPE_UINT64:
+        return (double)thing->payload._u64;
+    default:
+        return NAN;
+    }
+}
+
+uint64_t
+sentry__value_as_addr(sentry_value_t value)
+{
+    const thing_t *thing = value_as_thing(value);
+    if (thing
+        && (thing_get_type(thing) == THING_TYPE_ADDR
+            || thing_get_type(thing) == THING_TYPE_UINT64)) {
+        return thing->payload._u64;
+    }
+    if (thing && thing_get_type(thing) == THING_TYPE_STRING) {
+        return (uint64_t)strtoull(
+            (const char *)thing->payload._ptr, NULL, 0);
+    }
+    return (uint64_t)sentry_value_as_int64(value);
+}
+
+const char *
+sentry__value_as_string_n(sentry_value_t value, size_t *len_out)
+{
+    thing_t *thing = value_as_thing(value);
+    if (thing && thing_get_type(thing) == THING_TYPE_STRING) {
+        *len_out = thing_string_len(thing);
+        return (const char *)thing->payload._ptr;
+    } else if (thing && thing_get_type(thing) == THING_TYPE_ADDR) {
+        const char *s = thing_addr_string(thing);
+        *len_out = thing->len;
+        return s;
+    } else if (thing && thing_get_type(thing) == THING_TYPE_UUID) {
+        const char *s = thing_uuid_string(thing);
+        *len_out = thing->len;
+        return s;
+    } else {
+        *len_out = 0;
+        return "";
+    }
+}
+
+const char *
+sentry_value_as_string(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    if (thing && thing_get_type(thing) == THING_TYPE_STRING) {
+        return (const char *)thing->payload._ptr;
+    } else if (thing && thing_get_type(thing) == THING_TYPE_ADDR) {
+        return thing_addr_string(thing);
+    } else if (thing && thing_get_type(thing) == THING_TYPE_UUID) {
+        return thing_uuid_string(thing);
+    } else {
+        return "";
+    }
+}
+
+int
+sentry_value_is_true(sentry_value_t value)
+{
+    if (value._bits == CONST_TRUE) {
+        return 1;
+    }
+    switch (sentry_value_get_type(value)) {
+    case SENTRY_VALUE_TYPE_BOOL:
+    case SENTRY_VALUE_TYPE_NULL:
+        return 0;
+    case SENTRY_VALUE_TYPE_INT32:
+        return sentry_value_as_int32(value) != 0;
+    case SENTRY_VALUE_TYPE_INT64:
+    case SENTRY_VALUE_TYPE_UINT64:
+        return sentry_value_as_int64(value) != 0;
+    case SENTRY_VALUE_TYPE_DOUBLE:
+        return sentry_value_as_double(value) != 0.0;
+    default:
+        return sentry_value_get_length(value) > 0;
+    }
+}
+
+int
+sentry_value_is_null(sentry_value_t value)
+{
+    return value._bits == CONST_NULL;
+}
+
+int
+sentry__value_merge_objects(sentry_value_t dst, sentry_value_t src)
+{
+    if (sentry_value_is_null(src)) {
+        return 0;
+    }
+    if (sentry_value_get_type(dst) != SENTRY_VALUE_TYPE_OBJECT
+        || sentry_value_get_type(src) != SENTRY_VALUE_TYPE_OBJECT
+        || sentry_value_is_frozen(dst)) {
+        return 1;
+    }
+    thing_t *thing = value_as_thing(src);
+    if (!thing) {
+        return 1;
+    }
+    obj_t *obj = thing->payload._ptr;
+    for (size_t i = 0; i < obj->len; i++) {
+        const char *key = obj->pairs[i].k;
+        size_t key_len = obj->pairs[i].k_len;
+        sentry_value_t src_val = obj->pairs[i].v;
+        sentry_value_t dst_val = sentry_value_get_by_key_n(dst, key, key_len);
+        if (sentry_value_get_type(dst_val) == SENTRY_VALUE_TYPE_OBJECT
+            && sentry_value_get_type(src_val) == SENTRY_VALUE_TYPE_OBJECT) {
+            if (sentry__value_merge_objects(dst_val, src_val) != 0) {
+                return 1;
+            }
+        } else {
+            if (sentry_value_set_by_key_n(dst, key, key_len, src_val) != 0) {
+                return 1;
+            }
+            sentry_value_incref(src_val);
+        }
+    }
+    return 0;
+}
+
+/**
+ * The serialized forms of frozen Values that are part of many events, like
+ * the tags of the scope, see `sentry__value_cache_serialized`. The JSON and
+ * msgpack bytes are only created once they are first needed, and never change
+ * after that. An entry keeps a reference to its Value, so its thing can not be
+ * reused by another Value while it is cached, and writers keep a reference to
+ * the entry while splicing in its bytes.
+ */
+#define SERIALIZED_CACHE_SIZE 8
+
+typedef struct {
+    long refcount;
+    sentry_value_t value;
+    char *json;
+    size_t json_len;
+    char *msgpack;
+    size_t msgpack_len;
+} serialized_t;
+
+static sentry_mutex_t g_serialized_lock = SENTRY__MUTEX_INIT;
+static serialized_t *g_serialized[SERIALIZED_CACHE_SIZE];
+// read without the lock, so writers can skip the lookup for an empty cache,
+// which is why it is only ever accessed atomically
+static volatile long g_serialized_len = 0;
+
+static size_t
+serialized_len(void)
+{
+    return (size_t)sentry__atomic_fetch(&g_serialized_len);
+}
+
+static void
+serialized_decref(serialized_t *serialized)
+{
+    if (serialized
+        && sentry__atomic_fetch_and_add(&serialized->refcount, -1) == 1) {
+        sentry_value_decref(serialized->value);
+        sentry_free(serialized->json);
+        sentry_free(serialized->msgpack);
+        sentry_free(serialized);
+    }
+}
+
+static void
+serialized_remove_at(size_t i)
+{
+    serialized_t *serialized = g_serialized[i];
+    size_t len = serialized_len() - 1;
+    memmove(&g_serialized[i], &g_serialized[i + 1],
+        sizeof(serialized_t *) * (len - i));
+    sentry__atomic_store(&g_serialized_len, (long)len);
+    serialized_decref(serialized);
+}
+
+void
+sentry__value_cache_serialized(sentry_value_t value)
+{
+    thing_t *thing = value_as_thing(value);
+    if (!thing) {
+        return;
+    }
+    thing_freeze(thing);
+    sentry__mutex_lock(&g_serialized_lock);
+    for (size_t i = 0; i < serialized_len(); i++) {
+        if (g_serialized[i]->value._bits == value._bits) {
+            goto done;
+        }
+    }
+    serialized_t *serialized = SENTRY_MAKE(serialized_t);
+    if (!serialized) {
+        goto done;
+    }
+    memset(serialized, 0, sizeof(serialized_t));
+    serialized->refcount = 1;
+    sentry_value_incref(value);
+    serialized->value = value;
+    // the oldest entry makes room for the new one
+    if (serialized_len() == SERIALIZED_CACHE_SIZE) {
+        serialized_remove_at(0);
+    }
+    g_serialized[serialized_len()] = serialized;
+    sentry__atomic_fetch_and_add(&g_serialized_len, 1);
+
+done:
+    sentry__mutex_unlock(&g_serialized_lock);
+}
+
+void
+sentry__value_uncache_serialized(sentry_value_t value)
+{
+    sentry__mutex_lock(&g_serialized_lock);
+    for (size_t i = 0; i < serialized_len(); i++) {
+        if (g_serialized[i]->value._bits == value._bits) {
+            serialized_remove_at(i);
+            break;
+        }
+    }
+    sentry__mutex_unlock(&g_serialized_lock);
+}
+
+static void
+serialize_json(serialized_t *serialized)
+{
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    if (jw) {
+        sentry__jsonwriter_write_value(jw, serialized->value);
+        serialized->json
+            = sentry__jsonwriter_into_string(jw, &serialized->json_len);
+    }
+}
+
+static int value_append_msgpack(
+    sentry_stringbuilder_t *sb, sentry_value_t value, bool splice_members);
+
+static void
+serialize_msgpack(serialized_t *serialized)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    if (value_append_msgpack(&sb, serialized->value, false) != 0) {
+        sentry__stringbuilder_cleanup(&sb);
+        return;
+    }
+    serialized->msgpack_len = sentry__stringbuilder_len(&sb);
+    serialized->msgpack = sentry__stringbuilder_into_string(&sb);
+}
+
+/**
+ * Returns a reference to the cache entry of `value`, whose JSON or msgpack
+ * bytes, depending on `is_msgpack`, are available, or NULL if `value` is not
+ * cached.
+ */
+static serialized_t *
+serialized_get(sentry_value_t value, bool is_msgpack)
+{
+    const thing_t *thing = value_as_thing(value);
+    if (!serialized_len() || !thing
+        || !thing_is_frozen(thing)) {
+        return NULL;
+    }
+    serialized_t *rv = NULL;
+    sentry__mutex_lock(&g_serialized_lock);
+    for (size_t i = 0; i < serialized_len(); i++) {
+        serialized_t *serialized = g_serialized[i];
+        if (serialized->value._bits != value._bits) {
+            continue;
+        }
+        // this runs once per Value and format, so it is done under the lock
+        if (is_msgpack && !serialized->msgpack) {
+            serialize_msgpack(serialized);
+        } else if (!is_msgpack && !serialized->json) {
+            serialize_json(serialized);
+        }
+        if (is_msgpack ? serialized->msgpack != NULL
+                       : serialized->json != NULL) {
+            sentry__atomic_fetch_and_add(&serialized->refcount, 1);
+            rv = serialized;
+        }
+        break;
+    }
+    sentry__mutex_unlock(&g_serialized_lock);
+    return rv;
+}
+
+void
+sentry__jsonwriter_write_value(sentry_jsonwriter_t *jw, sentry_value_t value)
+{
+    // the output buffer grows while writing
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_JSON);
+    switch (sentry_value_get_type(value)) {
+    case SENTRY_VALUE_TYPE_NULL:
+        sentry__jsonwriter_write_null(jw);
+        break;
+    case SENTRY_VALUE_TYPE_BOOL:
+        sentry__jsonwriter_write_bool(jw, sentry_value_is_true(value));
+        break;
+    case SENTRY_VALUE_TYPE_INT32:
+        sentry__jsonwriter_write_int32(jw, sentry_value_as_int32(value));
+        break;
+    case SENTRY_VALUE_TYPE_INT64:
+        sentry__jsonwriter_write_int64(jw, sentry_value_as_int64(value));
+        break;
+    case SENTRY_VALUE_TYPE_UINT64:
+        sentry__jsonwriter_write_uint64(jw, sentry_value_as_uint64(value));
+        break;
+    case SENTRY_VALUE_TYPE_DOUBLE:
+        sentry__jsonwriter_write_double(jw, sentry_value_as_double(value));
+        break;
+    case SENTRY_VALUE_TYPE_STRING: {
+        const thing_t *thing = value_as_thing(value);
+        if (thing_get_type(thing) == THING_TYPE_ADDR) {
+            char buf[ADDR_BUF_SIZE];
+            size_t len = format_addr(buf, thing->payload._u64);
+            sentry__jsonwriter_write_str_n(jw, buf, len);
+            break;
+        }
+        if (thing_get_type(thing) == THING_TYPE_UUID) {
+            char buf[UUID_BUF_SIZE];
+            size_t len = format_uuid(buf, thing->payload._ptr);
+            sentry__jsonwriter_write_str_n(jw, buf, len);
+            break;
+        }
+        size_t len;
+        const char *s = sentry__value_as_string_n(value, &len);
+        sentry__jsonwriter_write_str_n(jw, s, len);
+        break;
+    }
+    case SENTRY_VALUE_TYPE_LIST: {
+        const list_t *l = value_as_thing(value)->payload._ptr;
+        sentry__jsonwriter_write_list_start(jw);
+        for (size_t i = 0; i < l->len; i++) {
+            sentry__jsonwriter_write_value(jw, l->items[i]);
+        }
+        sentry__jsonwriter_write_list_end(jw);
+        break;
+    }
+    case SENTRY_VALUE_TYPE_OBJECT: {
+        const obj_t *o = value_as_thing(value)->payload._ptr;
+        sentry__jsonwriter_write_object_start(jw);
+        for (size_t i = 0; i < o->len; i++) {
+            sentry__jsonwriter_write_key(jw, o->pairs[i].k);
+            sentry__jsonwriter_write_value(jw, o->pairs[i].v);
+        }
+        sentry__jsonwriter_write_object_end(jw);
+        break;
+    }
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
+}
+
+/**
+ * How an event is trimmed while writing it, see
+ * `sentry__jsonwriter_write_event`. A limit of 0 means no limit.
+ */
+typedef struct {
+    // the number of the oldest breadcrumbs of the event to leave out
+    size_t skipped_breadcrumbs;
+    // the maximum length of strings in bytes, which are cut at a UTF-8
+    // character boundary and end in `TRIM_ELLIPSIS` then
+    size_t max_string_len;
+    // the maximum number of frames of a stack trace, of which only the
+    // outermost and innermost ones are kept
+    size_t max_frames;
+} trim_limits_t;
+
+#define TRIM_ELLIPSIS "..."
+#define TRIM_ELLIPSIS_LEN 3
+
+/**
+ * Returns the number of bytes of the string that are kept by `trim`.
+ */
+static size_t
+trimmed_str_len(const char *str, size_t len, const trim_limits_t *trim)
 {
-    if ((value._bits & TAG_MASK) == TAG_INT32) {
-        return (double)sentry_value_as_int32(value);
+    if (!trim->max_string_len || len <= trim->max_string_len) {
+        return len;
     }
-
-    const thing_t *thing = value_as_thing(value);
-    if (thing && thing_get_type(thing) == THING_TYPE_DOUBLE) {
-        return thing->payload._double;
-    } else {
-        return NAN;
+    size_t cut = trim->max_string_len;
+    // do not split a multi-byte character
+    while (cut > 0 && ((unsigned char)str[cut] & 0xC0) == 0x80) {
+        cut--;
     }
+    return cut;
 }
 
-const char *
-sentry_value_as_string(sentry_value_t value)
+/**
+ * Returns the range of the items of `list` that `trim` leaves out, from
+ * `*omitted_start` up to `*omitted_end`, given that it is the member `key` of
+ * an object at `depth`, where the event itself is at depth 0.
+ */
+static void
+trimmed_list_range(const list_t *list, const char *key, size_t depth,
+    const trim_limits_t *trim, size_t *omitted_start, size_t *omitted_end)
 {
-    const thing_t *thing = value_as_thing(value);
-    if (thing && thing_get_type(thing) == THING_TYPE_STRING) {
-        return (const char *)thing->payload._ptr;
-    } else {
-        return "";
+    *omitted_start = 0;
+    *omitted_end = 0;
+    if (!key) {
+        return;
+    }
+    if (depth == 1 && sentry__string_eq(key, "breadcrumbs")) {
+        *omitted_end = trim->skipped_breadcrumbs < list->len
+            ? trim->skipped_breadcrumbs
+            : list->len;
+    } else if (trim->max_frames && list->len > trim->max_frames
+        && sentry__string_eq(key, "frames")) {
+        *omitted_start = trim->max_frames / 2;
+        *omitted_end = list->len - (trim->max_frames - *omitted_start);
     }
 }
 
-int
-sentry_value_is_true(sentry_value_t value)
+static size_t
+number_json_size(sentry_value_t value)
 {
-    if (value._bits == CONST_TRUE) {
-        return 1;
-    }
+    char buf[SENTRY_DTOA_BUF_SIZE];
     switch (sentry_value_get_type(value)) {
-    case SENTRY_VALUE_TYPE_BOOL:
-    case SENTRY_VALUE_TYPE_NULL:
-        return 0;
     case SENTRY_VALUE_TYPE_INT32:
-        return sentry_value_as_int32(value) != 0;
-    case SENTRY_VALUE_TYPE_DOUBLE:
-        return sentry_value_as_double(value) != 0.0;
-    default:
-        return sentry_value_get_length(value) > 0;
+        return (size_t)snprintf(
+            buf, sizeof(buf), "%" PRId32, sentry_value_as_int32(value));
+    case SENTRY_VALUE_TYPE_INT64:
+        return (size_t)snprintf(
+            buf, sizeof(buf), "%" PRId64, sentry_value_as_int64(value));
+    case SENTRY_VALUE_TYPE_UINT64:
+        return (size_t)snprintf(
+            buf, sizeof(buf), "%" PRIu64, sentry_value_as_uint64(value));
+    default: {
+        double val = sentry_value_as_double(value);
+        return isfinite(val) ? sentry__dtoa(val, buf) : 4;
+    }
     }
 }
 
-int
-sentry_value_is_null(sentry_value_t value)
-{
-    return value._bits == CONST_NULL;
-}
-
-int
-sentry__value_merge_objects(sentry_value_t dst, sentry_value_t src)
+/**
+ * Returns the number of bytes that writing `value` at `depth`, as the member
+ * `key` of its parent object, takes with the given `trim` applied.
+ */
+static size_t
+value_json_size(sentry_value_t value, const char *key, size_t depth,
+    const trim_limits_t *trim)
 {
-    if (sentry_value_is_null(src)) {
-        return 0;
-    }
-    if (sentry_value_get_type(dst) != SENTRY_VALUE_TYPE_OBJECT
-        || sentry_value_get_type(src) != SENTRY_VALUE_TYPE_OBJECT
-        || sentry_value_is_frozen(dst)) {
-        return 1;
-    }
-    thing_t *thing = value_as_thing(src);
-    if (!thing) {
-        return 1;
+    switch (sentry_value_get_type(value)) {
+    case SENTRY_VALUE_TYPE_NULL:
+        return 4;
+    case SENTRY_VALUE_TYPE_BOOL:
+        return sentry_value_is_true(value) ? 4 : 5;
+    case SENTRY_VALUE_TYPE_INT32:
+    case SENTRY_VALUE_TYPE_INT64:
+    case SENTRY_VALUE_TYPE_UINT64:
+    case SENTRY_VALUE_TYPE_DOUBLE:
+        return number_json_size(value);
+    case SENTRY_VALUE_TYPE_STRING: {
+        const thing_t *thing = value_as_thing(value);
+        if (thing_get_type(thing) == THING_TYPE_ADDR
+            || thing_get_type(thing) == THING_TYPE_UUID) {
+            // neither needs to be escaped
+            return thing->len + 2;
+        }
+        size_t len;
+        const char *s = sentry__value_as_string_n(value, &len);
+        size_t kept = trimmed_str_len(s, len, trim);
+        return sentry__json_str_len(s, kept)
+            + (kept < len ? TRIM_ELLIPSIS_LEN : 0);
     }
-    obj_t *obj = thing->payload._ptr;
-    for (size_t i = 0; i < obj->len; i++) {
-        char *key = obj->pairs[i].k;
-        sentry_value_t src_val = obj->pairs[i].v;
-        sentry_value_t dst_val = sentry_value_get_by_key(dst, key);
-        if (sentry_value_get_type(dst_val) == SENTRY_VALUE_TYPE_OBJECT
-            && sentry_value_get_type(src_val) == SENTRY_VALUE_TYPE_OBJECT) {
-            if (sentry__value_merge_objects(dst_val, src_val) != 0) {
-                return 1;
-            }
-        } else {
-            if (sentry_value_set_by_key(dst, key, src_val) != 0) {
-                return 1;
+    case SENTRY_VALUE_TYPE_LIST: {
+        const list_t *l = value_as_thing(value)->payload._ptr;
+        size_t omitted_start;
+        size_t omitted_end;
+        trimmed_list_range(l, key, depth, trim, &omitted_start, &omitted_end);
+        size_t size = 2;
+        size_t count = 0;
+        for (size_t i = 0; i < l->len; i++) {
+            if (i >= omitted_start && i < omitted_end) {
+                continue;
             }
-            sentry_value_incref(src_val);
+            size += value_json_size(l->items[i], NULL, depth + 1, trim);
+            count++;
+        }
+        return size + (count ? count - 1 : 0);
+    }
+    case SENTRY_VALUE_TYPE_OBJECT: {
+        const obj_t *o = value_as_thing(value)->payload._ptr;
+        size_t size = 2;
+        for (size_t i = 0; i < o->len; i++) {
+            const char *k = o->pairs[i].k;
+            size += sentry__json_str_len(k, strlen(k)) + 1
+                + value_json_size(o->pairs[i].v, k, depth + 1, trim);
         }
+        return size + (o->len ? o->len - 1 : 0);
+    }
     }
     return 0;
 }
 
-void
-sentry__jsonwriter_write_value(sentry_jsonwriter_t *jw, sentry_value_t value)
+static void
+write_trimmed_value(sentry_jsonwriter_t *jw, sentry_value_t value,
+    const char *key, size_t depth, const trim_limits_t *trim)
 {
     switch (sentry_value_get_type(value)) {
-    case SENTRY_VALUE_TYPE_NULL:
-        sentry__jsonwriter_write_null(jw);
-        break;
-    case SENTRY_VALUE_TYPE_BOOL:
-        sentry__jsonwriter_write_bool(jw, sentry_value_is_true(value));
-        break;
-    case SENTRY_VALUE_TYPE_INT32:
-        sentry__jsonwriter_write_int32(jw, sentry_value_as_int32(value));
-        break;
-    case SENTRY_VALUE_TYPE_DOUBLE:
-        sentry__jsonwriter_write_double(jw, sentry_value_as_double(value));
-        break;
-    case SENTRY_VALUE_TYPE_STRING:
-        sentry__jsonwriter_write_str(jw, sentry_value_as_string(value));
+    case SENTRY_VALUE_TYPE_STRING: {
+        int thing_type = thing_get_type(value_as_thing(value));
+        if (thing_type == THING_TYPE_ADDR || thing_type == THING_TYPE_UUID) {
+            sentry__jsonwriter_write_value(jw, value);
+            break;
+        }
+        size_t len;
+        const char *s = sentry__value_as_string_n(value, &len);
+        size_t kept = trimmed_str_len(s, len, trim);
+        if (kept == len) {
+            sentry__jsonwriter_write_value(jw, value);
+            break;
+        }
+        char *trimmed = sentry_malloc(kept + TRIM_ELLIPSIS_LEN);
+        if (!trimmed) {
+            sentry__jsonwriter_write_null(jw);
+            break;
+        }
+        memcpy(trimmed, s, kept);
+        memcpy(trimmed + kept, TRIM_ELLIPSIS, TRIM_ELLIPSIS_LEN);
+        sentry__jsonwriter_write_str_n(jw, trimmed, kept + TRIM_ELLIPSIS_LEN);
+        sentry_free(trimmed);
         break;
+    }
     case SENTRY_VALUE_TYPE_LIST: {
         const list_t *l = value_as_thing(value)->payload._ptr;
+        size_t omitted_start;
+        size_t omitted_end;
+        trimmed_list_range(l, key, depth, trim, &omitted_start, &omitted_end);
         sentry__jsonwriter_write_list_start(jw);
         for (size_t i = 0; i < l->len; i++) {
-            sentry__jsonwriter_write_value(jw, l->items[i]);
+            if (i < omitted_start || i >= omitted_end) {
+                write_trimmed_value(jw, l->items[i], NULL, depth + 1, trim);
+            }
         }
         sentry__jsonwriter_write_list_end(jw);
         break;
@@ -874,12 +2285,107 @@ sentry__jsonwriter_write_value(sentry_jsonwriter_t *jw, sentry_value_t value)
         sentry__jsonwriter_write_object_start(jw);
         for (size_t i = 0; i < o->len; i++) {
             sentry__jsonwriter_write_key(jw, o->pairs[i].k);
-            sentry__jsonwriter_write_value(jw, o->pairs[i].v);
+            write_trimmed_value(
+                jw, o->pairs[i].v, o->pairs[i].k, depth + 1, trim);
         }
         sentry__jsonwriter_write_object_end(jw);
         break;
     }
+    default:
+        sentry__jsonwriter_write_value(jw, value);
+    }
+}
+
+/**
+ * Writes `value` like `sentry__jsonwriter_write_value`, but if it is an
+ * Object, this splices in the cached JSON of its members, see
+ * `sentry__value_cache_serialized`.
+ */
+static void
+write_value_spliced(sentry_jsonwriter_t *jw, sentry_value_t value)
+{
+    if (sentry_value_get_type(value) != SENTRY_VALUE_TYPE_OBJECT
+        || !serialized_len()) {
+        sentry__jsonwriter_write_value(jw, value);
+        return;
+    }
+    const obj_t *o = value_as_thing(value)->payload._ptr;
+    sentry__jsonwriter_write_object_start(jw);
+    for (size_t i = 0; i < o->len; i++) {
+        sentry__jsonwriter_write_key(jw, o->pairs[i].k);
+        serialized_t *serialized = serialized_get(o->pairs[i].v, false);
+        if (serialized) {
+            sentry__jsonwriter_write_json(
+                jw, serialized->json, serialized->json_len);
+            serialized_decref(serialized);
+        } else {
+            sentry__jsonwriter_write_value(jw, o->pairs[i].v);
+        }
+    }
+    sentry__jsonwriter_write_object_end(jw);
+}
+
+bool
+sentry__jsonwriter_write_event(
+    sentry_jsonwriter_t *jw, sentry_value_t event, size_t max_size)
+{
+    trim_limits_t trim = { 0, 0, 0 };
+    size_t size = 0;
+    if (max_size && !sentry__jsonwriter_get_len(jw)
+        && sentry__jsonwriter_reset(jw)) {
+        // most events fit, so they are measured by writing them, into a writer
+        // that is able to discard them again otherwise
+        write_value_spliced(jw, event);
+        size = sentry__jsonwriter_get_len(jw);
+        if (size <= max_size) {
+            return false;
+        }
+        sentry__jsonwriter_reset(jw);
+    } else {
+        size = max_size ? value_json_size(event, NULL, 0, &trim) : 0;
+        if (size <= max_size) {
+            write_value_spliced(jw, event);
+            return false;
+        }
+    }
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_JSON);
+
+    // the oldest breadcrumbs go first
+    sentry_value_t breadcrumbs = sentry_value_get_by_key(event, "breadcrumbs");
+    if (sentry_value_get_type(breadcrumbs) == SENTRY_VALUE_TYPE_LIST) {
+        const list_t *l = value_as_thing(breadcrumbs)->payload._ptr;
+        for (size_t i = 0; i < l->len && size > max_size; i++) {
+            // along with its comma, unless it is the last one
+            size -= value_json_size(l->items[i], NULL, 2, &trim)
+                + (i + 1 < l->len ? 1 : 0);
+            trim.skipped_breadcrumbs++;
+        }
+    }
+
+    // then the long strings, and then the middle frames of deep stack traces
+    static const size_t max_string_lens[] = { 16384, 4096, 1024, 256 };
+    for (size_t i = 0; i < sizeof(max_string_lens) / sizeof(max_string_lens[0])
+         && size > max_size;
+         i++) {
+        trim.max_string_len = max_string_lens[i];
+        size = value_json_size(event, NULL, 0, &trim);
+    }
+    static const size_t max_frames[] = { 128, 32, 8 };
+    for (size_t i = 0;
+         i < sizeof(max_frames) / sizeof(max_frames[0]) && size > max_size;
+         i++) {
+        trim.max_frames = max_frames[i];
+        size = value_json_size(event, NULL, 0, &trim);
     }
+    if (size > max_size) {
+        SENTRY_WARNF("event of %zu bytes still exceeds the maximum event size "
+                     "after trimming",
+            size);
+    }
+
+    write_trimmed_value(jw, event, NULL, 0, &trim);
+    SENTRY_MEMORY_TAG_LEAVE();
+    return true;
 }
 
 char *
@@ -906,11 +2412,32 @@ value_to_msgpack(mpack_writer_t *writer, sentry_value_t value)
     case SENTRY_VALUE_TYPE_INT32:
         mpack_write_i32(writer, sentry_value_as_int32(value));
         break;
+    case SENTRY_VALUE_TYPE_INT64:
+        mpack_write_i64(writer, sentry_value_as_int64(value));
+        break;
+    case SENTRY_VALUE_TYPE_UINT64:
+        mpack_write_u64(writer, sentry_value_as_uint64(value));
+        break;
     case SENTRY_VALUE_TYPE_DOUBLE:
         mpack_write_double(writer, sentry_value_as_double(value));
         break;
     case SENTRY_VALUE_TYPE_STRING: {
-        mpack_write_cstr_or_nil(writer, sentry_value_as_string(value));
+        const thing_t *thing = value_as_thing(value);
+        if (thing_get_type(thing) == THING_TYPE_ADDR) {
+            char buf[ADDR_BUF_SIZE];
+            size_t len = format_addr(buf, thing->payload._u64);
+            mpack_write_str(writer, buf, (uint32_t)len);
+            break;
+        }
+        if (thing_get_type(thing) == THING_TYPE_UUID) {
+            char buf[UUID_BUF_SIZE];
+            size_t len = format_uuid(buf, thing->payload._ptr);
+            mpack_write_str(writer, buf, (uint32_t)len);
+            break;
+        }
+        size_t len;
+        const char *s = sentry__value_as_string_n(value, &len);
+        mpack_write_str(writer, s, (uint32_t)len);
         break;
     }
     case SENTRY_VALUE_TYPE_LIST: {
@@ -928,7 +2455,7 @@ value_to_msgpack(mpack_writer_t *writer, sentry_value_t value)
 
         mpack_start_map(writer, (uint32_t)o->len);
         for (size_t i = 0; i < o->len; i++) {
-            mpack_write_cstr(writer, o->pairs[i].k);
+            mpack_write_str(writer, o->pairs[i].k, (uint32_t)o->pairs[i].k_len);
             value_to_msgpack(writer, o->pairs[i].v);
         }
         mpack_finish_map(writer);
@@ -937,6 +2464,70 @@ value_to_msgpack(mpack_writer_t *writer, sentry_value_t value)
     }
 }
 
+static void
+msgpack_flush_to_stringbuilder(
+    mpack_writer_t *writer, const char *buffer, size_t count)
+{
+    sentry_stringbuilder_t *sb
+        = (sentry_stringbuilder_t *)mpack_writer_context(writer);
+    if (sentry__stringbuilder_append_buf(sb, buffer, count) != 0) {
+        mpack_writer_flag_error(writer, mpack_error_memory);
+    }
+}
+
+/**
+ * Writes the members of the Object `value`, splicing in their cached msgpack,
+ * see `sentry__value_cache_serialized`.
+ */
+static void
+members_to_msgpack_spliced(mpack_writer_t *writer, sentry_value_t value)
+{
+    const obj_t *o = value_as_thing(value)->payload._ptr;
+    mpack_start_map(writer, (uint32_t)o->len);
+    for (size_t i = 0; i < o->len; i++) {
+        mpack_write_str(writer, o->pairs[i].k, (uint32_t)o->pairs[i].k_len);
+        serialized_t *serialized = serialized_get(o->pairs[i].v, true);
+        if (serialized) {
+            mpack_write_object_bytes(
+                writer, serialized->msgpack, serialized->msgpack_len);
+            serialized_decref(serialized);
+        } else {
+            value_to_msgpack(writer, o->pairs[i].v);
+        }
+    }
+    mpack_finish_map(writer);
+}
+
+static int
+value_append_msgpack(
+    sentry_stringbuilder_t *sb, sentry_value_t value, bool splice_members)
+{
+    size_t prev_len = sentry__stringbuilder_len(sb);
+    char buf[256];
+    mpack_writer_t writer;
+    mpack_writer_init(&writer, buf, sizeof(buf));
+    mpack_writer_set_context(&writer, sb);
+    mpack_writer_set_flush(&writer, msgpack_flush_to_stringbuilder);
+    if (splice_members
+        && sentry_value_get_type(value) == SENTRY_VALUE_TYPE_OBJECT
+        && serialized_len()) {
+        members_to_msgpack_spliced(&writer, value);
+    } else {
+        value_to_msgpack(&writer, value);
+    }
+    if (mpack_writer_destroy(&writer) != mpack_ok) {
+        sentry__stringbuilder_set_len(sb, prev_len);
+        return 1;
+    }
+    return 0;
+}
+
+int
+sentry__value_append_msgpack(sentry_stringbuilder_t *sb, sentry_value_t value)
+{
+    return value_append_msgpack(sb, value, true);
+}
+
 char *
 sentry_value_to_msgpack(sentry_value_t value, size_t *size_out)
 {
@@ -950,6 +2541,122 @@ sentry_value_to_msgpack(sentry_value_t value, size_t *size_out)
     return buf;
 }
 
+// Deeper documents are rejected, to bound the recursion of the decoder.
+#define MAX_MSGPACK_DEPTH 512
+
+static sentry_value_t
+value_from_msgpack(mpack_reader_t *reader, size_t depth)
+{
+    mpack_tag_t tag = mpack_read_tag(reader);
+    if (mpack_reader_error(reader) != mpack_ok) {
+        return sentry_value_new_null();
+    }
+
+    switch (mpack_tag_type(&tag)) {
+    case mpack_type_nil:
+        return sentry_value_new_null();
+    case mpack_type_bool:
+        return sentry_value_new_bool(mpack_tag_bool_value(&tag));
+    case mpack_type_int: {
+        int64_t val = mpack_tag_int_value(&tag);
+        return val >= INT32_MIN ? sentry_value_new_int32((int32_t)val)
+                                : sentry_value_new_int64(val);
+    }
+    case mpack_type_uint: {
+        // positive signed integers are encoded as unsigned ones as well
+        uint64_t val = mpack_tag_uint_value(&tag);
+        if (val <= INT32_MAX) {
+            return sentry_value_new_int32((int32_t)val);
+        } else if (val <= INT64_MAX) {
+            return sentry_value_new_int64((int64_t)val);
+        }
+        return sentry_value_new_uint64(val);
+    }
+    case mpack_type_float:
+        return sentry_value_new_double(mpack_tag_float_value(&tag));
+    case mpack_type_double:
+        return sentry_value_new_double(mpack_tag_double_value(&tag));
+    case mpack_type_str: {
+        uint32_t len = mpack_tag_str_length(&tag);
+        const char *s = mpack_read_bytes_inplace(reader, len);
+        mpack_done_str(reader);
+        if (mpack_reader_error(reader) != mpack_ok) {
+            return sentry_value_new_null();
+        }
+        return sentry_value_new_string_n(s, len);
+    }
+    case mpack_type_array: {
+        if (depth >= MAX_MSGPACK_DEPTH) {
+            mpack_reader_flag_error(reader, mpack_error_too_big);
+            return sentry_value_new_null();
+        }
+        uint32_t count = mpack_tag_array_count(&tag);
+        // every item takes at least one byte, which bounds the pre-sizing of
+        // the list for bogus counts
+        size_t remaining = mpack_reader_remaining(reader, NULL);
+        sentry_value_t rv = sentry__value_new_list_with_size(
+            count < remaining ? count : remaining);
+        for (uint32_t i = 0;
+             i < count && mpack_reader_error(reader) == mpack_ok; i++) {
+            sentry_value_append(rv, value_from_msgpack(reader, depth + 1));
+        }
+        mpack_done_array(reader);
+        return rv;
+    }
+    case mpack_type_map: {
+        if (depth >= MAX_MSGPACK_DEPTH) {
+            mpack_reader_flag_error(reader, mpack_error_too_big);
+            return sentry_value_new_null();
+        }
+        uint32_t count = mpack_tag_map_count(&tag);
+        size_t remaining = mpack_reader_remaining(reader, NULL) / 2;
+        sentry_value_t rv = sentry__value_new_object_with_size(
+            count < remaining ? count : remaining);
+        for (uint32_t i = 0;
+             i < count && mpack_reader_error(reader) == mpack_ok; i++) {
+            // only string keys are supported
+            mpack_tag_t key_tag = mpack_read_tag(reader);
+            if (mpack_tag_type(&key_tag) != mpack_type_str) {
+                mpack_reader_flag_error(reader, mpack_error_type);
+                break;
+            }
+            uint32_t key_len = mpack_tag_str_length(&key_tag);
+            const char *key = mpack_read_bytes_inplace(reader, key_len);
+            mpack_done_str(reader);
+            sentry_value_t child = value_from_msgpack(reader, depth + 1);
+            if (mpack_reader_error(reader) == mpack_ok) {
+                sentry_value_set_by_key_n(rv, key, key_len, child);
+            } else {
+                sentry_value_decref(child);
+            }
+        }
+        mpack_done_map(reader);
+        return rv;
+    }
+    default:
+        // bin and ext values are never written by the SDK, and are skipped
+        mpack_skip_bytes(reader, mpack_tag_bytes(&tag));
+        mpack_done_type(reader, mpack_tag_type(&tag));
+        return sentry_value_new_null();
+    }
+}
+
+sentry_value_t
+sentry__value_from_msgpack(const char *buf, size_t buflen)
+{
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, buf, buflen);
+    sentry_value_t rv = value_from_msgpack(&reader, 0);
+    if (mpack_reader_remaining(&reader, NULL) != 0) {
+        mpack_reader_flag_error(&reader, mpack_error_invalid);
+    }
+    if (mpack_reader_destroy(&reader) != mpack_ok) {
+        sentry_value_decref(rv);
+        return sentry_value_new_null();
+    }
+    return rv;
+}
+
 sentry_value_t
 sentry__value_new_string_owned(char *s)
 {
@@ -960,6 +2667,8 @@ sentry__value_new_string_owned(char *s)
         = new_thing_value(s, THING_TYPE_STRING | THING_TYPE_FROZEN);
     if (sentry_value_is_null(rv)) {
         sentry_free(s);
+    } else {
+        thing_set_string_len(value_as_thing(rv), strlen(s));
     }
     return rv;
 }
@@ -976,14 +2685,17 @@ sentry__value_new_string_from_wstr(const wchar_t *s)
 sentry_value_t
 sentry__value_new_addr(uint64_t addr)
 {
-    char buf[32];
-    size_t written = (size_t)snprintf(
-        buf, sizeof(buf), "0x%llx", (unsigned long long)addr);
-    if (written >= sizeof(buf)) {
+    thing_t *thing = thing_new(sizeof(addr_payload_t),
+        (uint8_t)(THING_TYPE_ADDR | THING_TYPE_FROZEN));
+    if (!thing) {
         return sentry_value_new_null();
     }
-    buf[written] = '\0';
-    return sentry_value_new_string(buf);
+    thing->payload._u64 = addr;
+    thing->len = (uint32_t)addr_len(addr);
+    ((addr_payload_t *)thing_get_extra(thing))->str_state
+        = LAZY_STR_UNFORMATTED;
+
+    return thing_to_value(thing);
 }
 
 sentry_value_t
@@ -1009,40 +2721,40 @@ sentry__value_new_hexstring(const uint8_t *bytes, size_t len)
     return sentry__value_new_string_owned(buf);
 }
 
-sentry_value_t
-sentry__value_new_span_uuid(const sentry_uuid_t *uuid)
+static sentry_value_t
+value_new_uuid(const sentry_uuid_t *uuid, uuid_form_t form)
 {
-    char *buf = sentry_malloc(17);
-    if (!buf) {
+    thing_t *thing = thing_new(sizeof(uuid_payload_t),
+        (uint8_t)(THING_TYPE_UUID | THING_TYPE_FROZEN));
+    if (!thing) {
         return sentry_value_new_null();
     }
-    sentry__span_uuid_as_string(uuid, buf);
-    buf[16] = '\0';
-    return sentry__value_new_string_owned(buf);
+    uuid_payload_t *payload = thing_get_extra(thing);
+    payload->uuid = *uuid;
+    payload->form = (uint8_t)form;
+    payload->str_state = LAZY_STR_UNFORMATTED;
+    thing->payload._ptr = payload;
+    thing->len = (uint32_t)uuid_len(form);
+
+    return thing_to_value(thing);
+}
+
+sentry_value_t
+sentry__value_new_span_uuid(const sentry_uuid_t *uuid)
+{
+    return value_new_uuid(uuid, UUID_FORM_SPAN);
 }
 
 sentry_value_t
 sentry__value_new_internal_uuid(const sentry_uuid_t *uuid)
 {
-    char *buf = sentry_malloc(33);
-    if (!buf) {
-        return sentry_value_new_null();
-    }
-    sentry__internal_uuid_as_string(uuid, buf);
-    buf[32] = '\0';
-    return sentry__value_new_string_owned(buf);
+    return value_new_uuid(uuid, UUID_FORM_INTERNAL);
 }
 
 sentry_value_t
 sentry__value_new_uuid(const sentry_uuid_t *uuid)
 {
-    char *buf = sentry_malloc(37);
-    if (!buf) {
-        return sentry_value_new_null();
-    }
-    sentry_uuid_as_string(uuid, buf);
-    buf[36] = '\0';
-    return sentry__value_new_string_owned(buf);
+    return value_new_uuid(uuid, UUID_FORM_DEFAULT);
 }
 
 sentry_value_t
@@ -1054,18 +2766,16 @@ sentry__value_new_level(sentry_level_t level)
 sentry_value_t
 sentry_value_new_event(void)
 {
-    sentry_value_t rv = sentry_value_new_object();
-
     sentry_uuid_t uuid = sentry__new_event_id();
-    sentry_value_set_by_key(rv, "event_id", sentry__value_new_uuid(&uuid));
-
-    sentry_value_set_by_key(rv, "timestamp",
-        sentry__value_new_string_owned(
-            sentry__msec_time_to_iso8601(sentry__msec_time())));
-
-    sentry_value_set_by_key(rv, "platform", sentry_value_new_string("native"));
-
-    return rv;
+    sentry_value_pair_t pairs[] = {
+        { SENTRY_KEY(event_id), sentry__value_new_uuid(&uuid) },
+        { SENTRY_KEY(timestamp),
+            sentry__value_new_string_owned(
+                sentry__msec_time_to_iso8601(sentry__msec_time())) },
+        { SENTRY_KEY(platform), sentry_value_new_string("native") },
+    };
+    return sentry_value_new_object_from_pairs(
+        pairs, sizeof(pairs) / sizeof(pairs[0]));
 }
 
 sentry_value_t
@@ -1073,15 +2783,17 @@ sentry_value_new_message_event(
     sentry_level_t level, const char *logger, const char *text)
 {
     sentry_value_t rv = sentry_value_new_event();
-    sentry_value_set_by_key(rv, "level", sentry__value_new_level(level));
+    sentry_value_set_by_key(
+        rv, SENTRY_KEY(level), sentry__value_new_level(level));
     if (logger) {
-        sentry_value_set_by_key(rv, "logger", sentry_value_new_string(logger));
+        sentry_value_set_by_key(
+            rv, SENTRY_KEY(logger), sentry_value_new_string(logger));
     }
     if (text) {
         sentry_value_t container = sentry_value_new_object();
         sentry_value_set_by_key(
-            container, "formatted", sentry_value_new_string(text));
-        sentry_value_set_by_key(rv, "message", container);
+            container, SENTRY_KEY(formatted), sentry_value_new_string(text));
+        sentry_value_set_by_key(rv, SENTRY_KEY(message), container);
     }
     return rv;
 }
@@ -1090,16 +2802,17 @@ sentry_value_t
 sentry_value_new_breadcrumb(const char *type, const char *message)
 {
     sentry_value_t rv = sentry_value_new_object();
-    sentry_value_set_by_key(rv, "timestamp",
+    sentry_value_set_by_key(rv, SENTRY_KEY(timestamp),
         sentry__value_new_string_owned(
             sentry__msec_time_to_iso8601(sentry__msec_time())));
 
     if (type) {
-        sentry_value_set_by_key(rv, "type", sentry_value_new_string(type));
+        sentry_value_set_by_key(
+            rv, SENTRY_KEY(type), sentry_value_new_string(type));
     }
     if (message) {
         sentry_value_set_by_key(
-            rv, "message", sentry_value_new_string(message));
+            rv, SENTRY_KEY(message), sentry_value_new_string(message));
     }
     return rv;
 }
@@ -1108,8 +2821,10 @@ sentry_value_t
 sentry_value_new_exception(const char *type, const char *value)
 {
     sentry_value_t exc = sentry_value_new_object();
-    sentry_value_set_by_key(exc, "type", sentry_value_new_string(type));
-    sentry_value_set_by_key(exc, "value", sentry_value_new_string(value));
+    sentry_value_set_by_key(
+        exc, SENTRY_KEY(type), sentry_value_new_string(type));
+    sentry_value_set_by_key(
+        exc, SENTRY_KEY(value), sentry_value_new_string(value));
     return exc;
 }
 
@@ -1124,11 +2839,13 @@ sentry_value_new_thread(uint64_t id, const char *name)
         = (size_t)snprintf(buf, sizeof(buf), "%llu", (unsigned long long)id);
     if (written < sizeof(buf)) {
         buf[written] = '\0';
-        sentry_value_set_by_key(thread, "id", sentry_value_new_string(buf));
+        sentry_value_set_by_key(
+            thread, SENTRY_KEY(id), sentry_value_new_string(buf));
     }
 
     if (name) {
-        sentry_value_set_by_key(thread, "name", sentry_value_new_string(name));
+        sentry_value_set_by_key(
+            thread, SENTRY_KEY(name), sentry_value_new_string(name));
     }
 
     return thread;
@@ -1145,17 +2862,36 @@ sentry_value_new_stacktrace(void **ips, size_t len)
         ips = walked_backtrace;
     }
 
-    sentry_value_t frames = sentry__value_new_list_with_size(len);
+    // recurring stacktraces share their frozen frames, which are only
+    // symbolized once as well
+    sentry_value_t frames = sentry__symbolizer_intern_frames(ips, len);
+    if (!sentry_value_is_null(frames)) {
+        sentry_value_pair_t pairs[] = { { SENTRY_KEY(frames), frames } };
+        return sentry_value_new_object_from_pairs(pairs, 1);
+    }
+
+    // the frames are allocated from their own arena, unless the caller has
+    // already entered one
+    sentry_value_arena_t *arena = NULL;
+    sentry_value_arena_t *prev_arena = g_current_arena;
+    if (!prev_arena) {
+        arena = sentry__value_arena_new();
+        sentry__value_arena_enter(arena);
+    }
+
+    frames = sentry__value_new_list_with_size(len);
     for (size_t i = 0; i < len; i++) {
-        sentry_value_t frame = sentry_value_new_object();
-        sentry_value_set_by_key(frame, "instruction_addr",
+        sentry_value_t frame = sentry__value_new_object_with_size(1);
+        sentry_value_set_by_key(frame, SENTRY_KEY(instruction_addr),
             sentry__value_new_addr((uint64_t)(size_t)ips[len - i - 1]));
         sentry_value_append(frames, frame);
     }
 
-    sentry_value_t stacktrace = sentry_value_new_object();
-    sentry_value_set_by_key(stacktrace, "frames", frames);
+    sentry_value_pair_t pairs[] = { { SENTRY_KEY(frames), frames } };
+    sentry_value_t stacktrace = sentry_value_new_object_from_pairs(pairs, 1);
 
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
     return stacktrace;
 }
 
@@ -1171,10 +2907,10 @@ sentry__get_or_insert_values_list(sentry_value_t parent, const char *key)
     sentry_value_type_t type = sentry_value_get_type(obj);
     sentry_value_t values = sentry_value_new_null();
     if (type == SENTRY_VALUE_TYPE_OBJECT) {
-        values = sentry_value_get_by_key(obj, "values");
+        values = sentry_value_get_by_key(obj, SENTRY_KEY(values));
         if (sentry_value_is_null(values)) {
             values = sentry_value_new_list();
-            sentry_value_set_by_key(obj, "values", values);
+            sentry_value_set_by_key(obj, SENTRY_KEY(values), values);
         }
     } else if (type == SENTRY_VALUE_TYPE_LIST) {
         values = obj;
@@ -1187,7 +2923,7 @@ void
 sentry_event_add_exception(sentry_value_t event, sentry_value_t exception)
 {
     sentry_value_t exceptions
-        = sentry__get_or_insert_values_list(event, "exception");
+        = sentry__get_or_insert_values_list(event, SENTRY_KEY(exception));
     sentry_value_append(exceptions, exception);
 }
 
@@ -1195,7 +2931,7 @@ void
 sentry_event_add_thread(sentry_value_t event, sentry_value_t thread)
 {
     sentry_value_t threads
-        = sentry__get_or_insert_values_list(event, "threads");
+        = sentry__get_or_insert_values_list(event, SENTRY_KEY(threads));
     sentry_value_append(threads, thread);
 }
 
@@ -1203,13 +2939,24 @@ void
 sentry_value_set_stacktrace(sentry_value_t value, void **ips, size_t len)
 {
     sentry_value_t stacktrace = sentry_value_new_stacktrace(ips, len);
-    sentry_value_set_by_key(value, "stacktrace", stacktrace);
+    sentry_value_set_by_key(value, SENTRY_KEY(stacktrace), stacktrace);
 }
 
 void
 sentry_event_value_add_stacktrace(sentry_value_t event, void **ips, size_t len)
 {
-    sentry_value_t thread = sentry_value_new_object();
+    // a stack that is walked here belongs to the current thread, whose name
+    // is cached after the first event
+    long tid = ips ? 0 : sentry__unwinder_current_tid();
+    sentry_value_t thread;
+    if (tid) {
+        char name_buf[16];
+        thread = sentry_value_new_thread(
+            (uint64_t)tid, sentry__unwinder_thread_name(tid, name_buf));
+        sentry_value_set_by_key(thread, "current", sentry_value_new_bool(true));
+    } else {
+        thread = sentry_value_new_object();
+    }
     sentry_value_set_stacktrace(thread, ips, len);
     sentry_event_add_thread(event, thread);
 }
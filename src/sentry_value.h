@@ -2,12 +2,74 @@
 #define SENTRY_VALUE_H_INCLUDED
 
 #include "sentry_boot.h"
+#include "sentry_string.h"
+
+/**
+ * Well-known Object keys, which are interned into a static table.
+ *
+ * `SENTRY_KEY(name)` returns the interned handle for `name`, which can be
+ * passed as key to any of the Object functions. Objects reference such keys
+ * directly instead of allocating a copy, and lookups compare them by pointer
+ * before falling back to a string comparison.
+ */
+#define SENTRY_INTERNED_KEYS(X)                                                \
+    X(breadcrumbs)                                                             \
+    X(category)                                                                \
+    X(contexts)                                                                \
+    X(data)                                                                    \
+    X(description)                                                             \
+    X(event_id)                                                                \
+    X(exception)                                                               \
+    X(extra)                                                                   \
+    X(formatted)                                                               \
+    X(frames)                                                                  \
+    X(function)                                                                \
+    X(id)                                                                      \
+    X(image_addr)                                                              \
+    X(instruction_addr)                                                        \
+    X(level)                                                                   \
+    X(logger)                                                                  \
+    X(message)                                                                 \
+    X(name)                                                                    \
+    X(op)                                                                      \
+    X(parent_span_id)                                                          \
+    X(platform)                                                                \
+    X(sampled)                                                                 \
+    X(span_id)                                                                 \
+    X(spans)                                                                   \
+    X(stacktrace)                                                              \
+    X(start_timestamp)                                                         \
+    X(status)                                                                  \
+    X(symbol_addr)                                                             \
+    X(tags)                                                                    \
+    X(threads)                                                                 \
+    X(timestamp)                                                               \
+    X(trace)                                                                   \
+    X(trace_id)                                                                \
+    X(transaction)                                                             \
+    X(type)                                                                    \
+    X(value)                                                                   \
+    X(values)
+
+#define SENTRY_INTERNED_KEY_MEMBER(Name) char Name[sizeof(#Name)];
+extern const struct sentry_interned_keys_s {
+    SENTRY_INTERNED_KEYS(SENTRY_INTERNED_KEY_MEMBER)
+} sentry__interned_keys;
+#undef SENTRY_INTERNED_KEY_MEMBER
+
+#define SENTRY_KEY(Name) (sentry__interned_keys.Name)
 
 /**
  * Create a new Value from an owned string.
  */
 sentry_value_t sentry__value_new_string_owned(char *s);
 
+/**
+ * Returns the String Value, like `sentry_value_as_string`, and writes its
+ * cached byte length into `len_out`.
+ */
+const char *sentry__value_as_string_n(sentry_value_t value, size_t *len_out);
+
 #ifdef SENTRY_PLATFORM_WINDOWS
 /**
  * Create a new Value from a Wide String.
@@ -17,9 +79,19 @@ sentry_value_t sentry__value_new_string_from_wstr(const wchar_t *s);
 
 /**
  * Create a new String Value, with the hex-formatted value of `addr`.
+ *
+ * The address is stored as a plain number, and is only formatted as a hex
+ * string when it is first read as one. Serializing it formats it on the stack
+ * instead.
  */
 sentry_value_t sentry__value_new_addr(uint64_t addr);
 
+/**
+ * Returns the address of a Value created by `sentry__value_new_addr`.
+ * Integer Values and hex-formatted String Values are converted as well.
+ */
+uint64_t sentry__value_as_addr(sentry_value_t value);
+
 /**
  * Creates a new String Value, with a hex representation of `bytes`.
  */
@@ -28,6 +100,7 @@ sentry_value_t sentry__value_new_hexstring(const uint8_t *bytes, size_t len);
 /**
  * Creates a new String Value from the `uuid` that conforms to
  * the structure of a span ID.
+ * The raw bytes are stored, and only formatted when the string is needed.
  * See also `sentry__span_uuid_as_string`.
  */
 sentry_value_t sentry__value_new_span_uuid(const sentry_uuid_t *uuid);
@@ -35,12 +108,14 @@ sentry_value_t sentry__value_new_span_uuid(const sentry_uuid_t *uuid);
 /**
  * Creates a new String Value from the `uuid` in a form meant for
  * ingestion as an internal ID.
+ * The raw bytes are stored, and only formatted when the string is needed.
  * See also `sentry_internal_uuid_as_string`.
  */
 sentry_value_t sentry__value_new_internal_uuid(const sentry_uuid_t *uuid);
 
 /**
  * Creates a new String Value from the `uuid`.
+ * The raw bytes are stored, and only formatted when the string is needed.
  * See also `sentry_uuid_as_string`.
  */
 sentry_value_t sentry__value_new_uuid(const sentry_uuid_t *uuid);
@@ -51,6 +126,14 @@ sentry_value_t sentry__value_new_uuid(const sentry_uuid_t *uuid);
  */
 sentry_value_t sentry__value_new_level(sentry_level_t level);
 
+/**
+ * Returns the borrowed value of the pair at `index` of the Object `value`, in
+ * the order in which the pairs were added, along with its key in `key_out`.
+ * Returns a null Value and a NULL key if there is no such pair.
+ */
+sentry_value_t sentry__value_get_pair_by_index(
+    sentry_value_t value, size_t index, const char **key_out);
+
 /**
  * Creates a new List Value with a capacity of `size`.
  */
@@ -61,6 +144,13 @@ sentry_value_t sentry__value_new_list_with_size(size_t size);
  */
 sentry_value_t sentry__value_new_object_with_size(size_t size);
 
+/**
+ * Copies the raw bytes of a Value created by one of the `sentry__value_new_*
+ * uuid` functions into `uuid_out`, without formatting or parsing a string.
+ * Returns false for any other Value, including plain UUID strings.
+ */
+bool sentry__value_get_uuid(sentry_value_t value, sentry_uuid_t *uuid_out);
+
 /**
  * This will parse the Value into a UUID, or return a `nil` UUID on error.
  * See also `sentry_uuid_from_string`.
@@ -79,6 +169,35 @@ char *sentry__value_stringify(sentry_value_t value);
  */
 sentry_value_t sentry__value_clone(sentry_value_t value);
 
+/**
+ * Returns the number of bytes allocated for `value`, including all of its
+ * children. Values that are shared between multiple parents are counted once
+ * for each of them, and allocator overhead is not included.
+ */
+size_t sentry__value_get_memory_usage(sentry_value_t value);
+
+/**
+ * Makes sure that the List or Object in `*value` can be mutated, by replacing
+ * it with a shallow clone if it is frozen. This allows sharing frozen
+ * snapshots of a collection, and only copying it on its first modification.
+ */
+void sentry__value_make_mutable(sentry_value_t *value);
+
+/**
+ * Makes sure that the List or Object in `*value`, and all the Lists and
+ * Objects it contains, can be mutated, by replacing the frozen ones with
+ * shallow clones as per `sentry__value_make_mutable`. The collections that are
+ * not frozen are kept, but are modified in place.
+ */
+void sentry__value_make_mutable_deep(sentry_value_t *value);
+
+/**
+ * Returns the value of the key `k` in the Object `value`, making sure that it
+ * can be mutated as per `sentry__value_make_mutable`.
+ */
+sentry_value_t sentry__value_get_mutable_by_key(
+    sentry_value_t value, const char *k);
+
 /**
  * This appends `v` to the List `value`.
  * It will remove the first value of the list, is case the total number if items
@@ -105,11 +224,74 @@ int sentry__value_append_bounded(
  */
 int sentry__value_merge_objects(sentry_value_t dst, sentry_value_t src);
 
+typedef struct sentry_value_arena_s sentry_value_arena_t;
+
+/**
+ * Creates a new Value Arena, which can be used to bump-allocate all the values
+ * created for one event in one go.
+ * This returns `NULL` if arenas are not available, which is fine to be used
+ * with all the other arena functions.
+ */
+sentry_value_arena_t *sentry__value_arena_new(void);
+
+/**
+ * Drops the reference to the `arena` that was returned by
+ * `sentry__value_arena_new`. The arena memory is released once all the values
+ * allocated from it have been freed as well.
+ */
+void sentry__value_arena_decref(sentry_value_arena_t *arena);
+
+/**
+ * Makes `arena` the current arena of the calling thread, so all the values
+ * created on this thread are allocated from it until
+ * `sentry__value_arena_leave` is called with the returned previous arena.
+ */
+sentry_value_arena_t *sentry__value_arena_enter(sentry_value_arena_t *arena);
+
+/**
+ * Restores the `previous` arena returned by `sentry__value_arena_enter`.
+ */
+void sentry__value_arena_leave(sentry_value_arena_t *previous);
+
 /**
  * Parse the given JSON string into a new Value.
  */
 sentry_value_t sentry__value_from_json(const char *buf, size_t buflen);
 
+/**
+ * Freezes `value`, and keeps its serialized forms in a small cache, so that
+ * they are created only once for all the events `value` is part of. When the
+ * members of an event, or of the Object passed to
+ * `sentry__value_append_msgpack`, are written, the cached bytes of any of
+ * them are spliced in instead of encoding them again. The cache holds a
+ * reference to `value` until `sentry__value_uncache_serialized` is called, or
+ * until it is evicted by newer entries.
+ */
+void sentry__value_cache_serialized(sentry_value_t value);
+
+/**
+ * Drops the serialized forms of `value` from the cache, if it is cached.
+ */
+void sentry__value_uncache_serialized(sentry_value_t value);
+
+/**
+ * Appends the msgpack encoding of `value` to the string builder `sb`.
+ *
+ * Unlike `sentry_value_to_msgpack`, this allows reusing the buffer of `sb`
+ * for repeated encodings, and it splices in the cached encoding of members
+ * that were passed to `sentry__value_cache_serialized`. On failure, `sb` is
+ * reset to its previous length. Returns 0 on success.
+ */
+int sentry__value_append_msgpack(
+    sentry_stringbuilder_t *sb, sentry_value_t value);
+
+/**
+ * Decodes the msgpack encoded `buf`, as written by `sentry_value_to_msgpack`,
+ * into a new Value. Returns a null Value if `buf` is not a single valid
+ * msgpack document.
+ */
+sentry_value_t sentry__value_from_msgpack(const char *buf, size_t buflen);
+
 typedef struct sentry_jsonwriter_s sentry_jsonwriter_t;
 
 /**
@@ -118,6 +300,25 @@ typedef struct sentry_jsonwriter_s sentry_jsonwriter_t;
 void sentry__jsonwriter_write_value(
     sentry_jsonwriter_t *jw, sentry_value_t value);
 
+/**
+ * Writes the given `event` into the `jsonwriter`, trimmed so that it takes at
+ * most `max_size` bytes, if possible. A `max_size` of 0 means no limit.
+ *
+ * An event that is written into an empty writer without a sink is measured by
+ * writing it, and is only written again if it turns out too large. Otherwise,
+ * and for sizing the trimmed event, the size is computed from the values,
+ * without serializing them. When the event is too large, the oldest
+ * breadcrumbs are left out first. Then strings are cut to progressively
+ * shorter lengths, and then only the outermost and innermost frames of deep
+ * stack traces are kept, until the event fits. The event itself is not
+ * modified. An event that is not trimmed gets the cached
+ * JSON of its members spliced in, see `sentry__value_cache_serialized`.
+ *
+ * Returns true if the event was trimmed.
+ */
+bool sentry__jsonwriter_write_event(
+    sentry_jsonwriter_t *jw, sentry_value_t event, size_t max_size);
+
 sentry_value_t sentry__value_new_span_uuid(const sentry_uuid_t *uuid);
 
 sentry_value_t sentry__value_new_internal_uuid(const sentry_uuid_t *uuid);
@@ -0,0 +1,197 @@
+#include "sentry_watchdog.h"
+
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_sync.h"
+#include "sentry_unwinder.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+#include <stdio.h>
+
+#define MAX_FRAMES 128
+// the heartbeat is checked this many times per timeout
+#define CHECKS_PER_TIMEOUT 4
+#define MIN_CHECK_INTERVAL_MS 10
+// how long the stalled thread has to respond to being unwound
+#define UNWIND_TIMEOUT_MS 100
+
+/**
+ * The heartbeats are stored as milliseconds since the watchdog was started,
+ * plus one so that 0 means that there was no heartbeat yet. They are only
+ * accessed atomically, since `sentry_app_heartbeat` is meant to be called
+ * from a hot loop and must not take any locks, and have 64 bits, since a
+ * `long` of milliseconds wraps after about 24 days where it has 32.
+ */
+static volatile long g_running = 0;
+static uint64_t g_epoch = 0;
+static volatile uint64_t g_last_heartbeat = 0;
+static volatile long g_watched_tid = 0;
+
+static sentry_mutex_t g_watchdog_lock = SENTRY__MUTEX_INIT;
+static sentry_bgworker_t *g_watchdog = NULL;
+
+typedef struct {
+    uint64_t timeout;
+    uint64_t shutdown_timeout;
+    // the heartbeat that was last reported, so that every stall is reported
+    // only once
+    uint64_t reported_heartbeat;
+} sentry_watchdog_t;
+
+static uint64_t
+watchdog_time(void)
+{
+    return sentry__monotonic_time() - g_epoch + 1;
+}
+
+void
+sentry_app_heartbeat(void)
+{
+    if (!sentry__atomic_fetch(&g_running)) {
+        return;
+    }
+    static SENTRY_THREAD_LOCAL long tid = 0;
+    if (!tid) {
+        tid = sentry__unwinder_current_tid();
+    }
+    sentry__atomic_store(&g_watched_tid, tid);
+    sentry__atomic_store_u64(&g_last_heartbeat, watchdog_time());
+}
+
+static void
+report_app_hang(long tid, uint64_t duration_ms)
+{
+    SENTRY_DEBUGF("app is hanging for %" PRIu64 " ms", duration_ms);
+
+    // the thread id is only known where the thread can also be unwound, so
+    // elsewhere the event has neither a stack nor a thread id
+    void *backtrace[MAX_FRAMES];
+    size_t frame_count = 0;
+    if (tid) {
+        frame_count = sentry__unwind_thread(
+            tid, &backtrace[0], MAX_FRAMES, UNWIND_TIMEOUT_MS);
+    }
+
+    char message[64];
+    snprintf(message, sizeof(message),
+        "App hanging for at least %" PRIu64 " ms.", duration_ms);
+
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_set_by_key(
+        event, "level", sentry__value_new_level(SENTRY_LEVEL_ERROR));
+
+    sentry_value_t exc = sentry_value_new_exception("App Hanging", message);
+    sentry_value_t mechanism = sentry_value_new_object();
+    sentry_value_set_by_key(
+        mechanism, "type", sentry_value_new_string("AppHang"));
+    sentry_value_set_by_key(
+        mechanism, "synthetic", sentry_value_new_bool(true));
+    sentry_value_t data = sentry_value_new_object();
+    sentry_value_set_by_key(
+        data, "duration_ms", sentry_value_new_double((double)duration_ms));
+    sentry_value_set_by_key(mechanism, "data", data);
+    sentry_value_set_by_key(exc, "mechanism", mechanism);
+
+    if (frame_count) {
+        sentry_value_set_stacktrace(exc, &backtrace[0], frame_count);
+    }
+    if (tid) {
+        sentry_value_set_by_key(
+            exc, "thread_id", sentry_value_new_uint64((uint64_t)tid));
+    }
+    sentry_event_add_exception(event, exc);
+
+    sentry_capture_event(event);
+}
+
+static void
+check_heartbeat(void *UNUSED(task_data), void *state)
+{
+    sentry_watchdog_t *watchdog = (sentry_watchdog_t *)state;
+    uint64_t last_heartbeat = sentry__atomic_fetch_u64(&g_last_heartbeat);
+    if (!last_heartbeat || last_heartbeat == watchdog->reported_heartbeat) {
+        return;
+    }
+
+    uint64_t now = watchdog_time();
+    uint64_t stalled_for = now > last_heartbeat ? now - last_heartbeat : 0;
+    if (stalled_for < watchdog->timeout) {
+        return;
+    }
+
+    watchdog->reported_heartbeat = last_heartbeat;
+    report_app_hang(sentry__atomic_fetch(&g_watched_tid), stalled_for);
+}
+
+void
+sentry__watchdog_start(const sentry_options_t *options)
+{
+    if (!options->app_hang_timeout) {
+        return;
+    }
+
+    sentry__mutex_lock(&g_watchdog_lock);
+    if (g_watchdog) {
+        goto done;
+    }
+
+    sentry_watchdog_t *watchdog = SENTRY_MAKE(sentry_watchdog_t);
+    if (!watchdog) {
+        goto done;
+    }
+    watchdog->timeout = options->app_hang_timeout;
+    watchdog->shutdown_timeout = options->shutdown_timeout;
+    watchdog->reported_heartbeat = 0;
+
+    sentry_bgworker_t *bgw = sentry__bgworker_new(watchdog, sentry_free);
+    if (!bgw) {
+        sentry_free(watchdog);
+        goto done;
+    }
+    sentry__bgworker_setname(bgw, "sentry-watchdog");
+
+    uint64_t interval = watchdog->timeout / CHECKS_PER_TIMEOUT;
+    if (interval < MIN_CHECK_INTERVAL_MS) {
+        interval = MIN_CHECK_INTERVAL_MS;
+    }
+    if (sentry__bgworker_submit_periodic(
+            bgw, check_heartbeat, NULL, NULL, interval, NULL)
+            != 0
+        || sentry__bgworker_start(bgw) != 0) {
+        SENTRY_WARN("failed to start the app hang watchdog");
+        sentry__bgworker_decref(bgw);
+        goto done;
+    }
+
+    sentry__unwinder_threads_begin();
+    g_epoch = sentry__monotonic_time();
+    sentry__atomic_store_u64(&g_last_heartbeat, 0);
+    sentry__atomic_store(&g_running, 1);
+    g_watchdog = bgw;
+    SENTRY_DEBUGF(
+        "started the app hang watchdog with a timeout of %" PRIu64 " ms",
+        watchdog->timeout);
+
+done:
+    sentry__mutex_unlock(&g_watchdog_lock);
+}
+
+void
+sentry__watchdog_stop(void)
+{
+    sentry__mutex_lock(&g_watchdog_lock);
+    sentry_bgworker_t *bgw = g_watchdog;
+    g_watchdog = NULL;
+    if (bgw) {
+        sentry__atomic_store(&g_running, 0);
+        sentry_watchdog_t *watchdog
+            = (sentry_watchdog_t *)sentry__bgworker_get_state(bgw);
+        if (sentry__bgworker_shutdown(bgw, watchdog->shutdown_timeout) == 0) {
+            sentry__bgworker_decref(bgw);
+            sentry__unwinder_threads_end();
+        }
+        SENTRY_DEBUG("stopped the app hang watchdog");
+    }
+    sentry__mutex_unlock(&g_watchdog_lock);
+}
@@ -0,0 +1,19 @@
+#ifndef SENTRY_WATCHDOG_H_INCLUDED
+#define SENTRY_WATCHDOG_H_INCLUDED
+
+#include "sentry_boot.h"
+
+#include "sentry_options.h"
+
+/**
+ * Starts the watchdog thread, if `options` has an app hang timeout.
+ */
+void sentry__watchdog_start(const sentry_options_t *options);
+
+/**
+ * Stops the watchdog thread. This must not be called with the options lock
+ * held, since a hang that is being reported needs it.
+ */
+void sentry__watchdog_stop(void);
+
+#endif
@@ -0,0 +1,530 @@
+#include "sentry_boot.h"
+
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_string.h"
+#include "sentry_symbolizer.h"
+#include "sentry_sync.h"
+#include "sentry_value.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the number of addresses the cache holds, and the number of buckets of its
+// hash table, which must be a power of two
+#define CACHE_SIZE 1024
+#define CACHE_BUCKETS 2048
+// the number of interned stacktraces, which must be a power of two
+#define STACKTRACE_CACHE_SIZE 64
+
+/**
+ * An entry of the cache. Entries are evicted with the CLOCK approximation of
+ * LRU: a hit only sets `referenced`, which can happen under the shared lock,
+ * and eviction skips over (and resets) all the entries that were referenced
+ * since the clock hand last passed them.
+ */
+typedef struct {
+    void *addr;
+    void *load_addr;
+    void *symbol_addr;
+    char *symbol;
+    char *object_name;
+    // one-based index of the next entry in the same bucket
+    size_t next;
+    volatile long referenced;
+} cache_entry_t;
+
+/**
+ * An interned stacktrace. `frames` is the frozen list of unsymbolized frames
+ * for the `len` addresses in `ips`, and `symbolized` is its frozen
+ * symbolized counterpart once it was needed. A new stacktrace simply replaces
+ * whichever one was interned in the same slot.
+ */
+typedef struct {
+    uint64_t hash;
+    void **ips;
+    size_t len;
+    sentry_value_t frames;
+    sentry_value_t symbolized;
+} stacktrace_entry_t;
+
+static sentry_rwlock_t g_lock = SENTRY__RWLOCK_INIT;
+static cache_entry_t g_entries[CACHE_SIZE];
+// one-based index of the first entry of each bucket
+static size_t g_buckets[CACHE_BUCKETS];
+static size_t g_used = 0;
+static size_t g_hand = 0;
+static stacktrace_entry_t g_stacktraces[STACKTRACE_CACHE_SIZE];
+
+static size_t
+bucket_for(void *addr)
+{
+    // fibonacci hashing, instruction addresses are mostly aligned
+    uint64_t h = (uint64_t)(uintptr_t)addr * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (CACHE_BUCKETS - 1);
+}
+
+static cache_entry_t *
+find_entry(void *addr)
+{
+    size_t idx = g_buckets[bucket_for(addr)];
+    while (idx) {
+        cache_entry_t *entry = &g_entries[idx - 1];
+        if (entry->addr == addr) {
+            return entry;
+        }
+        idx = entry->next;
+    }
+    return NULL;
+}
+
+static void
+unlink_entry(size_t idx)
+{
+    size_t *link = &g_buckets[bucket_for(g_entries[idx].addr)];
+    while (*link != idx + 1) {
+        link = &g_entries[*link - 1].next;
+    }
+    *link = g_entries[idx].next;
+}
+
+static void
+free_entry(cache_entry_t *entry)
+{
+    sentry_free(entry->symbol);
+    sentry_free(entry->object_name);
+    memset(entry, 0, sizeof(cache_entry_t));
+}
+
+static size_t
+evict_entry(void)
+{
+    if (g_used < CACHE_SIZE) {
+        return g_used++;
+    }
+    while (g_entries[g_hand].referenced) {
+        g_entries[g_hand].referenced = 0;
+        g_hand = (g_hand + 1) % CACHE_SIZE;
+    }
+    size_t idx = g_hand;
+    g_hand = (g_hand + 1) % CACHE_SIZE;
+    unlink_entry(idx);
+    free_entry(&g_entries[idx]);
+    return idx;
+}
+
+static void
+insert_entry(const sentry_frame_info_t *info)
+{
+    sentry__rwlock_lock(&g_lock);
+    if (!find_entry(info->instruction_addr)) {
+        size_t idx = evict_entry();
+        cache_entry_t *entry = &g_entries[idx];
+        entry->addr = info->instruction_addr;
+        entry->load_addr = info->load_addr;
+        entry->symbol_addr = info->symbol_addr;
+        entry->symbol = sentry__string_clone(info->symbol);
+        entry->object_name = sentry__string_clone(info->object_name);
+        size_t *bucket = &g_buckets[bucket_for(entry->addr)];
+        entry->next = *bucket;
+        *bucket = idx + 1;
+    }
+    sentry__rwlock_unlock(&g_lock);
+}
+
+typedef struct {
+    void (*func)(const sentry_frame_info_t *, void *);
+    void *data;
+    bool found;
+} cache_fill_t;
+
+static void
+fill_cache(const sentry_frame_info_t *info, void *data)
+{
+    cache_fill_t *fill = data;
+    insert_entry(info);
+    fill->func(info, fill->data);
+}
+
+static void
+call_single(const sentry_frame_info_t *info, size_t UNUSED(index), void *data)
+{
+    cache_fill_t *fill = data;
+    fill->func(info, fill->data);
+    fill->found = true;
+}
+
+bool
+sentry__symbolize_uncached(
+    void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data)
+{
+    cache_fill_t fill = { func, data, false };
+    sentry__symbolize_many_uncached(&addr, 1, call_single, &fill);
+    return fill.found;
+}
+
+/**
+ * Looks up `addr` in the cache, and fills `frame_info` from it. The cache
+ * needs to be locked at least shared while `frame_info` is in use.
+ */
+static bool
+lookup_entry(void *addr, sentry_frame_info_t *frame_info)
+{
+    cache_entry_t *entry = find_entry(addr);
+    if (!entry) {
+        return false;
+    }
+    sentry__atomic_store(&entry->referenced, 1);
+    memset(frame_info, 0, sizeof(sentry_frame_info_t));
+    frame_info->load_addr = entry->load_addr;
+    frame_info->symbol_addr = entry->symbol_addr;
+    frame_info->instruction_addr = addr;
+    frame_info->symbol = entry->symbol;
+    frame_info->object_name = entry->object_name;
+    return true;
+}
+
+bool
+sentry__symbolize(
+    void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data)
+{
+    sentry_frame_info_t frame_info;
+    sentry__rwlock_lock_shared(&g_lock);
+    bool found = lookup_entry(addr, &frame_info);
+    if (found) {
+        func(&frame_info, data);
+    }
+    sentry__rwlock_unlock_shared(&g_lock);
+    if (found) {
+        return true;
+    }
+
+    cache_fill_t fill = { func, data, false };
+    return sentry__symbolize_uncached(addr, fill_cache, &fill);
+}
+
+typedef struct {
+    void *addr;
+    size_t index;
+} pending_addr_t;
+
+typedef struct {
+    const pending_addr_t *pending;
+    // the offset into `pending` of each unique address, followed by the
+    // number of pending addresses
+    const size_t *starts;
+    void (*func)(const sentry_frame_info_t *, size_t, void *);
+    void *data;
+    size_t symbolized;
+} batch_fill_t;
+
+static int
+compare_pending(const void *a, const void *b)
+{
+    uintptr_t addr_a = (uintptr_t)((const pending_addr_t *)a)->addr;
+    uintptr_t addr_b = (uintptr_t)((const pending_addr_t *)b)->addr;
+    return addr_a < addr_b ? -1 : addr_a > addr_b ? 1 : 0;
+}
+
+static void
+fill_cache_many(const sentry_frame_info_t *info, size_t unique, void *data)
+{
+    batch_fill_t *fill = data;
+    insert_entry(info);
+    for (size_t i = fill->starts[unique]; i < fill->starts[unique + 1]; i++) {
+        fill->func(info, fill->pending[i].index, fill->data);
+        fill->symbolized++;
+    }
+}
+
+typedef struct {
+    void (*func)(const sentry_frame_info_t *, size_t, void *);
+    size_t index;
+    void *data;
+} single_fill_t;
+
+static void
+fill_single(const sentry_frame_info_t *info, void *data)
+{
+    single_fill_t *fill = data;
+    fill->func(info, fill->index, fill->data);
+}
+
+size_t
+sentry__symbolize_many(void *const *addrs, size_t len,
+    void (*func)(const sentry_frame_info_t *, size_t, void *), void *data)
+{
+    pending_addr_t *pending = sentry_malloc(sizeof(pending_addr_t) * len);
+    void **unique = sentry_malloc(sizeof(void *) * len);
+    size_t *starts = sentry_malloc(sizeof(size_t) * (len + 1));
+    if (!pending || !unique || !starts) {
+        sentry_free(pending);
+        sentry_free(unique);
+        sentry_free(starts);
+        size_t symbolized = 0;
+        for (size_t i = 0; i < len; i++) {
+            single_fill_t fill = { func, i, data };
+            symbolized += sentry__symbolize(addrs[i], fill_single, &fill);
+        }
+        return symbolized;
+    }
+
+    size_t symbolized = 0;
+    size_t pending_len = 0;
+    sentry__rwlock_lock_shared(&g_lock);
+    for (size_t i = 0; i < len; i++) {
+        sentry_frame_info_t frame_info;
+        if (lookup_entry(addrs[i], &frame_info)) {
+            func(&frame_info, i, data);
+            symbolized++;
+        } else {
+            pending[pending_len].addr = addrs[i];
+            pending[pending_len].index = i;
+            pending_len++;
+        }
+    }
+    sentry__rwlock_unlock_shared(&g_lock);
+
+    qsort(pending, pending_len, sizeof(pending_addr_t), compare_pending);
+    size_t unique_len = 0;
+    for (size_t i = 0; i < pending_len; i++) {
+        if (!i || pending[i].addr != pending[i - 1].addr) {
+            unique[unique_len] = pending[i].addr;
+            starts[unique_len] = i;
+            unique_len++;
+        }
+    }
+    starts[unique_len] = pending_len;
+
+    batch_fill_t fill = { pending, starts, func, data, 0 };
+    sentry__symbolize_many_uncached(unique, unique_len, fill_cache_many, &fill);
+    symbolized += fill.symbolized;
+
+    sentry_free(pending);
+    sentry_free(unique);
+    sentry_free(starts);
+    return symbolized;
+}
+
+void
+sentry__symbolize_frame(const sentry_frame_info_t *info, void *data)
+{
+    // See https://develop.sentry.dev/sdk/event-payloads/stacktrace/
+    sentry_value_t frame = *(sentry_value_t *)data;
+
+    if (info->symbol
+        && sentry_value_is_null(sentry_value_get_by_key(frame, "function"))) {
+        sentry_value_set_by_key(
+            frame, "function", sentry_value_new_string(info->symbol));
+    }
+
+    if (info->object_name
+        && sentry_value_is_null(sentry_value_get_by_key(frame, "package"))) {
+        sentry_value_set_by_key(
+            frame, "package", sentry_value_new_string(info->object_name));
+    }
+
+    if (info->symbol_addr
+        && sentry_value_is_null(
+            sentry_value_get_by_key(frame, "symbol_addr"))) {
+        sentry_value_set_by_key(frame, "symbol_addr",
+            sentry__value_new_addr((uint64_t)(size_t)info->symbol_addr));
+    }
+
+    if (info->load_addr
+        && sentry_value_is_null(sentry_value_get_by_key(frame, "image_addr"))) {
+        sentry_value_set_by_key(frame, "image_addr",
+            sentry__value_new_addr((uint64_t)(size_t)info->load_addr));
+    }
+}
+
+static uint64_t
+hash_ips(void *const *ips, size_t len)
+{
+    // FNV-1a over the addresses
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint64_t)(uintptr_t)ips[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+static stacktrace_entry_t *
+stacktrace_slot(uint64_t hash)
+{
+    return &g_stacktraces[hash & (STACKTRACE_CACHE_SIZE - 1)];
+}
+
+static bool
+stacktrace_matches(const stacktrace_entry_t *entry, uint64_t hash,
+    void *const *ips, size_t len)
+{
+    return entry->ips && entry->hash == hash && entry->len == len
+        && memcmp(entry->ips, ips, sizeof(void *) * len) == 0;
+}
+
+static void
+free_stacktrace(stacktrace_entry_t *entry)
+{
+    sentry_free(entry->ips);
+    sentry_value_decref(entry->frames);
+    sentry_value_decref(entry->symbolized);
+    memset(entry, 0, sizeof(stacktrace_entry_t));
+}
+
+static void
+symbolize_interned_frame(
+    const sentry_frame_info_t *info, size_t index, void *data)
+{
+    sentry_value_t frames = *(sentry_value_t *)data;
+    sentry_value_t frame = sentry_value_get_by_index(
+        frames, sentry_value_get_length(frames) - index - 1);
+    sentry__symbolize_frame(info, &frame);
+}
+
+/**
+ * Creates the frozen frames for the `len` addresses in `ips`, with the
+ * outermost frame first. They are allocated from their own arena, so that
+ * they do not keep the arena of the event they were first used in alive.
+ */
+static sentry_value_t
+new_frames(void *const *ips, size_t len, bool symbolize)
+{
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+
+    sentry_value_t frames = sentry__value_new_list_with_size(len);
+    for (size_t i = 0; i < len; i++) {
+        sentry_value_t frame = sentry__value_new_object_with_size(1);
+        sentry_value_set_by_key(frame, SENTRY_KEY(instruction_addr),
+            sentry__value_new_addr((uint64_t)(size_t)ips[len - i - 1]));
+        sentry_value_append(frames, frame);
+    }
+    if (symbolize) {
+        sentry__symbolize_many(ips, len, symbolize_interned_frame, &frames);
+    }
+    sentry_value_freeze(frames);
+
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
+    return frames;
+}
+
+sentry_value_t
+sentry__symbolizer_intern_frames(void *const *ips, size_t len)
+{
+    // interning allocates and locks, which is not safe to do from within our
+    // signal handler
+    if (!len || !sentry__block_for_signal_handler()) {
+        return sentry_value_new_null();
+    }
+    uint64_t hash = hash_ips(ips, len);
+    stacktrace_entry_t *entry = stacktrace_slot(hash);
+
+    sentry_value_t frames = sentry_value_new_null();
+    sentry__rwlock_lock_shared(&g_lock);
+    if (stacktrace_matches(entry, hash, ips, len)) {
+        frames = entry->frames;
+        sentry_value_incref(frames);
+    }
+    sentry__rwlock_unlock_shared(&g_lock);
+    if (!sentry_value_is_null(frames)) {
+        return frames;
+    }
+
+    void **ips_copy = sentry_malloc(sizeof(void *) * len);
+    if (!ips_copy) {
+        return frames;
+    }
+    memcpy(ips_copy, ips, sizeof(void *) * len);
+    frames = new_frames(ips, len, false);
+
+    sentry__rwlock_lock(&g_lock);
+    if (stacktrace_matches(entry, hash, ips, len)) {
+        // another thread interned the same stacktrace in the meantime
+        sentry_free(ips_copy);
+        sentry_value_decref(frames);
+    } else {
+        free_stacktrace(entry);
+        entry->hash = hash;
+        entry->ips = ips_copy;
+        entry->len = len;
+        entry->frames = frames;
+        entry->symbolized = sentry_value_new_null();
+    }
+    frames = entry->frames;
+    sentry_value_incref(frames);
+    sentry__rwlock_unlock(&g_lock);
+    return frames;
+}
+
+sentry_value_t
+sentry__symbolizer_symbolize_frames(sentry_value_t frames)
+{
+    size_t len = sentry_value_get_length(frames);
+    if (sentry_value_get_type(frames) != SENTRY_VALUE_TYPE_LIST || !len
+        || !sentry__block_for_signal_handler()) {
+        return sentry_value_new_null();
+    }
+    void **ips = sentry_malloc(sizeof(void *) * len);
+    if (!ips) {
+        return sentry_value_new_null();
+    }
+    // the frames are rebuilt from their addresses, which is only lossless
+    // for frames that were created by `sentry__symbolizer_intern_frames`
+    for (size_t i = 0; i < len; i++) {
+        sentry_value_t frame = sentry_value_get_by_index(frames, len - i - 1);
+        ips[i] = (void *)(size_t)sentry__value_as_addr(
+            sentry_value_get_by_key(frame, SENTRY_KEY(instruction_addr)));
+        if (!ips[i] || sentry_value_get_length(frame) != 1) {
+            sentry_free(ips);
+            return sentry_value_new_null();
+        }
+    }
+    uint64_t hash = hash_ips(ips, len);
+    stacktrace_entry_t *entry = stacktrace_slot(hash);
+
+    sentry_value_t symbolized = sentry_value_new_null();
+    sentry__rwlock_lock_shared(&g_lock);
+    if (stacktrace_matches(entry, hash, ips, len)) {
+        symbolized = entry->symbolized;
+        sentry_value_incref(symbolized);
+    }
+    sentry__rwlock_unlock_shared(&g_lock);
+
+    if (sentry_value_is_null(symbolized)) {
+        symbolized = new_frames(ips, len, true);
+        // only stacktraces that are still interned keep their symbolized
+        // frames around
+        sentry__rwlock_lock(&g_lock);
+        if (stacktrace_matches(entry, hash, ips, len)) {
+            if (sentry_value_is_null(entry->symbolized)) {
+                sentry_value_incref(symbolized);
+                entry->symbolized = symbolized;
+            } else {
+                sentry_value_decref(symbolized);
+                symbolized = entry->symbolized;
+                sentry_value_incref(symbolized);
+            }
+        }
+        sentry__rwlock_unlock(&g_lock);
+    }
+    sentry_free(ips);
+    return symbolized;
+}
+
+void
+sentry__symbolizer_clear_cache(void)
+{
+    sentry__rwlock_lock(&g_lock);
+    for (size_t i = 0; i < g_used; i++) {
+        free_entry(&g_entries[i]);
+    }
+    for (size_t i = 0; i < STACKTRACE_CACHE_SIZE; i++) {
+        free_stacktrace(&g_stacktraces[i]);
+    }
+    memset(g_buckets, 0, sizeof(g_buckets));
+    g_used = 0;
+    g_hand = 0;
+    sentry__rwlock_unlock(&g_lock);
+}
@@ -186,32 +186,31 @@ dladdr(void *s, Dl_info *i)
 }
 #endif
 
-bool
-sentry__symbolize(
-    void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data)
+void
+sentry__symbolize_many_uncached(void *const *addrs, size_t len,
+    void (*func)(const sentry_frame_info_t *, size_t, void *), void *data)
 {
-    Dl_info info;
-
-    if (dladdr(addr, &info) == 0) {
-        return false;
-    }
+    // `dladdr` finds the module of every address on its own, so there is
+    // nothing to share between the addresses
+    for (size_t i = 0; i < len; i++) {
+        Dl_info info;
+        if (dladdr(addrs[i], &info) == 0) {
+            continue;
+        }
 
-    sentry_frame_info_t frame_info;
-    memset(&frame_info, 0, sizeof(sentry_frame_info_t));
-    frame_info.load_addr = info.dli_fbase;
-    frame_info.symbol_addr = info.dli_saddr;
-    frame_info.instruction_addr = addr;
-    frame_info.symbol = info.dli_sname;
-    frame_info.object_name = info.dli_fname;
-    func(&frame_info, data);
+        sentry_frame_info_t frame_info;
+        memset(&frame_info, 0, sizeof(sentry_frame_info_t));
+        frame_info.load_addr = info.dli_fbase;
+        frame_info.symbol_addr = info.dli_saddr;
+        frame_info.instruction_addr = addrs[i];
+        frame_info.symbol = info.dli_sname;
+        frame_info.object_name = info.dli_fname;
+        func(&frame_info, i, data);
 #ifdef SENTRY_PLATFORM_AIX
-    // On AIX these must be freed. Hope the the callback doesn't use that
-    // buffer...
-    // XXX: We may just be able to stuff it into a fixed-length field of
-    // Dl_info?
-    free(info.dli_sname);
-    free(info.dli_fname);
+        // On AIX these must be freed. Hope the the callback doesn't use that
+        // buffer...
+        free(info.dli_sname);
+        free(info.dli_fname);
 #endif
-
-    return true;
+    }
 }
@@ -8,33 +8,41 @@
 
 #define MAX_SYM 1024
 
-bool
-sentry__symbolize(
-    void *addr, void (*func)(const sentry_frame_info_t *, void *), void *data)
+void
+sentry__symbolize_many_uncached(void *const *addrs, size_t len,
+    void (*func)(const sentry_frame_info_t *, size_t, void *), void *data)
 {
     HANDLE proc = sentry__init_dbghelp();
 
     SYMBOL_INFO *sym = (SYMBOL_INFO *)_alloca(sizeof(SYMBOL_INFO) + MAX_SYM);
-    memset(sym, 0, sizeof(SYMBOL_INFO) + MAX_SYM);
-    sym->MaxNameLen = MAX_SYM;
-    sym->SizeOfStruct = sizeof(SYMBOL_INFO);
-
-    if (!SymFromAddr(proc, (DWORD64)addr, 0, sym)) {
-        return false;
-    }
 
+    // the addresses are sorted, so the ones of the same module follow each
+    // other, and its file name only needs to be looked up once
     char mod_name[MAX_PATH];
-    GetModuleFileNameA(
-        (HMODULE)(size_t)sym->ModBase, mod_name, sizeof(mod_name));
-
-    sentry_frame_info_t frame_info;
-    memset(&frame_info, 0, sizeof(sentry_frame_info_t));
-    frame_info.load_addr = (void *)(size_t)sym->ModBase;
-    frame_info.instruction_addr = addr;
-    frame_info.symbol_addr = (void *)(size_t)sym->Address;
-    frame_info.symbol = sym->Name;
-    frame_info.object_name = mod_name;
-    func(&frame_info, data);
-
-    return true;
+    DWORD64 mod_base = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        memset(sym, 0, sizeof(SYMBOL_INFO) + MAX_SYM);
+        sym->MaxNameLen = MAX_SYM;
+        sym->SizeOfStruct = sizeof(SYMBOL_INFO);
+
+        if (!SymFromAddr(proc, (DWORD64)addrs[i], 0, sym)) {
+            continue;
+        }
+
+        if (!mod_base || sym->ModBase != mod_base) {
+            mod_base = sym->ModBase;
+            GetModuleFileNameA(
+                (HMODULE)(size_t)mod_base, mod_name, sizeof(mod_name));
+        }
+
+        sentry_frame_info_t frame_info;
+        memset(&frame_info, 0, sizeof(sentry_frame_info_t));
+        frame_info.load_addr = (void *)(size_t)sym->ModBase;
+        frame_info.instruction_addr = addrs[i];
+        frame_info.symbol_addr = (void *)(size_t)sym->Address;
+        frame_info.symbol = sym->Name;
+        frame_info.object_name = mod_name;
+        func(&frame_info, i, data);
+    }
 }
@@ -3,9 +3,11 @@
 #include "sentry_database.h"
 #include "sentry_envelope.h"
 #include "sentry_options.h"
+#include "sentry_random.h"
 #include "sentry_ratelimiter.h"
 #include "sentry_string.h"
 #include "sentry_sync.h"
+#include "sentry_tracepoint.h"
 #include "sentry_transport.h"
 #include "sentry_utils.h"
 
@@ -14,20 +16,77 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Failed envelopes are retried up to this many times, with a delay that starts
+// at `RETRY_BASE_DELAY_MS` and doubles with every attempt.
+#define RETRY_MAX_ATTEMPTS 6
+#define RETRY_BASE_DELAY_MS 1000
+
+struct header_info {
+    char *x_sentry_rate_limits;
+    char *retry_after;
+};
+
+/**
+ * The task data of a queued envelope. Up to `max_transfers` queued envelopes
+ * are sent concurrently by the task at the front of the queue, which marks
+ * them as `in_flight`, and releases their `envelope` once they are sent.
+ * The tasks themselves stay in the queue, and are only popped once they reach
+ * its front.
+ */
+typedef struct {
+    sentry_envelope_t *envelope;
+    bool in_flight;
+    // set for envelopes that are being retried, which are spooled to this file
+    sentry_path_t *retry_path;
+    int retry_count;
+} curl_queued_envelope_t;
+
+/**
+ * The task data of a delayed retry of the envelope spooled to `path`.
+ */
+typedef struct {
+    sentry_path_t *path;
+    int retry_count;
+} curl_retry_t;
+
+typedef struct {
+    CURL *curl_handle;
+    curl_queued_envelope_t *queued;
+    sentry_prepared_http_request_t *req;
+    struct curl_slist *headers;
+    sentry_envelope_body_reader_t reader;
+    struct header_info info;
+    uint64_t started;
+} curl_transfer_t;
+
 typedef struct curl_transport_state_s {
     sentry_dsn_t *dsn;
-    CURL *curl_handle;
+    sentry_bgworker_t *bgworker;
+    CURLM *multi_handle;
+    CURLSH *share_handle;
+    // a copy of the run, which the envelopes that are retried are spooled to
+    sentry_run_t *run;
+    curl_transfer_t *transfers;
+    size_t max_transfers;
+    size_t active_transfers;
     char *http_proxy;
     char *ca_certs;
     sentry_rate_limiter_t *ratelimiter;
+    sentry_transport_stats_t *stats;
+    // the headers that are the same for every request, which are shared by
+    // the header lists of all the transfers
+    struct curl_slist *static_headers;
+    uint64_t connect_timeout;
+    uint64_t request_timeout;
+    size_t low_speed_limit;
+    uint64_t low_speed_time;
+    bool tcp_nodelay;
+    bool tcp_keepalive;
+    sentry_ip_resolve_t ip_resolve;
+    uint64_t happy_eyeballs_timeout;
     bool debug;
 } curl_bgworker_state_t;
 
-struct header_info {
-    char *x_sentry_rate_limits;
-    char *retry_after;
-};
-
 static curl_bgworker_state_t *
 sentry__curl_bgworker_state_new(void)
 {
@@ -38,6 +97,7 @@ sentry__curl_bgworker_state_new(void)
     memset(state, 0, sizeof(curl_bgworker_state_t));
 
     state->ratelimiter = sentry__rate_limiter_new();
+    state->stats = sentry__transport_stats_new();
 
     return state;
 }
@@ -46,16 +106,121 @@ static void
 sentry__curl_bgworker_state_free(void *_state)
 {
     curl_bgworker_state_t *state = _state;
-    if (state->curl_handle) {
-        curl_easy_cleanup(state->curl_handle);
+    for (size_t i = 0; state->transfers && i < state->max_transfers; i++) {
+        if (state->transfers[i].curl_handle) {
+            curl_easy_cleanup(state->transfers[i].curl_handle);
+        }
+    }
+    sentry_free(state->transfers);
+    if (state->multi_handle) {
+        curl_multi_cleanup(state->multi_handle);
+    }
+    if (state->share_handle) {
+        curl_share_cleanup(state->share_handle);
     }
     sentry__dsn_decref(state->dsn);
+    sentry__run_free(state->run);
     sentry__rate_limiter_free(state->ratelimiter);
+    sentry__transport_stats_free(state->stats);
+    curl_slist_free_all(state->static_headers);
     sentry_free(state->ca_certs);
     sentry_free(state->http_proxy);
     sentry_free(state);
 }
 
+/**
+ * Sets the options of `curl` that are related to the connection, which are
+ * the same for every request.
+ */
+static void
+setup_connection(curl_bgworker_state_t *state, CURL *curl)
+{
+    if (state->share_handle) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, state->share_handle);
+    }
+    // keeps idle connections from being dropped by firewalls and NATs
+    curl_easy_setopt(
+        curl, CURLOPT_TCP_KEEPALIVE, (long)(state->tcp_keepalive ? 1 : 0));
+    curl_easy_setopt(
+        curl, CURLOPT_TCP_NODELAY, (long)(state->tcp_nodelay ? 1 : 0));
+    if (state->connect_timeout) {
+        curl_easy_setopt(
+            curl, CURLOPT_CONNECTTIMEOUT_MS, (long)state->connect_timeout);
+    }
+    if (state->request_timeout) {
+        curl_easy_setopt(
+            curl, CURLOPT_TIMEOUT_MS, (long)state->request_timeout);
+    }
+    // a hung request would otherwise block the worker until the operating
+    // system gives up on the connection
+    if (state->low_speed_time) {
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
+            (long)(state->low_speed_limit ? state->low_speed_limit : 1));
+        // curl only takes whole seconds
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME,
+            (long)((state->low_speed_time + 999) / 1000));
+    }
+    switch (state->ip_resolve) {
+    case SENTRY_IP_RESOLVE_V4:
+        curl_easy_setopt(curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
+        break;
+    case SENTRY_IP_RESOLVE_V6:
+        curl_easy_setopt(curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
+        break;
+    case SENTRY_IP_RESOLVE_ANY:
+    default:
+        break;
+    }
+#if LIBCURL_VERSION_NUM >= 0x073b00
+    if (state->happy_eyeballs_timeout) {
+        curl_easy_setopt(curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS,
+            (long)state->happy_eyeballs_timeout);
+    }
+#endif
+    if (state->http_proxy) {
+        curl_easy_setopt(curl, CURLOPT_PROXY, state->http_proxy);
+    }
+    if (state->ca_certs) {
+        curl_easy_setopt(curl, CURLOPT_CAINFO, state->ca_certs);
+    }
+}
+
+/**
+ * Connects to the DSN host ahead of the first envelope, which fills the
+ * shared DNS and TLS session caches, so that the first request does not have
+ * to wait for a full lookup and handshake.
+ */
+static void
+sentry__curl_warmup_task(void *UNUSED(task_data), void *_state)
+{
+    curl_bgworker_state_t *state = (curl_bgworker_state_t *)_state;
+    const char *url = state->dsn ? state->dsn->envelope_url : NULL;
+    CURL *curl = url ? curl_easy_init() : NULL;
+    if (!curl) {
+        return;
+    }
+    if (state->debug) {
+        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, (long)1);
+    setup_connection(state, curl);
+
+    CURLcode rv = curl_easy_perform(curl);
+    if (rv != CURLE_OK) {
+        SENTRY_DEBUGF(
+            "warming up the connection failed with code `%d`", (int)rv);
+    }
+    curl_easy_cleanup(curl);
+}
+
+static bool
+curl_queued_envelope_can_drop(void *task_data)
+{
+    // envelopes that are being sent are still in use by the worker
+    return !((curl_queued_envelope_t *)task_data)->in_flight;
+}
+
 static int
 sentry__curl_transport_start(
     const sentry_options_t *options, void *transport_state)
@@ -73,20 +238,74 @@ sentry__curl_transport_start(
     curl_bgworker_state_t *state = sentry__bgworker_get_state(bgworker);
 
     state->dsn = sentry__dsn_incref(options->dsn);
+    state->bgworker = bgworker;
     state->http_proxy = sentry__string_clone(options->http_proxy);
     state->ca_certs = sentry__string_clone(options->ca_certs);
-    state->curl_handle = curl_easy_init();
     state->debug = options->debug;
+    state->connect_timeout = options->transport_connect_timeout;
+    state->request_timeout = options->transport_request_timeout;
+    state->low_speed_limit = options->transport_low_speed_limit;
+    state->low_speed_time = options->transport_low_speed_time;
+    state->tcp_nodelay = options->transport_tcp_nodelay;
+    state->tcp_keepalive = options->transport_tcp_keepalive;
+    state->ip_resolve = options->transport_ip_resolve;
+    state->happy_eyeballs_timeout = options->transport_happy_eyeballs_timeout;
+    if (options->run) {
+        state->run = sentry__run_clone(options->run);
+    }
 
     sentry__bgworker_setname(bgworker, options->transport_thread_name);
+    sentry__bgworker_set_queue_limits(bgworker,
+        options->transport_max_queue_size, options->transport_max_queue_bytes,
+        curl_queued_envelope_can_drop);
+
+    // In case of failure we don’t start the worker at all, which means we can
+    // still dump all unsent envelopes to disk on shutdown.
+    state->multi_handle = curl_multi_init();
+    if (!state->multi_handle) {
+        SENTRY_WARN("`curl_multi_init` failed");
+        return 1;
+    }
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    // concurrent requests to the same host share a single HTTP/2 connection
+    curl_multi_setopt(
+        state->multi_handle, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
+
+    // DNS lookups and TLS sessions are shared between all transfers, so that
+    // they outlive their connections, which are pooled by the multi handle.
+    // All of the handles are only used by the worker thread, so no locking
+    // is needed.
+    state->share_handle = curl_share_init();
+    if (state->share_handle) {
+        curl_share_setopt(
+            state->share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(
+            state->share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
 
-    if (!state->curl_handle) {
-        // In this case we don’t start the worker at all, which means we can
-        // still dump all unsent envelopes to disk on shutdown.
-        SENTRY_WARN("`curl_easy_init` failed");
+    size_t max_transfers = options->transport_max_concurrent_requests;
+    state->max_transfers = max_transfers ? max_transfers : 1;
+    state->transfers
+        = sentry_malloc(sizeof(curl_transfer_t) * state->max_transfers);
+    if (!state->transfers) {
         return 1;
     }
-    return sentry__bgworker_start(bgworker);
+    memset(state->transfers, 0, sizeof(curl_transfer_t) * state->max_transfers);
+    for (size_t i = 0; i < state->max_transfers; i++) {
+        state->transfers[i].curl_handle = curl_easy_init();
+        if (!state->transfers[i].curl_handle) {
+            SENTRY_WARN("`curl_easy_init` failed");
+            return 1;
+        }
+    }
+    if (sentry__bgworker_start(bgworker)) {
+        return 1;
+    }
+    if (options->transport_warmup) {
+        sentry__bgworker_submit(bgworker, sentry__curl_warmup_task, NULL, NULL);
+    }
+    return 0;
 }
 
 static int
@@ -100,7 +319,9 @@ static int
 sentry__curl_transport_shutdown(uint64_t timeout, void *transport_state)
 {
     sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
-    return sentry__bgworker_shutdown(bgworker, timeout);
+    int rv = sentry__bgworker_shutdown(bgworker, timeout);
+    sentry__transport_log_dropped_envelopes(bgworker);
+    return rv;
 }
 
 static size_t
@@ -110,6 +331,29 @@ swallow_data(
     return size * nmemb;
 }
 
+static size_t
+read_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    return sentry__envelope_body_read(
+        (sentry_envelope_body_reader_t *)userdata, buffer, size * nitems);
+}
+
+static int
+seek_callback(void *userdata, curl_off_t offset, int origin)
+{
+    // curl only seeks when it has to rewind the body, for example on
+    // redirects, so anything other than rewinding to the start is left to
+    // curl, which can skip ahead by reading
+    if (origin != SEEK_SET || offset != 0) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    sentry_envelope_body_reader_t *reader = userdata;
+    const sentry_serialized_envelope_t *body = reader->body;
+    sentry__envelope_body_reader_cleanup(reader);
+    sentry__envelope_body_reader_init(reader, body);
+    return CURL_SEEKFUNC_OK;
+}
+
 static size_t
 header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
 {
@@ -135,32 +379,97 @@ header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
     return bytes;
 }
 
+static struct curl_slist *
+append_header(
+    struct curl_slist *headers, const sentry_prepared_http_header_t *h)
+{
+    char buf[255];
+    size_t written
+        = (size_t)snprintf(buf, sizeof(buf), "%s:%s", h->key, h->value);
+    if (written >= sizeof(buf)) {
+        return headers;
+    }
+    return curl_slist_append(headers, buf);
+}
+
+/**
+ * Returns the header list of `req`, which starts with the headers that differ
+ * between requests, followed by the static headers of the transport, which are
+ * only rendered once.
+ */
+static struct curl_slist *
+build_request_headers(
+    curl_bgworker_state_t *state, const sentry_prepared_http_request_t *req)
+{
+    if (!state->static_headers) {
+        state->static_headers = curl_slist_append(NULL, "expect:");
+        for (size_t i = 0; i < req->static_headers_len; i++) {
+            state->static_headers
+                = append_header(state->static_headers, &req->headers[i]);
+        }
+    }
+
+    struct curl_slist *headers = NULL;
+    for (size_t i = req->static_headers_len; i < req->headers_len; i++) {
+        headers = append_header(headers, &req->headers[i]);
+    }
+    if (!headers) {
+        return state->static_headers;
+    }
+    struct curl_slist *last = headers;
+    while (last->next) {
+        last = last->next;
+    }
+    last->next = state->static_headers;
+    return headers;
+}
+
+/**
+ * Frees the header list built by `build_request_headers`, without the static
+ * headers it shares.
+ */
 static void
-sentry__curl_send_task(void *_envelope, void *_state)
+free_request_headers(curl_bgworker_state_t *state, struct curl_slist *headers)
 {
-    sentry_envelope_t *envelope = (sentry_envelope_t *)_envelope;
-    curl_bgworker_state_t *state = (curl_bgworker_state_t *)_state;
+    if (!headers || headers == state->static_headers) {
+        return;
+    }
+    struct curl_slist *last = headers;
+    while (last->next && last->next != state->static_headers) {
+        last = last->next;
+    }
+    last->next = NULL;
+    curl_slist_free_all(headers);
+}
+
+static void sentry__curl_send_task(void *_queued, void *_state);
 
+/**
+ * Starts sending the envelope of `queued` using `transfer`.
+ * Returns false if there is nothing to send because of rate limits.
+ */
+static bool
+start_transfer(curl_bgworker_state_t *state, curl_transfer_t *transfer,
+    curl_queued_envelope_t *queued)
+{
+    sentry__transport_stats_record_rate_limits(
+        state->stats, queued->envelope, state->ratelimiter);
     sentry_prepared_http_request_t *req = sentry__prepare_http_request(
-        envelope, state->dsn, state->ratelimiter);
+        queued->envelope, state->dsn, state->ratelimiter);
     if (!req) {
-        return;
+        return false;
     }
 
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "expect:");
-    for (size_t i = 0; i < req->headers_len; i++) {
-        char buf[255];
-        size_t written = (size_t)snprintf(buf, sizeof(buf), "%s:%s",
-            req->headers[i].key, req->headers[i].value);
-        if (written >= sizeof(buf)) {
-            continue;
-        }
-        buf[written] = '\0';
-        headers = curl_slist_append(headers, buf);
-    }
+    struct curl_slist *headers = build_request_headers(state, req);
 
-    CURL *curl = state->curl_handle;
+    transfer->queued = queued;
+    transfer->req = req;
+    transfer->headers = headers;
+    transfer->info.retry_after = NULL;
+    transfer->info.x_sentry_rate_limits = NULL;
+    transfer->started = sentry__monotonic_time();
+
+    CURL *curl = transfer->curl_handle;
     curl_easy_reset(curl);
     if (state->debug) {
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
@@ -169,50 +478,316 @@ sentry__curl_send_task(void *_envelope, void *_state)
     } else {
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, swallow_data);
     }
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)transfer);
     curl_easy_setopt(curl, CURLOPT_URL, req->url);
     curl_easy_setopt(curl, CURLOPT_POST, (long)1);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->body);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)req->body_len);
+    // the body is streamed from its segments, which avoids copying the
+    // payloads into one contiguous buffer
+    sentry__envelope_body_reader_init(&transfer->reader, &req->body);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, (void *)&transfer->reader);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seek_callback);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, (void *)&transfer->reader);
+    curl_easy_setopt(
+        curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)req->body.total_len);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, SENTRY_SDK_USER_AGENT);
-
-    struct header_info info;
-    info.retry_after = NULL;
-    info.x_sentry_rate_limits = NULL;
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)&info);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)&transfer->info);
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    // rather wait for an existing connection to multiplex on than opening a
+    // new one for every concurrent request
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, (long)1);
+#endif
+
+    setup_connection(state, curl);
+
+    SENTRY_TRACEPOINT1(transport__send__start, req->body.total_len);
+    curl_multi_add_handle(state->multi_handle, curl);
+    state->active_transfers++;
+    return true;
+}
 
-    if (state->http_proxy) {
-        curl_easy_setopt(curl, CURLOPT_PROXY, state->http_proxy);
+static bool
+claim_queued_envelope(void *task_data, void *_state)
+{
+    curl_bgworker_state_t *state = (curl_bgworker_state_t *)_state;
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)task_data;
+    if (!queued->envelope || queued->in_flight
+        || state->active_transfers >= state->max_transfers) {
+        return false;
     }
-    if (state->ca_certs) {
-        curl_easy_setopt(curl, CURLOPT_CAINFO, state->ca_certs);
+
+    curl_transfer_t *transfer = NULL;
+    for (size_t i = 0; !transfer && i < state->max_transfers; i++) {
+        if (!state->transfers[i].queued) {
+            transfer = &state->transfers[i];
+        }
+    }
+    if (start_transfer(state, transfer, queued)) {
+        queued->in_flight = true;
+    } else {
+        sentry_envelope_free(queued->envelope);
+        queued->envelope = NULL;
     }
+    return false;
+}
 
-    CURLcode rv = curl_easy_perform(curl);
+static bool
+coalesce_queued_envelope(void *task_data, void *_target)
+{
+    sentry_envelope_t **target = (sentry_envelope_t **)_target;
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)task_data;
+    if (!queued->envelope || queued->in_flight) {
+        return false;
+    }
+    if (*target && sentry__envelope_merge_sessions(*target, queued->envelope)) {
+        // the task is dropped from the queue, which frees it
+        sentry_envelope_free(queued->envelope);
+        queued->envelope = NULL;
+        return true;
+    }
+    *target = queued->envelope;
+    return false;
+}
+
+/**
+ * Claims as many queued envelopes as there are free transfers, after moving
+ * queued sessions into the envelopes queued before them, which saves a
+ * request for each of them.
+ */
+static void
+claim_queued_envelopes(curl_bgworker_state_t *state)
+{
+    sentry_envelope_t *target = NULL;
+    sentry__bgworker_foreach_matching(state->bgworker, sentry__curl_send_task,
+        coalesce_queued_envelope, &target);
+    sentry__bgworker_foreach_matching(state->bgworker, sentry__curl_send_task,
+        claim_queued_envelope, state);
+}
+
+static bool
+release_queued_envelope(void *task_data, void *queued_envelope)
+{
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)task_data;
+    if (queued == queued_envelope) {
+        sentry_envelope_free(queued->envelope);
+        queued->envelope = NULL;
+        queued->in_flight = false;
+    }
+    return false;
+}
 
+static void
+curl_queued_envelope_free(void *_queued)
+{
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)_queued;
+    sentry_envelope_free(queued->envelope);
+    sentry__path_free(queued->retry_path);
+    sentry_free(queued);
+}
+
+static void
+curl_retry_free(void *_retry)
+{
+    curl_retry_t *retry = (curl_retry_t *)_retry;
+    sentry__path_free(retry->path);
+    sentry_free(retry);
+}
+
+/**
+ * Queues the envelope spooled to the file of `_retry` again.
+ */
+static void
+sentry__curl_retry_task(void *_retry, void *_state)
+{
+    curl_retry_t *retry = (curl_retry_t *)_retry;
+    curl_bgworker_state_t *state = (curl_bgworker_state_t *)_state;
+    // the spooled file is kept until the envelope was sent, so that large
+    // attachments can be uploaded straight from it
+    sentry_envelope_t *envelope
+        = sentry__envelope_from_path_streamed(retry->path);
+    curl_queued_envelope_t *queued
+        = envelope ? SENTRY_MAKE(curl_queued_envelope_t) : NULL;
+    if (!queued) {
+        sentry_envelope_free(envelope);
+        return;
+    }
+    queued->envelope = envelope;
+    queued->in_flight = false;
+    queued->retry_path = retry->path;
+    queued->retry_count = retry->retry_count;
+    retry->path = NULL;
+    sentry__bgworker_submit_bounded(state->bgworker, sentry__curl_send_task,
+        curl_queued_envelope_free, queued,
+        sentry__envelope_get_task_priority(envelope),
+        sentry__envelope_get_memory_usage(envelope));
+}
+
+/**
+ * Spools the envelope of `queued`, which failed to send, to the run directory,
+ * and schedules a retry with exponential backoff and jitter, which waits for
+ * the rate limits to expire. Envelopes which are not retried anymore move to
+ * the offline backlog, which outlives the run, and are sent on the next start
+ * instead.
+ */
+static void
+schedule_retry(curl_bgworker_state_t *state, curl_queued_envelope_t *queued)
+{
+    if (!state->run) {
+        return;
+    }
+    if (queued->retry_count >= RETRY_MAX_ATTEMPTS) {
+        SENTRY_WARN("giving up on retrying envelope until the next start");
+        if (sentry__run_write_offline_envelope(state->run, queued->envelope)
+            && queued->retry_path) {
+            sentry__path_remove(queued->retry_path);
+        }
+        return;
+    }
+    sentry_path_t *path = queued->retry_path
+        ? sentry__path_clone(queued->retry_path)
+        : sentry__run_write_spooled_envelope(state->run, queued->envelope);
+    if (!path) {
+        return;
+    }
+
+    uint64_t delay_ms = (uint64_t)RETRY_BASE_DELAY_MS << queued->retry_count;
+    uint32_t jitter = 0;
+    if (sentry__getrandom(&jitter, sizeof(jitter)) == 0) {
+        delay_ms += jitter % (delay_ms / 2 + 1);
+    }
+    uint64_t now = sentry__monotonic_time();
+    uint64_t disabled_until = sentry__rate_limiter_get_disabled_until(
+        state->ratelimiter, SENTRY_RL_CATEGORY_ANY);
+    if (disabled_until > now + delay_ms) {
+        delay_ms = disabled_until - now;
+    }
+
+    curl_retry_t *retry = SENTRY_MAKE(curl_retry_t);
+    if (!retry) {
+        sentry__path_free(path);
+        return;
+    }
+    retry->path = path;
+    retry->retry_count = queued->retry_count + 1;
+    SENTRY_DEBUGF("retrying envelope in %" PRIu64 "ms", delay_ms);
+    sentry__bgworker_submit_delayed(state->bgworker, sentry__curl_retry_task,
+        curl_retry_free, retry, delay_ms, NULL);
+}
+
+static void
+finish_transfer(
+    curl_bgworker_state_t *state, curl_transfer_t *transfer, CURLcode rv)
+{
+    CURL *curl = transfer->curl_handle;
+    // network errors and server errors are worth retrying
+    bool retry = true;
+    long response_code = 0;
     if (rv == CURLE_OK) {
-        long response_code;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        retry = response_code >= 500;
 
-        if (info.x_sentry_rate_limits) {
+        struct header_info *info = &transfer->info;
+        if (info->x_sentry_rate_limits) {
             sentry__rate_limiter_update_from_header(
-                state->ratelimiter, info.x_sentry_rate_limits);
-        } else if (info.retry_after) {
+                state->ratelimiter, info->x_sentry_rate_limits);
+        } else if (info->retry_after) {
             sentry__rate_limiter_update_from_http_retry_after(
-                state->ratelimiter, info.retry_after);
+                state->ratelimiter, info->retry_after);
         } else if (response_code == 429) {
             sentry__rate_limiter_update_from_429(state->ratelimiter);
         }
     } else {
-        SENTRY_WARNF(
-            "sending via `curl_easy_perform` failed with code `%d`", (int)rv);
+        SENTRY_WARNF("sending via curl failed with code `%d`", (int)rv);
+    }
+    curl_multi_remove_handle(state->multi_handle, curl);
+    state->active_transfers--;
+    SENTRY_TRACEPOINT1(transport__send__end, response_code);
+
+    sentry_prepared_http_request_t *req = transfer->req;
+    sentry__transport_stats_record_request(state->stats,
+        sentry__monotonic_time() - transfer->started,
+        rv == CURLE_OK ? req->body.total_len : 0, req->uncompressed_len,
+        response_code, (long)rv);
+
+    curl_queued_envelope_t *queued = transfer->queued;
+    if (retry) {
+        schedule_retry(state, queued);
+    } else if (queued->retry_path) {
+        sentry__path_remove(queued->retry_path);
     }
 
-    curl_slist_free_all(headers);
-    sentry_free(info.retry_after);
-    sentry_free(info.x_sentry_rate_limits);
-    sentry__prepared_http_request_free(req);
+    // the queued envelope is released while holding the queue lock, as it
+    // might concurrently be dumped to disk
+    sentry__bgworker_foreach_matching(state->bgworker, sentry__curl_send_task,
+        release_queued_envelope, transfer->queued);
+
+    sentry__envelope_body_reader_cleanup(&transfer->reader);
+    free_request_headers(state, transfer->headers);
+    sentry_free(transfer->info.retry_after);
+    sentry_free(transfer->info.x_sentry_rate_limits);
+    sentry__prepared_http_request_free(transfer->req);
+    transfer->queued = NULL;
+    transfer->req = NULL;
+    transfer->headers = NULL;
+}
+
+static void
+sentry__curl_send_task(void *_queued, void *_state)
+{
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)_queued;
+    curl_bgworker_state_t *state = (curl_bgworker_state_t *)_state;
+    if (!queued->envelope) {
+        // already sent along with an earlier envelope
+        return;
+    }
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_TRANSPORT);
+    sentry__transport_stats_record_queue_depth(
+        state->stats, sentry__bgworker_get_queue_depth(state->bgworker));
+
+    // this envelope, and as many of the following ones as there are free
+    // transfers are sent concurrently, picking up envelopes that are queued in
+    // the meantime whenever a transfer is free
+    claim_queued_envelopes(state);
+    while (state->active_transfers) {
+        int running = 0;
+        CURLMcode mrv = curl_multi_perform(state->multi_handle, &running);
+
+        CURLMsg *msg;
+        int remaining = 0;
+        while ((msg = curl_multi_info_read(state->multi_handle, &remaining))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            char *transfer = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+            finish_transfer(
+                state, (curl_transfer_t *)transfer, msg->data.result);
+        }
+
+        if (mrv != CURLM_OK) {
+            SENTRY_WARNF(
+                "`curl_multi_perform` failed with code `%d`", (int)mrv);
+            for (size_t i = 0; i < state->max_transfers; i++) {
+                if (state->transfers[i].queued) {
+                    finish_transfer(
+                        state, &state->transfers[i], CURLE_SEND_ERROR);
+                }
+            }
+            break;
+        }
+        int timeout_ms = 1000;
+        if (state->active_transfers < state->max_transfers) {
+            claim_queued_envelopes(state);
+            timeout_ms = 50;
+        }
+        if (state->active_transfers) {
+            curl_multi_wait(state->multi_handle, NULL, 0, timeout_ms, NULL);
+        }
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
 }
 
 static void
@@ -220,15 +795,49 @@ sentry__curl_transport_send_envelope(
     sentry_envelope_t *envelope, void *transport_state)
 {
     sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
-    sentry__bgworker_submit(bgworker, sentry__curl_send_task,
-        (void (*)(void *))sentry_envelope_free, envelope);
+    curl_queued_envelope_t *queued = SENTRY_MAKE(curl_queued_envelope_t);
+    if (!queued) {
+        sentry_envelope_free(envelope);
+        return;
+    }
+    queued->envelope = envelope;
+    queued->in_flight = false;
+    queued->retry_path = NULL;
+    queued->retry_count = 0;
+    sentry__bgworker_submit_bounded(bgworker, sentry__curl_send_task,
+        curl_queued_envelope_free, queued,
+        sentry__envelope_get_task_priority(envelope),
+        sentry__envelope_get_memory_usage(envelope));
+
+    curl_bgworker_state_t *state = sentry__bgworker_get_state(bgworker);
+    sentry__transport_stats_record_queue_depth(
+        state->stats, sentry__bgworker_get_queue_depth(bgworker));
+}
+
+typedef struct {
+    sentry_run_t *run;
+    size_t dumped;
+} curl_dump_state_t;
+
+static bool
+sentry__curl_dump_task(void *_queued, void *_dump_state)
+{
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)_queued;
+    curl_dump_state_t *dump_state = (curl_dump_state_t *)_dump_state;
+    if (queued->envelope) {
+        // retried envelopes are already spooled to the run directory
+        if (!queued->retry_path) {
+            sentry__run_write_envelope(dump_state->run, queued->envelope);
+        }
+        dump_state->dumped++;
+    }
+    // envelopes that are being sent are still in use by the worker
+    return !queued->in_flight;
 }
 
 static bool
-sentry__curl_dump_task(void *envelope, void *run)
+sentry__curl_drop_retry_task(void *UNUSED(retry), void *UNUSED(data))
 {
-    sentry__run_write_envelope(
-        (sentry_run_t *)run, (sentry_envelope_t *)envelope);
     return true;
 }
 
@@ -236,8 +845,34 @@ size_t
 sentry__curl_dump_queue(sentry_run_t *run, void *transport_state)
 {
     sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
-    return sentry__bgworker_foreach_matching(
-        bgworker, sentry__curl_send_task, sentry__curl_dump_task, run);
+    curl_dump_state_t dump_state = { run, 0 };
+    sentry__bgworker_foreach_matching(
+        bgworker, sentry__curl_send_task, sentry__curl_dump_task, &dump_state);
+    // pending retries are already spooled to the run directory, and need to
+    // be counted so that it is kept
+    dump_state.dumped += sentry__bgworker_foreach_matching(bgworker,
+        sentry__curl_retry_task, sentry__curl_drop_retry_task, NULL);
+    return dump_state.dumped;
+}
+
+static bool
+sentry__curl_memory_usage_task(void *_queued, void *size)
+{
+    curl_queued_envelope_t *queued = (curl_queued_envelope_t *)_queued;
+    if (queued->envelope) {
+        *(size_t *)size += sentry__envelope_get_memory_usage(queued->envelope);
+    }
+    return false;
+}
+
+static size_t
+sentry__curl_memory_usage(void *transport_state)
+{
+    sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
+    size_t size = 0;
+    sentry__bgworker_foreach_matching(bgworker, sentry__curl_send_task,
+        sentry__curl_memory_usage_task, &size);
+    return size;
 }
 
 sentry_transport_t *
@@ -269,6 +904,13 @@ sentry__transport_new_default(void)
     sentry_transport_set_shutdown_func(
         transport, sentry__curl_transport_shutdown);
     sentry__transport_set_dump_func(transport, sentry__curl_dump_queue);
+    sentry__transport_set_bgworker(transport, bgworker);
+    sentry__transport_set_rate_limiter(transport, state->ratelimiter);
+    sentry__transport_set_stats(transport, state->stats);
+    sentry__transport_set_memory_usage_func(
+        transport, sentry__curl_memory_usage);
+    sentry__transport_set_factory_func(
+        transport, sentry__transport_new_default);
 
     return transport;
 }
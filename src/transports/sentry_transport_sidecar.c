@@ -0,0 +1,135 @@
+#include "sentry_alloc.h"
+#include "sentry_core.h"
+#include "sentry_envelope.h"
+#include "sentry_path.h"
+#include "sentry_sidecar.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+
+#define SIDECAR_DEFAULT_CAPACITY (8 * 1024 * 1024)
+
+typedef struct {
+    sentry_path_t *directory;
+    size_t capacity;
+    sentry_mutex_t lock;
+    sentry_sidecar_ring_t *ring;
+} sidecar_transport_state_t;
+
+static void
+sidecar_transport_state_free(void *_state)
+{
+    sidecar_transport_state_t *state = _state;
+    sentry__sidecar_ring_free(state->ring);
+    sentry__path_free(state->directory);
+    sentry__mutex_free(&state->lock);
+    sentry_free(state);
+}
+
+static int
+sidecar_transport_start(const sentry_options_t *UNUSED(options), void *_state)
+{
+    sidecar_transport_state_t *state = _state;
+    if (state->ring) {
+        if (sentry__sidecar_ring_is_own(state->ring)) {
+            return 0;
+        }
+        // this is a forked child, which must not produce into the ring of its
+        // parent, and whose lock may have been held by another thread
+        sentry__sidecar_ring_abandon(state->ring);
+        state->ring = NULL;
+        sentry__mutex_init(&state->lock);
+    }
+
+    if (sentry__path_create_dir_all(state->directory) != 0) {
+        SENTRY_WARN("failed to create the sidecar directory");
+        return 1;
+    }
+    sentry_uuid_t uuid = sentry_uuid_new_v4();
+    char filename[37 + sizeof(SENTRY_SIDECAR_RING_EXT)];
+    sentry_uuid_as_string(&uuid, filename);
+    filename[36] = '.';
+    memcpy(filename + 37, SENTRY_SIDECAR_RING_EXT,
+        sizeof(SENTRY_SIDECAR_RING_EXT));
+    sentry_path_t *path = sentry__path_join_str(state->directory, filename);
+    sentry_sidecar_ring_t *ring
+        = path ? sentry__sidecar_ring_new(path, state->capacity) : NULL;
+    sentry__path_free(path);
+    if (!ring) {
+        SENTRY_WARN("failed to create the sidecar ring");
+        return 1;
+    }
+
+    sentry__mutex_lock(&state->lock);
+    state->ring = ring;
+    sentry__mutex_unlock(&state->lock);
+    return 0;
+}
+
+static int
+sidecar_transport_shutdown(uint64_t UNUSED(timeout), void *_state)
+{
+    sidecar_transport_state_t *state = _state;
+    // the ring is left for the uploader, which removes it once it sent all
+    // the envelopes that are in it
+    sentry__mutex_lock(&state->lock);
+    sentry_sidecar_ring_t *ring = state->ring;
+    state->ring = NULL;
+    sentry__mutex_unlock(&state->lock);
+    sentry__sidecar_ring_free(ring);
+    return 0;
+}
+
+static void
+sidecar_transport_send_envelope(sentry_envelope_t *envelope, void *_state)
+{
+    sidecar_transport_state_t *state = _state;
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry__envelope_serialize_into_stringbuilder(envelope, &sb);
+    sentry_envelope_free(envelope);
+
+    int rv = 1;
+    sentry__mutex_lock(&state->lock);
+    if (state->ring) {
+        rv = sentry__sidecar_ring_push(
+            state->ring, sb.buf, sentry__stringbuilder_len(&sb));
+    }
+    sentry__mutex_unlock(&state->lock);
+    sentry__stringbuilder_cleanup(&sb);
+    if (rv != 0) {
+        SENTRY_WARN("dropping envelope, since the sidecar ring is full");
+    }
+}
+
+sentry_transport_t *
+sentry_new_sidecar_transport(const char *directory, size_t capacity)
+{
+    SENTRY_DEBUG("initializing sidecar transport");
+    if (!directory) {
+        return NULL;
+    }
+    sidecar_transport_state_t *state = SENTRY_MAKE(sidecar_transport_state_t);
+    if (!state) {
+        return NULL;
+    }
+    memset(state, 0, sizeof(*state));
+    sentry__mutex_init(&state->lock);
+    state->capacity = capacity ? capacity : SIDECAR_DEFAULT_CAPACITY;
+    state->directory = sentry__path_from_str(directory);
+    if (!state->directory) {
+        sidecar_transport_state_free(state);
+        return NULL;
+    }
+
+    sentry_transport_t *transport
+        = sentry_transport_new(sidecar_transport_send_envelope);
+    if (!transport) {
+        sidecar_transport_state_free(state);
+        return NULL;
+    }
+    sentry_transport_set_state(transport, state);
+    sentry_transport_set_free_func(transport, sidecar_transport_state_free);
+    sentry_transport_set_startup_func(transport, sidecar_transport_start);
+    sentry_transport_set_shutdown_func(transport, sidecar_transport_shutdown);
+    return transport;
+}
@@ -6,6 +6,7 @@
 #include "sentry_ratelimiter.h"
 #include "sentry_string.h"
 #include "sentry_sync.h"
+#include "sentry_tracepoint.h"
 #include "sentry_transport.h"
 #include "sentry_utils.h"
 
@@ -13,14 +14,59 @@
 #include <string.h>
 #include <winhttp.h>
 
+// The body is written to the request in chunks of this size.
+#define CHUNK_SIZE 16384
+
+/**
+ * The task data of a queued envelope. In async mode, up to `max_transfers`
+ * queued envelopes are sent concurrently by the task at the front of the
+ * queue, which marks them as `in_flight`, and releases their `envelope` once
+ * they are sent. The tasks themselves stay in the queue, and are only popped
+ * once they reach its front.
+ */
+typedef struct {
+    sentry_envelope_t *envelope;
+    bool in_flight;
+} winhttp_queued_envelope_t;
+
+struct winhttp_bgworker_state_s;
+
+/**
+ * A request in async mode, which is driven by `winhttp_status_callback` on the
+ * WinHTTP thread pool until it is `done`.
+ */
 typedef struct {
+    struct winhttp_bgworker_state_s *state;
+    winhttp_queued_envelope_t *queued;
+    sentry_prepared_http_request_t *req;
+    wchar_t *headers;
+    sentry_envelope_body_reader_t reader;
+    char chunk[CHUNK_SIZE];
+    // these are written by the status callback while holding `transfer_lock`,
+    // and `request` is only reset once WinHTTP is done with the handle
+    HINTERNET request;
+    bool done;
+    DWORD error;
+    uint64_t started;
+} winhttp_transfer_t;
+
+typedef struct winhttp_bgworker_state_s {
     sentry_dsn_t *dsn;
+    sentry_bgworker_t *bgworker;
     wchar_t *user_agent;
     wchar_t *proxy;
     sentry_rate_limiter_t *ratelimiter;
+    sentry_transport_stats_t *stats;
     HINTERNET session;
     HINTERNET connect;
     HINTERNET request;
+    // only used in async mode
+    bool async;
+    winhttp_transfer_t *transfers;
+    size_t max_transfers;
+    size_t active_transfers;
+    sentry_mutex_t transfer_lock;
+    sentry_cond_t transfer_signal;
     bool debug;
 } winhttp_bgworker_state_t;
 
@@ -34,6 +80,9 @@ sentry__winhttp_bgworker_state_new(void)
     memset(state, 0, sizeof(winhttp_bgworker_state_t));
 
     state->ratelimiter = sentry__rate_limiter_new();
+    state->stats = sentry__transport_stats_new();
+    sentry__mutex_init(&state->transfer_lock);
+    sentry__cond_init(&state->transfer_signal);
 
     return state;
 }
@@ -48,13 +97,40 @@ sentry__winhttp_bgworker_state_free(void *_state)
     if (state->session) {
         WinHttpCloseHandle(state->session);
     }
+    if (state->transfers) {
+        // the transfers are the context of their requests, which are closed
+        // asynchronously, so wait for WinHTTP to be done with them
+        sentry__mutex_lock(&state->transfer_lock);
+        for (size_t i = 0; i < state->max_transfers; i++) {
+            while (state->transfers[i].request) {
+                if (!sentry__cond_wait_timeout(&state->transfer_signal,
+                        &state->transfer_lock, 1000)) {
+                    break;
+                }
+            }
+        }
+        sentry__mutex_unlock(&state->transfer_lock);
+    }
+    sentry_free(state->transfers);
+    sentry__mutex_free(&state->transfer_lock);
     sentry__dsn_decref(state->dsn);
     sentry__rate_limiter_free(state->ratelimiter);
+    sentry__transport_stats_free(state->stats);
     sentry_free(state->user_agent);
     sentry_free(state->proxy);
     sentry_free(state);
 }
 
+static void CALLBACK winhttp_status_callback(HINTERNET request,
+    DWORD_PTR context, DWORD status, LPVOID info, DWORD info_len);
+
+static bool
+winhttp_queued_envelope_can_drop(void *task_data)
+{
+    // envelopes that are being sent are still in use by the worker
+    return !((winhttp_queued_envelope_t *)task_data)->in_flight;
+}
+
 static int
 sentry__winhttp_transport_start(
     const sentry_options_t *opts, void *transport_state)
@@ -63,10 +139,17 @@ sentry__winhttp_transport_start(
     winhttp_bgworker_state_t *state = sentry__bgworker_get_state(bgworker);
 
     state->dsn = sentry__dsn_incref(opts->dsn);
+    state->bgworker = bgworker;
     state->user_agent = sentry__string_to_wstr(SENTRY_SDK_USER_AGENT);
     state->debug = opts->debug;
+    // concurrent requests are sent asynchronously, with completion callbacks
+    // running on the WinHTTP thread pool
+    state->async = opts->transport_max_concurrent_requests > 1;
+    DWORD flags = state->async ? WINHTTP_FLAG_ASYNC : 0;
 
     sentry__bgworker_setname(bgworker, opts->transport_thread_name);
+    sentry__bgworker_set_queue_limits(bgworker, opts->transport_max_queue_size,
+        opts->transport_max_queue_bytes, winhttp_queued_envelope_can_drop);
 
     // ensure the proxy starts with `http://`, otherwise ignore it
     if (opts->http_proxy
@@ -85,25 +168,67 @@ sentry__winhttp_transport_start(
     if (state->proxy) {
         state->session
             = WinHttpOpen(state->user_agent, WINHTTP_ACCESS_TYPE_NAMED_PROXY,
-                state->proxy, WINHTTP_NO_PROXY_BYPASS, 0);
+                state->proxy, WINHTTP_NO_PROXY_BYPASS, flags);
     } else {
 #if _WIN32_WINNT >= 0x0603
         state->session = WinHttpOpen(state->user_agent,
             WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME,
-            WINHTTP_NO_PROXY_BYPASS, 0);
+            WINHTTP_NO_PROXY_BYPASS, flags);
 #endif
         // On windows 8.0 or lower, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY does
         // not work on error we fallback to WINHTTP_ACCESS_TYPE_DEFAULT_PROXY
         if (!state->session) {
             state->session = WinHttpOpen(state->user_agent,
                 WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME,
-                WINHTTP_NO_PROXY_BYPASS, 0);
+                WINHTTP_NO_PROXY_BYPASS, flags);
         }
     }
     if (!state->session) {
         SENTRY_WARN("`WinHttpOpen` failed");
         return 1;
     }
+
+    // a value of 0 keeps the default of WinHTTP, whereas the low speed time
+    // is the closest thing to a timeout for sending and receiving data
+    int connect_timeout = (int)opts->transport_connect_timeout;
+    int io_timeout = (int)opts->transport_low_speed_time;
+    if (connect_timeout || io_timeout) {
+        WinHttpSetTimeouts(state->session, 0,
+            connect_timeout ? connect_timeout : 60000,
+            io_timeout ? io_timeout : 30000, io_timeout ? io_timeout : 30000);
+    }
+
+    if (state->async) {
+        state->max_transfers = opts->transport_max_concurrent_requests;
+        state->transfers
+            = sentry_malloc(sizeof(winhttp_transfer_t) * state->max_transfers);
+        if (!state->transfers) {
+            return 1;
+        }
+        memset(state->transfers, 0,
+            sizeof(winhttp_transfer_t) * state->max_transfers);
+        for (size_t i = 0; i < state->max_transfers; i++) {
+            state->transfers[i].state = state;
+        }
+
+        if (WinHttpSetStatusCallback(state->session, winhttp_status_callback,
+                WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS
+                    | WINHTTP_CALLBACK_FLAG_HANDLES,
+                0)
+            == WINHTTP_INVALID_STATUS_CALLBACK) {
+            SENTRY_WARNF("`WinHttpSetStatusCallback` failed with code `%d`",
+                GetLastError());
+            return 1;
+        }
+#ifdef WINHTTP_PROTOCOL_FLAG_HTTP2
+        // concurrent requests to the same host share a single HTTP/2
+        // connection. This fails on windows versions that don't support
+        // HTTP/2, which then just fall back to HTTP/1.1.
+        DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+        WinHttpSetOption(state->session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL,
+            &protocols, sizeof(protocols));
+#endif
+    }
     return sentry__bgworker_start(bgworker);
 }
 
@@ -121,6 +246,7 @@ sentry__winhttp_transport_shutdown(uint64_t timeout, void *transport_state)
     winhttp_bgworker_state_t *state = sentry__bgworker_get_state(bgworker);
 
     int rv = sentry__bgworker_shutdown(bgworker, timeout);
+    sentry__transport_log_dropped_envelopes(bgworker);
     if (rv != 0) {
         // Seems like some requests are taking too long/hanging
         // Just close them to make sure the background thread is exiting.
@@ -144,22 +270,17 @@ sentry__winhttp_transport_shutdown(uint64_t timeout, void *transport_state)
     return rv;
 }
 
-static void
-sentry__winhttp_send_task(void *_envelope, void *_state)
+/**
+ * Opens a request for `req` on the connection to the host of the envelope
+ * endpoint, which is opened on first use and shared by all requests, and
+ * formats the request headers into `headers_out`.
+ */
+static HINTERNET
+open_request(winhttp_bgworker_state_t *state,
+    const sentry_prepared_http_request_t *req, wchar_t **headers_out)
 {
-    sentry_envelope_t *envelope = (sentry_envelope_t *)_envelope;
-    winhttp_bgworker_state_t *state = (winhttp_bgworker_state_t *)_state;
-
-    uint64_t started = sentry__monotonic_time();
-
-    sentry_prepared_http_request_t *req = sentry__prepare_http_request(
-        envelope, state->dsn, state->ratelimiter);
-    if (!req) {
-        return;
-    }
-
     wchar_t *url = sentry__string_to_wstr(req->url);
-    wchar_t *headers = NULL;
+    HINTERNET request = NULL;
 
     URL_COMPONENTS url_components;
     wchar_t hostname[128];
@@ -182,10 +303,10 @@ sentry__winhttp_send_task(void *_envelope, void *_state)
     }
 
     bool is_secure = strstr(req->url, "https") == req->url;
-    state->request = WinHttpOpenRequest(state->connect, L"POST",
+    request = WinHttpOpenRequest(state->connect, L"POST",
         url_components.lpszUrlPath, NULL, WINHTTP_NO_REFERER,
         WINHTTP_DEFAULT_ACCEPT_TYPES, is_secure ? WINHTTP_FLAG_SECURE : 0);
-    if (!state->request) {
+    if (!request) {
         SENTRY_WARNF(
             "`WinHttpOpenRequest` failed with code `%d`", GetLastError());
         goto exit;
@@ -202,80 +323,144 @@ sentry__winhttp_send_task(void *_envelope, void *_state)
     }
 
     char *headers_buf = sentry__stringbuilder_into_string(&sb);
-    headers = sentry__string_to_wstr(headers_buf);
+    *headers_out = sentry__string_to_wstr(headers_buf);
     sentry_free(headers_buf);
 
     SENTRY_TRACEF(
-        "sending request using winhttp to \"%s\":\n%S", req->url, headers);
-
-    if (WinHttpSendRequest(state->request, headers, (DWORD)-1,
-            (LPVOID)req->body, (DWORD)req->body_len, (DWORD)req->body_len, 0)) {
-        WinHttpReceiveResponse(state->request, NULL);
-
-        if (state->debug) {
-            // this is basically the example from:
-            // https://docs.microsoft.com/en-us/windows/win32/api/winhttp/nf-winhttp-winhttpqueryheaders#examples
-            DWORD dwSize = 0;
-            LPVOID lpOutBuffer = NULL;
-            WinHttpQueryHeaders(state->request, WINHTTP_QUERY_RAW_HEADERS_CRLF,
-                WINHTTP_HEADER_NAME_BY_INDEX, NULL, &dwSize,
-                WINHTTP_NO_HEADER_INDEX);
-
-            // Allocate memory for the buffer.
-            if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
-                lpOutBuffer = sentry_malloc(dwSize);
-
-                // Now, use WinHttpQueryHeaders to retrieve the header.
-                if (lpOutBuffer
-                    && WinHttpQueryHeaders(state->request,
-                        WINHTTP_QUERY_RAW_HEADERS_CRLF,
-                        WINHTTP_HEADER_NAME_BY_INDEX, lpOutBuffer, &dwSize,
-                        WINHTTP_NO_HEADER_INDEX)) {
-                    SENTRY_TRACEF(
-                        "received response:\n%S", (wchar_t *)lpOutBuffer);
-                }
-                sentry_free(lpOutBuffer);
+        "sending request using winhttp to \"%s\":\n%S", req->url, *headers_out);
+
+exit:
+    sentry_free(url);
+    return request;
+}
+
+/**
+ * Returns the HTTP status code of the response to `request`, or 0 if there is
+ * none.
+ */
+static DWORD
+get_status_code(HINTERNET request)
+{
+    DWORD status_code = 0;
+    DWORD status_code_size = sizeof(status_code);
+    if (!WinHttpQueryHeaders(request,
+            WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+            WINHTTP_HEADER_NAME_BY_INDEX, &status_code, &status_code_size,
+            WINHTTP_NO_HEADER_INDEX)) {
+        return 0;
+    }
+    return status_code;
+}
+
+/**
+ * Updates the rate limiter from the response headers of `request`.
+ */
+static void
+update_rate_limits(winhttp_bgworker_state_t *state, HINTERNET request)
+{
+    if (state->debug) {
+        // this is basically the example from:
+        // https://docs.microsoft.com/en-us/windows/win32/api/winhttp/nf-winhttp-winhttpqueryheaders#examples
+        DWORD dwSize = 0;
+        LPVOID lpOutBuffer = NULL;
+        WinHttpQueryHeaders(request, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+            WINHTTP_HEADER_NAME_BY_INDEX, NULL, &dwSize,
+            WINHTTP_NO_HEADER_INDEX);
+
+        // Allocate memory for the buffer.
+        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
+            lpOutBuffer = sentry_malloc(dwSize);
+
+            // Now, use WinHttpQueryHeaders to retrieve the header.
+            if (lpOutBuffer
+                && WinHttpQueryHeaders(request, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                    WINHTTP_HEADER_NAME_BY_INDEX, lpOutBuffer, &dwSize,
+                    WINHTTP_NO_HEADER_INDEX)) {
+                SENTRY_TRACEF("received response:\n%S", (wchar_t *)lpOutBuffer);
             }
+            sentry_free(lpOutBuffer);
         }
+    }
+
+    // lets just assume we won’t have headers > 2k
+    wchar_t buf[2048];
+    DWORD buf_size = sizeof(buf);
+
+    if (WinHttpQueryHeaders(request, WINHTTP_QUERY_CUSTOM,
+            L"x-sentry-rate-limits", buf, &buf_size,
+            WINHTTP_NO_HEADER_INDEX)) {
+        char *h = sentry__string_from_wstr(buf);
+        if (h) {
+            sentry__rate_limiter_update_from_header(state->ratelimiter, h);
+            sentry_free(h);
+        }
+    } else if (WinHttpQueryHeaders(request, WINHTTP_QUERY_CUSTOM,
+                   L"retry-after", buf, &buf_size, WINHTTP_NO_HEADER_INDEX)) {
+        char *h = sentry__string_from_wstr(buf);
+        if (h) {
+            sentry__rate_limiter_update_from_http_retry_after(
+                state->ratelimiter, h);
+            sentry_free(h);
+        }
+    } else if (get_status_code(request) == 429) {
+        sentry__rate_limiter_update_from_429(state->ratelimiter);
+    }
+}
 
-        // lets just assume we won’t have headers > 2k
-        wchar_t buf[2048];
-        DWORD buf_size = sizeof(buf);
+static void
+send_envelope_sync(winhttp_bgworker_state_t *state, sentry_envelope_t *envelope)
+{
+    uint64_t started = sentry__monotonic_time();
 
-        DWORD status_code = 0;
-        DWORD status_code_size = sizeof(status_code);
+    sentry__transport_stats_record_rate_limits(
+        state->stats, envelope, state->ratelimiter);
+    sentry_prepared_http_request_t *req = sentry__prepare_http_request(
+        envelope, state->dsn, state->ratelimiter);
+    if (!req) {
+        return;
+    }
 
-        if (WinHttpQueryHeaders(state->request, WINHTTP_QUERY_CUSTOM,
-                L"x-sentry-rate-limits", buf, &buf_size,
-                WINHTTP_NO_HEADER_INDEX)) {
-            char *h = sentry__string_from_wstr(buf);
-            if (h) {
-                sentry__rate_limiter_update_from_header(state->ratelimiter, h);
-                sentry_free(h);
-            }
-        } else if (WinHttpQueryHeaders(state->request, WINHTTP_QUERY_CUSTOM,
-                       L"retry-after", buf, &buf_size,
-                       WINHTTP_NO_HEADER_INDEX)) {
-            char *h = sentry__string_from_wstr(buf);
-            if (h) {
-                sentry__rate_limiter_update_from_http_retry_after(
-                    state->ratelimiter, h);
-                sentry_free(h);
-            }
-        } else if (WinHttpQueryHeaders(state->request,
-                       WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-                       WINHTTP_HEADER_NAME_BY_INDEX, &status_code,
-                       &status_code_size, WINHTTP_NO_HEADER_INDEX)
-            && status_code == 429) {
-            sentry__rate_limiter_update_from_429(state->ratelimiter);
+    wchar_t *headers = NULL;
+    state->request = open_request(state, req, &headers);
+    if (!state->request) {
+        goto exit;
+    }
+
+    // the body is written in chunks, which avoids copying the payloads into
+    // one contiguous buffer
+    SENTRY_TRACEPOINT1(transport__send__start, req->body.total_len);
+    BOOL sent = WinHttpSendRequest(state->request, headers, (DWORD)-1,
+        WINHTTP_NO_REQUEST_DATA, 0, (DWORD)req->body.total_len, 0);
+    sentry_envelope_body_reader_t reader;
+    sentry__envelope_body_reader_init(&reader, &req->body);
+    char chunk[CHUNK_SIZE];
+    while (sent) {
+        size_t chunk_len
+            = sentry__envelope_body_read(&reader, chunk, sizeof(chunk));
+        if (!chunk_len) {
+            break;
         }
+        DWORD written = 0;
+        sent = WinHttpWriteData(
+            state->request, (LPCVOID)chunk, (DWORD)chunk_len, &written);
+    }
+    sentry__envelope_body_reader_cleanup(&reader);
+    DWORD error = 0;
+    DWORD status_code = 0;
+    if (sent && WinHttpReceiveResponse(state->request, NULL)) {
+        status_code = get_status_code(state->request);
+        update_rate_limits(state, state->request);
     } else {
-        SENTRY_DEBUGF(
-            "`WinHttpSendRequest` failed with code `%d`", GetLastError());
+        error = GetLastError();
+        SENTRY_DEBUGF("`WinHttpSendRequest` failed with code `%d`", error);
     }
 
+    SENTRY_TRACEPOINT1(transport__send__end, status_code);
     uint64_t now = sentry__monotonic_time();
     SENTRY_TRACEF("request handled in %llums", now - started);
+    sentry__transport_stats_record_request(state->stats, now - started,
+        status_code ? req->body.total_len : 0, req->uncompressed_len,
+        (long)status_code, (long)error);
 
 exit:
     if (state->request) {
@@ -283,34 +468,358 @@ exit:
         state->request = NULL;
         WinHttpCloseHandle(request);
     }
-    sentry_free(url);
     sentry_free(headers);
     sentry__prepared_http_request_free(req);
 }
 
+/**
+ * Marks `transfer` as done, and wakes up the worker to finish it.
+ */
+static void
+complete_transfer(winhttp_transfer_t *transfer, DWORD error)
+{
+    winhttp_bgworker_state_t *state = transfer->state;
+    sentry__mutex_lock(&state->transfer_lock);
+    if (!transfer->done) {
+        transfer->done = true;
+        transfer->error = error;
+    }
+    sentry__cond_wake(&state->transfer_signal);
+    sentry__mutex_unlock(&state->transfer_lock);
+}
+
+/**
+ * Writes the next chunk of the body of `transfer`, or starts receiving the
+ * response once the whole body is written.
+ */
+static void
+write_next_chunk(winhttp_transfer_t *transfer, HINTERNET request)
+{
+    size_t chunk_len = sentry__envelope_body_read(
+        &transfer->reader, transfer->chunk, sizeof(transfer->chunk));
+    BOOL ok = chunk_len
+        ? WinHttpWriteData(request, (LPCVOID)transfer->chunk, (DWORD)chunk_len,
+            NULL)
+        : WinHttpReceiveResponse(request, NULL);
+    if (!ok) {
+        DWORD error = GetLastError();
+        SENTRY_DEBUGF("sending via winhttp failed with code `%d`", error);
+        complete_transfer(transfer, error);
+    }
+}
+
+static void CALLBACK
+winhttp_status_callback(HINTERNET request, DWORD_PTR context, DWORD status,
+    LPVOID info, DWORD UNUSED(info_len))
+{
+    winhttp_transfer_t *transfer = (winhttp_transfer_t *)context;
+    if (!transfer) {
+        // the session and connect handles have no context
+        return;
+    }
+
+    switch (status) {
+    case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+    case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE:
+        write_next_chunk(transfer, request);
+        break;
+    case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+        complete_transfer(transfer, 0);
+        break;
+    case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
+        WINHTTP_ASYNC_RESULT *result = (WINHTTP_ASYNC_RESULT *)info;
+        SENTRY_DEBUGF("sending via winhttp failed with code `%d`",
+            (int)result->dwError);
+        complete_transfer(transfer, result->dwError);
+        break;
+    }
+    case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING: {
+        winhttp_bgworker_state_t *state = transfer->state;
+        sentry__mutex_lock(&state->transfer_lock);
+        transfer->request = NULL;
+        sentry__cond_wake(&state->transfer_signal);
+        sentry__mutex_unlock(&state->transfer_lock);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * Starts sending the envelope of `queued` asynchronously using `transfer`.
+ * Returns false if there is nothing to send because of rate limits.
+ */
+static bool
+start_transfer(winhttp_bgworker_state_t *state, winhttp_transfer_t *transfer,
+    winhttp_queued_envelope_t *queued)
+{
+    sentry__transport_stats_record_rate_limits(
+        state->stats, queued->envelope, state->ratelimiter);
+    sentry_prepared_http_request_t *req = sentry__prepare_http_request(
+        queued->envelope, state->dsn, state->ratelimiter);
+    if (!req) {
+        return false;
+    }
+
+    transfer->queued = queued;
+    transfer->req = req;
+    transfer->headers = NULL;
+    transfer->done = false;
+    transfer->error = 0;
+    transfer->started = sentry__monotonic_time();
+    sentry__envelope_body_reader_init(&transfer->reader, &req->body);
+    state->active_transfers++;
+    SENTRY_TRACEPOINT1(transport__send__start, req->body.total_len);
+
+    HINTERNET request = open_request(state, req, &transfer->headers);
+    if (!request) {
+        complete_transfer(transfer, GetLastError());
+        return true;
+    }
+    transfer->request = request;
+
+    // the transfer is passed to all the callbacks of its request, including
+    // the one for closing the handle, which might come before any other
+    DWORD_PTR context = (DWORD_PTR)transfer;
+    WinHttpSetOption(
+        request, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context));
+    // the body is written in chunks by the callbacks, which avoids copying the
+    // payloads into one contiguous buffer
+    if (!WinHttpSendRequest(request, transfer->headers, (DWORD)-1,
+            WINHTTP_NO_REQUEST_DATA, 0, (DWORD)req->body.total_len,
+            context)) {
+        DWORD error = GetLastError();
+        SENTRY_DEBUGF("`WinHttpSendRequest` failed with code `%d`", error);
+        complete_transfer(transfer, error);
+    }
+    return true;
+}
+
+static void sentry__winhttp_send_task(void *_queued, void *_state);
+
+static bool
+claim_queued_envelope(void *task_data, void *_state)
+{
+    winhttp_bgworker_state_t *state = (winhttp_bgworker_state_t *)_state;
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)task_data;
+    if (!queued->envelope || queued->in_flight
+        || state->active_transfers >= state->max_transfers) {
+        return false;
+    }
+
+    // a transfer is only free once the handle of its previous request is
+    // closed
+    winhttp_transfer_t *transfer = NULL;
+    sentry__mutex_lock(&state->transfer_lock);
+    for (size_t i = 0; !transfer && i < state->max_transfers; i++) {
+        if (!state->transfers[i].queued && !state->transfers[i].request) {
+            transfer = &state->transfers[i];
+        }
+    }
+    sentry__mutex_unlock(&state->transfer_lock);
+    if (!transfer) {
+        return false;
+    }
+
+    if (start_transfer(state, transfer, queued)) {
+        queued->in_flight = true;
+    } else {
+        sentry_envelope_free(queued->envelope);
+        queued->envelope = NULL;
+    }
+    return false;
+}
+
+/**
+ * Claims as many queued envelopes as there are free transfers.
+ */
+static void
+claim_queued_envelopes(winhttp_bgworker_state_t *state)
+{
+    sentry__bgworker_foreach_matching(state->bgworker,
+        sentry__winhttp_send_task, claim_queued_envelope, state);
+}
+
+static bool
+release_queued_envelope(void *task_data, void *queued_envelope)
+{
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)task_data;
+    if (queued == queued_envelope) {
+        sentry_envelope_free(queued->envelope);
+        queued->envelope = NULL;
+        queued->in_flight = false;
+    }
+    return false;
+}
+
+static void
+finish_transfer(winhttp_bgworker_state_t *state, winhttp_transfer_t *transfer)
+{
+    sentry__mutex_lock(&state->transfer_lock);
+    HINTERNET request = transfer->request;
+    DWORD error = transfer->error;
+    sentry__mutex_unlock(&state->transfer_lock);
+
+    DWORD status_code = 0;
+    if (request && !error) {
+        status_code = get_status_code(request);
+        update_rate_limits(state, request);
+    }
+    state->active_transfers--;
+    SENTRY_TRACEPOINT1(transport__send__end, status_code);
+
+    sentry_prepared_http_request_t *req = transfer->req;
+    sentry__transport_stats_record_request(state->stats,
+        sentry__monotonic_time() - transfer->started,
+        status_code ? req->body.total_len : 0, req->uncompressed_len,
+        (long)status_code, (long)error);
+
+    // the queued envelope is released while holding the queue lock, as it
+    // might concurrently be dumped to disk
+    sentry__bgworker_foreach_matching(state->bgworker,
+        sentry__winhttp_send_task, release_queued_envelope, transfer->queued);
+
+    // the transfer can be reused once the handle closing callback has reset
+    // its `request`
+    if (request) {
+        WinHttpCloseHandle(request);
+    }
+    sentry__envelope_body_reader_cleanup(&transfer->reader);
+    sentry_free(transfer->headers);
+    sentry__prepared_http_request_free(transfer->req);
+    transfer->queued = NULL;
+    transfer->req = NULL;
+    transfer->headers = NULL;
+}
+
+static void
+sentry__winhttp_send_task(void *_queued, void *_state)
+{
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)_queued;
+    winhttp_bgworker_state_t *state = (winhttp_bgworker_state_t *)_state;
+    if (!queued->envelope) {
+        // already sent along with an earlier envelope
+        return;
+    }
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_TRANSPORT);
+    sentry__transport_stats_record_queue_depth(
+        state->stats, sentry__bgworker_get_queue_depth(state->bgworker));
+    if (!state->async) {
+        send_envelope_sync(state, queued->envelope);
+        SENTRY_MEMORY_TAG_LEAVE();
+        return;
+    }
+
+    // this envelope, and as many of the following ones as there are free
+    // transfers are sent concurrently, picking up envelopes that are queued in
+    // the meantime whenever a transfer is free. The transfers of earlier
+    // requests might still be closing, in which case this envelope is claimed
+    // as soon as one of them is free.
+    claim_queued_envelopes(state);
+    while (state->active_transfers
+        || (queued->envelope && !queued->in_flight)) {
+        winhttp_transfer_t *done = NULL;
+        sentry__mutex_lock(&state->transfer_lock);
+        for (size_t i = 0; !done && i < state->max_transfers; i++) {
+            if (state->transfers[i].queued && state->transfers[i].done) {
+                done = &state->transfers[i];
+            }
+        }
+        if (!done) {
+            DWORD timeout_ms
+                = state->active_transfers < state->max_transfers ? 50 : 1000;
+            sentry__cond_wait_timeout(
+                &state->transfer_signal, &state->transfer_lock, timeout_ms);
+        }
+        sentry__mutex_unlock(&state->transfer_lock);
+
+        if (done) {
+            finish_transfer(state, done);
+        }
+        if (state->active_transfers < state->max_transfers) {
+            claim_queued_envelopes(state);
+        }
+    }
+    SENTRY_MEMORY_TAG_LEAVE();
+}
+
+static void
+winhttp_queued_envelope_free(void *_queued)
+{
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)_queued;
+    sentry_envelope_free(queued->envelope);
+    sentry_free(queued);
+}
+
 static void
 sentry__winhttp_transport_send_envelope(
     sentry_envelope_t *envelope, void *transport_state)
 {
     sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
-    sentry__bgworker_submit(bgworker, sentry__winhttp_send_task,
-        (void (*)(void *))sentry_envelope_free, envelope);
+    winhttp_queued_envelope_t *queued = SENTRY_MAKE(winhttp_queued_envelope_t);
+    if (!queued) {
+        sentry_envelope_free(envelope);
+        return;
+    }
+    queued->envelope = envelope;
+    queued->in_flight = false;
+    sentry__bgworker_submit_bounded(bgworker, sentry__winhttp_send_task,
+        winhttp_queued_envelope_free, queued,
+        sentry__envelope_get_task_priority(envelope),
+        sentry__envelope_get_memory_usage(envelope));
+
+    winhttp_bgworker_state_t *state = sentry__bgworker_get_state(bgworker);
+    sentry__transport_stats_record_queue_depth(
+        state->stats, sentry__bgworker_get_queue_depth(bgworker));
 }
 
+typedef struct {
+    sentry_run_t *run;
+    size_t dumped;
+} winhttp_dump_state_t;
+
 static bool
-sentry__winhttp_dump_task(void *envelope, void *run)
+sentry__winhttp_dump_task(void *_queued, void *_dump_state)
 {
-    sentry__run_write_envelope(
-        (sentry_run_t *)run, (sentry_envelope_t *)envelope);
-    return true;
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)_queued;
+    winhttp_dump_state_t *dump_state = (winhttp_dump_state_t *)_dump_state;
+    if (queued->envelope) {
+        sentry__run_write_envelope(dump_state->run, queued->envelope);
+        dump_state->dumped++;
+    }
+    // envelopes that are being sent are still in use by the worker
+    return !queued->in_flight;
 }
 
 static size_t
 sentry__winhttp_dump_queue(sentry_run_t *run, void *transport_state)
 {
     sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
-    return sentry__bgworker_foreach_matching(
-        bgworker, sentry__winhttp_send_task, sentry__winhttp_dump_task, run);
+    winhttp_dump_state_t dump_state = { run, 0 };
+    sentry__bgworker_foreach_matching(bgworker, sentry__winhttp_send_task,
+        sentry__winhttp_dump_task, &dump_state);
+    return dump_state.dumped;
+}
+
+static bool
+sentry__winhttp_memory_usage_task(void *_queued, void *size)
+{
+    winhttp_queued_envelope_t *queued = (winhttp_queued_envelope_t *)_queued;
+    if (queued->envelope) {
+        *(size_t *)size += sentry__envelope_get_memory_usage(queued->envelope);
+    }
+    return false;
+}
+
+static size_t
+sentry__winhttp_memory_usage(void *transport_state)
+{
+    sentry_bgworker_t *bgworker = (sentry_bgworker_t *)transport_state;
+    size_t size = 0;
+    sentry__bgworker_foreach_matching(bgworker, sentry__winhttp_send_task,
+        sentry__winhttp_memory_usage_task, &size);
+    return size;
 }
 
 sentry_transport_t *
@@ -343,6 +852,13 @@ sentry__transport_new_default(void)
     sentry_transport_set_shutdown_func(
         transport, sentry__winhttp_transport_shutdown);
     sentry__transport_set_dump_func(transport, sentry__winhttp_dump_queue);
+    sentry__transport_set_bgworker(transport, bgworker);
+    sentry__transport_set_rate_limiter(transport, state->ratelimiter);
+    sentry__transport_set_stats(transport, state->stats);
+    sentry__transport_set_memory_usage_func(
+        transport, sentry__winhttp_memory_usage);
+    sentry__transport_set_factory_func(
+        transport, sentry__transport_new_default);
 
     return transport;
 }
@@ -1,5 +1,7 @@
 #include "sentry_boot.h"
 
+#include "sentry_unwinder.h"
+
 #define DEFINE_UNWINDER(Func)                                                  \
     size_t sentry__unwind_stack_##Func(void *addr,                             \
         const sentry_ucontext_t *uctx, void **ptrs, size_t max_frames)
@@ -12,14 +14,28 @@
         }                                                                      \
     } while (0)
 
+DEFINE_UNWINDER(fp);
 DEFINE_UNWINDER(libunwindstack);
 DEFINE_UNWINDER(libbacktrace);
 DEFINE_UNWINDER(dbghelp);
 
+void sentry__unwinder_prepare_libunwindstack(void);
+
+void
+sentry__unwinder_prepare(void)
+{
+#ifdef SENTRY_WITH_UNWINDER_LIBUNWINDSTACK
+    sentry__unwinder_prepare_libunwindstack();
+#endif
+}
+
 static size_t
 unwind_stack(
     void *addr, const sentry_ucontext_t *uctx, void **ptrs, size_t max_frames)
 {
+#ifdef SENTRY_WITH_UNWINDER_FP
+    TRY_UNWINDER(fp);
+#endif
 #ifdef SENTRY_WITH_UNWINDER_LIBUNWINDSTACK
     TRY_UNWINDER(libunwindstack);
 #endif
@@ -0,0 +1,219 @@
+#include "sentry_boot.h"
+
+#include "sentry_sync.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(SENTRY_PLATFORM_LINUX)
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    include <unistd.h>
+#endif
+
+#if defined(__has_feature)
+#    if __has_feature(ptrauth_calls)
+#        include <ptrauth.h>
+#        define STRIP_RETURN_ADDR(Addr)                                        \
+            (uintptr_t)ptrauth_strip(                                          \
+                (void *)(Addr), ptrauth_key_return_address)
+#    endif
+#endif
+#ifndef STRIP_RETURN_ADDR
+#    define STRIP_RETURN_ADDR(Addr) (Addr)
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)          \
+    || defined(__arm64__)
+#    define HAS_FRAME_RECORDS
+#endif
+
+// the stack size we assume when the bounds of the stack are unknown, which
+// limits how far a walk with safe reads can get
+#define UNKNOWN_STACK_SIZE (8 * 1024 * 1024)
+
+/**
+ * The bounds of a thread stack. `safe_reads` is set when `hi` is only an
+ * estimate, in which case every frame record is read with a syscall that
+ * fails instead of faulting on unmapped memory.
+ */
+typedef struct {
+    uintptr_t lo;
+    uintptr_t hi;
+    bool safe_reads;
+} stack_bounds_t;
+
+#if defined(SENTRY_PLATFORM_LINUX)
+// the stack of the current thread, which `pthread_getattr_np` is too
+// expensive to query on every unwind, and not safe to query from within a
+// signal handler
+static SENTRY_THREAD_LOCAL uintptr_t g_stack_lo = 0;
+static SENTRY_THREAD_LOCAL uintptr_t g_stack_hi = 0;
+#endif
+
+static void
+get_stack_bounds(uintptr_t sp, stack_bounds_t *bounds)
+{
+    bounds->lo = sp;
+    bounds->hi = 0;
+    bounds->safe_reads = false;
+#if defined(SENTRY_PLATFORM_DARWIN)
+    // these only read the `pthread_t` and are fine to call anywhere
+    pthread_t thread = pthread_self();
+    bounds->hi = (uintptr_t)pthread_get_stackaddr_np(thread);
+    if (sp > bounds->hi
+        || bounds->hi - sp > pthread_get_stacksize_np(thread)) {
+        bounds->hi = 0;
+    }
+#elif defined(SENTRY_PLATFORM_LINUX)
+    if (!g_stack_hi && sentry__block_for_signal_handler()) {
+        pthread_attr_t attr;
+        void *stack_addr = NULL;
+        size_t stack_size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0) {
+                g_stack_lo = (uintptr_t)stack_addr;
+                g_stack_hi = g_stack_lo + stack_size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+    // the signal handler may also run on an alternate stack, or have
+    // interrupted a different stack than the one we have recorded
+    if (g_stack_hi && sp >= g_stack_lo && sp < g_stack_hi) {
+        bounds->hi = g_stack_hi;
+    }
+#endif
+    if (!bounds->hi) {
+        bounds->hi = sp > UINTPTR_MAX - UNKNOWN_STACK_SIZE
+            ? UINTPTR_MAX
+            : sp + UNKNOWN_STACK_SIZE;
+        bounds->safe_reads = true;
+    }
+}
+
+/**
+ * Reads the frame record at `fp`, which consists of the frame pointer of the
+ * calling frame, followed by the return address.
+ */
+static bool
+read_frame_record(
+    const stack_bounds_t *bounds, uintptr_t fp, uintptr_t record[2])
+{
+    if (fp % sizeof(uintptr_t) != 0 || fp < bounds->lo
+        || fp > bounds->hi - sizeof(uintptr_t) * 2) {
+        return false;
+    }
+    if (!bounds->safe_reads) {
+        memcpy(record, (const void *)fp, sizeof(uintptr_t) * 2);
+        return true;
+    }
+#if defined(SENTRY_PLATFORM_LINUX) && defined(SYS_process_vm_readv)
+    struct iovec local = { record, sizeof(uintptr_t) * 2 };
+    struct iovec remote = { (void *)fp, sizeof(uintptr_t) * 2 };
+    return syscall(SYS_process_vm_readv, getpid(), &local, 1, &remote, 1, 0)
+        == (long)(sizeof(uintptr_t) * 2);
+#else
+    return false;
+#endif
+}
+
+static size_t
+walk_frames(uintptr_t fp, const stack_bounds_t *bounds, void **ptrs,
+    size_t frame_count, size_t max_frames)
+{
+    uintptr_t record[2];
+    while (frame_count < max_frames && read_frame_record(bounds, fp, record)) {
+        uintptr_t return_addr = STRIP_RETURN_ADDR(record[1]);
+        if (!return_addr) {
+            break;
+        }
+        ptrs[frame_count++] = (void *)return_addr;
+        // the stack grows down, so anything else is a broken chain
+        if (record[0] <= fp) {
+            break;
+        }
+        fp = record[0];
+    }
+    return frame_count;
+}
+
+#ifdef HAS_FRAME_RECORDS
+static bool
+registers_from_uctx(
+    const sentry_ucontext_t *uctx, uintptr_t *pc, uintptr_t *sp, uintptr_t *fp)
+{
+#    if defined(SENTRY_PLATFORM_LINUX) && defined(__x86_64__)
+    const greg_t *gregs = uctx->user_context->uc_mcontext.gregs;
+    *pc = (uintptr_t)gregs[REG_RIP];
+    *sp = (uintptr_t)gregs[REG_RSP];
+    *fp = (uintptr_t)gregs[REG_RBP];
+#    elif defined(SENTRY_PLATFORM_LINUX) && defined(__i386__)
+    const greg_t *gregs = uctx->user_context->uc_mcontext.gregs;
+    *pc = (uintptr_t)gregs[REG_EIP];
+    *sp = (uintptr_t)gregs[REG_ESP];
+    *fp = (uintptr_t)gregs[REG_EBP];
+#    elif defined(SENTRY_PLATFORM_LINUX) && defined(__aarch64__)
+    const mcontext_t *mcontext = &uctx->user_context->uc_mcontext;
+    *pc = (uintptr_t)mcontext->pc;
+    *sp = (uintptr_t)mcontext->sp;
+    *fp = (uintptr_t)mcontext->regs[29];
+#    elif defined(SENTRY_PLATFORM_DARWIN) && defined(__x86_64__)
+    const _STRUCT_X86_THREAD_STATE64 *thread_state
+        = &uctx->user_context->uc_mcontext->__ss;
+    *pc = (uintptr_t)thread_state->__rip;
+    *sp = (uintptr_t)thread_state->__rsp;
+    *fp = (uintptr_t)thread_state->__rbp;
+#    elif defined(SENTRY_PLATFORM_DARWIN) && defined(__arm64__)
+    const _STRUCT_ARM_THREAD_STATE64 *thread_state
+        = &uctx->user_context->uc_mcontext->__ss;
+    *pc = STRIP_RETURN_ADDR((uintptr_t)thread_state->__pc);
+    *sp = (uintptr_t)thread_state->__sp;
+    *fp = (uintptr_t)thread_state->__fp;
+#    else
+    (void)uctx;
+    (void)pc;
+    (void)sp;
+    (void)fp;
+    return false;
+#    endif
+    return true;
+}
+#endif
+
+size_t
+sentry__unwind_stack_fp(
+    void *addr, const sentry_ucontext_t *uctx, void **ptrs, size_t max_frames)
+{
+#ifdef HAS_FRAME_RECORDS
+    stack_bounds_t bounds;
+    if (uctx) {
+        uintptr_t pc, sp, fp;
+        if (!max_frames || !registers_from_uctx(uctx, &pc, &sp, &fp)) {
+            return 0;
+        }
+        // the interrupted function may not have set up its frame record yet,
+        // so this can miss its direct caller
+        get_stack_bounds(sp, &bounds);
+        ptrs[0] = (void *)pc;
+        return walk_frames(fp, &bounds, ptrs, 1, max_frames);
+    }
+
+    uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+    get_stack_bounds(fp, &bounds);
+    if (addr) {
+        // like `backtrace_from_fp`, a given address is the frame pointer to
+        // start from, which needs to be on the stack of the current thread
+        fp = (uintptr_t)addr;
+    }
+    return walk_frames(fp, &bounds, ptrs, 0, max_frames);
+#else
+    (void)addr;
+    (void)uctx;
+    (void)ptrs;
+    (void)max_frames;
+    return 0;
+#endif
+}
@@ -1,9 +1,12 @@
 extern "C" {
 #include "sentry_boot.h"
 #include "sentry_core.h"
+#include "sentry_sync.h"
+#include "modulefinder/sentry_modulefinder_linux.h"
 }
 
 #include <memory>
+#include <new>
 #include <ucontext.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
@@ -11,8 +14,97 @@ extern "C" {
 #include <unwindstack/RegsGetLocal.h>
 #include <unwindstack/Unwinder.h>
 
+/**
+ * The maps and process memory are kept across unwinds, since parsing
+ * `/proc/self/maps` and setting up the memory dominates the time of an unwind
+ * otherwise. The maps are reparsed when the dynamic loader reports that
+ * objects were loaded or unloaded, or when an unwind ends up in an address
+ * outside of all known maps.
+ *
+ * Within our signal handler, the state is used as-is without any updates, and
+ * the lock is bypassed like all our locks are.
+ */
+struct unwinder_state_t {
+    unwindstack::LocalUpdatableMaps maps;
+    std::shared_ptr<unwindstack::Memory> process_memory;
+    uint64_t load_count;
+};
+
+static sentry_rwlock_t g_lock = SENTRY__RWLOCK_INIT;
+// this is deliberately never freed, so that threads which still unwind while
+// the process exits do not end up with a destroyed state
+static unwinder_state_t *g_state = nullptr;
+
+static size_t
+unwind_with(unwindstack::Maps *maps,
+    const std::shared_ptr<unwindstack::Memory> &process_memory,
+    unwindstack::Regs *regs, void **ptrs, size_t max_frames)
+{
+    unwindstack::Unwinder unwinder(max_frames, maps, regs, process_memory);
+    unwinder.Unwind();
+
+    std::vector<unwindstack::FrameData> &frames = unwinder.frames();
+
+    size_t rv = 0;
+    for (unwindstack::FrameData &frame : frames) {
+        ptrs[rv++] = (void *)frame.pc;
+    }
+
+    return rv;
+}
+
+/**
+ * Creates the state, or reparses its maps if they may be outdated. `g_lock`
+ * needs to be held exclusively.
+ */
+static void
+update_state(uint64_t load_count, bool force)
+{
+    if (!g_state) {
+        unwinder_state_t *state = new (std::nothrow) unwinder_state_t();
+        if (!state) {
+            return;
+        }
+        if (!state->maps.Parse()) {
+            SENTRY_WARN("unwinder failed to parse process maps\n");
+            delete state;
+            return;
+        }
+        state->process_memory
+            = unwindstack::Memory::CreateProcessMemoryCached(getpid());
+        state->load_count = load_count;
+        g_state = state;
+    } else if (force || load_count != g_state->load_count) {
+        // this keeps the maps that did not change, along with the elf files
+        // that were already read for them
+        g_state->maps.Reparse();
+        g_state->load_count = load_count;
+    }
+}
+
+static bool
+is_state_outdated(uint64_t load_count)
+{
+    sentry__rwlock_lock_shared(&g_lock);
+    bool outdated
+        = !g_state || (load_count && load_count != g_state->load_count);
+    sentry__rwlock_unlock_shared(&g_lock);
+    return outdated;
+}
+
 extern "C" {
 
+void
+sentry__unwinder_prepare_libunwindstack(void)
+{
+    uint64_t load_count = sentry__modulefinder_get_load_count();
+    if (is_state_outdated(load_count)) {
+        sentry__rwlock_lock(&g_lock);
+        update_state(load_count, false);
+        sentry__rwlock_unlock(&g_lock);
+    }
+}
+
 size_t
 sentry__unwind_stack_libunwindstack(
     void *addr, const sentry_ucontext_t *uctx, void **ptrs, size_t max_frames)
@@ -31,25 +123,48 @@ sentry__unwind_stack_libunwindstack(
         return 0;
     }
 
-    unwindstack::LocalMaps maps;
-    if (!maps.Parse()) {
-        SENTRY_WARN("unwinder failed to parse process maps\n");
-        ptrs[0] = (void *)regs->pc();
-        return 1;
+    bool in_signal_handler = !sentry__block_for_signal_handler();
+    if (!in_signal_handler) {
+        sentry__unwinder_prepare_libunwindstack();
     }
 
-    const std::shared_ptr<unwindstack::Memory> process_memory
-        = unwindstack::Memory::CreateProcessMemoryCached(getpid());
-
-    unwindstack::Unwinder unwinder(
-        max_frames, &maps, regs.get(), process_memory);
-    unwinder.Unwind();
+    // the unwinder modifies the registers, so keep them around in case the
+    // unwind needs to be retried with updated maps
+    std::unique_ptr<unwindstack::Regs> retry_regs;
+    if (!in_signal_handler) {
+        retry_regs = std::unique_ptr<unwindstack::Regs>(regs->Clone());
+    }
 
-    std::vector<unwindstack::FrameData> &frames = unwinder.frames();
+    sentry__rwlock_lock_shared(&g_lock);
+    if (!g_state) {
+        sentry__rwlock_unlock_shared(&g_lock);
+        // the state could not be set up, or we crashed before our first
+        // unwind, so fall back to freshly parsed maps
+        unwindstack::LocalMaps maps;
+        if (!maps.Parse()) {
+            SENTRY_WARN("unwinder failed to parse process maps\n");
+            ptrs[0] = (void *)regs->pc();
+            return 1;
+        }
+        return unwind_with(&maps,
+            unwindstack::Memory::CreateProcessMemoryCached(getpid()),
+            regs.get(), ptrs, max_frames);
+    }
+    size_t rv = unwind_with(
+        &g_state->maps, g_state->process_memory, regs.get(), ptrs, max_frames);
+    // an unwind which stops in an unknown map may have hit a freshly loaded
+    // module that the dynamic loader did not tell us about
+    bool incomplete = rv > 0 && rv < max_frames
+        && !g_state->maps.Find((uint64_t)(uintptr_t)ptrs[rv - 1]);
+    sentry__rwlock_unlock_shared(&g_lock);
 
-    size_t rv = 0;
-    for (unwindstack::FrameData &frame : frames) {
-        ptrs[rv++] = (void *)frame.pc;
+    if (incomplete && retry_regs) {
+        uint64_t load_count = sentry__modulefinder_get_load_count();
+        sentry__rwlock_lock(&g_lock);
+        update_state(load_count, true);
+        rv = unwind_with(&g_state->maps, g_state->process_memory,
+            retry_regs.get(), ptrs, max_frames);
+        sentry__rwlock_unlock(&g_lock);
     }
 
     return rv;
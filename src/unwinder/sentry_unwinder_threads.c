@@ -0,0 +1,475 @@
+#include "sentry_boot.h"
+
+#include "sentry_sync.h"
+#include "sentry_unwinder.h"
+#include "sentry_utils.h"
+
+#include <string.h>
+
+#ifdef SENTRY_PLATFORM_LINUX
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <sched.h>
+#    include <signal.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+
+/**
+ * To unwind another thread, it is sent `THREAD_CAPTURE_SIGNAL`. Its handler
+ * copies the context of the thread into `g_capture_context`, and keeps the
+ * thread waiting until the requesting thread has unwound its stack from that
+ * context. The handler itself only copies memory, the unwinding is always
+ * done on the requesting thread.
+ *
+ * `g_capture_state` holds the id of the thread whose context is requested, so
+ * a thread that only responds after we stopped waiting for it can not mistake
+ * the request for the next thread as its own. Only one request can be in
+ * flight at a time, so the requesting threads are serialized by
+ * `g_capture_owner`, which holds the id of the requesting thread. That works
+ * like a mutex, except that it can be taken from within the crash handler,
+ * which only waits for it so long.
+ *
+ * Our requests are queued along with `g_capture_state` as their value, and any
+ * other `THREAD_CAPTURE_SIGNAL` is passed on to the previous handler, so the
+ * signal still works for the application while we use it.
+ *
+ * Unwinders which can not unwind from a context, like `libbacktrace`, fall back
+ * to walking the frame records, which only gets past the interrupted function
+ * if the code was built with frame pointers.
+ */
+// this is ignored by default, in case it arrives after our handler is gone
+#    define THREAD_CAPTURE_SIGNAL SIGURG
+// how long a thread waits in its handler to be unwound
+#    define THREAD_RELEASE_TIMEOUT_MS 500
+
+#    define CAPTURE_IDLE 0
+#    define CAPTURE_RUNNING -1
+#    define CAPTURE_DONE -2
+
+static volatile long g_capture_owner = 0;
+static volatile long g_capture_state = CAPTURE_IDLE;
+static ucontext_t g_capture_context;
+
+static volatile long g_handler_refcount = 0;
+static struct sigaction g_previous_action;
+
+size_t sentry__unwind_stack_fp(
+    void *addr, const sentry_ucontext_t *uctx, void **ptrs, size_t max_frames);
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static bool
+is_capture_request(const siginfo_t *info)
+{
+    return info && info->si_code == SI_QUEUE && info->si_pid == getpid()
+        && info->si_value.sival_ptr == (void *)&g_capture_state;
+}
+
+/**
+ * Passes a signal that was not sent by us on to the handler that was installed
+ * before ours.
+ */
+static void
+chain_signal(int signum, siginfo_t *info, void *user_context)
+{
+    if (g_previous_action.sa_flags & SA_SIGINFO) {
+        if (g_previous_action.sa_sigaction) {
+            g_previous_action.sa_sigaction(signum, info, user_context);
+        }
+    } else if (g_previous_action.sa_handler != SIG_DFL
+        && g_previous_action.sa_handler != SIG_IGN) {
+        g_previous_action.sa_handler(signum);
+    }
+}
+
+static void
+handle_thread_capture(int signum, siginfo_t *info, void *user_context)
+{
+    if (!is_capture_request(info)) {
+        chain_signal(signum, info, user_context);
+        return;
+    }
+
+    int saved_errno = errno;
+    long tid = syscall(SYS_gettid);
+    if (__sync_bool_compare_and_swap(&g_capture_state, tid, CAPTURE_RUNNING)) {
+        memcpy(&g_capture_context, user_context, sizeof(ucontext_t));
+        sentry__atomic_store(&g_capture_state, CAPTURE_DONE);
+
+        // the stack of this thread needs to stay as it is until it was unwound
+        uint64_t deadline
+            = sentry__monotonic_time() + THREAD_RELEASE_TIMEOUT_MS;
+        while (sentry__atomic_fetch(&g_capture_state) == CAPTURE_DONE
+            && sentry__monotonic_time() < deadline) {
+            sched_yield();
+        }
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Sends our `THREAD_CAPTURE_SIGNAL` to the thread `tid`.
+ */
+static bool
+send_capture_request(long tid)
+{
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.si_signo = THREAD_CAPTURE_SIGNAL;
+    info.si_code = SI_QUEUE;
+    info.si_pid = getpid();
+    info.si_uid = getuid();
+    info.si_value.sival_ptr = (void *)&g_capture_state;
+    return syscall(SYS_rt_tgsigqueueinfo, getpid(), tid, THREAD_CAPTURE_SIGNAL,
+               &info)
+        == 0;
+}
+
+/**
+ * Waits for the thread to respond to the `request` in `g_capture_state`, and
+ * returns true once it is done with it.
+ */
+static bool
+wait_for_thread(long request, uint64_t timeout_ms)
+{
+    uint64_t deadline = sentry__monotonic_time() + timeout_ms;
+    while (sentry__monotonic_time() < deadline) {
+        if (sentry__atomic_fetch(&g_capture_state) == CAPTURE_DONE) {
+            return true;
+        }
+        sched_yield();
+    }
+    // once the thread started on the request, it finishes quickly
+    if (__sync_bool_compare_and_swap(&g_capture_state, request, CAPTURE_IDLE)) {
+        return false;
+    }
+    while (sentry__atomic_fetch(&g_capture_state) == CAPTURE_RUNNING) {
+        sched_yield();
+    }
+    return true;
+}
+
+/**
+ * Makes the calling thread `self` the only one that requests a context, and
+ * returns false if another thread did not finish its request within
+ * `timeout_ms`, or if the calling thread is already requesting one, which
+ * happens when it crashes while doing so.
+ */
+static bool
+lock_capture(long self, uint64_t timeout_ms)
+{
+    uint64_t deadline = sentry__monotonic_time() + timeout_ms;
+    while (!sentry__atomic_compare_swap(&g_capture_owner, 0, self)) {
+        if (sentry__atomic_fetch(&g_capture_owner) == self
+            || sentry__monotonic_time() >= deadline) {
+            return false;
+        }
+        sched_yield();
+    }
+    return true;
+}
+
+static void
+unlock_capture(void)
+{
+    sentry__atomic_store(&g_capture_owner, 0);
+}
+
+static size_t
+format_tid(char *buf, long tid)
+{
+    char digits[24];
+    size_t len = 0;
+    do {
+        digits[len++] = (char)('0' + tid % 10);
+        tid /= 10;
+    } while (tid && len < sizeof(digits));
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = digits[len - i - 1];
+    }
+    return len;
+}
+
+/**
+ * The names of the threads are cached in `g_thread_names`, so that they are
+ * only read from `/proc` once per thread. `sentry__thread_setname` updates
+ * the cache, and the background workers drop their entry when they exit, so
+ * that the id can be reused by another thread.
+ *
+ * Every entry is guarded by a sequence counter, which is odd while the entry
+ * is being written. Readers do not wait for writers, and treat an entry that
+ * changed while they read it as a cache miss, so the cache can be used from
+ * within a signal handler.
+ */
+#    define THREAD_NAME_CACHE_SIZE 64
+#    define THREAD_NAME_WORDS (16 / sizeof(long))
+
+typedef struct {
+    volatile long seq;
+    volatile long tid;
+    volatile long name[THREAD_NAME_WORDS];
+} thread_name_entry_t;
+
+static thread_name_entry_t g_thread_names[THREAD_NAME_CACHE_SIZE];
+
+static bool
+lookup_thread_name(long tid, char name[16])
+{
+    for (size_t i = 0; i < THREAD_NAME_CACHE_SIZE; i++) {
+        thread_name_entry_t *entry = &g_thread_names[i];
+        long seq = sentry__atomic_fetch(&entry->seq);
+        if (seq & 1 || sentry__atomic_fetch(&entry->tid) != tid) {
+            continue;
+        }
+        long words[THREAD_NAME_WORDS];
+        for (size_t j = 0; j < THREAD_NAME_WORDS; j++) {
+            words[j] = sentry__atomic_fetch(&entry->name[j]);
+        }
+        if (sentry__atomic_fetch(&entry->seq) != seq) {
+            return false;
+        }
+        memcpy(name, words, 16);
+        name[15] = '\0';
+        return true;
+    }
+    return false;
+}
+
+#    define ANY_THREAD -1
+
+/**
+ * Replaces the thread id and name of `entry`, if it belongs to the thread
+ * `expected`, where `ANY_THREAD` matches all the entries that are in use.
+ * Returns true if the entry was replaced.
+ */
+static bool
+replace_thread_name(
+    thread_name_entry_t *entry, long expected, long tid, const long *words)
+{
+    long seq = sentry__atomic_fetch(&entry->seq);
+    long entry_tid = sentry__atomic_fetch(&entry->tid);
+    bool matches = expected == ANY_THREAD ? entry_tid != 0
+                                          : entry_tid == expected;
+    // a concurrent writer changes the counter, so this fails for it
+    if (seq & 1 || !matches
+        || !sentry__atomic_compare_swap(&entry->seq, seq, seq + 1)) {
+        return false;
+    }
+    sentry__atomic_store(&entry->tid, tid);
+    for (size_t i = 0; i < THREAD_NAME_WORDS; i++) {
+        sentry__atomic_store(&entry->name[i], words[i]);
+    }
+    sentry__atomic_store(&entry->seq, seq + 2);
+    return true;
+}
+
+/**
+ * Caches `name` for the thread `tid`, or drops the cached name if `name` is
+ * NULL. A `tid` of `ANY_THREAD` drops the names of all the threads.
+ */
+static void
+store_thread_name(long tid, const char *name)
+{
+    long words[THREAD_NAME_WORDS];
+    memset(words, 0, sizeof(words));
+    if (name) {
+        size_t len = strlen(name);
+        memcpy(words, name, len < 15 ? len : 15);
+    }
+
+    bool replaced = false;
+    for (size_t i = 0; i < THREAD_NAME_CACHE_SIZE; i++) {
+        if (replace_thread_name(
+                &g_thread_names[i], tid, name ? tid : 0, words)) {
+            replaced = true;
+        }
+    }
+    for (size_t i = 0; name && !replaced && i < THREAD_NAME_CACHE_SIZE; i++) {
+        replaced = replace_thread_name(&g_thread_names[i], 0, tid, words);
+    }
+}
+
+static const char *
+read_thread_name(long tid, char name[16])
+{
+    static const char prefix[] = "/proc/self/task/";
+    static const char suffix[] = "/comm";
+    char path[sizeof(prefix) + 24 + sizeof(suffix)];
+    size_t len = sizeof(prefix) - 1;
+    memcpy(path, prefix, len);
+    len += format_tid(path + len, tid);
+    memcpy(path + len, suffix, sizeof(suffix));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    ssize_t read_len = read(fd, name, 15);
+    close(fd);
+    if (read_len <= 0) {
+        return NULL;
+    }
+    name[read_len] = '\0';
+    char *newline = strchr(name, '\n');
+    if (newline) {
+        *newline = '\0';
+    }
+    return name;
+}
+#endif
+
+void
+sentry__unwinder_threads_begin(void)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    if (sentry__atomic_fetch_and_add(&g_handler_refcount, 1) == 0) {
+        struct sigaction capture_action;
+        memset(&capture_action, 0, sizeof(capture_action));
+        sigemptyset(&capture_action.sa_mask);
+        capture_action.sa_sigaction = handle_thread_capture;
+        // the handler of a runtime that we chain to may need its own stack
+        capture_action.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+        sigaction(THREAD_CAPTURE_SIGNAL, &capture_action, &g_previous_action);
+    }
+#endif
+}
+
+void
+sentry__unwinder_threads_end(void)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    if (sentry__atomic_fetch_and_add(&g_handler_refcount, -1) == 1) {
+        sigaction(THREAD_CAPTURE_SIGNAL, &g_previous_action, NULL);
+    }
+#endif
+}
+
+long
+sentry__unwinder_current_tid(void)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    return syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+size_t
+sentry__unwinder_foreach_thread(
+    bool (*callback)(long tid, void *data), void *data)
+{
+    size_t thread_count = 0;
+#ifdef SENTRY_PLATFORM_LINUX
+    int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    char buf[1024];
+    long len;
+    bool done = false;
+    while (!done && (len = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (long offset = 0; !done && offset < len;) {
+            struct linux_dirent64 *entry
+                = (struct linux_dirent64 *)(buf + offset);
+            offset += entry->d_reclen;
+            long tid = 0;
+            for (const char *c = entry->d_name; *c >= '0' && *c <= '9'; c++) {
+                tid = tid * 10 + (*c - '0');
+            }
+            if (tid > 0) {
+                thread_count++;
+                done = !callback(tid, data);
+            }
+        }
+    }
+    close(fd);
+#else
+    (void)callback;
+    (void)data;
+#endif
+    return thread_count;
+}
+
+const char *
+sentry__unwinder_thread_name(long tid, char name[16])
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    if (lookup_thread_name(tid, name)) {
+        return name;
+    }
+    if (!read_thread_name(tid, name)) {
+        return NULL;
+    }
+    store_thread_name(tid, name);
+    return name;
+#else
+    (void)tid;
+    (void)name;
+    return NULL;
+#endif
+}
+
+void
+sentry__unwinder_cache_thread_name(long tid, const char *name)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    store_thread_name(tid ? tid : syscall(SYS_gettid), name);
+#else
+    (void)tid;
+    (void)name;
+#endif
+}
+
+void
+sentry__unwinder_reset_thread_names(void)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    store_thread_name(ANY_THREAD, NULL);
+#endif
+}
+
+size_t
+sentry__unwind_thread(
+    long tid, void **ptrs, size_t max_frames, uint64_t timeout_ms)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    long self = syscall(SYS_gettid);
+    if (!sentry__atomic_fetch(&g_handler_refcount) || tid == self
+        || !lock_capture(self, timeout_ms)) {
+        return 0;
+    }
+    sentry__atomic_store(&g_capture_state, tid);
+    if (!send_capture_request(tid) || !wait_for_thread(tid, timeout_ms)) {
+        sentry__atomic_store(&g_capture_state, CAPTURE_IDLE);
+        unlock_capture();
+        SENTRY_TRACEF("thread %ld did not respond in time", tid);
+        return 0;
+    }
+
+    sentry_ucontext_t uctx;
+    memset(&uctx, 0, sizeof(uctx));
+    uctx.signum = THREAD_CAPTURE_SIGNAL;
+    uctx.user_context = &g_capture_context;
+    size_t frame_count
+        = sentry_unwind_stack_from_ucontext(&uctx, ptrs, max_frames);
+    if (!frame_count) {
+        frame_count = sentry__unwind_stack_fp(NULL, &uctx, ptrs, max_frames);
+    }
+    // this releases the thread
+    sentry__atomic_store(&g_capture_state, CAPTURE_IDLE);
+    unlock_capture();
+    return frame_count;
+#else
+    (void)tid;
+    (void)ptrs;
+    (void)max_frames;
+    (void)timeout_ms;
+    return 0;
+#endif
+}
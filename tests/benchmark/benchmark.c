@@ -0,0 +1,532 @@
+/*
+Microbenchmarks of the hot paths of the SDK.
+
+Build with optimizations and run via:
+
+cmake -B bench -D SENTRY_BUILD_BENCHMARKS=ON -D CMAKE_BUILD_TYPE=Release
+cmake --build bench --parallel --target sentry_benchmarks
+bench/tests/benchmark/sentry_benchmarks [options] [name...]
+
+Every benchmark prints a single line with a JSON object, which contains the
+number of `iterations` per sample, the `median_ns` and `min_ns` per iteration
+over all samples, and the average number of `allocations` made through
+`sentry_malloc` per iteration.
+
+With `--baseline <file>`, the results are compared against the output of a
+previous run stored in that file, like the ones in `baselines`. The run fails
+when the median of a benchmark is more than `--max-regression <percent>` (20
+by default) slower than its baseline, or when it makes more allocations.
+*/
+
+#include "sentry_boot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sentry_core.h"
+#include "sentry_envelope.h"
+#include "sentry_json.h"
+#include "sentry_modulefinder.h"
+#include "sentry_path.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+#define SAMPLE_COUNT 7
+#define MIN_SAMPLE_NS 50000000
+#define DEFAULT_MAX_REGRESSION 20.0
+// the allocation counts vary slightly with the number of iterations for some
+// benchmarks, and are printed with two decimals
+#define ALLOCATION_TOLERANCE 0.01
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*run)(size_t iterations);
+    void (*teardown)(void);
+} benchmark_t;
+
+static sentry_value_t g_event;
+static char *g_event_json;
+static size_t g_event_json_len;
+static sentry_value_t g_object;
+static sentry_stringbuilder_t g_sb;
+static sentry_transaction_t *g_tx;
+static sentry_bgworker_t *g_bgw;
+
+static volatile long g_allocations;
+static sentry_value_t g_baseline;
+static double g_max_regression = DEFAULT_MAX_REGRESSION;
+
+static const char *const KEYS[] = { "event_id", "timestamp", "platform",
+    "level", "logger", "transaction", "server_name", "release", "dist",
+    "environment", "message", "tags", "extra", "user", "contexts",
+    "breadcrumbs" };
+
+#define KEY_COUNT (sizeof(KEYS) / sizeof(KEYS[0]))
+
+/**
+ * Makes an event that resembles a typical captured message, with tags, extra
+ * data and breadcrumbs.
+ */
+static sentry_value_t
+make_event(void)
+{
+    sentry_value_t event = sentry_value_new_message_event(
+        SENTRY_LEVEL_ERROR, "benchmark", "something went wrong in a benchmark");
+    sentry_value_set_by_key(
+        event, "release", sentry_value_new_string("benchmark@1.0.0"));
+    sentry_value_set_by_key(
+        event, "environment", sentry_value_new_string("production"));
+
+    sentry_value_t tags = sentry_value_new_object();
+    sentry_value_t extra = sentry_value_new_object();
+    for (int i = 0; i < 10; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key-%d", i);
+        sentry_value_set_by_key(tags, key, sentry_value_new_string("a tag"));
+        sentry_value_set_by_key(extra, key, sentry_value_new_double(i * 1.5));
+    }
+    sentry_value_set_by_key(event, "tags", tags);
+    sentry_value_set_by_key(event, "extra", extra);
+
+    sentry_value_t breadcrumbs = sentry_value_new_list();
+    for (int i = 0; i < 20; i++) {
+        sentry_value_t breadcrumb
+            = sentry_value_new_breadcrumb("navigation", "opened a screen");
+        sentry_value_t data = sentry_value_new_object();
+        sentry_value_set_by_key(data, "index", sentry_value_new_int32(i));
+        sentry_value_set_by_key(breadcrumb, "data", data);
+        sentry_value_append(breadcrumbs, breadcrumb);
+    }
+    sentry_value_set_by_key(event, "breadcrumbs", breadcrumbs);
+    return event;
+}
+
+static void
+setup_event(void)
+{
+    g_event = make_event();
+    g_event_json = sentry_value_to_json(g_event);
+    g_event_json_len = strlen(g_event_json);
+}
+
+static void
+teardown_event(void)
+{
+    sentry_value_decref(g_event);
+    sentry_free(g_event_json);
+}
+
+static void
+run_value_construction(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry_value_t object = sentry_value_new_object();
+        for (size_t j = 0; j < KEY_COUNT; j++) {
+            sentry_value_set_by_key(
+                object, KEYS[j], sentry_value_new_string(KEYS[j]));
+        }
+        sentry_value_decref(object);
+    }
+}
+
+static void
+setup_value_lookup(void)
+{
+    g_object = sentry_value_new_object();
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        sentry_value_set_by_key(
+            g_object, KEYS[i], sentry_value_new_int32((int32_t)i));
+    }
+}
+
+static void
+teardown_value_lookup(void)
+{
+    sentry_value_decref(g_object);
+}
+
+static void
+run_value_lookup(size_t iterations)
+{
+    int32_t sum = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        sum += sentry_value_as_int32(
+            sentry_value_get_by_key(g_object, KEYS[i % KEY_COUNT]));
+    }
+    if (sum < 0) {
+        abort();
+    }
+}
+
+static void
+run_json_serialize(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+        sentry__jsonwriter_write_value(jw, g_event);
+        size_t len = 0;
+        sentry_free(sentry__jsonwriter_into_string(jw, &len));
+    }
+}
+
+static void
+run_json_parse(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry_value_decref(
+            sentry__value_from_json(g_event_json, g_event_json_len));
+    }
+}
+
+static void
+setup_msgpack_encode(void)
+{
+    setup_event();
+    sentry__stringbuilder_init(&g_sb);
+}
+
+static void
+teardown_msgpack_encode(void)
+{
+    sentry__stringbuilder_cleanup(&g_sb);
+    teardown_event();
+}
+
+static void
+run_msgpack_encode(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry__stringbuilder_set_len(&g_sb, 0);
+        sentry__value_append_msgpack(&g_sb, g_event);
+    }
+}
+
+static void
+run_envelope_serialize(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry_envelope_t *envelope = sentry__envelope_new();
+        sentry_value_incref(g_event);
+        sentry__envelope_add_event(envelope, g_event);
+        sentry_stringbuilder_t sb;
+        sentry__stringbuilder_init(&sb);
+        sentry__envelope_serialize_into_stringbuilder(envelope, &sb);
+        sentry__stringbuilder_cleanup(&sb);
+        sentry_envelope_free(envelope);
+    }
+}
+
+static void
+setup_sdk(void)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_database_path(options, ".sentry-benchmarks");
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_init(options);
+}
+
+static void
+teardown_sdk(void)
+{
+    sentry_close();
+}
+
+static void
+run_breadcrumb_add(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry_add_breadcrumb(
+            sentry_value_new_breadcrumb("navigation", "opened a screen"));
+    }
+}
+
+#define SPANS_PER_TRANSACTION 500
+
+static void
+start_transaction(void)
+{
+    sentry_transaction_context_t *tx_ctx
+        = sentry_transaction_context_new("benchmark", "benchmark");
+    g_tx = sentry_transaction_start(tx_ctx, sentry_value_new_null());
+}
+
+static void
+setup_span(void)
+{
+    setup_sdk();
+    start_transaction();
+}
+
+static void
+teardown_span(void)
+{
+    sentry_transaction_finish(g_tx);
+    teardown_sdk();
+}
+
+static void
+run_span_start_finish(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        // the transactions are replaced regularly so that they stay below
+        // `max_spans`, which includes finishing them in the measurement
+        if (i % SPANS_PER_TRANSACTION == SPANS_PER_TRANSACTION - 1) {
+            sentry_transaction_finish(g_tx);
+            start_transaction();
+        }
+        sentry_span_t *span
+            = sentry_transaction_start_child(g_tx, "benchmark", "a span");
+        sentry_span_finish(span);
+    }
+}
+
+static void
+noop_task(void *UNUSED(task_data), void *UNUSED(state))
+{
+}
+
+static void
+setup_bgworker(void)
+{
+    g_bgw = sentry__bgworker_new(NULL, NULL);
+    sentry__bgworker_start(g_bgw);
+}
+
+static void
+teardown_bgworker(void)
+{
+    sentry__bgworker_shutdown(g_bgw, 5000);
+    sentry__bgworker_decref(g_bgw);
+}
+
+static void
+run_bgworker_submit(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry__bgworker_submit(g_bgw, noop_task, NULL, NULL);
+    }
+    // the throughput includes executing the tasks
+    sentry__bgworker_flush(g_bgw, 5000);
+}
+
+static void
+run_modulefinder_load(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sentry__modulefinder_cleanup();
+        sentry_value_decref(sentry_get_modules_list());
+    }
+}
+
+static const benchmark_t BENCHMARKS[] = {
+    { "value_construction", NULL, run_value_construction, NULL },
+    { "value_lookup", setup_value_lookup, run_value_lookup,
+        teardown_value_lookup },
+    { "json_serialize", setup_event, run_json_serialize, teardown_event },
+    { "json_parse", setup_event, run_json_parse, teardown_event },
+    { "msgpack_encode", setup_msgpack_encode, run_msgpack_encode,
+        teardown_msgpack_encode },
+    { "envelope_serialize", setup_event, run_envelope_serialize,
+        teardown_event },
+    { "breadcrumb_add", setup_sdk, run_breadcrumb_add, teardown_sdk },
+    { "span_start_finish", setup_span, run_span_start_finish, teardown_span },
+    { "bgworker_submit", setup_bgworker, run_bgworker_submit,
+        teardown_bgworker },
+    { "modulefinder_load", NULL, run_modulefinder_load, NULL },
+};
+
+static void *
+counting_malloc(size_t size, void *UNUSED(user_data))
+{
+    sentry__atomic_fetch_and_add(&g_allocations, 1);
+    return malloc(size);
+}
+
+static void
+counting_free(void *ptr, void *UNUSED(user_data))
+{
+    free(ptr);
+}
+
+/**
+ * Loads the results of a previous run, one JSON object per line, into
+ * `g_baseline`, keyed by their name. Returns 0 on success.
+ */
+static int
+load_baseline(const char *filename)
+{
+    sentry_path_t *path = sentry__path_from_str(filename);
+    size_t len = 0;
+    char *buf = path ? sentry__path_read_to_buffer(path, &len) : NULL;
+    sentry__path_free(path);
+    if (!buf) {
+        fprintf(stderr, "failed to read baseline \"%s\"\n", filename);
+        return 1;
+    }
+
+    g_baseline = sentry_value_new_object();
+    for (char *line = buf; line < buf + len;) {
+        char *newline = memchr(line, '\n', (size_t)(buf + len - line));
+        char *end = newline ? newline : buf + len;
+        sentry_value_t result
+            = sentry__value_from_json(line, (size_t)(end - line));
+        const char *name = sentry_value_as_string(
+            sentry_value_get_by_key(result, "name"));
+        if (*name) {
+            sentry_value_set_by_key(g_baseline, name, result);
+        } else {
+            sentry_value_decref(result);
+        }
+        line = end + 1;
+    }
+    sentry_free(buf);
+    return 0;
+}
+
+/**
+ * Compares the results of the benchmark `name` against its baseline, if
+ * there is one. Returns false if it regressed.
+ */
+static bool
+check_baseline(const char *name, uint64_t median_ns, double allocations)
+{
+    sentry_value_t baseline = sentry_value_get_by_key(g_baseline, name);
+    if (sentry_value_is_null(baseline)) {
+        return true;
+    }
+    bool rv = true;
+    double baseline_ns = sentry_value_as_double(
+        sentry_value_get_by_key(baseline, "median_ns"));
+    double regression = (median_ns / baseline_ns - 1.0) * 100.0;
+    if (regression > g_max_regression) {
+        fprintf(stderr,
+            "%s: %llu ns per iteration is %.1f%% slower than the baseline of "
+            "%.0f ns\n",
+            name, (unsigned long long)median_ns, regression, baseline_ns);
+        rv = false;
+    }
+    double baseline_allocations = sentry_value_as_double(
+        sentry_value_get_by_key(baseline, "allocations"));
+    if (allocations
+        > baseline_allocations * (1.0 + ALLOCATION_TOLERANCE) + 0.005) {
+        fprintf(stderr,
+            "%s: %.2f allocations per iteration are more than the baseline "
+            "of %.2f\n",
+            name, allocations, baseline_allocations);
+        rv = false;
+    }
+    return rv;
+}
+
+static uint64_t
+time_run(const benchmark_t *benchmark, size_t iterations)
+{
+    uint64_t started = sentry__monotonic_time_ns();
+    benchmark->run(iterations);
+    return sentry__monotonic_time_ns() - started;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+/**
+ * Runs the `benchmark`, and returns false if it regressed compared to the
+ * baseline.
+ */
+static bool
+run_benchmark(const benchmark_t *benchmark)
+{
+    if (benchmark->setup) {
+        benchmark->setup();
+    }
+
+    // double the iterations until a sample takes long enough to be measured
+    // reliably, which also warms up the caches
+    size_t iterations = 1;
+    while (time_run(benchmark, iterations) < MIN_SAMPLE_NS
+        && iterations < ((size_t)1 << 30)) {
+        iterations *= 2;
+    }
+
+    uint64_t ns_per_iteration[SAMPLE_COUNT];
+    long allocations_before = sentry__atomic_fetch(&g_allocations);
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        ns_per_iteration[i] = time_run(benchmark, iterations) / iterations;
+    }
+    double allocations
+        = (double)(sentry__atomic_fetch(&g_allocations) - allocations_before)
+        / (double)(iterations * SAMPLE_COUNT);
+    qsort(ns_per_iteration, SAMPLE_COUNT, sizeof(uint64_t), compare_u64);
+
+    if (benchmark->teardown) {
+        benchmark->teardown();
+    }
+
+    uint64_t median_ns = ns_per_iteration[SAMPLE_COUNT / 2];
+    printf("{\"name\":\"%s\",\"iterations\":%llu,\"samples\":%d,"
+           "\"median_ns\":%llu,\"min_ns\":%llu,\"allocations\":%.2f}\n",
+        benchmark->name, (unsigned long long)iterations, SAMPLE_COUNT,
+        (unsigned long long)median_ns, (unsigned long long)ns_per_iteration[0],
+        allocations);
+    fflush(stdout);
+    return check_baseline(benchmark->name, median_ns, allocations);
+}
+
+int
+main(int argc, char **argv)
+{
+    // this has to come before anything else allocates
+    sentry_set_allocator(counting_malloc, counting_free, NULL);
+    g_baseline = sentry_value_new_null();
+
+    size_t benchmark_count = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+    int rv = 0;
+    int names = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            sentry_value_decref(g_baseline);
+            if (load_baseline(argv[++i]) != 0) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-regression") == 0 && i + 1 < argc) {
+            g_max_regression = strtod(argv[++i], NULL);
+        } else {
+            argv[++names] = argv[i];
+        }
+    }
+
+    if (!names) {
+        for (size_t i = 0; i < benchmark_count; i++) {
+            if (!run_benchmark(&BENCHMARKS[i])) {
+                rv = 1;
+            }
+        }
+    }
+    for (int i = 1; i <= names; i++) {
+        bool found = false;
+        for (size_t j = 0; j < benchmark_count; j++) {
+            if (strcmp(argv[i], BENCHMARKS[j].name) == 0) {
+                if (!run_benchmark(&BENCHMARKS[j])) {
+                    rv = 1;
+                }
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "unknown benchmark \"%s\"\n", argv[i]);
+            rv = 1;
+        }
+    }
+    sentry_value_decref(g_baseline);
+    return rv;
+}
@@ -0,0 +1,329 @@
+/*
+End-to-end benchmark of capturing events from many threads at once.
+
+Every thread adds breadcrumbs, finishes a transaction with a child span every
+tenth iteration, and captures an event, measuring how long each
+`sentry_capture_event` call takes. Meanwhile, the depth of the send queue
+and the resident memory of the process are sampled.
+
+Run via:
+
+bench/tests/benchmark/sentry_benchmark_capture [options]
+
+    --threads N       the number of capturing threads (default 4)
+    --events N        the number of events per thread (default 1000)
+    --dsn DSN         sends the envelopes via the default transport to DSN,
+                      like a local mock ingest server, instead of dropping
+                      them in a function transport
+    --async-capture   enables `sentry_options_set_async_capture`
+
+The results are printed as a single JSON object.
+*/
+
+#include "sentry_boot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sentry_sync.h"
+#include "sentry_utils.h"
+
+#if defined(SENTRY_PLATFORM_WINDOWS)
+#    include <psapi.h>
+#elif defined(SENTRY_PLATFORM_DARWIN)
+#    include <mach/mach.h>
+#elif defined(SENTRY_PLATFORM_LINUX)
+#    include <unistd.h>
+#endif
+
+#define SAMPLE_INTERVAL_MS 10
+#define MAX_SAMPLES 100000
+
+typedef struct {
+    size_t index;
+    size_t event_count;
+    uint64_t *latencies_ns;
+} capture_thread_t;
+
+typedef struct {
+    uint64_t time_ms;
+    int64_t queue_depth;
+    size_t rss_bytes;
+} sample_t;
+
+static long g_envelopes = 0;
+static long g_sampling = 0;
+static sentry_mutex_t g_sampler_lock = SENTRY__MUTEX_INIT;
+static sentry_cond_t g_sampler_cond;
+static sample_t *g_samples;
+static size_t g_sample_count = 0;
+
+static size_t
+get_rss_bytes(void)
+{
+#if defined(SENTRY_PLATFORM_WINDOWS)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(
+            GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(SENTRY_PLATFORM_DARWIN)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info,
+            &count)
+        == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+    return 0;
+#elif defined(SENTRY_PLATFORM_LINUX)
+    size_t rss_bytes = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        if (fscanf(statm, "%lu %lu", &size, &resident) == 2) {
+            rss_bytes = resident * (size_t)sysconf(_SC_PAGESIZE);
+        }
+        fclose(statm);
+    }
+    return rss_bytes;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Returns the number of envelopes in the send queue, or -1 if the transport
+ * does not report it.
+ */
+static int64_t
+get_queue_depth(void)
+{
+    sentry_value_t stats = sentry_get_transport_stats();
+    int64_t depth = sentry_value_is_null(stats)
+        ? -1
+        : sentry_value_as_int64(sentry_value_get_by_key(stats, "queue_depth"));
+    sentry_value_decref(stats);
+    return depth;
+}
+
+SENTRY_THREAD_FN
+sampler_thread(void *UNUSED(data))
+{
+    uint64_t started = sentry__monotonic_time();
+    sentry__mutex_lock(&g_sampler_lock);
+    while (sentry__atomic_fetch(&g_sampling) && g_sample_count < MAX_SAMPLES) {
+        sample_t *sample = &g_samples[g_sample_count++];
+        sample->time_ms = sentry__monotonic_time() - started;
+        sample->queue_depth = get_queue_depth();
+        sample->rss_bytes = get_rss_bytes();
+        sentry__cond_wait_timeout(
+            &g_sampler_cond, &g_sampler_lock, SAMPLE_INTERVAL_MS);
+    }
+    sentry__mutex_unlock(&g_sampler_lock);
+    return 0;
+}
+
+static void
+count_envelope(const sentry_envelope_t *UNUSED(envelope), void *UNUSED(data))
+{
+    sentry__atomic_fetch_and_add(&g_envelopes, 1);
+}
+
+SENTRY_THREAD_FN
+capture_thread(void *data)
+{
+    capture_thread_t *thread = data;
+    for (size_t i = 0; i < thread->event_count; i++) {
+        sentry_add_breadcrumb(
+            sentry_value_new_breadcrumb("navigation", "opened a screen"));
+
+        if (i % 10 == 0) {
+            sentry_transaction_context_t *tx_ctx
+                = sentry_transaction_context_new("benchmark", "benchmark");
+            sentry_transaction_t *tx
+                = sentry_transaction_start(tx_ctx, sentry_value_new_null());
+            sentry_span_t *span
+                = sentry_transaction_start_child(tx, "benchmark", "a span");
+            sentry_span_finish(span);
+            sentry_transaction_finish(tx);
+        }
+
+        sentry_value_t event = sentry_value_new_message_event(
+            SENTRY_LEVEL_INFO, "benchmark", "captured by a benchmark");
+        sentry_value_t extra = sentry_value_new_object();
+        sentry_value_set_by_key(
+            extra, "thread", sentry_value_new_uint64(thread->index));
+        sentry_value_set_by_key(event, "extra", extra);
+
+        uint64_t started = sentry__monotonic_time_ns();
+        sentry_capture_event(event);
+        thread->latencies_ns[i] = sentry__monotonic_time_ns() - started;
+    }
+    return 0;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static sentry_value_t
+percentile(const uint64_t *sorted, size_t count, size_t percent)
+{
+    return sentry_value_new_uint64(
+        count ? sorted[(count - 1) * percent / 100] : 0);
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t thread_count = 4;
+    size_t event_count = 1000;
+    const char *dsn = NULL;
+    bool async_capture = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            event_count = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dsn") == 0 && i + 1 < argc) {
+            dsn = argv[++i];
+        } else if (strcmp(argv[i], "--async-capture") == 0) {
+            async_capture = true;
+        } else {
+            fprintf(stderr, "unknown argument \"%s\"\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!thread_count || !event_count) {
+        fprintf(stderr, "--threads and --events must be positive\n");
+        return 1;
+    }
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_database_path(options, ".sentry-benchmarks");
+    sentry_options_set_release(options, "benchmark@1.0.0");
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_async_capture(options, async_capture);
+    if (dsn) {
+        sentry_options_set_dsn(options, dsn);
+    } else {
+        sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+        sentry_options_set_transport(
+            options, sentry_new_function_transport(count_envelope, NULL));
+    }
+    sentry_init(options);
+
+    g_samples = sentry_malloc(sizeof(sample_t) * MAX_SAMPLES);
+    capture_thread_t *threads
+        = sentry_malloc(sizeof(capture_thread_t) * thread_count);
+    sentry_threadid_t *thread_ids
+        = sentry_malloc(sizeof(sentry_threadid_t) * thread_count);
+    uint64_t *latencies_ns
+        = sentry_malloc(sizeof(uint64_t) * thread_count * event_count);
+    if (!g_samples || !threads || !thread_ids || !latencies_ns) {
+        fprintf(stderr, "failed to allocate the results\n");
+        return 1;
+    }
+
+    sentry__cond_init(&g_sampler_cond);
+    sentry__atomic_store(&g_sampling, 1);
+    sentry_threadid_t sampler_id;
+    sentry__thread_init(&sampler_id);
+    sentry__thread_spawn(&sampler_id, sampler_thread, NULL);
+
+    uint64_t started = sentry__monotonic_time_ns();
+    for (size_t i = 0; i < thread_count; i++) {
+        threads[i].index = i;
+        threads[i].event_count = event_count;
+        threads[i].latencies_ns = &latencies_ns[i * event_count];
+        sentry__thread_init(&thread_ids[i]);
+        sentry__thread_spawn(&thread_ids[i], capture_thread, &threads[i]);
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        sentry__thread_join(thread_ids[i]);
+        sentry__thread_free(&thread_ids[i]);
+    }
+    uint64_t captured_ns = sentry__monotonic_time_ns() - started;
+
+    // the queue keeps being sampled while it drains
+    sentry_flush(30000);
+    uint64_t flushed_ns = sentry__monotonic_time_ns() - started;
+
+    sentry__atomic_store(&g_sampling, 0);
+    sentry__cond_wake(&g_sampler_cond);
+    sentry__thread_join(sampler_id);
+    sentry__thread_free(&sampler_id);
+
+    sentry_close();
+
+    size_t latency_count = thread_count * event_count;
+    qsort(latencies_ns, latency_count, sizeof(uint64_t), compare_u64);
+
+    sentry_value_t results = sentry_value_new_object();
+    sentry_value_set_by_key(results, "transport",
+        sentry_value_new_string(dsn ? "default" : "function"));
+    sentry_value_set_by_key(
+        results, "async_capture", sentry_value_new_bool(async_capture));
+    sentry_value_set_by_key(
+        results, "threads", sentry_value_new_uint64(thread_count));
+    sentry_value_set_by_key(
+        results, "events", sentry_value_new_uint64(latency_count));
+    sentry_value_set_by_key(
+        results, "capture_ms", sentry_value_new_double(captured_ns / 1e6));
+    sentry_value_set_by_key(
+        results, "flush_ms", sentry_value_new_double(flushed_ns / 1e6));
+    sentry_value_set_by_key(results, "events_per_sec",
+        sentry_value_new_double(latency_count / (captured_ns / 1e9)));
+    if (!dsn) {
+        sentry_value_set_by_key(results, "envelopes",
+            sentry_value_new_int64(sentry__atomic_fetch(&g_envelopes)));
+    }
+
+    sentry_value_t latency = sentry_value_new_object();
+    sentry_value_set_by_key(
+        latency, "p50", percentile(latencies_ns, latency_count, 50));
+    sentry_value_set_by_key(
+        latency, "p99", percentile(latencies_ns, latency_count, 99));
+    sentry_value_set_by_key(
+        latency, "max", percentile(latencies_ns, latency_count, 100));
+    sentry_value_set_by_key(results, "capture_latency_ns", latency);
+
+    size_t peak_rss_bytes = 0;
+    sentry_value_t samples = sentry_value_new_list();
+    for (size_t i = 0; i < g_sample_count; i++) {
+        sentry_value_t sample = sentry_value_new_object();
+        sentry_value_set_by_key(
+            sample, "time_ms", sentry_value_new_uint64(g_samples[i].time_ms));
+        sentry_value_set_by_key(sample, "queue_depth",
+            sentry_value_new_int64(g_samples[i].queue_depth));
+        sentry_value_set_by_key(sample, "rss_bytes",
+            sentry_value_new_uint64(g_samples[i].rss_bytes));
+        sentry_value_append(samples, sample);
+        if (g_samples[i].rss_bytes > peak_rss_bytes) {
+            peak_rss_bytes = g_samples[i].rss_bytes;
+        }
+    }
+    sentry_value_set_by_key(
+        results, "peak_rss_bytes", sentry_value_new_uint64(peak_rss_bytes));
+    sentry_value_set_by_key(results, "samples", samples);
+
+    char *json = sentry_value_to_json(results);
+    printf("%s\n", json);
+    sentry_free(json);
+    sentry_value_decref(results);
+
+    sentry_free(latencies_ns);
+    sentry_free(thread_ids);
+    sentry_free(threads);
+    sentry_free(g_samples);
+    return 0;
+}
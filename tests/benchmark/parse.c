@@ -0,0 +1,386 @@
+/*
+Throughput benchmark of the parsers, replaying the fuzzing corpora as well as
+synthetic large events, sessions and envelopes.
+
+Build with optimizations and run via:
+
+cmake -B bench -D SENTRY_BUILD_BENCHMARKS=ON -D CMAKE_BUILD_TYPE=Release
+cmake --build bench --parallel --target sentry_benchmark_parse
+bench/tests/benchmark/sentry_benchmark_parse [path...]
+
+The `fuzzing-examples` and `tests/fuzzing-failures` corpora are always
+replayed, any files or directories given as arguments are added to them.
+
+Every workload prints a single line with a JSON object, which contains the
+number of `bytes` that one pass parses, the number of `passes` per sample and
+the `median_mb_per_sec` and `max_mb_per_sec` over all samples.
+*/
+
+#include "sentry_boot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sentry_envelope.h"
+#include "sentry_json.h"
+#include "sentry_path.h"
+#include "sentry_session.h"
+#include "sentry_string.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+#define SAMPLE_COUNT 7
+#define MIN_SAMPLE_NS 50000000
+#define MAX_INPUTS 4096
+#define SYNTHETIC_SESSION_COUNT 256
+
+typedef struct {
+    char *buf;
+    size_t len;
+} input_t;
+
+typedef struct {
+    input_t items[MAX_INPUTS];
+    size_t count;
+    size_t bytes;
+} inputs_t;
+
+typedef struct {
+    const char *name;
+    size_t (*run)(void);
+} workload_t;
+
+static inputs_t g_json_inputs;
+static inputs_t g_session_inputs;
+static sentry_path_t *g_envelope_path;
+static size_t g_envelope_len;
+
+static void
+add_input(inputs_t *inputs, char *buf, size_t len)
+{
+    if (inputs->count == MAX_INPUTS) {
+        sentry_free(buf);
+        return;
+    }
+    inputs->items[inputs->count].buf = buf;
+    inputs->items[inputs->count].len = len;
+    inputs->count++;
+    inputs->bytes += len;
+}
+
+static void
+add_file(const sentry_path_t *path)
+{
+    size_t len = 0;
+    char *buf = sentry__path_read_to_buffer(path, &len);
+    if (!buf) {
+        return;
+    }
+    // files that are valid sessions are parsed as sessions too, everything
+    // is parsed as plain json
+    sentry_session_t *session = sentry__session_from_json(buf, len);
+    if (session) {
+        sentry__session_free(session);
+        char *copy = sentry__string_clonen(buf, len);
+        if (copy) {
+            add_input(&g_session_inputs, copy, len);
+        }
+    }
+    add_input(&g_json_inputs, buf, len);
+}
+
+static void
+add_path(const sentry_path_t *path)
+{
+    if (!sentry__path_is_dir(path)) {
+        add_file(path);
+        return;
+    }
+    sentry_pathiter_t *piter = sentry__path_iter_directory(path);
+    const sentry_path_t *file;
+    while ((file = sentry__pathiter_next(piter)) != NULL) {
+        if (sentry__path_is_file(file)) {
+            add_file(file);
+        }
+    }
+    sentry__pathiter_free(piter);
+}
+
+static void
+add_corpora(void)
+{
+    sentry_path_t *file = sentry__path_from_str(__FILE__);
+    sentry_path_t *benchmark_dir = sentry__path_dir(file);
+    sentry_path_t *tests_dir = sentry__path_dir(benchmark_dir);
+    sentry_path_t *root_dir = sentry__path_dir(tests_dir);
+
+    sentry_path_t *examples
+        = sentry__path_join_str(root_dir, "fuzzing-examples");
+    sentry_path_t *failures
+        = sentry__path_join_str(tests_dir, "fuzzing-failures");
+    add_path(examples);
+    add_path(failures);
+
+    sentry__path_free(failures);
+    sentry__path_free(examples);
+    sentry__path_free(root_dir);
+    sentry__path_free(tests_dir);
+    sentry__path_free(benchmark_dir);
+    sentry__path_free(file);
+}
+
+/**
+ * Makes a native crash event, with a long stack trace, many breadcrumbs and a
+ * large list of loaded images.
+ */
+static sentry_value_t
+make_large_event(void)
+{
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_set_by_key(event, "level", sentry_value_new_string("fatal"));
+    sentry_value_set_by_key(
+        event, "release", sentry_value_new_string("benchmark@1.0.0"));
+
+    sentry_value_t frames = sentry_value_new_list();
+    for (int i = 0; i < 200; i++) {
+        char addr[32];
+        snprintf(addr, sizeof(addr), "0x%llx", 0x7ff812340000ULL + i * 0x40);
+        sentry_value_t frame = sentry_value_new_object();
+        sentry_value_set_by_key(
+            frame, "instruction_addr", sentry_value_new_string(addr));
+        sentry_value_set_by_key(
+            frame, "function", sentry_value_new_string("some::namespace::fn"));
+        sentry_value_set_by_key(
+            frame, "package", sentry_value_new_string("/usr/lib/libfoo.so"));
+        sentry_value_append(frames, frame);
+    }
+    sentry_value_t stacktrace = sentry_value_new_object();
+    sentry_value_set_by_key(stacktrace, "frames", frames);
+    sentry_value_t exception
+        = sentry_value_new_exception("SIGSEGV", "Segfault");
+    sentry_value_set_by_key(exception, "stacktrace", stacktrace);
+    sentry_event_add_exception(event, exception);
+
+    sentry_value_t breadcrumbs = sentry_value_new_list();
+    for (int i = 0; i < 100; i++) {
+        sentry_value_t breadcrumb
+            = sentry_value_new_breadcrumb("http", "GET https://example.com");
+        sentry_value_t data = sentry_value_new_object();
+        sentry_value_set_by_key(
+            data, "status_code", sentry_value_new_int32(200));
+        sentry_value_set_by_key(
+            data, "duration", sentry_value_new_double(1.5));
+        sentry_value_set_by_key(breadcrumb, "data", data);
+        sentry_value_append(breadcrumbs, breadcrumb);
+    }
+    sentry_value_set_by_key(event, "breadcrumbs", breadcrumbs);
+
+    sentry_value_t images = sentry_value_new_list();
+    for (int i = 0; i < 300; i++) {
+        char name[64];
+        char addr[32];
+        snprintf(name, sizeof(name), "/usr/lib/libmodule%d.so", i);
+        snprintf(
+            addr, sizeof(addr), "0x%llx", 0x7ff800000000ULL + i * 0x10000);
+        sentry_value_t image = sentry_value_new_object();
+        sentry_value_set_by_key(
+            image, "type", sentry_value_new_string("elf"));
+        sentry_value_set_by_key(
+            image, "code_file", sentry_value_new_string(name));
+        sentry_value_set_by_key(
+            image, "image_addr", sentry_value_new_string(addr));
+        sentry_value_set_by_key(
+            image, "image_size", sentry_value_new_int32(0x10000));
+        sentry_value_set_by_key(image, "debug_id",
+            sentry_value_new_string("c0bcc3f1-9827-fe65-3058-404b2831d9e6"));
+        sentry_value_append(images, image);
+    }
+    sentry_value_t debug_meta = sentry_value_new_object();
+    sentry_value_set_by_key(debug_meta, "images", images);
+    sentry_value_set_by_key(event, "debug_meta", debug_meta);
+    return event;
+}
+
+static void
+add_synthetic_inputs(void)
+{
+    sentry_value_t event = make_large_event();
+    char *json = sentry_value_to_json(event);
+    sentry_value_decref(event);
+    if (json) {
+        add_input(&g_json_inputs, json, strlen(json));
+    }
+
+    static const char *const STATUSES[] = { "ok", "exited", "crashed" };
+    for (int i = 0; i < SYNTHETIC_SESSION_COUNT; i++) {
+        char buf[512];
+        int len = snprintf(buf, sizeof(buf),
+            "{\"init\":%s,\"sid\":\"fa919fb1-d7e1-4ed8-414d-4b10048b%04x\","
+            "\"status\":\"%s\",\"did\":\"user-%d\",\"errors\":%d,"
+            "\"started\":\"2021-03-24T14:07:06.852Z\",\"duration\":%d.25,"
+            "\"attrs\":{\"release\":\"benchmark@1.0.%d\","
+            "\"environment\":\"production\"}}",
+            i % 2 ? "true" : "false", i, STATUSES[i % 3], i, i % 5, i, i % 10);
+        char *session = sentry__string_clonen(buf, (size_t)len);
+        if (session) {
+            add_input(&g_session_inputs, session, (size_t)len);
+        }
+    }
+}
+
+/**
+ * Writes an envelope with a large event, a session and an attachment to disk,
+ * which is then read back by the `envelope_from_path` workload.
+ */
+static void
+write_envelope(void)
+{
+    sentry_path_t *dir = sentry__path_from_str(".sentry-benchmarks");
+    sentry__path_create_dir_all(dir);
+    g_envelope_path = sentry__path_join_str(dir, "parse.envelope");
+    sentry__path_free(dir);
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry__envelope_add_event(envelope, make_large_event());
+    const input_t *session = &g_session_inputs.items[0];
+    sentry__envelope_add_from_buffer(
+        envelope, session->buf, session->len, "session");
+    char *attachment = sentry_malloc(256 * 1024);
+    if (attachment) {
+        memset(attachment, 'x', 256 * 1024);
+        sentry__envelope_add_from_buffer(
+            envelope, attachment, 256 * 1024, "attachment");
+        sentry_free(attachment);
+    }
+    if (sentry_envelope_write_to_path(envelope, g_envelope_path) != 0) {
+        fprintf(stderr, "failed to write the envelope\n");
+    }
+    sentry_envelope_free(envelope);
+
+    size_t len = 0;
+    sentry_free(sentry__path_read_to_buffer(g_envelope_path, &len));
+    g_envelope_len = len;
+}
+
+static size_t
+run_value_from_json(void)
+{
+    for (size_t i = 0; i < g_json_inputs.count; i++) {
+        const input_t *input = &g_json_inputs.items[i];
+        sentry_value_decref(sentry__value_from_json(input->buf, input->len));
+    }
+    return g_json_inputs.bytes;
+}
+
+static size_t
+run_session_from_json(void)
+{
+    for (size_t i = 0; i < g_session_inputs.count; i++) {
+        const input_t *input = &g_session_inputs.items[i];
+        sentry__session_free(
+            sentry__session_from_json(input->buf, input->len));
+    }
+    return g_session_inputs.bytes;
+}
+
+static size_t
+run_envelope_from_path(void)
+{
+    sentry_envelope_t *envelope = sentry__envelope_from_path(g_envelope_path);
+    // the envelope is read as is, and only parsed once the headers and the
+    // event are accessed, like when prioritizing retries
+    sentry__envelope_get_event_id(envelope);
+    sentry_envelope_get_event(envelope);
+    sentry_envelope_free(envelope);
+    return g_envelope_len;
+}
+
+static const workload_t WORKLOADS[] = {
+    { "value_from_json", run_value_from_json },
+    { "session_from_json", run_session_from_json },
+    { "envelope_from_path", run_envelope_from_path },
+};
+
+static uint64_t
+time_passes(const workload_t *workload, size_t passes, size_t *bytes)
+{
+    uint64_t started = sentry__monotonic_time_ns();
+    for (size_t i = 0; i < passes; i++) {
+        *bytes = workload->run();
+    }
+    return sentry__monotonic_time_ns() - started;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double lhs = *(const double *)a;
+    double rhs = *(const double *)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static void
+run_workload(const workload_t *workload)
+{
+    // double the passes until a sample takes long enough to be measured
+    // reliably, which also warms up the caches
+    size_t bytes = 0;
+    size_t passes = 1;
+    while (time_passes(workload, passes, &bytes) < MIN_SAMPLE_NS
+        && passes < ((size_t)1 << 30)) {
+        passes *= 2;
+    }
+
+    double mb_per_sec[SAMPLE_COUNT];
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        uint64_t ns = time_passes(workload, passes, &bytes);
+        mb_per_sec[i] = (double)bytes * passes / 1e6 / (ns / 1e9);
+    }
+    qsort(mb_per_sec, SAMPLE_COUNT, sizeof(double), compare_double);
+
+    printf("{\"name\":\"%s\",\"bytes\":%llu,\"passes\":%llu,\"samples\":%d,"
+           "\"median_mb_per_sec\":%.2f,\"max_mb_per_sec\":%.2f}\n",
+        workload->name, (unsigned long long)bytes, (unsigned long long)passes,
+        SAMPLE_COUNT, mb_per_sec[SAMPLE_COUNT / 2],
+        mb_per_sec[SAMPLE_COUNT - 1]);
+    fflush(stdout);
+}
+
+static void
+free_inputs(inputs_t *inputs)
+{
+    for (size_t i = 0; i < inputs->count; i++) {
+        sentry_free(inputs->items[i].buf);
+    }
+    inputs->count = 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    add_corpora();
+    for (int i = 1; i < argc; i++) {
+        sentry_path_t *path = sentry__path_from_str(argv[i]);
+        if (!path
+            || (!sentry__path_is_dir(path) && !sentry__path_is_file(path))) {
+            fprintf(stderr, "\"%s\" does not exist\n", argv[i]);
+            sentry__path_free(path);
+            return 1;
+        }
+        add_path(path);
+        sentry__path_free(path);
+    }
+    add_synthetic_inputs();
+    write_envelope();
+
+    for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); i++) {
+        run_workload(&WORKLOADS[i]);
+    }
+
+    sentry__path_remove(g_envelope_path);
+    sentry__path_free(g_envelope_path);
+    free_inputs(&g_session_inputs);
+    free_inputs(&g_json_inputs);
+    return 0;
+}
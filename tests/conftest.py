@@ -36,6 +36,16 @@ def pytest_addoption(parser):
         action="store_true",
         help="Enables tests for the crashpad WER module on Windows",
     )
+    parser.addoption(
+        "--with_benchmarks",
+        action="store_true",
+        help="Enables comparing the benchmarks against their baseline",
+    )
+    parser.addoption(
+        "--benchmark_max_regression",
+        default="20",
+        help="How many percent slower than the baseline benchmarks may be",
+    )
 
 
 def pytest_runtest_setup(item):
@@ -43,3 +53,7 @@ def pytest_runtest_setup(item):
         "--with_crashpad_wer"
     ):
         pytest.skip("need --with_crashpad_wer to run this test")
+    if "with_benchmarks" in item.keywords and not item.config.getoption(
+        "--with_benchmarks"
+    ):
+        pytest.skip("need --with_benchmarks to run this test")
@@ -56,6 +56,31 @@ def test_capture_http(cmake, httpserver):
     assert_event(envelope)
 
 
+def test_concurrent_requests_http(cmake, httpserver):
+    tmp_path = cmake(["sentry_example"], {"SENTRY_BACKEND": "none"})
+
+    httpserver.expect_request(
+        "/api/123456/envelope/",
+        headers={"x-sentry-auth": auth_header},
+    ).respond_with_data("OK")
+    env = dict(os.environ, SENTRY_DSN=make_dsn(httpserver))
+
+    run(
+        tmp_path,
+        "sentry_example",
+        ["log", "concurrent-requests", "capture-multiple"],
+        check=True,
+        env=env,
+    )
+
+    assert len(httpserver.log) == 10
+    messages = set()
+    for entry in httpserver.log:
+        envelope = Envelope.deserialize(entry[0].get_data())
+        messages.add(envelope.get_event()["message"]["formatted"])
+    assert messages == set("Event #{}".format(i) for i in range(10))
+
+
 def test_session_http(cmake, httpserver):
     tmp_path = cmake(["sentry_example"], {"SENTRY_BACKEND": "none"})
 
@@ -1,4 +1,6 @@
 import os
+import platform
+import sys
 import pytest
 from . import run
 from .conditions import has_http
@@ -17,3 +19,33 @@ def test_unit_transport(cmake, unittest):
     cwd = cmake(["sentry_test_unit"], {"SENTRY_BACKEND": "none"})
     env = dict(os.environ)
     run(cwd, "sentry_test_unit", ["--no-summary", unittest], check=True, env=env)
+
+
+# the benchmarks are compared against the baseline of the current platform,
+# invoke pytest with the --with_benchmarks option to run them
+@pytest.mark.with_benchmarks
+def test_benchmarks(cmake, request):
+    baseline = os.path.join(
+        os.path.dirname(os.path.realpath(__file__)),
+        "benchmark",
+        "baselines",
+        "{}-{}.json".format(sys.platform, platform.machine().lower()),
+    )
+    if not os.path.exists(baseline):
+        pytest.skip("no benchmark baseline for this platform")
+    cwd = cmake(
+        ["sentry_benchmarks"],
+        {
+            "SENTRY_BUILD_BENCHMARKS": "ON",
+            "CMAKE_BUILD_TYPE": "Release",
+            "SENTRY_BACKEND": "none",
+            "SENTRY_TRANSPORT": "none",
+        },
+    )
+    max_regression = request.config.getoption("--benchmark_max_regression")
+    run(
+        cwd,
+        "sentry_benchmarks",
+        ["--baseline", baseline, "--max-regression", max_regression],
+        check=True,
+    )
@@ -13,7 +13,11 @@
 #include "../vendor/acutest.h"
 
 #define CONCAT(A, B) A##B
-#define SENTRY_TEST(Name) void CONCAT(test_sentry_, Name)(void)
+#ifdef __cplusplus
+#    define SENTRY_TEST(Name) extern "C" void CONCAT(test_sentry_, Name)(void)
+#else
+#    define SENTRY_TEST(Name) void CONCAT(test_sentry_, Name)(void)
+#endif
 #define SKIP_TEST() (void)0
 
 #define TEST_CHECK_STRING_EQUAL(Val, ReferenceVal)                             \
@@ -91,3 +91,128 @@ SENTRY_TEST(lazy_attachments)
 
     TEST_CHECK_INT_EQUAL(testdata.called, 2);
 }
+
+static size_t
+count_attachments(const char *serialized)
+{
+    size_t count = 0;
+    const char *pos = serialized;
+    while ((pos = strstr(pos, "{\"type\":\"attachment\"")) != NULL) {
+        count++;
+        pos++;
+    }
+    return count;
+}
+
+SENTRY_TEST(deduplicated_attachments)
+{
+    sentry_attachments_testdata_t testdata;
+    testdata.called = 0;
+    sentry__stringbuilder_init(&testdata.serialized_envelope);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            send_envelope_test_attachments, &testdata));
+    sentry_options_add_attachment_with_flags(options,
+        PREFIX ".dedup-attachment-a", SENTRY_ATTACHMENT_DEDUPLICATE);
+    sentry_options_add_attachment_with_flags(options,
+        PREFIX ".dedup-attachment-b", SENTRY_ATTACHMENT_DEDUPLICATE);
+    sentry_path_t *a = sentry__path_from_str(PREFIX ".dedup-attachment-a");
+    sentry_path_t *b = sentry__path_from_str(PREFIX ".dedup-attachment-b");
+    sentry__path_write_buffer(a, "config dump", 11);
+    sentry__path_write_buffer(b, "config dump", 11);
+
+    sentry_init(options);
+
+    // the second attachment has the same contents as the first one
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "root", "Hello World!"));
+    char *serialized
+        = sentry_stringbuilder_take_string(&testdata.serialized_envelope);
+    TEST_CHECK_INT_EQUAL(count_attachments(serialized), 1);
+    TEST_CHECK(strstr(serialized, "\"length\":11,") != NULL);
+    sentry_free(serialized);
+
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "root", "Hello World!"));
+    serialized
+        = sentry_stringbuilder_take_string(&testdata.serialized_envelope);
+    TEST_CHECK_INT_EQUAL(count_attachments(serialized), 0);
+    sentry_free(serialized);
+
+    // changed contents are sent again
+    sentry__path_write_buffer(b, "log tail", 8);
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "root", "Hello World!"));
+    serialized
+        = sentry_stringbuilder_take_string(&testdata.serialized_envelope);
+    TEST_CHECK_INT_EQUAL(count_attachments(serialized), 1);
+    TEST_CHECK(strstr(serialized,
+                   "{\"type\":\"attachment\",\"length\":8,"
+                   "\"filename\":\".dedup-attachment-b\"}\n"
+                   "log tail")
+        != NULL);
+    sentry_free(serialized);
+
+    sentry_close();
+
+    sentry__path_remove(a);
+    sentry__path_remove(b);
+    sentry__path_free(a);
+    sentry__path_free(b);
+
+    TEST_CHECK_INT_EQUAL(testdata.called, 3);
+}
+
+SENTRY_TEST(compressed_attachments)
+{
+    sentry_attachments_testdata_t testdata;
+    testdata.called = 0;
+    sentry__stringbuilder_init(&testdata.serialized_envelope);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            send_envelope_test_attachments, &testdata));
+    sentry_options_add_attachment_with_flags(
+        options, PREFIX ".compressed-attachment", SENTRY_ATTACHMENT_COMPRESS);
+    sentry_path_t *path
+        = sentry__path_from_str(PREFIX ".compressed-attachment");
+    char contents[4096];
+    memset(contents, 'x', sizeof(contents));
+    sentry__path_write_buffer(path, contents, sizeof(contents));
+
+    sentry_init(options);
+
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "root", "Hello World!"));
+    char *serialized
+        = sentry_stringbuilder_take_string(&testdata.serialized_envelope);
+    TEST_CHECK_INT_EQUAL(count_attachments(serialized), 1);
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+    TEST_CHECK(strstr(serialized,
+                   "\"filename\":\".compressed-attachment.gz\","
+                   "\"content_type\":\"application/gzip\"")
+        != NULL);
+    TEST_CHECK(strstr(serialized, "\"length\":4096,") == NULL);
+#else
+    // without zlib, the attachment is sent as is
+    TEST_CHECK(strstr(serialized,
+                   "{\"type\":\"attachment\",\"length\":4096,"
+                   "\"filename\":\".compressed-attachment\"}\n")
+        != NULL);
+#endif
+    sentry_free(serialized);
+
+    sentry_close();
+
+    sentry__path_remove(path);
+    sentry__path_free(path);
+
+    TEST_CHECK_INT_EQUAL(testdata.called, 1);
+}
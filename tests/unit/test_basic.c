@@ -1,6 +1,27 @@
+#include "sentry_alloc.h"
+#include "sentry_breadcrumb.h"
 #include "sentry_core.h"
 #include "sentry_database.h"
+#include "sentry_envelope.h"
+#include "sentry_options.h"
+#include "sentry_path.h"
+#include "sentry_ratelimiter.h"
+#include "sentry_ringbuffer.h"
+#include "sentry_scope.h"
+#include "sentry_session.h"
+#include "sentry_string.h"
 #include "sentry_testsupport.h"
+#include "sentry_transport.h"
+#include "sentry_utils.h"
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <sys/wait.h>
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
 
 static void
 send_envelope_test_basic(const sentry_envelope_t *envelope, void *data)
@@ -65,8 +86,8 @@ SENTRY_TEST(basic_function_transport)
 static void
 counting_transport_func(const sentry_envelope_t *UNUSED(envelope), void *data)
 {
-    uint64_t *called = data;
-    *called += 1;
+    // this runs on the transport worker, while the test reads the count
+    sentry__atomic_fetch_and_add((volatile long *)data, 1);
 }
 
 static sentry_value_t
@@ -81,13 +102,13 @@ before_send(sentry_value_t event, void *UNUSED(hint), void *data)
 SENTRY_TEST(sampling_before_send)
 {
     uint64_t called_beforesend = 0;
-    uint64_t called_transport = 0;
+    volatile long called_transport = 0;
 
     sentry_options_t *options = sentry_options_new();
     sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
     sentry_options_set_transport(options,
         sentry_new_function_transport(
-            counting_transport_func, &called_transport));
+            counting_transport_func, (void *)&called_transport));
     sentry_options_set_before_send(options, before_send, &called_beforesend);
     sentry_options_set_sample_rate(options, 0.75);
     sentry_init(options);
@@ -99,13 +120,277 @@ SENTRY_TEST(sampling_before_send)
 
     sentry_close();
 
-    // The behavior here has changed with version 0.4.19:
-    // the documentation (https://develop.sentry.dev/sdk/sessions/#filter-order)
-    // requires that the sampling-rate filter for all SDKs is executed last.
-    // This means the `before_send` callback will be invoked every time and only
-    // the actual transport will be randomly sampled.
-    TEST_CHECK(called_transport > 50 && called_transport < 100);
-    TEST_CHECK_INT_EQUAL(called_beforesend, 100);
+    // the sampling happens before any of the event processing, so the
+    // `before_send` callback is only invoked for the events that are sent
+    long sent = sentry__atomic_fetch(&called_transport);
+    TEST_CHECK(sent > 50 && sent < 100);
+    TEST_CHECK_INT_EQUAL(called_beforesend, sent);
+}
+
+SENTRY_TEST(rate_limited_before_prepare)
+{
+    uint64_t called_beforesend = 0;
+    volatile long called_transport = 0;
+
+    sentry_rate_limiter_t *rl = sentry__rate_limiter_new();
+    sentry__rate_limiter_update_from_header(rl, "60:error:organization");
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_transport_t *transport = sentry_new_function_transport(
+        counting_transport_func, (void *)&called_transport);
+    sentry__transport_set_rate_limiter(transport, rl);
+    sentry_options_set_transport(options, transport);
+    sentry_options_set_before_send(options, before_send, &called_beforesend);
+    sentry_init(options);
+
+    sentry_uuid_t event_id = sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "foo"));
+    TEST_CHECK(sentry_uuid_is_nil(&event_id));
+
+    sentry_close();
+    sentry__rate_limiter_free(rl);
+
+    // the event is rejected before it gets to `before_send`
+    TEST_CHECK_INT_EQUAL(called_beforesend, 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 0);
+}
+
+SENTRY_TEST(sampled_before_prepare)
+{
+    uint64_t called_beforesend = 0;
+    volatile long called_transport = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(options, before_send, &called_beforesend);
+    sentry_options_set_release(options, "prod");
+    sentry_options_set_sample_rate(options, 0.0);
+    sentry_init(options);
+
+    sentry_uuid_t event_id = sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "foo"));
+    TEST_CHECK(sentry_uuid_is_nil(&event_id));
+    // the error still counts towards the session
+    SENTRY_WITH_OPTIONS (opts) {
+        TEST_CHECK(opts->session != NULL);
+        if (opts->session) {
+            TEST_CHECK_INT_EQUAL(opts->session->errors, 1);
+        }
+    }
+
+    sentry_close();
+
+    // the event is sampled out before it gets to `before_send`, and only the
+    // session is sent
+    TEST_CHECK_INT_EQUAL(called_beforesend, 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 1);
+}
+
+SENTRY_TEST(throttled_before_prepare)
+{
+    uint64_t called_beforesend = 0;
+    volatile long called_transport = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(options, before_send, &called_beforesend);
+    sentry_options_set_max_events_per_second(options, 5);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_max_events_per_second(options), 5);
+    sentry_init(options);
+
+    for (int i = 0; i < 20; i++) {
+        sentry_capture_event(
+            sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+    }
+
+    sentry_close();
+
+    // a burst of 5 events gets through, and the bucket slowly refills while
+    // the others are captured
+    long sent = sentry__atomic_fetch(&called_transport);
+    TEST_CHECK(sent >= 5 && sent <= 6);
+    TEST_CHECK_INT_EQUAL(called_beforesend, sent);
+}
+
+SENTRY_TEST(rate_sampler)
+{
+    sentry_rate_sampler_t sampler;
+    sentry__rate_sampler_init(&sampler, 10);
+    uint64_t now = sampler.window_start;
+
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(sentry__rate_sampler_sample_rate(&sampler, now) == 1.0);
+    }
+    double rate = sentry__rate_sampler_sample_rate(&sampler, now);
+    TEST_CHECK(rate > 0.9 && rate < 0.91);
+    for (int i = 0; i < 29; i++) {
+        sentry__rate_sampler_sample_rate(&sampler, now);
+    }
+
+    // half of the 40 events of the previous window are still counted
+    rate = sentry__rate_sampler_sample_rate(&sampler, now + 1500);
+    TEST_CHECK(rate > 0.47 && rate < 0.48);
+
+    // and none of them after a second without any events
+    rate = sentry__rate_sampler_sample_rate(&sampler, now + 3000);
+    TEST_CHECK(rate == 1.0);
+
+    sentry__rate_sampler_cleanup(&sampler);
+
+    sentry__rate_sampler_init(&sampler, 0);
+    for (int i = 0; i < 100; i++) {
+        TEST_CHECK(sentry__rate_sampler_sample_rate(&sampler, now) == 1.0);
+    }
+    sentry__rate_sampler_cleanup(&sampler);
+}
+
+typedef struct {
+    uint64_t fatal;
+    uint64_t error;
+    uint64_t sampled;
+} level_counts_t;
+
+static sentry_value_t
+counting_levels_before_send(
+    sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    level_counts_t *counts = data;
+    const char *level
+        = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
+    if (strcmp(level, "fatal") == 0) {
+        counts->fatal++;
+    } else {
+        counts->error++;
+    }
+    sentry_value_t sample_rate = sentry_value_get_by_key(event, "sample_rate");
+    if (!sentry_value_is_null(sample_rate)) {
+        TEST_CHECK(sentry_value_as_double(sample_rate) < 1.0);
+        counts->sampled++;
+    }
+    sentry_value_decref(event);
+    return sentry_value_new_null();
+}
+
+SENTRY_TEST(max_events_per_second_for_level)
+{
+    level_counts_t counts = { 0 };
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_before_send(
+        options, counting_levels_before_send, &counts);
+    sentry_options_set_max_events_per_second_for_level(
+        options, SENTRY_LEVEL_ERROR, 2);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_max_events_per_second_for_level(
+                             options, SENTRY_LEVEL_ERROR),
+        2);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_max_events_per_second_for_level(
+                             options, SENTRY_LEVEL_FATAL),
+        0);
+    sentry_init(options);
+
+    for (int i = 0; i < 100; i++) {
+        sentry_capture_event(
+            sentry_value_new_message_event(SENTRY_LEVEL_FATAL, NULL, "foo"));
+        sentry_capture_event(
+            sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "foo"));
+    }
+
+    sentry_close();
+
+    // all the fatal events are kept, and the errors beyond the first ones are
+    // sampled, with their sample rate attached
+    TEST_CHECK_INT_EQUAL(counts.fatal, 100);
+    TEST_CHECK(counts.error >= 2 && counts.error < 50);
+    TEST_CHECK(counts.sampled == counts.error - 2);
+}
+
+SENTRY_TEST(transport_stats)
+{
+    volatile long called = 0;
+    sentry_rate_limiter_t *rl = sentry__rate_limiter_new();
+    sentry__rate_limiter_update_from_header(rl, "60:error:organization");
+    sentry_transport_stats_t *stats = sentry__transport_stats_new();
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_transport_t *transport = sentry_new_function_transport(
+        counting_transport_func, (void *)&called);
+    sentry__transport_set_rate_limiter(transport, rl);
+    sentry__transport_set_stats(transport, stats);
+    sentry_options_set_transport(options, transport);
+    sentry_init(options);
+
+    sentry__transport_stats_record_request(stats, 20, 100, 300, 200, 0);
+    sentry__transport_stats_record_request(stats, 700, 50, 50, 429, 0);
+    sentry__transport_stats_record_request(stats, 9000, 0, 80, 0, 28);
+    sentry__transport_stats_record_queue_depth(stats, 5);
+    sentry__transport_stats_record_queue_depth(stats, 2);
+
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+
+    sentry_value_t value = sentry_get_transport_stats();
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_key(value, "requests")), 3);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(sentry_value_get_by_key(
+                             value, "latency_ms_sum")),
+        9720);
+    sentry_value_t buckets
+        = sentry_value_get_by_key(value, "latency_ms_buckets");
+    sentry_value_t bounds = sentry_value_get_by_key(value, "latency_ms_bounds");
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(buckets), 8);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(bounds), 7);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_index(buckets, 0)), 1);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_index(buckets, 4)), 1);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_index(buckets, 7)), 1);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_key(value, "bytes_sent")),
+        150);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(sentry_value_get_by_key(
+                             value, "bytes_uncompressed")),
+        430);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_key(value, "queue_depth")),
+        2);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(sentry_value_get_by_key(
+                             value, "queue_high_water")),
+        5);
+    sentry_value_t status_codes
+        = sentry_value_get_by_key(value, "status_codes");
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_key(status_codes, "200")), 1);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int64(sentry_value_get_by_key(status_codes, "429")), 1);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(sentry_value_get_by_key(
+                             sentry_value_get_by_key(value, "errors"), "28")),
+        1);
+    sentry_value_t rate_limited
+        = sentry_value_get_by_key(value, "rate_limited");
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(sentry_value_get_by_key(
+                             rate_limited, "transaction")),
+        0);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int64(
+                             sentry_value_get_by_key(rate_limited, "error")),
+        1);
+    sentry_value_decref(value);
+
+    sentry_close();
+    sentry__transport_stats_free(stats);
+    sentry__rate_limiter_free(rl);
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called), 0);
+    TEST_CHECK(sentry_value_is_null(sentry_get_transport_stats()));
 }
 
 static sentry_value_t
@@ -121,13 +406,13 @@ discarding_before_send(sentry_value_t event, void *UNUSED(hint), void *data)
 SENTRY_TEST(discarding_before_send)
 {
     uint64_t called_beforesend = 0;
-    uint64_t called_transport = 0;
+    volatile long called_transport = 0;
 
     sentry_options_t *options = sentry_options_new();
     sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
     sentry_options_set_transport(options,
         sentry_new_function_transport(
-            counting_transport_func, &called_transport));
+            counting_transport_func, (void *)&called_transport));
     sentry_options_set_before_send(
         options, discarding_before_send, &called_beforesend);
     sentry_init(options);
@@ -137,73 +422,1351 @@ SENTRY_TEST(discarding_before_send)
 
     sentry_close();
 
-    TEST_CHECK_INT_EQUAL(called_transport, 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 0);
     TEST_CHECK_INT_EQUAL(called_beforesend, 1);
 }
 
-SENTRY_TEST(crash_marker)
+static int64_t
+get_stat(sentry_value_t stats, const char *key)
+{
+    return sentry_value_as_int64(sentry_value_get_by_key(stats, key));
+}
+
+SENTRY_TEST(sdk_stats)
 {
+    uint64_t called_beforesend = 0;
+    volatile long called_transport = 0;
+
     sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(
+        options, discarding_before_send, &called_beforesend);
+    sentry_options_set_max_events_per_second(options, 1);
+    sentry_options_set_max_breadcrumbs(options, 2);
+    sentry_options_set_max_spans(options, 1);
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_init(options);
 
-    // clear returns true, regardless if the file exists
-    TEST_CHECK(sentry__clear_crash_marker(options));
+    // the counters are global, so only their increments are checked
+    sentry_value_t before = sentry_get_stats();
 
-    // write should normally be true, even when called multiple times
-    TEST_CHECK(!sentry__has_crash_marker(options));
-    TEST_CHECK(sentry__write_crash_marker(options));
-    TEST_CHECK(sentry__has_crash_marker(options));
-    TEST_CHECK(sentry__write_crash_marker(options));
-    TEST_CHECK(sentry__has_crash_marker(options));
+    // the first event is discarded by the hook, the second is throttled
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
 
-    TEST_CHECK(sentry__clear_crash_marker(options));
-    TEST_CHECK(!sentry__has_crash_marker(options));
-    TEST_CHECK(sentry__clear_crash_marker(options));
+    for (int i = 0; i < 3; i++) {
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(NULL, "crumb"));
+    }
 
-    sentry_options_free(options);
+    sentry_transaction_context_t *tx_ctx
+        = sentry_transaction_context_new("sampled", "test");
+    sentry_transaction_t *tx
+        = sentry_transaction_start(tx_ctx, sentry_value_new_null());
+    sentry_span_finish(sentry_transaction_start_child(tx, "op", "first"));
+    // the transaction already has `max_spans` spans
+    TEST_CHECK(!sentry_transaction_start_child(tx, "op", "second"));
+    sentry_transaction_finish(tx);
+
+    tx_ctx = sentry_transaction_context_new("unsampled", "test");
+    sentry_transaction_context_set_sampled(tx_ctx, 0);
+    sentry_transaction_finish(
+        sentry_transaction_start(tx_ctx, sentry_value_new_null()));
+
+    sentry_value_t after = sentry_get_stats();
+    sentry_close();
+
+#define CHECK_STAT_INCREMENT(Key, Increment)                                   \
+    TEST_CHECK_INT_EQUAL(                                                      \
+        get_stat(after, Key) - get_stat(before, Key), Increment)
+    CHECK_STAT_INCREMENT("events_captured", 4);
+    CHECK_STAT_INCREMENT("events_sampled_out", 1);
+    CHECK_STAT_INCREMENT("events_discarded", 1);
+    CHECK_STAT_INCREMENT("events_rate_limited", 1);
+    CHECK_STAT_INCREMENT("events_sent", 1);
+    CHECK_STAT_INCREMENT("breadcrumbs_added", 3);
+    CHECK_STAT_INCREMENT("breadcrumbs_evicted", 1);
+    CHECK_STAT_INCREMENT("spans_dropped", 1);
+    CHECK_STAT_INCREMENT("envelopes_dumped", 0);
+#undef CHECK_STAT_INCREMENT
+    TEST_CHECK_INT_EQUAL(get_stat(after, "transport_queue_depth"), 0);
+    TEST_CHECK_INT_EQUAL(get_stat(after, "capture_queue_depth"), 0);
+    TEST_CHECK(sentry_value_get_type(sentry_value_get_by_key(
+                   after, "modules_bytes"))
+        != SENTRY_VALUE_TYPE_NULL);
+
+    TEST_CHECK_INT_EQUAL(called_beforesend, 1);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 1);
+    sentry_value_decref(before);
+    sentry_value_decref(after);
 }
 
-SENTRY_TEST(crashed_last_run)
+#ifdef SENTRY_WITH_MEMORY_TAGS
+static int64_t
+get_tag_bytes(const char *tag, const char *key)
 {
-    // fails before init() is called
-    TEST_CHECK_INT_EQUAL(sentry_clear_crashed_last_run(), 1);
+    // the counters are read before the returned object is allocated
+    sentry_value_t memory = sentry__memory_tags_to_value();
+    int64_t bytes = get_stat(sentry_value_get_by_key(memory, tag), key);
+    sentry_value_decref(memory);
+    return bytes;
+}
+#endif
 
-    // clear any leftover from previous test runs
-    sentry_options_t *options = sentry_options_new();
-    TEST_CHECK(sentry__clear_crash_marker(options));
-    sentry_options_free(options);
+SENTRY_TEST(memory_tags)
+{
+#ifdef SENTRY_WITH_MEMORY_TAGS
+    int64_t transport_bytes = get_tag_bytes("transport", "current_bytes");
+    int64_t total_bytes = get_tag_bytes("total", "current_bytes");
 
-    // -1 before sentry_init()
-    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), -1);
+    SENTRY_MEMORY_TAG_ENTER(SENTRY_MEMORY_TAG_TRANSPORT);
+    char *buf = sentry_malloc(100000);
+    SENTRY_MEMORY_TAG_LEAVE();
+    TEST_ASSERT(!!buf);
+    TEST_CHECK_INT_EQUAL(get_tag_bytes("transport", "current_bytes"),
+        transport_bytes + 100000);
+    TEST_CHECK(get_tag_bytes("transport", "peak_bytes")
+        >= transport_bytes + 100000);
+    TEST_CHECK(
+        get_tag_bytes("total", "current_bytes") >= total_bytes + 100000);
 
-    options = sentry_options_new();
-    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
-    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
-    sentry_close();
+    // allocations after leaving the tag are no longer attributed to it
+    char *other = sentry_malloc(1000);
+    TEST_CHECK_INT_EQUAL(get_tag_bytes("transport", "current_bytes"),
+        transport_bytes + 100000);
+    sentry_free(other);
 
-    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 0);
+    sentry_free(buf);
+    TEST_CHECK_INT_EQUAL(
+        get_tag_bytes("transport", "current_bytes"), transport_bytes);
+    TEST_CHECK(get_tag_bytes("transport", "peak_bytes")
+        >= transport_bytes + 100000);
 
-    options = sentry_options_new();
+    // values are attributed to their own tag by default
+    int64_t value_bytes = get_tag_bytes("value", "current_bytes");
+    buf = sentry_malloc(100000);
+    TEST_ASSERT(!!buf);
+    memset(buf, 'a', 99999);
+    buf[99999] = '\0';
+    sentry_value_t value = sentry_value_new_string(buf);
+    sentry_free(buf);
+    TEST_CHECK(
+        get_tag_bytes("value", "current_bytes") >= value_bytes + 100000);
+    sentry_value_decref(value);
+    TEST_CHECK_INT_EQUAL(get_tag_bytes("value", "current_bytes"), value_bytes);
+
+    sentry_value_t stats = sentry_get_stats();
+    TEST_CHECK(!sentry_value_is_null(sentry_value_get_by_key(
+        sentry_value_get_by_key(stats, "memory"), "total")));
+    sentry_value_decref(stats);
+#else
+    SKIP_TEST();
+#endif
+}
+
+#ifdef SENTRY_PLATFORM_LINUX
+/**
+ * Returns the number of threads of this process with the given `name`.
+ */
+static size_t
+count_threads_named(const char *name)
+{
+    size_t count = 0;
+    sentry_path_t *task_path = sentry__path_from_str("/proc/self/task");
+    sentry_pathiter_t *iter = sentry__path_iter_directory(task_path);
+    const sentry_path_t *path;
+    while (iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        // the files of procfs have no size, so they are not read as a whole
+        sentry_path_t *comm_path = sentry__path_join_str(path, "comm");
+        FILE *f = comm_path ? fopen(comm_path->path, "r") : NULL;
+        char comm[32];
+        if (f && fgets(comm, sizeof(comm), f)) {
+            comm[strcspn(comm, "\n")] = '\0';
+            count += sentry__string_eq(comm, name);
+        }
+        if (f) {
+            fclose(f);
+        }
+        sentry__path_free(comm_path);
+    }
+    sentry__pathiter_free(iter);
+    sentry__path_free(task_path);
+    return count;
+}
+#endif
+
+#ifdef SENTRY_PLATFORM_LINUX
+typedef struct {
+    sentry_uuid_t run_id;
+    sentry_uuid_t session_id;
+    bool run_exists;
+    uint64_t called_transport;
+    bool uploaded_backlog;
+} fork_result_t;
+
+static void
+get_run_and_session(sentry_uuid_t *run_id, sentry_uuid_t *session_id)
+{
+    *run_id = sentry_uuid_nil();
+    *session_id = sentry_uuid_nil();
+    SENTRY_WITH_OPTIONS (options) {
+        *run_id = options->run->uuid;
+        if (options->session) {
+            *session_id = options->session->session_id;
+        }
+    }
+}
+#endif
+
+SENTRY_TEST(reinit_after_fork)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    volatile long called_transport = 0;
+    sentry_options_t *options = sentry_options_new();
     sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_release(options, "prefork@1.0.0");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_session_persist_interval(options, 1000);
+    TEST_CHECK(!sentry_options_get_reinit_after_fork(options));
+    sentry_options_set_reinit_after_fork(options, true);
+    TEST_CHECK(sentry_options_get_reinit_after_fork(options));
+    sentry_init(options);
 
-    // simulate a crash
-    TEST_CHECK(sentry__write_crash_marker(options));
+    sentry_uuid_t run_id;
+    sentry_uuid_t session_id;
+    get_run_and_session(&run_id, &session_id);
+    TEST_CHECK(!sentry_uuid_is_nil(&session_id));
+    sentry_path_t *run_path = NULL;
+    SENTRY_WITH_OPTIONS (opts) {
+        run_path = sentry__path_clone(opts->run->run_path);
+    }
+    TEST_ASSERT(!!run_path);
 
-    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
+    int fds[2];
+    TEST_ASSERT(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the child reports back through the pipe, and exits without
+        // running the tests of the parent
+        fork_result_t result;
+        get_run_and_session(&result.run_id, &result.session_id);
+        SENTRY_WITH_OPTIONS (opts) {
+            result.run_exists = sentry__path_is_dir(opts->run->run_path);
+        }
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_INFO, NULL, "captured by the child"));
+        result.called_transport
+            = (uint64_t)sentry__atomic_fetch(&called_transport);
+        // the offline backlog is uploaded by a worker of the child
+        sentry_set_offline(1);
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_INFO, NULL, "stored by the child"));
+        long called_offline = sentry__atomic_fetch(&called_transport);
+        sentry_set_offline(0);
+        for (int i = 0; i < 500
+             && sentry__atomic_fetch(&called_transport) == called_offline;
+             i++) {
+            sleep_ms(10);
+        }
+        result.uploaded_backlog
+            = sentry__atomic_fetch(&called_transport) > called_offline;
+        sentry_close();
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+    TEST_ASSERT(pid > 0);
 
-    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 1);
+    fork_result_t result;
+    memset(&result, 0, sizeof(result));
+    TEST_CHECK(read(fds[0], &result, sizeof(result)) == sizeof(result));
+    int status = -1;
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+    TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
 
-    // clear the status and re-init
-    TEST_CHECK_INT_EQUAL(sentry_clear_crashed_last_run(), 0);
+    // the child has a run and a session of its own
+    TEST_CHECK(result.run_exists);
+    TEST_CHECK(memcmp(&result.run_id, &run_id, sizeof(run_id)) != 0);
+    TEST_CHECK(!sentry_uuid_is_nil(&result.session_id));
+    TEST_CHECK(
+        memcmp(&result.session_id, &session_id, sizeof(session_id)) != 0);
+    TEST_CHECK(result.called_transport >= 1);
+    TEST_CHECK(result.uploaded_backlog);
+
+    // while the parent keeps its own, and keeps capturing
+    sentry_uuid_t parent_run_id;
+    sentry_uuid_t parent_session_id;
+    get_run_and_session(&parent_run_id, &parent_session_id);
+    TEST_CHECK(memcmp(&parent_run_id, &run_id, sizeof(run_id)) == 0);
+    TEST_CHECK(
+        memcmp(&parent_session_id, &session_id, sizeof(session_id)) == 0);
+    TEST_CHECK(sentry__path_is_dir(run_path));
+    long called_before = sentry__atomic_fetch(&called_transport);
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, NULL, "captured by the parent"));
+    TEST_CHECK(sentry__atomic_fetch(&called_transport) > called_before);
 
     sentry_close();
+    TEST_CHECK(!sentry__path_is_dir(run_path));
+    sentry__path_free(run_path);
+#else
+    SKIP_TEST();
+#endif
+}
 
-    // no change yet before sentry_init() is called
-    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 1);
+SENTRY_TEST(offline_worker_on_demand)
+{
+#ifdef SENTRY_PLATFORM_LINUX
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-offline-worker");
+    sentry__path_remove_all(database_path);
+    volatile long called_transport = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_database_path(options, ".sentry-native-offline-worker");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_init(options);
 
-    options = sentry_options_new();
+    // there is nothing to upload until the SDK was offline
+    TEST_CHECK_INT_EQUAL(count_threads_named("sentry-offline"), 0);
+    sentry_set_offline(1);
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "stored"));
+    TEST_CHECK_INT_EQUAL(count_threads_named("sentry-offline"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 0);
+
+    sentry_set_offline(0);
+    for (int i = 0;
+         i < 500 && sentry__atomic_fetch(&called_transport) == 0; i++) {
+        sleep_ms(10);
+    }
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 1);
+    TEST_CHECK_INT_EQUAL(count_threads_named("sentry-offline"), 1);
+    sentry_close();
+
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+#else
+    SKIP_TEST();
+#endif
+}
+
+static sentry_value_t
+modifying_before_send(sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    uint64_t *called = data;
+    *called += 1;
+
+    sentry_value_t tags = sentry_value_get_by_key(event, "tags");
+    TEST_CHECK(!sentry_value_is_frozen(tags));
+    TEST_CHECK(sentry_value_set_by_key(
+                   tags, "hook", sentry_value_new_string("modified"))
+        == 0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(tags, "scope")),
+        "tag");
+
+    return event;
+}
+
+SENTRY_TEST(before_send_modifies_scope_values)
+{
+    uint64_t called_beforesend = 0;
+    volatile long called_transport = 0;
+
+    sentry_options_t *options = sentry_options_new();
     sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
-    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(
+        options, modifying_before_send, &called_beforesend);
+    sentry_init(options);
+
+    sentry_set_tag("scope", "tag");
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "bar"));
+
+    SENTRY_WITH_SCOPE (scope) {
+        // the hook only ever modified its own copy
+        TEST_CHECK(sentry_value_is_null(
+            sentry_value_get_by_key(scope->tags, "hook")));
+    }
+    // modifying the scope after it was shared with events still works
+    sentry_set_tag("other", "tag");
+    SENTRY_WITH_SCOPE (scope) {
+        TEST_CHECK_INT_EQUAL(sentry_value_get_length(scope->tags), 2);
+    }
+
     sentry_close();
 
-    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 2);
+    TEST_CHECK_INT_EQUAL(called_beforesend, 2);
+}
+
+static sentry_value_t
+nested_before_send(sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    uint64_t *called = data;
+    *called += 1;
+
+    sentry_value_t os = sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "contexts"), "os");
+    TEST_CHECK(!sentry_value_is_frozen(os));
+    TEST_CHECK(
+        sentry_value_set_by_key(os, "name", sentry_value_new_string("hooked"))
+        == 0);
+
+    return event;
+}
+
+static void
+check_nested_transport(const sentry_envelope_t *envelope, void *data)
+{
+    uint64_t *called = data;
+    *called += 1;
+
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t os = sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "contexts"), "os");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(os, "name")), "hooked");
+}
+
+SENTRY_TEST(before_send_modifies_nested_scope_values)
+{
+    uint64_t called_beforesend = 0;
+    uint64_t called_transport = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            check_nested_transport, &called_transport));
+    sentry_options_set_before_send(
+        options, nested_before_send, &called_beforesend);
+    sentry_init(options);
+
+    sentry_value_t os = sentry_value_new_object();
+    sentry_value_set_by_key(os, "name", sentry_value_new_string("scope"));
+    sentry_set_context("os", os);
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+
+    SENTRY_WITH_SCOPE (scope) {
+        // the hook only ever modified its own copy
+        os = sentry_value_get_by_key(scope->contexts, "os");
+        TEST_CHECK_STRING_EQUAL(
+            sentry_value_as_string(sentry_value_get_by_key(os, "name")),
+            "scope");
+    }
+
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(called_transport, 1);
+    TEST_CHECK_INT_EQUAL(called_beforesend, 1);
+}
+
+static sentry_value_t
+thread_scope_before_send(sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    sentry_value_t *tags = data;
+    sentry_value_decref(*tags);
+    *tags = sentry_value_get_by_key_owned(event, "tags");
+    return event;
+}
+
+SENTRY_TEST(thread_scope)
+{
+    volatile long called_transport = 0;
+    sentry_value_t tags = sentry_value_new_null();
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(options, thread_scope_before_send, &tags);
+    sentry_init(options);
+
+    sentry_set_tag("shared", "global");
+    sentry_set_tag("global", "global");
+    sentry_set_thread_tag("shared", "thread");
+    sentry_set_thread_tag("thread", "thread");
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+
+    // the thread takes precedence, without modifying the global scope
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(tags), 3);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(tags, "shared")),
+        "thread");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(tags, "thread")),
+        "thread");
+    SENTRY_WITH_SCOPE (scope) {
+        TEST_CHECK_INT_EQUAL(sentry_value_get_length(scope->tags), 2);
+    }
+
+    sentry_remove_thread_tag("thread");
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "bar"));
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(tags), 2);
+
+    sentry_clear_thread_scope();
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "baz"));
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(tags, "shared")),
+        "global");
+
+    sentry_close();
+    sentry_value_decref(tags);
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 3);
+}
+
+typedef struct {
+    sentry_value_t tags;
+    sentry_threadid_t thread;
+    int called;
+} async_before_send_t;
+
+static sentry_value_t
+async_before_send(sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    async_before_send_t *state = data;
+    state->called++;
+    state->thread = sentry__current_thread();
+    sentry_value_decref(state->tags);
+    state->tags = sentry_value_get_by_key_owned(event, "tags");
+    return event;
+}
+
+SENTRY_TEST(async_capture)
+{
+    volatile long called_transport = 0;
+    async_before_send_t state = { sentry_value_new_null(), 0, 0 };
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_before_send(options, async_before_send, &state);
+    sentry_options_set_async_capture(options, true);
+    TEST_CHECK(sentry_options_get_async_capture(options));
+    sentry_init(options);
+
+    sentry_set_tag("global", "before");
+    sentry_set_thread_tag("thread", "thread");
+    sentry_uuid_t event_id = sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "foo"));
+    // the scope was snapshotted when the event was captured
+    sentry_set_tag("global", "after");
+    sentry_clear_thread_scope();
+    TEST_CHECK(!sentry_uuid_is_nil(&event_id));
+
+    TEST_CHECK_INT_EQUAL(sentry_flush(1000), 0);
+    TEST_CHECK_INT_EQUAL(state.called, 1);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 1);
+    TEST_CHECK(!sentry__threadid_equal(state.thread, sentry__current_thread()));
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(state.tags, "global")),
+        "before");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(state.tags, "thread")),
+        "thread");
+
+    // the events that are still queued are sent on close
+    for (int i = 0; i < 10; i++) {
+        sentry_capture_event(
+            sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "bar"));
+    }
+    sentry_close();
+    sentry_value_decref(state.tags);
+
+    TEST_CHECK_INT_EQUAL(state.called, 11);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called_transport), 11);
+}
+
+SENTRY_TEST(memory_usage)
+{
+    volatile long called_transport = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called_transport));
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_init(options);
+
+    sentry_memory_usage_t before;
+    sentry__get_memory_usage(&before);
+    TEST_CHECK(before.scope > 0);
+    TEST_CHECK_INT_EQUAL(before.transaction, 0);
+    // the function transport has no queue
+    TEST_CHECK_INT_EQUAL(before.transport_queue, 0);
+
+    for (int i = 0; i < 10; i++) {
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(NULL, "crumb"));
+    }
+    sentry_transaction_context_t *tx_ctx
+        = sentry_transaction_context_new("tx", "op");
+    sentry_transaction_t *tx
+        = sentry_transaction_start(tx_ctx, sentry_value_new_null());
+    sentry_set_transaction_object(tx);
+
+    sentry_memory_usage_t after;
+    sentry__get_memory_usage(&after);
+    TEST_CHECK(after.scope > before.scope);
+    TEST_CHECK(after.transaction > 0);
+
+    sentry_transaction_finish(tx);
+    sentry_close();
+}
+
+SENTRY_TEST(crash_marker)
+{
+    sentry_options_t *options = sentry_options_new();
+
+    // clear returns true, regardless if the file exists
+    TEST_CHECK(sentry__clear_crash_marker(options));
+
+    // write should normally be true, even when called multiple times
+    TEST_CHECK(!sentry__has_crash_marker(options));
+    TEST_CHECK(sentry__write_crash_marker(options));
+    TEST_CHECK(sentry__has_crash_marker(options));
+    TEST_CHECK(sentry__write_crash_marker(options));
+    TEST_CHECK(sentry__has_crash_marker(options));
+
+    TEST_CHECK(sentry__clear_crash_marker(options));
+    TEST_CHECK(!sentry__has_crash_marker(options));
+    TEST_CHECK(sentry__clear_crash_marker(options));
+
+    sentry_options_free(options);
+}
+
+SENTRY_TEST(crashed_last_run)
+{
+    // fails before init() is called
+    TEST_CHECK_INT_EQUAL(sentry_clear_crashed_last_run(), 1);
+
+    // clear any leftover from previous test runs
+    sentry_options_t *options = sentry_options_new();
+    TEST_CHECK(sentry__clear_crash_marker(options));
+    sentry_options_free(options);
+
+    // -1 before sentry_init()
+    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), -1);
+
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 0);
+
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+
+    // simulate a crash
+    TEST_CHECK(sentry__write_crash_marker(options));
+
+    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
+
+    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 1);
+
+    // clear the status and re-init
+    TEST_CHECK_INT_EQUAL(sentry_clear_crashed_last_run(), 0);
+
+    sentry_close();
+
+    // no change yet before sentry_init() is called
+    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 1);
+
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    TEST_CHECK_INT_EQUAL(sentry_init(options), 0);
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(sentry_get_crashed_last_run(), 0);
+}
+
+#define OLD_RUN_COUNT 40
+
+static void
+count_old_run_envelopes(const sentry_envelope_t *envelope, void *data)
+{
+    if (!sentry_value_is_null(sentry_envelope_get_event(envelope))) {
+        sentry__atomic_fetch_and_add((volatile long *)data, 1);
+    }
+}
+
+static void
+write_old_runs(const sentry_path_t *database_path, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        sentry_run_t *run = sentry__run_new(database_path);
+        TEST_ASSERT(!!run);
+        sentry_envelope_t *envelope = sentry__envelope_new();
+        sentry__envelope_add_event(envelope, sentry_value_new_event());
+        TEST_CHECK(sentry__run_write_envelope(run, envelope));
+        sentry_envelope_free(envelope);
+        // this unlocks the run so that it counts as an old one
+        sentry__run_free(run);
+    }
+}
+
+static size_t
+count_old_runs(const sentry_path_t *database_path)
+{
+    size_t count = 0;
+    sentry_pathiter_t *iter = sentry__path_iter_directory(database_path);
+    const sentry_path_t *path;
+    while (iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        if (sentry__path_is_dir(path) && sentry__path_ends_with(path, ".run")) {
+            count++;
+        }
+    }
+    sentry__pathiter_free(iter);
+    return count;
+}
+
+SENTRY_TEST(old_runs_in_background)
+{
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-old-runs");
+    sentry__path_remove_all(database_path);
+    TEST_CHECK(sentry__path_create_dir_all(database_path) == 0);
+    write_old_runs(database_path, OLD_RUN_COUNT);
+    TEST_CHECK_INT_EQUAL(count_old_runs(database_path), OLD_RUN_COUNT);
+
+    volatile long sent = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_database_path(options, ".sentry-native-old-runs");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            count_old_run_envelopes, (void *)&sent));
+    sentry_init(options);
+
+    uint64_t deadline = sentry__monotonic_time() + 5000;
+    while (sentry__atomic_fetch(&sent) < OLD_RUN_COUNT
+        && sentry__monotonic_time() < deadline) {
+        sleep_ms(1);
+    }
+#ifdef SENTRY_PLATFORM_LINUX
+    // the thread exits on its own once all the runs are processed
+    while (count_threads_named("sentry-old-runs")
+        && sentry__monotonic_time() < deadline) {
+        sleep_ms(1);
+    }
+    TEST_CHECK_INT_EQUAL(count_threads_named("sentry-old-runs"), 0);
+#endif
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&sent), OLD_RUN_COUNT);
+    TEST_CHECK_INT_EQUAL(count_old_runs(database_path), 0);
+
+    // closing right away leaves the runs which were not processed yet on disk
+    write_old_runs(database_path, OLD_RUN_COUNT);
+    sent = 0;
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_database_path(options, ".sentry-native-old-runs");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            count_old_run_envelopes, (void *)&sent));
+    sentry_init(options);
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&sent)
+            + (long)count_old_runs(database_path),
+        OLD_RUN_COUNT);
+
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+static sentry_uuid_t
+write_quota_envelope(
+    sentry_run_t *run, sentry_value_t event, bool is_transaction)
+{
+    // the event ids of the unit tests are fixed, but the files need their own
+    sentry_uuid_t event_id = sentry_uuid_new_v4();
+    sentry_value_set_by_key(
+        event, "event_id", sentry__value_new_uuid(&event_id));
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    if (is_transaction) {
+        sentry__envelope_add_transaction(envelope, event);
+    } else {
+        sentry__envelope_add_event(envelope, event);
+    }
+    TEST_CHECK(sentry__run_write_envelope(run, envelope));
+    sentry_envelope_free(envelope);
+    // the eviction order within a priority goes by the time of writing
+    sleep_ms(2);
+    return event_id;
+}
+
+static bool
+has_quota_envelope(const sentry_run_t *run, sentry_uuid_t event_id)
+{
+    char filename[37 + 9];
+    sentry_uuid_as_string(&event_id, filename);
+    strcpy(&filename[36], ".envelope");
+    sentry_path_t *path = sentry__path_join_str(run->run_path, filename);
+    bool exists = sentry__path_is_file(path);
+    sentry__path_free(path);
+    return exists;
+}
+
+SENTRY_TEST(database_quota_evicts_by_priority)
+{
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-quota");
+    sentry__path_remove_all(database_path);
+    TEST_CHECK(sentry__path_create_dir_all(database_path) == 0);
+    sentry_run_t *run = sentry__run_new(database_path);
+    TEST_ASSERT(!!run);
+    sentry__run_set_quota(run, 0, 3);
+
+    sentry_value_t transaction = sentry_value_new_event();
+    sentry_value_set_by_key(
+        transaction, "type", sentry_value_new_string("transaction"));
+    sentry_value_t crash = sentry_value_new_event();
+    sentry_value_set_by_key(crash, "level", sentry_value_new_string("fatal"));
+
+    sentry_uuid_t transaction_id = write_quota_envelope(run, transaction, true);
+    sentry_uuid_t old_error_id
+        = write_quota_envelope(run, sentry_value_new_event(), false);
+    sentry_uuid_t crash_id = write_quota_envelope(run, crash, false);
+    TEST_CHECK(has_quota_envelope(run, transaction_id));
+
+    // the transaction goes first, even though it is not the only old one
+    sentry_uuid_t error_id
+        = write_quota_envelope(run, sentry_value_new_event(), false);
+    TEST_CHECK(!has_quota_envelope(run, transaction_id));
+    TEST_CHECK(has_quota_envelope(run, old_error_id));
+
+    // then the oldest error, while the crash stays around
+    sentry_uuid_t new_error_id
+        = write_quota_envelope(run, sentry_value_new_event(), false);
+    TEST_CHECK(!has_quota_envelope(run, old_error_id));
+    TEST_CHECK(has_quota_envelope(run, crash_id));
+    TEST_CHECK(has_quota_envelope(run, error_id));
+    TEST_CHECK(has_quota_envelope(run, new_error_id));
+
+    // envelopes that are gone already only leave the index, and do not count
+    // against the quota
+    char filename[37 + 9];
+    sentry_uuid_as_string(&new_error_id, filename);
+    strcpy(&filename[36], ".envelope");
+    sentry_path_t *error_path = sentry__path_join_str(run->run_path, filename);
+    sentry__path_remove(error_path);
+    sentry__path_free(error_path);
+    sentry_uuid_t last_error_id
+        = write_quota_envelope(run, sentry_value_new_event(), false);
+    TEST_CHECK(has_quota_envelope(run, crash_id));
+    TEST_CHECK(has_quota_envelope(run, error_id));
+    TEST_CHECK(has_quota_envelope(run, last_error_id));
+
+    // the crash envelope is counted once the next write merges its entry
+    TEST_CHECK(sentry__run_prepare_crash_envelope(run));
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry__envelope_add_event(envelope, sentry_value_new_event());
+    TEST_CHECK(sentry__run_write_crash_envelope(run, envelope));
+    sentry_envelope_free(envelope);
+    TEST_CHECK(sentry__path_is_file(run->crash_index_path));
+    sleep_ms(2);
+    write_quota_envelope(run, sentry_value_new_event(), false);
+    TEST_CHECK(!sentry__path_is_file(run->crash_index_path));
+    TEST_CHECK(!has_quota_envelope(run, error_id));
+    TEST_CHECK(has_quota_envelope(run, crash_id));
+    TEST_CHECK(sentry__path_is_file(run->crash_path));
+
+    sentry__run_clean(run);
+    sentry__run_free(run);
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+SENTRY_TEST(database_quota_counts_spooled_envelopes)
+{
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-spool");
+    sentry__path_remove_all(database_path);
+    TEST_CHECK(sentry__path_create_dir_all(database_path) == 0);
+    sentry_run_t *run = sentry__run_new(database_path);
+    TEST_ASSERT(!!run);
+    sentry__run_set_quota(run, 0, 2);
+    sentry_run_t *clone = sentry__run_clone(run);
+    TEST_ASSERT(!!clone);
+
+    sentry_path_t *paths[3];
+    for (size_t i = 0; i < 3; i++) {
+        sentry_envelope_t *envelope = sentry__envelope_new();
+        sentry__envelope_add_event(envelope, sentry_value_new_event());
+        paths[i] = sentry__run_write_spooled_envelope(clone, envelope);
+        sentry_envelope_free(envelope);
+        TEST_ASSERT(!!paths[i]);
+        sleep_ms(2);
+    }
+    TEST_CHECK(!sentry__path_is_file(paths[0]));
+    TEST_CHECK(sentry__path_is_file(paths[1]));
+    TEST_CHECK(sentry__path_is_file(paths[2]));
+    for (size_t i = 0; i < 3; i++) {
+        sentry__path_free(paths[i]);
+    }
+
+    sentry__run_free(clone);
+    sentry__run_clean(run);
+    sentry__run_free(run);
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+SENTRY_TEST(durability_policies)
+{
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-durability");
+    sentry__path_remove_all(database_path);
+    TEST_CHECK(sentry__path_create_dir_all(database_path) == 0);
+    sentry_run_t *run = sentry__run_new(database_path);
+    TEST_ASSERT(!!run);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_durability_interval(options, 5);
+    sentry_durability_t policies[] = { SENTRY_DURABILITY_NONE,
+        SENTRY_DURABILITY_CRASH, SENTRY_DURABILITY_BATCHED,
+        SENTRY_DURABILITY_ALWAYS };
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        sentry_options_set_durability(options, policies[i]);
+        TEST_CHECK_INT_EQUAL(
+            sentry_options_get_durability(options), policies[i]);
+        sentry__durability_start(options);
+        // more than one batch worth of files, so the batch overflows
+        for (size_t j = 0; j < 80; j++) {
+            sentry_envelope_t *envelope = sentry__envelope_new();
+            sentry_value_t event = sentry_value_new_event();
+            sentry_uuid_t event_id = sentry_uuid_new_v4();
+            sentry_value_set_by_key(
+                event, "event_id", sentry__value_new_uuid(&event_id));
+            sentry__envelope_add_event(envelope, event);
+            TEST_CHECK(sentry__run_write_envelope(run, envelope));
+            sentry_envelope_free(envelope);
+        }
+        TEST_CHECK(sentry__run_prepare_crash_envelope(run));
+        sentry_envelope_t *crash = sentry__envelope_new();
+        sentry__envelope_add_event(crash, sentry_value_new_event());
+        TEST_CHECK(sentry__run_write_crash_envelope(run, crash));
+        sentry_envelope_free(crash);
+        // the stop flushes whatever is still pending
+        sentry__durability_stop();
+    }
+    sentry_options_free(options);
+
+    sentry__run_clean(run);
+    sentry__run_free(run);
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+// the hooks are called from the threads of the SDK as well
+typedef struct {
+    volatile long allocations;
+    volatile long frees;
+} allocator_counts_t;
+
+static void *
+counting_malloc(size_t size, void *user_data)
+{
+    sentry__atomic_fetch_and_add(
+        &((allocator_counts_t *)user_data)->allocations, 1);
+    return malloc(size);
+}
+
+static void
+counting_free(void *ptr, void *user_data)
+{
+    sentry__atomic_fetch_and_add(&((allocator_counts_t *)user_data)->frees, 1);
+    free(ptr);
+}
+
+SENTRY_TEST(custom_allocator)
+{
+    allocator_counts_t counts = { 0, 0 };
+    sentry_set_allocator(counting_malloc, counting_free, &counts);
+
+    sentry_value_t event = sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "test", "custom allocator");
+    TEST_CHECK(sentry__atomic_fetch(&counts.allocations) > 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&counts.frees), 0);
+    long allocations = sentry__atomic_fetch(&counts.allocations);
+    size_t size;
+    // the vendored mpack allocates through the hooks as well
+    char *msgpack = sentry_value_to_msgpack(event, &size);
+    TEST_CHECK(sentry__atomic_fetch(&counts.allocations) > allocations);
+    sentry_free(msgpack);
+    sentry_value_decref(event);
+#ifndef SENTRY_WITH_VALUE_SLABS
+    // the slabs keep freed values around for reuse
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&counts.frees),
+        sentry__atomic_fetch(&counts.allocations));
+#endif
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    volatile long called = 0;
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            counting_transport_func, (void *)&called));
+    sentry_init(options);
+    allocations = sentry__atomic_fetch(&counts.allocations);
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, "test", "custom allocator"));
+    TEST_CHECK(sentry__atomic_fetch(&counts.allocations) > allocations);
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&called), 1);
+
+    // a missing function restores the system allocator
+    sentry_set_allocator(counting_malloc, NULL, &counts);
+    allocations = sentry__atomic_fetch(&counts.allocations);
+    sentry_free(sentry_malloc(16));
+    TEST_CHECK_INT_EQUAL(
+        sentry__atomic_fetch(&counts.allocations), allocations);
+}
+
+static void
+serialize_envelope(const sentry_envelope_t *envelope, void *data)
+{
+    sentry_stringbuilder_t *sb = data;
+    size_t len;
+    char *buf = sentry_envelope_serialize(envelope, &len);
+    sentry__stringbuilder_append_buf(sb, buf, len);
+    sentry_free(buf);
+}
+
+SENTRY_TEST(scope_sections_serialized_once)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(serialize_envelope, &sb));
+    sentry_init(options);
+
+    sentry_value_t user = sentry_value_new_object();
+    sentry_value_set_by_key(user, "id", sentry_value_new_string("42"));
+    sentry_set_user(user);
+    sentry_set_tag("scope", "one");
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "first"));
+    TEST_CHECK(sentry_value_is_frozen(user));
+    TEST_CHECK(strstr(sb.buf, "\"tags\":{\"scope\":\"one\"}") != NULL);
+    TEST_CHECK(strstr(sb.buf, "\"user\":{\"id\":\"42\"}") != NULL);
+
+    // a change to a section is picked up by the next event
+    sentry__stringbuilder_set_len(&sb, 0);
+    sentry_set_tag("scope", "two");
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "second"));
+    TEST_CHECK(strstr(sb.buf, "\"tags\":{\"scope\":\"two\"}") != NULL);
+    TEST_CHECK(strstr(sb.buf, "\"user\":{\"id\":\"42\"}") != NULL);
+
+    // the event tags are merged into a copy, which is serialized as usual
+    sentry__stringbuilder_set_len(&sb, 0);
+    sentry_value_t event
+        = sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "third");
+    sentry_value_t event_tags = sentry_value_new_object();
+    sentry_value_set_by_key(
+        event_tags, "event", sentry_value_new_string("tag"));
+    sentry_value_set_by_key(event, "tags", event_tags);
+    sentry_capture_event(event);
+    TEST_CHECK(strstr(sb.buf, "\"event\":\"tag\"") != NULL);
+    TEST_CHECK(strstr(sb.buf, "\"scope\":\"two\"") != NULL);
+
+    sentry_close();
+    sentry__stringbuilder_cleanup(&sb);
+}
+
+static void
+check_system_contexts(const sentry_envelope_t *envelope, void *data)
+{
+    uint64_t *called = data;
+    *called += 1;
+
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t contexts = sentry_value_get_by_key(event, "contexts");
+    TEST_CHECK(!sentry_value_is_null(sentry_value_get_by_key(contexts, "os")));
+    TEST_CHECK(
+        !sentry_value_is_null(sentry_value_get_by_key(contexts, "device")));
+    TEST_CHECK(!sentry_value_is_null(sentry_value_get_by_key(contexts, "app")));
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(
+            sentry_value_get_by_key(contexts, "custom"), "key")),
+        "value");
+}
+
+SENTRY_TEST(system_contexts_in_events)
+{
+    uint64_t called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(check_system_contexts, &called));
+    sentry_init(options);
+
+    sentry_value_t custom = sentry_value_new_object();
+    sentry_value_set_by_key(custom, "key", sentry_value_new_string("value"));
+    sentry_set_context("custom", custom);
+    // the event may be captured before or after the background thread added
+    // the system contexts to the scope
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "early"));
+    sentry__scope_add_system_contexts();
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "late"));
+    SENTRY_WITH_SCOPE (scope) {
+        TEST_CHECK(!sentry_value_is_null(
+            sentry_value_get_by_key(scope->contexts, "device")));
+    }
+
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(called, 2);
+}
+
+SENTRY_TEST(event_header_shared)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_release(options, "my-release");
+    sentry_options_set_dist(options, "");
+    sentry_options_set_environment(options, "staging");
+    options->event_header = sentry__scope_new_event_header(options);
+    TEST_CHECK(sentry_value_is_frozen(options->event_header));
+    TEST_CHECK_JSON_VALUE(options->event_header,
+        "{\"platform\":\"native\",\"release\":\"my-release\","
+        "\"environment\":\"staging\"}");
+
+    sentry_value_t first = sentry_value_new_event();
+    sentry_value_t second = sentry_value_new_event();
+    sentry_value_set_by_key(
+        second, "environment", sentry_value_new_string("custom"));
+    SENTRY_WITH_SCOPE (scope) {
+        sentry__scope_apply_to_event(
+            scope, options, first, SENTRY_SCOPE_NONE);
+        sentry__scope_apply_to_event(
+            scope, options, second, SENTRY_SCOPE_NONE);
+    }
+
+    // both events share the very same Values of the header
+    sentry_value_t release = sentry_value_get_by_key(first, "release");
+    TEST_CHECK(
+        release._bits == sentry_value_get_by_key(second, "release")._bits);
+    TEST_CHECK(release._bits
+        == sentry_value_get_by_key(options->event_header, "release")._bits);
+    TEST_CHECK_STRING_EQUAL(sentry_value_as_string(release), "my-release");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(first, "platform")),
+        "native");
+    TEST_CHECK(sentry_value_is_null(sentry_value_get_by_key(first, "dist")));
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(first, "environment")),
+        "staging");
+    // members set by the event itself are kept
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(second, "environment")),
+        "custom");
+
+    sentry_value_decref(first);
+    sentry_value_decref(second);
+    sentry_options_free(options);
+    sentry__scope_cleanup();
+}
+
+static void
+check_buffered_breadcrumbs(const sentry_envelope_t *envelope, void *data)
+{
+    uint64_t *called = data;
+    *called += 1;
+
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t breadcrumbs = sentry_value_get_by_key(event, "breadcrumbs");
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(breadcrumbs), 1000);
+    for (int32_t i = 0; i < 1000; i++) {
+        sentry_value_t message = sentry_value_get_by_key(
+            sentry_value_get_by_index(breadcrumbs, (size_t)i), "message");
+        char expected[16];
+        snprintf(expected, sizeof(expected), "%d", i);
+        if (!sentry__string_eq(sentry_value_as_string(message), expected)) {
+            TEST_CHECK_STRING_EQUAL(sentry_value_as_string(message), expected);
+            break;
+        }
+    }
+}
+
+SENTRY_TEST(breadcrumbs_buffered)
+{
+    uint64_t called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_max_breadcrumbs(options, 1000);
+    TEST_CHECK(!sentry_options_get_qt_buffered_breadcrumbs(options));
+    sentry_options_set_qt_buffered_breadcrumbs(options, true);
+    TEST_CHECK(sentry_options_get_qt_buffered_breadcrumbs(options));
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(check_buffered_breadcrumbs, &called));
+    sentry_init(options);
+    sentry__breadcrumbs_start_buffered();
+
+    // this overflows the queue more than once, which drains it in between
+    for (int32_t i = 0; i < 1000; i++) {
+        char message[16];
+        snprintf(message, sizeof(message), "%d", i);
+        sentry__breadcrumbs_add_buffered(
+            sentry_value_new_breadcrumb(NULL, message));
+    }
+    // the event picks up all the breadcrumbs that are still buffered
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "event"));
+
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(called, 1);
+}
+
+static size_t
+scope_breadcrumb_count(void)
+{
+    size_t count = 0;
+    SENTRY_WITH_SCOPE (scope) {
+        count = sentry__ringbuffer_len(scope->breadcrumbs);
+    }
+    return count;
+}
+
+SENTRY_TEST(breadcrumbs_buffered_wake_up)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_qt_buffered_breadcrumbs(options, true);
+    sentry_init(options);
+    sentry__breadcrumbs_start_buffered();
+
+    // the idle queue thread is woken up by each breadcrumb, without a flush
+    for (size_t i = 0; i < 3; i++) {
+        sleep_ms(50);
+        sentry__breadcrumbs_add_buffered(
+            sentry_value_new_breadcrumb(NULL, "crumb"));
+        uint64_t deadline = sentry__monotonic_time() + 5000;
+        while (scope_breadcrumb_count() != i + 1
+            && sentry__monotonic_time() < deadline) {
+            sleep_ms(1);
+        }
+        TEST_CHECK_INT_EQUAL(scope_breadcrumb_count(), i + 1);
+    }
+
+    sentry_close();
+}
+
+SENTRY_TEST(breadcrumbs_bulk)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_max_breadcrumbs(options, 3);
+    sentry_init(options);
+
+    sentry_add_breadcrumb(sentry_value_new_breadcrumb(NULL, "single"));
+    sentry_value_t before = sentry_get_stats();
+    sentry_value_t breadcrumbs[5];
+    for (size_t i = 0; i < 5; i++) {
+        char message[16];
+        snprintf(message, sizeof(message), "%d", (int)i);
+        breadcrumbs[i] = sentry_value_new_breadcrumb(NULL, message);
+    }
+    sentry_add_breadcrumbs(breadcrumbs, 5);
+    sentry_add_breadcrumbs(NULL, 0);
+    sentry_value_t after = sentry_get_stats();
+
+    // the first two would be evicted by the later ones, and are never added
+    SENTRY_WITH_SCOPE (scope) {
+        sentry_value_t list = sentry__ringbuffer_to_list(scope->breadcrumbs);
+        TEST_CHECK_INT_EQUAL(sentry_value_get_length(list), 3);
+        for (size_t i = 0; i < 3; i++) {
+            char expected[16];
+            snprintf(expected, sizeof(expected), "%d", (int)i + 2);
+            TEST_CHECK_STRING_EQUAL(
+                sentry_value_as_string(sentry_value_get_by_key(
+                    sentry_value_get_by_index(list, i), "message")),
+                expected);
+        }
+        sentry_value_decref(list);
+    }
+    TEST_CHECK_INT_EQUAL(get_stat(after, "breadcrumbs_added")
+            - get_stat(before, "breadcrumbs_added"),
+        5);
+    TEST_CHECK_INT_EQUAL(get_stat(after, "breadcrumbs_evicted")
+            - get_stat(before, "breadcrumbs_evicted"),
+        3);
+
+    sentry_close();
+    sentry_value_decref(before);
+    sentry_value_decref(after);
+}
+
+SENTRY_TEST(transport_options)
+{
+    sentry_options_t *options = sentry_options_new();
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_connect_timeout(options), 10000);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_request_timeout(options), 0);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_low_speed_limit(options), 1);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_low_speed_time(options), 30000);
+    TEST_CHECK(sentry_options_get_transport_tcp_nodelay(options));
+    TEST_CHECK(sentry_options_get_transport_tcp_keepalive(options));
+    TEST_CHECK_INT_EQUAL(sentry_options_get_transport_ip_resolve(options),
+        SENTRY_IP_RESOLVE_ANY);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_happy_eyeballs_timeout(options), 0);
+
+    sentry_options_set_transport_connect_timeout(options, 2000);
+    sentry_options_set_transport_request_timeout(options, 120000);
+    sentry_options_set_transport_low_speed_limit(options, 512, 1500);
+    sentry_options_set_transport_tcp_nodelay(options, 0);
+    sentry_options_set_transport_tcp_keepalive(options, 0);
+    sentry_options_set_transport_ip_resolve(options, SENTRY_IP_RESOLVE_V4);
+    sentry_options_set_transport_happy_eyeballs_timeout(options, 100);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_connect_timeout(options), 2000);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_request_timeout(options), 120000);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_low_speed_limit(options), 512);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_low_speed_time(options), 1500);
+    TEST_CHECK(!sentry_options_get_transport_tcp_nodelay(options));
+    TEST_CHECK(!sentry_options_get_transport_tcp_keepalive(options));
+    TEST_CHECK_INT_EQUAL(sentry_options_get_transport_ip_resolve(options),
+        SENTRY_IP_RESOLVE_V4);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_transport_happy_eyeballs_timeout(options), 100);
+
+    sentry_options_free(options);
 }
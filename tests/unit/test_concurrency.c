@@ -2,6 +2,7 @@
 #include "sentry_testsupport.h"
 
 #include <sentry_sync.h>
+#include <sentry_value.h>
 
 static void
 send_envelope_test_concurrent(const sentry_envelope_t *envelope, void *data)
@@ -96,6 +97,91 @@ SENTRY_TEST(concurrent_init)
     TEST_CHECK(called <= THREADS_NUM * 3);
 }
 
+typedef struct {
+    long running;
+    long mismatches;
+} options_readers_t;
+
+SENTRY_THREAD_FN
+thread_options_reader(void *arg)
+{
+    options_readers_t *readers = arg;
+    while (sentry__atomic_fetch(&readers->running)) {
+        SENTRY_WITH_OPTIONS (options) {
+            const char *release = sentry_options_get_release(options);
+            if (!release || strcmp(release, "prod") != 0) {
+                sentry__atomic_fetch_and_add(&readers->mismatches, 1);
+            }
+        }
+    }
+    return 0;
+}
+
+SENTRY_TEST(concurrent_options_access)
+{
+    long called = 0;
+    options_readers_t readers = { 1, 0 };
+
+#define READERS_NUM 4
+    sentry_threadid_t threads[READERS_NUM];
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &thread_options_reader, &readers);
+    }
+
+    // the readers keep using the options while they are replaced and freed
+    for (int i = 0; i < 10; i++) {
+        init_framework(&called);
+        sentry_close();
+    }
+
+    sentry__atomic_store(&readers.running, 0);
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+    TEST_CHECK_INT_EQUAL(readers.mismatches, 0);
+}
+
+SENTRY_THREAD_FN
+thread_modules_reader(void *arg)
+{
+    options_readers_t *readers = arg;
+    while (sentry__atomic_fetch(&readers->running)) {
+        sentry_value_t modules = sentry_get_modules_list();
+        if (sentry_value_get_length(modules) == 0) {
+            sentry__atomic_fetch_and_add(&readers->mismatches, 1);
+        }
+        sentry_value_decref(modules);
+    }
+    return 0;
+}
+
+SENTRY_TEST(concurrent_modules_access)
+{
+    options_readers_t readers = { 1, 0 };
+
+    sentry_threadid_t threads[READERS_NUM];
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &thread_modules_reader, &readers);
+    }
+
+    // the readers keep using the module lists while they are replaced
+    for (int i = 0; i < 10; i++) {
+        sentry_clear_modulecache();
+        sentry_value_decref(sentry_get_modules_list());
+    }
+
+    sentry__atomic_store(&readers.running, 0);
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+    TEST_CHECK_INT_EQUAL(readers.mismatches, 0);
+    sentry_clear_modulecache();
+}
+
 SENTRY_THREAD_FN
 thread_breadcrumb(void *UNUSED(arg))
 {
@@ -122,3 +208,162 @@ SENTRY_TEST(concurrent_uninit)
 
     sentry_close();
 }
+
+static void
+count_envelopes(const sentry_envelope_t *UNUSED(envelope), void *data)
+{
+    sentry__atomic_fetch_and_add((long *)data, 1);
+}
+
+static sentry_value_t
+check_thread_tag_before_send(
+    sentry_value_t event, void *UNUSED(hint), void *data)
+{
+    const char *thread_tag = sentry_value_as_string(sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "tags"), "thread"));
+    const char *expected = sentry_value_as_string(sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "extra"), "expected"));
+    if (strcmp(thread_tag, expected) != 0) {
+        sentry__atomic_fetch_and_add((long *)data, 1);
+    }
+    return event;
+}
+
+SENTRY_THREAD_FN
+thread_scope_worker(void *arg)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%d", (int)(size_t)arg);
+    sentry_set_thread_tag("thread", name);
+
+    for (int i = 0; i < 50; i++) {
+        sentry_set_tag("shared", name);
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(NULL, name));
+
+        sentry_value_t event = sentry_value_new_message_event(
+            SENTRY_LEVEL_INFO, NULL, "concurrent");
+        sentry_value_t extra = sentry_value_new_object();
+        sentry_value_set_by_key(
+            extra, "expected", sentry_value_new_string(name));
+        sentry_value_set_by_key(event, "extra", extra);
+        sentry_capture_event(event);
+    }
+
+    sentry_clear_thread_scope();
+    return 0;
+}
+
+SENTRY_TEST(concurrent_scope)
+{
+    long called = 0;
+    long mismatches = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(count_envelopes, &called));
+    sentry_options_set_before_send(
+        options, check_thread_tag_before_send, &mismatches);
+    sentry_init(options);
+
+    sentry_threadid_t threads[THREADS_NUM];
+    for (size_t i = 0; i < THREADS_NUM; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &thread_scope_worker, (void *)i);
+    }
+    for (size_t i = 0; i < THREADS_NUM; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(called, THREADS_NUM * 50);
+    TEST_CHECK_INT_EQUAL(mismatches, 0);
+}
+
+SENTRY_THREAD_FN
+thread_arena_grower(void *data)
+{
+    sentry_value_t list = *(sentry_value_t *)data;
+    for (size_t i = 0; i < 1000; i++) {
+        sentry_value_append(list, sentry_value_new_int32((int32_t)i));
+    }
+    return 0;
+}
+
+SENTRY_TEST(concurrent_arena_growth)
+{
+    // containers that escaped their arena may grow on different threads
+    sentry_value_t lists[READERS_NUM];
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        lists[i] = sentry_value_new_list();
+    }
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
+
+    sentry_threadid_t threads[READERS_NUM];
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &thread_arena_grower, &lists[i]);
+    }
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        TEST_CHECK_INT_EQUAL(sentry_value_get_length(lists[i]), 1000);
+        TEST_CHECK_INT_EQUAL(
+            sentry_value_as_int32(sentry_value_get_by_index(lists[i], 999)),
+            999);
+        sentry_value_decref(lists[i]);
+    }
+}
+
+typedef struct {
+    sentry_value_t addr;
+    sentry_value_t uuid;
+    volatile long mismatches;
+} lazy_strings_t;
+
+SENTRY_THREAD_FN
+thread_lazy_string_reader(void *data)
+{
+    lazy_strings_t *strings = (lazy_strings_t *)data;
+    if (strcmp(sentry_value_as_string(strings->addr), "0xdeadbeef0") != 0
+        || strcmp(sentry_value_as_string(strings->uuid),
+               "4c035723-8638-4c3a-923f-2ab9d08b4018")
+            != 0) {
+        sentry__atomic_fetch_and_add(&strings->mismatches, 1);
+    }
+    return 0;
+}
+
+SENTRY_TEST(concurrent_lazy_strings)
+{
+    // frozen values are formatted by whichever thread reads them first
+    sentry_uuid_t uuid
+        = sentry_uuid_from_string("4c035723-8638-4c3a-923f-2ab9d08b4018");
+    lazy_strings_t strings;
+    strings.addr = sentry__value_new_addr(0xdeadbeef0);
+    strings.uuid = sentry__value_new_uuid(&uuid);
+    strings.mismatches = 0;
+
+    sentry_threadid_t threads[READERS_NUM];
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(
+            &threads[i], &thread_lazy_string_reader, &strings);
+    }
+    for (size_t i = 0; i < READERS_NUM; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&strings.mismatches), 0);
+    sentry_value_decref(strings.addr);
+    sentry_value_decref(strings.uuid);
+}
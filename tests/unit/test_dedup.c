@@ -0,0 +1,198 @@
+#include "sentry_dedup.h"
+#include "sentry_envelope.h"
+#include "sentry_testsupport.h"
+#include "sentry_value.h"
+
+static sentry_value_t
+exception_event(const char *value)
+{
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_t exception = sentry_value_new_exception("Error", value);
+    sentry_value_t frames = sentry_value_new_list();
+    sentry_value_t frame = sentry_value_new_object();
+    sentry_value_set_by_key(
+        frame, "instruction_addr", sentry_value_new_string("0x1234"));
+    sentry_value_append(frames, frame);
+    sentry_value_t stacktrace = sentry_value_new_object();
+    sentry_value_set_by_key(stacktrace, "frames", frames);
+    sentry_value_set_by_key(exception, "stacktrace", stacktrace);
+    sentry_event_add_exception(event, exception);
+    return event;
+}
+
+SENTRY_TEST(dedup_window)
+{
+    sentry_value_decref(sentry__dedup_flush());
+    sentry_value_t summaries = sentry_value_new_null();
+    sentry_value_t event = exception_event("foo");
+    sentry_value_t other = exception_event("bar");
+    sentry_value_t empty = sentry_value_new_event();
+
+    TEST_CHECK(!sentry__dedup_check(event, 100, true, 1000, &summaries));
+    TEST_CHECK(sentry__dedup_check(event, 100, true, 1000, &summaries));
+    TEST_CHECK(sentry__dedup_check(event, 100, true, 1050, &summaries));
+    TEST_CHECK(!sentry__dedup_check(other, 100, true, 1050, &summaries));
+    // events without anything to tell them apart are never duplicates
+    TEST_CHECK(!sentry__dedup_check(empty, 100, true, 1050, &summaries));
+    TEST_CHECK(!sentry__dedup_check(empty, 100, true, 1050, &summaries));
+    TEST_CHECK(sentry_value_is_null(summaries));
+
+    // once the window ends, the event is sent again, along with a summary
+    TEST_CHECK(!sentry__dedup_check(event, 100, true, 1100, &summaries));
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(summaries), 1);
+    sentry_value_t summary = sentry_value_get_by_index(summaries, 0);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_uint64(sentry_value_get_by_key(
+            sentry_value_get_by_key(summary, "extra"),
+            "duplicates_suppressed")),
+        2);
+    TEST_CHECK(
+        sentry_value_is_null(sentry_value_get_by_key(summary, "event_id")));
+    sentry_value_decref(summaries);
+
+    // without a summary, the duplicates are just dropped
+    summaries = sentry_value_new_null();
+    TEST_CHECK(sentry__dedup_check(other, 100, false, 1120, &summaries));
+    TEST_CHECK(sentry_value_is_null(summaries));
+
+    summaries = sentry__dedup_flush();
+    TEST_CHECK(sentry_value_is_null(summaries));
+    TEST_CHECK(!sentry__dedup_check(other, 100, true, 1120, &summaries));
+    // a window of 0 disables deduplication
+    TEST_CHECK(!sentry__dedup_check(other, 0, true, 1120, &summaries));
+
+    sentry_value_decref(sentry__dedup_flush());
+    sentry_value_decref(event);
+    sentry_value_decref(other);
+    sentry_value_decref(empty);
+}
+
+SENTRY_TEST(dedup_evicts_oldest)
+{
+    sentry_value_decref(sentry__dedup_flush());
+    sentry_value_t summaries = sentry_value_new_null();
+    sentry_value_t first = exception_event("first");
+    TEST_CHECK(!sentry__dedup_check(first, 1000, true, 0, &summaries));
+    TEST_CHECK(sentry__dedup_check(first, 1000, true, 0, &summaries));
+
+    char value[16];
+    for (int i = 0; i < 32; i++) {
+        snprintf(value, sizeof(value), "value%d", i);
+        sentry_value_t event = exception_event(value);
+        TEST_CHECK(!sentry__dedup_check(event, 1000, true, 1 + i, &summaries));
+        sentry_value_decref(event);
+    }
+    // the first event was evicted, which sends its summary
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(summaries), 1);
+    TEST_CHECK(!sentry__dedup_check(first, 1000, true, 100, &summaries));
+
+    sentry_value_decref(summaries);
+    sentry_value_decref(sentry__dedup_flush());
+    sentry_value_decref(first);
+}
+
+typedef struct {
+    int events;
+    int summaries;
+    uint64_t duplicates;
+} dedup_envelopes_t;
+
+static void
+collect_dedup_events(const sentry_envelope_t *envelope, void *data)
+{
+    dedup_envelopes_t *envelopes = data;
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    if (sentry_value_is_null(event)) {
+        return;
+    }
+    envelopes->events++;
+    sentry_value_t duplicates = sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "extra"), "duplicates_suppressed");
+    if (!sentry_value_is_null(duplicates)) {
+        envelopes->summaries++;
+        envelopes->duplicates = sentry_value_as_uint64(duplicates);
+    }
+}
+
+SENTRY_TEST(dedup_capture)
+{
+    dedup_envelopes_t envelopes = { 0, 0, 0 };
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(collect_dedup_events, &envelopes));
+    sentry_options_set_dedup_window(options, 60 * 1000);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_dedup_window(options), 60 * 1000);
+    TEST_CHECK(sentry_options_get_dedup_summary(options));
+    sentry_init(options);
+
+    for (int i = 0; i < 100; i++) {
+        sentry_capture_event(exception_event("in a loop"));
+    }
+    sentry_capture_event(exception_event("something else"));
+    TEST_CHECK_INT_EQUAL(envelopes.events, 2);
+
+    // the summary is sent on close
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(envelopes.events, 3);
+    TEST_CHECK_INT_EQUAL(envelopes.summaries, 1);
+    TEST_CHECK_INT_EQUAL(envelopes.duplicates, 99);
+}
+
+static void
+check_exception_event(const sentry_envelope_t *envelope, void *data)
+{
+    collect_dedup_events(envelope, data);
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(event, "level")),
+        "warning");
+    sentry_value_t exception = sentry_value_get_by_index(
+        sentry_value_get_by_key(
+            sentry_value_get_by_key(event, "exception"), "values"),
+        0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(exception, "type")),
+        "std::runtime_error");
+    const char *value
+        = sentry_value_as_string(sentry_value_get_by_key(exception, "value"));
+    TEST_CHECK(strcmp(value, "in a loop") == 0
+        || strcmp(value, "something else") == 0);
+    sentry_value_t frames = sentry_value_get_by_key(
+        sentry_value_get_by_key(exception, "stacktrace"), "frames");
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(frames), 2);
+    // the innermost frame comes last
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(
+            sentry_value_get_by_index(frames, 1), "instruction_addr")),
+        "0x1234");
+}
+
+SENTRY_TEST(dedup_capture_exception_n)
+{
+    dedup_envelopes_t envelopes = { 0, 0, 0 };
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(check_exception_event, &envelopes));
+    sentry_options_set_dedup_window(options, 60 * 1000);
+    sentry_init(options);
+
+    void *ips[] = { (void *)0x1234, (void *)0x5678 };
+    // neither of the strings is terminated where the exception ends
+    const char type[] = "std::runtime_error, and more";
+    const char value[] = "in a loop, and more";
+    for (int i = 0; i < 100; i++) {
+        sentry_uuid_t event_id = sentry_capture_exception_n(
+            SENTRY_LEVEL_WARNING, type, 18, value, 9, ips, 2);
+        TEST_CHECK(sentry_uuid_is_nil(&event_id) == (i > 0));
+    }
+    sentry_capture_exception_n(
+        SENTRY_LEVEL_WARNING, type, 18, "something else", 14, ips, 2);
+    TEST_CHECK_INT_EQUAL(envelopes.events, 2);
+
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(envelopes.events, 3);
+    TEST_CHECK_INT_EQUAL(envelopes.summaries, 1);
+    TEST_CHECK_INT_EQUAL(envelopes.duplicates, 99);
+}
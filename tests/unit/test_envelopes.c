@@ -1,9 +1,39 @@
+#include "sentry_database.h"
 #include "sentry_envelope.h"
+#include "sentry_path.h"
+#include "sentry_ratelimiter.h"
 #include "sentry_testsupport.h"
 #include "sentry_transport.h"
 #include "sentry_utils.h"
 #include "sentry_value.h"
 
+#ifdef SENTRY_TRANSPORT_COMPRESSION
+#    include <zlib.h>
+#endif
+
+#ifdef __ANDROID__
+#    define PREFIX "/data/local/tmp/"
+#else
+#    define PREFIX ""
+#endif
+
+static char *
+join_body_segments(const sentry_prepared_http_request_t *req)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry_envelope_body_reader_t reader;
+    sentry__envelope_body_reader_init(&reader, &req->body);
+    char chunk[7];
+    size_t chunk_len;
+    while ((chunk_len = sentry__envelope_body_read(&reader, chunk, 7)) > 0) {
+        sentry__stringbuilder_append_buf(&sb, chunk, chunk_len);
+    }
+    sentry__envelope_body_reader_cleanup(&reader);
+    TEST_CHECK_INT_EQUAL(sentry__stringbuilder_len(&sb), req->body.total_len);
+    return sentry__stringbuilder_into_string(&sb);
+}
+
 SENTRY_TEST(basic_http_request_preparation_for_event)
 {
     sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
@@ -21,10 +51,12 @@ SENTRY_TEST(basic_http_request_preparation_for_event)
     TEST_CHECK_STRING_EQUAL(req->method, "POST");
     TEST_CHECK_STRING_EQUAL(
         req->url, "https://sentry.invalid:443/api/42/envelope/");
-    TEST_CHECK_STRING_EQUAL(req->body,
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body,
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
         "{\"type\":\"event\",\"length\":51}\n"
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}");
+    sentry_free(body);
     sentry__prepared_http_request_free(req);
     sentry_envelope_free(envelope);
 
@@ -50,13 +82,15 @@ SENTRY_TEST(basic_http_request_preparation_for_transaction)
     TEST_CHECK_STRING_EQUAL(req->method, "POST");
     TEST_CHECK_STRING_EQUAL(
         req->url, "https://sentry.invalid:443/api/42/envelope/");
-    TEST_CHECK_STRING_EQUAL(req->body,
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body,
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\",\"sent_at\":"
         "\"2021-12-16T05:53:59.343Z\"}\n"
         "{\"type\":\"transaction\",\"length\":72}\n"
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\",\"type\":"
         "\"transaction\"}");
 
+    sentry_free(body);
     sentry__prepared_http_request_free(req);
     sentry_envelope_free(envelope);
 
@@ -83,12 +117,14 @@ SENTRY_TEST(basic_http_request_preparation_for_event_with_attachment)
     TEST_CHECK_STRING_EQUAL(req->method, "POST");
     TEST_CHECK_STRING_EQUAL(
         req->url, "https://sentry.invalid:443/api/42/envelope/");
-    TEST_CHECK_STRING_EQUAL(req->body,
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body,
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
         "{\"type\":\"event\",\"length\":51}\n"
         "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
         "{\"type\":\"attachment\",\"length\":12}\n"
         "Hello World!");
+    sentry_free(body);
     sentry__prepared_http_request_free(req);
     sentry_envelope_free(envelope);
 
@@ -112,16 +148,119 @@ SENTRY_TEST(basic_http_request_preparation_for_minidump)
     TEST_CHECK_STRING_EQUAL(req->method, "POST");
     TEST_CHECK_STRING_EQUAL(
         req->url, "https://sentry.invalid:443/api/42/envelope/");
-    TEST_CHECK_STRING_EQUAL(req->body,
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body,
         "{}\n"
         "{\"type\":\"minidump\",\"length\":4}\n"
         "MDMP\n"
         "{\"type\":\"attachment\",\"length\":12}\n"
         "Hello World!");
+    sentry_free(body);
+    sentry__prepared_http_request_free(req);
+    sentry_envelope_free(envelope);
+
+    sentry__dsn_decref(dsn);
+}
+
+SENTRY_TEST(http_request_body_segments)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry_uuid_t event_id
+        = sentry_uuid_from_string("c993afb6-b4ac-48a6-b61b-2558e601d65d");
+    sentry_value_t transaction = sentry_value_new_object();
+    sentry_value_set_by_key(
+        transaction, "event_id", sentry__value_new_uuid(&event_id));
+    sentry_value_set_by_key(
+        transaction, "type", sentry_value_new_string("transaction"));
+    sentry__envelope_add_transaction(envelope, transaction);
+    char msg[] = "Hello World!";
+    sentry__envelope_add_from_buffer(
+        envelope, msg, sizeof(msg) - 1, "attachment");
+
+    sentry_rate_limiter_t *rl = sentry__rate_limiter_new();
+    sentry__rate_limiter_update_from_header(rl, "60:transaction:project");
+
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(envelope, dsn, rl);
+    TEST_ASSERT(!!req);
+    // the envelope headers, followed by the attachment headers and payload
+    TEST_CHECK_INT_EQUAL(req->body.segments_len, 3);
+    TEST_CHECK_INT_EQUAL(req->body.segments[2].len, sizeof(msg) - 1);
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body,
+        "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\",\"sent_at\":"
+        "\"2021-12-16T05:53:59.343Z\"}\n"
+        "{\"type\":\"attachment\",\"length\":12}\n"
+        "Hello World!");
+    sentry_free(body);
     sentry__prepared_http_request_free(req);
+
+    // nothing is left to send once everything is limited
+    sentry__rate_limiter_update_from_header(rl, "60::project");
+    TEST_CHECK(!sentry__prepare_http_request(envelope, dsn, rl));
+
+    sentry__rate_limiter_free(rl);
     sentry_envelope_free(envelope);
+    sentry__dsn_decref(dsn);
+}
 
+SENTRY_TEST(http_request_body_compression)
+{
+#ifndef SENTRY_TRANSPORT_COMPRESSION
+    SKIP_TEST();
+#else
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    char small[] = "Hello World!";
+    sentry__envelope_add_from_buffer(
+        envelope, small, sizeof(small) - 1, "attachment");
+
+    // small bodies are sent uncompressed
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    TEST_CHECK_INT_EQUAL(req->headers_len, 3);
+    sentry__prepared_http_request_free(req);
+
+    char large[8192];
+    for (size_t i = 0; i < sizeof(large); i++) {
+        large[i] = "abcdefgh"[i % 8];
+    }
+    sentry__envelope_add_from_buffer(
+        envelope, large, sizeof(large), "attachment");
+    size_t serialized_len = 0;
+    char *serialized = sentry_envelope_serialize(envelope, &serialized_len);
+
+    req = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    TEST_CHECK_INT_EQUAL(req->headers_len, 4);
+    TEST_CHECK_STRING_EQUAL(req->headers[2].key, "content-encoding");
+    TEST_CHECK_STRING_EQUAL(req->headers[2].value, "gzip");
+    TEST_CHECK_INT_EQUAL(req->body.segments_len, 1);
+    TEST_CHECK(req->body.total_len < serialized_len / 10);
+
+    char *decompressed = sentry_malloc(serialized_len);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    TEST_CHECK_INT_EQUAL(inflateInit2(&stream, MAX_WBITS + 16), Z_OK);
+    stream.next_in = (Bytef *)req->body.segments[0].buf;
+    stream.avail_in = (uInt)req->body.segments[0].len;
+    stream.next_out = (Bytef *)decompressed;
+    stream.avail_out = (uInt)serialized_len;
+    TEST_CHECK_INT_EQUAL(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    TEST_CHECK_INT_EQUAL(stream.total_out, serialized_len);
+    TEST_CHECK(!memcmp(decompressed, serialized, serialized_len));
+    inflateEnd(&stream);
+
+    sentry_free(decompressed);
+    sentry_free(serialized);
+    sentry__prepared_http_request_free(req);
+    sentry_envelope_free(envelope);
     sentry__dsn_decref(dsn);
+#endif
 }
 
 SENTRY_TEST(serialize_envelope)
@@ -162,8 +301,593 @@ SENTRY_TEST(serialize_envelope)
         "{\"type\":\"attachment\",\"length\":12}\n"
         "Hello World!");
 
+    // writing to a file streams the same output
+    sentry_path_t *path = sentry__path_from_str(PREFIX ".serialized-envelope");
+    TEST_CHECK_INT_EQUAL(sentry_envelope_write_to_path(envelope, path), 0);
+    size_t file_len = 0;
+    char *file_contents = sentry__path_read_to_buffer(path, &file_len);
+    TEST_CHECK_STRING_EQUAL(file_contents, str);
+    TEST_CHECK_INT_EQUAL(file_len, strlen(str));
+    sentry_free(file_contents);
+    sentry__path_remove(path);
+    sentry__path_free(path);
+
+    sentry_envelope_free(envelope);
+    sentry_free(str);
+
+    sentry_close();
+}
+
+SENTRY_TEST(read_envelope_from_file)
+{
+    // the attachment comes first, and has to be skipped via its length, as
+    // it contains a newline
+    const char *serialized
+        = "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
+          "{\"type\":\"attachment\",\"length\":12}\n"
+          "Hello\nWorld!\n"
+          "{\"type\":\"event\",\"length\":24}\n"
+          "{\"message\":\"some event\"}\n";
+    sentry_path_t *path = sentry__path_from_str(PREFIX ".read-envelope");
+    TEST_CHECK_INT_EQUAL(
+        sentry__path_write_buffer(path, serialized, strlen(serialized)), 0);
+    sentry_envelope_t *envelope = sentry__envelope_from_path(path);
+    sentry__path_remove(path);
+    sentry__path_free(path);
+    TEST_ASSERT(!!envelope);
+
+    sentry_uuid_t event_id = sentry__envelope_get_event_id(envelope);
+    char event_id_str[37];
+    sentry_uuid_as_string(&event_id, event_id_str);
+    TEST_CHECK_STRING_EQUAL(
+        event_id_str, "c993afb6-b4ac-48a6-b61b-2558e601d65d");
+
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(event, "message")),
+        "some event");
+    TEST_CHECK(sentry_value_is_null(sentry_envelope_get_transaction(envelope)));
+
+    // the envelope is still sent as-is
+    size_t len = 0;
+    char *str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str, serialized);
+    TEST_CHECK_INT_EQUAL(len, strlen(serialized));
+    sentry_free(str);
+
+    sentry_envelope_free(envelope);
+}
+
+SENTRY_TEST(read_envelope_streamed)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+    size_t len = 256 * 1024;
+    char *contents = sentry_malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        contents[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+    }
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry__envelope_add_from_buffer(envelope, contents, len, "attachment");
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_set_by_key(
+        event, "message", sentry_value_new_string("some event"));
+    sentry__envelope_add_event(envelope, event);
+    sentry__envelope_add_from_buffer(envelope, "small", 5, "attachment");
+    sentry_path_t *path = sentry__path_from_str(PREFIX ".streamed-envelope");
+    TEST_CHECK_INT_EQUAL(sentry_envelope_write_to_path(envelope, path), 0);
+    size_t serialized_len = 0;
+    char *serialized = sentry_envelope_serialize(envelope, &serialized_len);
+    sentry_envelope_free(envelope);
+
+    envelope = sentry__envelope_from_path_streamed(path);
+    TEST_ASSERT(!!envelope);
+    TEST_CHECK_INT_EQUAL(sentry__envelope_get_item_count(envelope), 3);
+    // the large attachment stays in the file, the others are read
+    TEST_CHECK(!sentry__envelope_item_get_payload(
+        sentry__envelope_get_item(envelope, 0), NULL));
+    size_t payload_len = 0;
+    TEST_CHECK_STRING_EQUAL(
+        sentry__envelope_item_get_payload(
+            sentry__envelope_get_item(envelope, 2), &payload_len),
+        "small");
+    TEST_CHECK_INT_EQUAL(payload_len, 5);
+    TEST_CHECK(sentry__envelope_get_memory_usage(envelope) < len);
+    event = sentry_envelope_get_event(envelope);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(event, "message")),
+        "some event");
+
+    size_t streamed_len = 0;
+    char *streamed = sentry_envelope_serialize(envelope, &streamed_len);
+    TEST_CHECK_INT_EQUAL(streamed_len, serialized_len);
+    TEST_CHECK(!memcmp(streamed, serialized, serialized_len));
+    sentry_free(streamed);
+
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    char *body = join_body_segments(req);
+    TEST_CHECK(!memcmp(body, serialized, serialized_len));
+    sentry_free(body);
+    sentry__prepared_http_request_free(req);
+    sentry_envelope_free(envelope);
+
+    // items without a length end at the next newline
+    const char *implicit = "{}\n"
+                           "{\"type\":\"attachment\"}\n"
+                           "Hello\n"
+                           "{\"type\":\"attachment\",\"length\":5}\n"
+                           "World";
+    TEST_CHECK_INT_EQUAL(
+        sentry__path_write_buffer(path, implicit, strlen(implicit)), 0);
+    envelope = sentry__envelope_from_path_streamed(path);
+    TEST_ASSERT(!!envelope);
+    TEST_CHECK_INT_EQUAL(sentry__envelope_get_item_count(envelope), 2);
+    streamed = sentry_envelope_serialize(envelope, &streamed_len);
+    TEST_CHECK_STRING_EQUAL(streamed,
+        "{}\n"
+        "{\"type\":\"attachment\",\"length\":5}\n"
+        "Hello\n"
+        "{\"type\":\"attachment\",\"length\":5}\n"
+        "World");
+    sentry_free(streamed);
+    sentry_envelope_free(envelope);
+
+    // envelopes that do not fit into items are read as they are
+    const char *truncated = "{}\n"
+                            "{\"type\":\"attachment\",\"length\":50}\n"
+                            "Hello";
+    TEST_CHECK_INT_EQUAL(
+        sentry__path_write_buffer(path, truncated, strlen(truncated)), 0);
+    envelope = sentry__envelope_from_path_streamed(path);
+    TEST_ASSERT(!!envelope);
+    streamed = sentry_envelope_serialize(envelope, &streamed_len);
+    TEST_CHECK_STRING_EQUAL(streamed, truncated);
+    sentry_free(streamed);
+    sentry_envelope_free(envelope);
+
+    sentry__path_remove(path);
+    sentry__path_free(path);
+    sentry_free(serialized);
+    sentry_free(contents);
+    sentry__dsn_decref(dsn);
+}
+
+SENTRY_TEST(envelope_from_large_files)
+{
+    // large files are memory-mapped, which must survive their removal
+    size_t len = 256 * 1024;
+    char *contents = sentry_malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        contents[i] = (char)('a' + i % 26);
+    }
+    sentry_path_t *path = sentry__path_from_str(PREFIX ".large-attachment");
+    TEST_CHECK_INT_EQUAL(sentry__path_write_buffer(path, contents, len), 0);
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry_envelope_item_t *item
+        = sentry__envelope_add_from_path(envelope, path, "attachment");
+    TEST_ASSERT(!!item);
+    sentry__path_remove(path);
+
+    size_t payload_len = 0;
+    const char *payload = sentry__envelope_item_get_payload(item, &payload_len);
+    TEST_CHECK_INT_EQUAL(payload_len, len);
+    TEST_CHECK(!memcmp(payload, contents, len));
+
+    // and the same for whole envelopes
+    TEST_CHECK_INT_EQUAL(sentry_envelope_write_to_path(envelope, path), 0);
+    size_t serialized_len = 0;
+    char *serialized = sentry_envelope_serialize(envelope, &serialized_len);
+    sentry_envelope_free(envelope);
+
+    envelope = sentry__envelope_from_path(path);
+    TEST_ASSERT(!!envelope);
+    sentry__path_remove(path);
+    size_t raw_len = 0;
+    char *raw = sentry_envelope_serialize(envelope, &raw_len);
+    TEST_CHECK_INT_EQUAL(raw_len, serialized_len);
+    TEST_CHECK(!memcmp(raw, serialized, serialized_len));
+    sentry_envelope_free(envelope);
+
+    sentry_free(raw);
+    sentry_free(serialized);
+    sentry_free(contents);
+    sentry__path_free(path);
+}
+
+SENTRY_TEST(file_backed_envelope_items)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+    sentry_path_t *path = sentry__path_from_str(PREFIX ".file-backed-item");
+    sentry_path_t *out_path
+        = sentry__path_from_str(PREFIX ".file-backed-envelope");
+    const char contents[] = "Hello World!";
+    TEST_CHECK_INT_EQUAL(
+        sentry__path_write_buffer(path, contents, sizeof(contents) - 1), 0);
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    TEST_CHECK(!sentry__envelope_add_file_backed(
+        envelope, out_path, "attachment"));
+    sentry_envelope_item_t *item
+        = sentry__envelope_add_file_backed(envelope, path, "attachment");
+    TEST_ASSERT(!!item);
+    // the contents are read when serializing
+    TEST_CHECK(!sentry__envelope_item_get_payload(item, NULL));
+    const char *expected = "{}\n"
+                           "{\"type\":\"attachment\",\"length\":12}\n"
+                           "Hello World!";
+
+    size_t len = 0;
+    char *str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str, expected);
+    sentry_free(str);
+
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body, expected);
+    sentry_free(body);
+    sentry__prepared_http_request_free(req);
+
+    TEST_CHECK_INT_EQUAL(sentry_envelope_write_to_path(envelope, out_path), 0);
+    str = sentry__path_read_to_buffer(out_path, &len);
+    TEST_CHECK_STRING_EQUAL(str, expected);
+    sentry_free(str);
+
+    // a file that shrank is padded to its original length
+    TEST_CHECK_INT_EQUAL(sentry__path_write_buffer(path, "Bye", 3), 0);
+    str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_INT_EQUAL(len, strlen(expected));
+    TEST_CHECK(!memcmp(str + len - 12, "Bye\0\0\0\0\0\0\0\0\0", 12));
+    sentry_free(str);
+
+    sentry_envelope_free(envelope);
+    sentry__path_remove(path);
+    sentry__path_remove(out_path);
+    sentry__path_free(path);
+    sentry__path_free(out_path);
+    sentry__dsn_decref(dsn);
+}
+
+SENTRY_TEST(envelope_headers_serialized_once)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry_envelope_item_t *item
+        = sentry__envelope_add_from_buffer(envelope, "foo", 3, "attachment");
+    TEST_ASSERT(!!item);
+
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    TEST_CHECK_INT_EQUAL(req->body.segments_len, 3);
+    const char *envelope_headers = req->body.segments[0].buf;
+    const char *item_headers = req->body.segments[1].buf;
+    sentry__prepared_http_request_free(req);
+
+    // later serializations reuse the cached headers
+    req = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    TEST_CHECK(req->body.segments[0].buf == envelope_headers);
+    TEST_CHECK(req->body.segments[1].buf == item_headers);
+    sentry__prepared_http_request_free(req);
+
+    // and modifying the headers invalidates them
+    sentry__envelope_item_set_header(
+        item, "filename", sentry_value_new_string("foo.txt"));
+    sentry_value_t event = sentry_value_new_object();
+    sentry_value_set_by_key(event, "event_id",
+        sentry_value_new_string("4c035723-8638-4c3a-923f-2ab9d08b4018"));
+    TEST_CHECK(!!sentry__envelope_add_event(envelope, event));
+
+    const char *expected
+        = "{\"event_id\":\"4c035723-8638-4c3a-923f-2ab9d08b4018\"}\n"
+          "{\"type\":\"attachment\",\"length\":3,\"filename\":\"foo.txt\"}\n"
+          "foo\n"
+          "{\"type\":\"event\",\"length\":51}\n"
+          "{\"event_id\":\"4c035723-8638-4c3a-923f-2ab9d08b4018\"}";
+    size_t len = 0;
+    char *str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str, expected);
+    sentry_free(str);
+
+    req = sentry__prepare_http_request(envelope, dsn, NULL);
+    TEST_ASSERT(!!req);
+    char *body = join_body_segments(req);
+    TEST_CHECK_STRING_EQUAL(body, expected);
+    sentry_free(body);
+    sentry__prepared_http_request_free(req);
+
+    sentry_envelope_free(envelope);
+    sentry__dsn_decref(dsn);
+}
+
+SENTRY_TEST(envelope_merge_sessions)
+{
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry__envelope_add_from_buffer(envelope, "{}", 2, "attachment");
+    sentry_envelope_t *sessions = sentry__envelope_new();
+    sentry__envelope_add_from_buffer(sessions, "{\"sid\":1}", 9, "session");
+    sentry__envelope_add_from_buffer(sessions, "{\"sid\":2}", 9, "session");
+    sentry_envelope_t *other = sentry__envelope_new();
+    sentry__envelope_add_from_buffer(other, "{\"sid\":3}", 9, "session");
+    sentry__envelope_add_from_buffer(other, "{}", 2, "attachment");
+
+    // only envelopes consisting of sessions can be merged
+    TEST_CHECK(!sentry__envelope_merge_sessions(envelope, other));
+    TEST_CHECK(sentry__envelope_merge_sessions(envelope, sessions));
+    TEST_CHECK(!sentry__envelope_merge_sessions(envelope, sessions));
+
+    size_t len = 0;
+    char *str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str,
+        "{}\n"
+        "{\"type\":\"attachment\",\"length\":2}\n"
+        "{}\n"
+        "{\"type\":\"session\",\"length\":9}\n"
+        "{\"sid\":1}\n"
+        "{\"type\":\"session\",\"length\":9}\n"
+        "{\"sid\":2}");
+    sentry_free(str);
+    str = sentry_envelope_serialize(sessions, &len);
+    TEST_CHECK_STRING_EQUAL(str, "{}");
+    sentry_free(str);
+
+    // and only as long as they fit
+    for (size_t i = 0; i < SENTRY_MAX_ENVELOPE_ITEMS - 4; i++) {
+        sentry__envelope_add_from_buffer(envelope, "{}", 2, "attachment");
+    }
+    sentry_envelope_free(sessions);
+    sessions = sentry__envelope_new();
+    sentry__envelope_add_from_buffer(sessions, "{\"sid\":4}", 9, "session");
+    sentry__envelope_add_from_buffer(sessions, "{\"sid\":5}", 9, "session");
+    TEST_CHECK(!sentry__envelope_merge_sessions(envelope, sessions));
+    TEST_CHECK(sentry__envelope_merge_sessions(other, sessions));
+
     sentry_envelope_free(envelope);
+    sentry_envelope_free(sessions);
+    sentry_envelope_free(other);
+}
+
+SENTRY_TEST(envelope_event_with_members)
+{
+    sentry_uuid_t event_id
+        = sentry_uuid_from_string("c993afb6-b4ac-48a6-b61b-2558e601d65d");
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry_value_t event = sentry_value_new_object();
+    sentry_value_set_by_key(
+        event, "event_id", sentry__value_new_uuid(&event_id));
+    const char members[] = "\"release\":\"1.0\",\"tags\":{\"a\":\"b\"}";
+    TEST_CHECK(!!sentry__envelope_add_event_with_members(
+        envelope, event, members, sizeof(members) - 1));
+
+    size_t len = 0;
+    char *str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str,
+        "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
+        "{\"type\":\"event\",\"length\":84}\n"
+        "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\","
+        "\"release\":\"1.0\",\"tags\":{\"a\":\"b\"}}");
+    sentry_free(str);
+
+    // the event itself does not have the members
+    sentry_value_t stored = sentry_envelope_get_event(envelope);
+    TEST_CHECK(
+        sentry_value_is_null(sentry_value_get_by_key(stored, "release")));
+    sentry_envelope_free(envelope);
+
+    // without members, the event is kept as-is
+    envelope = sentry__envelope_new();
+    event = sentry_value_new_object();
+    sentry_value_set_by_key(
+        event, "event_id", sentry__value_new_uuid(&event_id));
+    sentry__envelope_add_event_with_members(envelope, event, NULL, 0);
+    str = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_STRING_EQUAL(str,
+        "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}\n"
+        "{\"type\":\"event\",\"length\":51}\n"
+        "{\"event_id\":\"c993afb6-b4ac-48a6-b61b-2558e601d65d\"}");
     sentry_free(str);
+    sentry_envelope_free(envelope);
+}
+
+SENTRY_TEST(write_crash_envelope)
+{
+    sentry_path_t *db_path = sentry__path_from_str(PREFIX ".crash-envelope-db");
+    sentry__path_remove_all(db_path);
+    sentry__path_create_dir_all(db_path);
+    sentry_run_t *run = sentry__run_new(db_path);
+    TEST_ASSERT(!!run);
+    TEST_CHECK(sentry__run_prepare_crash_envelope(run));
+    // preparing twice keeps the file that is already open
+    TEST_CHECK(sentry__run_prepare_crash_envelope(run));
+    TEST_CHECK(sentry__path_is_file(run->crash_pending_path));
+    TEST_CHECK(!sentry__path_is_file(run->crash_path));
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry__envelope_add_event(envelope, sentry_value_new_object());
+    sentry__envelope_add_from_buffer(envelope, "MDMP", 4, "minidump");
+    TEST_CHECK(sentry__run_write_crash_envelope(run, envelope));
+    TEST_CHECK(!sentry__path_is_file(run->crash_pending_path));
+
+    size_t len = 0;
+    char *expected = sentry_envelope_serialize(envelope, &len);
+    size_t file_len = 0;
+    char *file_contents
+        = sentry__path_read_to_buffer(run->crash_path, &file_len);
+    TEST_CHECK_STRING_EQUAL(file_contents, expected);
+    TEST_CHECK_INT_EQUAL(file_len, len);
+    sentry_free(file_contents);
+    sentry_free(expected);
+
+    // any further envelope is written like a regular one
+    sentry_uuid_t event_id = sentry__envelope_get_event_id(envelope);
+    TEST_CHECK(sentry__run_write_crash_envelope(run, envelope));
+    char filename[37 + 9];
+    sentry_uuid_as_string(&event_id, filename);
+    strcpy(&filename[36], ".envelope");
+    sentry_path_t *path = sentry__path_join_str(run->run_path, filename);
+    TEST_CHECK(sentry__path_is_file(path));
+    sentry__path_free(path);
+    sentry_envelope_free(envelope);
+
+    sentry__run_clean(run);
+    sentry__run_free(run);
+    sentry__path_remove_all(db_path);
+    sentry__path_free(db_path);
+}
+
+SENTRY_TEST(shared_envelope_http_requests)
+{
+    sentry_dsn_t *dsn = sentry__dsn_new("https://foo@sentry.invalid/42");
+    sentry_dsn_t *mirror_dsn = sentry__dsn_new("https://bar@mirror.invalid/7");
+
+    sentry_envelope_t *envelope = sentry__envelope_new();
+    sentry_value_t transaction = sentry_value_new_object();
+    sentry_value_set_by_key(
+        transaction, "type", sentry_value_new_string("transaction"));
+    sentry__envelope_add_transaction(envelope, transaction);
+    // large enough to be compressed
+    char msg[2048];
+    memset(msg, 'a', sizeof(msg));
+    sentry__envelope_add_from_buffer(envelope, msg, sizeof(msg), "attachment");
+
+    TEST_CHECK(!sentry__envelope_share(envelope));
+    sentry_envelope_t *shared = sentry__envelope_new_shared(envelope, NULL);
+    TEST_ASSERT(!!shared);
+    sentry_envelope_t *copy = sentry__envelope_share(shared);
+    TEST_ASSERT(!!copy);
+    TEST_CHECK(sentry__envelope_get_shared(copy)
+        == sentry__envelope_get_shared(shared));
+    TEST_CHECK(!sentry_value_is_null(sentry_envelope_get_transaction(copy)));
+
+    sentry_prepared_http_request_t *req
+        = sentry__prepare_http_request(shared, dsn, NULL);
+    sentry_prepared_http_request_t *mirror_req
+        = sentry__prepare_http_request(copy, mirror_dsn, NULL);
+    TEST_ASSERT(req && mirror_req);
+    TEST_CHECK_STRING_EQUAL(
+        mirror_req->url, "https://mirror.invalid:443/api/7/envelope/");
+    // both requests send the same bytes, which were only compressed once
+    TEST_CHECK_INT_EQUAL(mirror_req->body.segments_len, 1);
+    TEST_CHECK(req->body.segments[0].buf == mirror_req->body.segments[0].buf);
+    TEST_CHECK_INT_EQUAL(req->body.total_len, mirror_req->body.total_len);
+    TEST_CHECK_INT_EQUAL(req->headers_len, mirror_req->headers_len);
+
+    size_t len = 0;
+    char *expected = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK_INT_EQUAL(mirror_req->uncompressed_len, len);
+#ifndef SENTRY_TRANSPORT_COMPRESSION
+    char *body = join_body_segments(mirror_req);
+    TEST_CHECK_STRING_EQUAL(body, expected);
+    sentry_free(body);
+#endif
+    sentry_free(expected);
+    sentry__prepared_http_request_free(req);
+    sentry__prepared_http_request_free(mirror_req);
+    sentry_envelope_free(shared);
+    sentry_envelope_free(copy);
+
+    // destinations that rate limit some of the items get their own copy
+    sentry_rate_limiter_t *rl = sentry__rate_limiter_new();
+    sentry__rate_limiter_update_from_header(rl, "60:transaction:project");
+    sentry_envelope_t *limited = sentry__envelope_new_shared(envelope, rl);
+    TEST_ASSERT(!!limited);
+    char *serialized = sentry_envelope_serialize(limited, &len);
+    TEST_CHECK(!strstr(serialized, "\"type\":\"transaction\""));
+    TEST_CHECK(
+        !!strstr(serialized, "{\"type\":\"attachment\",\"length\":2048}"));
+    sentry_free(serialized);
+    sentry_envelope_free(limited);
 
+    sentry__rate_limiter_update_from_header(rl, "60::project");
+    TEST_CHECK(!sentry__envelope_new_shared(envelope, rl));
+    sentry__rate_limiter_free(rl);
+
+    sentry_envelope_free(envelope);
+    sentry__dsn_decref(mirror_dsn);
+    sentry__dsn_decref(dsn);
+}
+
+typedef struct {
+    char dsn[64];
+    const sentry_shared_payload_t *payload;
+    size_t sent;
+} mirror_transport_state_t;
+
+static mirror_transport_state_t g_mirror_states[3];
+static size_t g_mirror_transports = 0;
+
+static int
+mirror_transport_startup(const sentry_options_t *options, void *_state)
+{
+    mirror_transport_state_t *state = _state;
+    snprintf(state->dsn, sizeof(state->dsn), "%s",
+        sentry_options_get_dsn(options));
+    return 0;
+}
+
+static void
+mirror_transport_send(sentry_envelope_t *envelope, void *_state)
+{
+    mirror_transport_state_t *state = _state;
+    state->payload = sentry__envelope_get_shared(envelope);
+    state->sent++;
+    sentry_envelope_free(envelope);
+}
+
+static sentry_transport_t *
+new_mirror_transport(void)
+{
+    if (g_mirror_transports >= 3) {
+        return NULL;
+    }
+    sentry_transport_t *transport = sentry_transport_new(mirror_transport_send);
+    sentry_transport_set_state(
+        transport, &g_mirror_states[g_mirror_transports++]);
+    sentry_transport_set_startup_func(transport, mirror_transport_startup);
+    sentry__transport_set_factory_func(transport, new_mirror_transport);
+    return transport;
+}
+
+SENTRY_TEST(mirror_dsns_share_envelopes)
+{
+    memset(g_mirror_states, 0, sizeof(g_mirror_states));
+    g_mirror_transports = 0;
+    // envelopes of earlier runs would be sent as well otherwise
+    sentry_path_t *db_path = sentry__path_from_str(PREFIX ".sentry-mirrors");
+    sentry__path_remove_all(db_path);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_database_path(options, PREFIX ".sentry-mirrors");
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_add_mirror_dsn(options, "https://bar@mirror.invalid/7");
+    sentry_options_add_mirror_dsn(options, "not a dsn");
+    sentry_options_add_mirror_dsn(options, "https://baz@other.invalid/8");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_transport(options, new_mirror_transport());
+    sentry_init(options);
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "mirrored"));
     sentry_close();
+
+    TEST_CHECK_INT_EQUAL(g_mirror_transports, 3);
+    TEST_CHECK_STRING_EQUAL(
+        g_mirror_states[0].dsn, "https://foo@sentry.invalid/42");
+    const char *first = g_mirror_states[1].dsn;
+    const char *second = g_mirror_states[2].dsn;
+    TEST_CHECK((sentry__string_eq(first, "https://bar@mirror.invalid/7")
+                   && sentry__string_eq(second, "https://baz@other.invalid/8"))
+        || (sentry__string_eq(first, "https://baz@other.invalid/8")
+            && sentry__string_eq(second, "https://bar@mirror.invalid/7")));
+    for (size_t i = 0; i < 3; i++) {
+        TEST_CHECK_INT_EQUAL(g_mirror_states[i].sent, 1);
+        TEST_CHECK(!!g_mirror_states[i].payload);
+        TEST_CHECK(g_mirror_states[i].payload == g_mirror_states[0].payload);
+    }
+
+    sentry__path_remove_all(db_path);
+    sentry__path_free(db_path);
 }
@@ -0,0 +1,215 @@
+#include "sentry_database.h"
+#include "sentry_envelope.h"
+#include "sentry_journal.h"
+#include "sentry_path.h"
+#include "sentry_session.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_testsupport.h"
+#include "sentry_utils.h"
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
+
+static void
+collect_record(sentry_journal_record_type_t type, const char *buf, size_t len,
+    void *data)
+{
+    sentry_stringbuilder_t *sb = data;
+    sentry__stringbuilder_append_char(sb, (char)('0' + type));
+    sentry__stringbuilder_append_buf(sb, buf, len);
+    sentry__stringbuilder_append_char(sb, ';');
+}
+
+static char *
+read_records(const sentry_path_t *path, size_t *count_out)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    size_t count = sentry__journal_read(path, collect_record, &sb);
+    if (count_out) {
+        *count_out = count;
+    }
+    sentry__stringbuilder_append_char(&sb, '\0');
+    return sentry__stringbuilder_into_string(&sb);
+}
+
+SENTRY_TEST(journal_stops_at_incomplete_record)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-journal");
+    sentry_journal_t *journal = sentry__journal_new(path);
+    TEST_ASSERT(!!journal);
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_ENVELOPE, "env", 3)
+        == 0);
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_SESSION, "s1", 2) == 0);
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_SESSION_CLEARED, NULL, 0)
+        == 0);
+    sentry__journal_free(journal);
+
+    size_t count = 0;
+    char *records = read_records(path, &count);
+    TEST_CHECK_INT_EQUAL(count, 3);
+    TEST_CHECK_STRING_EQUAL(records, "1env;2s1;3;");
+    sentry_free(records);
+
+    // a crash in the middle of appending leaves a partial record behind
+    TEST_CHECK(sentry__path_append_buffer(path, "\x01\0\0\0\x10", 5) == 0);
+    records = read_records(path, &count);
+    TEST_CHECK_INT_EQUAL(count, 3);
+    TEST_CHECK_STRING_EQUAL(records, "1env;2s1;3;");
+    sentry_free(records);
+
+    // a corrupted payload fails its checksum, and ends the journal there
+    size_t len = 0;
+    char *buf = sentry__path_read_to_buffer(path, &len);
+    TEST_ASSERT(!!buf);
+    // the records contain null bytes, so this can not use `strstr`
+    size_t offset = 0;
+    while (
+        offset + 1 < len && (buf[offset] != 's' || buf[offset + 1] != '1')) {
+        offset++;
+    }
+    TEST_ASSERT(offset + 1 < len);
+    buf[offset + 1] = '2';
+    TEST_CHECK(sentry__path_write_buffer(path, buf, len) == 0);
+    sentry_free(buf);
+    records = read_records(path, &count);
+    TEST_CHECK_INT_EQUAL(count, 1);
+    TEST_CHECK_STRING_EQUAL(records, "1env;");
+    sentry_free(records);
+
+    sentry__path_remove(path);
+    sentry__path_free(path);
+}
+
+SENTRY_TEST(journal_compacts_superseded_sessions)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-journal");
+    sentry_journal_t *journal = sentry__journal_new(path);
+    TEST_ASSERT(!!journal);
+
+    char session[256];
+    memset(session, 's', sizeof(session));
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_ENVELOPE, "one", 3)
+        == 0);
+    for (size_t i = 0; i < 1024; i++) {
+        session[0] = (char)('a' + i % 26);
+        TEST_CHECK(sentry__journal_append(journal, SENTRY_JOURNAL_SESSION,
+                       session, sizeof(session))
+            == 0);
+    }
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_ENVELOPE, "two", 3)
+        == 0);
+    // the superseded sessions were compacted away while appending
+    TEST_CHECK(sentry__path_get_size(path) < 128 * 1024);
+
+    TEST_CHECK(sentry__journal_compact(journal) == 0);
+    TEST_CHECK(
+        sentry__journal_append(journal, SENTRY_JOURNAL_ENVELOPE, "three", 5)
+        == 0);
+    sentry__journal_free(journal);
+
+    size_t count = 0;
+    char *records = read_records(path, &count);
+    TEST_CHECK_INT_EQUAL(count, 4);
+    TEST_CHECK(!strncmp(records, "1one;2j", 7));
+    TEST_CHECK(strstr(records, ";1two;1three;") != NULL);
+    sentry_free(records);
+
+    sentry__path_remove(path);
+    sentry__path_free(path);
+}
+
+typedef struct {
+    volatile long events;
+    volatile long sessions;
+} journal_counts_t;
+
+static void
+count_journal_envelopes(const sentry_envelope_t *envelope, void *data)
+{
+    journal_counts_t *counts = data;
+    if (!sentry_value_is_null(sentry_envelope_get_event(envelope))) {
+        sentry__atomic_fetch_and_add(&counts->events, 1);
+    }
+    for (size_t i = 0; i < sentry__envelope_get_item_count(envelope); i++) {
+        const sentry_envelope_item_t *item
+            = sentry__envelope_get_item(envelope, i);
+        sentry_value_t type = sentry__envelope_item_get_header(item, "type");
+        if (sentry__string_eq(sentry_value_as_string(type), "session")) {
+            sentry__atomic_fetch_and_add(&counts->sessions, 1);
+        }
+    }
+}
+
+SENTRY_TEST(journal_of_old_run)
+{
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-journal");
+    sentry__path_remove_all(database_path);
+    TEST_CHECK(sentry__path_create_dir_all(database_path) == 0);
+
+    sentry_run_t *run = sentry__run_new(database_path);
+    TEST_ASSERT(!!run);
+    TEST_ASSERT(sentry__run_set_journal(run));
+    const char session_json[]
+        = "{\"sid\":\"4c035723-8638-4c3a-923f-2ab9d08b4018\",\"status\":\"ok\","
+          "\"started\":\"2021-01-01T00:00:00.000Z\","
+          "\"attrs\":{\"release\":\"test-release\"}}";
+    sentry_session_t *session
+        = sentry__session_from_json(session_json, sizeof(session_json) - 1);
+    TEST_ASSERT(!!session);
+    for (int i = 0; i < 2; i++) {
+        sentry_envelope_t *envelope = sentry__envelope_new();
+        sentry__envelope_add_event(envelope, sentry_value_new_event());
+        TEST_CHECK(sentry__run_write_envelope(run, envelope));
+        sentry_envelope_free(envelope);
+        session->errors = i;
+        TEST_CHECK(sentry__run_write_session(run, session));
+    }
+    sentry__session_free(session);
+
+    // everything went into the journal
+    sentry_path_t *journal_path
+        = sentry__path_join_str(run->run_path, "journal");
+    TEST_CHECK(sentry__path_is_file(journal_path));
+    TEST_CHECK(!sentry__path_is_file(run->session_path));
+    sentry__path_free(journal_path);
+    // this unlocks the run so that it counts as an old one
+    sentry__run_free(run);
+
+    journal_counts_t counts = { 0, 0 };
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_database_path(options, ".sentry-native-journal");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_run_journal(options, true);
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(count_journal_envelopes, &counts));
+    sentry_init(options);
+
+    uint64_t deadline = sentry__monotonic_time() + 5000;
+    while ((sentry__atomic_fetch(&counts.events) < 2
+               || sentry__atomic_fetch(&counts.sessions) < 1)
+        && sentry__monotonic_time() < deadline) {
+        sleep_ms(1);
+    }
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&counts.events), 2);
+    // only the most recent session update is sent
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&counts.sessions), 1);
+
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
@@ -1,10 +1,22 @@
 #include "sentry_core.h"
 #include "sentry_logger.h"
+#include "sentry_sync.h"
 #include "sentry_testsupport.h"
+#include "sentry_utils.h"
+
+#include <string.h>
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
 
 typedef struct {
-    uint64_t called;
-    bool assert_now;
+    volatile long called;
+    volatile long assert_now;
 } logger_test_t;
 
 static void
@@ -12,21 +24,21 @@ test_logger(
     sentry_level_t level, const char *message, va_list args, void *_data)
 {
     logger_test_t *data = _data;
-    if (data->assert_now) {
-        data->called += 1;
+    char formatted[128];
+    vsnprintf(formatted, sizeof(formatted), message, args);
 
+    // the thread that loads the modules during `sentry_init` logs as well, so
+    // only the message of the test itself is checked
+    if (sentry__atomic_fetch(&data->assert_now)
+        && strcmp(formatted, "Oh this is bad") == 0) {
+        sentry__atomic_fetch_and_add(&data->called, 1);
         TEST_CHECK(level == SENTRY_LEVEL_WARNING);
-
-        char formatted[128];
-        vsprintf(formatted, message, args);
-
-        TEST_CHECK_STRING_EQUAL(formatted, "Oh this is bad");
     }
 }
 
 SENTRY_TEST(custom_logger)
 {
-    logger_test_t data = { 0, false };
+    logger_test_t data = { 0, 0 };
 
     sentry_options_t *options = sentry_options_new();
     sentry_options_set_debug(options, true);
@@ -34,16 +46,141 @@ SENTRY_TEST(custom_logger)
 
     sentry_init(options);
 
-    data.assert_now = true;
+    sentry__atomic_store(&data.assert_now, 1);
     SENTRY_WARNF("Oh this is %s", "bad");
-    data.assert_now = false;
+    sentry__atomic_store(&data.assert_now, 0);
 
     sentry_close();
 
-    TEST_CHECK_INT_EQUAL(data.called, 1);
+#if SENTRY_MIN_LOG_LEVEL <= 1
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&data.called), 1);
+#else
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&data.called), 0);
+#endif
 
     // *really* clear the logger instance
     options = sentry_options_new();
     sentry_init(options);
     sentry_close();
 }
+
+typedef struct {
+    long logged;
+    long dropped;
+    long last;
+    bool out_of_order;
+} async_logger_test_t;
+
+static void
+test_async_logger(sentry_level_t UNUSED(level), const char *message,
+    va_list args, void *_data)
+{
+    async_logger_test_t *data = _data;
+
+    char formatted[128];
+    vsnprintf(formatted, sizeof(formatted), message, args);
+
+    long number = 0;
+    if (sscanf(formatted, "%ld log messages were dropped", &number) == 1) {
+        data->dropped += number;
+    } else if (sscanf(formatted, "async message %ld", &number) == 1) {
+        data->out_of_order = data->out_of_order || number <= data->last;
+        data->last = number;
+        data->logged++;
+    }
+}
+
+SENTRY_TEST(async_logger)
+{
+    async_logger_test_t data = { 0, 0, -1, false };
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_debug(options, true);
+    sentry_options_set_logger(options, test_async_logger, &data);
+    TEST_CHECK(!sentry_options_get_logger_async(options));
+    sentry_options_set_logger_async(options, true);
+    TEST_CHECK(sentry_options_get_logger_async(options));
+
+    sentry_init(options);
+
+    // more than fit into the buffer at once
+    for (long i = 0; i < 1000; i++) {
+        SENTRY_DEBUGF("async message %ld", i);
+    }
+
+    // the buffered messages are logged on close
+    sentry_close();
+
+#if SENTRY_MIN_LOG_LEVEL <= 0
+    TEST_CHECK(data.logged > 0);
+    TEST_CHECK(data.logged <= 1000);
+    // the dropped messages might include some of the SDK itself
+    TEST_CHECK(data.logged + data.dropped >= 1000);
+    TEST_CHECK(!data.out_of_order);
+
+    // messages are logged right away after closing
+    long logged = data.logged;
+    SENTRY_DEBUGF("async message %ld", 1000L);
+    TEST_CHECK_INT_EQUAL(data.logged, logged + 1);
+#else
+    TEST_CHECK_INT_EQUAL(data.logged, 0);
+#endif
+
+    options = sentry_options_new();
+    sentry_init(options);
+    sentry_close();
+}
+
+static void
+count_idle_message(
+    sentry_level_t UNUSED(level), const char *message, va_list args, void *data)
+{
+    char formatted[128];
+    vsnprintf(formatted, sizeof(formatted), message, args);
+    if (strcmp(formatted, "idle message") == 0) {
+        sentry__atomic_fetch_and_add((volatile long *)data, 1);
+    }
+}
+
+SENTRY_TEST(async_logger_wakes_up)
+{
+    volatile long logged = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_debug(options, true);
+    sentry_options_set_logger(options, count_idle_message, (void *)&logged);
+    sentry_options_set_logger_async(options, true);
+    sentry_init(options);
+
+#if SENTRY_MIN_LOG_LEVEL <= 1
+    // the idle logger thread is woken up by the message, not by closing
+    for (int i = 0; i < 3; i++) {
+        sleep_ms(50);
+        SENTRY_WARN("idle message");
+        uint64_t deadline = sentry__monotonic_time() + 5000;
+        while (sentry__atomic_fetch(&logged) != i + 1
+            && sentry__monotonic_time() < deadline) {
+            sleep_ms(1);
+        }
+        TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&logged), i + 1);
+    }
+#endif
+    sentry_close();
+
+    options = sentry_options_new();
+    sentry_init(options);
+    sentry_close();
+}
+
+SENTRY_TEST(log_level_elimination)
+{
+    int evaluated = 0;
+    SENTRY_TRACEF("evaluated %d", ++evaluated);
+    SENTRY_DEBUGF("evaluated %d", ++evaluated);
+    SENTRY_WARNF("evaluated %d", ++evaluated);
+
+    // the arguments of messages below the minimum level are not evaluated
+    TEST_CHECK_INT_EQUAL(evaluated,
+        (SENTRY_MIN_LOG_LEVEL <= -1) + (SENTRY_MIN_LOG_LEVEL <= 0)
+            + (SENTRY_MIN_LOG_LEVEL <= 1));
+}
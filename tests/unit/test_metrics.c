@@ -0,0 +1,128 @@
+#include "sentry_envelope.h"
+#include "sentry_metrics.h"
+#include "sentry_string.h"
+#include "sentry_testsupport.h"
+
+typedef struct {
+    int envelopes;
+    char statsd[1024];
+} statsd_envelopes_t;
+
+static void
+collect_statsd(const sentry_envelope_t *envelope, void *data)
+{
+    statsd_envelopes_t *envelopes = data;
+    for (size_t i = 0; i < sentry__envelope_get_item_count(envelope); i++) {
+        const sentry_envelope_item_t *item
+            = sentry__envelope_get_item(envelope, i);
+        const char *type = sentry_value_as_string(
+            sentry__envelope_item_get_header(item, "type"));
+        if (sentry__string_eq(type, "statsd")) {
+            envelopes->envelopes++;
+            size_t len = 0;
+            const char *payload = sentry__envelope_item_get_payload(item, &len);
+            size_t used = strlen(envelopes->statsd);
+            snprintf(envelopes->statsd + used, sizeof(envelopes->statsd) - used,
+                "%.*s", (int)len, payload);
+        }
+    }
+}
+
+static sentry_options_t *
+metrics_options(statsd_envelopes_t *envelopes)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(collect_statsd, envelopes));
+    sentry_options_set_enable_metrics(options, 1);
+    return options;
+}
+
+SENTRY_TEST(metrics_aggregation)
+{
+    statsd_envelopes_t envelopes = { 0, "" };
+    sentry_options_t *options = metrics_options(&envelopes);
+    TEST_CHECK(sentry_options_get_enable_metrics(options));
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_metrics_max_memory(options), 1024 * 1024);
+    sentry_init(options);
+
+    sentry_metrics_increment("requests", 1, NULL, "route:/home");
+    sentry_metrics_increment("requests", 1, NULL, "route:/home");
+    sentry_metrics_gauge("queue", 1, NULL, NULL);
+    sentry_metrics_gauge("queue", 3, NULL, NULL);
+    sentry_metrics_gauge("queue", 2, NULL, NULL);
+    sentry_metrics_distribution("latency", 2, "millisecond", NULL);
+    sentry_metrics_distribution("latency", 1.5, "millisecond", NULL);
+    sentry_metrics_set("users", "alice", NULL, NULL);
+    sentry_metrics_set("users", "bob", NULL, NULL);
+    sentry_metrics_set("users", "alice", NULL, NULL);
+    sentry__metrics_flush();
+
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 1);
+    TEST_CHECK(strstr(envelopes.statsd, "requests@none:2|c|#route:/home|T")
+        != NULL);
+    TEST_CHECK(strstr(envelopes.statsd, "queue@none:2:1:3:6:3|g|T") != NULL);
+    TEST_CHECK(
+        strstr(envelopes.statsd, "latency@millisecond:1.5:2|d|T") != NULL);
+    const char *set = strstr(envelopes.statsd, "users@none:");
+    TEST_CHECK(set != NULL);
+    if (set) {
+        // the two members are only sent once each
+        size_t members = 0;
+        for (; *set != '|'; set++) {
+            members += *set == ':';
+        }
+        TEST_CHECK_INT_EQUAL(members, 2);
+    }
+
+    // empty buckets are not sent
+    sentry__metrics_flush();
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 1);
+
+    // the remaining metrics are sent on close
+    sentry_metrics_increment("closed", 1, NULL, NULL);
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 2);
+    TEST_CHECK(strstr(envelopes.statsd, "closed@none:1|c|T") != NULL);
+
+    // nothing is recorded once closed
+    sentry_metrics_increment("closed", 1, NULL, NULL);
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 2);
+}
+
+SENTRY_TEST(metrics_disabled)
+{
+    statsd_envelopes_t envelopes = { 0, "" };
+    sentry_options_t *options = metrics_options(&envelopes);
+    sentry_options_set_enable_metrics(options, 0);
+    sentry_init(options);
+    sentry_metrics_increment("requests", 1, NULL, NULL);
+    sentry__metrics_flush();
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 0);
+}
+
+SENTRY_TEST(metrics_memory_cap)
+{
+    statsd_envelopes_t envelopes = { 0, "" };
+    sentry_options_t *options = metrics_options(&envelopes);
+    // leaves room for the minimum number of slots, and a few values
+    sentry_options_set_metrics_max_memory(options, 1024);
+    sentry_init(options);
+    char key[16];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        sentry_metrics_increment(key, 1, NULL, NULL);
+    }
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(envelopes.envelopes, 1);
+    size_t lines = 0;
+    for (const char *c = envelopes.statsd; *c; c++) {
+        lines += *c == '\n';
+    }
+    // the metrics that do not fit are dropped
+    TEST_CHECK(lines > 0 && lines < 100);
+}
@@ -1,10 +1,23 @@
+#include "sentry_backend.h"
+#include "sentry_modulefinder.h"
+#include "sentry_options.h"
 #include "sentry_path.h"
+#include "sentry_string.h"
 #include "sentry_testsupport.h"
+#include "sentry_value.h"
 
 #ifdef SENTRY_PLATFORM_LINUX
 #    include "modulefinder/sentry_modulefinder_linux.h"
 #endif
 
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
+
 SENTRY_TEST(module_finder)
 {
     // make sure that we are able to do multiple cleanup cycles
@@ -36,6 +49,269 @@ SENTRY_TEST(module_finder)
     sentry_clear_modulecache();
 }
 
+SENTRY_TEST(module_finder_incremental)
+{
+#if !defined(SENTRY_PLATFORM_LINUX) && !defined(SENTRY_PLATFORM_WINDOWS)
+    SKIP_TEST();
+#else
+    sentry_clear_modulecache();
+    sentry_value_t modules = sentry_get_modules_list();
+
+    // without any libraries being loaded, the same list is handed out again
+    sentry_value_t cached = sentry_get_modules_list();
+    TEST_CHECK(cached._bits == modules._bits);
+    sentry_value_decref(cached);
+
+    // after clearing the cache, the modules that are still loaded are reused
+    sentry_clear_modulecache();
+    sentry_value_t reloaded = sentry_get_modules_list();
+    TEST_CHECK(reloaded._bits != modules._bits);
+    TEST_CHECK(sentry_value_is_frozen(reloaded));
+
+    size_t reused = 0;
+    for (size_t i = 0; i < sentry_value_get_length(reloaded); i++) {
+        sentry_value_t mod = sentry_value_get_by_index(reloaded, i);
+        for (size_t j = 0; j < sentry_value_get_length(modules); j++) {
+            if (sentry_value_get_by_index(modules, j)._bits == mod._bits) {
+                reused++;
+                break;
+            }
+        }
+    }
+    TEST_CHECK(reused > 0);
+    TEST_CHECK_INT_EQUAL(reused, sentry_value_get_length(reloaded));
+
+    sentry_value_decref(reloaded);
+    sentry_value_decref(modules);
+    sentry__modulefinder_cleanup();
+#endif
+}
+
+#ifdef SENTRY_PLATFORM_LINUX
+static const char *
+find_test_debug_id(sentry_value_t modules)
+{
+    for (size_t i = 0; i < sentry_value_get_length(modules); i++) {
+        sentry_value_t mod = sentry_value_get_by_index(modules, i);
+        const char *name = sentry_value_as_string(
+            sentry_value_get_by_key(mod, "code_file"));
+        if (strstr(name, "sentry_test_unit")) {
+            return sentry_value_as_string(
+                sentry_value_get_by_key(mod, "debug_id"));
+        }
+    }
+    return NULL;
+}
+#endif
+
+SENTRY_TEST(build_id_cache)
+{
+#if !defined(SENTRY_PLATFORM_LINUX)
+    SKIP_TEST();
+#else
+    sentry_path_t *dir = sentry__path_from_str(".build-id-cache");
+    sentry__path_remove_all(dir);
+    TEST_ASSERT(sentry__path_create_dir_all(dir) == 0);
+    sentry_path_t *cache_path = sentry__path_join_str(dir, "build-ids.cache");
+
+    // the first scan fills the cache
+    sentry__modulefinder_cleanup();
+    sentry__modulefinder_set_database_path(dir);
+    sentry_value_t modules = sentry_get_modules_list();
+    const char *debug_id = find_test_debug_id(modules);
+    TEST_CHECK(debug_id && strlen(debug_id) == 36);
+    size_t len = 0;
+    char *contents = sentry__path_read_to_buffer(cache_path, &len);
+    TEST_ASSERT(!!contents);
+    TEST_CHECK(strncmp(contents, "sentry-build-ids 1\n", 19) == 0);
+
+    // replace all the cached debug ids, which the next scan picks up
+    // instead of reading the files
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    char *line = strchr(contents, '\n') + 1;
+    sentry__stringbuilder_append(&sb, "sentry-build-ids 1\n");
+    while (*line) {
+        char *id = line;
+        for (int i = 0; i < 6; i++) {
+            id = strchr(id, ' ') + 1;
+        }
+        sentry__stringbuilder_append_buf(&sb, line, (size_t)(id - line));
+        sentry__stringbuilder_append(
+            &sb, "01234567-89ab-cdef-0123-456789abcdef");
+        line = strchr(id, '\n') + 1;
+        sentry__stringbuilder_append_buf(
+            &sb, id + 36, (size_t)(line - id - 36));
+    }
+    sentry_free(contents);
+    len = sentry__stringbuilder_len(&sb);
+    contents = sentry__stringbuilder_into_string(&sb);
+    TEST_CHECK(sentry__path_write_buffer(cache_path, contents, len) == 0);
+    sentry_free(contents);
+    sentry_value_decref(modules);
+
+    sentry__modulefinder_cleanup();
+    sentry__modulefinder_set_database_path(dir);
+    modules = sentry_get_modules_list();
+    debug_id = find_test_debug_id(modules);
+    TEST_CHECK(debug_id
+        && sentry__string_eq(debug_id, "01234567-89ab-cdef-0123-456789abcdef"));
+    sentry_value_decref(modules);
+
+    // without a database path, nothing is cached
+    sentry__modulefinder_cleanup();
+    modules = sentry_get_modules_list();
+    debug_id = find_test_debug_id(modules);
+    TEST_CHECK(debug_id
+        && !sentry__string_eq(
+            debug_id, "01234567-89ab-cdef-0123-456789abcdef"));
+    sentry_value_decref(modules);
+    sentry__modulefinder_cleanup();
+
+    sentry__path_remove_all(dir);
+    sentry__path_free(cache_path);
+    sentry__path_free(dir);
+#endif
+}
+
+SENTRY_TEST(modules_loaded_after_init)
+{
+#ifdef SENTRY_PLATFORM_DARWIN
+    // the images that dyld reports are kept across `sentry_close`
+    SKIP_TEST();
+#else
+    sentry__modulefinder_cleanup();
+    TEST_CHECK_INT_EQUAL(sentry__modulefinder_get_memory_usage(), 0);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_init(options);
+
+    // the modules are loaded in the background, without asking for them
+    for (int i = 0; i < 500 && !sentry__modulefinder_get_memory_usage(); i++) {
+        sleep_ms(10);
+    }
+    TEST_CHECK(sentry__modulefinder_get_memory_usage() > 0);
+
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(sentry__modulefinder_get_memory_usage(), 0);
+#endif
+}
+
+static void
+check_referenced_images(const sentry_envelope_t *envelope, void *data)
+{
+    int *called = data;
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t images = sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "debug_meta"), "images");
+    if (sentry_value_is_null(sentry_value_get_by_key(event, "exception"))) {
+        // events without a stacktrace do not reference any images
+        TEST_CHECK(sentry_value_is_null(images));
+    } else {
+        TEST_CHECK_INT_EQUAL(sentry_value_get_length(images), 1);
+        const char *name = sentry_value_as_string(sentry_value_get_by_key(
+            sentry_value_get_by_index(images, 0), "code_file"));
+        TEST_CHECK(strstr(name, "sentry_test_unit") != NULL);
+    }
+    *called += 1;
+}
+
+SENTRY_TEST(only_referenced_images)
+{
+    int called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_only_referenced_images(options, true);
+    TEST_CHECK(sentry_options_get_only_referenced_images(options));
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(check_referenced_images, &called));
+    sentry_init(options);
+
+    // there are a lot more modules loaded than just the test executable
+    sentry_value_t modules = sentry_get_modules_list();
+    TEST_CHECK(sentry_value_get_length(modules) > 1);
+    sentry_value_decref(modules);
+
+#ifdef SENTRY_PLATFORM_AIX
+    void *ip = *(void **)&check_referenced_images;
+#else
+    void *ip = (void *)(size_t)&check_referenced_images;
+#endif
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_t exception
+        = sentry_value_new_exception("SIGSEGV", "test exception");
+    sentry_value_set_by_key(
+        exception, "stacktrace", sentry_value_new_stacktrace(&ip, 1));
+    sentry_event_add_exception(event, exception);
+    sentry_capture_event(event);
+
+    sentry_capture_event(sentry_value_new_message_event(
+        SENTRY_LEVEL_INFO, NULL, "without stacktrace"));
+
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(called, 2);
+}
+
+static sentry_value_t
+new_module(const char *code_file, uint64_t image_addr, int32_t image_size)
+{
+    sentry_value_t module = sentry_value_new_object();
+    sentry_value_set_by_key(
+        module, "code_file", sentry_value_new_string(code_file));
+    sentry_value_set_by_key(
+        module, "image_addr", sentry__value_new_addr(image_addr));
+    sentry_value_set_by_key(
+        module, "image_size", sentry_value_new_int32(image_size));
+    return module;
+}
+
+SENTRY_TEST(module_index)
+{
+    sentry_value_t modules = sentry_value_new_list();
+    sentry_value_append(modules, new_module("c", 0x3000, 0x1000));
+    sentry_value_append(modules, new_module("a", 0x1000, 0x800));
+    // modules without an address range are left out
+    sentry_value_append(modules, new_module("empty", 0, 0));
+    sentry_value_append(modules, new_module("b", 0x2000, 0x1000));
+    sentry_value_freeze(modules);
+
+    sentry_module_index_t *index = sentry__module_index_get(modules);
+    TEST_ASSERT(!!index);
+    // the index of the same list is shared
+    sentry_module_index_t *cached = sentry__module_index_get(modules);
+    TEST_CHECK(cached == index);
+    sentry__module_index_decref(cached);
+
+    TEST_CHECK(!sentry__module_index_find(index, 0xfff));
+    const sentry_module_range_t *range
+        = sentry__module_index_find(index, 0x1000);
+    TEST_ASSERT(!!range);
+    TEST_CHECK_INT_EQUAL(range->index, 1);
+    TEST_CHECK(range->start == 0x1000 && range->end == 0x1800);
+    // the gap between the first two modules
+    TEST_CHECK(!sentry__module_index_find(index, 0x1800));
+    TEST_CHECK(!sentry__module_index_find(index, 0x1fff));
+    TEST_CHECK_INT_EQUAL(sentry__module_index_find(index, 0x2fff)->index, 3);
+    TEST_CHECK_INT_EQUAL(sentry__module_index_find(index, 0x3000)->index, 0);
+    TEST_CHECK(!sentry__module_index_find(index, 0x4000));
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(
+            sentry__module_index_find_module(index, 0x2100), "code_file")),
+        "b");
+    TEST_CHECK(
+        sentry_value_is_null(sentry__module_index_find_module(index, 0x10)));
+
+    // the index keeps the list alive
+    sentry_value_decref(modules);
+    TEST_CHECK_INT_EQUAL(sentry__module_index_find(index, 0x3100)->index, 0);
+    sentry__module_index_decref(index);
+
+    TEST_CHECK(!sentry__module_index_get(sentry_value_new_null()));
+    sentry__module_index_cleanup();
+}
+
 SENTRY_TEST(module_addr)
 {
 #if !defined(SENTRY_PLATFORM_LINUX)
@@ -204,3 +480,63 @@ SENTRY_TEST(buildid_fallback)
     sentry__path_free(dir);
 #endif
 }
+
+static int g_minidump_global = 42;
+
+typedef struct {
+    size_t count;
+    size_t total_size;
+    bool has_global;
+} minidump_ranges_t;
+
+static void
+collect_minidump_range(void *start, size_t size, void *data)
+{
+    minidump_ranges_t *ranges = data;
+    ranges->count++;
+    ranges->total_size += size;
+    char *global = (char *)&g_minidump_global;
+    if (global >= (char *)start && global < (char *)start + size) {
+        ranges->has_global = true;
+    }
+}
+
+SENTRY_TEST(minidump_module_ranges)
+{
+#ifdef SENTRY_PLATFORM_AIX
+    SKIP_TEST();
+#else
+    sentry_options_t *options = sentry_options_new();
+    TEST_CHECK_INT_EQUAL(sentry_options_get_minidump_mode(options),
+        SENTRY_MINIDUMP_MODE_STACK_ONLY);
+    minidump_ranges_t ranges = { 0, 0, false };
+    TEST_CHECK_INT_EQUAL(sentry__backend_foreach_minidump_range(
+                             options, collect_minidump_range, &ranges),
+        0);
+    TEST_CHECK_INT_EQUAL(ranges.count, 0);
+
+    sentry_options_add_minidump_module(options, "not-a-module.so");
+#    ifdef SENTRY_PLATFORM_WINDOWS
+    sentry_options_add_minidump_module(options, "SENTRY_TEST_UNIT.EXE");
+#    else
+    sentry_options_add_minidump_module(options, "sentry_test_unit");
+#    endif
+    size_t total_size = sentry__backend_foreach_minidump_range(
+        options, collect_minidump_range, &ranges);
+    TEST_CHECK(ranges.count > 0);
+    TEST_CHECK(ranges.has_global);
+    TEST_CHECK_INT_EQUAL(total_size, ranges.total_size);
+    TEST_CHECK(g_minidump_global == 42);
+
+    // the ranges are truncated to the size limit
+    sentry_options_set_minidump_max_size(options, 16);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_minidump_max_size(options), 16);
+    memset(&ranges, 0, sizeof(ranges));
+    TEST_CHECK_INT_EQUAL(sentry__backend_foreach_minidump_range(
+                             options, collect_minidump_range, &ranges),
+        16);
+    TEST_CHECK_INT_EQUAL(ranges.count, 1);
+
+    sentry_options_free(options);
+#endif
+}
@@ -1,6 +1,7 @@
 #include "sentry_path.h"
 #include "sentry_scope.h"
 #include "sentry_testsupport.h"
+#include "sentry_value.h"
 
 SENTRY_TEST(mpack_removed_tags)
 {
@@ -62,3 +63,77 @@ SENTRY_TEST(mpack_newlines)
     sentry__path_remove(file);
     sentry__path_free(file);
 }
+
+SENTRY_TEST(mpack_reused_buffer)
+{
+    sentry_value_t o = sentry_value_new_object();
+    sentry_value_set_by_key(o, "some prop", sentry_value_new_string("value"));
+    sentry_value_t list = sentry_value_new_list();
+    for (int32_t i = 0; i < 100; i++) {
+        sentry_value_append(list, sentry_value_new_int32(i * 1000));
+    }
+    sentry_value_set_by_key(o, "list", list);
+
+    size_t size;
+    char *buf = sentry_value_to_msgpack(o, &size);
+
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    for (int i = 0; i < 2; i++) {
+        sentry__stringbuilder_set_len(&sb, 0);
+        TEST_CHECK_INT_EQUAL(sentry__value_append_msgpack(&sb, o), 0);
+        TEST_CHECK_INT_EQUAL(sentry__stringbuilder_len(&sb), size);
+        TEST_CHECK(!memcmp(sb.buf, buf, size));
+    }
+
+    sentry__stringbuilder_cleanup(&sb);
+    sentry_value_decref(o);
+    sentry_free(buf);
+}
+
+SENTRY_TEST(mpack_roundtrip)
+{
+    sentry_value_t o = sentry_value_new_object();
+    sentry_value_set_by_key(o, "null", sentry_value_new_null());
+    sentry_value_set_by_key(o, "bool", sentry_value_new_bool(true));
+    sentry_value_set_by_key(o, "int32", sentry_value_new_int32(-1234));
+    sentry_value_set_by_key(o, "int64", sentry_value_new_int64(INT64_MIN));
+    sentry_value_set_by_key(o, "uint64", sentry_value_new_uint64(UINT64_MAX));
+    sentry_value_set_by_key(o, "double", sentry_value_new_double(12.34));
+    sentry_value_set_by_key(
+        o, "string", sentry_value_new_string("lf\ncrlf\r\nlf\n..."));
+    sentry_value_t list = sentry_value_new_list();
+    sentry_value_append(list, sentry_value_new_int32(1));
+    sentry_value_append(list, sentry_value_new_object());
+    sentry_value_append(list, sentry_value_new_list());
+    sentry_value_set_by_key(o, "list", list);
+
+    size_t size;
+    char *buf = sentry_value_to_msgpack(o, &size);
+    sentry_value_t rt = sentry__value_from_msgpack(buf, size);
+
+    char *json = sentry_value_to_json(o);
+    char *json_rt = sentry_value_to_json(rt);
+    TEST_CHECK_STRING_EQUAL(json_rt, json);
+    TEST_CHECK(sentry_value_get_type(sentry_value_get_by_key(rt, "int64"))
+        == SENTRY_VALUE_TYPE_INT64);
+    TEST_CHECK(sentry_value_get_type(sentry_value_get_by_key(rt, "uint64"))
+        == SENTRY_VALUE_TYPE_UINT64);
+    sentry_free(json);
+    sentry_free(json_rt);
+    sentry_value_decref(rt);
+
+    // truncated documents and trailing garbage are rejected
+    for (size_t i = 0; i < size; i++) {
+        TEST_CHECK(sentry_value_is_null(sentry__value_from_msgpack(buf, i)));
+    }
+    char *padded = sentry_malloc(size + 1);
+    memcpy(padded, buf, size);
+    padded[size] = '\0';
+    TEST_CHECK(
+        sentry_value_is_null(sentry__value_from_msgpack(padded, size + 1)));
+    sentry_free(padded);
+
+    sentry_value_decref(o);
+    sentry_free(buf);
+}
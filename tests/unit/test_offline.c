@@ -0,0 +1,172 @@
+#include "sentry_database.h"
+#include "sentry_path.h"
+#include "sentry_string.h"
+#include "sentry_sync.h"
+#include "sentry_testsupport.h"
+
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
+
+#define OFFLINE_DATABASE ".sentry-offline"
+
+typedef struct {
+    volatile long sent;
+    char levels[4][16];
+} uploaded_t;
+
+static void
+record_envelope(const sentry_envelope_t *envelope, void *data)
+{
+    uploaded_t *uploaded = data;
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    long sent = sentry__atomic_fetch(&uploaded->sent);
+    if (sent < 4) {
+        const char *level
+            = sentry_value_as_string(sentry_value_get_by_key(event, "level"));
+        snprintf(uploaded->levels[sent], sizeof(uploaded->levels[sent]), "%s",
+            level);
+    }
+    sentry__atomic_fetch_and_add(&uploaded->sent, 1);
+}
+
+static size_t
+count_backlog(void)
+{
+    sentry_path_t *dir = sentry__path_from_str(
+        OFFLINE_DATABASE "/" SENTRY_OFFLINE_BACKLOG_DIR);
+    sentry_pathiter_t *iter = sentry__path_iter_directory(dir);
+    size_t count = 0;
+    const sentry_path_t *path;
+    while (iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        count += sentry__path_ends_with(path, ".envelope");
+    }
+    sentry__pathiter_free(iter);
+    sentry__path_free(dir);
+    return count;
+}
+
+static bool
+wait_for_uploads(uploaded_t *uploaded, long expected)
+{
+    for (int i = 0; i < 500; i++) {
+        if (sentry__atomic_fetch(&uploaded->sent) >= expected) {
+            return true;
+        }
+        sleep_ms(10);
+    }
+    return false;
+}
+
+static sentry_options_t *
+offline_options(uploaded_t *uploaded)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_database_path(options, OFFLINE_DATABASE);
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(record_envelope, uploaded));
+    return options;
+}
+
+SENTRY_TEST(offline_backlog_uploads_crashes_first)
+{
+    sentry_path_t *database = sentry__path_from_str(OFFLINE_DATABASE);
+    sentry__path_remove_all(database);
+
+    uploaded_t uploaded = { 0 };
+    sentry_init(offline_options(&uploaded));
+    TEST_CHECK(!sentry_is_offline());
+    sentry_set_offline(1);
+    TEST_CHECK(sentry_is_offline());
+
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "older"));
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_FATAL, NULL, "crash"));
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&uploaded.sent), 0);
+    TEST_CHECK_INT_EQUAL(count_backlog(), 2);
+
+    // the crash is uploaded before the older, less important event
+    sentry_set_offline(0);
+    TEST_CHECK(wait_for_uploads(&uploaded, 2));
+    TEST_CHECK_STRING_EQUAL(uploaded.levels[0], "fatal");
+    TEST_CHECK_STRING_EQUAL(uploaded.levels[1], "info");
+    TEST_CHECK_INT_EQUAL(count_backlog(), 0);
+
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_INFO, NULL, "online"));
+    TEST_CHECK(wait_for_uploads(&uploaded, 3));
+    sentry_close();
+
+    sentry__path_remove_all(database);
+    sentry__path_free(database);
+}
+
+SENTRY_TEST(offline_backlog_survives_restart)
+{
+    sentry_path_t *database = sentry__path_from_str(OFFLINE_DATABASE);
+    sentry__path_remove_all(database);
+
+    uploaded_t uploaded = { 0 };
+    sentry_init(offline_options(&uploaded));
+    sentry_set_offline(1);
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "stored"));
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&uploaded.sent), 0);
+    TEST_CHECK_INT_EQUAL(count_backlog(), 1);
+
+    // the next run picks up the backlog once it is online
+    sentry_set_offline(0);
+    sentry_init(offline_options(&uploaded));
+    TEST_CHECK(wait_for_uploads(&uploaded, 1));
+    TEST_CHECK_STRING_EQUAL(uploaded.levels[0], "error");
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(count_backlog(), 0);
+
+    sentry__path_remove_all(database);
+    sentry__path_free(database);
+}
+
+static int
+probe_connectivity(void *closure)
+{
+    return (int)sentry__atomic_fetch((volatile long *)closure);
+}
+
+SENTRY_TEST(offline_connectivity_probe)
+{
+    sentry_path_t *database = sentry__path_from_str(OFFLINE_DATABASE);
+    sentry__path_remove_all(database);
+
+    uploaded_t uploaded = { 0 };
+    volatile long online = 0;
+    sentry_options_t *options = offline_options(&uploaded);
+    sentry_options_set_connectivity_probe(
+        options, probe_connectivity, (void *)&online);
+    sentry_options_set_connectivity_probe_interval(options, 10);
+    sentry_init(options);
+    for (int i = 0; i < 500 && !sentry_is_offline(); i++) {
+        sleep_ms(10);
+    }
+    TEST_CHECK(sentry_is_offline());
+
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "probed"));
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&uploaded.sent), 0);
+
+    sentry__atomic_store(&online, 1);
+    TEST_CHECK(wait_for_uploads(&uploaded, 1));
+    TEST_CHECK(!sentry_is_offline());
+    sentry_close();
+
+    sentry_set_offline(0);
+    sentry__path_remove_all(database);
+    sentry__path_free(database);
+}
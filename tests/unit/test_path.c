@@ -97,6 +97,22 @@ SENTRY_TEST(path_joining_windows)
     TEST_CHECK(_wcsicmp(joined->path, L"C:\\root\\path") == 0);
     sentry__path_free(joined);
 
+    joined = sentry__path_join_str(winpath, "..\\");
+    sentry_path_t *rejoined = sentry__path_join_str(joined, "extra");
+    TEST_CHECK(
+        _wcsicmp(rejoined->path, L"foo\\bar\\baz.txt\\..\\extra") == 0);
+    sentry__path_free(rejoined);
+    sentry__path_free(joined);
+
+    joined = sentry__path_append_str(path, ".tmp");
+    TEST_CHECK(_wcsicmp(joined->path, L"foo/bar/baz.txt.tmp") == 0);
+    sentry__path_free(joined);
+
+    TEST_CHECK(sentry__path_ends_with(winpath, ".TXT"));
+    TEST_CHECK(!sentry__path_ends_with(winpath, "a\\foo\\bar\\baz.txt"));
+    TEST_CHECK(sentry__path_filename_matches(winpath, "BAZ.txt"));
+    TEST_CHECK(!sentry__path_filename_matches(winpath, "baz"));
+
     sentry__path_free(cpath);
     sentry__path_free(awinpath);
     sentry__path_free(winpath);
@@ -117,6 +133,29 @@ SENTRY_TEST(path_relative_filename)
     sentry__path_free(path);
 }
 
+SENTRY_TEST(path_str)
+{
+    sentry_path_t *dir = sentry__path_from_str("foo");
+    sentry_path_t *path =
+#ifdef SENTRY_PLATFORM_WINDOWS
+        sentry__path_join_wstr(dir, L"Юля.txt");
+    const char *expected = "foo\\Юля.txt";
+#else
+        sentry__path_join_str(dir, "Юля.txt");
+    const char *expected = "foo/Юля.txt";
+#endif
+
+    const char *str = sentry__path_str(path);
+    TEST_CHECK_STRING_EQUAL(str, expected);
+    // the string is converted only once
+    TEST_CHECK(sentry__path_str(path) == str);
+    TEST_CHECK_STRING_EQUAL(sentry__path_filename_str(path), "Юля.txt");
+    TEST_CHECK_STRING_EQUAL(sentry__path_filename_str(dir), "foo");
+
+    sentry__path_free(path);
+    sentry__path_free(dir);
+}
+
 SENTRY_TEST(path_basics)
 {
     size_t items = 0;
@@ -196,3 +235,82 @@ SENTRY_TEST(path_directory)
     sentry__path_free(path_1);
     sentry__path_free(path_2);
 }
+
+SENTRY_TEST(path_iter_entries)
+{
+    sentry_path_t *dir = sentry__path_from_str(".sentry-iter");
+    sentry__path_remove_all(dir);
+    sentry_path_t *sub = sentry__path_join_str(dir, "sub");
+    sentry__path_create_dir_all(sub);
+    sentry_path_t *file = sentry__path_join_str(dir, "file.txt");
+    sentry__path_write_buffer(file, "abc", 3);
+    sentry_path_t *nested = sentry__path_join_str(sub, "nested");
+    sentry__path_touch(nested);
+
+    size_t files = 0;
+    size_t dirs = 0;
+    sentry_path_t *clone = NULL;
+    sentry_pathiter_t *piter = sentry__path_iter_directory(dir);
+    const sentry_path_t *p;
+    while ((p = sentry__pathiter_next(piter)) != NULL) {
+        if (sentry__path_filename_matches(p, "file.txt")) {
+            files++;
+            TEST_CHECK(sentry__path_is_file(p));
+            TEST_CHECK(!sentry__path_is_dir(p));
+            TEST_CHECK_INT_EQUAL(sentry__path_get_size(p), 3);
+            size_t len = 0;
+            char *buf = sentry__path_read_to_buffer(p, &len);
+            TEST_CHECK_STRING_EQUAL(buf, "abc");
+            TEST_CHECK_INT_EQUAL(len, 3);
+            sentry_free(buf);
+            clone = sentry__path_clone(p);
+        } else if (sentry__path_filename_matches(p, "sub")) {
+            dirs++;
+            TEST_CHECK(sentry__path_is_dir(p));
+            TEST_CHECK(!sentry__path_is_file(p));
+            // the nested iterator has a buffer of its own
+            sentry_pathiter_t *sub_iter = sentry__path_iter_directory(p);
+            const sentry_path_t *q = sentry__pathiter_next(sub_iter);
+            TEST_CHECK(q && sentry__path_filename_matches(q, "nested"));
+            TEST_CHECK(q && sentry__path_is_file(q));
+            TEST_CHECK(!sentry__pathiter_next(sub_iter));
+            sentry__pathiter_free(sub_iter);
+        }
+        TEST_CHECK_INT_EQUAL(sentry__path_remove_all(p), 0);
+    }
+    sentry__pathiter_free(piter);
+    TEST_CHECK_INT_EQUAL(files, 1);
+    TEST_CHECK_INT_EQUAL(dirs, 1);
+
+    // the entries were removed while iterating, and the clone outlives the
+    // iterator
+    TEST_CHECK(!sentry__path_is_file(file));
+    TEST_CHECK(!sentry__path_is_dir(sub));
+    TEST_CHECK(clone && !sentry__path_is_file(clone));
+    TEST_CHECK(clone && sentry__path_filename_matches(clone, "file.txt"));
+
+    sentry__path_remove_all(dir);
+    sentry__path_free(clone);
+    sentry__path_free(nested);
+    sentry__path_free(file);
+    sentry__path_free(sub);
+    sentry__path_free(dir);
+}
+
+SENTRY_TEST(path_sync)
+{
+    sentry_path_t *dir = sentry__path_from_str(".sentry-sync");
+    sentry__path_remove_all(dir);
+    TEST_CHECK(sentry__path_create_dir_all(dir) == 0);
+    sentry_path_t *file = sentry__path_join_str(dir, "file");
+    TEST_CHECK(sentry__path_write_buffer(file, "data", 4) == 0);
+
+    TEST_CHECK(sentry__path_sync(file) == 0);
+    TEST_CHECK(sentry__path_sync(dir) == 0);
+    sentry__path_remove(file);
+    TEST_CHECK(sentry__path_sync(file) != 0);
+
+    sentry__path_free(file);
+    sentry__path_remove_all(dir);
+    sentry__path_free(dir);
+}
@@ -0,0 +1,122 @@
+#include "sentry_envelope.h"
+#include "sentry_string.h"
+#include "sentry_testsupport.h"
+#include "sentry_utils.h"
+#include "sentry_value.h"
+
+typedef struct {
+    int transactions;
+    int profiles;
+    sentry_value_t profile;
+    char tx_id[37];
+} profile_envelopes_t;
+
+static void
+collect_profile(const sentry_envelope_t *envelope, void *data)
+{
+    profile_envelopes_t *envelopes = data;
+    for (size_t i = 0; i < sentry__envelope_get_item_count(envelope); i++) {
+        const sentry_envelope_item_t *item
+            = sentry__envelope_get_item(envelope, i);
+        const char *type = sentry_value_as_string(
+            sentry__envelope_item_get_header(item, "type"));
+        if (sentry__string_eq(type, "transaction")) {
+            envelopes->transactions++;
+            sentry_value_t event_id = sentry_value_get_by_key(
+                sentry_envelope_get_transaction(envelope), "event_id");
+            snprintf(envelopes->tx_id, sizeof(envelopes->tx_id), "%s",
+                sentry_value_as_string(event_id));
+        } else if (sentry__string_eq(type, "profile")) {
+            envelopes->profiles++;
+            size_t len = 0;
+            const char *payload = sentry__envelope_item_get_payload(item, &len);
+            sentry_value_decref(envelopes->profile);
+            envelopes->profile = sentry__value_from_json(payload, len);
+        }
+    }
+}
+
+TEST_VISIBLE void
+spin_for(uint64_t ms)
+{
+    uint64_t deadline = sentry__monotonic_time() + ms;
+    while (sentry__monotonic_time() < deadline) {
+        // busy waiting, so that the profiled thread is not in a syscall
+    }
+}
+
+SENTRY_TEST(profiled_transaction)
+{
+    profile_envelopes_t envelopes = { 0, 0, sentry_value_new_null(), "" };
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(collect_profile, &envelopes));
+    sentry_options_set_release(options, "test-release");
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_profiles_sample_rate(options, 1.0);
+    sentry_options_set_profiling_interval(options, 5);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_profiling_interval(options), 5);
+    sentry_init(options);
+
+    sentry_transaction_context_t *tx_cxt
+        = sentry_transaction_context_new("profiled", "test");
+    sentry_transaction_t *tx
+        = sentry_transaction_start(tx_cxt, sentry_value_new_null());
+    // only one transaction is profiled at a time
+    tx_cxt = sentry_transaction_context_new("not profiled", "test");
+    sentry_transaction_t *other_tx
+        = sentry_transaction_start(tx_cxt, sentry_value_new_null());
+    spin_for(200);
+    sentry_transaction_finish(other_tx);
+    sentry_transaction_finish(tx);
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(envelopes.transactions, 2);
+#ifdef SENTRY_PLATFORM_LINUX
+    TEST_CHECK_INT_EQUAL(envelopes.profiles, 1);
+    sentry_value_t profile = envelopes.profile;
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(profile, "release")),
+        "test-release");
+    sentry_value_t profile_tx = sentry_value_get_by_key(profile, "transaction");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(profile_tx, "name")),
+        "profiled");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(profile_tx, "id")),
+        envelopes.tx_id);
+
+    sentry_value_t samples = sentry_value_get_by_key(
+        sentry_value_get_by_key(profile, "profile"), "samples");
+    sentry_value_t stacks = sentry_value_get_by_key(
+        sentry_value_get_by_key(profile, "profile"), "stacks");
+    sentry_value_t frames = sentry_value_get_by_key(
+        sentry_value_get_by_key(profile, "profile"), "frames");
+    size_t sample_count = sentry_value_get_length(samples);
+    size_t stack_count = sentry_value_get_length(stacks);
+    size_t frame_count = sentry_value_get_length(frames);
+    TEST_CHECK(sample_count > 1);
+    // the stacks and frames are deduplicated
+    TEST_CHECK(stack_count > 0 && stack_count <= sample_count);
+    TEST_CHECK(frame_count > 0);
+    for (size_t i = 0; i < sample_count; i++) {
+        sentry_value_t sample = sentry_value_get_by_index(samples, i);
+        int32_t stack_id = sentry_value_as_int32(
+            sentry_value_get_by_key(sample, "stack_id"));
+        TEST_CHECK(stack_id >= 0 && (size_t)stack_id < stack_count);
+    }
+    for (size_t i = 0; i < stack_count; i++) {
+        sentry_value_t stack = sentry_value_get_by_index(stacks, i);
+        for (size_t j = 0; j < sentry_value_get_length(stack); j++) {
+            int32_t frame_id
+                = sentry_value_as_int32(sentry_value_get_by_index(stack, j));
+            TEST_CHECK(frame_id >= 0 && (size_t)frame_id < frame_count);
+        }
+    }
+#else
+    TEST_CHECK_INT_EQUAL(envelopes.profiles, 0);
+#endif
+    sentry_value_decref(envelopes.profile);
+}
@@ -34,3 +34,33 @@ SENTRY_TEST(rate_limit_parsing)
 
     sentry__rate_limiter_free(rl);
 }
+
+SENTRY_TEST(token_bucket)
+{
+    sentry_token_bucket_t bucket;
+    sentry__token_bucket_init(&bucket, 2);
+    uint64_t now = bucket.refilled_at;
+
+    // a full bucket allows a burst of `rate` takes
+    TEST_CHECK(sentry__token_bucket_take(&bucket, now));
+    TEST_CHECK(sentry__token_bucket_take(&bucket, now));
+    TEST_CHECK(!sentry__token_bucket_take(&bucket, now));
+
+    // and is refilled by `rate` tokens per second
+    TEST_CHECK(!sentry__token_bucket_take(&bucket, now + 400));
+    TEST_CHECK(sentry__token_bucket_take(&bucket, now + 500));
+    TEST_CHECK(!sentry__token_bucket_take(&bucket, now + 500));
+
+    // but never holds more than `rate` tokens
+    now += 60000;
+    TEST_CHECK(sentry__token_bucket_take(&bucket, now));
+    TEST_CHECK(sentry__token_bucket_take(&bucket, now));
+    TEST_CHECK(!sentry__token_bucket_take(&bucket, now));
+    sentry__token_bucket_cleanup(&bucket);
+
+    sentry__token_bucket_init(&bucket, 0);
+    for (int i = 0; i < 100; i++) {
+        TEST_CHECK(sentry__token_bucket_take(&bucket, now));
+    }
+    sentry__token_bucket_cleanup(&bucket);
+}
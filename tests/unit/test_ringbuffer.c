@@ -0,0 +1,134 @@
+#include "sentry_breadcrumb.h"
+#include "sentry_ringbuffer.h"
+#include "sentry_testsupport.h"
+#include "sentry_value.h"
+
+SENTRY_TEST(ringbuffer_wraps_around)
+{
+    sentry_ringbuffer_t *rb = sentry__ringbuffer_new(3);
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 0);
+    sentry_value_t list = sentry__ringbuffer_to_list(rb);
+    TEST_CHECK_JSON_VALUE(list, "[]");
+    sentry_value_decref(list);
+
+    for (int32_t i = 0; i < 5; i++) {
+        TEST_CHECK(
+            sentry__ringbuffer_append(rb, sentry_value_new_int32(i)) == 0);
+    }
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 3);
+    list = sentry__ringbuffer_to_list(rb);
+    TEST_CHECK_JSON_VALUE(list, "[2,3,4]");
+    sentry_value_decref(list);
+
+    sentry__ringbuffer_append(rb, sentry_value_new_string("five"));
+    list = sentry__ringbuffer_to_list(rb);
+    TEST_CHECK_JSON_VALUE(list, "[3,4,\"five\"]");
+    sentry_value_decref(list);
+
+    sentry__ringbuffer_free(rb);
+}
+
+SENTRY_TEST(ringbuffer_resize)
+{
+    sentry_ringbuffer_t *rb = sentry__ringbuffer_new(4);
+    for (int32_t i = 0; i < 6; i++) {
+        sentry__ringbuffer_append(rb, sentry_value_new_int32(i));
+    }
+
+    sentry__ringbuffer_set_max_size(rb, 6);
+    sentry__ringbuffer_append(rb, sentry_value_new_int32(6));
+    sentry_value_t list = sentry__ringbuffer_to_list(rb);
+    TEST_CHECK_JSON_VALUE(list, "[2,3,4,5,6]");
+    sentry_value_decref(list);
+
+    sentry__ringbuffer_set_max_size(rb, 2);
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 2);
+    list = sentry__ringbuffer_to_list(rb);
+    TEST_CHECK_JSON_VALUE(list, "[5,6]");
+    sentry_value_decref(list);
+
+    sentry__ringbuffer_set_max_size(rb, 0);
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 0);
+    TEST_CHECK(sentry__ringbuffer_append(rb, sentry_value_new_int32(7)) == 1);
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 0);
+
+    sentry__ringbuffer_free(rb);
+}
+
+SENTRY_TEST(ringbuffer_compact_breadcrumbs)
+{
+    sentry_ringbuffer_t *rb = sentry__ringbuffer_new(4);
+
+    sentry_value_t simple = sentry_value_new_object();
+    sentry_value_set_by_key(simple, "timestamp",
+        sentry_value_new_string("2024-01-02T03:04:05.678Z"));
+    sentry_value_set_by_key(simple, "message", sentry_value_new_string("hi"));
+    sentry_value_set_by_key(simple, "type", sentry_value_new_string("http"));
+    sentry_value_set_by_key(simple, "level", sentry_value_new_string("error"));
+    sentry_value_set_by_key(
+        simple, "category", sentry_value_new_string("net"));
+    sentry__ringbuffer_append(rb, simple);
+    size_t compact_usage = sentry__ringbuffer_get_memory_usage(rb);
+
+    // these do not fit into a compact breadcrumb, and are kept as is
+    sentry_value_t with_data = sentry_value_new_breadcrumb(NULL, "data");
+    sentry_value_t data = sentry_value_new_object();
+    sentry_value_set_by_key(data, "k", sentry_value_new_int32(1));
+    sentry_value_set_by_key(with_data, "data", data);
+    sentry__ringbuffer_append(rb, with_data);
+    char long_message[SENTRY_BREADCRUMB_MESSAGE_MAX + 1];
+    memset(long_message, 'x', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    sentry_value_t long_crumb = sentry_value_new_object();
+    sentry_value_set_by_key(
+        long_crumb, "message", sentry_value_new_string(long_message));
+    sentry__ringbuffer_append(rb, long_crumb);
+    sentry_value_t odd_level = sentry_value_new_object();
+    sentry_value_set_by_key(
+        odd_level, "level", sentry_value_new_string("Warning"));
+    sentry__ringbuffer_append(rb, odd_level);
+    TEST_CHECK(sentry__ringbuffer_len(rb) == 4);
+    TEST_CHECK(sentry__ringbuffer_get_memory_usage(rb) > compact_usage);
+
+    sentry_value_t list = sentry__ringbuffer_to_list(rb);
+    sentry_value_t crumb = sentry_value_get_by_index(list, 0);
+    TEST_CHECK_JSON_VALUE(crumb,
+        "{\"timestamp\":\"2024-01-02T03:04:05.678Z\",\"message\":\"hi\","
+        "\"type\":\"http\",\"level\":\"error\",\"category\":\"net\"}");
+    crumb = sentry_value_get_by_index(list, 1);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int32(sentry_value_get_by_key(
+                             sentry_value_get_by_key(crumb, "data"), "k")),
+        1);
+    crumb = sentry_value_get_by_index(list, 2);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(crumb, "message")),
+        long_message);
+    crumb = sentry_value_get_by_index(list, 3);
+    TEST_CHECK_JSON_VALUE(crumb, "{\"level\":\"Warning\"}");
+    sentry_value_decref(list);
+
+    sentry__ringbuffer_free(rb);
+}
+
+SENTRY_TEST(ringbuffer_compact_breadcrumbs_use_less_memory)
+{
+    sentry_ringbuffer_t *compact = sentry__ringbuffer_new(16);
+    sentry_ringbuffer_t *values = sentry__ringbuffer_new(16);
+    for (int i = 0; i < 16; i++) {
+        sentry_value_t crumb = sentry_value_new_breadcrumb("navigation", "go");
+        sentry_value_set_by_key(
+            crumb, "category", sentry_value_new_string("ui.click"));
+        sentry__ringbuffer_append(compact, crumb);
+        // an empty data object keeps the breadcrumb from being compacted
+        crumb = sentry_value_new_breadcrumb("navigation", "go");
+        sentry_value_set_by_key(
+            crumb, "category", sentry_value_new_string("ui.click"));
+        sentry_value_set_by_key(crumb, "data", sentry_value_new_object());
+        sentry__ringbuffer_append(values, crumb);
+    }
+    TEST_CHECK(sentry__ringbuffer_get_memory_usage(compact)
+        < sentry__ringbuffer_get_memory_usage(values));
+
+    sentry__ringbuffer_free(compact);
+    sentry__ringbuffer_free(values);
+}
@@ -0,0 +1,75 @@
+#include "sentry_path.h"
+#include "sentry_ringfile.h"
+#include "sentry_string.h"
+#include "sentry_testsupport.h"
+
+static char *
+read_records(const sentry_ringfile_t *rf)
+{
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    TEST_CHECK(sentry__ringfile_read(rf, &sb) == 0);
+    sentry__stringbuilder_append_char(&sb, '\0');
+    return sentry__stringbuilder_into_string(&sb);
+}
+
+SENTRY_TEST(ringfile_wraps_around)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-ringfile");
+    sentry_ringfile_t *rf = sentry__ringfile_new(path, 3, 4);
+    TEST_ASSERT(!!rf);
+
+    char *records = read_records(rf);
+    TEST_CHECK_STRING_EQUAL(records, "");
+    sentry_free(records);
+
+    TEST_CHECK(sentry__ringfile_append(rf, "a", 1) == 0);
+    TEST_CHECK(sentry__ringfile_append(rf, "bb", 2) == 0);
+    records = read_records(rf);
+    TEST_CHECK_STRING_EQUAL(records, "abb");
+    sentry_free(records);
+
+    TEST_CHECK(sentry__ringfile_append(rf, "ccc", 3) == 0);
+    TEST_CHECK(sentry__ringfile_append(rf, "dddd", 4) == 0);
+    // does not fit into a slot
+    TEST_CHECK(sentry__ringfile_append(rf, "eeeeeeeee", 9) == 1);
+    records = read_records(rf);
+    TEST_CHECK_STRING_EQUAL(records, "bbcccdddd");
+    sentry_free(records);
+
+    sentry__ringfile_free(rf);
+    sentry__path_remove(path);
+    sentry__path_free(path);
+}
+
+SENTRY_TEST(ringfile_survives_on_disk)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-ringfile");
+    sentry_ringfile_t *rf = sentry__ringfile_new(path, 2, 16);
+    TEST_ASSERT(!!rf);
+    sentry__ringfile_append(rf, "hello ", 6);
+    sentry__ringfile_append(rf, "world", 5);
+    sentry__ringfile_free(rf);
+
+    size_t len = 0;
+    char *buf = sentry__path_read_to_buffer(path, &len);
+    TEST_ASSERT(!!buf);
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    TEST_CHECK(sentry__ringfile_parse(buf, len, &sb) == 0);
+    sentry__stringbuilder_append_char(&sb, '\0');
+    char *records = sentry__stringbuilder_into_string(&sb);
+    TEST_CHECK_STRING_EQUAL(records, "hello world");
+    sentry_free(records);
+
+    // a truncated or foreign file is rejected
+    sentry__stringbuilder_init(&sb);
+    TEST_CHECK(sentry__ringfile_parse(buf, len - 1, &sb) == 1);
+    buf[0] = 'X';
+    TEST_CHECK(sentry__ringfile_parse(buf, len, &sb) == 1);
+    sentry__stringbuilder_cleanup(&sb);
+    sentry_free(buf);
+
+    sentry__path_remove(path);
+    sentry__path_free(path);
+}
@@ -1,3 +1,5 @@
+#include "sentry_sampling.h"
+#include "sentry_string.h"
 #include "sentry_testsupport.h"
 #include "sentry_tracing.h"
 
@@ -17,21 +19,108 @@ SENTRY_TEST(sampling_transaction)
         = sentry_transaction_context_new("honk", NULL);
 
     sentry_transaction_context_set_sampled(tx_cxt, 0);
-    TEST_CHECK(sentry__should_send_transaction(tx_cxt->inner) == false);
+    TEST_CHECK(sentry__should_send_transaction(
+                   tx_cxt->inner, sentry_value_new_null())
+        == false);
 
     sentry_transaction_context_set_sampled(tx_cxt, 1);
-    TEST_CHECK(sentry__should_send_transaction(tx_cxt->inner));
+    TEST_CHECK(sentry__should_send_transaction(
+        tx_cxt->inner, sentry_value_new_null()));
 
     // fall back to default in sentry options (0.0) if sampled isn't there
     sentry_transaction_context_remove_sampled(tx_cxt);
-    TEST_CHECK(sentry__should_send_transaction(tx_cxt->inner) == false);
+    TEST_CHECK(sentry__should_send_transaction(
+                   tx_cxt->inner, sentry_value_new_null())
+        == false);
 
     options = sentry_options_new();
     sentry_options_set_traces_sample_rate(options, 1.0);
     TEST_CHECK(sentry_init(options) == 0);
 
-    TEST_CHECK(sentry__should_send_transaction(tx_cxt->inner));
+    TEST_CHECK(sentry__should_send_transaction(
+        tx_cxt->inner, sentry_value_new_null()));
 
     sentry__transaction_context_free(tx_cxt);
     sentry_close();
 }
+
+static double
+sample_by_name(const char *name, const char *operation,
+    sentry_value_t sampling_ctx, void *user_data)
+{
+    int *called = user_data;
+    *called += 1;
+    TEST_CHECK_STRING_EQUAL(operation, "http.server");
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int32(sentry_value_get_by_key(sampling_ctx, "port")),
+        80);
+    return sentry__string_eq(name, "checkout") ? 1.0 : 0.0;
+}
+
+static bool
+start_and_check(const char *name)
+{
+    sentry_transaction_context_t *tx_cxt
+        = sentry_transaction_context_new(name, "http.server");
+    sentry_value_t sampling_ctx = sentry_value_new_object();
+    sentry_value_set_by_key(sampling_ctx, "port", sentry_value_new_int32(80));
+    sentry_transaction_t *tx = sentry_transaction_start(tx_cxt, sampling_ctx);
+    bool sampled
+        = sentry_value_is_true(sentry_value_get_by_key(tx->inner, "sampled"));
+    sentry__transaction_decref(tx);
+    return sampled;
+}
+
+SENTRY_TEST(traces_sampler)
+{
+    int called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_traces_sampler(options, sample_by_name, &called);
+    TEST_CHECK(sentry_init(options) == 0);
+
+    // the sampler takes precedence over the sample rate
+    TEST_CHECK(start_and_check("checkout"));
+    TEST_CHECK(!start_and_check("health"));
+    TEST_CHECK(start_and_check("checkout"));
+    TEST_CHECK_INT_EQUAL(called, 3);
+    sentry_close();
+
+    called = 0;
+    options = sentry_options_new();
+    sentry_options_set_traces_sampler(options, sample_by_name, &called);
+    sentry_options_set_traces_sampler_cache_ttl(options, 60 * 1000);
+    TEST_CHECK(sentry_init(options) == 0);
+
+    // only the first transaction of each name calls the sampler
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(start_and_check("checkout"));
+        TEST_CHECK(!start_and_check("health"));
+    }
+    TEST_CHECK_INT_EQUAL(called, 2);
+    sentry_close();
+}
+
+SENTRY_TEST(sampler_cache)
+{
+    sentry_sampler_cache_t *cache = sentry__sampler_cache_new(100);
+    TEST_ASSERT(!!cache);
+    double rate = -1.0;
+    TEST_CHECK(!sentry__sampler_cache_get(cache, "name", "op", 0, &rate));
+
+    sentry__sampler_cache_put(cache, "name", "op", 1000, 0.5);
+    TEST_CHECK(sentry__sampler_cache_get(cache, "name", "op", 1099, &rate));
+    TEST_CHECK(rate == 0.5);
+    // the name and op are part of the key
+    TEST_CHECK(!sentry__sampler_cache_get(cache, "nameop", "", 1000, &rate));
+    TEST_CHECK(!sentry__sampler_cache_get(cache, "name", NULL, 1000, &rate));
+    // which expires after the ttl
+    TEST_CHECK(!sentry__sampler_cache_get(cache, "name", "op", 1100, &rate));
+
+    sentry__sampler_cache_put(cache, NULL, NULL, 1000, 0.25);
+    TEST_CHECK(sentry__sampler_cache_get(cache, NULL, NULL, 1000, &rate));
+    TEST_CHECK(rate == 0.25);
+    TEST_CHECK(sentry__sampler_cache_get(cache, "", "", 1000, &rate));
+
+    sentry__sampler_cache_free(cache);
+}
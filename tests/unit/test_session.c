@@ -1,8 +1,22 @@
+#include "sentry_database.h"
 #include "sentry_envelope.h"
+#include "sentry_options.h"
+#include "sentry_path.h"
 #include "sentry_session.h"
+#include "sentry_session_aggregator.h"
+#include "sentry_sync.h"
 #include "sentry_testsupport.h"
+#include "sentry_transport.h"
 #include "sentry_value.h"
 
+#ifdef SENTRY_PLATFORM_WINDOWS
+#    include <windows.h>
+#    define sleep_ms(MSECS) Sleep(MSECS)
+#else
+#    include <unistd.h>
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
+#endif
+
 static void
 send_envelope(const sentry_envelope_t *envelope, void *data)
 {
@@ -150,3 +164,230 @@ SENTRY_TEST(count_sampled_events)
 
     TEST_CHECK_INT_EQUAL(assertion.called, 1);
 }
+
+static void
+discard_envelope(const sentry_envelope_t *UNUSED(envelope), void *UNUSED(data))
+{
+}
+
+static uint64_t
+persisted_errors(void)
+{
+    uint64_t errors = UINT64_MAX;
+    SENTRY_WITH_OPTIONS (options) {
+        sentry_session_t *session
+            = sentry__session_from_path(options->run->session_path);
+        if (session) {
+            errors = session->errors;
+            sentry__session_free(session);
+        }
+    }
+    return errors;
+}
+
+static void
+capture_errors(int count)
+{
+    for (int i = 0; i < count; i++) {
+        sentry_capture_event(
+            sentry_value_new_message_event(SENTRY_LEVEL_ERROR, NULL, "foo"));
+    }
+}
+
+SENTRY_TEST(session_persistence_is_coalesced)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_database_path(options, ".sentry-native-session");
+    sentry_options_set_release(options, "my_release");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(discard_envelope, NULL));
+    TEST_CHECK_INT_EQUAL(sentry_options_get_session_persist_interval(options),
+        SENTRY_DEFAULT_SESSION_PERSIST_INTERVAL);
+    sentry_options_set_session_persist_interval(options, 60 * 1000);
+    sentry_init(options);
+
+    // only the start of the session was written so far
+    capture_errors(50);
+    TEST_CHECK_INT_EQUAL(persisted_errors(), 0);
+    // stopping the persister writes the dirty session
+    sentry__session_persister_stop();
+    TEST_CHECK_INT_EQUAL(persisted_errors(), 50);
+    // without the persister, every change is written right away
+    capture_errors(1);
+    TEST_CHECK_INT_EQUAL(persisted_errors(), 51);
+    sentry_close();
+
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_database_path(options, ".sentry-native-session");
+    sentry_options_set_release(options, "my_release");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(discard_envelope, NULL));
+    sentry_options_set_session_persist_interval(options, 10);
+    sentry_init(options);
+
+    capture_errors(20);
+    uint64_t deadline = sentry__monotonic_time() + 5000;
+    while (persisted_errors() != 20 && sentry__monotonic_time() < deadline) {
+        sleep_ms(1);
+    }
+    TEST_CHECK_INT_EQUAL(persisted_errors(), 20);
+    sentry_close();
+
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-session");
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+SENTRY_TEST(session_persisted_on_transport_worker)
+{
+    sentry_options_t *options = sentry_options_new();
+    // nothing listens there, so the events are rejected right away
+    sentry_options_set_dsn(options, "http://foo@127.0.0.1:1/42");
+    sentry_options_set_database_path(options, ".sentry-native-session");
+    sentry_options_set_release(options, "my_release");
+    sentry_options_set_session_persist_interval(options, 10);
+    sentry_init(options);
+
+    bool has_worker = false;
+    SENTRY_WITH_OPTIONS (opts) {
+        has_worker = sentry__transport_get_bgworker(opts->transport) != NULL;
+    }
+    if (has_worker) {
+        capture_errors(20);
+        uint64_t deadline = sentry__monotonic_time() + 5000;
+        while (
+            persisted_errors() != 20 && sentry__monotonic_time() < deadline) {
+            sleep_ms(1);
+        }
+        TEST_CHECK_INT_EQUAL(persisted_errors(), 20);
+    }
+    sentry_close();
+
+    sentry_path_t *database_path
+        = sentry__path_from_str(".sentry-native-session");
+    sentry__path_remove_all(database_path);
+    sentry__path_free(database_path);
+}
+
+typedef struct {
+    uint64_t called;
+    int64_t exited;
+    int64_t errored;
+    int64_t crashed;
+    int64_t anonymous;
+} aggregate_counts_t;
+
+static int64_t
+aggregate_count(sentry_value_t aggregate, const char *status)
+{
+    // statuses without any sessions are left out
+    sentry_value_t count = sentry_value_get_by_key(aggregate, status);
+    return sentry_value_is_null(count) ? 0
+                                       : (int64_t)sentry_value_as_double(count);
+}
+
+static void
+count_aggregates(const sentry_envelope_t *envelope, void *data)
+{
+    aggregate_counts_t *counts = data;
+    counts->called += 1;
+
+    TEST_CHECK_INT_EQUAL(sentry__envelope_get_item_count(envelope), 1);
+    const sentry_envelope_item_t *item = sentry__envelope_get_item(envelope, 0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry__envelope_item_get_header(item, "type")),
+        "sessions");
+
+    size_t buf_len;
+    const char *buf = sentry__envelope_item_get_payload(item, &buf_len);
+    sentry_value_t sessions = sentry__value_from_json(buf, buf_len);
+    sentry_value_t attrs = sentry_value_get_by_key(sessions, "attrs");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(attrs, "release")),
+        "my_release");
+
+    sentry_value_t aggregates = sentry_value_get_by_key(sessions, "aggregates");
+    for (size_t i = 0; i < sentry_value_get_length(aggregates); i++) {
+        sentry_value_t aggregate = sentry_value_get_by_index(aggregates, i);
+        sentry_value_t started = sentry_value_get_by_key(aggregate, "started");
+        TEST_CHECK_INT_EQUAL(
+            sentry_value_get_type(started), SENTRY_VALUE_TYPE_STRING);
+        const char *did = sentry_value_as_string(
+            sentry_value_get_by_key(aggregate, "did"));
+        int64_t exited = aggregate_count(aggregate, "exited");
+        if (!*did) {
+            counts->anonymous += exited;
+            continue;
+        }
+        TEST_CHECK_STRING_EQUAL(did, "some-user");
+        counts->exited += exited;
+        counts->errored += aggregate_count(aggregate, "errored");
+        counts->crashed += aggregate_count(aggregate, "crashed");
+    }
+    sentry_value_decref(sessions);
+}
+
+SENTRY_THREAD_FN
+record_request_sessions(void *UNUSED(data))
+{
+    for (int i = 0; i < 1000; i++) {
+        sentry_record_request_session(
+            SENTRY_REQUEST_SESSION_EXITED, "some-user");
+    }
+    return 0;
+}
+
+SENTRY_TEST(session_aggregates)
+{
+    aggregate_counts_t counts = { 0, 0, 0, 0, 0 };
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(count_aggregates, &counts));
+    sentry_options_set_release(options, "my_release");
+    TEST_CHECK_INT_EQUAL(sentry_options_get_session_mode(options),
+        SENTRY_SESSION_MODE_APPLICATION);
+    sentry_options_set_session_mode(options, SENTRY_SESSION_MODE_REQUEST);
+    sentry_init(options);
+
+    for (int i = 0; i < 30; i++) {
+        sentry_record_request_session(
+            SENTRY_REQUEST_SESSION_EXITED, "some-user");
+    }
+    sentry_record_request_session(SENTRY_REQUEST_SESSION_ERRORED, "some-user");
+    sentry_record_request_session(SENTRY_REQUEST_SESSION_CRASHED, "some-user");
+    sentry_record_request_session(SENTRY_REQUEST_SESSION_EXITED, NULL);
+    sentry__session_aggregator_flush();
+    TEST_CHECK_INT_EQUAL(counts.called, 1);
+    counts.called = 0;
+
+    // requests on other threads are counted while flushing concurrently
+    sentry_threadid_t threads[4];
+    for (size_t i = 0; i < 4; i++) {
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &record_request_sessions, NULL);
+    }
+    for (int i = 0; i < 10; i++) {
+        sentry__session_aggregator_flush();
+    }
+    for (size_t i = 0; i < 4; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+    // the rest is sent when closing
+    sentry_close();
+
+    // no application session was started, and all the envelopes have
+    // aggregates
+    TEST_CHECK(counts.called >= 1);
+    TEST_CHECK_INT_EQUAL(counts.exited, 30 + 4 * 1000);
+    TEST_CHECK_INT_EQUAL(counts.errored, 1);
+    TEST_CHECK_INT_EQUAL(counts.crashed, 1);
+    TEST_CHECK_INT_EQUAL(counts.anonymous, 1);
+
+    // without aggregating, recording does nothing
+    sentry_record_request_session(SENTRY_REQUEST_SESSION_EXITED, "some-user");
+}
@@ -0,0 +1,130 @@
+#include "sentry_envelope.h"
+#include "sentry_path.h"
+#include "sentry_sidecar.h"
+#include "sentry_string.h"
+#include "sentry_testsupport.h"
+
+#define SIDECAR_DIR ".sentry-sidecar"
+
+static size_t
+count_rings(void)
+{
+    sentry_path_t *dir = sentry__path_from_str(SIDECAR_DIR);
+    sentry_pathiter_t *iter = sentry__path_iter_directory(dir);
+    size_t count = 0;
+    const sentry_path_t *path;
+    while (iter && (path = sentry__pathiter_next(iter)) != NULL) {
+        count += sentry__path_ends_with(path, "." SENTRY_SIDECAR_RING_EXT);
+    }
+    sentry__pathiter_free(iter);
+    sentry__path_free(dir);
+    return count;
+}
+
+SENTRY_TEST(sidecar_ring_wraps_around)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-sidecar-ring");
+    sentry_sidecar_ring_t *producer = sentry__sidecar_ring_new(path, 24);
+    TEST_ASSERT(!!producer);
+    TEST_CHECK(sentry__sidecar_ring_is_own(producer));
+    sentry_sidecar_ring_t *consumer = sentry__sidecar_ring_open(path);
+    TEST_ASSERT(!!consumer);
+    TEST_CHECK(!sentry__sidecar_ring_is_orphaned(consumer));
+
+    sentry_stringbuilder_t record;
+    sentry__stringbuilder_init(&record);
+    TEST_CHECK(sentry__sidecar_ring_pop(consumer, &record) == 1);
+
+    TEST_CHECK(sentry__sidecar_ring_push(producer, "hello", 5) == 0);
+    TEST_CHECK(sentry__sidecar_ring_push(producer, "world", 5) == 0);
+    TEST_CHECK_INT_EQUAL(sentry__sidecar_ring_pending(consumer), 18);
+    // 4 more bytes are needed for the length of the record
+    TEST_CHECK(sentry__sidecar_ring_push(producer, "!!!", 3) == 1);
+    TEST_CHECK_INT_EQUAL(sentry__sidecar_ring_dropped(consumer), 1);
+
+    TEST_CHECK(sentry__sidecar_ring_pop(consumer, &record) == 0);
+    TEST_CHECK_STRING_EQUAL(record.buf, "hello");
+    // this record wraps around the end of the ring
+    TEST_CHECK(sentry__sidecar_ring_push(producer, "abcdef", 6) == 0);
+    TEST_CHECK(sentry__sidecar_ring_pop(consumer, &record) == 0);
+    TEST_CHECK_STRING_EQUAL(record.buf, "world");
+    TEST_CHECK(sentry__sidecar_ring_pop(consumer, &record) == 0);
+    TEST_CHECK_STRING_EQUAL(record.buf, "abcdef");
+    TEST_CHECK(sentry__sidecar_ring_pop(consumer, &record) == 1);
+    TEST_CHECK_INT_EQUAL(sentry__sidecar_ring_pending(consumer), 0);
+
+    // the consumer picks up that the producer is gone
+    sentry__sidecar_ring_free(producer);
+    TEST_CHECK(sentry__sidecar_ring_is_orphaned(consumer));
+
+    sentry__stringbuilder_cleanup(&record);
+    sentry__sidecar_ring_free(consumer);
+    sentry__path_remove(path);
+    sentry__path_free(path);
+}
+
+SENTRY_TEST(sidecar_ring_rejects_invalid_files)
+{
+    sentry_path_t *path = sentry__path_from_str(".sentry-sidecar-ring");
+    TEST_CHECK(!sentry__sidecar_ring_new(path, 0));
+
+    const char *content = "not a sidecar ring, but long enough to have a "
+                          "header of the right size";
+    sentry__path_write_buffer(path, content, strlen(content));
+    TEST_CHECK(!sentry__sidecar_ring_open(path));
+    sentry__path_remove(path);
+    TEST_CHECK(!sentry__sidecar_ring_open(path));
+    sentry__path_free(path);
+}
+
+static void
+count_envelope(const sentry_envelope_t *envelope, void *data)
+{
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    const char *message = sentry_value_as_string(sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "message"), "formatted"));
+    if (sentry__string_eq(message, "handed over")) {
+        *(uint64_t *)data += 1;
+    }
+}
+
+SENTRY_TEST(sidecar_transport_hands_over_envelopes)
+{
+    sentry_path_t *dir = sentry__path_from_str(SIDECAR_DIR);
+    sentry__path_remove_all(dir);
+
+    // the uploader is not initialized yet
+    TEST_CHECK(sentry_sidecar_drain(SIDECAR_DIR) == -1);
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_transport(
+        options, sentry_new_sidecar_transport(SIDECAR_DIR, 0));
+    sentry_init(options);
+    TEST_CHECK_INT_EQUAL(count_rings(), 1);
+    for (int i = 0; i < 3; i++) {
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_INFO, NULL, "handed over"));
+    }
+    sentry_close();
+    // the envelopes stay in the ring until the uploader sent them
+    TEST_CHECK_INT_EQUAL(count_rings(), 1);
+
+    uint64_t sent = 0;
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_auto_session_tracking(options, false);
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(count_envelope, &sent));
+    sentry_init(options);
+    TEST_CHECK_INT_EQUAL(sentry_sidecar_drain(SIDECAR_DIR), 3);
+    TEST_CHECK_INT_EQUAL(sent, 3);
+    TEST_CHECK_INT_EQUAL(count_rings(), 0);
+    TEST_CHECK_INT_EQUAL(sentry_sidecar_drain(SIDECAR_DIR), 0);
+    TEST_CHECK(sentry_sidecar_drain(SIDECAR_DIR "-missing") == -1);
+    sentry_close();
+
+    sentry__path_remove_all(dir);
+    sentry__path_free(dir);
+}
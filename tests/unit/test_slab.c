@@ -0,0 +1,81 @@
+#include "sentry_sync.h"
+#include "sentry_testsupport.h"
+
+#ifdef SENTRY_WITH_VALUE_SLABS
+#    include "sentry_slab.h"
+
+SENTRY_THREAD_FN
+build_values(void *data)
+{
+    sentry_value_t *list = data;
+    *list = sentry_value_new_list();
+    for (int i = 0; i < 1000; i++) {
+        sentry_value_t obj = sentry_value_new_object();
+        sentry_value_set_by_key(obj, "i", sentry_value_new_int32(i));
+        sentry_value_set_by_key(obj, "s", sentry_value_new_string("value"));
+        sentry_value_append(*list, obj);
+    }
+    return 0;
+}
+
+SENTRY_THREAD_FN
+free_values(void *data)
+{
+    sentry_value_decref(*(sentry_value_t *)data);
+    return 0;
+}
+#endif
+
+SENTRY_TEST(slab_reuse)
+{
+#ifndef SENTRY_WITH_VALUE_SLABS
+    SKIP_TEST();
+#else
+    void *small = sentry__slab_alloc(24);
+    TEST_CHECK((uintptr_t)small % 8 == 0);
+    sentry__slab_free(small);
+    // freed blocks are reused right away
+    void *again = sentry__slab_alloc(20);
+    TEST_CHECK(again == small);
+    sentry__slab_free(again);
+
+    // large blocks come from the system allocator
+    char *large = sentry__slab_alloc(4096);
+    TEST_CHECK((uintptr_t)large % 8 == 0);
+    memset(large, 0, 4096);
+    sentry__slab_free(large);
+    sentry__slab_free(NULL);
+#endif
+}
+
+SENTRY_TEST(slab_cross_thread)
+{
+#ifndef SENTRY_WITH_VALUE_SLABS
+    SKIP_TEST();
+#else
+    // values of a thread that has exited are freed on another thread
+    sentry_value_t list = sentry_value_new_null();
+    sentry_threadid_t thread;
+    sentry__thread_init(&thread);
+    sentry__thread_spawn(&thread, &build_values, &list);
+    sentry__thread_join(thread);
+    sentry__thread_free(&thread);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(list), 1000);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int32(sentry_value_get_by_key(
+            sentry_value_get_by_index(list, 999), "i")),
+        999);
+    sentry_value_decref(list);
+
+    // and values of this thread are handed back from another thread
+    build_values(&list);
+    sentry__thread_init(&thread);
+    sentry__thread_spawn(&thread, &free_values, &list);
+    sentry__thread_join(thread);
+    sentry__thread_free(&thread);
+    // which are picked up again once the free lists run dry
+    build_values(&list);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(list), 1000);
+    sentry_value_decref(list);
+#endif
+}
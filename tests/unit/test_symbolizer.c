@@ -1,5 +1,6 @@
 #include "sentry_symbolizer.h"
 #include "sentry_testsupport.h"
+#include "sentry_value.h"
 
 TEST_VISIBLE void
 test_function(void)
@@ -39,3 +40,198 @@ SENTRY_TEST(symbolizer)
 #endif
     TEST_CHECK_INT_EQUAL(called, 1);
 }
+
+static void
+remember_symbol(const sentry_frame_info_t *info, void *data)
+{
+    int called = 0;
+    asserter(info, &called);
+    *(const char **)data = info->symbol;
+}
+
+SENTRY_TEST(symbolizer_cache)
+{
+#ifdef SENTRY_PLATFORM_AIX
+    void *addr = ((char *)*(void **)&test_function) + 1;
+#else
+    void *addr = ((char *)(void *)&test_function) + 1;
+#endif
+    // the cache hands out its own copy of the symbol, so the pointers tell
+    // which of the calls were served from the cache
+    const char *uncached = NULL;
+    TEST_CHECK(sentry__symbolize_uncached(addr, remember_symbol, &uncached));
+
+    sentry__symbolizer_clear_cache();
+    const char *first = NULL;
+    const char *second = NULL;
+    const char *third = NULL;
+    TEST_CHECK(sentry__symbolize(addr, remember_symbol, &first));
+    TEST_CHECK(sentry__symbolize(addr, remember_symbol, &second));
+    TEST_CHECK(sentry__symbolize(addr, remember_symbol, &third));
+    TEST_CHECK(second != first);
+    TEST_CHECK(third == second);
+
+    // clearing the module cache invalidates the symbols as well
+    sentry_clear_modulecache();
+    const char *fourth = NULL;
+    TEST_CHECK(sentry__symbolize(addr, remember_symbol, &fourth));
+    TEST_CHECK(fourth != second);
+    sentry__symbolizer_clear_cache();
+}
+
+static void
+record_index(const sentry_frame_info_t *info, size_t index, void *data)
+{
+    void **seen = data;
+    TEST_CHECK(info->symbol && strstr(info->symbol, "test_function") != 0);
+    seen[index] = info->instruction_addr;
+}
+
+static void
+symbolize_batch(void)
+{
+    char *base = (char *)(void *)&test_function;
+#ifdef SENTRY_PLATFORM_AIX
+    base = (char *)*(void **)&test_function;
+#endif
+    void *addrs[] = { base + 2, base + 1, NULL, base + 2, base + 1 };
+    void *seen[5] = { 0 };
+    TEST_CHECK_INT_EQUAL(
+        sentry__symbolize_many(addrs, 5, record_index, seen), 4);
+    TEST_CHECK(seen[0] == base + 2);
+    TEST_CHECK(seen[1] == base + 1);
+    TEST_CHECK(seen[2] == NULL);
+    TEST_CHECK(seen[3] == base + 2);
+    TEST_CHECK(seen[4] == base + 1);
+}
+
+SENTRY_TEST(symbolizer_batch)
+{
+    // once filling the cache, and once served from it
+    sentry__symbolizer_clear_cache();
+    symbolize_batch();
+    symbolize_batch();
+    sentry__symbolizer_clear_cache();
+}
+
+static sentry_value_t
+first_exception_frame(sentry_value_t event)
+{
+    return sentry_value_get_by_index(
+        sentry_value_get_by_key(
+            sentry_value_get_by_key(
+                sentry_value_get_by_index(
+                    sentry_value_get_by_key(
+                        sentry_value_get_by_key(event, "exception"), "values"),
+                    0),
+                "stacktrace"),
+            "frames"),
+        0);
+}
+
+static void
+check_deferred_symbolization(const sentry_envelope_t *envelope, void *data)
+{
+    int *called = data;
+    *called += 1;
+
+    // the event is only symbolized once it is serialized
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t frame = first_exception_frame(event);
+    TEST_CHECK(!sentry_value_is_null(frame));
+    TEST_CHECK(
+        sentry_value_is_null(sentry_value_get_by_key(frame, "function")));
+
+    size_t len = 0;
+    char *serialized = sentry_envelope_serialize(envelope, &len);
+    TEST_CHECK(serialized && strstr(serialized, "test_function") != 0);
+    sentry_free(serialized);
+    // the interned frames were swapped for their symbolized copy
+    TEST_CHECK(!sentry_value_is_null(
+        sentry_value_get_by_key(first_exception_frame(event), "function")));
+}
+
+SENTRY_TEST(symbolize_when_serializing)
+{
+    int called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_symbolize_stacktraces(options, true);
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(check_deferred_symbolization, &called));
+    sentry_init(options);
+
+#ifdef SENTRY_PLATFORM_AIX
+    void *ip = ((char *)*(void **)&test_function) + 1;
+#else
+    void *ip = ((char *)(void *)&test_function) + 1;
+#endif
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_t exception
+        = sentry_value_new_exception("SIGSEGV", "test exception");
+    sentry_value_set_by_key(
+        exception, "stacktrace", sentry_value_new_stacktrace(&ip, 1));
+    sentry_event_add_exception(event, exception);
+    sentry_capture_event(event);
+
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(called, 1);
+}
+
+SENTRY_TEST(stacktrace_interning)
+{
+    sentry__symbolizer_clear_cache();
+
+    void *ips[2] = { ((char *)(void *)&test_function) + 1, NULL };
+#ifdef SENTRY_PLATFORM_AIX
+    ips[0] = ((char *)*(void **)&test_function) + 1;
+#endif
+    ips[1] = (char *)ips[0] + 1;
+
+    sentry_value_t stacktrace1 = sentry_value_new_stacktrace(ips, 2);
+    sentry_value_t stacktrace2 = sentry_value_new_stacktrace(ips, 2);
+    sentry_value_t stacktrace3 = sentry_value_new_stacktrace(ips, 1);
+    sentry_value_t frames1 = sentry_value_get_by_key(stacktrace1, "frames");
+    sentry_value_t frames2 = sentry_value_get_by_key(stacktrace2, "frames");
+    sentry_value_t frames3 = sentry_value_get_by_key(stacktrace3, "frames");
+
+    // the same stack shares its frames, while the stacktrace itself can
+    // still be modified
+    TEST_CHECK(frames1._bits == frames2._bits);
+    TEST_CHECK(frames1._bits != frames3._bits);
+    TEST_CHECK(sentry_value_is_frozen(frames1));
+    TEST_CHECK(!sentry_value_is_frozen(stacktrace1));
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(frames1), 2);
+    TEST_CHECK(sentry__value_as_addr(sentry_value_get_by_key(
+                   sentry_value_get_by_index(frames1, 1), "instruction_addr"))
+        == (uint64_t)(size_t)ips[0]);
+
+    sentry_value_t symbolized1 = sentry__symbolizer_symbolize_frames(frames1);
+    sentry_value_t symbolized2 = sentry__symbolizer_symbolize_frames(frames2);
+    TEST_CHECK(symbolized1._bits == symbolized2._bits);
+    TEST_CHECK(sentry_value_is_frozen(symbolized1));
+    const char *function = sentry_value_as_string(sentry_value_get_by_key(
+        sentry_value_get_by_index(symbolized1, 1), "function"));
+    TEST_CHECK(function && strstr(function, "test_function") != NULL);
+
+    // other frames are left alone
+    sentry_value_t other = sentry_value_new_list();
+    sentry_value_append(other, sentry_value_new_object());
+    TEST_CHECK(
+        sentry_value_is_null(sentry__symbolizer_symbolize_frames(other)));
+    sentry_value_decref(other);
+
+    sentry__symbolizer_clear_cache();
+    sentry_value_t stacktrace4 = sentry_value_new_stacktrace(ips, 2);
+    TEST_CHECK(
+        sentry_value_get_by_key(stacktrace4, "frames")._bits != frames1._bits);
+
+    sentry_value_decref(symbolized1);
+    sentry_value_decref(symbolized2);
+    sentry_value_decref(stacktrace1);
+    sentry_value_decref(stacktrace2);
+    sentry_value_decref(stacktrace3);
+    sentry_value_decref(stacktrace4);
+    sentry__symbolizer_clear_cache();
+}
@@ -1,13 +1,16 @@
 #include "sentry_core.h"
 #include "sentry_sync.h"
 #include "sentry_testsupport.h"
+#include "sentry_utils.h"
 
 #ifdef SENTRY_PLATFORM_WINDOWS
 #    include <windows.h>
 #    define sleep_s(SECONDS) Sleep((SECONDS)*1000)
+#    define sleep_ms(MSECS) Sleep(MSECS)
 #else
 #    include <unistd.h>
 #    define sleep_s(SECONDS) sleep(SECONDS)
+#    define sleep_ms(MSECS) usleep((MSECS)*1000)
 #endif
 
 struct task_state {
@@ -151,3 +154,383 @@ SENTRY_TEST(bgworker_flush)
     TEST_CHECK_INT_EQUAL(shutdown, 0);
     sentry__bgworker_decref(bgw);
 }
+
+static bool
+can_drop_odd(void *task_data)
+{
+    return (size_t)task_data % 2;
+}
+
+SENTRY_TEST(bgworker_bounded_queue)
+{
+    sentry_bgworker_t *bgw = sentry__bgworker_new(NULL, NULL);
+    sentry__bgworker_set_queue_limits(bgw, 4, 100, can_drop_odd);
+
+    // the first task is never overtaken nor dropped, as it might be executing
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)1, SENTRY_TASK_PRIORITY_LOW, 10),
+        0);
+    sentry__bgworker_submit_bounded(
+        bgw, sleep_task, NULL, (void *)3, SENTRY_TASK_PRIORITY_LOW, 10);
+    sentry__bgworker_submit_bounded(
+        bgw, sleep_task, NULL, (void *)5, SENTRY_TASK_PRIORITY_NORMAL, 10);
+    sentry__bgworker_submit_bounded(
+        bgw, sleep_task, NULL, (void *)7, SENTRY_TASK_PRIORITY_HIGH, 10);
+
+    // a full queue drops the oldest task of the lowest priority
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)9, SENTRY_TASK_PRIORITY_NORMAL, 10),
+        0);
+    TEST_CHECK_INT_EQUAL(
+        sentry__bgworker_get_dropped(bgw, SENTRY_TASK_PRIORITY_LOW), 1);
+
+    // or the new task, if everything else has a higher priority
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)11, SENTRY_TASK_PRIORITY_LOW, 10),
+        1);
+    TEST_CHECK_INT_EQUAL(
+        sentry__bgworker_get_dropped(bgw, SENTRY_TASK_PRIORITY_LOW), 2);
+
+    // tasks that can not be dropped are skipped
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)2, SENTRY_TASK_PRIORITY_HIGH, 10),
+        0);
+    TEST_CHECK_INT_EQUAL(
+        sentry__bgworker_get_dropped(bgw, SENTRY_TASK_PRIORITY_NORMAL), 1);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)13, SENTRY_TASK_PRIORITY_HIGH, 10),
+        0);
+    TEST_CHECK_INT_EQUAL(
+        sentry__bgworker_get_dropped(bgw, SENTRY_TASK_PRIORITY_NORMAL), 2);
+
+    // and the size limit applies as well
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)15, SENTRY_TASK_PRIORITY_HIGH, 101),
+        1);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_bounded(bgw, sleep_task, NULL,
+                             (void *)17, SENTRY_TASK_PRIORITY_HIGH, 80),
+        0);
+    TEST_CHECK_INT_EQUAL(
+        sentry__bgworker_get_dropped(bgw, SENTRY_TASK_PRIORITY_HIGH), 3);
+
+    // unbounded tasks are always appended
+    sentry__bgworker_submit(bgw, sleep_task, NULL, (void *)19);
+
+    sentry_value_t list = sentry_value_new_list();
+    sentry__bgworker_foreach_matching(bgw, sleep_task, collect, &list);
+    TEST_CHECK_JSON_VALUE(list, "[1,2,17,19]");
+    sentry_value_decref(list);
+
+    sentry__bgworker_decref(bgw);
+}
+
+static void
+record_task(void *data, void *state)
+{
+    sentry_value_append(*(sentry_value_t *)state,
+        sentry_value_new_int32((int32_t)(size_t)data));
+}
+
+static bool
+count_task(void *UNUSED(task), void *data)
+{
+    (*(size_t *)data)++;
+    return false;
+}
+
+SENTRY_TEST(bgworker_delayed_tasks)
+{
+    sentry_value_t list = sentry_value_new_list();
+    sentry_bgworker_t *bgw = sentry__bgworker_new(&list, NULL);
+    sentry__bgworker_submit_delayed(
+        bgw, record_task, NULL, (void *)3, 400, NULL);
+    sentry__bgworker_submit_delayed(
+        bgw, record_task, NULL, (void *)2, 200, NULL);
+    sentry__bgworker_submit(bgw, record_task, NULL, (void *)1);
+    size_t count = 0;
+    sentry__bgworker_foreach_matching(bgw, record_task, count_task, &count);
+    TEST_CHECK_INT_EQUAL(count, 3);
+
+    sentry__bgworker_start(bgw);
+    // delayed tasks are not executed before they are due, and a flush only
+    // waits for the ones that are due before its timeout
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 100), 0);
+    TEST_CHECK_JSON_VALUE(list, "[1]");
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 1000), 0);
+    TEST_CHECK_JSON_VALUE(list, "[1,2,3]");
+
+    // and do not keep the worker from shutting down
+    sentry__bgworker_submit_delayed(
+        bgw, record_task, NULL, (void *)4, 60000, NULL);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_shutdown(bgw, 1000), 0);
+    sentry__bgworker_decref(bgw);
+    TEST_CHECK_JSON_VALUE(list, "[1,2,3]");
+    sentry_value_decref(list);
+}
+
+struct timer_state {
+    sentry_bgworker_t *bgw;
+    long executed;
+    long cleaned_up;
+    long chained;
+};
+
+static void
+count_timer_task(void *UNUSED(data), void *_state)
+{
+    struct timer_state *state = _state;
+    sentry__atomic_fetch_and_add(&state->executed, 1);
+}
+
+static void
+cleanup_timer_task(void *data)
+{
+    struct timer_state *state = data;
+    sentry__atomic_fetch_and_add(&state->cleaned_up, 1);
+}
+
+static void
+chained_task(void *UNUSED(data), void *_state)
+{
+    struct timer_state *state = _state;
+    sentry__atomic_fetch_and_add(&state->chained, 1);
+}
+
+static void
+chaining_task(void *UNUSED(data), void *_state)
+{
+    struct timer_state *state = _state;
+    sentry__bgworker_submit(state->bgw, chained_task, NULL, NULL);
+}
+
+SENTRY_TEST(bgworker_timers)
+{
+    struct timer_state state;
+    memset(&state, 0, sizeof(state));
+    sentry_bgworker_t *bgw = sentry__bgworker_new(&state, NULL);
+    state.bgw = bgw;
+    sentry__bgworker_start(bgw);
+
+    // periodic tasks are executed repeatedly, and are not waited for by a flush
+    uint64_t periodic_id = 0;
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_submit_periodic(bgw,
+                             count_timer_task, cleanup_timer_task, &state, 100,
+                             &periodic_id),
+        0);
+    TEST_CHECK(periodic_id != 0);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 5000), 0);
+    sleep_ms(550);
+    long executed = sentry__atomic_fetch(&state.executed);
+    TEST_CHECK(executed >= 3 && executed <= 6);
+    TEST_MSG("executed %ld times", executed);
+
+    // until they are cancelled
+    TEST_CHECK(sentry__bgworker_cancel_timer(bgw, periodic_id));
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 1000), 0);
+    executed = sentry__atomic_fetch(&state.executed);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&state.cleaned_up), 1);
+    sleep_ms(250);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&state.executed), executed);
+    TEST_CHECK(!sentry__bgworker_cancel_timer(bgw, periodic_id));
+
+    // delayed tasks can be cancelled before they are due
+    uint64_t delayed_id = 0;
+    sentry__bgworker_submit_delayed(
+        bgw, count_timer_task, NULL, NULL, 200, &delayed_id);
+    TEST_CHECK(sentry__bgworker_cancel_timer(bgw, delayed_id));
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 1000), 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&state.executed), executed);
+
+    // a flush waits for the tasks that delayed tasks submit in turn
+    sentry__bgworker_submit_delayed(bgw, chaining_task, NULL, NULL, 100, NULL);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 1000), 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&state.chained), 1);
+
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_shutdown(bgw, 1000), 0);
+    sentry__bgworker_decref(bgw);
+}
+
+#define SUBMIT_THREADS 4
+#define SUBMIT_TASKS 1000
+
+struct submit_state {
+    sentry_bgworker_t *bgw;
+    size_t producer;
+};
+
+struct submitted_tasks {
+    size_t last_seen[SUBMIT_THREADS];
+    long executed;
+    bool in_order;
+};
+
+static void
+submitted_task(void *data, void *_state)
+{
+    struct submitted_tasks *state = _state;
+    size_t producer = (size_t)data / SUBMIT_TASKS;
+    size_t seq = (size_t)data % SUBMIT_TASKS + 1;
+    if (seq <= state->last_seen[producer]) {
+        state->in_order = false;
+    }
+    state->last_seen[producer] = seq;
+    sentry__atomic_fetch_and_add(&state->executed, 1);
+}
+
+SENTRY_THREAD_FN
+submit_tasks(void *data)
+{
+    struct submit_state *state = data;
+    for (size_t i = 0; i < SUBMIT_TASKS; i++) {
+        void *task_data = (void *)(state->producer * SUBMIT_TASKS + i);
+        if (i % 2) {
+            sentry__bgworker_submit(
+                state->bgw, submitted_task, NULL, task_data);
+        } else {
+            sentry__bgworker_submit_bounded(state->bgw, submitted_task, NULL,
+                task_data, SENTRY_TASK_PRIORITY_NORMAL, 1);
+        }
+    }
+    return 0;
+}
+
+SENTRY_TEST(bgworker_concurrent_submit)
+{
+    struct submitted_tasks tasks;
+    memset(&tasks, 0, sizeof(tasks));
+    tasks.in_order = true;
+    sentry_bgworker_t *bgw = sentry__bgworker_new(&tasks, NULL);
+    sentry__bgworker_start(bgw);
+
+    struct submit_state states[SUBMIT_THREADS];
+    sentry_threadid_t threads[SUBMIT_THREADS];
+    for (size_t i = 0; i < SUBMIT_THREADS; i++) {
+        states[i].bgw = bgw;
+        states[i].producer = i;
+        sentry__thread_init(&threads[i]);
+        sentry__thread_spawn(&threads[i], &submit_tasks, &states[i]);
+    }
+    for (size_t i = 0; i < SUBMIT_THREADS; i++) {
+        sentry__thread_join(threads[i]);
+        sentry__thread_free(&threads[i]);
+    }
+
+    // every task is executed once, in the order of its producer
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_flush(bgw, 5000), 0);
+    TEST_CHECK_INT_EQUAL(tasks.executed, SUBMIT_THREADS * SUBMIT_TASKS);
+    TEST_CHECK(tasks.in_order);
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_get_queue_depth(bgw), 0);
+
+    TEST_CHECK_INT_EQUAL(sentry__bgworker_shutdown(bgw, 1000), 0);
+    sentry__bgworker_decref(bgw);
+}
+
+SENTRY_TEST(cond_wait_timeout)
+{
+    sentry_mutex_t lock;
+    sentry_cond_t signal;
+    sentry__mutex_init(&lock);
+    sentry__cond_init(&signal);
+
+    // a timed wait without a wakeup lasts (at least) for its timeout
+    sentry__mutex_lock(&lock);
+    uint64_t started = sentry__monotonic_time();
+    sentry__cond_wait_timeout(&signal, &lock, 1100);
+    uint64_t elapsed = sentry__monotonic_time() - started;
+    sentry__mutex_unlock(&lock);
+    TEST_CHECK(elapsed >= 1000);
+    TEST_CHECK(elapsed < 5000);
+
+    sentry__mutex_free(&lock);
+}
+
+#ifdef SENTRY_WITH_LOCK_STATS
+static sentry_mutex_t g_stats_lock = SENTRY__MUTEX_INIT;
+static long g_stats_lock_held = 0;
+
+SENTRY_THREAD_FN
+hold_stats_lock(void *UNUSED(data))
+{
+    sentry__mutex_lock(&g_stats_lock);
+    sentry__atomic_store(&g_stats_lock_held, 1);
+    sleep_ms(30);
+    sentry__mutex_unlock(&g_stats_lock);
+    return 0;
+}
+
+static int64_t
+get_lock_stat(sentry_value_t lock, const char *key)
+{
+    return sentry_value_as_int64(sentry_value_get_by_key(lock, key));
+}
+#endif
+
+SENTRY_TEST(lock_stats)
+{
+#ifdef SENTRY_WITH_LOCK_STATS
+    sentry__mutex_lock(&g_stats_lock);
+    sleep_ms(20);
+    sentry__mutex_unlock(&g_stats_lock);
+
+    // waiting on a condition variable does not count as holding the lock
+    sentry_cond_t signal;
+    sentry__cond_init(&signal);
+    sentry__mutex_lock(&g_stats_lock);
+    sentry__cond_wait_timeout(&signal, &g_stats_lock, 150);
+    sentry__mutex_unlock(&g_stats_lock);
+
+    sentry_threadid_t thread;
+    sentry__thread_init(&thread);
+    sentry__thread_spawn(&thread, hold_stats_lock, NULL);
+    while (!sentry__atomic_fetch(&g_stats_lock_held)) {
+        sleep_ms(1);
+    }
+    sentry__mutex_lock(&g_stats_lock);
+    sentry__mutex_unlock(&g_stats_lock);
+    sentry__thread_join(thread);
+    sentry__thread_free(&thread);
+
+    sentry_value_t stats = sentry_get_stats();
+    sentry_value_t locks = sentry_value_get_by_key(stats, "locks");
+    sentry_value_t lock
+        = sentry_value_get_by_key(locks, "test_sync.c:g_stats_lock");
+    TEST_CHECK_INT_EQUAL(get_lock_stat(lock, "acquisitions"), 4);
+    TEST_CHECK(get_lock_stat(lock, "max_hold_us") >= 15000);
+    TEST_CHECK(get_lock_stat(lock, "max_hold_us") < 150000);
+    TEST_CHECK(get_lock_stat(lock, "max_wait_us") >= 10000);
+    TEST_CHECK(get_lock_stat(lock, "wait_us")
+        >= get_lock_stat(lock, "max_wait_us"));
+
+    sentry_value_t histogram = sentry_value_get_by_key(lock, "wait_histogram");
+    int64_t waits = 0;
+    const char *buckets[] = { "lt_1us", "lt_10us", "lt_100us", "lt_1ms",
+        "lt_10ms", "lt_100ms", "ge_100ms" };
+    for (size_t i = 0; i < sizeof(buckets) / sizeof(buckets[0]); i++) {
+        waits += get_lock_stat(histogram, buckets[i]);
+    }
+    TEST_CHECK_INT_EQUAL(waits, 4);
+    TEST_CHECK(get_lock_stat(histogram, "lt_10ms")
+            + get_lock_stat(histogram, "lt_100ms")
+        >= 1);
+
+    // the locks of the SDK itself are recorded as well
+    sentry_options_t *options = sentry_options_new();
+    sentry_init(options);
+    sentry_add_breadcrumb(sentry_value_new_breadcrumb(NULL, "crumb"));
+    sentry_close();
+    sentry_value_decref(stats);
+    stats = sentry_get_stats();
+    locks = sentry_value_get_by_key(stats, "locks");
+    TEST_CHECK(get_lock_stat(sentry_value_get_by_key(
+                                 locks, "sentry_core.c:g_options_lock"),
+                   "acquisitions")
+        > 0);
+    TEST_CHECK(
+        get_lock_stat(sentry_value_get_by_key(locks, "sentry_scope.c:g_lock"),
+            "acquisitions")
+        > 0);
+    sentry_value_decref(stats);
+#else
+    SKIP_TEST();
+#endif
+}
@@ -191,9 +191,8 @@ SENTRY_TEST(basic_function_transport_transaction)
     sentry_transaction_t *tx
         = sentry_transaction_start(tx_cxt, sentry_value_new_null());
     sentry_uuid_t event_id = sentry_transaction_finish(tx);
-    // TODO: `sentry_capture_event` acts as if the event was sent if user
-    // consent was not given
-    TEST_CHECK(!sentry_uuid_is_nil(&event_id));
+    // events without user consent are discarded right away
+    TEST_CHECK(sentry_uuid_is_nil(&event_id));
     sentry_user_consent_give();
 
     tx_cxt = sentry_transaction_context_new("honk", "beep");
@@ -206,9 +205,8 @@ SENTRY_TEST(basic_function_transport_transaction)
         "How could you again", "Don't capture this either.");
     tx = sentry_transaction_start(tx_cxt, sentry_value_new_null());
     event_id = sentry_transaction_finish(tx);
-    // TODO: `sentry_capture_event` acts as if the event was sent if user
-    // consent was not given
-    TEST_CHECK(!sentry_uuid_is_nil(&event_id));
+    // events without user consent are discarded right away
+    TEST_CHECK(sentry_uuid_is_nil(&event_id));
 
     sentry_close();
 
@@ -381,8 +379,10 @@ SENTRY_TEST(basic_spans)
     // Now finishing
     sentry_span_finish(opaque_child);
 
-    TEST_CHECK(!IS_NULL(tx, "spans"));
-    sentry_value_t spans = sentry_value_get_by_key(tx, "spans");
+    // the finished spans are only added to the transaction when it finishes
+    TEST_CHECK(IS_NULL(tx, "spans"));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
+    sentry_value_t spans = sentry__transaction_spans_to_value(opaque_tx);
     TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
 
     sentry_value_t stored_child = sentry_value_get_by_index(spans, 0);
@@ -393,6 +393,9 @@ SENTRY_TEST(basic_spans)
     CHECK_STRING_PROPERTY(stored_child, "description", "goose");
     // Should be finished
     TEST_CHECK(!IS_NULL(stored_child, "timestamp"));
+    TEST_CHECK(!IS_NULL(stored_child, "start_timestamp"));
+    TEST_CHECK(IS_NULL(stored_child, "sampled"));
+    sentry_value_decref(spans);
 
     sentry__transaction_decref(opaque_tx);
 
@@ -431,9 +434,7 @@ SENTRY_TEST(spans_on_scope)
 
     sentry_span_finish(opaque_child);
 
-    scope_tx = sentry__scope_get_span_or_transaction();
-    TEST_CHECK(!IS_NULL(scope_tx, "spans"));
-    sentry_value_t spans = sentry_value_get_by_key(scope_tx, "spans");
+    sentry_value_t spans = sentry__transaction_spans_to_value(opaque_tx);
     TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
 
     sentry_value_t stored_child = sentry_value_get_by_index(spans, 0);
@@ -444,6 +445,7 @@ SENTRY_TEST(spans_on_scope)
     CHECK_STRING_PROPERTY(stored_child, "description", "goose");
     // Should be finished
     TEST_CHECK(!IS_NULL(stored_child, "timestamp"));
+    sentry_value_decref(spans);
 
     sentry__transaction_decref(opaque_tx);
 
@@ -485,8 +487,7 @@ SENTRY_TEST(child_spans)
     const char *parent_span_id
         = sentry_value_as_string(sentry_value_get_by_key(child, "span_id"));
 
-    TEST_CHECK(!IS_NULL(tx, "spans"));
-    sentry_value_t spans = sentry_value_get_by_key(tx, "spans");
+    sentry_value_t spans = sentry__transaction_spans_to_value(opaque_tx);
     TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
 
     sentry_value_t stored_grandchild = sentry_value_get_by_index(spans, 0);
@@ -496,10 +497,12 @@ SENTRY_TEST(child_spans)
     CHECK_STRING_PROPERTY(stored_grandchild, "description", "car");
     // Should be finished
     TEST_CHECK(!IS_NULL(stored_grandchild, "timestamp"));
+    sentry_value_decref(spans);
 
     sentry_span_finish(opaque_child);
-    spans = sentry_value_get_by_key(tx, "spans");
+    spans = sentry__transaction_spans_to_value(opaque_tx);
     TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 2);
+    sentry_value_decref(spans);
 
     sentry__transaction_decref(opaque_tx);
 
@@ -537,26 +540,34 @@ SENTRY_TEST(overflow_spans)
 
     sentry_span_finish(opaque_child);
 
-    TEST_CHECK(!IS_NULL(tx, "spans"));
-    sentry_value_t spans = sentry_value_get_by_key(tx, "spans");
+    sentry_value_t spans = sentry__transaction_spans_to_value(opaque_tx);
     TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
 
     sentry_value_t stored_child = sentry_value_get_by_index(spans, 0);
     CHECK_STRING_PROPERTY(stored_child, "span_id", child_span_id);
+    sentry_value_decref(spans);
 
     sentry_span_finish(opaque_drop_on_finish_child);
-    TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
 
     sentry_span_t *opaque_drop_on_start_child
         = sentry_transaction_start_child(opaque_tx, "ring", "bicycle");
     TEST_CHECK(!opaque_drop_on_start_child);
-    TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 1);
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
 
     sentry__transaction_decref(opaque_tx);
 
     sentry_close();
 }
 
+static void
+copy_trace_header(const char *key, const char *value, void *userdata)
+{
+    if (strcmp(key, "sentry-trace") == 0) {
+        snprintf(userdata, 64, "%s", value);
+    }
+}
+
 SENTRY_TEST(unsampled_spans)
 {
     sentry_options_t *options = sentry_options_new();
@@ -579,6 +590,12 @@ SENTRY_TEST(unsampled_spans)
     TEST_CHECK(!sentry_value_is_null(child));
     TEST_CHECK(
         !sentry_value_is_true(sentry_value_get_by_key(child, "sampled")));
+    // nothing is built for spans that are never sent
+    TEST_CHECK(opaque_child->noop);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(child), 0);
+    sentry_span_set_tag(opaque_child, "honk", "loud");
+    sentry_span_set_data(opaque_child, "honks", sentry_value_new_int32(3));
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(child), 0);
 
     sentry_span_t *opaque_grandchild
         = sentry_span_start_child(opaque_child, "beep", "car");
@@ -586,15 +603,24 @@ SENTRY_TEST(unsampled_spans)
     TEST_CHECK(!sentry_value_is_null(grandchild));
     TEST_CHECK(
         !sentry_value_is_true(sentry_value_get_by_key(grandchild, "sampled")));
+    TEST_CHECK(opaque_grandchild->noop);
+
+    // the trace is still propagated, as that of the transaction
+    char trace_header[64] = { 0 };
+    sentry_span_iter_headers(
+        opaque_grandchild, copy_trace_header, trace_header);
+    char expected_header[64];
+    snprintf(expected_header, sizeof(expected_header), "%s-%s-0",
+        sentry_value_as_string(sentry_value_get_by_key(tx, "trace_id")),
+        sentry_value_as_string(sentry_value_get_by_key(tx, "span_id")));
+    TEST_CHECK_STRING_EQUAL(trace_header, expected_header);
 
     // finishing does not add (grand)children to the spans list
     sentry_span_finish(opaque_grandchild);
-    TEST_CHECK(
-        0 == sentry_value_get_length(sentry_value_get_by_key(tx, "spans")));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 0);
 
     sentry_span_finish(opaque_child);
-    TEST_CHECK(
-        0 == sentry_value_get_length(sentry_value_get_by_key(tx, "spans")));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 0);
 
     // perform the same checks, but with the transaction on the scope
     sentry_set_transaction_object(opaque_tx);
@@ -613,18 +639,91 @@ SENTRY_TEST(unsampled_spans)
         !sentry_value_is_true(sentry_value_get_by_key(grandchild, "sampled")));
 
     sentry_span_finish(opaque_grandchild);
-    TEST_CHECK(
-        0 == sentry_value_get_length(sentry_value_get_by_key(tx, "spans")));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 0);
 
     sentry_span_finish(opaque_child);
-    TEST_CHECK(
-        0 == sentry_value_get_length(sentry_value_get_by_key(tx, "spans")));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 0);
 
     sentry_transaction_finish(opaque_tx);
 
     sentry_close();
 }
 
+SENTRY_TEST(finish_shared_span)
+{
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_init(options);
+
+    sentry_transaction_context_t *opaque_tx_cxt
+        = sentry_transaction_context_new("wow!", NULL);
+    sentry_transaction_t *opaque_tx
+        = sentry_transaction_start(opaque_tx_cxt, sentry_value_new_null());
+
+    // the span on the scope is recognized by its identity
+    sentry_span_t *opaque_child
+        = sentry_transaction_start_child(opaque_tx, "honk", "goose");
+    sentry_set_span(opaque_child);
+    sentry_span_finish(opaque_child);
+    SENTRY_WITH_SCOPE (scope) {
+        TEST_CHECK(!scope->span);
+    }
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
+
+    // a span that is still referenced elsewhere is recorded as a snapshot,
+    // and can not be finished a second time
+    opaque_child = sentry_transaction_start_child(opaque_tx, "beep", "car");
+    sentry__span_incref(opaque_child);
+    sentry_span_finish(opaque_child);
+    TEST_CHECK(opaque_child->finished);
+    sentry_span_set_tag(opaque_child, "after", "finish");
+    sentry_span_finish(opaque_child);
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 2);
+
+    sentry_value_t spans = sentry__transaction_spans_to_value(opaque_tx);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 2);
+    sentry_value_t stored_child = sentry_value_get_by_index(spans, 1);
+    CHECK_STRING_PROPERTY(stored_child, "op", "beep");
+    TEST_CHECK(IS_NULL(stored_child, "tags"));
+    sentry_value_decref(spans);
+
+    sentry__transaction_decref(opaque_tx);
+
+    sentry_close();
+}
+
+SENTRY_TEST(span_timestamps)
+{
+    sentry_transaction_t *opaque_tx
+        = sentry__transaction_new(sentry_value_new_object());
+    TEST_ASSERT(!!opaque_tx);
+    opaque_tx->start_timestamp_us = 1587985356050000;
+    opaque_tx->start_ns = 1000;
+
+    // the timestamps keep the microseconds of the monotonic clock
+    sentry_value_t timestamp
+        = sentry__transaction_timestamp_to_value(opaque_tx, 1000 + 1500);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(timestamp), "2020-04-27T11:02:36.050001Z");
+    sentry_value_decref(timestamp);
+    timestamp = sentry__transaction_timestamp_to_value(opaque_tx, 0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(timestamp), "2020-04-27T11:02:36.050000Z");
+    sentry_value_decref(timestamp);
+
+    opaque_tx->start_ns = sentry__monotonic_time_ns();
+    sentry_value_t parent = opaque_tx->inner;
+    sentry_span_t *span = sentry__span_new(opaque_tx,
+        sentry__value_span_new(opaque_tx, parent, "honk", 4, "goose", 5));
+    TEST_ASSERT(!!span);
+    TEST_CHECK(span->start_ns >= opaque_tx->start_ns);
+    TEST_CHECK(sentry__transaction_add_finished_span(opaque_tx, span));
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
+    TEST_CHECK(opaque_tx->spans[0].end_ns >= opaque_tx->spans[0].start_ns);
+
+    sentry__transaction_decref(opaque_tx);
+}
+
 static void
 check_spans(sentry_envelope_t *envelope, void *data)
 {
@@ -660,7 +759,6 @@ SENTRY_TEST(drop_unfinished_spans)
         = sentry_transaction_context_new("wow!", NULL);
     sentry_transaction_t *opaque_tx
         = sentry_transaction_start(opaque_tx_cxt, sentry_value_new_null());
-    sentry_value_t tx = opaque_tx->inner;
 
     sentry_span_t *opaque_child
         = sentry_transaction_start_child(opaque_tx, "honk", "goose");
@@ -674,8 +772,7 @@ SENTRY_TEST(drop_unfinished_spans)
     sentry_span_finish(opaque_grandchild);
 
     // spans are only added to transactions upon completion
-    TEST_CHECK_INT_EQUAL(
-        sentry_value_get_length(sentry_value_get_by_key(tx, "spans")), 1);
+    TEST_CHECK_INT_EQUAL(opaque_tx->span_count, 1);
 
     sentry_uuid_t event_id = sentry_transaction_finish(opaque_tx);
     TEST_CHECK(!sentry_uuid_is_nil(&event_id));
@@ -807,5 +904,169 @@ SENTRY_TEST(distributed_headers)
     sentry_close();
 }
 
+typedef struct {
+    uint64_t called;
+    size_t span_counts[8];
+    char trace_id[33];
+    char root_span_id[17];
+} span_chunks_t;
+
+static void
+collect_span_chunks(sentry_envelope_t *envelope, void *data)
+{
+    span_chunks_t *chunks = data;
+    sentry_value_t tx = sentry_envelope_get_transaction(envelope);
+    TEST_CHECK(!sentry_value_is_null(tx));
+    CHECK_STRING_PROPERTY(tx, "transaction", "batch");
+    sentry_value_t trace = sentry_value_get_by_key(
+        sentry_value_get_by_key(tx, "contexts"), "trace");
+    CHECK_STRING_PROPERTY(trace, "trace_id", chunks->trace_id);
+    // the chunks are children of the root span, which is sent last
+    const char *parent_span_id = sentry_value_as_string(
+        sentry_value_get_by_key(trace, "parent_span_id"));
+    const char *span_id
+        = sentry_value_as_string(sentry_value_get_by_key(trace, "span_id"));
+    if (!strcmp(span_id, chunks->root_span_id)) {
+        TEST_CHECK_STRING_EQUAL(parent_span_id, "");
+    } else {
+        TEST_CHECK_STRING_EQUAL(parent_span_id, chunks->root_span_id);
+    }
+
+    if (chunks->called < 8) {
+        chunks->span_counts[chunks->called] = sentry_value_get_length(
+            sentry_value_get_by_key(tx, "spans"));
+    }
+    chunks->called += 1;
+
+    sentry_envelope_free(envelope);
+}
+
+SENTRY_TEST(span_streaming)
+{
+    span_chunks_t chunks;
+    memset(&chunks, 0, sizeof(chunks));
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_transport_t *transport = sentry_transport_new(collect_span_chunks);
+    sentry_transport_set_state(transport, &chunks);
+    sentry_options_set_transport(options, transport);
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_max_spans(options, 5);
+    sentry_options_set_span_chunk_size(options, 10);
+    TEST_CHECK_INT_EQUAL(sentry_options_get_span_chunk_size(options), 10);
+    sentry_init(options);
+
+    sentry_transaction_context_t *tx_cxt
+        = sentry_transaction_context_new("batch", "job");
+    sentry_transaction_t *tx
+        = sentry_transaction_start(tx_cxt, sentry_value_new_null());
+    TEST_ASSERT(!!tx);
+    strcpy(chunks.trace_id,
+        sentry_value_as_string(sentry_value_get_by_key(tx->inner, "trace_id")));
+    strcpy(chunks.root_span_id,
+        sentry_value_as_string(sentry_value_get_by_key(tx->inner, "span_id")));
+
+    // the chunk size replaces `max_spans`, and no span is dropped
+    for (int i = 0; i < 25; i++) {
+        sentry_span_t *span = sentry_transaction_start_child(tx, "step", NULL);
+        TEST_ASSERT(!!span);
+        sentry_span_finish(span);
+        TEST_CHECK(tx->span_count < 10);
+    }
+    TEST_CHECK_INT_EQUAL(chunks.called, 2);
+    TEST_CHECK_INT_EQUAL(tx->span_count, 5);
+
+    sentry_uuid_t event_id = sentry_transaction_finish(tx);
+    TEST_CHECK(!sentry_uuid_is_nil(&event_id));
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(chunks.called, 3);
+    TEST_CHECK_INT_EQUAL(chunks.span_counts[0], 10);
+    TEST_CHECK_INT_EQUAL(chunks.span_counts[1], 10);
+    TEST_CHECK_INT_EQUAL(chunks.span_counts[2], 5);
+
+    // a byte limit that every span exceeds sends them one by one
+    memset(&chunks, 0, sizeof(chunks));
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    transport = sentry_transport_new(collect_span_chunks);
+    sentry_transport_set_state(transport, &chunks);
+    sentry_options_set_transport(options, transport);
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_span_chunk_max_bytes(options, 1);
+    sentry_init(options);
+
+    tx_cxt = sentry_transaction_context_new("batch", "job");
+    tx = sentry_transaction_start(tx_cxt, sentry_value_new_null());
+    TEST_ASSERT(!!tx);
+    strcpy(chunks.trace_id,
+        sentry_value_as_string(sentry_value_get_by_key(tx->inner, "trace_id")));
+    strcpy(chunks.root_span_id,
+        sentry_value_as_string(sentry_value_get_by_key(tx->inner, "span_id")));
+    for (int i = 0; i < 3; i++) {
+        sentry_span_finish(sentry_transaction_start_child(tx, "step", NULL));
+    }
+    TEST_CHECK_INT_EQUAL(chunks.called, 3);
+    sentry_transaction_finish(tx);
+    sentry_close();
+
+    TEST_CHECK_INT_EQUAL(chunks.called, 4);
+    TEST_CHECK_INT_EQUAL(chunks.span_counts[0], 1);
+    TEST_CHECK_INT_EQUAL(chunks.span_counts[3], 0);
+}
+
+SENTRY_TEST(trace_header_parsing)
+{
+    sentry_trace_header_t header;
+    TEST_CHECK(sentry__trace_header_parse(
+        &header, "2674EB52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df-1"));
+    TEST_CHECK_INT_EQUAL(header.sampled, 1);
+    char buf[SENTRY_TRACE_HEADER_SIZE];
+    TEST_CHECK_INT_EQUAL(sentry__trace_header_format(buf, &header.trace_id,
+                             &header.span_id, header.sampled),
+        SENTRY_TRACE_HEADER_SIZE - 1);
+    TEST_CHECK_STRING_EQUAL(
+        buf, "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df-1");
+
+    TEST_CHECK(sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df"));
+    TEST_CHECK_INT_EQUAL(header.sampled, -1);
+    TEST_CHECK(sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df-0"));
+    TEST_CHECK_INT_EQUAL(header.sampled, 0);
+
+    TEST_CHECK(!sentry__trace_header_parse(&header, NULL));
+    TEST_CHECK(!sentry__trace_header_parse(&header, ""));
+    TEST_CHECK(!sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a"));
+    TEST_CHECK(!sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63"));
+    TEST_CHECK(!sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8x-a0f9fdf04f1a63df-1"));
+    TEST_CHECK(!sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a_a0f9fdf04f1a63df-1"));
+    TEST_CHECK(!sentry__trace_header_parse(
+        &header, "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df1"));
+
+    // the ids of an invalid header are not taken over
+    sentry_transaction_context_t *tx_cxt
+        = sentry_transaction_context_new("honk", NULL);
+    sentry_transaction_context_update_from_header(
+        tx_cxt, "sentry-trace", "2674eb52d5874b13b560236d6c79ce8a-a0f9");
+    TEST_CHECK(sentry_uuid_is_nil(&tx_cxt->trace_id));
+    sentry_transaction_context_update_from_header(tx_cxt, "sentry-trace",
+        "2674eb52d5874b13b560236d6c79ce8a-a0f9fdf04f1a63df-0");
+    TEST_CHECK(!sentry_uuid_is_nil(&tx_cxt->trace_id));
+    TEST_CHECK(IS_NULL(tx_cxt->inner, "parent_span_id"));
+    TEST_CHECK(!sentry_value_is_true(
+        sentry_value_get_by_key(tx_cxt->inner, "sampled")));
+    sentry__transaction_context_apply_trace_header(tx_cxt);
+    CHECK_STRING_PROPERTY(
+        tx_cxt->inner, "trace_id", "2674eb52d5874b13b560236d6c79ce8a");
+    CHECK_STRING_PROPERTY(tx_cxt->inner, "parent_span_id", "a0f9fdf04f1a63df");
+    sentry__transaction_context_free(tx_cxt);
+}
+
 #undef IS_NULL
 #undef CHECK_STRING_PROPERTY
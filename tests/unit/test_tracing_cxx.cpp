@@ -0,0 +1,78 @@
+#include "sentry_testsupport.h"
+
+#include "sentry.hpp"
+#include "sentry_string.h"
+#include "sentry_tracing.h"
+
+#include <string>
+
+static void
+check_cxx_transaction(const sentry_envelope_t *envelope, void *data)
+{
+    int *called = static_cast<int *>(data);
+    *called += 1;
+
+    sentry_value_t tx = sentry_envelope_get_transaction(envelope);
+    const char *name
+        = sentry_value_as_string(sentry_value_get_by_key(tx, "transaction"));
+    if (!sentry__string_eq(name, "honk")) {
+        return;
+    }
+    sentry_value_t spans = sentry_value_get_by_key(tx, "spans");
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(spans), 2);
+    // the grandchild finished first
+    sentry_value_t child = sentry_value_get_by_index(spans, 1);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(child, "op")), "beep");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(child, "description")),
+        "goose");
+    sentry_value_t tags = sentry_value_get_by_key(child, "tags");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(tags, "wing")), "left");
+}
+
+SENTRY_TEST(cxx_tracing)
+{
+    int called = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_traces_sample_rate(options, 1.0);
+    sentry_options_set_transport(
+        options, sentry_new_function_transport(check_cxx_transaction, &called));
+    TEST_CHECK(sentry_init(options) == 0);
+
+    {
+        sentry::Transaction tx("honk", "http.server");
+        TEST_ASSERT(!!tx);
+        {
+            // none of these strings are null terminated where they end
+            std::string buf = "beepgoosewingleft";
+            std::string_view view = buf;
+            sentry::Span child
+                = tx.start_child(view.substr(0, 4), view.substr(4, 5));
+            TEST_CHECK(!!child);
+            child.set_tag(view.substr(9, 4), view.substr(13));
+
+            sentry::Span grandchild = child.start_child("vroom");
+            sentry::Span moved = std::move(grandchild);
+            TEST_CHECK(!grandchild);
+            TEST_CHECK(!!moved);
+            TEST_CHECK_INT_EQUAL(tx.get()->span_count, 0);
+        }
+        TEST_CHECK_INT_EQUAL(tx.get()->span_count, 2);
+    }
+    TEST_CHECK_INT_EQUAL(called, 1);
+
+    // a transaction that was released is neither finished nor sent
+    sentry::Transaction released("released", "op");
+    sentry_transaction_t *opaque_tx = released.release();
+    TEST_CHECK(!released);
+    TEST_CHECK(!released.start_child("nothing"));
+    sentry_uuid_t event_id = released.finish();
+    TEST_CHECK(sentry_uuid_is_nil(&event_id));
+    sentry_transaction_finish(opaque_tx);
+    TEST_CHECK_INT_EQUAL(called, 2);
+
+    sentry_close();
+}
@@ -1,5 +1,11 @@
 #include "sentry_symbolizer.h"
+#include "sentry_sync.h"
 #include "sentry_testsupport.h"
+#include "sentry_unwinder.h"
+
+#if defined(SENTRY_PLATFORM_LINUX) && !defined(SENTRY_PLATFORM_ANDROID)
+#    include <ucontext.h>
+#endif
 
 #define MAX_FRAMES 128
 
@@ -74,3 +80,200 @@ SENTRY_TEST(unwinder)
         }
     }
 }
+
+SENTRY_TEST(unwinder_frame_pointers)
+{
+#if !defined(SENTRY_WITH_UNWINDER_FP) || !defined(SENTRY_PLATFORM_LINUX)       \
+    || defined(SENTRY_PLATFORM_ANDROID)                                        \
+    || !(defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+    SKIP_TEST();
+#else
+    void *backtrace1[MAX_FRAMES] = { 0 };
+    size_t frame_count1 = invoke_unwinder(backtrace1);
+
+    // starting at the frame of this function skips the frames below it
+    void *backtrace2[MAX_FRAMES] = { 0 };
+    size_t frame_count2 = sentry_unwind_stack(
+        __builtin_frame_address(0), backtrace2, MAX_FRAMES);
+    TEST_CHECK(frame_count2 > 0);
+    TEST_CHECK(frame_count2 < frame_count1);
+    size_t offset = frame_count1 - frame_count2;
+    for (size_t i = 0; i < frame_count2; i++) {
+        TEST_CHECK(backtrace2[i] == backtrace1[offset + i]);
+    }
+
+    // the instruction address is not a frame pointer on the stack
+    TEST_CHECK_INT_EQUAL(
+        sentry_unwind_stack(backtrace1[0], backtrace2, MAX_FRAMES), 0);
+
+    ucontext_t user_context;
+    TEST_ASSERT(getcontext(&user_context) == 0);
+    sentry_ucontext_t uctx = { 0 };
+    uctx.user_context = &user_context;
+    void *backtrace3[MAX_FRAMES] = { 0 };
+    size_t frame_count3
+        = sentry_unwind_stack_from_ucontext(&uctx, backtrace3, MAX_FRAMES);
+    // the first frame is the captured instruction within this function,
+    // followed by the same callers
+    TEST_CHECK_INT_EQUAL(frame_count3, frame_count2 + 1);
+    for (size_t i = 1; i < frame_count3; i++) {
+        TEST_CHECK(backtrace3[i] == backtrace2[i - 1]);
+    }
+#endif
+}
+
+SENTRY_TEST(thread_names_cached)
+{
+#if !defined(SENTRY_PLATFORM_LINUX) || defined(SENTRY_PLATFORM_ANDROID)
+    SKIP_TEST();
+#else
+    long tid = sentry__unwinder_current_tid();
+    char original[16];
+    TEST_ASSERT(!!sentry__unwinder_thread_name(tid, original));
+
+    char name[16];
+    TEST_CHECK_INT_EQUAL(
+        sentry__thread_setname(sentry__current_thread(), "sentry-test"), 0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry__unwinder_thread_name(tid, name), "sentry-test");
+
+    // names that change behind our back are only read after a reset
+    pthread_setname_np(pthread_self(), "renamed");
+    TEST_CHECK_STRING_EQUAL(
+        sentry__unwinder_thread_name(tid, name), "sentry-test");
+    sentry__unwinder_reset_thread_names();
+    TEST_CHECK_STRING_EQUAL(sentry__unwinder_thread_name(tid, name), "renamed");
+
+    sentry__unwinder_cache_thread_name(0, "a-very-long-thread-name");
+    TEST_CHECK_STRING_EQUAL(
+        sentry__unwinder_thread_name(tid, name), "a-very-long-thr");
+    sentry__unwinder_cache_thread_name(tid, NULL);
+    TEST_CHECK_STRING_EQUAL(sentry__unwinder_thread_name(tid, name), "renamed");
+
+    // a walked stack is attributed to the current thread
+    sentry_value_t event = sentry_value_new_event();
+    sentry_event_value_add_stacktrace(event, NULL, 0);
+    sentry_value_t thread = sentry_value_get_by_index(
+        sentry_value_get_by_key(sentry_value_get_by_key(event, "threads"),
+            "values"),
+        0);
+    char tid_str[24];
+    snprintf(tid_str, sizeof(tid_str), "%ld", tid);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(thread, "id")),
+        tid_str);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(thread, "name")),
+        "renamed");
+    TEST_CHECK(
+        sentry_value_is_true(sentry_value_get_by_key(thread, "current")));
+    TEST_CHECK(!sentry_value_is_null(
+        sentry_value_get_by_key(thread, "stacktrace")));
+    sentry_value_decref(event);
+
+    sentry__thread_setname(sentry__current_thread(), original);
+#endif
+}
+
+#if defined(SENTRY_PLATFORM_LINUX) && !defined(SENTRY_PLATFORM_ANDROID)
+#    include <errno.h>
+#    include <sched.h>
+#    include <signal.h>
+
+struct unwound_thread {
+    volatile long tid;
+    volatile long running;
+    volatile long spoiled_errno;
+    volatile long failed_unwinds;
+};
+
+static volatile long g_chained_signals = 0;
+
+static void
+count_chained_signal(int UNUSED(signum))
+{
+    sentry__atomic_fetch_and_add(&g_chained_signals, 1);
+}
+
+SENTRY_THREAD_FN
+spin_until_stopped(void *data)
+{
+    struct unwound_thread *thread = data;
+    sentry__atomic_store(&thread->tid, sentry__unwinder_current_tid());
+    while (sentry__atomic_fetch(&thread->running)) {
+        errno = EINTR;
+        for (volatile int i = 0; i < 1000; i++) { }
+        if (errno != EINTR) {
+            sentry__atomic_store(&thread->spoiled_errno, 1);
+        }
+    }
+    return 0;
+}
+
+SENTRY_THREAD_FN
+unwind_repeatedly(void *data)
+{
+    struct unwound_thread *thread = data;
+    void *backtrace[MAX_FRAMES];
+    for (size_t i = 0; i < 50; i++) {
+        if (!sentry__unwind_thread(sentry__atomic_fetch(&thread->tid),
+                backtrace, MAX_FRAMES, 1000)) {
+            sentry__atomic_fetch_and_add(&thread->failed_unwinds, 1);
+        }
+    }
+    return 0;
+}
+#endif
+
+SENTRY_TEST(unwind_other_thread)
+{
+#if !defined(SENTRY_PLATFORM_LINUX) || defined(SENTRY_PLATFORM_ANDROID)
+    SKIP_TEST();
+#else
+    struct sigaction previous;
+    struct sigaction counting;
+    memset(&counting, 0, sizeof(counting));
+    sigemptyset(&counting.sa_mask);
+    counting.sa_handler = count_chained_signal;
+    sigaction(SIGURG, &counting, &previous);
+    sentry__unwinder_threads_begin();
+
+    struct unwound_thread thread;
+    memset(&thread, 0, sizeof(thread));
+    thread.running = 1;
+    sentry_threadid_t spinner;
+    sentry__thread_init(&spinner);
+    TEST_ASSERT(
+        sentry__thread_spawn(&spinner, spin_until_stopped, &thread) == 0);
+    while (!sentry__atomic_fetch(&thread.tid)) {
+        sched_yield();
+    }
+
+    // concurrent requests are serialized, and never see each others context
+    sentry_threadid_t requesters[2];
+    for (size_t i = 0; i < 2; i++) {
+        sentry__thread_init(&requesters[i]);
+        sentry__thread_spawn(&requesters[i], unwind_repeatedly, &thread);
+    }
+    for (size_t i = 0; i < 2; i++) {
+        sentry__thread_join(requesters[i]);
+        sentry__thread_free(&requesters[i]);
+    }
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&thread.failed_unwinds), 0);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&g_chained_signals), 0);
+
+    // signals that we did not send still reach the previous handler
+    pthread_kill(spinner, SIGURG);
+    while (!sentry__atomic_fetch(&g_chained_signals)) {
+        sched_yield();
+    }
+
+    sentry__atomic_store(&thread.running, 0);
+    sentry__thread_join(spinner);
+    sentry__thread_free(&spinner);
+    TEST_CHECK(!sentry__atomic_fetch(&thread.spoiled_errno));
+
+    sentry__unwinder_threads_end();
+    sigaction(SIGURG, &previous, NULL);
+#endif
+}
@@ -5,6 +5,7 @@
 
 #ifdef SENTRY_PLATFORM_UNIX
 #    include "sentry_unix_pageallocator.h"
+#    include <unistd.h>
 #endif
 
 SENTRY_TEST(iso_time)
@@ -25,6 +26,51 @@ SENTRY_TEST(iso_time)
     uint64_t roundtrip = sentry__iso8601_to_msec(str);
     sentry_free(str);
     TEST_CHECK_INT_EQUAL(roundtrip, msec);
+
+    // leap days and the end of the year
+    str = sentry__msec_time_to_iso8601(951782400000);
+    TEST_CHECK_STRING_EQUAL(str, "2000-02-29T00:00:00Z");
+    sentry_free(str);
+    str = sentry__msec_time_to_iso8601(1704067199999);
+    TEST_CHECK_STRING_EQUAL(str, "2023-12-31T23:59:59.999Z");
+    sentry_free(str);
+    // the cached second is not reused for the next one
+    str = sentry__msec_time_to_iso8601(1704067200001);
+    TEST_CHECK_STRING_EQUAL(str, "2024-01-01T00:00:00.001Z");
+    sentry_free(str);
+    TEST_CHECK(!sentry__msec_time_to_iso8601(UINT64_MAX));
+
+    TEST_CHECK_INT_EQUAL(
+        sentry__iso8601_to_msec("2000-02-29T00:00:00Z"), 951782400000);
+    TEST_CHECK_INT_EQUAL(
+        sentry__iso8601_to_msec("2024-01-01T00:00:00.001Z"), 1704067200001);
+    // out of range fields carry over
+    TEST_CHECK_INT_EQUAL(
+        sentry__iso8601_to_msec("2023-12-32T00:00:00.001Z"), 1704067200001);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("2020-04-27T11:02:36.05Z"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("2020-04-27T11:02:36"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("2020-04-27 11:02:36Z"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("2020-04-27T11:02:36Zx"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("2020-13-27T11:02:36Z"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec("1969-12-31T23:59:59Z"), 0);
+    TEST_CHECK_INT_EQUAL(sentry__iso8601_to_msec(""), 0);
+}
+
+SENTRY_TEST(iso_time_usec)
+{
+    char *str = sentry__usec_time_to_iso8601(1587985356050123);
+    TEST_CHECK_STRING_EQUAL(str, "2020-04-27T11:02:36.050123Z");
+    sentry_free(str);
+    str = sentry__usec_time_to_iso8601(1587985356000001);
+    TEST_CHECK_STRING_EQUAL(str, "2020-04-27T11:02:36.000001Z");
+    sentry_free(str);
+    str = sentry__usec_time_to_iso8601(10 * 1000000);
+    TEST_CHECK_STRING_EQUAL(str, "1970-01-01T00:00:10Z");
+    sentry_free(str);
+
+    uint64_t before = sentry__monotonic_time_ns();
+    uint64_t after = sentry__monotonic_time_ns();
+    TEST_CHECK(after >= before);
 }
 
 SENTRY_TEST(url_parsing_complete)
@@ -193,15 +239,21 @@ SENTRY_TEST(page_allocator)
         p_after[i] = (i + 10) % 255;
     }
 
-    /* free is a noop after page allocator was enabled */
+    /* free is a noop for allocations from before the page allocator was
+       enabled */
     sentry_free(p_before);
-    sentry_free(p_after);
-
     for (size_t i = 0; i < size; i++) {
         TEST_CHECK_INT_EQUAL((unsigned char)p_before[i], i % 255);
-        TEST_CHECK_INT_EQUAL((unsigned char)p_after[i], (i + 10) % 255);
     }
 
+    /* and the page allocator reuses its own allocations */
+    sentry_free(p_after);
+    TEST_CHECK(sentry_malloc(size) == p_after);
+    char *small = sentry_malloc(20);
+    sentry_free(small);
+    TEST_CHECK(sentry_malloc(32) == small);
+    TEST_CHECK(sentry_malloc(20) != small);
+
     sentry__page_allocator_disable();
 
     /* now we can free p_before though */
@@ -209,6 +261,67 @@ SENTRY_TEST(page_allocator)
 #endif
 }
 
+SENTRY_TEST(page_allocator_reserve)
+{
+#ifndef SENTRY_PLATFORM_UNIX
+    SKIP_TEST();
+#else
+    size_t page_size = (size_t)getpagesize();
+    sentry_page_allocator_stats_t stats;
+    /* drop any reserve that an earlier `sentry_init` has made */
+    sentry__page_allocator_disable();
+    sentry__page_allocator_reserve(page_size * 4 - 1);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.mapped, page_size * 4);
+    TEST_CHECK_INT_EQUAL(stats.in_use, 0);
+
+    /* a smaller reserve keeps the current one */
+    sentry__page_allocator_reserve(page_size);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.mapped, page_size * 4);
+
+    /* which serves the first allocations once enabled */
+    sentry__page_allocator_enable();
+    char *a = sentry_malloc(1000);
+    char *b = sentry_malloc(100);
+    memset(a, 1, 1000);
+    memset(b, 2, 100);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.mapped, page_size * 4);
+    TEST_CHECK_INT_EQUAL(stats.in_use, 1024 + 128);
+    TEST_CHECK_INT_EQUAL(stats.high_water_mark, 1024 + 128);
+
+    sentry_free(a);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.in_use, 128);
+    TEST_CHECK_INT_EQUAL(stats.high_water_mark, 1024 + 128);
+
+    /* anything that does not fit maps more pages */
+    char *large = sentry_malloc(page_size * 4);
+    memset(large, 3, page_size * 4);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK(stats.mapped > page_size * 8);
+#ifdef SENTRY_WITH_MEMORY_TAGS
+    // along with the header that every tagged allocation has
+    TEST_CHECK_INT_EQUAL(stats.in_use, 128 + page_size * 4 + 16);
+#else
+    TEST_CHECK_INT_EQUAL(stats.in_use, 128 + page_size * 4);
+#endif
+    sentry_free(large);
+    TEST_CHECK(sentry_malloc(page_size * 2) == large);
+
+    /* reserving does nothing once enabled */
+    size_t mapped = stats.mapped;
+    sentry__page_allocator_reserve(page_size * 64);
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.mapped, mapped);
+
+    sentry__page_allocator_disable();
+    sentry__page_allocator_get_stats(&stats);
+    TEST_CHECK_INT_EQUAL(stats.mapped, 0);
+#endif
+}
+
 SENTRY_TEST(os)
 {
     sentry_value_t os = sentry__get_os_context();
@@ -221,3 +334,65 @@ SENTRY_TEST(os)
 
     sentry_value_decref(os);
 }
+
+SENTRY_TEST(system_contexts)
+{
+    sentry_value_t contexts = sentry__get_system_contexts();
+    TEST_CHECK(sentry_value_is_frozen(contexts));
+    TEST_CHECK(!sentry_value_is_null(sentry_value_get_by_key(contexts, "os")));
+    sentry_value_t device = sentry_value_get_by_key(contexts, "device");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(device, "arch")),
+        SENTRY_CPU_ARCHITECTURE);
+    TEST_CHECK(sentry_value_get_type(sentry_value_get_by_key(contexts, "app"))
+        == SENTRY_VALUE_TYPE_OBJECT);
+
+    // they are computed only once, and shared afterwards
+    sentry_value_t shared = sentry__get_system_contexts();
+    TEST_CHECK(shared._bits == contexts._bits);
+    sentry_value_decref(shared);
+    sentry_value_decref(contexts);
+    TEST_CHECK_INT_EQUAL(sentry_value_refcount(contexts), 1);
+
+    sentry__system_contexts_cleanup();
+}
+
+SENTRY_TEST(stringbuilder_pool)
+{
+    sentry__stringbuilder_pool_clear();
+
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    char *buf = sentry__stringbuilder_reserve(&sb, 1000);
+    TEST_ASSERT(!!buf);
+    sentry__stringbuilder_cleanup(&sb);
+
+    // the released buffer is handed to the next builder that fits it
+    sentry__stringbuilder_init(&sb);
+    TEST_CHECK(sentry__stringbuilder_reserve(&sb, 100) != buf);
+    sentry__stringbuilder_cleanup(&sb);
+    sentry__stringbuilder_init(&sb);
+    TEST_CHECK(sentry__stringbuilder_reserve(&sb, 900) == buf);
+    sentry__stringbuilder_append(&sb, "reused");
+    char *s = sentry__stringbuilder_into_string(&sb);
+    TEST_CHECK_STRING_EQUAL(s, "reused");
+    sentry_free(s);
+
+    sentry__stringbuilder_pool_clear();
+}
+
+SENTRY_TEST(size_hint)
+{
+    sentry__stringbuilder_pool_clear();
+    sentry_size_hint_t hint = SENTRY__SIZE_HINT_INIT;
+    TEST_CHECK_INT_EQUAL(sentry__size_hint_get(&hint), 0);
+    sentry__size_hint_update(&hint, 800);
+    TEST_CHECK_INT_EQUAL(sentry__size_hint_get(&hint), 900);
+
+    // a reservation up front is not rounded up
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry__stringbuilder_reserve(&sb, sentry__size_hint_get(&hint));
+    TEST_CHECK_INT_EQUAL(sb.allocated, 900);
+    sentry__stringbuilder_cleanup(&sb);
+}
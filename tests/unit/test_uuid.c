@@ -1,7 +1,13 @@
 #include "sentry_testsupport.h"
 
+#include "sentry_random.h"
 #include "sentry_uuid.h"
 
+#ifdef SENTRY_PLATFORM_LINUX
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
 SENTRY_TEST(uuid_api)
 {
     sentry_uuid_t uuid
@@ -46,3 +52,41 @@ SENTRY_TEST(internal_uuid_api)
     sentry__span_uuid_as_string(&span_id, sbuf);
     TEST_CHECK_STRING_EQUAL(sbuf, "f391fdc0bb2743b1");
 }
+
+SENTRY_TEST(random_pool)
+{
+    sentry_uuid_t uuids[100];
+    for (size_t i = 0; i < 100; i++) {
+        uuids[i] = sentry_uuid_new_v4();
+        for (size_t j = 0; j < i; j++) {
+            TEST_CHECK(memcmp(&uuids[i], &uuids[j], sizeof(uuids[i])) != 0);
+        }
+    }
+    // larger requests bypass the pool
+    char large[1024] = { 0 };
+    char zeros[1024] = { 0 };
+    TEST_CHECK_INT_EQUAL(sentry__getrandom(large, sizeof(large)), 0);
+    TEST_CHECK(memcmp(large, zeros, sizeof(large)) != 0);
+
+#ifdef SENTRY_PLATFORM_LINUX
+    // a forked child does not hand out the bytes its parent has pooled
+    int fds[2];
+    TEST_ASSERT(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        sentry_uuid_t uuid = sentry_uuid_new_v4();
+        ssize_t written = write(fds[1], &uuid, sizeof(uuid));
+        _exit(written == sizeof(uuid) ? 0 : 1);
+    }
+    TEST_ASSERT(pid > 0);
+    sentry_uuid_t parent_uuid = sentry_uuid_new_v4();
+    sentry_uuid_t child_uuid = sentry_uuid_nil();
+    TEST_CHECK(read(fds[0], &child_uuid, sizeof(child_uuid))
+        == sizeof(child_uuid));
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    close(fds[1]);
+    TEST_CHECK(!sentry_uuid_is_nil(&child_uuid));
+    TEST_CHECK(memcmp(&parent_uuid, &child_uuid, sizeof(child_uuid)) != 0);
+#endif
+}
@@ -1,5 +1,8 @@
+#include "sentry_dtoa.h"
 #include "sentry_json.h"
+#include "sentry_string.h"
 #include "sentry_testsupport.h"
+#include "sentry_utils.h"
 #include "sentry_value.h"
 #include <locale.h>
 #include <math.h>
@@ -71,6 +74,104 @@ SENTRY_TEST(value_int32)
     TEST_CHECK(sentry_value_refcount(val) == 1);
 }
 
+SENTRY_TEST(value_int64)
+{
+    sentry_value_t val = sentry_value_new_int64(INT64_MIN);
+    TEST_CHECK(sentry_value_get_type(val) == SENTRY_VALUE_TYPE_INT64);
+    TEST_CHECK(sentry_value_as_int64(val) == INT64_MIN);
+    TEST_CHECK(sentry_value_as_int32(val) == 0);
+    TEST_CHECK(sentry_value_is_true(val));
+    TEST_CHECK_JSON_VALUE(val, "-9223372036854775808");
+    TEST_CHECK(sentry_value_refcount(val) == 1);
+    TEST_CHECK(sentry_value_is_frozen(val));
+    sentry_value_decref(val);
+
+    val = sentry_value_new_uint64(UINT64_MAX);
+    TEST_CHECK(sentry_value_get_type(val) == SENTRY_VALUE_TYPE_UINT64);
+    TEST_CHECK(sentry_value_as_uint64(val) == UINT64_MAX);
+    TEST_CHECK_JSON_VALUE(val, "18446744073709551615");
+    char *str = sentry__value_stringify(val);
+    TEST_CHECK_STRING_EQUAL(str, "18446744073709551615");
+    sentry_free(str);
+    sentry_value_decref(val);
+
+    val = sentry_value_new_uint64(0);
+    TEST_CHECK(!sentry_value_is_true(val));
+    sentry_value_decref(val);
+
+    val = sentry_value_new_int32(-5);
+    TEST_CHECK(sentry_value_as_int64(val) == -5);
+}
+
+SENTRY_TEST(value_addr)
+{
+    sentry_value_t val = sentry__value_new_addr(0xdeadbeef0);
+    TEST_CHECK(sentry_value_get_type(val) == SENTRY_VALUE_TYPE_STRING);
+    TEST_CHECK(sentry__value_as_addr(val) == 0xdeadbeef0);
+    TEST_CHECK_JSON_VALUE(val, "\"0xdeadbeef0\"");
+    TEST_CHECK_STRING_EQUAL(sentry_value_as_string(val), "0xdeadbeef0");
+    TEST_CHECK(sentry_value_get_length(val) == 11);
+    TEST_CHECK(sentry_value_is_true(val));
+    TEST_CHECK(sentry_value_is_frozen(val));
+    sentry_value_decref(val);
+
+    val = sentry__value_new_addr(0);
+    TEST_CHECK_JSON_VALUE(val, "\"0x0\"");
+    TEST_CHECK_STRING_EQUAL(sentry_value_as_string(val), "0x0");
+    sentry_value_decref(val);
+
+    // the length is known before the string is formatted
+    val = sentry__value_new_addr(UINT64_MAX);
+    TEST_CHECK(sentry_value_get_length(val) == 18);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(val), "0xffffffffffffffff");
+    sentry_value_decref(val);
+
+    val = sentry_value_new_string("0x1234");
+    TEST_CHECK(sentry__value_as_addr(val) == 0x1234);
+    sentry_value_decref(val);
+}
+
+SENTRY_TEST(value_uuid)
+{
+    sentry_uuid_t uuid
+        = sentry_uuid_from_string("4c035723-8638-4c3a-923f-2ab9d08b4018");
+    sentry_value_t val = sentry__value_new_uuid(&uuid);
+    TEST_CHECK(sentry_value_get_type(val) == SENTRY_VALUE_TYPE_STRING);
+    TEST_CHECK(sentry_value_is_frozen(val));
+    TEST_CHECK_JSON_VALUE(val, "\"4c035723-8638-4c3a-923f-2ab9d08b4018\"");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(val), "4c035723-8638-4c3a-923f-2ab9d08b4018");
+    TEST_CHECK(sentry_value_get_length(val) == 36);
+    sentry_uuid_t raw;
+    TEST_CHECK(sentry__value_get_uuid(val, &raw));
+    TEST_CHECK(memcmp(raw.bytes, uuid.bytes, 16) == 0);
+    sentry_uuid_t parsed = sentry__value_as_uuid(val);
+    TEST_CHECK(memcmp(parsed.bytes, uuid.bytes, 16) == 0);
+    sentry_value_decref(val);
+
+    val = sentry__value_new_internal_uuid(&uuid);
+    TEST_CHECK_JSON_VALUE(val, "\"4c03572386384c3a923f2ab9d08b4018\"");
+    TEST_CHECK(sentry_value_get_length(val) == 32);
+    sentry_value_decref(val);
+
+    // a span id only keeps the first half, like the parsed string does
+    val = sentry__value_new_span_uuid(&uuid);
+    TEST_CHECK_JSON_VALUE(val, "\"4c03572386384c3a\"");
+    TEST_CHECK_STRING_EQUAL(sentry_value_as_string(val), "4c03572386384c3a");
+    TEST_CHECK(sentry__value_get_uuid(val, &raw));
+    sentry_uuid_t from_string = sentry_uuid_from_string("4c03572386384c3a");
+    TEST_CHECK(memcmp(raw.bytes, from_string.bytes, 16) == 0);
+    sentry_value_decref(val);
+
+    // plain strings are still parsed, but have no raw bytes
+    val = sentry_value_new_string("4c035723-8638-4c3a-923f-2ab9d08b4018");
+    TEST_CHECK(!sentry__value_get_uuid(val, &raw));
+    parsed = sentry__value_as_uuid(val);
+    TEST_CHECK(memcmp(parsed.bytes, uuid.bytes, 16) == 0);
+    sentry_value_decref(val);
+}
+
 SENTRY_TEST(value_double)
 {
     sentry_value_t val = sentry_value_new_double(42.05);
@@ -100,6 +201,23 @@ SENTRY_TEST(value_string)
     TEST_CHECK(sentry_value_refcount(val) == 1);
     TEST_CHECK(sentry_value_is_frozen(val));
     sentry_value_decref(val);
+
+    val = sentry_value_new_string_n("Hello World!", 5);
+    size_t len = 0;
+    TEST_CHECK_STRING_EQUAL(sentry__value_as_string_n(val, &len), "Hello");
+    TEST_CHECK(len == 5);
+    TEST_CHECK(sentry_value_get_length(val) == 5);
+    TEST_CHECK_JSON_VALUE(val, "\"Hello\"");
+    sentry_value_decref(val);
+
+    val = sentry__value_new_string_owned(sentry__string_clone("owned"));
+    TEST_CHECK(sentry_value_get_length(val) == 5);
+    TEST_CHECK_JSON_VALUE(val, "\"owned\"");
+    sentry_value_decref(val);
+
+    TEST_CHECK_STRING_EQUAL(
+        sentry__value_as_string_n(sentry_value_new_int32(5), &len), "");
+    TEST_CHECK(len == 0);
 }
 
 SENTRY_TEST(value_unicode)
@@ -228,6 +346,161 @@ SENTRY_TEST(value_object)
     sentry_value_decref(val);
 }
 
+SENTRY_TEST(value_object_large)
+{
+    sentry_value_t val = sentry_value_new_object();
+    for (size_t i = 0; i < 1000; i++) {
+        char key[100];
+        sprintf(key, "key%d", (int)i);
+        sentry_value_set_by_key(val, key, sentry_value_new_int32((int32_t)i));
+    }
+    TEST_CHECK(sentry_value_get_length(val) == 1000);
+
+    // overwriting keeps the length and the insertion order
+    sentry_value_set_by_key(val, "key500", sentry_value_new_int32(-1));
+    TEST_CHECK(sentry_value_get_length(val) == 1000);
+    TEST_CHECK(sentry_value_as_int32(sentry_value_get_by_key(val, "key500"))
+        == -1);
+
+    for (size_t i = 0; i < 1000; i += 2) {
+        char key[100];
+        sprintf(key, "key%d", (int)i);
+        TEST_CHECK(sentry_value_remove_by_key(val, key) == 0);
+    }
+    TEST_CHECK(sentry_value_get_length(val) == 500);
+
+    for (size_t i = 0; i < 1100; i++) {
+        char key[100];
+        sprintf(key, "key%d", (int)i);
+        sentry_value_t child = sentry_value_get_by_key(val, key);
+        if (i < 1000 && i % 2) {
+            TEST_CHECK(sentry_value_as_int32(child) == (int32_t)i);
+        } else {
+            TEST_CHECK(sentry_value_is_null(child));
+        }
+    }
+
+    sentry_value_t clone = sentry__value_clone(val);
+    TEST_CHECK(sentry_value_get_length(clone) == 500);
+    TEST_CHECK(
+        sentry_value_as_int32(sentry_value_get_by_key(clone, "key999")) == 999);
+    sentry_value_decref(clone);
+
+    // shrinking below the index threshold falls back to linear lookups
+    for (size_t i = 1; i < 990; i += 2) {
+        char key[100];
+        sprintf(key, "key%d", (int)i);
+        sentry_value_remove_by_key(val, key);
+    }
+    TEST_CHECK(sentry_value_get_length(val) == 5);
+    TEST_CHECK_JSON_VALUE(val,
+        "{\"key991\":991,\"key993\":993,\"key995\":995,\"key997\":997,"
+        "\"key999\":999}");
+    sentry_value_decref(val);
+}
+
+SENTRY_TEST(value_arena)
+{
+    sentry_value_t outside = sentry_value_new_object();
+
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+    sentry_value_t val = sentry_value_new_object();
+    sentry_value_t list = sentry_value_new_list();
+    for (size_t i = 0; i < 100; i++) {
+        sentry_value_append(list, sentry_value_new_double((double)i));
+    }
+    sentry_value_set_by_key(val, "list", list);
+    sentry_value_set_by_key(val, "string", sentry_value_new_string("foo"));
+    sentry_value_set_by_key(outside, "arena", sentry__value_clone(val));
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
+
+    // values created outside of the arena can be mixed in freely, and arena
+    // containers can still grow after the arena has been left
+    sentry_value_set_by_key(val, "heap", sentry_value_new_string("bar"));
+    for (size_t i = 0; i < 100; i++) {
+        char key[100];
+        sprintf(key, "key%d", (int)i);
+        sentry_value_set_by_key(val, key, sentry_value_new_int32((int32_t)i));
+    }
+    sentry_value_remove_by_key(val, "key50");
+    TEST_CHECK(sentry_value_get_length(val) == 102);
+    TEST_CHECK(sentry_value_get_length(list) == 100);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(val, "string")), "foo");
+    TEST_CHECK(
+        sentry_value_as_double(sentry_value_get_by_index(list, 99)) == 99.0);
+    sentry_value_decref(val);
+
+    // the clone still keeps the arena alive
+    TEST_CHECK_JSON_VALUE(
+        sentry_value_get_by_key(sentry_value_get_by_key(outside, "arena"),
+            "string"),
+        "\"foo\"");
+    TEST_CHECK(sentry_value_get_length(sentry_value_get_by_key(
+                   sentry_value_get_by_key(outside, "arena"), "list"))
+        == 100);
+    sentry_value_decref(outside);
+}
+
+SENTRY_TEST(value_freeze_shrinks)
+{
+    sentry_value_t list = sentry_value_new_list();
+    for (int32_t i = 0; i < 100; i++) {
+        sentry_value_append(list, sentry_value_new_int32(i));
+    }
+    while (sentry_value_get_length(list) > 10) {
+        sentry_value_remove_by_index(list, 0);
+    }
+    sentry_value_t obj = sentry_value_new_object();
+    for (int32_t i = 0; i < 20; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", (int)i);
+        sentry_value_set_by_key(obj, key, sentry_value_new_int32(i));
+    }
+    sentry_value_set_by_key(obj, "list", list);
+
+    // the lists and objects shed the capacity they do not use anymore
+    size_t usage = sentry__value_get_memory_usage(obj);
+    sentry_value_freeze(obj);
+    size_t frozen_usage = sentry__value_get_memory_usage(obj);
+    TEST_CHECK_INT_EQUAL(usage - frozen_usage,
+        (128 - 10) * sizeof(sentry_value_t)
+            + (32 - 21)
+                * (sizeof(char *) + sizeof(size_t) + sizeof(sentry_value_t)));
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int32(sentry_value_get_by_index(list, 9)), 99);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_as_int32(sentry_value_get_by_key(obj, "key19")), 19);
+    sentry_value_t copy = sentry__value_clone(obj);
+    TEST_CHECK(!sentry_value_is_frozen(copy));
+    sentry_value_set_by_key(copy, "more", sentry_value_new_int32(1));
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(copy), 22);
+    sentry_value_decref(copy);
+    sentry_value_decref(obj);
+
+    // arena containers grow in place while nothing else is allocated
+    sentry_value_arena_t *arena = sentry__value_arena_new();
+    sentry_value_arena_t *prev_arena = sentry__value_arena_enter(arena);
+    list = sentry_value_new_list();
+    for (int32_t i = 0; i < 1000; i++) {
+        sentry_value_append(list, sentry_value_new_int32(i));
+        if (i % 100 == 0) {
+            sentry_value_decref(sentry_value_new_string("in between"));
+        }
+    }
+    sentry__value_arena_leave(prev_arena);
+    sentry__value_arena_decref(arena);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(list), 1000);
+    for (int32_t i = 0; i < 1000; i++) {
+        TEST_CHECK_INT_EQUAL(
+            sentry_value_as_int32(sentry_value_get_by_index(list, i)), i);
+    }
+    sentry_value_freeze(list);
+    sentry_value_decref(list);
+}
+
 SENTRY_TEST(value_object_merge)
 {
     sentry_value_t dst = sentry_value_new_object();
@@ -305,6 +578,170 @@ SENTRY_TEST(value_freezing)
     sentry_value_decref(val);
 }
 
+SENTRY_TEST(value_object_keys_n)
+{
+    const char header[] = "trace_id: 1234";
+    sentry_value_t val = sentry_value_new_object();
+    TEST_CHECK_INT_EQUAL(sentry_value_set_by_key_n(val, header, 8,
+                             sentry_value_new_string_n(header + 10, 4)),
+        0);
+    TEST_CHECK_JSON_VALUE(val, "{\"trace_id\":\"1234\"}");
+
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key_n(val, header, 8)),
+        "1234");
+    TEST_CHECK(sentry_value_is_null(sentry_value_get_by_key_n(val, header, 5)));
+    TEST_CHECK(
+        sentry_value_is_null(sentry_value_get_by_key_n(val, header, 10)));
+    TEST_CHECK(!sentry_value_is_null(
+        sentry_value_get_by_key(val, SENTRY_KEY(trace_id))));
+
+    sentry_value_t owned = sentry_value_get_by_key_owned_n(val, "trace", 5);
+    TEST_CHECK(sentry_value_is_null(owned));
+    owned = sentry_value_get_by_key_owned_n(val, "trace_id", 8);
+    TEST_CHECK(sentry_value_refcount(owned) == 2);
+    sentry_value_decref(owned);
+
+    TEST_CHECK_INT_EQUAL(sentry_value_remove_by_key_n(val, header, 5), 1);
+    TEST_CHECK_INT_EQUAL(sentry_value_remove_by_key_n(val, header, 8), 0);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(val), 0);
+    sentry_value_decref(val);
+}
+
+SENTRY_TEST(value_from_pairs)
+{
+    sentry_value_pair_t pairs[] = {
+        { "a", sentry_value_new_int32(1) },
+        { NULL, sentry_value_new_string("skipped") },
+        { "b", sentry_value_new_bool(true) },
+        { "a", sentry_value_new_int32(2) },
+    };
+    sentry_value_t obj = sentry_value_new_object_from_pairs(pairs, 4);
+    TEST_CHECK_JSON_VALUE(obj, "{\"a\":2,\"b\":true}");
+
+    // growing past the pre-sized capacity still works
+    sentry_value_set_by_key(obj, "c", sentry_value_new_null());
+    sentry_value_set_by_key(obj, "d", sentry_value_new_null());
+    sentry_value_set_by_key(obj, "e", sentry_value_new_null());
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(obj), 5);
+    sentry_value_decref(obj);
+
+    obj = sentry_value_new_object_from_pairs(NULL, 0);
+    TEST_CHECK(sentry_value_get_type(obj) == SENTRY_VALUE_TYPE_OBJECT);
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(obj), 0);
+    sentry_value_decref(obj);
+
+    sentry_value_t values[] = {
+        sentry_value_new_int32(1),
+        sentry_value_new_string("two"),
+        sentry_value_new_list(),
+    };
+    sentry_value_t list = sentry_value_new_list_from_values(values, 3);
+    TEST_CHECK_JSON_VALUE(list, "[1,\"two\",[]]");
+    for (int i = 0; i < 20; i++) {
+        sentry_value_append(list, sentry_value_new_int32(i));
+    }
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(list), 23);
+    sentry_value_remove_by_index(list, 0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_index(list, 0)), "two");
+    sentry_value_decref(list);
+}
+
+SENTRY_TEST(value_memory_usage)
+{
+    TEST_CHECK_INT_EQUAL(
+        sentry__value_get_memory_usage(sentry_value_new_null()), 0);
+    TEST_CHECK_INT_EQUAL(
+        sentry__value_get_memory_usage(sentry_value_new_int32(42)), 0);
+
+    sentry_value_t str = sentry_value_new_string("hello");
+    size_t str_size = sentry__value_get_memory_usage(str);
+    TEST_CHECK(str_size >= 6);
+
+    sentry_value_t obj = sentry_value_new_object();
+    size_t empty_size = sentry__value_get_memory_usage(obj);
+    sentry_value_set_by_key(obj, "some_key", str);
+    size_t obj_size = sentry__value_get_memory_usage(obj);
+    TEST_CHECK(obj_size >= empty_size + str_size + sizeof("some_key"));
+
+    // interned keys are not copied
+    sentry_value_t other = sentry_value_new_object();
+    sentry_value_set_by_key(
+        other, SENTRY_KEY(message), sentry_value_new_string("hello"));
+    sentry_value_t other_copy = sentry_value_new_object();
+    sentry_value_set_by_key(
+        other_copy, "non_interned", sentry_value_new_string("hello"));
+    TEST_CHECK(sentry__value_get_memory_usage(other)
+        < sentry__value_get_memory_usage(other_copy));
+    sentry_value_decref(other);
+    sentry_value_decref(other_copy);
+
+    sentry_value_t list = sentry_value_new_list();
+    sentry_value_append(list, obj);
+    TEST_CHECK(sentry__value_get_memory_usage(list) > obj_size);
+    sentry_value_decref(list);
+}
+
+SENTRY_TEST(value_interned_keys)
+{
+    TEST_CHECK_STRING_EQUAL(SENTRY_KEY(instruction_addr), "instruction_addr");
+
+    sentry_value_t val = sentry_value_new_object();
+    sentry_value_set_by_key(
+        val, SENTRY_KEY(platform), sentry_value_new_string("native"));
+    sentry_value_set_by_key(val, "level", sentry_value_new_string("info"));
+
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(val, "platform")),
+        "native");
+    sentry_value_t level = sentry_value_get_by_key(val, SENTRY_KEY(level));
+    TEST_CHECK_STRING_EQUAL(sentry_value_as_string(level), "info");
+    TEST_CHECK_JSON_VALUE(val, "{\"platform\":\"native\",\"level\":\"info\"}");
+
+    sentry_value_t clone = sentry__value_clone(val);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_remove_by_key(val, SENTRY_KEY(platform)), 0);
+    TEST_CHECK_JSON_VALUE(val, "{\"level\":\"info\"}");
+    sentry_value_decref(val);
+
+    TEST_CHECK_JSON_VALUE(
+        clone, "{\"platform\":\"native\",\"level\":\"info\"}");
+    sentry_value_decref(clone);
+}
+
+SENTRY_TEST(value_copy_on_write)
+{
+    sentry_value_t shared = sentry_value_new_object();
+    sentry_value_set_by_key(shared, "a", sentry_value_new_int32(1));
+    sentry_value_freeze(shared);
+
+    sentry_value_t parent = sentry_value_new_object();
+    sentry_value_incref(shared);
+    sentry_value_set_by_key(parent, "shared", shared);
+
+    sentry_value_t child = sentry__value_get_mutable_by_key(parent, "shared");
+    TEST_CHECK(!sentry_value_is_frozen(child));
+    TEST_CHECK(child._bits != shared._bits);
+    TEST_CHECK(sentry_value_get_by_key(parent, "shared")._bits == child._bits);
+    TEST_CHECK_INT_EQUAL(
+        sentry_value_set_by_key(child, "b", sentry_value_new_int32(2)), 0);
+    TEST_CHECK_JSON_VALUE(parent, "{\"shared\":{\"a\":1,\"b\":2}}");
+    TEST_CHECK_JSON_VALUE(shared, "{\"a\":1}");
+    TEST_CHECK(sentry_value_refcount(shared) == 1);
+
+    // an already mutable value is returned as-is
+    TEST_CHECK(sentry__value_get_mutable_by_key(parent, "shared")._bits
+        == child._bits);
+    sentry_value_decref(parent);
+
+    sentry_value_t value = shared;
+    sentry__value_make_mutable(&value);
+    TEST_CHECK(!sentry_value_is_frozen(value));
+    TEST_CHECK_JSON_VALUE(value, "{\"a\":1}");
+    sentry_value_decref(value);
+}
+
 #define STRING(X) X, (sizeof(X) - 1)
 
 SENTRY_TEST(value_json_parsing)
@@ -357,6 +794,37 @@ SENTRY_TEST(value_json_parsing)
     sentry_value_decref(rv);
 }
 
+SENTRY_TEST(value_json_invalid)
+{
+    const char *invalid[] = { "", " ", "[", "[1,", "[1,]", "{", "{\"a\"",
+        "{\"a\":", "{\"a\":1,}", "{a:1}", "\"unterminated", "\"\\", "tru",
+        "nul", "-", "1.", "1e", "01x", "[1 2]", "1 2", "{\"a\" 1}", "]" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        sentry_value_t rv
+            = sentry__value_from_json(invalid[i], strlen(invalid[i]));
+        TEST_CHECK(sentry_value_is_null(rv));
+        TEST_MSG("%s", invalid[i]);
+    }
+
+    // the input is bounded by its length, and ends at an embedded NUL
+    sentry_value_t rv = sentry__value_from_json("[12345]", 3);
+    TEST_CHECK(sentry_value_is_null(rv));
+    rv = sentry__value_from_json("123\0garbage", 11);
+    TEST_CHECK_INT_EQUAL(sentry_value_as_int32(rv), 123);
+
+    rv = sentry__value_from_json(STRING(" { \"a\" : [ 1 , -2.5e3 ] } \n"));
+    TEST_CHECK_JSON_VALUE(rv, "{\"a\":[1,-2500]}");
+    sentry_value_decref(rv);
+
+    // nesting is limited
+    char *deep = sentry_malloc(2 * 1000 + 1);
+    memset(deep, '[', 1000);
+    memset(deep + 1000, ']', 1000);
+    rv = sentry__value_from_json(deep, 2000);
+    TEST_CHECK(sentry_value_is_null(rv));
+    sentry_free(deep);
+}
+
 SENTRY_TEST(value_json_deeply_nested)
 {
     sentry_value_t root = sentry_value_new_list();
@@ -410,6 +878,87 @@ SENTRY_TEST(value_json_escaping)
     TEST_CHECK(sentry_value_is_null(rv));
 }
 
+static int
+collect_chunk(const char *buf, size_t len, void *data)
+{
+    sentry_stringbuilder_t *sb = data;
+    TEST_CHECK(len > 0);
+    sentry__stringbuilder_append_buf(sb, buf, len);
+    // signal a failure after a few chunks
+    return sentry__stringbuilder_len(sb) > 3 * 4096;
+}
+
+SENTRY_TEST(value_json_sink)
+{
+    sentry_value_t list = sentry_value_new_list();
+    for (int i = 0; i < 500; i++) {
+        sentry_value_append(list, sentry_value_new_string("some string"));
+    }
+    char *expected = sentry_value_to_json(list);
+
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new_sink(collect_chunk, &sb);
+    sentry__jsonwriter_write_value(jw, list);
+    // the output was passed on in chunks, before the final flush
+    TEST_CHECK(sentry__stringbuilder_len(&sb) > 0);
+    TEST_CHECK(sentry__stringbuilder_len(&sb) < strlen(expected));
+    TEST_CHECK_INT_EQUAL(sentry__jsonwriter_flush(jw), 0);
+    sentry__jsonwriter_free(jw);
+    char *streamed = sentry__stringbuilder_into_string(&sb);
+    TEST_CHECK_STRING_EQUAL(streamed, expected);
+    sentry_free(streamed);
+
+    // a failing sink is reported, and not called again
+    for (int i = 0; i < 1500; i++) {
+        sentry_value_append(list, sentry_value_new_string("some string"));
+    }
+    sentry__stringbuilder_init(&sb);
+    jw = sentry__jsonwriter_new_sink(collect_chunk, &sb);
+    sentry__jsonwriter_write_value(jw, list);
+    TEST_CHECK(sentry__jsonwriter_flush(jw) != 0);
+    sentry__jsonwriter_free(jw);
+    TEST_CHECK(sentry__stringbuilder_len(&sb) < 4 * 4096 + 64);
+    sentry__stringbuilder_cleanup(&sb);
+
+    sentry_free(expected);
+    sentry_value_decref(list);
+}
+
+SENTRY_TEST(value_json_escaping_long_strings)
+{
+    // escapes at every position of a string spanning multiple 16 byte chunks,
+    // including bytes >= 0x80 that must not be mistaken for control chars
+    const char specials[] = { '"', '\\', '\n', '\x01', '\x1f', '\x7f' };
+    const char *escaped[] = { "\\\"", "\\\\", "\\n", "\\u0001", "\\u001f",
+        "\x7f" };
+    char str[41];
+    for (size_t s = 0; s < sizeof(specials); s++) {
+        for (size_t pos = 0; pos < 40; pos++) {
+            memset(str, 'a', 40);
+            str[40] = '\0';
+            str[39 - (pos + 1) % 40] = '\xc3';
+            str[pos] = specials[s];
+
+            sentry_stringbuilder_t sb;
+            sentry__stringbuilder_init(&sb);
+            sentry__stringbuilder_append_char(&sb, '"');
+            sentry__stringbuilder_append_buf(&sb, str, pos);
+            sentry__stringbuilder_append(&sb, escaped[s]);
+            sentry__stringbuilder_append(&sb, str + pos + 1);
+            sentry__stringbuilder_append_char(&sb, '"');
+            char *expected = sentry__stringbuilder_into_string(&sb);
+
+            sentry_value_t val = sentry_value_new_string(str);
+            char *json = sentry_value_to_json(val);
+            TEST_CHECK_STRING_EQUAL(json, expected);
+            sentry_free(json);
+            sentry_free(expected);
+            sentry_value_decref(val);
+        }
+    }
+}
+
 SENTRY_TEST(value_json_surrogates)
 {
     sentry_value_t rv = sentry__value_from_json(
@@ -450,16 +999,59 @@ SENTRY_TEST(value_json_locales)
         sentry_value_as_double(sentry_value_get_by_key(rv, "max_safe_int"))
         == 9007199254740991.);
 
-    // we format to 16 digits:
+    // we format to the shortest representation that round-trips:
     TEST_CHECK_JSON_VALUE(rv,
-        "{\"dbl_max\":1.797693134862316e+308,"
-        "\"dbl_min\":2.225073858507201e-308,"
+        "{\"dbl_max\":1.7976931348623157e+308,"
+        "\"dbl_min\":2.2250738585072014e-308,"
         "\"max_int32\":4294967295,"
         "\"max_safe_int\":9007199254740991}");
 
     sentry_value_decref(rv);
 }
 
+SENTRY_TEST(value_json_doubles)
+{
+    const struct {
+        double value;
+        const char *json;
+    } cases[] = {
+        { 0.0, "0" },
+        { -0.0, "-0" },
+        { 42.05, "42.05" },
+        { -2.5e-7, "-2.5e-07" },
+        { 0.0001, "0.0001" },
+        { 0.1 + 0.2, "0.30000000000000004" },
+        { 1e15, "1000000000000000" },
+        { 1e16, "1e+16" },
+        { 123456789012345678.0, "1.2345678901234568e+17" },
+        { 5e-324, "5e-324" },
+        { 1704067200.123, "1704067200.123" },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        sentry_value_t val = sentry_value_new_double(cases[i].value);
+        TEST_CHECK_JSON_VALUE(val, cases[i].json);
+        sentry_value_decref(val);
+    }
+
+    // random bit patterns all round-trip
+    uint64_t state = 88172645463325252ULL;
+    for (int i = 0; i < 10000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double d;
+        memcpy(&d, &state, sizeof(d));
+        if (!isfinite(d)) {
+            continue;
+        }
+        char buf[SENTRY_DTOA_BUF_SIZE];
+        size_t len = sentry__dtoa(d, buf);
+        TEST_CHECK(len == strlen(buf));
+        TEST_CHECK(sentry__strtod_c(buf, NULL) == d);
+        TEST_MSG("%s", buf);
+    }
+}
+
 SENTRY_TEST(value_json_invalid_doubles)
 {
     sentry_value_t val;
@@ -477,6 +1069,159 @@ SENTRY_TEST(value_json_invalid_doubles)
     sentry_value_decref(val);
 }
 
+static char *
+write_event(sentry_value_t event, size_t max_size, bool *trimmed)
+{
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+    *trimmed = sentry__jsonwriter_write_event(jw, event, max_size);
+    return sentry__jsonwriter_into_string(jw, NULL);
+}
+
+SENTRY_TEST(value_json_event_size)
+{
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_set_by_key(
+        event, "escaped", sentry_value_new_string("\"quoted\"\n\x01"));
+    sentry_value_set_by_key(event, "unicode", sentry_value_new_string("ö"));
+    sentry_value_set_by_key(event, "int", sentry_value_new_int32(-1234));
+    sentry_value_set_by_key(
+        event, "uint", sentry_value_new_uint64(UINT64_MAX));
+    sentry_value_set_by_key(event, "double", sentry_value_new_double(1.5));
+    sentry_value_set_by_key(
+        event, "infinite", sentry_value_new_double(INFINITY));
+    sentry_value_set_by_key(event, "bool", sentry_value_new_bool(false));
+    sentry_value_set_by_key(event, "null", sentry_value_new_null());
+    sentry_value_set_by_key(event, "addr", sentry__value_new_addr(0x1234));
+    sentry_value_t list = sentry_value_new_list();
+    sentry_value_append(list, sentry_value_new_list());
+    sentry_value_append(list, sentry_value_new_object());
+    sentry_value_set_by_key(event, "list", list);
+
+    char *json = sentry_value_to_json(event);
+    size_t len = strlen(json);
+
+    // the size of the event is computed exactly, without serializing it
+    bool trimmed;
+    char *written = write_event(event, len, &trimmed);
+    TEST_CHECK(!trimmed);
+    TEST_CHECK_STRING_EQUAL(written, json);
+    sentry_free(written);
+    written = write_event(event, len - 1, &trimmed);
+    TEST_CHECK(trimmed);
+    sentry_free(written);
+    written = write_event(event, 0, &trimmed);
+    TEST_CHECK(!trimmed);
+    sentry_free(written);
+
+    // writers with a sink can not discard their output, so they size the
+    // event up front
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    sentry_jsonwriter_t *jw = sentry__jsonwriter_new_sink(collect_chunk, &sb);
+    TEST_CHECK(!sentry__jsonwriter_write_event(jw, event, len));
+    TEST_CHECK_INT_EQUAL(sentry__jsonwriter_flush(jw), 0);
+    TEST_CHECK(sentry__jsonwriter_write_event(jw, event, len - 1));
+    sentry__jsonwriter_free(jw);
+    written = sentry__stringbuilder_into_string(&sb);
+    TEST_CHECK(strncmp(written, json, len) == 0);
+    sentry_free(written);
+
+    sentry_free(json);
+    sentry_value_decref(event);
+}
+
+SENTRY_TEST(value_json_event_trimming)
+{
+    sentry_value_t event = sentry_value_new_event();
+    sentry_value_t breadcrumbs = sentry_value_new_list();
+    char message[1024];
+    for (int i = 0; i < 100; i++) {
+        snprintf(message, sizeof(message), "%d %01000d", i, 0);
+        sentry_value_append(
+            breadcrumbs, sentry_value_new_breadcrumb(NULL, message));
+    }
+    sentry_value_set_by_key(event, "breadcrumbs", breadcrumbs);
+
+    // only the newest breadcrumbs are kept
+    bool trimmed;
+    char *json = write_event(event, 20 * 1024, &trimmed);
+    TEST_CHECK(trimmed);
+    TEST_CHECK(strlen(json) <= 20 * 1024);
+    sentry_value_t parsed = sentry__value_from_json(json, strlen(json));
+    sentry_free(json);
+    sentry_value_t kept = sentry_value_get_by_key(parsed, "breadcrumbs");
+    size_t kept_len = sentry_value_get_length(kept);
+    TEST_CHECK(kept_len > 10 && kept_len < 20);
+    const char *newest = sentry_value_as_string(sentry_value_get_by_key(
+        sentry_value_get_by_index(kept, kept_len - 1), "message"));
+    TEST_CHECK(strncmp(newest, "99 ", 3) == 0);
+    TEST_CHECK_INT_EQUAL(strlen(newest), 1003);
+    sentry_value_decref(parsed);
+
+    // the event itself is left alone
+    TEST_CHECK_INT_EQUAL(sentry_value_get_length(breadcrumbs), 100);
+    sentry_value_decref(event);
+
+    // long strings are cut where a character starts
+    event = sentry_value_new_event();
+    sentry_stringbuilder_t sb;
+    sentry__stringbuilder_init(&sb);
+    for (int i = 0; i < 10000; i++) {
+        sentry__stringbuilder_append(&sb, "ö");
+    }
+    sentry_value_set_by_key(event, "extra",
+        sentry__value_new_string_owned(sentry__stringbuilder_into_string(&sb)));
+    json = write_event(event, 8 * 1024, &trimmed);
+    TEST_CHECK(trimmed);
+    parsed = sentry__value_from_json(json, strlen(json));
+    sentry_free(json);
+    const char *extra
+        = sentry_value_as_string(sentry_value_get_by_key(parsed, "extra"));
+    TEST_CHECK_INT_EQUAL(strlen(extra), 4096 + 3);
+    TEST_CHECK(strcmp(extra + 4096, "...") == 0);
+    sentry_value_decref(parsed);
+    sentry_value_decref(event);
+
+    // and the middle frames of deep stack traces are left out
+    event = sentry_value_new_event();
+    sentry_value_t frames = sentry_value_new_list();
+    for (int i = 0; i < 1000; i++) {
+        sentry_value_t frame = sentry_value_new_object();
+        sentry_value_set_by_key(frame, "instruction_addr",
+            sentry__value_new_addr((uint64_t)i + 1));
+        sentry_value_append(frames, frame);
+    }
+    sentry_value_t stacktrace = sentry_value_new_object();
+    sentry_value_set_by_key(stacktrace, "frames", frames);
+    sentry_value_t thread = sentry_value_new_thread(1, "main");
+    sentry_value_set_by_key(thread, "stacktrace", stacktrace);
+    sentry_event_add_thread(event, thread);
+    json = write_event(event, 4 * 1024, &trimmed);
+    TEST_CHECK(trimmed);
+    TEST_CHECK(strlen(json) <= 4 * 1024);
+    parsed = sentry__value_from_json(json, strlen(json));
+    sentry_free(json);
+    sentry_value_t kept_frames = sentry_value_get_by_key(
+        sentry_value_get_by_key(
+            sentry_value_get_by_index(sentry_value_get_by_key(
+                sentry_value_get_by_key(parsed, "threads"), "values"), 0),
+            "stacktrace"),
+        "frames");
+    size_t frame_count = sentry_value_get_length(kept_frames);
+    TEST_CHECK(frame_count > 0 && frame_count <= 128);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(
+            sentry_value_get_by_index(kept_frames, 0), "instruction_addr")),
+        "0x1");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(
+            sentry_value_get_by_index(kept_frames, frame_count - 1),
+            "instruction_addr")),
+        "0x3e8");
+    sentry_value_decref(parsed);
+    sentry_value_decref(event);
+}
+
 SENTRY_TEST(value_wrong_type)
 {
     sentry_value_t val = sentry_value_new_null();
@@ -564,3 +1309,45 @@ SENTRY_TEST(value_set_stacktrace)
 
     sentry_value_decref(exc);
 }
+
+SENTRY_TEST(value_cache_serialized)
+{
+    sentry_value_t tags = sentry_value_new_object();
+    sentry_value_set_by_key(tags, "a", sentry_value_new_string("b\n"));
+    sentry_value_set_by_key(tags, "n", sentry_value_new_int32(42));
+    sentry__value_cache_serialized(tags);
+    TEST_CHECK(sentry_value_is_frozen(tags));
+
+    sentry_value_t event = sentry_value_new_object();
+    sentry_value_set_by_key(event, "level", sentry_value_new_string("info"));
+    sentry_value_incref(tags);
+    sentry_value_set_by_key(event, "tags", tags);
+    char *expected = sentry_value_to_json(event);
+
+    // the cached bytes are spliced in, on every write
+    for (int i = 0; i < 2; i++) {
+        sentry_jsonwriter_t *jw = sentry__jsonwriter_new(NULL);
+        TEST_CHECK(!sentry__jsonwriter_write_event(jw, event, 0));
+        char *json = sentry__jsonwriter_into_string(jw, NULL);
+        TEST_CHECK_STRING_EQUAL(json, expected);
+        sentry_free(json);
+
+        size_t size;
+        char *buf = sentry_value_to_msgpack(event, &size);
+        sentry_stringbuilder_t sb;
+        sentry__stringbuilder_init(&sb);
+        TEST_CHECK_INT_EQUAL(sentry__value_append_msgpack(&sb, event), 0);
+        TEST_CHECK_INT_EQUAL(sentry__stringbuilder_len(&sb), size);
+        TEST_CHECK(!memcmp(sb.buf, buf, size));
+        sentry__stringbuilder_cleanup(&sb);
+        sentry_free(buf);
+    }
+    sentry_free(expected);
+
+    // the cache keeps its own reference until the value is uncached
+    sentry_value_decref(event);
+    TEST_CHECK_INT_EQUAL(sentry_value_refcount(tags), 2);
+    sentry__value_uncache_serialized(tags);
+    TEST_CHECK_INT_EQUAL(sentry_value_refcount(tags), 1);
+    sentry_value_decref(tags);
+}
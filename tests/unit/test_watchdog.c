@@ -0,0 +1,76 @@
+#include "sentry_core.h"
+#include "sentry_sync.h"
+#include "sentry_testsupport.h"
+#include "sentry_utils.h"
+
+#define APP_HANG_TIMEOUT_MS 50
+
+static void
+send_envelope_app_hang(const sentry_envelope_t *envelope, void *data)
+{
+    sentry_value_t event = sentry_envelope_get_event(envelope);
+    sentry_value_t exception = sentry_value_get_by_index(
+        sentry_value_get_by_key(sentry_value_get_by_key(event, "exception"),
+            "values"),
+        0);
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(exception, "type")),
+        "App Hanging");
+    sentry_value_t mechanism = sentry_value_get_by_key(exception, "mechanism");
+    TEST_CHECK_STRING_EQUAL(
+        sentry_value_as_string(sentry_value_get_by_key(mechanism, "type")),
+        "AppHang");
+    double duration = sentry_value_as_double(sentry_value_get_by_key(
+        sentry_value_get_by_key(mechanism, "data"), "duration_ms"));
+    TEST_CHECK(duration >= APP_HANG_TIMEOUT_MS);
+
+#ifdef SENTRY_PLATFORM_LINUX
+    sentry_value_t frames = sentry_value_get_by_key(
+        sentry_value_get_by_key(exception, "stacktrace"), "frames");
+    TEST_CHECK(sentry_value_get_length(frames) > 0);
+#endif
+
+    sentry__atomic_fetch_and_add((volatile long *)data, 1);
+}
+
+TEST_VISIBLE void
+hang_until_reported(volatile long *reported, long count, uint64_t max_ms)
+{
+    uint64_t deadline = sentry__monotonic_time() + max_ms;
+    while (sentry__atomic_fetch(reported) < count
+        && sentry__monotonic_time() < deadline) {
+        // busy waiting, so that the stalled thread is not in a syscall
+    }
+}
+
+SENTRY_TEST(app_hang_watchdog)
+{
+    volatile long reported = 0;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://foo@sentry.invalid/42");
+    sentry_options_set_transport(options,
+        sentry_new_function_transport(
+            send_envelope_app_hang, (void *)&reported));
+    sentry_options_set_app_hang_timeout(options, APP_HANG_TIMEOUT_MS);
+    TEST_CHECK_INT_EQUAL(
+        sentry_options_get_app_hang_timeout(options), APP_HANG_TIMEOUT_MS);
+    sentry_init(options);
+
+    // nothing is reported before the first heartbeat, or while they come in
+    for (int i = 0; i < 20; i++) {
+        hang_until_reported(&reported, 1, APP_HANG_TIMEOUT_MS / 5);
+        sentry_app_heartbeat();
+    }
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&reported), 0);
+
+    hang_until_reported(&reported, 1, 5000);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&reported), 1);
+
+    // the same stall is not reported again
+    hang_until_reported(&reported, 2, APP_HANG_TIMEOUT_MS * 4);
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&reported), 1);
+
+    sentry_close();
+    TEST_CHECK_INT_EQUAL(sentry__atomic_fetch(&reported), 1);
+}